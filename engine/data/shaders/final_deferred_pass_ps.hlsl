@@ -15,10 +15,28 @@ uniform Texture2D ws_normalTex: register(t2);
 
 uniform sampler texSampler;
 
-cbuffer PointLightBuffer: register(b0)
+// same layout as PointLight in ClusteredLighting.hpp
+struct PointLight {
+	float3 wsPosition;
+	float radius;
+	float3 color;
+	float intensity;
+};
+
+// built on the cpu by ClusteredLighting
+uniform StructuredBuffer<PointLight> lights: register(t3);
+// x = offset into lightIndices, y = count
+uniform StructuredBuffer<uint2> clusterGrid: register(t4);
+uniform StructuredBuffer<uint> lightIndices: register(t5);
+
+cbuffer ClusterBuffer: register(b0)
 {
-	float3 Pos;
-	float3 Col;
+	uint3 gridSize;
+	float sliceScale;
+	float sliceBias;
+	float2 tileScale;
+	uint lightCount;
+	float3 wsCameraPos;
 };
 
 cbuffer MatrixBuffer : register(b1)
@@ -28,20 +46,49 @@ cbuffer MatrixBuffer : register(b1)
     float4x4 viewToProjection;
 };
 
-// @TODO: point light only for now
-float3 PhongBRDF(float3 wsLightPos, float3 wsCamPos, float3 wsFragPos, float3 wsFragNormal)
+uint ClusterIndex(float2 pixelPos, float viewZ)
 {
-	// @TODO: material cbuffer, and param into brdf
-	float ka = 1;
-	float kd = 0.5;
-	float ks = 0.6;
-	float alpha = 32;
+	uint2 tile = min(uint2(pixelPos * tileScale), gridSize.xy - 1);
+	// exponential slices, same as ClusteredLighting::Build
+	int slice = int(floor(log(max(viewZ, 1e-4)) * sliceScale + sliceBias));
+	uint z = uint(clamp(slice, 0, int(gridSize.z) - 1));
 
-	float3 lightDir = normalize(wsLightPos - wsFragPos);
+	return (z * gridSize.y + tile.y) * gridSize.x + tile.x;
+}
+
+// smooth falloff that reaches exactly 0 at the radius, so lights outside a cluster really contribute nothing
+float Attenuation(float distance, float radius)
+{
+	float ratio = distance / radius;
+	float ratio4 = ratio * ratio * ratio * ratio;
+	float window = saturate(1 - ratio4);
+	return window * window / (distance * distance + 1);
+}
+
+// the phong terms of a material, metallic 0 and roughness 0.5 are the kd 0.5, ks 0.6 and alpha 32 this
+// used to hardcode, metals lose the diffuse and rough surfaces the highlight
+// same as PhongTerms in SoftwareRenderer.cpp
+void PhongTerms(float metallic, float roughness, out float kd, out float ks, out float alpha)
+{
+	kd = 0.5 * (1 - metallic);
+	ks = 1.2 * (1 - roughness);
+	alpha = exp2(10 * (1 - roughness));
+}
+
+// @TODO: point light only for now
+float3 PhongBRDF(PointLight light, float3 wsCamPos, float3 wsFragPos, float3 wsFragNormal, float metallic, float roughness)
+{
+	float kd;
+	float ks;
+	float alpha;
+	PhongTerms(metallic, roughness, kd, ks, alpha);
+
+	float3 toLight = light.wsPosition - wsFragPos;
+	float distance = length(toLight);
+	float3 lightDir = toLight / max(distance, 1e-4);
 	float shading = max(dot(lightDir, wsFragNormal), 0);
 
-	float3 diffuse = float3(Col * shading);
-	float3 ambient = float3(0.1, 0.1, 0.1);
+	float3 diffuse = float3(light.color * shading);
 
 	// reflect assumes incident vector is going into the surface
 	float3 reflectDir = reflect(-lightDir, wsFragNormal);
@@ -51,7 +98,9 @@ float3 PhongBRDF(float3 wsLightPos, float3 wsCamPos, float3 wsFragPos, float3 ws
 	float specTemp = max(dot(reflectDir, viewDir), 0);
 	float specular = pow(specTemp, alpha);
 
-	return ka * ambient + kd * diffuse + ks * specular;
+	float attenuation = Attenuation(distance, light.radius) * light.intensity;
+
+	return attenuation * (kd * diffuse + ks * specular * light.color);
 }
 
 PSOutput PSMain(PSInput psInput)
@@ -59,15 +108,32 @@ PSOutput PSMain(PSInput psInput)
 	PSOutput psOutput;
 
 	float4 albedo = albedoTex.Sample(texSampler, psInput.uv0);
-	float3 ws_position = ws_positionTex.Sample(texSampler, psInput.uv0).rgb;
-	float3 ws_normal = ws_normalTex.Sample(texSampler, psInput.uv0).rgb;
+	float4 ws_positionMetallic = ws_positionTex.Sample(texSampler, psInput.uv0);
+	float4 ws_normalRoughness = ws_normalTex.Sample(texSampler, psInput.uv0);
+	float3 ws_position = ws_positionMetallic.xyz;
+	float3 ws_normal = ws_normalRoughness.xyz;
+	float metallic = ws_positionMetallic.w;
+	float roughness = ws_normalRoughness.w;
+
+	// written by simple_deferred_ps for unlit materials
+	if (roughness < 0) {
+		psOutput.combined = albedo;
+		return psOutput;
+	}
 	
-#if 1
-	float3 wsCamPos = float3(-worldToView[3][0], -worldToView[3][1], -worldToView[3][2]);
-	float3 brdf = PhongBRDF(Pos, wsCamPos, ws_position, ws_normal);
+	float ka = 1;
+	float3 ambient = float3(0.1, 0.1, 0.1);
+	float3 brdf = ka * ambient;
+
+	float viewZ = mul(float4(ws_position, 1.0), worldToView).z;
+	uint2 cluster = clusterGrid[ClusterIndex(psInput.cs_position.xy, viewZ)];
+
+	for (uint i = 0; i < cluster.y; ++i) {
+		PointLight light = lights[lightIndices[cluster.x + i]];
+		brdf += PhongBRDF(light, wsCameraPos, ws_position, ws_normal, metallic, roughness);
+	}
 
 	float4 pixelColor = albedo * float4(brdf, 1.0);
-#endif
 
 	psOutput.combined = pixelColor;
 
@@ -14,22 +14,68 @@ struct PSOutput {
 	float4 ws_normal: SV_TARGET2;
 };
 
-uniform Texture2D albedoTex;
+// same layout as Material::Constants in Material.hpp
+struct Material {
+	float4 baseColorFactor;
+	float3 emissiveFactor;
+	float metallicFactor;
+	float roughnessFactor;
+	float normalScale;
+	float occlusionStrength;
+	float alphaCutoff;
+	uint alphaMode;
+	uint flags;
+	uint textureMask;
+	uint texCoords;
+};
+
+// Material::AlphaMode, blend is drawn like opaque until there is a forward pass
+#define ALPHA_MODE_OPAQUE 0
+#define ALPHA_MODE_MASK 1
+#define ALPHA_MODE_BLEND 2
+
+#define MATERIAL_FLAG_UNLIT 2
+
+// feature switches from the catalog, every variant gets all of them as 0 or 1
+#ifndef ALPHA_MASK
+#define ALPHA_MASK 0
+#endif
+
+uniform Texture2D albedoTex: register(t0);
+// every material of the catalog, indexed by the MaterialID of the draw
+uniform StructuredBuffer<Material> materials: register(t1);
 
 uniform sampler texSampler;
 
+cbuffer MatrixBuffer : register(b1)
+{
+    float4x4 modelToWorld;
+    float4x4 worldToView;
+    float4x4 viewToProjection;
+	uint materialIndex;
+};
+
 PSOutput PSMain(PSInput psInput)
 {
 	PSOutput psOutput;
 
-	float4 albedo = albedoTex.Sample(texSampler, psInput.uv0);
+	Material material = materials[materialIndex];
+
+	float4 albedo = albedoTex.Sample(texSampler, psInput.uv0) * material.baseColorFactor;
+	// only the variant for masked materials clips, so the rest keep early depth
+#if ALPHA_MASK
+	clip(albedo.a - material.alphaCutoff);
+#endif
+
 	float3 ws_position = psInput.ws_position;
 	float3 ws_normal = psInput.ws_normal;
 
+	// the final pass reads metallic and roughness from the w of the position and normal targets,
+	// a negative roughness means unlit
+	bool unlit = (material.flags & MATERIAL_FLAG_UNLIT) != 0;
 	psOutput.albedo = albedo;
-	const float xxunused = 1;
-	psOutput.ws_position = float4(ws_position, xxunused);
-	psOutput.ws_normal = float4(ws_normal, xxunused);
+	psOutput.ws_position = float4(ws_position, material.metallicFactor);
+	psOutput.ws_normal = float4(ws_normal, unlit ? -1.0 : material.roughnessFactor);
 
 	return psOutput;
 }
\ No newline at end of file
@@ -20,6 +20,9 @@ cbuffer MatrixBuffer : register(b0)
     float4x4 worldToView;
 	// @TODO: rename to viewToClip
     float4x4 viewToProjection;
+	uint materialIndex;
+	// quantized positions come in divided by the largest value of their type, 1 otherwise
+	float positionScale;
 };
 
 VSOutput VSMain(VSInput vsInput) {
@@ -27,6 +30,7 @@ VSOutput VSMain(VSInput vsInput) {
 
 	// @TODO: can i just set w to 1?
 	// @TODO: put this in a func? or macro?
+	vsInput.obj_position.xyz *= positionScale;
 	vsInput.obj_position.w = 1;
 	vsOutput.cs_position = vsInput.obj_position;
 	vsOutput.cs_position = mul(vsOutput.cs_position, modelToWorld);
@@ -18,11 +18,15 @@ cbuffer MatrixBuffer : register(b0)
     float4x4 modelToWorld;
     float4x4 worldToView;
     float4x4 viewToProjection;
+	uint materialIndex;
+	// quantized positions come in divided by the largest value of their type, 1 otherwise
+	float positionScale;
 };
 
 PSInput VSMain(VSInput vsInput) {
 	PSInput psInput;
 
+	vsInput.position.xyz *= positionScale;
 	vsInput.position.w = 1;
 	psInput.position = vsInput.position;
 	psInput.position = mul(psInput.position, modelToWorld);
@@ -0,0 +1,1240 @@
+#include "Animation.hpp"
+#include "AnimationCompression.hpp"
+
+#include "Core/JobSystem.hpp"
+#include "Core/Profiler.hpp"
+
+// sse2 only, every x64 cpu has it so there is nothing to pick at startup like MathBatch does
+#include <immintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+using namespace Animation;
+
+static constexpr u32 PathCount = static_cast<u32>(Path::Count);
+
+// a character with a typical skeleton takes a few microseconds
+static constexpr u32 InstancesPerJob = 16;
+
+// quaternions shorter than this come out as identity instead of nan
+static constexpr f32 s_minLengthSq = 1e-30f;
+
+static constexpr u32 SignBit = 0x80000000u;
+
+void Animation::SetTransform(TransformSoa& packet, u32 lane, const float3& translation, const float4& rotation, const float3& scale)
+{
+	ENSURE(lane < PacketWidth, "");
+
+	packet.translation[0][lane] = translation.x;
+	packet.translation[1][lane] = translation.y;
+	packet.translation[2][lane] = translation.z;
+	packet.rotation[0][lane] = rotation.x;
+	packet.rotation[1][lane] = rotation.y;
+	packet.rotation[2][lane] = rotation.z;
+	packet.rotation[3][lane] = rotation.w;
+	packet.scale[0][lane] = scale.x;
+	packet.scale[1][lane] = scale.y;
+	packet.scale[2][lane] = scale.z;
+}
+
+void Animation::InitClip(const Skeleton& skeleton, Clip& outClip)
+{
+	const u32 jointCount = skeleton.JointCount();
+	const u32 packetCount = PacketCount(jointCount);
+	ENSURE(skeleton.restPose.size() == packetCount, "skeleton rest pose doesnt match its joints");
+
+	outClip.duration = 0.0f;
+	outClip.times.assign(1, 0.0f);
+	outClip.translations.clear();
+	outClip.rotations.clear();
+	outClip.scales.clear();
+	outClip.tracks.resize(static_cast<size_t>(packetCount) * PacketWidth * PathCount);
+	outClip.constants.assign(skeleton.restPose.begin(), skeleton.restPose.end());
+	outClip.animatedPaths.assign(packetCount, 0);
+
+	// one key per joint, the padding lanes get the identity the rest pose has there
+	for (u32 joint = 0; joint < packetCount * PacketWidth; ++joint) {
+		const TransformSoa& rest = skeleton.restPose[joint / PacketWidth];
+		const u32 lane = joint % PacketWidth;
+
+		outClip.tracks[TrackIndex(joint, Path::Translation)] = Track{ .timesOffset = 0, .keyCount = 1, .valuesOffset = static_cast<u32>(outClip.translations.size()), .interpolation = Interpolation::Step };
+		outClip.tracks[TrackIndex(joint, Path::Rotation)] = Track{ .timesOffset = 0, .keyCount = 1, .valuesOffset = static_cast<u32>(outClip.rotations.size()), .interpolation = Interpolation::Step };
+		outClip.tracks[TrackIndex(joint, Path::Scale)] = Track{ .timesOffset = 0, .keyCount = 1, .valuesOffset = static_cast<u32>(outClip.scales.size()), .interpolation = Interpolation::Step };
+
+		outClip.translations.push_back(float3(rest.translation[0][lane], rest.translation[1][lane], rest.translation[2][lane]));
+		outClip.rotations.push_back(float4(rest.rotation[0][lane], rest.rotation[1][lane], rest.rotation[2][lane], rest.rotation[3][lane]));
+		outClip.scales.push_back(float3(rest.scale[0][lane], rest.scale[1][lane], rest.scale[2][lane]));
+	}
+}
+
+u32 Animation::AddKeyTimes(Clip& clip, std::span<const f32> times)
+{
+	ENSURE(!times.empty(), "a track needs at least one key");
+	ENSURE(std::is_sorted(times.begin(), times.end()), "key times have to be increasing");
+
+	const u32 offset = static_cast<u32>(clip.times.size());
+	clip.times.insert(clip.times.end(), times.begin(), times.end());
+	clip.duration = std::max(clip.duration, times.back());
+	return offset;
+}
+
+void Animation::SetTrack(Clip& clip, u32 joint, Path path, Interpolation interpolation, u32 timesOffset, u32 keyCount, std::span<const f32> values)
+{
+	ENSURE(keyCount > 0 && timesOffset <= clip.times.size() && keyCount <= clip.times.size() - timesOffset, "SetTrack key times out of range");
+	ENSURE(TrackIndex(joint, path) < clip.tracks.size(), "SetTrack joint out of range");
+
+	const u32 components = path == Path::Rotation ? 4 : 3;
+	const u32 valuesPerKey = interpolation == Interpolation::CubicSpline ? 3 : 1;
+	ENSURE(values.size() == static_cast<size_t>(keyCount) * valuesPerKey * components, "SetTrack value count doesnt match the keys");
+
+	// valuesOffset is where append puts the values
+	Track track = { .timesOffset = timesOffset, .keyCount = keyCount, .valuesOffset = 0, .interpolation = interpolation };
+	auto append = [&](auto& stream) {
+		using Value = std::remove_reference_t<decltype(stream[0])>;
+		track.valuesOffset = static_cast<u32>(stream.size());
+		const Value* begin = reinterpret_cast<const Value*>(values.data());
+		stream.insert(stream.end(), begin, begin + values.size() / components);
+	};
+
+	switch (path) {
+	case Path::Translation: append(clip.translations); break;
+	case Path::Rotation: append(clip.rotations); break;
+	case Path::Scale: append(clip.scales); break;
+	case Path::Count: UNREACHABLE(""); break;
+	}
+
+	clip.tracks[TrackIndex(joint, path)] = track;
+
+	const u32 packet = joint / PacketWidth;
+	const u32 lane = joint % PacketWidth;
+	if (keyCount == 1) {
+		const f32* value = values.data() + (interpolation == Interpolation::CubicSpline ? components : 0);
+		TransformSoa& constants = clip.constants[packet];
+		f32 (*lanes)[PacketWidth] = path == Path::Translation ? constants.translation : path == Path::Rotation ? constants.rotation : constants.scale;
+		for (u32 c = 0; c < components; ++c) {
+			lanes[c][lane] = value[c];
+		}
+	}
+
+	const u8 bit = static_cast<u8>(1u << static_cast<u32>(path));
+	clip.animatedPaths[packet] &= ~bit;
+	for (u32 l = 0; l < PacketWidth; ++l) {
+		if (clip.tracks[TrackIndex(packet * PacketWidth + l, path)].keyCount > 1) {
+			clip.animatedPaths[packet] |= bit;
+		}
+	}
+}
+
+//
+// sampling
+//
+
+// where time falls between the keys of a track
+struct KeyLookup {
+	u32 timesOffset = std::numeric_limits<u32>::max();
+	u32 keyCount = 0;
+
+	u32 key = 0;
+	u32 nextKey = 0;
+	// 0 to 1 from key to nextKey
+	f32 t = 0.0f;
+	// seconds from key to nextKey, cubic spline tangents are scaled by it
+	f32 interval = 0.0f;
+};
+
+// tracks from the same sampler share their times, so most of the time the last lookup is the one needed
+static const KeyLookup& FindKeys(const Clip& clip, const Track& track, f32 time, KeyLookup& lookup)
+{
+	if (track.timesOffset == lookup.timesOffset && track.keyCount == lookup.keyCount) {
+		return lookup;
+	}
+
+	lookup.timesOffset = track.timesOffset;
+	lookup.keyCount = track.keyCount;
+
+	const f32* times = clip.times.data() + track.timesOffset;
+	const u32 lastKey = track.keyCount - 1;
+
+	if (lastKey == 0 || time <= times[0]) {
+		lookup.key = 0;
+		lookup.nextKey = 0;
+		lookup.t = 0.0f;
+		lookup.interval = 0.0f;
+	} else if (time >= times[lastKey]) {
+		lookup.key = lastKey;
+		lookup.nextKey = lastKey;
+		lookup.t = 0.0f;
+		lookup.interval = 0.0f;
+	} else {
+		// times[next - 1] <= time < times[next]
+		const u32 next = static_cast<u32>(std::upper_bound(times + 1, times + lastKey, time) - times);
+		lookup.key = next - 1;
+		lookup.nextKey = next;
+		lookup.interval = times[next] - times[next - 1];
+		lookup.t = (time - times[next - 1]) / lookup.interval;
+	}
+
+	return lookup;
+}
+
+// every interpolation is the same weighted sum of 4 values per lane, the value at the key (p0) and its
+// out tangent (m0), the value at the next key (p1) and its in tangent (m1), linear and step just weight
+// the tangents with 0, so all 4 lanes go through one multiply add whatever their tracks are
+template<u32 Components>
+struct alignas(16) GatheredKeys {
+	f32 weights[4][PacketWidth];
+	f32 values[4][Components][PacketWidth];
+	// sign bit in lanes where the rotation should go the short way, cubic splines are used as they are
+	u32 shortestPath[PacketWidth];
+};
+
+template<u32 Components, typename Value>
+static void GatherKeys(const Clip& clip, const Track* tracks, const Value* values, f32 time, KeyLookup& lookup, GatheredKeys<Components>& out)
+{
+	static_assert(sizeof(Value) == Components * sizeof(f32));
+	static constexpr f32 zeros[Components] = {};
+
+	for (u32 lane = 0; lane < PacketWidth; ++lane) {
+		const Track& track = tracks[lane];
+		const KeyLookup& keys = FindKeys(clip, track, time, lookup);
+		const f32* base = reinterpret_cast<const f32*>(values + track.valuesOffset);
+
+		const f32* p0 = nullptr;
+		const f32* m0 = zeros;
+		const f32* p1 = nullptr;
+		const f32* m1 = zeros;
+		f32 weights[4] = {};
+
+		switch (track.interpolation) {
+		case Interpolation::Step: {
+			p0 = base + keys.key * Components;
+			p1 = p0;
+			weights[0] = 1.0f;
+		} break;
+		case Interpolation::Linear: {
+			p0 = base + keys.key * Components;
+			p1 = base + keys.nextKey * Components;
+			weights[0] = 1.0f - keys.t;
+			weights[2] = keys.t;
+		} break;
+		case Interpolation::CubicSpline: {
+			p0 = base + (keys.key * 3 + 1) * Components;
+			m0 = base + (keys.key * 3 + 2) * Components;
+			p1 = base + (keys.nextKey * 3 + 1) * Components;
+			m1 = base + (keys.nextKey * 3 + 0) * Components;
+
+			// hermite basis, the tangents are per second
+			const f32 t = keys.t;
+			const f32 t2 = t * t;
+			const f32 t3 = t2 * t;
+			weights[0] = 2.0f * t3 - 3.0f * t2 + 1.0f;
+			weights[1] = (t3 - 2.0f * t2 + t) * keys.interval;
+			weights[2] = -2.0f * t3 + 3.0f * t2;
+			weights[3] = (t3 - t2) * keys.interval;
+		} break;
+		}
+
+		const f32* sources[4] = { p0, m0, p1, m1 };
+		for (u32 i = 0; i < 4; ++i) {
+			out.weights[i][lane] = weights[i];
+			for (u32 c = 0; c < Components; ++c) {
+				out.values[i][c][lane] = sources[i][c];
+			}
+		}
+		out.shortestPath[lane] = track.interpolation == Interpolation::CubicSpline ? 0 : SignBit;
+	}
+}
+
+template<u32 Components>
+static inline void WeightKeys(const GatheredKeys<Components>& keys, __m128 out[Components])
+{
+	const __m128 w0 = _mm_load_ps(keys.weights[0]);
+	const __m128 w1 = _mm_load_ps(keys.weights[1]);
+	const __m128 w2 = _mm_load_ps(keys.weights[2]);
+	const __m128 w3 = _mm_load_ps(keys.weights[3]);
+
+	for (u32 c = 0; c < Components; ++c) {
+		out[c] = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(w0, _mm_load_ps(keys.values[0][c])), _mm_mul_ps(w1, _mm_load_ps(keys.values[1][c]))),
+			_mm_add_ps(_mm_mul_ps(w2, _mm_load_ps(keys.values[2][c])), _mm_mul_ps(w3, _mm_load_ps(keys.values[3][c]))));
+	}
+}
+
+static inline __m128 Dot4(const __m128 a[4], const __m128 b[4])
+{
+	return _mm_add_ps(
+		_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])),
+		_mm_add_ps(_mm_mul_ps(a[2], b[2]), _mm_mul_ps(a[3], b[3])));
+}
+
+static inline void NormalizeQuaternions(__m128 q[4])
+{
+	const __m128 lengthSq = Dot4(q, q);
+	const __m128 valid = _mm_cmpgt_ps(lengthSq, _mm_set1_ps(s_minLengthSq));
+	const __m128 inverseLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_max_ps(lengthSq, _mm_set1_ps(s_minLengthSq))));
+	for (u32 c = 0; c < 3; ++c) {
+		q[c] = _mm_and_ps(_mm_mul_ps(q[c], inverseLength), valid);
+	}
+	// w is 1 where the length was 0
+	q[3] = _mm_or_ps(_mm_and_ps(_mm_mul_ps(q[3], inverseLength), valid), _mm_andnot_ps(valid, _mm_set1_ps(1.0f)));
+}
+
+static void SampleRotations(const Clip& clip, const Track* tracks, f32 time, KeyLookup& lookup, f32 out[4][PacketWidth])
+{
+	GatheredKeys<4> keys;
+	GatherKeys(clip, tracks, clip.rotations.data(), time, lookup, keys);
+
+	// q and -q are the same rotation, flip the next key where that makes the way there shorter
+	__m128 p0[4];
+	__m128 p1[4];
+	for (u32 c = 0; c < 4; ++c) {
+		p0[c] = _mm_load_ps(keys.values[0][c]);
+		p1[c] = _mm_load_ps(keys.values[2][c]);
+	}
+	const __m128 flip = _mm_and_ps(_mm_cmplt_ps(Dot4(p0, p1), _mm_setzero_ps()), _mm_load_ps(reinterpret_cast<const f32*>(keys.shortestPath)));
+	for (u32 c = 0; c < 4; ++c) {
+		_mm_store_ps(keys.values[2][c], _mm_xor_ps(p1[c], flip));
+	}
+
+	__m128 q[4];
+	WeightKeys(keys, q);
+	NormalizeQuaternions(q);
+	for (u32 c = 0; c < 4; ++c) {
+		_mm_store_ps(out[c], q[c]);
+	}
+}
+
+template<typename Value>
+static void SampleVectors(const Clip& clip, const Track* tracks, const Value* values, f32 time, KeyLookup& lookup, f32 out[3][PacketWidth])
+{
+	GatheredKeys<3> keys;
+	GatherKeys(clip, tracks, values, time, lookup, keys);
+
+	__m128 v[3];
+	WeightKeys(keys, v);
+	for (u32 c = 0; c < 3; ++c) {
+		_mm_store_ps(out[c], v[c]);
+	}
+}
+
+void Animation::SampleClip(const Clip& clip, f32 time, std::span<TransformSoa> out)
+{
+	ENSURE(clip.tracks.size() == out.size() * PacketWidth * PathCount, "SampleClip pose doesnt match the clip");
+
+	KeyLookup lookup;
+	for (size_t p = 0; p < out.size(); ++p) {
+		const Track* tracks = clip.tracks.data() + p * PacketWidth * PathCount;
+		const TransformSoa& constants = clip.constants[p];
+		const u8 animated = clip.animatedPaths[p];
+
+		if (animated & (1u << static_cast<u32>(Path::Translation))) {
+			SampleVectors(clip, tracks + static_cast<u32>(Path::Translation) * PacketWidth, clip.translations.data(), time, lookup, out[p].translation);
+		} else {
+			std::memcpy(out[p].translation, constants.translation, sizeof(constants.translation));
+		}
+		if (animated & (1u << static_cast<u32>(Path::Rotation))) {
+			SampleRotations(clip, tracks + static_cast<u32>(Path::Rotation) * PacketWidth, time, lookup, out[p].rotation);
+		} else {
+			std::memcpy(out[p].rotation, constants.rotation, sizeof(constants.rotation));
+		}
+		if (animated & (1u << static_cast<u32>(Path::Scale))) {
+			SampleVectors(clip, tracks + static_cast<u32>(Path::Scale) * PacketWidth, clip.scales.data(), time, lookup, out[p].scale);
+		} else {
+			std::memcpy(out[p].scale, constants.scale, sizeof(constants.scale));
+		}
+	}
+}
+
+//
+// compressed clips
+//
+
+// the two keys of every lane of a path and how far between them the frame is, lanes without a track get
+// zeros that are masked out in the end
+// curves take 4 keys and are rare, so they are evaluated while gathering and only selected in the end
+struct alignas(16) CompressedLanes {
+	i32 values[2][3][PacketWidth];
+	i32 largest[2][PacketWidth];
+	f32 t[PacketWidth];
+	u32 animated[PacketWidth];
+	f32 min[3][PacketWidth];
+	f32 extent[3][PacketWidth];
+	f32 curve[4][PacketWidth];
+	u32 curveLanes[PacketWidth];
+};
+
+static constexpr f32 s_smallestThreeRange = 0.70710678f;
+
+// returns how many tracks it used
+static u32 GatherCompressedKeys(const CompressedClip& clip, const CompressedTrack* tracks, u32 laneMask, f32 time, f32 frame, CompressedLanes& out)
+{
+	const u32 wholeFrame = static_cast<u32>(frame);
+	u32 used = 0;
+	for (u32 lane = 0; lane < PacketWidth; ++lane) {
+		if ((laneMask & (1u << lane)) == 0) {
+			for (u32 k = 0; k < 2; ++k) {
+				for (u32 c = 0; c < 3; ++c) {
+					out.values[k][c][lane] = 0;
+				}
+				out.largest[k][lane] = 3;
+			}
+			for (u32 c = 0; c < 3; ++c) {
+				out.min[c][lane] = 0.0f;
+				out.extent[c][lane] = 0.0f;
+			}
+			for (u32 c = 0; c < 4; ++c) {
+				out.curve[c][lane] = 0.0f;
+			}
+			out.t[lane] = 0.0f;
+			out.animated[lane] = 0;
+			out.curveLanes[lane] = 0;
+			continue;
+		}
+
+		const CompressedTrack& track = tracks[used++];
+		out.curveLanes[lane] = track.curve ? 0xFFFFFFFFu : 0;
+
+		// the last key at or before the frame but not the last key, frames are whole so comparing to the
+		// whole part is the same, and without branches the search doesnt stall on every other step
+		const CompressedKey* key = clip.keys.data() + track.keyOffset;
+		f32 t = 0.0f;
+		if (track.timesOffset == KeysOnFrames) {
+			for (u32 count = track.keyCount - 1; count > 1;) {
+				const u32 half = count / 2;
+				key = key[half].Frame() <= wholeFrame ? key + half : key;
+				count -= half;
+			}
+			t = std::min((frame - key->Frame()) / static_cast<f32>(key[1].Frame() - key->Frame()), 1.0f);
+		} else {
+			// the same on the source times, which can start after 0, curves have 3 keys for each of them but the last
+			const f32* times = clip.times.data() + track.timesOffset;
+			u32 index = 0;
+			for (u32 count = (track.curve ? (track.keyCount + 2) / 3 : track.keyCount) - 1; count > 1;) {
+				const u32 half = count / 2;
+				index = times[index + half] <= time ? index + half : index;
+				count -= half;
+			}
+			t = std::clamp((time - times[index]) / (times[index + 1] - times[index]), 0.0f, 1.0f);
+			key += track.curve ? index * 3 : index;
+		}
+		const CompressedKey* next = key + 1;
+
+		// the bezier between the key and the next, the keys of the lane are left for the lerp to throw away
+		if (track.curve) {
+			const f32 s = 1.0f - t;
+			const f32 weights[4] = { s * s * s, 3.0f * s * s * t, 3.0f * s * t * t, t * t * t };
+			const f32* min = &track.min.x;
+			const f32* extent = &track.extent.x;
+			for (u32 c = 0; c < 4; ++c) {
+				f32 value = 0.0f;
+				for (u32 i = 0; i < 4; ++i) {
+					const u16 quantized = c < 3 ? key[i].values[c] : key[i].frameAndLargest;
+					value += weights[i] * (min[c] + static_cast<f32>(quantized) * (extent[c] * (1.0f / 65535.0f)));
+				}
+				out.curve[c][lane] = value;
+			}
+			t = 0.0f;
+		} else {
+			for (u32 c = 0; c < 4; ++c) {
+				out.curve[c][lane] = 0.0f;
+			}
+		}
+
+		out.t[lane] = track.step ? (t < 1.0f ? 0.0f : 1.0f) : t;
+		out.animated[lane] = 0xFFFFFFFFu;
+
+		const f32* min = &track.min.x;
+		const f32* extent = &track.extent.x;
+		for (u32 c = 0; c < 3; ++c) {
+			out.values[0][c][lane] = key->values[c];
+			out.values[1][c][lane] = next->values[c];
+			out.min[c][lane] = min[c];
+			out.extent[c][lane] = extent[c];
+		}
+		out.largest[0][lane] = static_cast<i32>(key->Largest());
+		out.largest[1][lane] = static_cast<i32>(next->Largest());
+	}
+	return used;
+}
+
+static inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static void DecodeVectors(const CompressedLanes& lanes, f32 inOut[3][PacketWidth])
+{
+	const __m128 t = _mm_load_ps(lanes.t);
+	const __m128 animated = _mm_load_ps(reinterpret_cast<const f32*>(lanes.animated));
+	const __m128 curve = _mm_load_ps(reinterpret_cast<const f32*>(lanes.curveLanes));
+	const __m128 step = _mm_set1_ps(1.0f / 65535.0f);
+
+	for (u32 c = 0; c < 3; ++c) {
+		const __m128 min = _mm_load_ps(lanes.min[c]);
+		const __m128 extent = _mm_mul_ps(_mm_load_ps(lanes.extent[c]), step);
+		const __m128 v0 = _mm_add_ps(min, _mm_mul_ps(_mm_cvtepi32_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(lanes.values[0][c]))), extent));
+		const __m128 v1 = _mm_add_ps(min, _mm_mul_ps(_mm_cvtepi32_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(lanes.values[1][c]))), extent));
+		const __m128 v = Select(curve, _mm_load_ps(lanes.curve[c]), _mm_add_ps(v0, _mm_mul_ps(_mm_sub_ps(v1, v0), t)));
+		_mm_store_ps(inOut[c], Select(animated, v, _mm_load_ps(inOut[c])));
+	}
+}
+
+// smallest three back to x y z w, the left out component is the one that makes the length 1
+static void DecodeSmallestThree(const i32 values[3][PacketWidth], const i32 largest[PacketWidth], __m128 out[4])
+{
+	const __m128 step = _mm_set1_ps(2.0f * s_smallestThreeRange / 65535.0f);
+	const __m128 range = _mm_set1_ps(s_smallestThreeRange);
+
+	__m128 a[3];
+	for (u32 c = 0; c < 3; ++c) {
+		a[c] = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(values[c]))), step), range);
+	}
+	const __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], a[0]), _mm_mul_ps(a[1], a[1])), _mm_mul_ps(a[2], a[2]));
+	const __m128 d = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.0f), lengthSq), _mm_setzero_ps()));
+
+	const __m128i index = _mm_load_si128(reinterpret_cast<const __m128i*>(largest));
+	const __m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_set1_epi32(0)));
+	const __m128 is1 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_set1_epi32(1)));
+	const __m128 is2 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_set1_epi32(2)));
+	const __m128 is3 = _mm_castsi128_ps(_mm_cmpeq_epi32(index, _mm_set1_epi32(3)));
+
+	out[0] = Select(is0, d, a[0]);
+	out[1] = Select(is0, a[0], Select(is1, d, a[1]));
+	out[2] = Select(_mm_or_ps(is0, is1), a[1], Select(is2, d, a[2]));
+	out[3] = Select(is3, d, a[2]);
+}
+
+static void DecodeRotations(const CompressedLanes& lanes, f32 inOut[4][PacketWidth])
+{
+	__m128 q0[4];
+	__m128 q1[4];
+	DecodeSmallestThree(lanes.values[0], lanes.largest[0], q0);
+	DecodeSmallestThree(lanes.values[1], lanes.largest[1], q1);
+
+	// keys always have a positive largest component, so neighbours can be on opposite sides
+	const __m128 flip = _mm_and_ps(_mm_cmplt_ps(Dot4(q0, q1), _mm_setzero_ps()), _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(SignBit))));
+	const __m128 t = _mm_load_ps(lanes.t);
+	const __m128 curve = _mm_load_ps(reinterpret_cast<const f32*>(lanes.curveLanes));
+	__m128 q[4];
+	for (u32 c = 0; c < 4; ++c) {
+		q[c] = _mm_add_ps(q0[c], _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(q1[c], flip), q0[c]), t));
+		q[c] = Select(curve, _mm_load_ps(lanes.curve[c]), q[c]);
+	}
+	NormalizeQuaternions(q);
+
+	const __m128 animated = _mm_load_ps(reinterpret_cast<const f32*>(lanes.animated));
+	for (u32 c = 0; c < 4; ++c) {
+		_mm_store_ps(inOut[c], Select(animated, q[c], _mm_load_ps(inOut[c])));
+	}
+}
+
+void Animation::SampleClip(const CompressedClip& clip, f32 time, std::span<TransformSoa> out)
+{
+	ENSURE(clip.constants.size() == out.size(), "SampleClip pose doesnt match the clip");
+
+	time = std::clamp(time, 0.0f, clip.duration);
+	const f32 frame = std::min(time * clip.sampleRate, static_cast<f32>(clip.frameCount - 1));
+
+	CompressedLanes lanes;
+	for (size_t p = 0; p < out.size(); ++p) {
+		out[p] = clip.constants[p];
+
+		const u32 animated = clip.animatedLanes[p];
+		if (animated == 0) {
+			continue;
+		}
+
+		const CompressedTrack* tracks = clip.tracks.data() + clip.firstTrack[p];
+		const u32 translationLanes = (animated >> (static_cast<u32>(Path::Translation) * PacketWidth)) & 0xF;
+		const u32 rotationLanes = (animated >> (static_cast<u32>(Path::Rotation) * PacketWidth)) & 0xF;
+		const u32 scaleLanes = (animated >> (static_cast<u32>(Path::Scale) * PacketWidth)) & 0xF;
+
+		if (translationLanes) {
+			tracks += GatherCompressedKeys(clip, tracks, translationLanes, time, frame, lanes);
+			DecodeVectors(lanes, out[p].translation);
+		}
+		if (rotationLanes) {
+			tracks += GatherCompressedKeys(clip, tracks, rotationLanes, time, frame, lanes);
+			DecodeRotations(lanes, out[p].rotation);
+		}
+		if (scaleLanes) {
+			tracks += GatherCompressedKeys(clip, tracks, scaleLanes, time, frame, lanes);
+			DecodeVectors(lanes, out[p].scale);
+		}
+	}
+}
+
+//
+// blending and model space
+//
+
+void Animation::BlendPoses(std::span<const BlendInput> inputs, std::span<TransformSoa> out)
+{
+	const BlendInput* reference = nullptr;
+	f32 totalWeight = 0.0f;
+	for (const BlendInput& input : inputs) {
+		ENSURE(input.pose.size() == out.size(), "BlendPoses inputs dont match the output");
+		if (input.weight > 0.0f) {
+			reference = reference ? reference : &input;
+			totalWeight += input.weight;
+		}
+	}
+	ENSURE(reference != nullptr, "BlendPoses needs a weight above 0");
+
+	const __m128 inverseWeight = _mm_set1_ps(1.0f / totalWeight);
+	const __m128 signBit = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(SignBit)));
+
+	for (size_t p = 0; p < out.size(); ++p) {
+		__m128 translation[3] = {};
+		__m128 rotation[4] = {};
+		__m128 scale[3] = {};
+
+		__m128 referenceRotation[4];
+		for (u32 c = 0; c < 4; ++c) {
+			referenceRotation[c] = _mm_load_ps(reference->pose[p].rotation[c]);
+		}
+
+		for (const BlendInput& input : inputs) {
+			if (input.weight <= 0.0f) {
+				continue;
+			}
+
+			const TransformSoa& pose = input.pose[p];
+			const __m128 weight = _mm_set1_ps(input.weight);
+			for (u32 c = 0; c < 3; ++c) {
+				translation[c] = _mm_add_ps(translation[c], _mm_mul_ps(weight, _mm_load_ps(pose.translation[c])));
+				scale[c] = _mm_add_ps(scale[c], _mm_mul_ps(weight, _mm_load_ps(pose.scale[c])));
+			}
+
+			__m128 q[4];
+			for (u32 c = 0; c < 4; ++c) {
+				q[c] = _mm_load_ps(pose.rotation[c]);
+			}
+			const __m128 signedWeight = _mm_xor_ps(weight, _mm_and_ps(_mm_cmplt_ps(Dot4(referenceRotation, q), _mm_setzero_ps()), signBit));
+			for (u32 c = 0; c < 4; ++c) {
+				rotation[c] = _mm_add_ps(rotation[c], _mm_mul_ps(signedWeight, q[c]));
+			}
+		}
+
+		NormalizeQuaternions(rotation);
+
+		TransformSoa& result = out[p];
+		for (u32 c = 0; c < 3; ++c) {
+			_mm_store_ps(result.translation[c], _mm_mul_ps(translation[c], inverseWeight));
+			_mm_store_ps(result.scale[c], _mm_mul_ps(scale[c], inverseWeight));
+		}
+		for (u32 c = 0; c < 4; ++c) {
+			_mm_store_ps(result.rotation[c], rotation[c]);
+		}
+	}
+}
+
+// row * m for a row vector and the 4 rows of m
+static inline __m128 MultiplyRow(__m128 row, const __m128 m[4])
+{
+	return _mm_add_ps(
+		_mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0)), m[0]), _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1)), m[1])),
+		_mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2)), m[2]), _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(3, 3, 3, 3)), m[3])));
+}
+
+void Animation::LocalToModel(const Skeleton& skeleton, std::span<const TransformSoa> pose, std::span<float4x4> out)
+{
+	const u32 jointCount = skeleton.JointCount();
+	ENSURE(pose.size() == PacketCount(jointCount) && out.size() == jointCount, "LocalToModel pose doesnt match the skeleton");
+
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	__m128 root[4];
+	for (u32 r = 0; r < 4; ++r) {
+		root[r] = _mm_loadu_ps(skeleton.rootTransform.m[r]);
+	}
+
+	for (u32 p = 0; p < pose.size(); ++p) {
+		const TransformSoa& local = pose[p];
+
+		// scale * rotation * translation of all 4 joints at once, the same as MathBatch::ComposeTransforms
+		const __m128 qx = _mm_load_ps(local.rotation[0]);
+		const __m128 qy = _mm_load_ps(local.rotation[1]);
+		const __m128 qz = _mm_load_ps(local.rotation[2]);
+		const __m128 qw = _mm_load_ps(local.rotation[3]);
+		const __m128 sx = _mm_load_ps(local.scale[0]);
+		const __m128 sy = _mm_load_ps(local.scale[1]);
+		const __m128 sz = _mm_load_ps(local.scale[2]);
+
+		const __m128 xx = _mm_mul_ps(qx, qx);
+		const __m128 yy = _mm_mul_ps(qy, qy);
+		const __m128 zz = _mm_mul_ps(qz, qz);
+		const __m128 xy = _mm_mul_ps(qx, qy);
+		const __m128 xz = _mm_mul_ps(qx, qz);
+		const __m128 yz = _mm_mul_ps(qy, qz);
+		const __m128 wx = _mm_mul_ps(qw, qx);
+		const __m128 wy = _mm_mul_ps(qw, qy);
+		const __m128 wz = _mm_mul_ps(qw, qz);
+
+		// row r of all 4 matrices, transposed into one row per joint
+		__m128 rows[4][4] = {
+			{
+				_mm_mul_ps(sx, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)))),
+				_mm_mul_ps(sx, _mm_mul_ps(two, _mm_add_ps(xy, wz))),
+				_mm_mul_ps(sx, _mm_mul_ps(two, _mm_sub_ps(xz, wy))),
+				zero,
+			},
+			{
+				_mm_mul_ps(sy, _mm_mul_ps(two, _mm_sub_ps(xy, wz))),
+				_mm_mul_ps(sy, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)))),
+				_mm_mul_ps(sy, _mm_mul_ps(two, _mm_add_ps(yz, wx))),
+				zero,
+			},
+			{
+				_mm_mul_ps(sz, _mm_mul_ps(two, _mm_add_ps(xz, wy))),
+				_mm_mul_ps(sz, _mm_mul_ps(two, _mm_sub_ps(yz, wx))),
+				_mm_mul_ps(sz, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)))),
+				zero,
+			},
+			{
+				_mm_load_ps(local.translation[0]),
+				_mm_load_ps(local.translation[1]),
+				_mm_load_ps(local.translation[2]),
+				one,
+			},
+		};
+		for (u32 r = 0; r < 4; ++r) {
+			_MM_TRANSPOSE4_PS(rows[r][0], rows[r][1], rows[r][2], rows[r][3]);
+		}
+
+		// parents come first, so even one in this packet is done by the time its children get here
+		const u32 laneCount = std::min(PacketWidth, jointCount - p * PacketWidth);
+		for (u32 lane = 0; lane < laneCount; ++lane) {
+			const u32 joint = p * PacketWidth + lane;
+			const i16 parent = skeleton.parents[joint];
+
+			__m128 parentRows[4];
+			if (parent < 0) {
+				std::copy_n(root, 4, parentRows);
+			} else {
+				for (u32 r = 0; r < 4; ++r) {
+					parentRows[r] = _mm_loadu_ps(out[parent].m[r]);
+				}
+			}
+
+			for (u32 r = 0; r < 4; ++r) {
+				_mm_storeu_ps(out[joint].m[r], MultiplyRow(rows[r][lane], parentRows));
+			}
+		}
+	}
+}
+
+static void SampleLayer(const Layer& layer, std::span<TransformSoa> out)
+{
+	if (layer.compressedClip) {
+		SampleClip(*layer.compressedClip, layer.time, out);
+	} else {
+		SampleClip(*layer.clip, layer.time, out);
+	}
+}
+
+void Animation::EvaluateInstances(const Skeleton& skeleton, std::span<const Instance> instances, std::span<float4x4> out)
+{
+	PROFILE_ZONE("Animation::EvaluateInstances");
+
+	const u32 jointCount = skeleton.JointCount();
+	const u32 packetCount = PacketCount(jointCount);
+	ENSURE(out.size() == instances.size() * jointCount, "EvaluateInstances output doesnt match the instances");
+
+	global::jobSystem->ParallelFor(static_cast<u32>(instances.size()), InstancesPerJob, [&](u32 begin, u32 end) {
+		PROFILE_ZONE("EvaluateInstances");
+
+		// a pose per layer and the blend of them, reused for every instance of the job
+		TrackedVector<TransformSoa, MemoryTag::Scratch> poses(static_cast<size_t>(MaxLayers + 1) * packetCount);
+		const std::span<TransformSoa> blended(poses.data() + static_cast<size_t>(MaxLayers) * packetCount, packetCount);
+
+		for (u32 i = begin; i < end; ++i) {
+			const Instance& instance = instances[i];
+			ENSURE(instance.layerCount > 0 && instance.layerCount <= MaxLayers, "an instance needs 1 to MaxLayers layers");
+
+			if (instance.layerCount == 1) {
+				SampleLayer(instance.layers[0], blended);
+			} else {
+				BlendInput inputs[MaxLayers];
+				for (u32 l = 0; l < instance.layerCount; ++l) {
+					const std::span<TransformSoa> layerPose(poses.data() + static_cast<size_t>(l) * packetCount, packetCount);
+					SampleLayer(instance.layers[l], layerPose);
+					inputs[l] = BlendInput{ .pose = layerPose, .weight = instance.layers[l].weight };
+				}
+				BlendPoses(std::span(inputs, instance.layerCount), blended);
+			}
+
+			LocalToModel(skeleton, blended, out.subspan(static_cast<size_t>(i) * jointCount, jointCount));
+		}
+	});
+}
+
+//
+// benchmark
+//
+
+static float4 AxisAngle(const float3& axis, f32 angle)
+{
+	const f32 s = std::sin(angle * 0.5f);
+	return float4(axis.x * s, axis.y * s, axis.z * s, std::cos(angle * 0.5f));
+}
+
+static float3 RandomAxis(std::mt19937& rng)
+{
+	std::uniform_real_distribution<f32> dist(-1.0f, 1.0f);
+	float3 axis;
+	f32 lengthSq = 0.0f;
+	do {
+		axis = float3(dist(rng), dist(rng), dist(rng));
+		lengthSq = axis.x * axis.x + axis.y * axis.y + axis.z * axis.z;
+	} while (lengthSq < 0.01f || lengthSq > 1.0f);
+	const f32 scale = 1.0f / std::sqrt(lengthSq);
+	return float3(axis.x * scale, axis.y * scale, axis.z * scale);
+}
+
+// a made up humanoid about 1.8 units tall, a spine, a head with a face, arms with five fingers and legs, the
+// chains are about as long as a real characters which is what the compression error depends on
+static void BuildBenchmarkSkeleton(std::mt19937& rng, Skeleton& out)
+{
+	std::uniform_real_distribution<f32> angle(-0.1f, 0.1f);
+
+	TrackedVector<i16, MemoryTag::Scratch> parents;
+	TrackedVector<float3, MemoryTag::Scratch> offsets;
+	auto add = [&](i16 parent, const float3& offset) {
+		parents.push_back(parent);
+		offsets.push_back(offset);
+		return static_cast<i16>(parents.size() - 1);
+	};
+
+	const i16 hips = add(-1, float3(0.0f, 1.0f, 0.0f));
+	i16 spine = hips;
+	for (u32 i = 0; i < 4; ++i) {
+		spine = add(spine, float3(0.0f, 0.12f, 0.0f));
+	}
+	const i16 head = add(add(spine, float3(0.0f, 0.1f, 0.0f)), float3(0.0f, 0.1f, 0.0f));
+	for (u32 i = 0; i < 6; ++i) {
+		add(head, float3(0.03f * (static_cast<f32>(i % 3) - 1.0f), 0.05f + 0.02f * (i / 3), 0.08f));
+	}
+
+	for (f32 side : { -1.0f, 1.0f }) {
+		const i16 clavicle = add(spine, float3(side * 0.05f, 0.06f, 0.0f));
+		const i16 hand = add(add(add(clavicle, float3(side * 0.15f, 0.0f, 0.0f)), float3(side * 0.3f, 0.0f, 0.0f)), float3(side * 0.26f, 0.0f, 0.0f));
+		for (u32 f = 0; f < 5; ++f) {
+			i16 finger = add(hand, float3(side * 0.08f, 0.0f, 0.04f - 0.02f * f));
+			for (u32 i = 0; i < 2; ++i) {
+				finger = add(finger, float3(side * 0.035f, 0.0f, 0.0f));
+			}
+		}
+
+		const i16 foot = add(add(add(hips, float3(side * 0.1f, -0.05f, 0.0f)), float3(0.0f, -0.45f, 0.0f)), float3(0.0f, -0.45f, 0.0f));
+		add(foot, float3(0.0f, -0.05f, 0.15f));
+	}
+
+	const u32 jointCount = static_cast<u32>(parents.size());
+	out.parents.assign(parents.begin(), parents.end());
+	out.inverseBindMatrices.assign(jointCount, out.rootTransform);
+	out.restPose.assign(PacketCount(jointCount), TransformSoa{});
+
+	for (u32 joint = 0; joint < PacketCount(jointCount) * PacketWidth; ++joint) {
+		float3 translation = float3(0.0f, 0.0f, 0.0f);
+		float4 rotation = float4(0.0f, 0.0f, 0.0f, 1.0f);
+		if (joint < jointCount) {
+			translation = offsets[joint];
+			rotation = AxisAngle(RandomAxis(rng), angle(rng));
+		}
+		SetTransform(out.restPose[joint / PacketWidth], joint % PacketWidth, translation, rotation, float3(1.0f, 1.0f, 1.0f));
+	}
+}
+
+// every joint swinging around its own axis, keyed at rate with the given interpolation, some joints
+// keep their rest pose and some linear keys get their sign flipped like exporters sometimes do
+// noise is radians of jitter on the moving joints, like motion capture that wasnt cleaned up, and baked
+// keys every path of every joint even where nothing moves, like exporters that sample the whole scene do
+static void BuildBenchmarkClip(const Skeleton& skeleton, const char* name, f32 duration, f32 rate, Interpolation interpolation, f32 noise, bool baked, std::mt19937& rng, Clip& out)
+{
+	const u32 jointCount = skeleton.JointCount();
+	const u32 keyCount = static_cast<u32>(duration * rate) + 1;
+	const bool cubic = interpolation == Interpolation::CubicSpline;
+	ENSURE(!(baked && cubic), "baked clips are linear or step");
+
+	out.name = name;
+	InitClip(skeleton, out);
+
+	TrackedVector<f32, MemoryTag::Scratch> times(keyCount);
+	for (u32 k = 0; k < keyCount; ++k) {
+		times[k] = k / rate;
+	}
+	const u32 timesOffset = AddKeyTimes(out, times);
+
+	std::uniform_real_distribution<f32> unit(0.0f, 1.0f);
+	std::uniform_real_distribution<f32> jitter(-noise, noise);
+	TrackedVector<f32, MemoryTag::Scratch> values;
+
+	for (u32 joint = 0; joint < jointCount; ++joint) {
+		const bool still = unit(rng) < 0.1f;
+		if (still && !baked) {
+			continue;
+		}
+
+		const float3 axis = RandomAxis(rng);
+		const f32 amplitude = still ? 0.0f : 0.05f + 0.5f * unit(rng);
+		const f32 phase = DirectX::XM_2PI * unit(rng);
+		const f32 frequency = DirectX::XM_2PI / duration * (1 + rng() % 2);
+
+		values.clear();
+		for (u32 k = 0; k < keyCount; ++k) {
+			const f32 angle = amplitude * std::sin(frequency * times[k] + phase) + (cubic || still ? 0.0f : jitter(rng));
+			float4 q = AxisAngle(axis, angle);
+			if (!cubic && unit(rng) < 0.2f) {
+				q = float4(-q.x, -q.y, -q.z, -q.w);
+			}
+			if (cubic) {
+				// d/dt of the quaternion, the same for in and out
+				const f32 speed = 0.5f * amplitude * frequency * std::cos(frequency * times[k] + phase);
+				const f32 c = std::cos(angle * 0.5f);
+				const f32 s = std::sin(angle * 0.5f);
+				const float4 tangent = float4(axis.x * c * speed, axis.y * c * speed, axis.z * c * speed, -s * speed);
+				values.insert(values.end(), { tangent.x, tangent.y, tangent.z, tangent.w, q.x, q.y, q.z, q.w, tangent.x, tangent.y, tangent.z, tangent.w });
+			} else {
+				values.insert(values.end(), { q.x, q.y, q.z, q.w });
+			}
+		}
+		SetTrack(out, joint, Path::Rotation, interpolation, timesOffset, keyCount, values);
+
+		// the root moves and a few joints stretch
+		const bool stretches = joint == 0 || unit(rng) < 0.15f;
+		if (stretches || baked) {
+			const TransformSoa& rest = skeleton.restPose[joint / PacketWidth];
+			const u32 lane = joint % PacketWidth;
+
+			values.clear();
+			for (u32 k = 0; k < keyCount; ++k) {
+				const f32 wave = stretches ? std::sin(frequency * times[k] + phase) : 0.0f;
+				const f32 translation[3] = { rest.translation[0][lane] + 0.05f * wave, rest.translation[1][lane] + 0.02f * wave, rest.translation[2][lane] };
+				if (cubic) {
+					const f32 slope = std::cos(frequency * times[k] + phase) * frequency;
+					const f32 tangent[3] = { 0.05f * slope, 0.02f * slope, 0.0f };
+					values.insert(values.end(), tangent, tangent + 3);
+					values.insert(values.end(), translation, translation + 3);
+					values.insert(values.end(), tangent, tangent + 3);
+				} else {
+					values.insert(values.end(), translation, translation + 3);
+				}
+			}
+			SetTrack(out, joint, Path::Translation, interpolation, timesOffset, keyCount, values);
+		}
+
+		if (baked) {
+			values.assign(static_cast<size_t>(keyCount) * 3, 1.0f);
+			SetTrack(out, joint, Path::Scale, interpolation, timesOffset, keyCount, values);
+		}
+	}
+}
+
+// glTF interpolation straight from the spec, a joint at a time
+static void SampleReference(const Clip& clip, const Track& track, u32 components, const f32* values, f32 time, f32* out)
+{
+	const f32* times = clip.times.data() + track.timesOffset;
+	const u32 lastKey = track.keyCount - 1;
+	const u32 stride = track.interpolation == Interpolation::CubicSpline ? 3 * components : components;
+	const u32 valueOffset = track.interpolation == Interpolation::CubicSpline ? components : 0;
+	values += static_cast<size_t>(track.valuesOffset) * components;
+
+	u32 key = 0;
+	while (key < lastKey && times[key + 1] <= time) {
+		++key;
+	}
+
+	if (key == lastKey || time <= times[0]) {
+		std::copy_n(values + key * stride + valueOffset, components, out);
+	} else {
+		const f32 interval = times[key + 1] - times[key];
+		const f32 t = (time - times[key]) / interval;
+		const f32* p0 = values + key * stride + valueOffset;
+		const f32* p1 = values + (key + 1) * stride + valueOffset;
+
+		switch (track.interpolation) {
+		case Interpolation::Step: {
+			std::copy_n(p0, components, out);
+		} break;
+		case Interpolation::Linear: {
+			f32 dot = 0.0f;
+			for (u32 c = 0; c < components; ++c) {
+				dot += p0[c] * p1[c];
+			}
+			const f32 sign = components == 4 && dot < 0.0f ? -1.0f : 1.0f;
+			for (u32 c = 0; c < components; ++c) {
+				out[c] = p0[c] + (sign * p1[c] - p0[c]) * t;
+			}
+		} break;
+		case Interpolation::CubicSpline: {
+			const f32* m0 = values + key * stride + 2 * components;
+			const f32* m1 = values + (key + 1) * stride;
+			const f32 t2 = t * t;
+			const f32 t3 = t2 * t;
+			for (u32 c = 0; c < components; ++c) {
+				out[c] = (2.0f * t3 - 3.0f * t2 + 1.0f) * p0[c] + (t3 - 2.0f * t2 + t) * interval * m0[c]
+					+ (-2.0f * t3 + 3.0f * t2) * p1[c] + (t3 - t2) * interval * m1[c];
+			}
+		} break;
+		}
+	}
+
+	if (components == 4) {
+		const f32 length = std::sqrt(out[0] * out[0] + out[1] * out[1] + out[2] * out[2] + out[3] * out[3]);
+		for (u32 c = 0; c < 4; ++c) {
+			out[c] /= length;
+		}
+	}
+}
+
+static void EvaluateReference(const Skeleton& skeleton, const Instance& instance, std::span<float4x4> out)
+{
+	const u32 jointCount = skeleton.JointCount();
+	for (u32 joint = 0; joint < jointCount; ++joint) {
+		f32 translation[3] = {};
+		f32 rotation[4] = {};
+		f32 scale[3] = {};
+		f32 totalWeight = 0.0f;
+		f32 firstRotation[4] = {};
+
+		for (u32 l = 0; l < instance.layerCount; ++l) {
+			const Layer& layer = instance.layers[l];
+			f32 t[3] = {};
+			f32 q[4] = {};
+			f32 s[3] = {};
+			SampleReference(*layer.clip, layer.clip->tracks[TrackIndex(joint, Path::Translation)], 3, &layer.clip->translations.data()->x, layer.time, t);
+			SampleReference(*layer.clip, layer.clip->tracks[TrackIndex(joint, Path::Rotation)], 4, &layer.clip->rotations.data()->x, layer.time, q);
+			SampleReference(*layer.clip, layer.clip->tracks[TrackIndex(joint, Path::Scale)], 3, &layer.clip->scales.data()->x, layer.time, s);
+
+			if (l == 0) {
+				std::copy_n(q, 4, firstRotation);
+			}
+			const f32 dot = q[0] * firstRotation[0] + q[1] * firstRotation[1] + q[2] * firstRotation[2] + q[3] * firstRotation[3];
+			const f32 sign = dot < 0.0f ? -1.0f : 1.0f;
+			for (u32 c = 0; c < 3; ++c) {
+				translation[c] += layer.weight * t[c];
+				scale[c] += layer.weight * s[c];
+			}
+			for (u32 c = 0; c < 4; ++c) {
+				rotation[c] += sign * layer.weight * q[c];
+			}
+			totalWeight += layer.weight;
+		}
+
+		const f32 length = std::sqrt(rotation[0] * rotation[0] + rotation[1] * rotation[1] + rotation[2] * rotation[2] + rotation[3] * rotation[3]);
+		const mat4 local = DirectX::XMMatrixAffineTransformation(
+			DirectX::XMVectorSet(scale[0] / totalWeight, scale[1] / totalWeight, scale[2] / totalWeight, 0.0f),
+			DirectX::XMVectorZero(),
+			DirectX::XMVectorSet(rotation[0] / length, rotation[1] / length, rotation[2] / length, rotation[3] / length),
+			DirectX::XMVectorSet(translation[0] / totalWeight, translation[1] / totalWeight, translation[2] / totalWeight, 1.0f));
+
+		const i16 parent = skeleton.parents[joint];
+		const float4x4& parentMatrix = parent < 0 ? skeleton.rootTransform : out[parent];
+		DirectX::XMStoreFloat4x4(&out[joint], local * DirectX::XMLoadFloat4x4(&parentMatrix));
+	}
+}
+
+static size_t MemoryUsage(const Clip& clip)
+{
+	return clip.tracks.size() * sizeof(Track) + clip.constants.size() * sizeof(TransformSoa) + clip.animatedPaths.size() * sizeof(u8)
+		+ clip.times.size() * sizeof(f32) + clip.translations.size() * sizeof(float3) + clip.rotations.size() * sizeof(float4) + clip.scales.size() * sizeof(float3);
+}
+
+static size_t MemoryUsage(const CompressedClip& clip)
+{
+	return clip.constants.size() * sizeof(TransformSoa) + clip.animatedLanes.size() * sizeof(u16) + clip.firstTrack.size() * sizeof(u32)
+		+ clip.tracks.size() * sizeof(CompressedTrack) + clip.keys.size() * sizeof(CompressedKey) + clip.times.size() * sizeof(f32);
+}
+
+// the furthest any joint or a point skinDistance along one of its axes is from where it should be
+static f32 PoseError(std::span<const float4x4> expected, std::span<const float4x4> actual, f32 skinDistance)
+{
+	f32 maxError = 0.0f;
+	for (size_t joint = 0; joint < expected.size(); ++joint) {
+		for (u32 axis = 0; axis < 4; ++axis) {
+			const f32 distance = axis < 3 ? skinDistance : 0.0f;
+			f32 errorSq = 0.0f;
+			for (u32 c = 0; c < 3; ++c) {
+				const f32 e = expected[joint].m[3][c] + distance * expected[joint].m[axis % 3][c];
+				const f32 a = actual[joint].m[3][c] + distance * actual[joint].m[axis % 3][c];
+				errorSq += (e - a) * (e - a);
+			}
+			maxError = std::max(maxError, std::sqrt(errorSq));
+		}
+	}
+	return maxError;
+}
+
+bool Animation::RunBenchmark()
+{
+	constexpr u32 instanceCount = 4096;
+	constexpr u32 frames = 20;
+	constexpr u32 checkedInstances = 256;
+	constexpr u32 sampledPoses = 20000;
+	constexpr f32 frameTime = 1.0f / 60.0f;
+
+	std::mt19937 rng(43);
+
+	Skeleton skeleton;
+	BuildBenchmarkSkeleton(rng, skeleton);
+	const u32 jointCount = skeleton.JointCount();
+	const u32 packetCount = PacketCount(jointCount);
+
+	Clip clips[4];
+	BuildBenchmarkClip(skeleton, "walk", 1.2f, 30.0f, Interpolation::Linear, 0.0f, false, rng, clips[0]);
+	BuildBenchmarkClip(skeleton, "idle", 2.5f, 10.0f, Interpolation::CubicSpline, 0.0f, false, rng, clips[1]);
+	BuildBenchmarkClip(skeleton, "gesture", 0.8f, 24.0f, Interpolation::Step, 0.0f, false, rng, clips[2]);
+	BuildBenchmarkClip(skeleton, "mocap", 4.0f, 60.0f, Interpolation::Linear, 0.004f, true, rng, clips[3]);
+
+	const CompressionSettings settings;
+	CompressedClip compressedClips[ARRLEN(clips)];
+	spdlog::stopwatch cookTime;
+	for (u32 c = 0; c < ARRLEN(clips); ++c) {
+		CompressClip(skeleton, clips[c], settings, compressedClips[c]);
+	}
+	const f64 cookMs = cookTime.elapsed().count() * 1000.0;
+
+	spdlog::info("animation benchmark, {} threads, {} characters of {} joints, {} frames", global::jobSystem->GetThreadCount(), instanceCount, jointCount, frames);
+
+	std::uniform_real_distribution<f32> unit(0.0f, 1.0f);
+	TrackedVector<f32, MemoryTag::Scratch> startTimes(instanceCount * MaxLayers);
+	for (f32& time : startTimes) {
+		time = unit(rng) * 10.0f;
+	}
+
+	TrackedVector<Instance, MemoryTag::Scratch> instances(instanceCount);
+	TrackedVector<float4x4, MemoryTag::Scratch> matrices(static_cast<size_t>(instanceCount) * jointCount);
+	TrackedVector<float4x4, MemoryTag::Scratch> expected(jointCount);
+	bool passed = true;
+
+	auto setup = [&](u32 layerCount, u32 frame, bool compressed) {
+		for (u32 i = 0; i < instanceCount; ++i) {
+			Instance& instance = instances[i];
+			instance.layerCount = layerCount;
+			for (u32 l = 0; l < layerCount; ++l) {
+				const u32 c = (i + l) % ARRLEN(clips);
+				const f32 time = startTimes[i * MaxLayers + l] + frame * frameTime;
+				instance.layers[l] = Layer{
+					.clip = &clips[c],
+					.compressedClip = compressed ? &compressedClips[c] : nullptr,
+					.time = std::fmod(time, clips[c].duration),
+					.weight = 1.0f / (l + 1),
+				};
+			}
+		}
+	};
+
+	for (bool compressed : { false, true }) {
+		for (u32 layerCount : { 1u, 3u }) {
+			f64 totalMs = 0.0;
+			f64 bestMs = std::numeric_limits<f64>::max();
+			for (u32 frame = 0; frame < frames; ++frame) {
+				setup(layerCount, frame, compressed);
+				spdlog::stopwatch sw;
+				EvaluateInstances(skeleton, instances, matrices);
+				const f64 ms = sw.elapsed().count() * 1000.0;
+				totalMs += ms;
+				bestMs = std::min(bestMs, ms);
+			}
+			const f64 averageMs = totalMs / frames;
+
+			if (compressed) {
+				spdlog::info("{} layer{}, compressed: {:.3f} ms per frame (best {:.3f}), {:.0f} joints per ms, {:.2f} us per character",
+					layerCount, layerCount == 1 ? "" : "s", averageMs, bestMs, static_cast<f64>(instanceCount) * jointCount / averageMs, averageMs * 1000.0 / instanceCount);
+				continue;
+			}
+
+			// the last frame against the reference, errors relative to how far the joint is from the root
+			f32 maxError = 0.0f;
+			for (u32 i = 0; i < checkedInstances; ++i) {
+				EvaluateReference(skeleton, instances[i], expected);
+				for (u32 joint = 0; joint < jointCount; ++joint) {
+					const float4x4& actual = matrices[static_cast<size_t>(i) * jointCount + joint];
+					for (u32 r = 0; r < 4; ++r) {
+						for (u32 c = 0; c < 4; ++c) {
+							maxError = std::max(maxError, std::abs(actual.m[r][c] - expected[joint].m[r][c]) / (1.0f + std::abs(expected[joint].m[r][c])));
+						}
+					}
+				}
+			}
+
+			spdlog::info("{} layer{}: {:.3f} ms per frame (best {:.3f}), {:.0f} joints per ms, {:.2f} us per character, max error {:.2e}, {}",
+				layerCount, layerCount == 1 ? "" : "s", averageMs, bestMs, static_cast<f64>(instanceCount) * jointCount / averageMs,
+				averageMs * 1000.0 / instanceCount, maxError, maxError < 1e-4f ? "matches" : "MISMATCH");
+			passed &= maxError < 1e-4f;
+		}
+	}
+
+	// compression, the error is measured at the frames the clip was compressed at and half way between them
+	// where the resampling adds its own, both have to stay in the tolerance and no clip may end up with more
+	// keys than the source has values
+	spdlog::info("compression, tolerance {:.3f} mm, {} frames per second, cooked in {:.1f} ms", settings.tolerance * 1000.0f, settings.sampleRate, cookMs);
+
+	TrackedVector<TransformSoa, MemoryTag::Scratch> sourcePose(packetCount);
+	TrackedVector<TransformSoa, MemoryTag::Scratch> compressedPose(packetCount);
+	TrackedVector<float4x4, MemoryTag::Scratch> compressedModel(jointCount);
+
+	size_t sourceBytes = 0;
+	size_t compressedBytes = 0;
+	bool withinTolerance = true;
+	for (u32 c = 0; c < ARRLEN(clips); ++c) {
+		const Clip& clip = clips[c];
+		const CompressedClip& compressedClip = compressedClips[c];
+
+		f32 frameError = 0.0f;
+		f32 betweenError = 0.0f;
+		for (u32 half = 0; half < compressedClip.frameCount * 2 - 1; ++half) {
+			const f32 time = std::min(half * 0.5f / compressedClip.sampleRate, clip.duration);
+			SampleClip(clip, time, sourcePose);
+			SampleClip(compressedClip, time, compressedPose);
+			LocalToModel(skeleton, sourcePose, expected);
+			LocalToModel(skeleton, compressedPose, compressedModel);
+
+			f32& error = half % 2 == 0 ? frameError : betweenError;
+			error = std::max(error, PoseError(expected, compressedModel, settings.skinDistance));
+		}
+		const size_t sourceKeys = clip.translations.size() + clip.rotations.size() + clip.scales.size();
+		withinTolerance = withinTolerance && frameError <= settings.tolerance * 1.01f && betweenError <= settings.tolerance * 1.01f;
+		withinTolerance = withinTolerance && compressedClip.keys.size() <= sourceKeys;
+
+		sourceBytes += MemoryUsage(clip);
+		compressedBytes += MemoryUsage(compressedClip);
+		spdlog::info("{}: {} keys in {} bytes to {} keys of {} tracks in {} bytes, {:.1f}x smaller, max error {:.3f} mm at the frames and {:.3f} mm between",
+			clip.name, sourceKeys, MemoryUsage(clip), compressedClip.keys.size(), compressedClip.tracks.size(), MemoryUsage(compressedClip),
+			static_cast<f64>(MemoryUsage(clip)) / MemoryUsage(compressedClip), frameError * 1000.0f, betweenError * 1000.0f);
+	}
+
+	// one pose at a time on this thread, no blending or model space
+	TrackedVector<f32, MemoryTag::Scratch> sampleTimes(sampledPoses);
+	for (f32& time : sampleTimes) {
+		time = unit(rng);
+	}
+	f64 sampleMs[2] = {};
+	for (bool compressed : { false, true }) {
+		spdlog::stopwatch sw;
+		for (u32 i = 0; i < sampledPoses; ++i) {
+			const u32 c = i % ARRLEN(clips);
+			const f32 time = sampleTimes[i] * clips[c].duration;
+			if (compressed) {
+				SampleClip(compressedClips[c], time, compressedPose);
+			} else {
+				SampleClip(clips[c], time, sourcePose);
+			}
+		}
+		sampleMs[compressed ? 1 : 0] = sw.elapsed().count() * 1000.0;
+	}
+
+	spdlog::info("{} bytes to {} bytes, {:.1f}x smaller, sampling {:.0f} joints per ms from the source clips and {:.0f} from the compressed ones, {}",
+		sourceBytes, compressedBytes, static_cast<f64>(sourceBytes) / compressedBytes,
+		static_cast<f64>(sampledPoses) * jointCount / sampleMs[0], static_cast<f64>(sampledPoses) * jointCount / sampleMs[1],
+		withinTolerance ? "within tolerance" : "ABOVE TOLERANCE");
+	passed &= withinTolerance;
+
+	spdlog::info("animation checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "Math.hpp"
+#include "Core/MemoryTracker.hpp"
+
+#include <span>
+#include <string>
+
+// skeletal animation, glTF skins and animation channels (imported by MeshAsset::Load) are sampled into
+// local poses, blended and turned into model space joint matrices
+//
+// poses are structure of arrays over packets of 4 joints, one sse register per component, so sampling and
+// blending interpolate 4 joints per instruction and only finding the keys is done a joint at a time
+// matrices are row vector like the rest of the engine, p' = p * m
+namespace Animation
+{
+	template<typename T>
+	using Data = TrackedVector<T, MemoryTag::AssetsAnimation>;
+
+	constexpr u32 PacketWidth = 4;
+
+	inline u32 PacketCount(u32 jointCount) { return (jointCount + PacketWidth - 1) / PacketWidth; }
+
+	// local transforms of PacketWidth joints, lane i of every array is joint i of the packet
+	struct alignas(16) TransformSoa {
+		f32 translation[3][PacketWidth];
+		// unit quaternions, x y z w
+		f32 rotation[4][PacketWidth];
+		f32 scale[3][PacketWidth];
+	};
+
+	// sets one joint of a packet, for filling poses a joint at a time
+	void SetTransform(TransformSoa& packet, u32 lane, const float3& translation, const float4& rotation, const float3& scale);
+
+	// JOINTS_0 of a vertex, indices into the skeleton, not the glTF skin, theyre remapped on import
+	struct JointIndices {
+		u16 index[4];
+	};
+
+	struct Skeleton {
+		// parents come before their children, -1 for roots
+		Data<i16> parents;
+		// model space to joint space in the bind pose, what skinning multiplies the model space joints with
+		Data<float4x4> inverseBindMatrices;
+		// the node transforms from the file, joints without a track in a clip stay at these
+		// padding lanes of the last packet are identity
+		Data<TransformSoa> restPose;
+		// the nodes above the roots, applied to every root
+		float4x4 rootTransform = float4x4(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+
+		inline u32 JointCount() const { return static_cast<u32>(parents.size()); }
+	};
+
+	// same order as cgltf_interpolation_type
+	enum class Interpolation : u8 {
+		Linear,
+		Step,
+		CubicSpline,
+	};
+
+	enum class Path : u8 {
+		Translation,
+		Rotation,
+		Scale,
+
+		Count
+	};
+
+	struct Track {
+		u32 timesOffset;
+		u32 keyCount;
+		// into the clips translations, rotations or scales depending on the path, a cubic spline key
+		// is 3 values (in tangent, value, out tangent) like in glTF
+		u32 valuesOffset;
+		Interpolation interpolation;
+	};
+
+	struct Clip {
+		std::string name;
+		// the last key of any track, in seconds
+		f32 duration = 0.0f;
+
+		// a translation, rotation and scale track for every joint, grouped by packet and then by path so the
+		// 4 tracks that fill one register sit next to each other, see TrackIndex
+		Data<Track> tracks;
+
+		// the value of every track with a single key, laid out like a pose, packets where every track of a
+		// path has one key are copied from here instead of sampled, which is most translations and scales
+		Data<TransformSoa> constants;
+		// a bit per path for each packet, set when some track of that path has more than one key
+		Data<u8> animatedPaths;
+
+		// key times of every track, tracks from the same glTF sampler input share them
+		Data<f32> times;
+		Data<float3> translations;
+		Data<float4> rotations;
+		Data<float3> scales;
+	};
+
+	inline u32 TrackIndex(u32 joint, Path path)
+	{
+		return ((joint / PacketWidth) * static_cast<u32>(Path::Count) + static_cast<u32>(path)) * PacketWidth + joint % PacketWidth;
+	}
+
+	// a clip that holds every joint at its rest pose, SetTrack then replaces tracks one by one
+	void InitClip(const Skeleton& skeleton, Clip& outClip);
+
+	// returns the offset to give SetTrack, times have to be increasing
+	u32 AddKeyTimes(Clip& clip, std::span<const f32> times);
+
+	// values has 3 floats per key for translations and scales, 4 for rotations, and 3 times as many for cubic splines
+	void SetTrack(Clip& clip, u32 joint, Path path, Interpolation interpolation, u32 timesOffset, u32 keyCount, std::span<const f32> values);
+
+	// the local pose at time, clamped to the first and last key of each track, wrap time to the duration to loop
+	// linear rotations are normalized lerps (nlerp) the short way round instead of slerps, close enough at
+	// the rate clips are keyed at
+	// out has PacketCount(jointCount) packets
+	void SampleClip(const Clip& clip, f32 time, std::span<TransformSoa> out);
+
+	struct BlendInput {
+		std::span<const TransformSoa> pose;
+		f32 weight;
+	};
+
+	// weighted average of the poses, the weights dont have to add up to 1 but one has to be above 0
+	// rotations are flipped to the side of the first pose before adding and normalized after
+	void BlendPoses(std::span<const BlendInput> inputs, std::span<TransformSoa> out);
+
+	// the model space matrix of every joint, out has jointCount entries
+	void LocalToModel(const Skeleton& skeleton, std::span<const TransformSoa> pose, std::span<float4x4> out);
+
+	// AnimationCompression.hpp
+	struct CompressedClip;
+
+	constexpr u32 MaxLayers = 4;
+
+	struct Layer {
+		// one of the two, compressedClip when it is set
+		const Clip* clip;
+		const CompressedClip* compressedClip;
+		f32 time;
+		f32 weight;
+	};
+
+	// one animated character, its layers are blended by weight
+	struct Instance {
+		Layer layers[MaxLayers];
+		u32 layerCount;
+	};
+
+	// samples, blends and builds the model space matrices of every instance, split over the job system
+	// every clip has to be made for skeleton, out is jointCount matrices per instance one after the other
+	void EvaluateInstances(const Skeleton& skeleton, std::span<const Instance> instances, std::span<float4x4> out);
+
+	// thousands of characters on a made up skeleton against a plain scalar evaluation, reports joints per ms
+	// then compresses the clips and reports how much smaller they got, the error and how fast they sample
+	bool RunBenchmark();
+}
@@ -0,0 +1,471 @@
+#include "AnimationCompression.hpp"
+
+#include "Core/Profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// the animation cooker, Animation::SampleClip for compressed clips is next to the other one in Animation.cpp
+//
+// the source clip is sampled into a pose for every frame and each track is cut down on its own, a greedy
+// pass keeps extending the segment from the last kept key for as long as interpolating its quantized end
+// keys lands every frame in between within the joints error budget
+// errors are distances, a rotation moves the furthest point below the joint by 2 * reach * sin(angle / 2)
+// and a scale by reach times the change, and along a chain they add up, so each joint gets the tolerance
+// divided by the number of joints on the longest chain through it
+// step tracks, and tracks the frames would need more keys for than the source has values, keep the source
+// keys at the source times instead, cubic splines as bezier curves
+
+using namespace Animation;
+
+static constexpr u32 PathCount = static_cast<u32>(Path::Count);
+
+// the components other than the largest are never further from 0 than this, 1/sqrt2
+static constexpr f32 s_smallestThreeRange = 0.70710678f;
+
+static float4 ReadLane(const TransformSoa& packet, Path path, u32 lane)
+{
+	switch (path) {
+	case Path::Translation: return float4(packet.translation[0][lane], packet.translation[1][lane], packet.translation[2][lane], 0.0f);
+	case Path::Rotation: return float4(packet.rotation[0][lane], packet.rotation[1][lane], packet.rotation[2][lane], packet.rotation[3][lane]);
+	case Path::Scale: return float4(packet.scale[0][lane], packet.scale[1][lane], packet.scale[2][lane], 0.0f);
+	case Path::Count: break;
+	}
+	UNREACHABLE("");
+	return float4(0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+static u16 Quantize(f32 value)
+{
+	return static_cast<u16>(std::clamp(std::round(value * 65535.0f), 0.0f, 65535.0f));
+}
+
+static void QuantizeVector(const CompressedTrack& track, const float4& value, CompressedKey& key)
+{
+	const f32* v = &value.x;
+	const f32* min = &track.min.x;
+	const f32* extent = &track.extent.x;
+	for (u32 c = 0; c < 3; ++c) {
+		key.values[c] = extent[c] > 0.0f ? Quantize((v[c] - min[c]) / extent[c]) : 0;
+	}
+	key.frameAndLargest = 0;
+}
+
+// the same math as DecodeVectors so the cooker measures the error the runtime will have
+static float4 DequantizeVector(const CompressedTrack& track, const CompressedKey& key)
+{
+	const f32* min = &track.min.x;
+	const f32* extent = &track.extent.x;
+	f32 v[3];
+	for (u32 c = 0; c < 3; ++c) {
+		v[c] = min[c] + static_cast<f32>(key.values[c]) * (extent[c] * (1.0f / 65535.0f));
+	}
+	return float4(v[0], v[1], v[2], 0.0f);
+}
+
+static void QuantizeRotation(const float4& rotation, CompressedKey& key)
+{
+	f32 q[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+	const f32 length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+
+	u32 largest = 0;
+	for (u32 c = 1; c < 4; ++c) {
+		if (std::abs(q[c]) > std::abs(q[largest])) {
+			largest = c;
+		}
+	}
+	// q and -q are the same rotation, the left out component has to be positive to come back from the length
+	const f32 scale = (q[largest] < 0.0f ? -1.0f : 1.0f) / length;
+
+	for (u32 c = 0, i = 0; c < 4; ++c) {
+		if (c != largest) {
+			key.values[i++] = Quantize((q[c] * scale + s_smallestThreeRange) / (2.0f * s_smallestThreeRange));
+		}
+	}
+	key.frameAndLargest = static_cast<u16>(largest << 14);
+}
+
+// the same math as DecodeSmallestThree
+static float4 DequantizeRotation(const CompressedKey& key)
+{
+	f32 a[3];
+	for (u32 c = 0; c < 3; ++c) {
+		a[c] = static_cast<f32>(key.values[c]) * (2.0f * s_smallestThreeRange / 65535.0f) - s_smallestThreeRange;
+	}
+	const f32 d = std::sqrt(std::max(1.0f - (a[0] * a[0] + a[1] * a[1] + a[2] * a[2]), 0.0f));
+
+	f32 q[4];
+	for (u32 c = 0, i = 0; c < 4; ++c) {
+		q[c] = c == key.Largest() ? d : a[i++];
+	}
+	return float4(q[0], q[1], q[2], q[3]);
+}
+
+static float4 Interpolate(Path path, const float4& a, const float4& b, f32 t)
+{
+	if (path != Path::Rotation) {
+		return float4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, 0.0f);
+	}
+
+	// an nlerp the short way round like DecodeRotations
+	const f32 sign = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w < 0.0f ? -1.0f : 1.0f;
+	const f32 q[4] = {
+		a.x + (sign * b.x - a.x) * t,
+		a.y + (sign * b.y - a.y) * t,
+		a.z + (sign * b.z - a.z) * t,
+		a.w + (sign * b.w - a.w) * t,
+	};
+	const f32 length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+	return float4(q[0] / length, q[1] / length, q[2] / length, q[3] / length);
+}
+
+// how far a point reach away from the joint moves between the two values
+static f32 Error(Path path, const float4& a, const float4& b, f32 reach)
+{
+	switch (path) {
+	case Path::Translation: {
+		const f32 dx = a.x - b.x;
+		const f32 dy = a.y - b.y;
+		const f32 dz = a.z - b.z;
+		return std::sqrt(dx * dx + dy * dy + dz * dz);
+	}
+	case Path::Rotation: {
+		// the chord between the quaternions is 2 * sin(angle / 4), going through the dot instead loses
+		// everything below a few tenths of a mm to float precision
+		const f32 sign = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w < 0.0f ? -1.0f : 1.0f;
+		const f32 dx = a.x - sign * b.x;
+		const f32 dy = a.y - sign * b.y;
+		const f32 dz = a.z - sign * b.z;
+		const f32 dw = a.w - sign * b.w;
+		const f32 chordSq = dx * dx + dy * dy + dz * dz + dw * dw;
+		// sin(angle / 2) = 2 * sin(angle / 4) * cos(angle / 4)
+		return 2.0f * reach * std::sqrt(chordSq * std::max(1.0f - chordSq * 0.25f, 0.0f));
+	}
+	case Path::Scale: {
+		return reach * std::max({ std::abs(a.x - b.x), std::abs(a.y - b.y), std::abs(a.z - b.z) });
+	}
+	case Path::Count: break;
+	}
+	UNREACHABLE("");
+	return 0.0f;
+}
+
+// a value of a source track, a key or one of the tangents of a cubic spline key
+static float4 SourceValue(const Clip& clip, Path path, u32 index)
+{
+	switch (path) {
+	case Path::Translation: return float4(clip.translations[index].x, clip.translations[index].y, clip.translations[index].z, 0.0f);
+	case Path::Rotation: return clip.rotations[index];
+	case Path::Scale: return float4(clip.scales[index].x, clip.scales[index].y, clip.scales[index].z, 0.0f);
+	case Path::Count: break;
+	}
+	UNREACHABLE("");
+	return float4(0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+// the source keys, cubic splines as the value at every key and the bezier control points between them,
+// a hermite segment from p0 to p1 over h seconds is the bezier p0, p0 + m0 * h / 3, p1 - m1 * h / 3, p1
+static void SourceKeys(const Clip& clip, const Track& track, Path path, std::span<float4> out)
+{
+	if (track.interpolation != Interpolation::CubicSpline) {
+		for (u32 k = 0; k < track.keyCount; ++k) {
+			out[k] = SourceValue(clip, path, track.valuesOffset + k);
+		}
+		return;
+	}
+
+	const f32* times = clip.times.data() + track.timesOffset;
+	for (u32 k = 0; k < track.keyCount; ++k) {
+		out[k * 3] = SourceValue(clip, path, track.valuesOffset + k * 3 + 1);
+		if (k + 1 == track.keyCount) {
+			break;
+		}
+
+		const f32 third = (times[k + 1] - times[k]) / 3.0f;
+		const float4 p0 = SourceValue(clip, path, track.valuesOffset + k * 3 + 1);
+		const float4 m0 = SourceValue(clip, path, track.valuesOffset + k * 3 + 2);
+		const float4 p1 = SourceValue(clip, path, track.valuesOffset + k * 3 + 4);
+		const float4 m1 = SourceValue(clip, path, track.valuesOffset + k * 3 + 3);
+		out[k * 3 + 1] = float4(p0.x + m0.x * third, p0.y + m0.y * third, p0.z + m0.z * third, p0.w + m0.w * third);
+		out[k * 3 + 2] = float4(p1.x - m1.x * third, p1.y - m1.y * third, p1.z - m1.z * third, p1.w - m1.w * third);
+	}
+}
+
+// curves keep all 4 components, the 4th where the frame and largest index would be
+static u16& CurveComponent(CompressedKey& key, u32 c)
+{
+	return c < 3 ? key.values[c] : key.frameAndLargest;
+}
+
+static void QuantizeCurve(std::span<const float4> values, CompressedTrack& track, std::span<CompressedKey> quantized, std::span<float4> dequantized)
+{
+	f32* min = &track.min.x;
+	f32* extent = &track.extent.x;
+	for (u32 c = 0; c < 4; ++c) {
+		f32 max = (&values[0].x)[c];
+		min[c] = max;
+		for (const float4& value : values) {
+			min[c] = std::min(min[c], (&value.x)[c]);
+			max = std::max(max, (&value.x)[c]);
+		}
+		extent[c] = max - min[c];
+	}
+
+	for (size_t k = 0; k < values.size(); ++k) {
+		f32* v = &dequantized[k].x;
+		for (u32 c = 0; c < 4; ++c) {
+			CurveComponent(quantized[k], c) = extent[c] > 0.0f ? Quantize(((&values[k].x)[c] - min[c]) / extent[c]) : 0;
+			v[c] = min[c] + static_cast<f32>(CurveComponent(quantized[k], c)) * (extent[c] * (1.0f / 65535.0f));
+		}
+	}
+}
+
+// translations and scales get the range of values, then every value goes through the quantization and back
+static void QuantizeKeys(Path path, std::span<const float4> values, CompressedTrack& track, std::span<CompressedKey> quantized, std::span<float4> dequantized)
+{
+	if (path == Path::Rotation) {
+		for (size_t k = 0; k < values.size(); ++k) {
+			QuantizeRotation(values[k], quantized[k]);
+			dequantized[k] = DequantizeRotation(quantized[k]);
+		}
+		return;
+	}
+
+	float4 max = float4(values[0].x, values[0].y, values[0].z, 0.0f);
+	track.min = max;
+	for (size_t k = 1; k < values.size(); ++k) {
+		track.min = float4(std::min(track.min.x, values[k].x), std::min(track.min.y, values[k].y), std::min(track.min.z, values[k].z), 0.0f);
+		max = float4(std::max(max.x, values[k].x), std::max(max.y, values[k].y), std::max(max.z, values[k].z), 0.0f);
+	}
+	track.extent = float4(max.x - track.min.x, max.y - track.min.y, max.z - track.min.z, 0.0f);
+
+	for (size_t k = 0; k < values.size(); ++k) {
+		QuantizeVector(track, values[k], quantized[k]);
+		dequantized[k] = DequantizeVector(track, quantized[k]);
+	}
+}
+
+// the same search and blend as GatherCompressedKeys for linear tracks and curves with times of their own
+static float4 SampleKeys(Path path, bool curve, std::span<const f32> times, std::span<const float4> values, f32 time)
+{
+	u32 key = 0;
+	for (u32 count = static_cast<u32>(times.size()) - 1; count > 1;) {
+		const u32 half = count / 2;
+		key = times[key + half] <= time ? key + half : key;
+		count -= half;
+	}
+	const f32 t = std::clamp((time - times[key]) / (times[key + 1] - times[key]), 0.0f, 1.0f);
+	if (!curve) {
+		return Interpolate(path, values[key], values[key + 1], t);
+	}
+
+	const f32 s = 1.0f - t;
+	const f32 weights[4] = { s * s * s, 3.0f * s * s * t, 3.0f * s * t * t, t * t * t };
+	f32 v[4] = {};
+	for (u32 i = 0; i < 4; ++i) {
+		const f32* point = &values[key * 3 + i].x;
+		for (u32 c = 0; c < 4; ++c) {
+			v[c] += weights[i] * point[c];
+		}
+	}
+	if (path != Path::Rotation) {
+		return float4(v[0], v[1], v[2], 0.0f);
+	}
+	const f32 length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2] + v[3] * v[3]);
+	return float4(v[0] / length, v[1] / length, v[2] / length, v[3] / length);
+}
+
+void Animation::CompressClip(const Skeleton& skeleton, const Clip& clip, const CompressionSettings& settings, CompressedClip& out)
+{
+	PROFILE_ZONE("Animation::CompressClip");
+
+	const u32 jointCount = skeleton.JointCount();
+	const u32 packetCount = PacketCount(jointCount);
+	ENSURE(clip.tracks.size() == static_cast<size_t>(packetCount) * PacketWidth * PathCount, "CompressClip clip doesnt match the skeleton");
+	ENSURE(settings.sampleRate > 0.0f && settings.tolerance > 0.0f, "CompressClip needs a sample rate and a tolerance above 0");
+
+	// whole frames from the start to the end, the rate goes up a little so the last one lands on the duration
+	// and very long clips get fewer frames a second to fit in the 14 bits of a key
+	const u32 frameCount = std::min(static_cast<u32>(std::max(std::ceil(clip.duration * settings.sampleRate - 1e-3f), 0.0f)) + 1, MaxCompressedFrames);
+
+	out.name = clip.name;
+	out.duration = clip.duration;
+	out.frameCount = frameCount;
+	out.sampleRate = frameCount > 1 ? (frameCount - 1) / clip.duration : settings.sampleRate;
+
+	TrackedVector<TransformSoa, MemoryTag::Scratch> poses(static_cast<size_t>(frameCount) * packetCount);
+	for (u32 f = 0; f < frameCount; ++f) {
+		SampleClip(clip, std::min(f / out.sampleRate, clip.duration), std::span(poses.data() + static_cast<size_t>(f) * packetCount, packetCount));
+	}
+
+	// how far the mesh reaches below each joint and the most joints on a chain through it, from the rest pose
+	// so clips that stretch bones a lot get a little less accurate than asked for
+	TrackedVector<float4x4, MemoryTag::Scratch> model(jointCount);
+	LocalToModel(skeleton, skeleton.restPose, model);
+
+	TrackedVector<f32, MemoryTag::Scratch> reach(jointCount, settings.skinDistance);
+	TrackedVector<u32, MemoryTag::Scratch> depth(jointCount);
+	TrackedVector<u32, MemoryTag::Scratch> height(jointCount, 1);
+	for (u32 joint = 0; joint < jointCount; ++joint) {
+		const i16 parent = skeleton.parents[joint];
+		depth[joint] = parent < 0 ? 1 : depth[parent] + 1;
+	}
+	for (u32 joint = jointCount; joint-- > 0;) {
+		const i16 parent = skeleton.parents[joint];
+		if (parent < 0) {
+			continue;
+		}
+		const f32 dx = model[joint].m[3][0] - model[parent].m[3][0];
+		const f32 dy = model[joint].m[3][1] - model[parent].m[3][1];
+		const f32 dz = model[joint].m[3][2] - model[parent].m[3][2];
+		reach[parent] = std::max(reach[parent], reach[joint] + std::sqrt(dx * dx + dy * dy + dz * dz));
+		height[parent] = std::max(height[parent], height[joint] + 1);
+	}
+
+	// frame 0 for every track, the ones that stay close enough to it are done with this
+	out.constants.assign(poses.begin(), poses.begin() + packetCount);
+	out.animatedLanes.assign(packetCount, 0);
+	out.firstTrack.resize(packetCount);
+	out.tracks.clear();
+	out.keys.clear();
+	out.times.clear();
+
+	// where the times of a source track went, tracks of the same sampler share them here too
+	struct SharedTimes {
+		u32 sourceOffset;
+		u32 keyCount;
+		u32 offset;
+	};
+	TrackedVector<SharedTimes, MemoryTag::Scratch> sharedTimes;
+
+	TrackedVector<float4, MemoryTag::Scratch> samples(frameCount);
+	TrackedVector<float4, MemoryTag::Scratch> dequantized(frameCount);
+	TrackedVector<CompressedKey, MemoryTag::Scratch> quantized(frameCount);
+	TrackedVector<float4, MemoryTag::Scratch> sourceValues;
+	TrackedVector<float4, MemoryTag::Scratch> sourceDequantized;
+	TrackedVector<CompressedKey, MemoryTag::Scratch> sourceQuantized;
+
+	for (u32 p = 0; p < packetCount; ++p) {
+		out.firstTrack[p] = static_cast<u32>(out.tracks.size());
+
+		for (u32 pathIndex = 0; pathIndex < PathCount; ++pathIndex) {
+			const Path path = static_cast<Path>(pathIndex);
+
+			for (u32 lane = 0; lane < PacketWidth && p * PacketWidth + lane < jointCount; ++lane) {
+				const u32 joint = p * PacketWidth + lane;
+				const Track& source = clip.tracks[TrackIndex(joint, path)];
+				if (source.keyCount <= 1) {
+					continue;
+				}
+
+				// the paths of a joint move the same points so they share its budget too
+				u32 animatedPaths = 0;
+				for (u32 other = 0; other < PathCount; ++other) {
+					animatedPaths += clip.tracks[TrackIndex(joint, static_cast<Path>(other))].keyCount > 1 ? 1 : 0;
+				}
+				const f32 budget = settings.tolerance / static_cast<f32>((depth[joint] + height[joint] - 1) * animatedPaths);
+
+				bool moves = false;
+				for (u32 f = 0; f < frameCount; ++f) {
+					samples[f] = ReadLane(poses[static_cast<size_t>(f) * packetCount + p], path, lane);
+					moves = moves || Error(path, samples[f], samples[0], reach[joint]) > budget;
+				}
+				if (!moves) {
+					continue;
+				}
+
+				// keyCount once the keys are picked
+				CompressedTrack track = {
+					.keyOffset = static_cast<u32>(out.keys.size()),
+					.keyCount = 0,
+					.timesOffset = KeysOnFrames,
+					.min = float4(0.0f, 0.0f, 0.0f, 0.0f),
+					.extent = float4(0.0f, 0.0f, 0.0f, 0.0f),
+					.step = source.interpolation == Interpolation::Step,
+					.curve = false,
+				};
+
+				// step keys switch between frames, so they stay where the source has them
+				if (!track.step) {
+					QuantizeKeys(path, samples, track, quantized, dequantized);
+
+					// whether keys at a and b get every frame between them close enough
+					auto fits = [&](u32 a, u32 b) {
+						for (u32 f = a + 1; f < b; ++f) {
+							const float4 value = Interpolate(path, dequantized[a], dequantized[b], static_cast<f32>(f - a) / static_cast<f32>(b - a));
+							if (Error(path, value, samples[f], reach[joint]) > budget) {
+								return false;
+							}
+						}
+						return true;
+					};
+					auto keep = [&](u32 f) {
+						CompressedKey key = quantized[f];
+						key.frameAndLargest = static_cast<u16>(key.frameAndLargest | f);
+						out.keys.push_back(key);
+					};
+
+					keep(0);
+					for (u32 start = 0; start + 1 < frameCount;) {
+						u32 end = start + 1;
+						while (end + 1 < frameCount && fits(start, end + 1)) {
+							++end;
+						}
+						keep(end);
+						start = end;
+					}
+					track.keyCount = static_cast<u32>(out.keys.size()) - track.keyOffset;
+				}
+
+				// the source keys as they are when the frames need more keys than the source has values
+				const bool cubic = source.interpolation == Interpolation::CubicSpline;
+				const u32 sourceValueCount = cubic ? source.keyCount * 3 : source.keyCount;
+				if (track.step || track.keyCount > sourceValueCount) {
+					const std::span<const f32> times(clip.times.data() + source.timesOffset, source.keyCount);
+					const u32 keyCount = cubic ? source.keyCount * 3 - 2 : source.keyCount;
+					sourceValues.resize(keyCount);
+					sourceQuantized.resize(keyCount);
+					sourceDequantized.resize(keyCount);
+					SourceKeys(clip, source, path, sourceValues);
+
+					CompressedTrack keyed = track;
+					keyed.keyCount = keyCount;
+					keyed.curve = cubic;
+					if (cubic) {
+						QuantizeCurve(sourceValues, keyed, sourceQuantized, sourceDequantized);
+					} else {
+						QuantizeKeys(path, sourceValues, keyed, sourceQuantized, sourceDequantized);
+						for (CompressedKey& key : sourceQuantized) {
+							key.frameAndLargest &= ~static_cast<u16>(MaxCompressedFrames - 1);
+						}
+					}
+
+					// step tracks take them whatever, the others only when the quantization keeps them in budget
+					bool fits = true;
+					for (u32 f = 0; f < frameCount && fits && !track.step; ++f) {
+						const f32 time = std::min(f / out.sampleRate, clip.duration);
+						fits = Error(path, SampleKeys(path, cubic, times, sourceDequantized, time), samples[f], reach[joint]) <= budget;
+					}
+
+					if (fits) {
+						auto shared = std::find_if(sharedTimes.begin(), sharedTimes.end(), [&](const SharedTimes& entry) {
+							return entry.sourceOffset == source.timesOffset && entry.keyCount == source.keyCount;
+						});
+						if (shared == sharedTimes.end()) {
+							shared = sharedTimes.insert(sharedTimes.end(), SharedTimes{ source.timesOffset, source.keyCount, static_cast<u32>(out.times.size()) });
+							out.times.insert(out.times.end(), times.begin(), times.end());
+						}
+						keyed.timesOffset = shared->offset;
+
+						out.keys.resize(track.keyOffset);
+						out.keys.insert(out.keys.end(), sourceQuantized.begin(), sourceQuantized.end());
+						track = keyed;
+					}
+				}
+
+				out.tracks.push_back(track);
+				out.animatedLanes[p] |= static_cast<u16>(1u << (pathIndex * PacketWidth + lane));
+			}
+		}
+	}
+}
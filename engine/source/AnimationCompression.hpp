@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Animation.hpp"
+
+// compressed clips, the cooker is in AnimationCompression.cpp and SampleClip for them is next to the
+// other one in Animation.cpp
+namespace Animation
+{
+	struct CompressionSettings {
+		// the clip is resampled to this many frames a second and then the frames that arent needed are dropped
+		f32 sampleRate = 60.0f;
+		// how far any point of the mesh may end up from where the source clip puts it, in model space units
+		f32 tolerance = 0.001f;
+		// how far the skin reaches past the last joint of a chain
+		f32 skinDistance = 0.1f;
+	};
+
+	// frames are stored in 14 bits
+	constexpr u32 MaxCompressedFrames = 1u << 14;
+
+	// CompressedTrack::timesOffset of tracks with their keys on frames
+	constexpr u32 KeysOnFrames = 0xFFFFFFFFu;
+
+	// 8 bytes instead of the 16 to 20 of a float key and its time
+	struct CompressedKey {
+		// the frame in the low 14 bits, 0 for tracks with key times of their own, rotations keep the index of
+		// the component they leave out in the top 2
+		// curves dont have either and keep a 4th component here instead
+		u16 frameAndLargest;
+		// translations and scales, 0 to 65535 over the range of the track
+		// rotations, the 3 components other than the largest from -1/sqrt2 to 1/sqrt2, the largest is made
+		// positive when quantizing and comes back from the length
+		// curves, every component 0 to 65535 over the range of the track like translations
+		u16 values[3];
+
+		inline u32 Frame() const { return frameAndLargest & (MaxCompressedFrames - 1); }
+		inline u32 Largest() const { return frameAndLargest >> 14; }
+	};
+
+	struct CompressedTrack {
+		// at least 2 keys, the first is frame 0 and the last the last frame, or the source keys
+		u32 keyOffset;
+		u32 keyCount;
+		// KeysOnFrames, or the key times in CompressedClip::times for tracks that keep the source keys, step
+		// tracks that have to switch when the source does and tracks the frames dont make any smaller
+		u32 timesOffset;
+		// translations, scales and curves are min + value / 65535 * extent, rotations that arent curves dont use them
+		float4 min;
+		float4 extent;
+		// holds each key until the next one instead of interpolating
+		bool step;
+		// the source cubic splines as bezier curves, the value at every source key and the 2 control points
+		// between each pair of them, with the source times, rotations are curves of all 4 components that
+		// get normalized like the source
+		bool curve;
+	};
+
+	struct CompressedClip {
+		std::string name;
+		f32 duration = 0.0f;
+		// frame f is at f / sampleRate seconds, the last frame at duration
+		f32 sampleRate = 0.0f;
+		u32 frameCount = 0;
+
+		// every track that doesnt move by more than the tolerance only has its value here, like Clip::constants
+		Data<TransformSoa> constants;
+		// a bit per lane for each path of a packet, path * PacketWidth + lane, set where the joint has a track
+		Data<u16> animatedLanes;
+		// the first track of each packet, the tracks of a packet are in path and then lane order
+		Data<u32> firstTrack;
+		Data<CompressedTrack> tracks;
+		Data<CompressedKey> keys;
+		// key times of the tracks that keep the source keys, shared like Clip::times
+		Data<f32> times;
+	};
+
+	// cooks clip, keys that interpolating their neighbours gets close enough to are dropped and the rest
+	// quantized, rotations to the smallest three components of the quaternion
+	// step tracks, and linear and cubic spline tracks that would end up with more keys than the source has
+	// values, keep the source keys and times instead, quantized the same way
+	// every joint gets a share of the tolerance split along its longest chain and measured at the furthest
+	// point it moves, so joints near the root keep more keys than finger tips
+	void CompressClip(const Skeleton& skeleton, const Clip& clip, const CompressionSettings& settings, CompressedClip& out);
+
+	// the same pose as the source clip within the tolerance, at the frames it was compressed at and at
+	// any time for tracks with the source keys, rotations are nlerps the short way round between the kept keys
+	void SampleClip(const CompressedClip& clip, f32 time, std::span<TransformSoa> out);
+}
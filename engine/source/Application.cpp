@@ -6,6 +6,11 @@
 #include "DX11/DX11Context.hpp"
 #include "AssetSystem.hpp"
 #include "SceneSystem.hpp"
+#include "Benchmarks.hpp"
+#include "Core/JobSystem.hpp"
+#include "Core/Profiler.hpp"
+#include "Core/MemoryTracker.hpp"
+#include "Core/Log.hpp"
 
 #include <GLFW/glfw3.h>
 
@@ -14,6 +19,11 @@ namespace global
 	DX11Context* rendererSystem = nullptr;
 }
 
+static f32 ElapsedMs(const spdlog::stopwatch& sw)
+{
+	return static_cast<f32>(sw.elapsed().count() * 1000.0);
+}
+
 #pragma region glfw callbacks
 
 void WindowSizeCallback(GLFWwindow* window, int width, int height) {
@@ -35,8 +45,48 @@ Application::Application(int argc, char** argv)
 
 	const flags::args args(argc, argv);
 
+	// loading and frame code log through LOG_*, which defers formatting and io to a background thread
+	// unless --log_sync is passed
+	Log::SetRateLimit(args.get<u32>("log_rate_limit", 100u));
+	Log::Init(!args.get<bool>("log_sync", false));
+
+	Profiler::Init();
+	Profiler::SetThreadName("main");
+	// writes a chrome trace on exit
+	m_profileOutPath = args.get<std::string>("profile_out", "");
+
+	for (const Benchmarks::Entry& benchmark : Benchmarks::GetEntries()) {
+		if (args.get<bool>(fmt::format("bench_{}", benchmark.name), false)) {
+			m_benchmarks.push_back(&benchmark);
+		}
+	}
+
+	// no window or device, assets load their cpu side only and the frame loop runs scene updates
+	// at a fixed timestep, for measuring loading, scene and culling on machines without a gpu
+	m_headless = args.get<bool>("headless", false);
+	m_frameSettings.frameTime = 1.0 / std::max(args.get<f64>("headless_fps", 60.0), 1.0);
+	// exit after this many frames or seconds of scene time, 0 is no limit
+	m_frameSettings.frameLimit = args.get<u64>("frames", 0ull);
+	m_frameSettings.timeLimit = args.get<f64>("duration", 0.0);
+	if (m_headless && m_frameSettings.frameLimit == 0 && m_frameSettings.timeLimit <= 0.0) {
+		m_frameSettings.frameLimit = 600;
+	}
+
+	MemoryTracker::Init();
+	// budgets in MB, --mem_budget_assets_mesh 64 etc, nothing is budgeted by default
+	for (u32 i = 0; i < static_cast<u32>(MemoryTag::Num); ++i) {
+		const MemoryTag tag = static_cast<MemoryTag>(i);
+		const std::string flag = fmt::format("mem_budget_{}", MemoryTagToString(tag));
+		if (const u64 budgetMB = args.get<u64>(flag, 0ull); budgetMB > 0) {
+			MemoryTracker::SetBudget(tag, budgetMB * 1024 * 1024);
+		}
+	}
+
 	// init global systems
 	{
+		global::jobSystem = new JobSystem(args.get<u32>("workers", 0u));
+		ASSERT(global::jobSystem != nullptr, "");
+
 		global::assetSystem = new AssetSystem();
 		{
 			ASSERT(global::assetSystem != nullptr, "");
@@ -47,30 +97,73 @@ Application::Application(int argc, char** argv)
 		}
 
 		global::sceneSystem = new SceneSystem();
-		{
-			ASSERT(global::sceneSystem != nullptr, "");
-			global::sceneSystem->runtimeScene = std::make_shared<RuntimeScene>();
-		}
+		ASSERT(global::sceneSystem != nullptr, "");
 	}
 }
 
 Application::~Application()
 {
+	if (!m_profileOutPath.empty()) {
+		Profiler::WriteChromeTrace(m_profileOutPath);
+	}
+
+	MemoryTracker::LogSnapshot("at shutdown", MemoryTracker::TakeSnapshot());
+
 	// deinit global systems
 	{
+		global::assetSystem->SetRenderer(nullptr);
 		delete global::rendererSystem;
 		delete global::assetSystem;
 		delete global::sceneSystem;
+		delete global::jobSystem;
 	}
+
+	Log::Shutdown();
 }
 
 int Application::Run()
 {
 	spdlog::info("Application startup");
+
+	if (!m_benchmarks.empty()) {
+		return Benchmarks::Run(m_benchmarks) ? 0 : 1;
+	}
+
+	if (m_headless) {
+		spdlog::info("running headless, {} frames at {:.1f} fps", m_frameSettings.frameLimit, 1.0 / m_frameSettings.frameTime);
+	} else if (!InitWindow()) {
+		return -1;
+	}
+
+	{
+		spdlog::stopwatch loadTime;
+		const MemoryTracker::Snapshot before = MemoryTracker::TakeSnapshot();
+		global::assetSystem->RegisterAssets();
+		MemoryTracker::LogDiff("RegisterAssets", MemoryTracker::Diff(before, MemoryTracker::TakeSnapshot()));
+		spdlog::info("RegisterAssets took {:.2f}ms", ElapsedMs(loadTime));
+	}
+
+	global::sceneSystem->runtimeScene = std::allocate_shared<RuntimeScene>(TrackedAllocator<RuntimeScene, MemoryTag::Scene>());
+
+	FrameLoop frameLoop(m_window != nullptr ? this : nullptr, global::rendererSystem);
+	const u64 frameIndex = frameLoop.Run(*global::sceneSystem->runtimeScene.get(), m_frameSettings);
+
+	if (m_headless) {
+		frameLoop.LogSummary(frameIndex);
+	}
+
+	ShutdownWindow();
+
+	spdlog::info("Application closing");
+	return 0;
+}
+
+bool Application::InitWindow()
+{
 	if(int res = glfwInit(); !res) 
 	{
 		spdlog::critical("glfwInit failed with {}", res);
-		return -1;
+		return false;
 	}
 
 	glfwWindowHint(GLFW_SCALE_TO_MONITOR, GLFW_FALSE);
@@ -78,34 +171,47 @@ int Application::Run()
 
 	m_window = glfwCreateWindow(1280, 720, "Engine", nullptr, nullptr);
 	
-	glfwSetWindowSizeCallback(m_window, WindowSizeCallback);
-	glfwSetWindowUserPointer(m_window, this);
-
 	if (!m_window)
 	{
 		spdlog::critical("window creation failed");
 		glfwTerminate();
-		return -1;
+		return false;
 	}
 
-	global::rendererSystem = new DX11Context(m_window);
+	glfwSetWindowSizeCallback(m_window, WindowSizeCallback);
+	glfwSetWindowUserPointer(m_window, this);
 
-	global::assetSystem->RegisterAssets();
+	global::rendererSystem = new DX11Context(m_window);
+	global::assetSystem->SetRenderer(global::rendererSystem);
+	return true;
+}
 
-	while (!glfwWindowShouldClose(m_window))
-	{
-		glfwPollEvents();
-		
-		global::rendererSystem->Render(*global::sceneSystem->runtimeScene.get());
+void Application::ShutdownWindow()
+{
+	if (m_window == nullptr) {
+		return;
 	}
 
 	glfwDestroyWindow(m_window);
+	m_window = nullptr;
 	spdlog::info("window destroyed");
 
 	glfwTerminate();
+}
 
-	spdlog::info("Application closing");
-	return 0;
+void Application::PollEvents()
+{
+	glfwPollEvents();
+}
+
+f64 Application::GetTime() const
+{
+	return glfwGetTime();
+}
+
+bool Application::ShouldClose() const
+{
+	return glfwWindowShouldClose(m_window);
 }
 
 void Application::OnWindowResize(GLFWwindow* window)
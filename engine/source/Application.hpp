@@ -1,25 +1,45 @@
 #pragma once
 
 #include "Basic.hpp"
+#include "FrameLoop.hpp"
 
 class DX11Context;
 class ShaderCompiler;
 
+namespace Benchmarks { struct Entry; }
+
 struct GLFWwindow;
 
-class Application {
+class Application : public FrameWindow {
 
 public:
 	Application(int argc, char** argv);
 	virtual ~Application();
 	int Run();
 
+	// FrameWindow
+	void PollEvents() override;
+	f64 GetTime() const override;
+	bool ShouldClose() const override;
+
 private:
+	// window and renderer, skipped when headless
+	bool InitWindow();
+	void ShutdownWindow();
+
 	void OnWindowResize(GLFWwindow* window);
 
 private:
 	GLFWwindow* m_window = nullptr;
 
+	std::string m_profileOutPath;
+
+	bool m_headless = false;
+	FrameLoop::Settings m_frameSettings;
+
+	// --bench_<name> for each, run instead of the app, no window or device
+	std::vector<const Benchmarks::Entry*> m_benchmarks;
+
 	//std::unique_ptr<DX11Context> m_renderer;
 
 	// glfw callbacks
@@ -0,0 +1,566 @@
+#include "AssetManifest.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <span>
+
+static const char* assetTypeStrings[] = {
+	"invalid",
+	"mesh",
+	"shader",
+	"texture",
+};
+
+static_assert(ARRLEN(assetTypeStrings) == static_cast<size_t>(AssetType::Num));
+
+const char* AssetManifest::AssetTypeToString(AssetType type)
+{
+	ENSURE(type < AssetType::Num, "");
+	return assetTypeStrings[static_cast<u32>(type)];
+}
+
+AssetType AssetManifest::AssetTypeFromString(std::string_view str)
+{
+	for (u32 i = 1; i < static_cast<u32>(AssetType::Num); ++i) {
+		if (str == assetTypeStrings[i]) {
+			return static_cast<AssetType>(i);
+		}
+	}
+	return AssetType::Invalid;
+}
+
+bool AssetManifest::Load(const byte* data, size_t size)
+{
+	u32 magic = 0;
+	if (size >= sizeof(magic)) {
+		memcpy(&magic, data, sizeof(magic));
+	}
+
+	return magic == Magic
+		? ParseBinary(data, size)
+		: ParseText(std::string_view(reinterpret_cast<const char*>(data), size));
+}
+
+bool AssetManifest::LoadFromFile(const std::string& realPath)
+{
+	std::ifstream file(realPath, std::ios::binary | std::ios::ate);
+	if (!file) {
+		spdlog::error("failed opening asset manifest {}", realPath);
+		return false;
+	}
+
+	const size_t size = static_cast<size_t>(file.tellg());
+	file.seekg(0);
+
+	// @TODO: use temp allocator here
+	std::vector<byte> contents(size);
+	file.read(reinterpret_cast<char*>(contents.data()), size);
+
+	if (!Load(contents.data(), contents.size())) {
+		spdlog::error("failed parsing asset manifest {}", realPath);
+		return false;
+	}
+
+	return true;
+}
+
+bool AssetManifest::WriteBinary(const std::string& realPath) const
+{
+	std::vector<byte> contents = SerializeBinary();
+
+	std::ofstream file(realPath, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		spdlog::error("failed opening {} for writing", realPath);
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(contents.data()), contents.size());
+	return file.good();
+}
+
+void AssetManifest::Clear()
+{
+	m_entries.clear();
+	m_settings.clear();
+	m_dependencies.clear();
+	m_stringTable.clear();
+	m_index.clear();
+}
+
+u32 AssetManifest::AddString(std::string_view str)
+{
+	const u32 offset = static_cast<u32>(m_stringTable.size());
+	m_stringTable.insert(m_stringTable.end(), str.begin(), str.end());
+	m_stringTable.push_back('\0');
+	return offset;
+}
+
+static std::string_view TrimWhitespace(std::string_view str)
+{
+	const size_t first = str.find_first_not_of(" \t\r");
+	if (first == std::string_view::npos) {
+		return {};
+	}
+	const size_t last = str.find_last_not_of(" \t\r");
+	return str.substr(first, last - first + 1);
+}
+
+// splits off the next whitespace separated token from the front of line
+static std::string_view NextToken(std::string_view& line)
+{
+	line = TrimWhitespace(line);
+	const size_t end = line.find_first_of(" \t");
+	std::string_view token = line.substr(0, end);
+	line = end == std::string_view::npos ? std::string_view{} : line.substr(end);
+	return token;
+}
+
+bool AssetManifest::ParseText(std::string_view text)
+{
+	Clear();
+
+	u32 lineNumber = 0;
+	bool ok = true;
+
+	while (!text.empty()) {
+		const size_t newline = text.find('\n');
+		std::string_view line = text.substr(0, newline);
+		text = newline == std::string_view::npos ? std::string_view{} : text.substr(newline + 1);
+		++lineNumber;
+
+		if (const size_t comment = line.find('#'); comment != std::string_view::npos) {
+			line = line.substr(0, comment);
+		}
+
+		line = TrimWhitespace(line);
+		if (line.empty()) {
+			continue;
+		}
+
+		const std::string_view typeStr = NextToken(line);
+		const std::string_view path = NextToken(line);
+
+		Entry entry = {
+			.pathHash = HashPath(path),
+			.type = AssetTypeFromString(typeStr),
+			.pathOffset = 0,
+			.firstSetting = static_cast<u32>(m_settings.size()),
+			.settingCount = 0,
+			.firstDependency = static_cast<u32>(m_dependencies.size()),
+			.dependencyCount = 0,
+		};
+
+		if (entry.type == AssetType::Invalid || path.empty()) {
+			spdlog::error("asset manifest line {}: expected '<type> <path>', got '{}'", lineNumber, typeStr);
+			ok = false;
+			continue;
+		}
+
+		entry.pathOffset = AddString(path);
+
+		for (std::string_view token = NextToken(line); !token.empty(); token = NextToken(line)) {
+			const size_t equals = token.find('=');
+			if (equals == std::string_view::npos) {
+				spdlog::error("asset manifest line {}: expected key=value, got '{}'", lineNumber, token);
+				ok = false;
+				continue;
+			}
+
+			const std::string_view key = token.substr(0, equals);
+			const std::string_view value = token.substr(equals + 1);
+
+			if (key == "dep") {
+				m_dependencies.push_back(Dependency{
+					.pathHash = HashPath(value),
+					.pathOffset = AddString(value),
+				});
+				entry.dependencyCount++;
+			} else {
+				m_settings.push_back(Setting{
+					.keyOffset = AddString(key),
+					.valueOffset = AddString(value),
+				});
+				entry.settingCount++;
+			}
+		}
+
+		m_entries.push_back(entry);
+	}
+
+	return BuildIndex() && ok;
+}
+
+template<typename T>
+static bool ReadArray(const byte*& cursor, const byte* end, std::vector<T>& out, u32 count)
+{
+	const size_t bytes = sizeof(T) * count;
+	if (static_cast<size_t>(end - cursor) < bytes) {
+		return false;
+	}
+	out.resize(count);
+	memcpy(out.data(), cursor, bytes);
+	cursor += bytes;
+	return true;
+}
+
+// into the front of rest, which has to have room for it, rest is left pointing past what was written
+template<typename T>
+static void WriteArray(std::span<byte>& rest, const T* data, size_t count)
+{
+	const std::span<byte> to = rest.first(sizeof(T) * count);
+	if (!to.empty()) {
+		memcpy(to.data(), data, to.size());
+	}
+	rest = rest.subspan(to.size());
+}
+
+bool AssetManifest::ParseBinary(const byte* data, size_t size)
+{
+	Clear();
+
+	Header header;
+	if (size < sizeof(header)) {
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+
+	if (header.magic != Magic || header.version != Version) {
+		spdlog::error("asset manifest version mismatch, got {} expected {}", header.version, Version);
+		return false;
+	}
+
+	const byte* cursor = data + sizeof(header);
+	const byte* end = data + size;
+
+	const bool ok =
+		ReadArray(cursor, end, m_entries, header.entryCount) &&
+		ReadArray(cursor, end, m_settings, header.settingCount) &&
+		ReadArray(cursor, end, m_dependencies, header.dependencyCount) &&
+		ReadArray(cursor, end, m_stringTable, header.stringTableSize);
+
+	if (!ok) {
+		spdlog::error("asset manifest is truncated");
+		Clear();
+		return false;
+	}
+
+	// every offset must land inside the string table, and the table must end in a terminator
+	// so GetString can never run off the end
+	if (!m_stringTable.empty() && m_stringTable.back() != '\0') {
+		Clear();
+		return false;
+	}
+
+	return BuildIndex();
+}
+
+std::vector<byte> AssetManifest::SerializeBinary() const
+{
+	const Header header = {
+		.entryCount = static_cast<u32>(m_entries.size()),
+		.settingCount = static_cast<u32>(m_settings.size()),
+		.dependencyCount = static_cast<u32>(m_dependencies.size()),
+		.stringTableSize = static_cast<u32>(m_stringTable.size()),
+	};
+
+	// sized from the counts and the string table length before anything is copied
+	std::vector<byte> out(sizeof(header)
+		+ sizeof(Entry) * m_entries.size()
+		+ sizeof(Setting) * m_settings.size()
+		+ sizeof(Dependency) * m_dependencies.size()
+		+ m_stringTable.size());
+
+	std::span<byte> rest(out);
+	WriteArray(rest, &header, 1);
+	WriteArray(rest, m_entries.data(), m_entries.size());
+	WriteArray(rest, m_settings.data(), m_settings.size());
+	WriteArray(rest, m_dependencies.data(), m_dependencies.size());
+	WriteArray(rest, m_stringTable.data(), m_stringTable.size());
+	ASSERT(rest.empty(), "");
+
+	return out;
+}
+
+std::string AssetManifest::SerializeText() const
+{
+	std::string out;
+	for (const Entry& entry : m_entries) {
+		out += AssetTypeToString(entry.type);
+		out += ' ';
+		out += GetPath(entry);
+		for (const Setting& setting : GetSettings(entry)) {
+			out += fmt::format(" {}={}", GetString(setting.keyOffset), GetString(setting.valueOffset));
+		}
+		for (const Dependency& dependency : GetDependencies(entry)) {
+			out += fmt::format(" dep={}", GetString(dependency.pathOffset));
+		}
+		out += '\n';
+	}
+	return out;
+}
+
+bool AssetManifest::BuildIndex()
+{
+	m_index.clear();
+	m_index.reserve(m_entries.size());
+
+	const u32 stringTableSize = static_cast<u32>(m_stringTable.size());
+	bool ok = true;
+
+	for (u32 i = 0; i < m_entries.size(); ++i) {
+		const Entry& entry = m_entries[i];
+
+		if (entry.pathOffset >= stringTableSize
+			// first <= size and then count <= size - first, adding them up first can wrap in u32
+			|| entry.firstSetting > m_settings.size() || entry.settingCount > m_settings.size() - entry.firstSetting
+			|| entry.firstDependency > m_dependencies.size() || entry.dependencyCount > m_dependencies.size() - entry.firstDependency
+			|| entry.type == AssetType::Invalid || entry.type >= AssetType::Num) {
+			spdlog::error("asset manifest entry {} is malformed", i);
+			ok = false;
+			continue;
+		}
+
+		auto [it, inserted] = m_index.emplace(entry.pathHash, i);
+		if (!inserted) {
+			spdlog::error("asset manifest path hash collision between {} and {}",
+				GetPath(m_entries[it->second]), GetPath(entry));
+			ok = false;
+		}
+	}
+
+	for (const Setting& setting : m_settings) {
+		ok = ok && setting.keyOffset < stringTableSize && setting.valueOffset < stringTableSize;
+	}
+
+	for (const Dependency& dependency : m_dependencies) {
+		ok = ok && dependency.pathOffset < stringTableSize;
+	}
+
+	return ok;
+}
+
+const AssetManifest::Entry* AssetManifest::Find(u64 pathHash) const
+{
+	auto it = m_index.find(pathHash);
+	return it != m_index.end() ? &m_entries[it->second] : nullptr;
+}
+
+std::string_view AssetManifest::GetSetting(const Entry& entry, std::string_view key, std::string_view defaultValue) const
+{
+	for (const Setting& setting : GetSettings(entry)) {
+		if (GetString(setting.keyOffset) == key) {
+			return GetString(setting.valueOffset);
+		}
+	}
+	return defaultValue;
+}
+
+// same entries with the same strings, offsets may differ
+static bool SameEntries(const AssetManifest& a, const AssetManifest& b)
+{
+	bool same = a.GetEntryCount() == b.GetEntryCount();
+	for (u32 i = 0; same && i < a.GetEntryCount(); ++i) {
+		const AssetManifest::Entry& entryA = a.GetEntry(i);
+		const AssetManifest::Entry& entryB = b.GetEntry(i);
+		same &= entryA.pathHash == entryB.pathHash && entryA.type == entryB.type && a.GetPath(entryA) == b.GetPath(entryB);
+
+		const std::span<const AssetManifest::Setting> settingsA = a.GetSettings(entryA);
+		const std::span<const AssetManifest::Setting> settingsB = b.GetSettings(entryB);
+		same &= settingsA.size() == settingsB.size();
+		for (size_t s = 0; same && s < settingsA.size(); ++s) {
+			same &= a.GetString(settingsA[s].keyOffset) == b.GetString(settingsB[s].keyOffset);
+			same &= a.GetString(settingsA[s].valueOffset) == b.GetString(settingsB[s].valueOffset);
+		}
+
+		const std::span<const AssetManifest::Dependency> dependenciesA = a.GetDependencies(entryA);
+		const std::span<const AssetManifest::Dependency> dependenciesB = b.GetDependencies(entryB);
+		same &= dependenciesA.size() == dependenciesB.size();
+		for (size_t d = 0; same && d < dependenciesA.size(); ++d) {
+			same &= dependenciesA[d].pathHash == dependenciesB[d].pathHash;
+			same &= a.GetString(dependenciesA[d].pathOffset) == b.GetString(dependenciesB[d].pathOffset);
+		}
+	}
+	return same;
+}
+
+// text -> binary -> manifest has to come out with the same entries as the text, and writing that out again
+// the same bytes
+static bool CheckRoundTrip(std::string_view name, std::string_view text)
+{
+	AssetManifest fromText;
+	bool passed = fromText.ParseText(text);
+
+	const std::vector<byte> binary = fromText.SerializeBinary();
+	AssetManifest fromBinary;
+	passed &= fromBinary.Load(binary.data(), binary.size());
+
+	const bool entries = SameEntries(fromText, fromBinary);
+	const bool bytes = fromBinary.SerializeBinary() == binary;
+
+	spdlog::info("{}: {} entries, {} bytes, text to binary {}, binary to binary {}", name, fromText.GetEntryCount(), binary.size(),
+		entries ? "matches" : "MISMATCH", bytes ? "matches" : "MISMATCH");
+	return passed && entries && bytes;
+}
+
+// the source without comments, blank lines and extra whitespace, what SerializeText writes for it when the
+// settings of every line come before its dependencies like the format says
+static std::string NormalizeText(std::string_view text)
+{
+	std::string out;
+	while (!text.empty()) {
+		const size_t newline = text.find('\n');
+		std::string_view line = text.substr(0, newline);
+		text = newline == std::string_view::npos ? std::string_view{} : text.substr(newline + 1);
+
+		line = line.substr(0, line.find('#'));
+		const size_t start = out.size();
+		for (std::string_view token = NextToken(line); !token.empty(); token = NextToken(line)) {
+			if (out.size() > start) {
+				out += ' ';
+			}
+			out += token;
+		}
+		if (out.size() > start) {
+			out += '\n';
+		}
+	}
+	return out;
+}
+
+// the catalog the engine ships, text -> binary -> text has to give back the source line for line, and parsing
+// that text again the same binary
+static bool CheckCatalogFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		spdlog::error("failed opening {}", path);
+		return false;
+	}
+	const std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	AssetManifest fromText;
+	bool passed = fromText.ParseText(source);
+
+	const std::vector<byte> binary = fromText.SerializeBinary();
+	AssetManifest fromBinary;
+	passed &= fromBinary.Load(binary.data(), binary.size());
+
+	const std::string text = fromBinary.SerializeText();
+	AssetManifest reparsed;
+	passed &= reparsed.ParseText(text);
+
+	const bool entries = SameEntries(fromText, fromBinary) && SameEntries(fromText, reparsed);
+	const bool sameText = text == NormalizeText(source);
+	const bool bytes = reparsed.SerializeBinary() == binary;
+
+	spdlog::info("{}: {} entries, {} bytes, text to binary {}, binary to text {}, text to binary again {}", path,
+		fromText.GetEntryCount(), binary.size(), entries ? "matches" : "MISMATCH", sameText ? "matches" : "MISMATCH",
+		bytes ? "matches" : "MISMATCH");
+	return passed && entries && sameText && bytes;
+}
+
+// ranges past the end of the arrays that only look in range once first + count wraps around
+static bool CheckMalformed()
+{
+	AssetManifest manifest;
+	manifest.ParseText("mesh meshes/a.gltf scale=1 dep=textures/a.png\n");
+	const std::vector<byte> binary = manifest.SerializeBinary();
+
+	bool passed = true;
+	const auto corrupt = [&](size_t fieldOffset, u32 value) {
+		std::vector<byte> broken = binary;
+		memcpy(broken.data() + sizeof(AssetManifest::Header) + fieldOffset, &value, sizeof(value));
+
+		AssetManifest parsed;
+		const bool rejected = !parsed.ParseBinary(broken.data(), broken.size());
+		passed &= rejected;
+	};
+
+	spdlog::info("the next four errors are on purpose");
+	corrupt(offsetof(AssetManifest::Entry, firstSetting), 0xffffffff);
+	corrupt(offsetof(AssetManifest::Entry, settingCount), 0xffffffff);
+	corrupt(offsetof(AssetManifest::Entry, firstDependency), 0xffffffff);
+	corrupt(offsetof(AssetManifest::Entry, dependencyCount), 0xffffffff);
+
+	spdlog::info("wrapping ranges rejected {}", passed ? "matches" : "MISMATCH");
+	return passed;
+}
+
+bool AssetManifest::RunBenchmark(const std::string& catalogPath)
+{
+	constexpr u32 entryCount = 100000;
+	constexpr u32 runs = 5;
+
+	spdlog::info("asset manifest benchmark, {} entries", entryCount);
+
+	bool passed = CheckCatalogFile(catalogPath);
+
+	// every form a line can take
+	passed &= CheckRoundTrip("handwritten",
+		"# comment\n"
+		"shader shaders/simple_vs.hlsl kind=vertex entry=VSMain target=vs_5_0 define.USE_FOO=1\n"
+		"\n"
+		"shader\tshaders/simple_ps.hlsl   kind=pixel entry=PSMain target=ps_5_0 feature.USE_BAR=0 # trailing\r\n"
+		"texture textures/error.png\n"
+		"mesh meshes/suzanne.gltf dep=textures/error.png dep=shaders/simple_ps.hlsl scale=2\n");
+	passed &= CheckMalformed();
+
+	// a catalog far bigger than the real one, a few settings and dependencies each
+	std::string text;
+	text.reserve(entryCount * 96);
+	for (u32 i = 0; i < entryCount; ++i) {
+		text += fmt::format("{} assets/{}/asset_{}.dat quality={} dep=assets/{}/asset_{}.dat\n",
+			assetTypeStrings[1 + i % (static_cast<u32>(AssetType::Num) - 1)], i % 64, i, i % 4, (i + 1) % 64, (i + 1) % entryCount);
+	}
+
+	spdlog::stopwatch parseTime;
+	AssetManifest manifest;
+	passed &= manifest.ParseText(text);
+	const f64 parseMs = parseTime.elapsed().count() * 1000.0;
+
+	spdlog::stopwatch serializeTime;
+	const std::vector<byte> binary = manifest.SerializeBinary();
+	const f64 serializeMs = serializeTime.elapsed().count() * 1000.0;
+
+	spdlog::stopwatch loadTime;
+	AssetManifest loaded;
+	passed &= loaded.Load(binary.data(), binary.size());
+	const f64 loadMs = loadTime.elapsed().count() * 1000.0;
+
+	const bool entries = SameEntries(manifest, loaded);
+	const bool bytes = loaded.SerializeBinary() == binary;
+	passed &= entries && bytes;
+
+	spdlog::info("generated: text {:.2f}ms, serialize {:.2f}ms, binary load {:.2f}ms, {} bytes, text to binary {}, binary to binary {}",
+		parseMs, serializeMs, loadMs, binary.size(), entries ? "matches" : "MISMATCH", bytes ? "matches" : "MISMATCH");
+
+	// what the catalog does for every asset at startup, the paths are built up front so only the lookup is timed
+	std::vector<std::string> paths(entryCount);
+	for (u32 i = 0; i < entryCount; ++i) {
+		paths[i] = fmt::format("assets/{}/asset_{}.dat", i % 64, i);
+	}
+
+	f64 bestMs = std::numeric_limits<f64>::max();
+	u32 resolved = 0;
+	for (u32 r = 0; r < runs; ++r) {
+		u32 found = 0;
+		spdlog::stopwatch sw;
+		for (u32 i = 0; i < entryCount; ++i) {
+			const Entry* entry = loaded.Find(paths[i]);
+			found += entry != nullptr && entry == &loaded.GetEntry(i) ? 1 : 0;
+		}
+		bestMs = std::min(bestMs, sw.elapsed().count() * 1000.0);
+		resolved = found;
+	}
+
+	const bool missing = loaded.Find("assets/0/asset_missing.dat") == nullptr;
+	passed &= resolved == entryCount && missing;
+
+	spdlog::info("{} names resolved in {:.2f}ms, {:.1f} ns per name, {} of {} {}, missing name {}", entryCount, bestMs,
+		bestMs * 1e6 / entryCount, resolved, entryCount, resolved == entryCount ? "matches" : "MISMATCH", missing ? "matches" : "MISMATCH");
+
+	spdlog::info("asset manifest checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "Core/Hash.hpp"
+
+#include <string_view>
+#include <span>
+
+enum class AssetType : u32 {
+	Invalid = 0,
+	Mesh,
+	Shader,
+	Texture,
+
+	Num
+};
+
+// the asset catalog manifest, lists every asset the engine knows about along with its type,
+// import settings and the other assets it depends on
+//
+// text source form (data/catalog.txt), one asset per line, # starts a comment:
+//   <type> <virtual path> [key=value ...] [dep=<virtual path> ...]
+//   shader shaders/simple_vs.hlsl kind=vertex entry=VSMain target=vs_5_0 define.USE_FOO=1
+//   shader shaders/simple_ps.hlsl kind=pixel entry=PSMain target=ps_5_0 feature.USE_BAR=0
+// feature.NAME=<bit> declares a switch that gets a variant per combination, see ShaderPermutation.hpp
+//
+// binary form (data/catalog.bin) is the in memory representation written out as is,
+// so loading it is a couple of memcpys
+//
+// all strings live in a single string table and are null terminated, string_views handed out
+// by the manifest can be passed straight to c apis and stay valid for the lifetime of the manifest
+class AssetManifest {
+public:
+	static constexpr u32 Magic = 0x54414341; // 'ACAT'
+	static constexpr u32 Version = 1;
+
+	struct Header {
+		u32 magic = Magic;
+		u32 version = Version;
+		u32 entryCount = 0;
+		u32 settingCount = 0;
+		u32 dependencyCount = 0;
+		u32 stringTableSize = 0;
+	};
+
+	struct Entry {
+		u64 pathHash = 0;
+		AssetType type = AssetType::Invalid;
+		u32 pathOffset = 0;
+		u32 firstSetting = 0;
+		u32 settingCount = 0;
+		u32 firstDependency = 0;
+		u32 dependencyCount = 0;
+	};
+
+	struct Setting {
+		u32 keyOffset = 0;
+		u32 valueOffset = 0;
+	};
+
+	struct Dependency {
+		u64 pathHash = 0;
+		u32 pathOffset = 0;
+		u32 _padding = 0;
+	};
+
+public:
+	// loads either form, the binary form is detected by its magic
+	bool Load(const byte* data, size_t size);
+	bool LoadFromFile(const std::string& realPath);
+	bool WriteBinary(const std::string& realPath) const;
+
+	bool ParseText(std::string_view text);
+	bool ParseBinary(const byte* data, size_t size);
+	std::vector<byte> SerializeBinary() const;
+	// the text form, a line per entry with its settings then its dependencies separated by single spaces,
+	// comments and blank lines of the source are not kept
+	std::string SerializeText() const;
+
+	void Clear();
+
+	inline u32 GetEntryCount() const { return static_cast<u32>(m_entries.size()); }
+	inline const Entry& GetEntry(u32 index) const { return m_entries[index]; }
+
+	// O(1) lookup by the hash of the virtual path, nullptr if the manifest doesnt list it
+	const Entry* Find(u64 pathHash) const;
+	inline const Entry* Find(std::string_view path) const { return Find(HashPath(path)); }
+
+	inline std::string_view GetPath(const Entry& entry) const { return GetString(entry.pathOffset); }
+
+	inline std::span<const Setting> GetSettings(const Entry& entry) const {
+		return { m_settings.data() + entry.firstSetting, entry.settingCount };
+	}
+	inline std::span<const Dependency> GetDependencies(const Entry& entry) const {
+		return { m_dependencies.data() + entry.firstDependency, entry.dependencyCount };
+	}
+
+	std::string_view GetSetting(const Entry& entry, std::string_view key, std::string_view defaultValue = "") const;
+
+	inline std::string_view GetString(u32 offset) const {
+		ENSURE(offset < m_stringTable.size(), "");
+		return std::string_view(m_stringTable.data() + offset);
+	}
+
+	static const char* AssetTypeToString(AssetType type);
+	static AssetType AssetTypeFromString(std::string_view str);
+
+	// text to binary and back to text on the catalog at catalogPath, a handwritten and a generated 100k entry
+	// manifest, binaries with wrapping ranges rejected, then every name of the generated one resolved and timed
+	static bool RunBenchmark(const std::string& catalogPath);
+
+private:
+	u32 AddString(std::string_view str);
+	bool BuildIndex();
+
+private:
+	std::vector<Entry> m_entries;
+	std::vector<Setting> m_settings;
+	std::vector<Dependency> m_dependencies;
+	std::vector<char> m_stringTable;
+
+	// path hash -> index into m_entries
+	std::unordered_map<u64, u32, IdentityHash> m_index;
+};
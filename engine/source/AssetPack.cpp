@@ -0,0 +1,104 @@
+#include "AssetPack.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+namespace AssetPack
+{
+	const Entry* FindEntry(const Entry* entries, u32 entryCount, u64 pathHash)
+	{
+		const Entry* end = entries + entryCount;
+		const Entry* it = std::lower_bound(entries, end, pathHash,
+			[](const Entry& entry, u64 hash) { return entry.pathHash < hash; });
+
+		return (it != end && it->pathHash == pathHash) ? it : nullptr;
+	}
+
+	bool Writer::AddFile(std::string_view virtualPath, const byte* data, size_t size)
+	{
+		const u64 pathHash = HashPath(virtualPath);
+		auto [it, inserted] = m_index.emplace(pathHash, static_cast<u32>(m_files.size()));
+		if (!inserted) {
+			spdlog::error("pack already contains {} (or a path with the same hash {})", virtualPath, m_files[it->second].virtualPath);
+			return false;
+		}
+
+		m_files.push_back(PendingFile{
+			.virtualPath = std::string(virtualPath),
+			.data = std::vector<byte>(data, data + size),
+		});
+		return true;
+	}
+
+	static u64 AlignUp(u64 value, u64 alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	bool Writer::Write(const std::string& realPath)
+	{
+		ASSERT(m_alignment > 0 && (m_alignment & (m_alignment - 1)) == 0, "alignment must be a power of two");
+
+		std::vector<Entry> entries;
+		entries.reserve(m_files.size());
+
+		std::vector<char> stringTable;
+
+		u64 offset = AlignUp(sizeof(Header), m_alignment);
+		for (const PendingFile& file : m_files) {
+			entries.push_back(Entry{
+				.pathHash = HashPath(file.virtualPath),
+				.offset = offset,
+				.size = file.data.size(),
+				.storedSize = file.data.size(),
+				.pathOffset = static_cast<u32>(stringTable.size()),
+				.compression = Compression::None,
+			});
+
+			stringTable.insert(stringTable.end(), file.virtualPath.begin(), file.virtualPath.end());
+			stringTable.push_back('\0');
+
+			offset = AlignUp(offset + file.data.size(), m_alignment);
+		}
+
+		const Header header = {
+			.entryCount = static_cast<u32>(entries.size()),
+			.alignment = m_alignment,
+			.tocOffset = offset,
+			.stringTableOffset = offset + sizeof(Entry) * entries.size(),
+			.stringTableSize = stringTable.size(),
+		};
+
+		std::ofstream out(realPath, std::ios::binary | std::ios::trunc);
+		if (!out) {
+			spdlog::error("failed opening {} for writing", realPath);
+			return false;
+		}
+
+		static const byte zeros[4096] = {};
+		auto padTo = [&out](u64 position) {
+			u64 current = static_cast<u64>(out.tellp());
+			while (current < position) {
+				const u64 count = std::min<u64>(position - current, sizeof(zeros));
+				out.write(reinterpret_cast<const char*>(zeros), count);
+				current += count;
+			}
+		};
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		for (size_t i = 0; i < m_files.size(); ++i) {
+			padTo(entries[i].offset);
+			out.write(reinterpret_cast<const char*>(m_files[i].data.data()), m_files[i].data.size());
+		}
+
+		padTo(header.tocOffset);
+
+		// data stays in insertion order, only the toc is sorted
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.pathHash < b.pathHash; });
+		out.write(reinterpret_cast<const char*>(entries.data()), sizeof(Entry) * entries.size());
+		out.write(stringTable.data(), stringTable.size());
+
+		return out.good();
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "Core/Hash.hpp"
+
+#include <string_view>
+
+// single file archive of the data dir, mapped into memory at runtime by the VirtualFileSystem
+//
+// layout:
+//   Header
+//   file data, every entry starts on an Header::alignment boundary
+//   Entry[entryCount], sorted by pathHash so lookups are a binary search with no allocation
+//   string table of null terminated virtual paths
+namespace AssetPack
+{
+	constexpr u32 Magic = 0x4b415041; // 'APAK'
+	constexpr u32 Version = 1;
+	constexpr u32 DefaultAlignment = 64;
+
+	// name of the pack inside the data dir
+	constexpr std::string_view FileName = "assets.pak";
+
+	enum class Compression : u32 {
+		// the only one, entries are served as slices of the mapped pack and a compressed one would need Open to
+		// decompress into memory of its own, readers reject anything they dont know so one can be added later
+		None = 0,
+
+		Num
+	};
+
+	struct Header {
+		u32 magic = Magic;
+		u32 version = Version;
+		u32 entryCount = 0;
+		u32 alignment = DefaultAlignment;
+		u64 tocOffset = 0;
+		u64 stringTableOffset = 0;
+		u64 stringTableSize = 0;
+	};
+
+	struct Entry {
+		u64 pathHash = 0;
+		u64 offset = 0;
+		// size of the file once decompressed
+		u64 size = 0;
+		// size of the bytes in the pack
+		u64 storedSize = 0;
+		u32 pathOffset = 0;
+		Compression compression = Compression::None;
+	};
+
+	// finds an entry in a sorted toc, nullptr if there is none
+	const Entry* FindEntry(const Entry* entries, u32 entryCount, u64 pathHash);
+
+	class Writer {
+	public:
+		Writer(u32 alignment = DefaultAlignment)
+			: m_alignment(alignment) {}
+
+		// takes a copy of the data
+		bool AddFile(std::string_view virtualPath, const byte* data, size_t size);
+
+		bool Write(const std::string& realPath);
+
+		inline size_t GetFileCount() const { return m_files.size(); }
+
+	private:
+		struct PendingFile {
+			std::string virtualPath;
+			std::vector<byte> data;
+		};
+
+		std::vector<PendingFile> m_files;
+		// path hash -> index into m_files, so adding a file doesnt rescan every file added before it
+		std::unordered_map<u64, u32, IdentityHash> m_index;
+		u32 m_alignment = DefaultAlignment;
+	};
+}
@@ -1,13 +1,18 @@
 #include "AssetSystem.hpp"
 #include <cgltf/cgltf.h>
 
-#include "DX11/DX11Context.hpp"
-#include "DX11/DX11Mesh.hpp"
-#include "DX11/DX11Shader.hpp"
-#include "DX11/DX11Texture.hpp"
+#include "MeshProcessing.hpp"
 
-namespace global {
-	extern DX11Context* rendererSystem;
+#include "Core/Profiler.hpp"
+#include "Core/Log.hpp"
+
+#include <charconv>
+
+// headless runs have no device, assets still load everything the cpu side needs
+// but never get a renderer resource, GetRendererResource stays null
+static bool HasRenderer()
+{
+	return global::assetSystem->Renderer() != nullptr;
 }
 
 namespace global 
@@ -144,8 +149,8 @@ static const char* jsmntype_strings[] = {
 
 #pragma endregion
 
-MeshAsset::MeshAsset(std::string_view filePath)
-	: m_filePath(filePath)
+MeshAsset::MeshAsset(std::string_view filePath, bool buildMeshlets)
+	: m_filePath(filePath), m_buildMeshlets(buildMeshlets)
 {
 	
 }
@@ -154,47 +159,75 @@ MeshAsset::MeshAsset(std::string_view filePath)
 MeshAsset::MeshAsset(
 	const std::vector<float3>&& positions,
 	const std::vector<float3>&& normals, 
-	const std::vector<float3>&& tangents,
+	const std::vector<float4>&& tangents,
 	const std::vector<float3>&& colors,
 	const std::vector<float2>&& uv0s,
 	const std::vector<float2>&& uv1s,
 	const std::vector<u32>&& indices)
 	// these are copies, cpp and its implicitness!!!!
-	: m_positions(positions), m_normals(normals), m_tangents(tangents), m_colors(colors), m_uv0s(uv0s), m_uv1s(uv1s), m_indices(indices)
+	: m_indices(indices.begin(), indices.end())
 {
-
+	m_import.positions.assign(positions.begin(), positions.end());
+	m_import.normals.assign(normals.begin(), normals.end());
+	m_import.tangents.assign(tangents.begin(), tangents.end());
+	m_import.colors.assign(colors.begin(), colors.end());
+	m_import.uv0s.assign(uv0s.begin(), uv0s.end());
+	m_import.uv1s.assign(uv1s.begin(), uv1s.end());
 }
 
 void MeshAsset::Load()
 {
+	PROFILE_ZONE_TEXT("MeshAsset::Load", m_filePath);
+
+	// the floats only live as long as Load, everything after reads the packed streams
+	ImportStreams vertices = std::move(m_import);
+	m_import = ImportStreams{};
+
 	// if we dont have a file path then we set the verted data ourselves
 	if (!m_filePath.empty()) 
 	{
-		std::string realPath = global::assetSystem->GetRealPath(m_filePath);
 		// @TODO: temprary, gltf loader should make meshes and stuff instead, only processing should happen here? or is that file a custom mesh format?
-		spdlog::info("loading mesh {}", realPath);
+		LOG_INFO("loading mesh {}", m_filePath);
+
+		// cgltf points into the file memory for glb files, so the view has to outlive data
+		FileView file = global::assetSystem->OpenFile(m_filePath);
+		if (!file) {
+			LOG_ERROR("failed opening mesh {}", m_filePath);
+			return;
+		}
 
 		// @TODO: customise options
 		cgltf_options options = {};
 		cgltf_data* data = nullptr;
-		cgltf_result result = cgltf_parse_file(&options, realPath.data(), &data);
+		cgltf_result result = cgltf_parse(&options, file.Data(), file.Size(), &data);
 
 		if (result != cgltf_result_success) {
-			spdlog::error("failed loading mesh {}", realPath);
+			LOG_ERROR("failed loading mesh {}", m_filePath);
 			return;
 		}
 
-		spdlog::info("loaded mesh {}", realPath);
+		LOG_INFO("loaded mesh {}", m_filePath);
 
-		spdlog::info("{}", data->json);
+#if ENGINE_LOG_LEVEL <= SPDLOG_LEVEL_TRACE
 		GltfPrintInfo(data);
+#endif
 
+		// glb buffers are already in memory, the real path is only needed to resolve external uris of .gltf files
+		std::string realPath = global::assetSystem->GetRealPath(m_filePath);
 		if(cgltf_load_buffers(&options, data, realPath.data()) != cgltf_result_success) {
-			spdlog::error("failed loading mesh buffers {}", realPath);
+			LOG_ERROR("failed loading mesh buffers {}", m_filePath);
+			cgltf_free(data);
 			return;
 		}
 
-		spdlog::info("loaded mesh buffers {}", realPath);
+		LOG_INFO("loaded mesh buffers {}", m_filePath);
+
+		// EXT_meshopt_compression views are decoded into memory of their own, accessors read them from there
+		if(!MeshCompression::DecodeGltfBufferViews(data)) {
+			LOG_ERROR("failed decoding compressed buffer views of {}", m_filePath);
+			cgltf_free(data);
+			return;
+		}
 
 		ENSURE(data->meshes_count > 0, "");
 		cgltf_mesh* mesh = &data->meshes[0];
@@ -202,6 +235,8 @@ void MeshAsset::Load()
 		ENSURE(mesh->primitives_count > 0, "");
 		cgltf_primitive* primitive = &mesh->primitives[0];
 
+		Material::ImportGltf(primitive->material, m_filePath, m_materialDesc);
+
 		// get indices
 		{
 			cgltf_size count = cgltf_accessor_unpack_indices(primitive->indices, nullptr, sizeof(u32), 0);
@@ -209,6 +244,9 @@ void MeshAsset::Load()
 			count = cgltf_accessor_unpack_indices(primitive->indices, m_indices.data(), sizeof(u32), m_indices.size());
 		}
 
+		// as floats so they weld like everything else, they become skeleton indices once the skin is loaded
+		TrackedVector<float4, MemoryTag::Scratch> skinJoints;
+
 		for(int a = 0; a < mesh->primitives->attributes_count; ++a) {
 			cgltf_attribute* attribute = &mesh->primitives->attributes[a];
 			cgltf_buffer_view* buffer_view = attribute->data->buffer_view;
@@ -217,43 +255,64 @@ void MeshAsset::Load()
 
 			switch(attribute->type) {
 			case cgltf_attribute_type_position: {
-				// cgltf_size count = cgltf_accessor_unpack_floats(attribute->data, nullptr, 0);
-				m_positions.resize(attribute->data->count);
-				(void)cgltf_accessor_unpack_floats(attribute->data, reinterpret_cast<cgltf_float*>(m_positions.data()), 3 * m_positions.size());
+				// floats for the cpu, the renderer gets them back in the format of the file
+				m_positionLayout.position = MeshCompression::GetGltfPositionFormat(attribute->data, m_positionLayout.positionScale);
+				vertices.positions.resize(attribute->data->count);
+				(void)cgltf_accessor_unpack_floats(attribute->data, reinterpret_cast<cgltf_float*>(vertices.positions.data()), 3 * vertices.positions.size());
 			} break;
 			case cgltf_attribute_type_normal: {
-				// cgltf_size count = cgltf_accessor_unpack_floats(attribute->data, nullptr, 0);
-				m_normals.resize(attribute->data->count);
-				(void)cgltf_accessor_unpack_floats(attribute->data, reinterpret_cast<cgltf_float*>(m_normals.data()), 3 * m_normals.size());
+				m_positionLayout.normal = MeshCompression::GetGltfFormat(attribute->data, MeshCompression::VertexFormat::Float3);
+				vertices.normals.resize(attribute->data->count);
+				(void)cgltf_accessor_unpack_floats(attribute->data, reinterpret_cast<cgltf_float*>(vertices.normals.data()), 3 * vertices.normals.size());
 			} break;
 			case cgltf_attribute_type_tangent: {
 				// cgltf_size count = cgltf_accessor_unpack_floats(attribute->data, nullptr, 0);
-				m_tangents.resize(attribute->data->count);
-				(void)cgltf_accessor_unpack_floats(attribute->data, reinterpret_cast<cgltf_float*>(m_tangents.data()), 3 * m_tangents.size());
+				m_attributeLayout.tangent = MeshCompression::GetGltfFormat(attribute->data, MeshCompression::VertexFormat::Float4);
+				vertices.tangents.resize(attribute->data->count);
+				(void)cgltf_accessor_unpack_floats(attribute->data, reinterpret_cast<cgltf_float*>(vertices.tangents.data()), 4 * vertices.tangents.size());
 			} break;
 			case cgltf_attribute_type_texcoord: {
 				if(attribute->index == 0) {
 					// cgltf_size count = cgltf_accessor_unpack_floats(attribute->data, nullptr, 0);
-					m_uv0s.resize(attribute->data->count);
-					(void)cgltf_accessor_unpack_floats(attribute->data, reinterpret_cast<cgltf_float*>(m_uv0s.data()), 2 * m_uv0s.size());
+					m_attributeLayout.uv0 = MeshCompression::GetGltfFormat(attribute->data, MeshCompression::VertexFormat::Float2);
+					vertices.uv0s.resize(attribute->data->count);
+					(void)cgltf_accessor_unpack_floats(attribute->data, reinterpret_cast<cgltf_float*>(vertices.uv0s.data()), 2 * vertices.uv0s.size());
 				}
 
 				if(attribute->index == 1) {
 					// cgltf_size count = cgltf_accessor_unpack_floats(attribute->data, nullptr, 0);
-					m_uv1s.resize(attribute->data->count);
-					(void)cgltf_accessor_unpack_floats(attribute->data, reinterpret_cast<cgltf_float*>(m_uv1s.data()), 2 * m_uv1s.size());
+					vertices.uv1s.resize(attribute->data->count);
+					(void)cgltf_accessor_unpack_floats(attribute->data, reinterpret_cast<cgltf_float*>(vertices.uv1s.data()), 2 * vertices.uv1s.size());
 				}
 			} break;
 			case cgltf_attribute_type_color: {
 				// cgltf_size count = cgltf_accessor_unpack_floats(attribute->data, nullptr, 0);
-				m_colors.resize(attribute->data->count);
-				(void)cgltf_accessor_unpack_floats(attribute->data, reinterpret_cast<cgltf_float*>(m_colors.data()), 3 * m_colors.size());
+				m_attributeLayout.color = MeshCompression::GetGltfFormat(attribute->data, MeshCompression::VertexFormat::Float3);
+				vertices.colors.resize(attribute->data->count);
+				if(attribute->data->type == cgltf_type_vec4) {
+					// unpack only reads whole elements, alpha is dropped afterwards
+					TrackedVector<float4, MemoryTag::Scratch> rgba(attribute->data->count);
+					(void)cgltf_accessor_unpack_floats(attribute->data, reinterpret_cast<cgltf_float*>(rgba.data()), 4 * rgba.size());
+					for(size_t v = 0; v < rgba.size(); ++v) {
+						vertices.colors[v] = float3(rgba[v].x, rgba[v].y, rgba[v].z);
+					}
+				} else {
+					(void)cgltf_accessor_unpack_floats(attribute->data, reinterpret_cast<cgltf_float*>(vertices.colors.data()), 3 * vertices.colors.size());
+				}
 			} break;
 			case cgltf_attribute_type_joints: {
-
+				if(attribute->index == 0) {
+					skinJoints.resize(attribute->data->count);
+					(void)cgltf_accessor_unpack_floats(attribute->data, reinterpret_cast<cgltf_float*>(skinJoints.data()), 4 * skinJoints.size());
+				} else {
+					LOG_WARN("{} has more than 4 joints per vertex, only JOINTS_0 is used", m_filePath);
+				}
 			} break;
 			case cgltf_attribute_type_weights: {
-
+				if(attribute->index == 0) {
+					m_weights.resize(attribute->data->count);
+					(void)cgltf_accessor_unpack_floats(attribute->data, reinterpret_cast<cgltf_float*>(m_weights.data()), 4 * m_weights.size());
+				}
 			} break;
 			case cgltf_attribute_type_custom: {
 
@@ -265,51 +324,325 @@ void MeshAsset::Load()
 			};
 		}
 
+		// morph target deltas, dense until after welding so vertices that move differently stay apart
+		// tangent deltas arent imported, tangents dont follow the morph
+		TrackedVector<TrackedVector<float3, MemoryTag::Scratch>, MemoryTag::Scratch> targetPositions(primitive->targets_count);
+		TrackedVector<TrackedVector<float3, MemoryTag::Scratch>, MemoryTag::Scratch> targetNormals(primitive->targets_count);
+		for(cgltf_size t = 0; t < primitive->targets_count; ++t) {
+			const cgltf_morph_target& target = primitive->targets[t];
+			for(cgltf_size a = 0; a < target.attributes_count; ++a) {
+				const cgltf_attribute& attribute = target.attributes[a];
+				TrackedVector<float3, MemoryTag::Scratch>* deltas = nullptr;
+				if(attribute.type == cgltf_attribute_type_position) {
+					deltas = &targetPositions[t];
+				} else if(attribute.type == cgltf_attribute_type_normal) {
+					deltas = &targetNormals[t];
+				}
+				if(deltas == nullptr || attribute.data->count != vertices.positions.size()) {
+					continue;
+				}
+				// sparse accessors come out dense too, zeros where they have no value
+				deltas->resize(attribute.data->count);
+				(void)cgltf_accessor_unpack_floats(attribute.data, reinterpret_cast<cgltf_float*>(deltas->data()), 3 * deltas->size());
+			}
+		}
+
+		// exporters split vertices along every seam, even where none of the attributes differ, welding
+		// bit exact so nothing changes except the count
+		if (!vertices.positions.empty()) {
+			const u32 vertexCount = static_cast<u32>(vertices.positions.size());
+			TrackedVector<MeshProcessing::WeldStream, MemoryTag::Scratch> streams;
+			auto addStream = [&](auto& data) {
+				if (data.size() == vertexCount) {
+					streams.push_back(MeshProcessing::MakeWeldStream(std::span(data)));
+				}
+			};
+			addStream(vertices.positions);
+			addStream(vertices.normals);
+			addStream(vertices.tangents);
+			addStream(vertices.colors);
+			addStream(vertices.uv0s);
+			addStream(vertices.uv1s);
+			addStream(skinJoints);
+			addStream(m_weights);
+			for(cgltf_size t = 0; t < primitive->targets_count; ++t) {
+				addStream(targetPositions[t]);
+				addStream(targetNormals[t]);
+			}
+
+			const u32 weldedCount = MeshProcessing::WeldVertices(streams, vertexCount, m_indices);
+			if (weldedCount != vertexCount) {
+				LOG_INFO("welded {} vertices into {} for {}, {:.1f}% fewer", vertexCount, weldedCount, m_filePath, 100.0 * (vertexCount - weldedCount) / vertexCount);
+				auto shrink = [&](auto& data) {
+					if (data.size() == vertexCount) {
+						data.resize(weldedCount);
+					}
+				};
+				shrink(vertices.positions);
+				shrink(vertices.normals);
+				shrink(vertices.tangents);
+				shrink(vertices.colors);
+				shrink(vertices.uv0s);
+				shrink(vertices.uv1s);
+				shrink(skinJoints);
+				shrink(m_weights);
+				for(cgltf_size t = 0; t < primitive->targets_count; ++t) {
+					shrink(targetPositions[t]);
+					shrink(targetNormals[t]);
+				}
+			}
+		}
+
 		// @TODO: this below is a hack, do better
 
 		// ensure normals exist
-		if(m_positions.size() != m_normals.size()) {
-			m_normals.resize(m_positions.size());
-			// @TODO: calculate normals
+		if(vertices.positions.size() != vertices.normals.size()) {
+			LOG_INFO("generating normals for {}", m_filePath);
+			m_positionLayout.normal = MeshCompression::VertexFormat::Float3;
+			vertices.normals.resize(vertices.positions.size());
+			MeshProcessing::GenerateNormals(vertices.positions, m_indices, MeshProcessing::NormalWeighting::Angle, vertices.normals);
 		}
 
 		// ensure colors exist
-		if(m_positions.size() != m_colors.size()) {
-			m_colors.resize(m_positions.size());
-			memset(m_colors.data(), 0, m_colors.size() * sizeof(float3));
+		if(vertices.positions.size() != vertices.colors.size()) {
+			vertices.colors.resize(vertices.positions.size());
+			memset(vertices.colors.data(), 0, vertices.colors.size() * sizeof(float3));
+			// all 0, no need for floats
+			m_attributeLayout.color = MeshCompression::VertexFormat::Unorm8x4;
 		}
 
 		// ensure uv0s exist
-		if(m_positions.size() != m_uv0s.size()) {
-			m_uv0s.resize(m_positions.size());
-			memset(m_uv0s.data(), 0, m_uv0s.size() * sizeof(float2));
+		if(vertices.positions.size() != vertices.uv0s.size()) {
+			vertices.uv0s.resize(vertices.positions.size());
+			memset(vertices.uv0s.data(), 0, vertices.uv0s.size() * sizeof(float2));
+		}
+
+		// ensure tangents exist, without uvs they come out as anything perpendicular to the normal
+		// before the skin and the morph targets are built, the vertices split at mirrored uv seams are copies of
+		// others in every stream and those are still plain arrays here
+		if(vertices.positions.size() != vertices.tangents.size()) {
+			LOG_INFO("generating tangents for {}", m_filePath);
+			m_attributeLayout.tangent = MeshCompression::VertexFormat::Float4;
+			const size_t vertexCount = vertices.positions.size();
+			vertices.tangents.resize(vertexCount);
+			TrackedVector<MeshProcessing::TangentSplit, MemoryTag::Scratch> splits;
+			MeshProcessing::GenerateTangents(vertices.positions, vertices.normals, vertices.uv0s, m_indices, vertices.tangents, splits);
+
+			if(!splits.empty()) {
+				LOG_INFO("split {} vertices of {} where the uvs are mirrored", splits.size(), m_filePath);
+				auto grow = [&](auto& data) {
+					if(data.size() == vertexCount) {
+						data.reserve(vertexCount + splits.size());
+						for(const MeshProcessing::TangentSplit& split : splits) {
+							data.push_back(data[split.vertex]);
+						}
+					}
+				};
+				grow(vertices.positions);
+				grow(vertices.normals);
+				grow(vertices.colors);
+				grow(vertices.uv0s);
+				grow(vertices.uv1s);
+				grow(skinJoints);
+				grow(m_weights);
+				for(cgltf_size t = 0; t < primitive->targets_count; ++t) {
+					grow(targetPositions[t]);
+					grow(targetNormals[t]);
+				}
+				for(const MeshProcessing::TangentSplit& split : splits) {
+					vertices.tangents.push_back(split.tangent);
+				}
+			}
+		}
+
+		// the skin of the first node that uses the mesh
+		const cgltf_skin* skin = nullptr;
+		for(cgltf_size n = 0; n < data->nodes_count && skin == nullptr; ++n) {
+			if(data->nodes[n].mesh == mesh) {
+				skin = data->nodes[n].skin;
+			}
+		}
+
+		TrackedVector<u16, MemoryTag::Scratch> jointRemap;
+		const bool hasInfluences = skinJoints.size() == vertices.positions.size() && m_weights.size() == vertices.positions.size();
+		if(skin != nullptr && hasInfluences && GltfLoadSkin(skin, jointRemap)) {
+			GltfLoadAnimations(data, skin, jointRemap);
+
+			u32 badJoints = 0;
+			m_joints.resize(vertices.positions.size());
+			for(size_t v = 0; v < vertices.positions.size(); ++v) {
+				const f32* joints = &skinJoints[v].x;
+				f32* weights = &m_weights[v].x;
+
+				f32 totalWeight = 0.0f;
+				for(u32 k = 0; k < 4; ++k) {
+					const u32 joint = static_cast<u32>(joints[k]);
+					if(joint >= jointRemap.size()) {
+						badJoints += weights[k] != 0.0f;
+						m_joints[v].index[k] = 0;
+						weights[k] = 0.0f;
+					} else {
+						m_joints[v].index[k] = jointRemap[joint];
+					}
+					totalWeight += weights[k];
+				}
+
+				// exporters only get the sum close to 1
+				if(totalWeight > 0.0f) {
+					for(u32 k = 0; k < 4; ++k) {
+						weights[k] /= totalWeight;
+					}
+				} else {
+					m_weights[v] = float4(1.0f, 0.0f, 0.0f, 0.0f);
+				}
+			}
+
+			if(badJoints > 0) {
+				LOG_WARN("{} has {} vertex weights on joints outside the skin, dropped them", m_filePath, badJoints);
+			}
+			LOG_INFO("loaded skin of {} with {} joints and {} clips", m_filePath, m_skeleton.JointCount(), m_clips.size());
+		} else if(skin != nullptr || !skinJoints.empty() || !m_weights.empty()) {
+			LOG_WARN("{} needs a skin, JOINTS_0 and WEIGHTS_0 to be skinned, ignoring what it has", m_filePath);
+			m_weights.clear();
+		}
+
+		if(primitive->targets_count > 0) {
+			for(cgltf_size t = 0; t < primitive->targets_count; ++t) {
+				// a target can move only normals
+				if(targetPositions[t].size() != vertices.positions.size()) {
+					targetPositions[t].assign(vertices.positions.size(), float3(0.0f, 0.0f, 0.0f));
+				}
+				const std::string name = t < mesh->target_names_count ? mesh->target_names[t] : fmt::format("target {}", t);
+				const f32 defaultWeight = t < mesh->weights_count ? mesh->weights[t] : 0.0f;
+				Morph::AddTarget(m_morphTargets, name, defaultWeight, targetPositions[t], targetNormals[t]);
+			}
+			LOG_INFO("loaded {} morph targets of {} with {} deltas in {} runs, {:.1f}% of dense", m_morphTargets.TargetCount(), m_filePath,
+				m_morphTargets.positionDeltas.size(), m_morphTargets.runs.size(),
+				100.0 * m_morphTargets.positionDeltas.size() / std::max<size_t>(1, vertices.positions.size() * primitive->targets_count));
+		}
+
+		// reorders the indices, so before the index buffer gets made
+		if (m_buildMeshlets) {
+			MeshProcessing::BuildMeshlets(vertices.positions, m_indices, m_meshlets);
+			LOG_INFO("built {} meshlets for {}", m_meshlets.size(), m_filePath);
 		}
 
-		ENSURE(m_positions.size() == m_normals.size(), "");
-		// ENSURE(m_positions.size() == m_tangents.size(), "");
-		ENSURE(m_positions.size() == m_colors.size(), "");
-		ENSURE(m_positions.size() == m_uv0s.size(), "");
-		// ENSURE(m_positions.size() == m_uv1s.size(), "");
+		ENSURE(vertices.positions.size() == vertices.normals.size(), "");
+		ENSURE(vertices.positions.size() == vertices.tangents.size(), "");
+		ENSURE(vertices.positions.size() == vertices.colors.size(), "");
+		ENSURE(vertices.positions.size() == vertices.uv0s.size(), "");
+		// ENSURE(vertices.positions.size() == vertices.uv1s.size(), "");
+		ENSURE(m_joints.empty() || vertices.positions.size() == m_joints.size(), "");
+		ENSURE(m_joints.size() == m_weights.size(), "");
 
 		cgltf_free(data);
-		spdlog::info("processed mesh {}", realPath);
+		LOG_INFO("processed mesh {}", m_filePath);
 	}
 
+	ComputeBounds(vertices.positions);
+	PackStreams(vertices);
+
 	state = AssetState::Loaded;
 
 	InitRendererResource();
 }
 
+void MeshAsset::ComputeBounds(std::span<const float3> positions)
+{
+	if (positions.empty()) {
+		m_boundsMin = float3(0.0f, 0.0f, 0.0f);
+		m_boundsMax = float3(0.0f, 0.0f, 0.0f);
+		return;
+	}
+
+	m_boundsMin = positions[0];
+	m_boundsMax = positions[0];
+	for (const float3& position : positions) {
+		m_boundsMin = float3(std::min(m_boundsMin.x, position.x), std::min(m_boundsMin.y, position.y), std::min(m_boundsMin.z, position.z));
+		m_boundsMax = float3(std::max(m_boundsMax.x, position.x), std::max(m_boundsMax.y, position.y), std::max(m_boundsMax.z, position.z));
+	}
+}
+
+void MeshAsset::PackStreams(const ImportStreams& vertices)
+{
+	m_vertexCount = static_cast<u32>(vertices.positions.size());
+	m_importedVertexBytes = vertices.positions.size() * sizeof(float3) + vertices.normals.size() * sizeof(float3)
+		+ vertices.uv0s.size() * sizeof(float2) + vertices.uv1s.size() * sizeof(float2);
+
+	m_attributes.resize(static_cast<size_t>(m_vertexCount) * m_attributeLayout.Stride());
+	MeshCompression::PackAttributes(m_attributeLayout, vertices.tangents, vertices.colors, vertices.uv0s, m_vertexCount, m_attributes);
+
+	// the cpu rewrites deformed meshes every frame from floats and the renderer gets them as floats too
+	if (IsSkinned() || HasMorphTargets()) {
+		m_positionLayout = MeshCompression::PositionLayout{};
+		m_positions.assign(vertices.positions.begin(), vertices.positions.end());
+		m_normals.assign(vertices.normals.begin(), vertices.normals.end());
+		m_deformBounds = Skinning::BuildDeformBounds(m_positions, m_joints, m_weights, m_skeleton.JointCount(), m_morphTargets);
+	} else {
+		m_positionStream.resize(static_cast<size_t>(m_vertexCount) * m_positionLayout.Stride());
+		MeshCompression::PackPositions(m_positionLayout, vertices.positions, vertices.normals, m_vertexCount, m_positionStream);
+	}
+
+	if (m_attributeLayout.Stride() != MeshCompression::AttributeLayout{}.Stride()) {
+		LOG_INFO("packed attributes of {} into {} bytes a vertex", m_filePath, m_attributeLayout.Stride());
+	}
+	if (m_positionLayout.Stride() != MeshCompression::PositionLayout{}.Stride()) {
+		LOG_INFO("positions and normals of {} go to the renderer in {} bytes a vertex", m_filePath, m_positionLayout.Stride());
+	}
+}
+
+void MeshAsset::DecodePositions(u32 first, std::span<float3> positions, std::span<float3> normals) const
+{
+	if (!m_positionStream.empty()) {
+		MeshCompression::UnpackPositions(m_positionLayout, m_positionStream, first, positions, normals);
+		return;
+	}
+
+	ENSURE(first + positions.size() <= m_positions.size() && first + normals.size() <= m_normals.size(), "DecodePositions past the last vertex");
+	std::copy_n(m_positions.begin() + first, positions.size(), positions.begin());
+	std::copy_n(m_normals.begin() + first, normals.size(), normals.begin());
+}
+
+void MeshAsset::DecodeUv0s(u32 first, std::span<float2> uv0s) const
+{
+	MeshCompression::UnpackUv0s(m_attributeLayout, m_attributes, first, uv0s);
+}
+
+size_t MeshAsset::GetVertexBytes() const
+{
+	return m_positionStream.size() + m_positions.size() * sizeof(float3) + m_normals.size() * sizeof(float3) + m_attributes.size();
+}
+
 void MeshAsset::Unload()
 {
 	m_indices.clear();
 	
+	m_vertexCount = 0;
+	m_importedVertexBytes = 0;
+	m_positionStream.clear();
 	m_positions.clear();
 	m_normals.clear();
-	m_tangents.clear();
-	m_colors.clear();
-	m_uv0s.clear();
-	m_uv1s.clear();
+	m_attributes.clear();
+	m_positionLayout = MeshCompression::PositionLayout{};
+	m_attributeLayout = MeshCompression::AttributeLayout{};
+	m_joints.clear();
+	m_weights.clear();
+	m_meshlets.clear();
+	m_clips.clear();
+	m_skeleton = Animation::Skeleton{};
+	m_morphTargets = Morph::TargetSet{};
+	m_deformBounds = Skinning::DeformBounds{};
+
+	// clear keeps the memory around, and with it the tracked bytes
+	m_indices.shrink_to_fit();
+	m_positionStream.shrink_to_fit();
+	m_positions.shrink_to_fit();
+	m_normals.shrink_to_fit();
+	m_attributes.shrink_to_fit();
+	m_joints.shrink_to_fit();
+	m_weights.shrink_to_fit();
+	m_meshlets.shrink_to_fit();
+	m_clips.shrink_to_fit();
 
 	state = AssetState::Unloaded;
 }
@@ -321,28 +654,223 @@ void* MeshAsset::GetRendererResource() const
 
 void MeshAsset::InitRendererResource()
 {
-	DX11Mesh::CreateInfo createInfo = {
-		.attributesCount = m_positions.size(),
-		
-		.positions = m_positions.data(),
-		.normals = m_normals.data(),
-		.tangents = m_tangents.data(),
-		.colors = m_colors.data(),
-		.uv0s = m_uv0s.data(),
-		.uv1s = m_uv1s.data(),
-		
-		.indicesCount = m_indices.size(),
-		.indices = m_indices.data(),
-	};
-	m_rendererResource = new DX11Mesh(global::rendererSystem->GetDevice(), createInfo);
+	if (!HasRenderer()) {
+		return;
+	}
+
+	m_rendererResource = global::assetSystem->Renderer()->CreateMesh(*this);
+}
+
+#pragma region gltf skins and animations
+
+// the index of node in the skin, -1 if it isnt one of its joints
+static i32 FindSkinJoint(const cgltf_skin* skin, const cgltf_node* node)
+{
+	for(cgltf_size j = 0; j < skin->joints_count; ++j) {
+		if(skin->joints[j] == node) {
+			return static_cast<i32>(j);
+		}
+	}
+	return -1;
+}
+
+bool MeshAsset::GltfLoadSkin(const cgltf_skin* skin, TrackedVector<u16, MemoryTag::Scratch>& outRemap)
+{
+	const u32 jointCount = static_cast<u32>(skin->joints_count);
+	if(jointCount == 0 || jointCount > static_cast<u32>(std::numeric_limits<i16>::max())) {
+		LOG_ERROR("skin of {} has {} joints, not loading it", m_filePath, jointCount);
+		return false;
+	}
+	if(skin->inverse_bind_matrices != nullptr && skin->inverse_bind_matrices->count < jointCount) {
+		LOG_ERROR("skin of {} has fewer inverse bind matrices than joints, not loading it", m_filePath);
+		return false;
+	}
+
+	// the closest ancestor that is a joint and how many joints are above, nodes in between that arent
+	// joints get skipped
+	TrackedVector<i32, MemoryTag::Scratch> gltfParents(jointCount, -1);
+	TrackedVector<u32, MemoryTag::Scratch> depths(jointCount, 0);
+	bool skippedNodes = false;
+	for(u32 j = 0; j < jointCount; ++j) {
+		bool passedNode = false;
+		for(const cgltf_node* node = skin->joints[j]->parent; node != nullptr; node = node->parent) {
+			const i32 ancestor = FindSkinJoint(skin, node);
+			if(ancestor < 0) {
+				passedNode |= gltfParents[j] < 0;
+				continue;
+			}
+			if(gltfParents[j] < 0) {
+				gltfParents[j] = ancestor;
+				skippedNodes |= passedNode;
+			}
+			++depths[j];
+		}
+	}
+	if(skippedNodes) {
+		LOG_WARN("skin of {} has nodes between its joints, their transforms are ignored", m_filePath);
+	}
+
+	// parents before children, glTF doesnt promise any order
+	TrackedVector<u32, MemoryTag::Scratch> order(jointCount);
+	for(u32 j = 0; j < jointCount; ++j) {
+		order[j] = j;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](u32 a, u32 b) { return depths[a] < depths[b]; });
+
+	outRemap.resize(jointCount);
+	for(u32 j = 0; j < jointCount; ++j) {
+		outRemap[order[j]] = static_cast<u16>(j);
+	}
+
+	TrackedVector<float4x4, MemoryTag::Scratch> inverseBindMatrices(jointCount, m_skeleton.rootTransform);
+	if(skin->inverse_bind_matrices != nullptr) {
+		// glTF matrices are column major for column vectors, read row major that is the row vector one
+		(void)cgltf_accessor_unpack_floats(skin->inverse_bind_matrices, &inverseBindMatrices[0].m[0][0], 16 * jointCount);
+	}
+
+	m_skeleton.parents.resize(jointCount);
+	m_skeleton.inverseBindMatrices.resize(jointCount);
+	m_skeleton.restPose.resize(Animation::PacketCount(jointCount));
+
+	// padding lanes included
+	for(u32 j = 0; j < m_skeleton.restPose.size() * Animation::PacketWidth; ++j) {
+		float3 translation = float3(0.0f, 0.0f, 0.0f);
+		float4 rotation = float4(0.0f, 0.0f, 0.0f, 1.0f);
+		float3 scale = float3(1.0f, 1.0f, 1.0f);
+
+		if(j < jointCount) {
+			const u32 gltfJoint = order[j];
+			const cgltf_node* node = skin->joints[gltfJoint];
+			m_skeleton.parents[j] = gltfParents[gltfJoint] < 0 ? -1 : static_cast<i16>(outRemap[gltfParents[gltfJoint]]);
+			m_skeleton.inverseBindMatrices[j] = inverseBindMatrices[gltfJoint];
+
+			if(node->has_matrix) {
+				vec4 s, r, t;
+				DirectX::XMMatrixDecompose(&s, &r, &t, DirectX::XMLoadFloat4x4(reinterpret_cast<const float4x4*>(node->matrix)));
+				DirectX::XMStoreFloat3(&translation, t);
+				DirectX::XMStoreFloat4(&rotation, r);
+				DirectX::XMStoreFloat3(&scale, s);
+			} else {
+				if(node->has_translation) {
+					translation = float3(node->translation[0], node->translation[1], node->translation[2]);
+				}
+				if(node->has_rotation) {
+					rotation = float4(node->rotation[0], node->rotation[1], node->rotation[2], node->rotation[3]);
+				}
+				if(node->has_scale) {
+					scale = float3(node->scale[0], node->scale[1], node->scale[2]);
+				}
+			}
+		}
+
+		Animation::SetTransform(m_skeleton.restPose[j / Animation::PacketWidth], j % Animation::PacketWidth, translation, rotation, scale);
+	}
+
+	// whatever is above the roots, joints are sorted so the first one is a root
+	const cgltf_node* rootParent = skin->joints[order[0]]->parent;
+	if(rootParent != nullptr) {
+		cgltf_node_transform_world(rootParent, &m_skeleton.rootTransform.m[0][0]);
+	}
+	for(u32 j = 1; j < jointCount && m_skeleton.parents[j] < 0; ++j) {
+		if(skin->joints[order[j]]->parent != rootParent) {
+			LOG_WARN("skin of {} has roots under different nodes, using the transform above the first", m_filePath);
+			break;
+		}
+	}
+
+	return true;
+}
+
+void MeshAsset::GltfLoadAnimations(const cgltf_data* data, const cgltf_skin* skin, std::span<const u16> remap)
+{
+	TrackedVector<f32, MemoryTag::Scratch> times;
+	TrackedVector<f32, MemoryTag::Scratch> values;
+	// channels of the same animation often share their input
+	std::unordered_map<const cgltf_accessor*, u32> timesOffsets;
+
+	for(cgltf_size a = 0; a < data->animations_count; ++a) {
+		const cgltf_animation& animation = data->animations[a];
+
+		Animation::Clip clip;
+		clip.name = animation.name != nullptr ? animation.name : fmt::format("animation {}", a);
+		Animation::InitClip(m_skeleton, clip);
+		timesOffsets.clear();
+
+		u32 trackCount = 0;
+		for(cgltf_size c = 0; c < animation.channels_count; ++c) {
+			const cgltf_animation_channel& channel = animation.channels[c];
+			const i32 gltfJoint = channel.target_node != nullptr ? FindSkinJoint(skin, channel.target_node) : -1;
+			if(gltfJoint < 0) {
+				continue;
+			}
+
+			Animation::Path path;
+			switch(channel.target_path) {
+			case cgltf_animation_path_type_translation: path = Animation::Path::Translation; break;
+			case cgltf_animation_path_type_rotation: path = Animation::Path::Rotation; break;
+			case cgltf_animation_path_type_scale: path = Animation::Path::Scale; break;
+			// morph target weights arent imported
+			default: continue;
+			}
+
+			Animation::Interpolation interpolation;
+			switch(channel.sampler->interpolation) {
+			case cgltf_interpolation_type_linear: interpolation = Animation::Interpolation::Linear; break;
+			case cgltf_interpolation_type_step: interpolation = Animation::Interpolation::Step; break;
+			case cgltf_interpolation_type_cubic_spline: interpolation = Animation::Interpolation::CubicSpline; break;
+			default: continue;
+			}
+
+			const cgltf_accessor* input = channel.sampler->input;
+			const cgltf_accessor* output = channel.sampler->output;
+			const u32 keyCount = static_cast<u32>(input->count);
+			const u32 valuesPerKey = interpolation == Animation::Interpolation::CubicSpline ? 3 : 1;
+			const u32 components = path == Animation::Path::Rotation ? 4 : 3;
+			if(keyCount == 0 || output->count != static_cast<cgltf_size>(keyCount) * valuesPerKey || cgltf_num_components(output->type) != components) {
+				LOG_WARN("animation {} of {} has a channel with bad keys, skipping it", clip.name, m_filePath);
+				continue;
+			}
+
+			auto found = timesOffsets.find(input);
+			if(found == timesOffsets.end()) {
+				times.resize(keyCount);
+				(void)cgltf_accessor_unpack_floats(input, times.data(), times.size());
+				if(!std::is_sorted(times.begin(), times.end())) {
+					LOG_WARN("animation {} of {} has key times out of order, skipping a channel", clip.name, m_filePath);
+					continue;
+				}
+				found = timesOffsets.emplace(input, Animation::AddKeyTimes(clip, times)).first;
+			}
+
+			// normalized integer rotations come out as floats too
+			values.resize(output->count * components);
+			(void)cgltf_accessor_unpack_floats(output, values.data(), values.size());
+
+			Animation::SetTrack(clip, remap[gltfJoint], path, interpolation, found->second, keyCount, values);
+			++trackCount;
+		}
+
+		if(trackCount == 0) {
+			continue;
+		}
+
+		// only the compressed clip is kept, the float keys are several times bigger
+		Animation::CompressedClip& compressed = m_clips.emplace_back();
+		Animation::CompressClip(m_skeleton, clip, Animation::CompressionSettings{}, compressed);
+
+		LOG_INFO("loaded clip {} of {}, {} tracks over {:.2f}s, {} of {} keys kept", clip.name, m_filePath, trackCount, clip.duration,
+			compressed.keys.size(), clip.translations.size() + clip.rotations.size() + clip.scales.size());
+	}
 }
 
+#pragma endregion
+
 #pragma region debug print gltf file
 
 void MeshAsset::GltfPrintInfo(cgltf_data* data) {
 	for(int s = 0;s < data->scenes_count; ++s) {
 		cgltf_scene scene = data->scenes[s];
-		spdlog::info("[scene name={} nodes_count={}]", SPDLOG_PTR(scene.name), scene.nodes_count);
+		LOG_TRACE("[scene name={} nodes_count={}]", SPDLOG_PTR(scene.name), scene.nodes_count);
 	}
 	
 	GltfPrintMeshInfo(data);
@@ -355,7 +883,7 @@ void MeshAsset::GltfPrintInfo(cgltf_data* data) {
 
 	for(int a = 0; a < data->accessors_count; ++a) {
 		cgltf_accessor accessor = data->accessors[a];
-		spdlog::info("[accessor name={} comp_type={} is_sparse={}]", SPDLOG_PTR(accessor.name), SPDLOG_PTR(cgltf_component_type_strings[accessor.component_type]), accessor.is_sparse);
+		LOG_TRACE("[accessor name={} comp_type={} is_sparse={}]", SPDLOG_PTR(accessor.name), SPDLOG_PTR(cgltf_component_type_strings[accessor.component_type]), accessor.is_sparse);
 	}
 }
 
@@ -363,10 +891,10 @@ void MeshAsset::GltfPrintInfo(cgltf_data* data) {
 void MeshAsset::GltfPrintAnimationInfo(cgltf_data* data) {
 	for(int a = 0; a < data->animations_count; ++a) {
 		cgltf_animation animation = data->animations[a];
-		spdlog::info("[animation name={}]", SPDLOG_PTR(animation.name));
+		LOG_TRACE("[animation name={}]", SPDLOG_PTR(animation.name));
 
 		for(int c = 0; c < animation.channels_count; ++c) {
-			spdlog::info("[channel path_type={}]", SPDLOG_PTR(cgltf_animation_path_type_strings[animation.channels[c].target_path]));
+			LOG_TRACE("[channel path_type={}]", SPDLOG_PTR(cgltf_animation_path_type_strings[animation.channels[c].target_path]));
 		}
 	}
 }
@@ -375,14 +903,14 @@ void MeshAsset::GltfPrintMaterialInfo(cgltf_data* data) {
 	for(int m = 0;m < data->materials_count; ++m) {
 		cgltf_material material = data->materials[m];
 
-		spdlog::info("[material name={}]", SPDLOG_PTR(material.name));
+		LOG_TRACE("[material name={}]", SPDLOG_PTR(material.name));
 	}
 }
 
 void MeshAsset::GltfPrintImageInfo(cgltf_data* data) {
 	for(int i = 0;i < data->images_count; ++i) {
 		cgltf_image image = data->images[i];
-		spdlog::info("[image name={} uri={} mime_type={}]", SPDLOG_PTR(image.name), SPDLOG_PTR(image.uri), SPDLOG_PTR(image.mime_type));
+		LOG_TRACE("[image name={} uri={} mime_type={}]", SPDLOG_PTR(image.name), SPDLOG_PTR(image.uri), SPDLOG_PTR(image.mime_type));
 	}	
 }
 
@@ -390,33 +918,33 @@ void MeshAsset::GltfPrintMeshInfo(cgltf_data* data) {
 
 	for(int m = 0;m < data->meshes_count; ++m) {
 		cgltf_mesh mesh = data->meshes[m];
-		spdlog::info("[mesh name={}]", SPDLOG_PTR(mesh.name));
+		LOG_TRACE("[mesh name={}]", SPDLOG_PTR(mesh.name));
 		
 		for(int p = 0;p < mesh.primitives_count; ++p) {
 			cgltf_primitive primitive = mesh.primitives[p];
-			spdlog::info("[primitive type={}]", SPDLOG_PTR(cgltf_primitive_type_strings[primitive.type]));
+			LOG_TRACE("[primitive type={}]", SPDLOG_PTR(cgltf_primitive_type_strings[primitive.type]));
 
 			for(int a = 0; a < primitive.attributes_count; ++a) {
 				cgltf_attribute attribute = primitive.attributes[a];
-				spdlog::info("[attribute name={} index={} type={}]", SPDLOG_PTR(attribute.name), attribute.index, SPDLOG_PTR(cgltf_attribute_type_strings[attribute.type]));
+				LOG_TRACE("[attribute name={} index={} type={}]", SPDLOG_PTR(attribute.name), attribute.index, SPDLOG_PTR(cgltf_attribute_type_strings[attribute.type]));
 			}
 
-			spdlog::info("[indices name={} type={}]", SPDLOG_PTR(primitive.indices->name), SPDLOG_PTR(cgltf_component_type_strings[primitive.indices->component_type]));
+			LOG_TRACE("[indices name={} type={}]", SPDLOG_PTR(primitive.indices->name), SPDLOG_PTR(cgltf_component_type_strings[primitive.indices->component_type]));
 		}
 
 		for(int w = 0;w < mesh.weights_count; ++w) {
 			cgltf_float weight = mesh.weights[w];
-			spdlog::info("[weight value={}]", weight);
+			LOG_TRACE("[weight value={}]", weight);
 		}
 
 		for(int tn = 0; tn < mesh.target_names_count; ++tn) {
 			const char* tname = mesh.target_names[tn];
-			spdlog::info("[target name={}]", SPDLOG_PTR(tname));
+			LOG_TRACE("[target name={}]", SPDLOG_PTR(tname));
 		}
 
 		for(int e = 0;e < mesh.extensions_count; ++e) {
 			cgltf_extension extension = mesh.extensions[e];
-			spdlog::info("[extension name={}]", SPDLOG_PTR(extension.name));
+			LOG_TRACE("[extension name={}]", SPDLOG_PTR(extension.name));
 		}
 	}
 }
@@ -434,8 +962,19 @@ TextureAsset::~TextureAsset()
 
 void TextureAsset::Load()
 {
-	std::string realPath = global::assetSystem->GetRealPath(m_filePath);
-	m_data = stbi_load(realPath.data(), &m_width, &m_height, &m_numComponents, 4);
+	PROFILE_ZONE_TEXT("TextureAsset::Load", m_filePath);
+
+	FileView file = global::assetSystem->OpenFile(m_filePath);
+	if (!file) {
+		LOG_ERROR("failed opening texture {}", m_filePath);
+		return;
+	}
+
+	m_data = stbi_load_from_memory(file.Data(), static_cast<int>(file.Size()), &m_width, &m_height, &m_numComponents, 4);
+	if (m_data != nullptr) {
+		// stb allocates it, 4 components since that is what we asked for
+		MemoryTracker::TrackAlloc(MemoryTag::AssetsTexture, GetDataSize());
+	}
 	InitRendererResource();
 
 	state = AssetState::Loaded;
@@ -443,7 +982,11 @@ void TextureAsset::Load()
 
 void TextureAsset::Unload()
 {
+	if (m_data != nullptr) {
+		MemoryTracker::TrackFree(MemoryTag::AssetsTexture, GetDataSize());
+	}
 	stbi_image_free(m_data);
+	m_data = nullptr;
 }
 
 void* TextureAsset::GetRendererResource() const
@@ -453,23 +996,31 @@ void* TextureAsset::GetRendererResource() const
 
 void TextureAsset::InitRendererResource()
 {
-	DX11Texture::CreateInfo createInfo = {
-		.width = m_width,
-		.height = m_height,
-		.numComponents = m_numComponents,
-		.data = m_data,
-	};
-	m_rendererResource = new DX11Texture(global::rendererSystem->GetDevice(), createInfo);
+	if (!HasRenderer()) {
+		return;
+	}
+
+	m_rendererResource = global::assetSystem->Renderer()->CreateTexture(*this);
 }
 
 void ShaderAsset::Load()
 {
+	PROFILE_ZONE_TEXT("ShaderAsset::Load", m_filePath);
+
+	// failed to compile, it stays unloaded without a renderer resource and draws with it are skipped
+	if (HasRenderer() && blob == nullptr) {
+		return;
+	}
+
 	InitRendererResource();
 	state = AssetState::Loaded;
 }
 
 void ShaderAsset::Unload()
 {
+	MemoryTracker::Free((void*)blob);
+	blob = nullptr;
+	blobSize = 0;
 }
 
 void* ShaderAsset::GetRendererResource() const
@@ -479,32 +1030,109 @@ void* ShaderAsset::GetRendererResource() const
 
 void ShaderAsset::InitRendererResource()
 {
-	auto device = global::rendererSystem->GetDevice();
-	switch (m_kind)
-	{
-	case ShaderAsset::Kind::Invalid:
-		ENSURE(false, "");
-		break;
-	case ShaderAsset::Kind::Vertex:
-		m_rendererResource = new DX11VertexShader(device, DX11VertexShader::CreateInfo{
-				.blob = blob,
-				.blobSize = blobSize,
-			});
-		break;
-	case ShaderAsset::Kind::Pixel:
-		m_rendererResource = new DX11PixelShader(device, DX11PixelShader::CreateInfo{
-				.blob = blob,
-				.blobSize = blobSize, 
-			});
-		break;
-	default:
+	if (!HasRenderer()) {
+		return;
+	}
+
+	m_rendererResource = global::assetSystem->Renderer()->CreateShader(*this);
+}
+
+void AssetSystem::SetDataDir(std::string_view dir)
+{
+	m_dataDir = dir;
+	m_vfs.SetLooseRoot(m_dataDir.generic_string());
+
+	// shipping builds have the data dir packed into one archive, development builds just have loose files
+	const std::string packPath = GetRealPath(AssetPack::FileName);
+	if (std::filesystem::exists(packPath)) {
+		m_vfs.MountPack(packPath);
+	}
+}
+
+bool AssetCatalog::LoadManifest(std::string_view path)
+{
+	FileView file = global::assetSystem->OpenFile(path);
+	if (!file) {
+		return false;
+	}
+
+	if (!m_manifest.Load(file.Data(), file.Size())) {
+		spdlog::error("failed parsing asset catalog {}", path);
+		return false;
+	}
+
+	spdlog::info("loaded asset catalog {} with {} entries", path, m_manifest.GetEntryCount());
+
+#ifdef _DEBUG
+	// the binary form has to round trip, catches layout changes that forgot to bump the version
+	std::vector<byte> binary = m_manifest.SerializeBinary();
+	AssetManifest roundTrip;
+	ENSURE(roundTrip.ParseBinary(binary.data(), binary.size()), "");
+	ENSURE(roundTrip.SerializeBinary() == binary, "");
+#endif
+
+	return true;
+}
+
+void AssetCatalog::AddLookup(u64 pathHash, AssetType type, u32 index)
+{
+	auto [it, inserted] = m_lookup.emplace(pathHash, LookupEntry{ .type = type, .index = index });
+	if (!inserted) {
+		spdlog::error("asset path hash {:x} registered twice, keeping the first one", pathHash);
 		ENSURE(false, "");
-		break;
 	}
 }
 
+u32 AssetCatalog::Find(u64 pathHash, AssetType type) const
+{
+	auto it = m_lookup.find(pathHash);
+	if (it == m_lookup.end() || it->second.type != type) {
+		spdlog::error("no {} asset registered with path hash {:x}", AssetManifest::AssetTypeToString(type), pathHash);
+		return InvalidAssetIndex;
+	}
+	return it->second.index;
+}
+
+ShaderID AssetCatalog::RegisterShaderAsset(u64 pathHash, ShaderAsset&& asset)
+{
+	ASSERT(asset.m_key == ShaderPermutation::BaseKey, "");
+
+	m_shaderAssets.emplace_back(asset);
+	ShaderID id = { static_cast<u32>(m_shaderAssets.size() - 1) };
+	AddLookup(pathHash, AssetType::Shader, id.value);
+
+	ShaderAsset& shader = m_shaderAssets.back();
+	shader.m_variants.Reset(shader.m_features.Mask());
+	shader.m_variants.Set(ShaderPermutation::BaseKey, id.value);
+	return id;
+}
+
+ShaderID AssetCatalog::RegisterShaderVariant(ShaderID base, ShaderAsset&& asset)
+{
+	ENSURE(base.value < m_shaderAssets.size(), "");
+	ASSERT(asset.m_key != ShaderPermutation::BaseKey && m_shaderAssets[base.value].m_features.IsValid(asset.m_key), "");
+
+	m_shaderAssets.emplace_back(asset);
+	ShaderID id = { static_cast<u32>(m_shaderAssets.size() - 1) };
+	m_shaderAssets[base.value].m_variants.Set(asset.m_key, id.value);
+	return id;
+}
+
+static ShaderAsset::Kind ShaderKindFromString(std::string_view str)
+{
+	if (str == "vertex") {
+		return ShaderAsset::Kind::Vertex;
+	}
+	if (str == "pixel") {
+		return ShaderAsset::Kind::Pixel;
+	}
+	return ShaderAsset::Kind::Invalid;
+}
+
 void AssetSystem::RegisterAssets()
 {
+	PROFILE_FUNCTION();
+
 	// engine meshes, used by engine systems like the renderer
 	{
 		std::vector<float3> m_quadMeshPositions = {
@@ -524,7 +1152,7 @@ void AssetSystem::RegisterAssets()
 			0, 3, 1
 		};
 
-		MeshID id = m_catalog->RegisterMeshAsset(MeshAsset(
+		MeshID id = m_catalog->RegisterMeshAsset(HashPath(EngineQuadMeshPath), MeshAsset(
 			std::move(m_quadMeshPositions),
 			{/* normal */}, 
 			{/* tangent */}, 
@@ -537,84 +1165,105 @@ void AssetSystem::RegisterAssets()
 		asset.Load();
 	}
 
-	// @TODO: upload thr render resources of the assets after the renderer is initialised
-	// @TODO: currently we dont unload anything, there needs to be a system that decides on scene transition, 
-	// or something more dynamic that loads and unloads resources from disk
+	// prefer the cooked binary catalog, fall back to the text source in development
 	{
-		// MeshID id = m_catalog->RegisterMeshAsset(MeshAsset("meshes/quad.glb"));
-		// MeshAsset& asset = const_cast<MeshAsset&>(m_catalog->GetMeshAsset(id));
-		// asset.Load();
-	}
+		const std::string_view catalogPath = FileExists("catalog.bin") ? "catalog.bin" : "catalog.txt";
 
-	{
-		MeshID id = m_catalog->RegisterMeshAsset(MeshAsset("meshes/suzanne.glb"));
-		MeshAsset& asset = const_cast<MeshAsset&>(m_catalog->GetMeshAsset(id));
-		asset.Load();
+		if (!m_catalog->LoadManifest(catalogPath)) {
+			spdlog::critical("failed loading asset catalog {}", catalogPath);
+			return;
+		}
 	}
 
-	{
-		MeshID id = m_catalog->RegisterMeshAsset(MeshAsset("meshes/two_cubes.glb"));
-		MeshAsset& asset = const_cast<MeshAsset&>(m_catalog->GetMeshAsset(id));
-		asset.Load();
-	}
+	// @TODO: upload thr render resources of the assets after the renderer is initialised
+	// @TODO: currently we dont unload anything, there needs to be a system that decides on scene transition, 
+	// or something more dynamic that loads and unloads resources from disk
+	const AssetManifest& manifest = m_catalog->GetManifest();
+	// compiled together once everything is registered
+	std::vector<ShaderID> shaders;
+	for (u32 i = 0; i < manifest.GetEntryCount(); ++i) {
+		const AssetManifest::Entry& entry = manifest.GetEntry(i);
+		const std::string_view path = manifest.GetPath(entry);
+
+		switch (entry.type) {
+		case AssetType::Mesh: {
+			const bool buildMeshlets = manifest.GetSetting(entry, "meshlets", "false") == "true";
+			MeshID id = m_catalog->RegisterMeshAsset(entry.pathHash, MeshAsset(path, buildMeshlets));
+			MeshAsset& asset = const_cast<MeshAsset&>(m_catalog->GetMeshAsset(id));
+			asset.Load();
+			if (asset.state == AssetState::Loaded) {
+				asset.SetMaterial(m_catalog->RegisterMaterial(asset.GetMaterialDesc()));
+			}
+		} break;
+		case AssetType::Shader: {
+			std::vector<ShaderMacro> defines;
+			ShaderPermutation::FeatureSet features;
+			bool validFeatures = true;
+			for (const AssetManifest::Setting& setting : manifest.GetSettings(entry)) {
+				constexpr std::string_view definePrefix = "define.";
+				constexpr std::string_view featurePrefix = "feature.";
+				std::string_view key = manifest.GetString(setting.keyOffset);
+				std::string_view value = manifest.GetString(setting.valueOffset);
+				if (key.starts_with(definePrefix)) {
+					// strings in the manifest are null terminated, so the suffix of the key is a valid c string
+					defines.push_back(ShaderMacro{
+						.name = key.data() + definePrefix.size(),
+						.definition = value.data(),
+					});
+				} else if (key.starts_with(featurePrefix)) {
+					u32 bit = ShaderPermutation::MaxFeatures;
+					const std::from_chars_result parsed = std::from_chars(value.data(), value.data() + value.size(), bit);
+					if (parsed.ec != std::errc() || parsed.ptr != value.data() + value.size() || !features.Add(key.substr(featurePrefix.size()), bit)) {
+						spdlog::error("shader {} has an invalid feature {}={}, bits go up to {} and each is used once", path, key, value, ShaderPermutation::MaxFeatures - 1);
+						validFeatures = false;
+					}
+				}
+			}
 
-	{
-		MeshID id = m_catalog->RegisterMeshAsset(MeshAsset("meshes/scene1.glb"));
-		MeshAsset& asset = const_cast<MeshAsset&>(m_catalog->GetMeshAsset(id));
-		asset.Load();
-	}
+			// with a feature dropped materials that need it would silently draw without it, so the shader isnt registered at all
+			if (!validFeatures) {
+				continue;
+			}
 
-	{
-		// 0
-		ShaderID id = m_catalog->RegisterShaderAsset(ShaderAsset(ShaderAsset::Kind::Vertex, L"shaders/simple_vs.hlsl", "VSMain", "vs_5_0"));
-		global::rendererSystem->shaderCompiler->CompileShaderAsset(id);
-		ShaderAsset& asset = const_cast<ShaderAsset&>(m_catalog->GetShaderAsset(id));
-		asset.Load();
-	}
+			const ShaderAsset::Kind kind = ShaderKindFromString(manifest.GetSetting(entry, "kind"));
+			if (kind == ShaderAsset::Kind::Invalid) {
+				spdlog::error("shader {} has no valid kind set in the catalog", path);
+				continue;
+			}
 
-	{
-		// 1
-		ShaderID id = m_catalog->RegisterShaderAsset(ShaderAsset(ShaderAsset::Kind::Pixel, L"shaders/simple_ps.hlsl", "PSMain", "ps_5_0"));
-		global::rendererSystem->shaderCompiler->CompileShaderAsset(id);
-		ShaderAsset& asset = const_cast<ShaderAsset&>(m_catalog->GetShaderAsset(id));
-		asset.Load();
-	}
+			const std::string_view entryFunc = manifest.GetSetting(entry, "entry", "main");
+			const std::string_view target = manifest.GetSetting(entry, "target");
 
-	{
-		// 2
-		ShaderID id = m_catalog->RegisterShaderAsset(ShaderAsset(ShaderAsset::Kind::Vertex, L"shaders/simple_deferred_vs.hlsl", "VSMain", "vs_5_0"));
-		global::rendererSystem->shaderCompiler->CompileShaderAsset(id);
-		ShaderAsset& asset = const_cast<ShaderAsset&>(m_catalog->GetShaderAsset(id));
-		asset.Load();
-	}
+			ShaderID baseId = m_catalog->RegisterShaderAsset(entry.pathHash, ShaderAsset(kind, path, entryFunc, target, defines, features));
+			// every other combination of the features right after, ids of a shader stay contiguous
+			features.ForEachKey([&](ShaderPermutation::Key key) {
+				if (key != ShaderPermutation::BaseKey) {
+					m_catalog->RegisterShaderVariant(baseId, ShaderAsset(kind, path, entryFunc, target, defines, features, key));
+				}
+			});
 
-	{
-		// 3
-		ShaderID id = m_catalog->RegisterShaderAsset(ShaderAsset(ShaderAsset::Kind::Pixel, L"shaders/simple_deferred_ps.hlsl", "PSMain", "ps_5_0"));
-		global::rendererSystem->shaderCompiler->CompileShaderAsset(id);
-		ShaderAsset& asset = const_cast<ShaderAsset&>(m_catalog->GetShaderAsset(id));
-		asset.Load();
+			for (u32 id = baseId.value; id < baseId.value + features.VariantCount(); ++id) {
+				shaders.push_back(ShaderID{ id });
+			}
+		} break;
+		case AssetType::Texture: {
+			TextureID id = m_catalog->RegisterTextureAsset(entry.pathHash, TextureAsset(path));
+			TextureAsset& asset = const_cast<TextureAsset&>(m_catalog->GetTextureAsset(id));
+			asset.Load();
+		} break;
+		default:
+			UNREACHABLE("");
+			break;
+		}
 	}
 
-	{
-		// 4
-		ShaderID id = m_catalog->RegisterShaderAsset(ShaderAsset(ShaderAsset::Kind::Vertex, L"shaders/final_deferred_pass_vs.hlsl", "VSMain", "vs_5_0"));
-		global::rendererSystem->shaderCompiler->CompileShaderAsset(id);
-		ShaderAsset& asset = const_cast<ShaderAsset&>(m_catalog->GetShaderAsset(id));
-		asset.Load();
+	// the compiler belongs to the renderer, headless shaders stay registered without a blob
+	// every shader and variant of the catalog in one batch across the workers, D3DCompile is thread safe
+	if (HasRenderer()) {
+		m_renderer->CompileShaders(shaders);
 	}
-
-	{
-		// 5
-		ShaderID id = m_catalog->RegisterShaderAsset(ShaderAsset(ShaderAsset::Kind::Pixel, L"shaders/final_deferred_pass_ps.hlsl", "PSMain", "ps_5_0"));
-		global::rendererSystem->shaderCompiler->CompileShaderAsset(id);
+	for (ShaderID id : shaders) {
 		ShaderAsset& asset = const_cast<ShaderAsset&>(m_catalog->GetShaderAsset(id));
 		asset.Load();
 	}
-
-	{
-		TextureID id = m_catalog->RegisterTextureAsset(TextureAsset("textures/checker.png"));
-		TextureAsset& asset = const_cast<TextureAsset&>(m_catalog->GetTextureAsset(id));
-		asset.Load();
-	}
 }
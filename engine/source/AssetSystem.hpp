@@ -2,6 +2,16 @@
 
 #include "Basic.hpp"
 #include "Math.hpp"
+#include "AssetManifest.hpp"
+#include "AnimationCompression.hpp"
+#include "Material.hpp"
+#include "MeshCompression.hpp"
+#include "MeshProcessing.hpp"
+#include "Morph.hpp"
+#include "Skinning.hpp"
+#include "ShaderPermutation.hpp"
+#include "VirtualFileSystem.hpp"
+#include "Core/MemoryTracker.hpp"
 
 #include <stb/stb_image.h>
 
@@ -18,6 +28,7 @@ class Asset;
 class MeshAsset;
 class ShaderAsset;
 class TextureAsset;
+class AssetRenderer;
 
 class DX11Mesh;
 class DX11Texture;
@@ -31,7 +42,7 @@ class AssetSystem {
 public:
 	AssetSystem() {
 		spdlog::info("AssetSystem init");
-		m_catalog = std::make_unique<AssetCatalog>("");
+		m_catalog = std::make_unique<AssetCatalog>();
 	}
 	~AssetSystem() {
 		spdlog::info("AssetSystem de-init");
@@ -46,7 +57,18 @@ public:
 		return m_dataDir.generic_string();
 	}
 
+	// opens an asset by its virtual path (relative to dataDir), from the mounted pack if there is one
+	// otherwise from the loose file on disk, doesnt allocate
+	inline FileView OpenFile(std::string_view path) const {
+		return m_vfs.Open(path);
+	}
+
+	inline bool FileExists(std::string_view path) const {
+		return m_vfs.Exists(path);
+	}
+
 	// converts an assets virtual path (relative to dataDir) to a real path on disk
+	// prefer OpenFile, this only makes sense for loose files
 	// @TODO: this allocates memory, make it not do that, use allocator
 	// this is temporary
 	inline std::string GetRealPath(std::string_view path)
@@ -66,50 +88,93 @@ public:
 		return realPath.generic_wstring();
 	}
 
-private:
-	inline void SetDataDir(std::string_view dir) {
-		m_dataDir = dir;
-	}
+	// before RegisterAssets, by whatever owns the process (Application, the tools)
+	void SetDataDir(std::string_view dir);
+
+	// before RegisterAssets, assets loaded without a renderer only have their cpu side
+	inline void SetRenderer(AssetRenderer* renderer) { m_renderer = renderer; }
+	inline AssetRenderer* Renderer() const { return m_renderer; }
 
 private:
 	std::filesystem::path m_dataDir = "data";
+	VirtualFileSystem m_vfs;
 	std::unique_ptr<AssetCatalog> m_catalog = nullptr;
-
-	// only allow Application to set the data directory
-	friend class Application;
+	AssetRenderer* m_renderer = nullptr;
 };
 
 DECL_ASSET_ID(MeshID, u32);
 DECL_ASSET_ID(ShaderID, u32);
 DECL_ASSET_ID(TextureID, u32);
+// an index into the deduplicated materials of the catalog, and into the material structured buffer
+DECL_ASSET_ID(MaterialID, u32);
+
+// makes the gpu side of the assets, the renderer sets itself on AssetSystem once it has a device
+// headless runs, the tools and the tests never have one, their assets load the cpu side only and
+// GetRendererResource stays null, so the asset code itself builds without any graphics api
+class AssetRenderer {
+public:
+	virtual ~AssetRenderer() = default;
+
+	virtual DX11Mesh* CreateMesh(const MeshAsset& asset) = 0;
+	virtual DX11Texture* CreateTexture(const TextureAsset& asset) = 0;
+	// null for shaders without a blob
+	virtual DX11ShaderBase* CreateShader(const ShaderAsset& asset) = 0;
+
+	// every shader and variant of the catalog in one batch, the blobs are written back to the assets
+	// false if any failed to compile
+	virtual bool CompileShaders(std::span<const ShaderID> shaders) = 0;
+};
+
+// index value used by the asset ids when a lookup fails
+constexpr u32 InvalidAssetIndex = std::numeric_limits<u32>::max();
+
+// virtual paths of assets that the engine builds in code instead of reading from the data dir
+constexpr std::string_view EngineQuadMeshPath = "engine/meshes/quad";
+
+// see Material::DefaultDesc, for meshes that dont have a material
+constexpr MaterialID DefaultMaterial = { 0 };
 
 class AssetCatalog {
 public:
-	// @TODO: catalog file read
-	AssetCatalog(std::string_view catalogPath, int initialCount = 128) {
+	AssetCatalog(int initialCount = 128) {
 		m_meshAssets.reserve(initialCount);
 		m_shaderAssets.reserve(initialCount);
 		m_textureAssets.reserve(initialCount);
+		m_lookup.reserve(initialCount);
+
+		m_materials.Add(Material::DefaultDesc());
 	}
 
+	// reads the catalog manifest, does not register or load anything by itself
+	bool LoadManifest(std::string_view path);
+
+	inline const AssetManifest& GetManifest() const { return m_manifest; }
+
 	// @TODO: mesh asset is not shallow copyable, make them shallow copyable
-	MeshID RegisterMeshAsset(MeshAsset&& asset) 
+	MeshID RegisterMeshAsset(u64 pathHash, MeshAsset&& asset) 
 	{
 		m_meshAssets.emplace_back(asset);
-		MeshID id = { m_meshAssets.size() - 1 };
+		MeshID id = { static_cast<u32>(m_meshAssets.size() - 1) };
+		AddLookup(pathHash, AssetType::Mesh, id.value);
 		return id;
 	}
-	ShaderID RegisterShaderAsset(ShaderAsset&& asset)
+	// the base variant of the shader, with every feature off
+	ShaderID RegisterShaderAsset(u64 pathHash, ShaderAsset&& asset);
+	// variants share the path of their base shader, so they are only reachable through FindShaderVariant
+	ShaderID RegisterShaderVariant(ShaderID base, ShaderAsset&& asset);
+	TextureID RegisterTextureAsset(u64 pathHash, TextureAsset&& asset)
 	{
-		m_shaderAssets.emplace_back(asset);
-		ShaderID id = { m_shaderAssets.size() - 1 };
+		m_textureAssets.emplace_back(asset);
+		TextureID id = { static_cast<u32>(m_textureAssets.size() - 1) };
+		AddLookup(pathHash, AssetType::Texture, id.value);
 		return id;
 	}
-	TextureID RegisterTextureAsset(TextureAsset&& asset)
+
+	// materials come out of mesh files instead of the catalog, the id of one with the same content if
+	// there is one already
+	MaterialID RegisterMaterial(const Material::Desc& desc)
 	{
-		m_textureAssets.emplace_back(asset);
-		TextureID id = { m_textureAssets.size() - 1 };
-		return id;
+		return MaterialID{ m_materials.Add(desc) };
 	}
 
 	const MeshAsset& GetMeshAsset(MeshID id) const 
@@ -127,11 +192,50 @@ public:
 		ENSURE(id.value >= 0 && id.value < m_textureAssets.size(), "");
 		return m_textureAssets[id.value];
 	}
+	const Material::Desc& GetMaterial(MaterialID id) const
+	{
+		ENSURE(id.value < m_materials.Count(), "");
+		return m_materials.Get(id.value);
+	}
+
+	inline u32 GetMaterialCount() const { return m_materials.Count(); }
+	// indexed by MaterialID, only ever grows so a renderer can tell from the size whether to upload it again
+	inline std::span<const Material::Constants> GetMaterialConstants() const { return m_materials.GetConstants(); }
+
+	// O(1) lookups by the hash of the virtual path, use HashPath on a literal to hash at compile time
+	// returns an id with value InvalidAssetIndex if nothing of that type is registered at that path
+	inline MeshID FindMeshAsset(u64 pathHash) const { return MeshID{ Find(pathHash, AssetType::Mesh) }; }
+	inline ShaderID FindShaderAsset(u64 pathHash) const { return ShaderID{ Find(pathHash, AssetType::Shader) }; }
+	inline TextureID FindTextureAsset(u64 pathHash) const { return TextureID{ Find(pathHash, AssetType::Texture) }; }
+
+	inline MeshID FindMeshAsset(std::string_view path) const { return FindMeshAsset(HashPath(path)); }
+	inline ShaderID FindShaderAsset(std::string_view path) const { return FindShaderAsset(HashPath(path)); }
+	inline TextureID FindTextureAsset(std::string_view path) const { return FindTextureAsset(HashPath(path)); }
+
+	// O(1), the variant of a shader compiled with the features in key, see ShaderPermutation
+	// returns an id with value InvalidAssetIndex if the shader has no such variant
+	inline ShaderID FindShaderVariant(ShaderID base, ShaderPermutation::Key key) const;
+
+private:
+	void AddLookup(u64 pathHash, AssetType type, u32 index);
+	u32 Find(u64 pathHash, AssetType type) const;
 
 private:
 	std::vector<MeshAsset> m_meshAssets;
 	std::vector<ShaderAsset> m_shaderAssets;
 	std::vector<TextureAsset> m_textureAssets;
+	Material::Library m_materials;
+
+	struct LookupEntry {
+		AssetType type = AssetType::Invalid;
+		u32 index = InvalidAssetIndex;
+	};
+
+	// path hash -> registered asset
+	std::unordered_map<u64, LookupEntry, IdentityHash> m_lookup;
+
+	// owns the strings that the registered assets file paths point into
+	AssetManifest m_manifest;
 };
 
 
@@ -160,14 +264,16 @@ protected:
 };
 
 struct cgltf_data;
+struct cgltf_skin;
 
 class MeshAsset : public Asset {
 public:
-	MeshAsset(std::string_view filePath);
+	// buildMeshlets splits the mesh for cluster culling on load, meshlets=true in the catalog
+	MeshAsset(std::string_view filePath, bool buildMeshlets = false);
 	MeshAsset(
 		const std::vector<float3>&& positions,
 		const std::vector<float3>&& normals, 
-		const std::vector<float3>&& tangents,
+		const std::vector<float4>&& tangents,
 		const std::vector<float3>&& colors,
 		const std::vector<float2>&& uv0s,
 		const std::vector<float2>&& uv1s,
@@ -175,21 +281,89 @@ public:
 
 	virtual void Load() override;
 	virtual void Unload() override;
+	// null when running headless, same for every asset type
 	void* GetRendererResource() const;
 	void InitRendererResource();
 
-	inline const std::vector<float3>& GetPositions() { return m_positions; }
-	inline const std::vector<float3>& GetNormals() { return m_normals; }
-	inline const std::vector<float3>& GetTangents() { return m_tangents; }
-	inline const std::vector<float3>& GetColors() { return m_colors; }
-	inline const std::vector<float2>& GetUV0s() { return m_uv0s; }
-	inline const std::vector<float2>& GetUV1s() { return m_uv1s; }
-	inline const std::vector<u32>& GetIndices() { return m_indices; }
+	// vertex data counts against the mesh memory budget
+	template<typename T>
+	using MeshData = TrackedVector<T, MemoryTag::AssetsMesh>;
+
+	inline u32 GetVertexCount() const { return m_vertexCount; }
+	// the formats positions and normals go to the renderer in, those of the file for quantized ones and
+	// floats for skinned and morphed meshes
+	inline const MeshCompression::PositionLayout& GetPositionLayout() const { return m_positionLayout; }
+	// positions and normals interleaved in the position layout, empty for skinned and morphed meshes, they
+	// keep the floats below instead
+	inline const MeshData<u8>& GetPositionStream() const { return m_positionStream; }
+	// the bind pose of the meshes the cpu deforms every frame, empty for static meshes
+	inline const MeshData<float3>& GetPositions() const { return m_positions; }
+	inline const MeshData<float3>& GetNormals() const { return m_normals; }
+	// tangents, colors and uv0s interleaved for the renderer, in the integer formats of quantized files
+	// tangents are xyz along +u and w the sign of the bitangent, see MeshProcessing::GenerateTangents
+	inline const MeshCompression::AttributeLayout& GetAttributeLayout() const { return m_attributeLayout; }
+	inline const MeshData<u8>& GetAttributes() const { return m_attributes; }
+	inline const MeshData<u32>& GetIndices() const { return m_indices; }
+
+	// floats of vertices first to first + out.size() into memory of the caller, for static and deformed meshes
+	// alike, the same floats the file had, either span can be empty
+	void DecodePositions(u32 first, std::span<float3> positions, std::span<float3> normals) const;
+	void DecodeUv0s(u32 first, std::span<float2> uv0s) const;
+
+	// the vertex streams kept after Load, and what the float positions, normals and uvs took while importing
+	size_t GetVertexBytes() const;
+	inline size_t GetImportedVertexBytes() const { return m_importedVertexBytes; }
+	// empty unless built on load, the indices are in meshlet order then
+	inline const MeshData<MeshProcessing::Meshlet>& GetMeshlets() const { return m_meshlets; }
+
+	// empty unless the file has a skin for the mesh, joints index the skeleton and weights add up to 1
+	inline bool IsSkinned() const { return !m_joints.empty(); }
+	inline const MeshData<Animation::JointIndices>& GetJoints() const { return m_joints; }
+	inline const MeshData<float4>& GetWeights() const { return m_weights; }
+	inline const Animation::Skeleton& GetSkeleton() const { return m_skeleton; }
+	// every animation of the file that moves a joint of the skeleton, compressed on load
+	inline const Animation::Data<Animation::CompressedClip>& GetClips() const { return m_clips; }
+
+	// empty unless the first primitive has targets, deltas are against the welded vertices
+	inline bool HasMorphTargets() const { return !m_morphTargets.Empty(); }
+	inline const Morph::TargetSet& GetMorphTargets() const { return m_morphTargets; }
+	// skinned and morphed meshes, what the scene culls them by instead of deforming them
+	inline const Skinning::DeformBounds& GetDeformBounds() const { return m_deformBounds; }
+
+	// model space box around the positions, worked out on load
+	inline const float3& GetBoundsMin() const { return m_boundsMin; }
+	inline const float3& GetBoundsMax() const { return m_boundsMax; }
+
+	// the material of the first primitive as imported, AssetSystem registers it with the catalog after Load
+	inline const Material::Desc& GetMaterialDesc() const { return m_materialDesc; }
+	inline MaterialID GetMaterial() const { return m_material; }
+	inline void SetMaterial(MaterialID material) { m_material = material; }
 
 private:
+	// floats while importing, gone once the streams are packed
+	struct ImportStreams {
+		template<typename T>
+		using Data = TrackedVector<T, MemoryTag::Scratch>;
+
+		Data<float3> positions;
+		Data<float3> normals;
+		Data<float4> tangents;
+		Data<float3> colors;
+		Data<float2> uv0s;
+		Data<float2> uv1s;
+	};
+
+	void ComputeBounds(std::span<const float3> positions);
+	// interleaves the import streams into the position stream (floats for deformed meshes) and m_attributes
+	void PackStreams(const ImportStreams& vertices);
+
 	// @TODO: move this stuff to gltf importer
 	void GltfPrintInfo(cgltf_data* data);
 
+	// the skeleton from the skin, outRemap takes a glTF joint index to the skeleton one
+	bool GltfLoadSkin(const cgltf_skin* skin, TrackedVector<u16, MemoryTag::Scratch>& outRemap);
+	void GltfLoadAnimations(const cgltf_data* data, const cgltf_skin* skin, std::span<const u16> remap);
+
 	void GltfPrintMeshInfo(cgltf_data* data);
 	void GltfPrintAnimationInfo(cgltf_data* data);
 	void GltfPrintMaterialInfo(cgltf_data* data);
@@ -200,14 +374,36 @@ private:
 	// @TODO: store vertices in SOA
 	//std::vector<Vertex> m_vertices;
 	
-	std::vector<u32> m_indices;
+	MeshData<u32> m_indices;
+
+	// meshes built in code hand their vertices over here, Load packs them like those of a file
+	ImportStreams m_import;
+
+	u32 m_vertexCount = 0;
+	size_t m_importedVertexBytes = 0;
+	MeshCompression::PositionLayout m_positionLayout;
+	MeshData<u8> m_positionStream;
+	MeshData<float3> m_positions;
+	MeshData<float3> m_normals;
+	MeshCompression::AttributeLayout m_attributeLayout;
+	MeshData<u8> m_attributes;
 
-	std::vector<float3> m_positions;
-	std::vector<float3> m_normals;
-	std::vector<float3> m_tangents;
-	std::vector<float3> m_colors;
-	std::vector<float2> m_uv0s;
-	std::vector<float2> m_uv1s;
+	MeshData<Animation::JointIndices> m_joints;
+	MeshData<float4> m_weights;
+	Animation::Skeleton m_skeleton;
+	Animation::Data<Animation::CompressedClip> m_clips;
+
+	Morph::TargetSet m_morphTargets;
+	Skinning::DeformBounds m_deformBounds;
+
+	bool m_buildMeshlets = false;
+	MeshData<MeshProcessing::Meshlet> m_meshlets;
+
+	float3 m_boundsMin = float3(0.0f, 0.0f, 0.0f);
+	float3 m_boundsMax = float3(0.0f, 0.0f, 0.0f);
+
+	Material::Desc m_materialDesc;
+	MaterialID m_material = DefaultMaterial;
 
 	DX11Mesh* m_rendererResource = nullptr;
 };
@@ -226,6 +422,7 @@ public:
 	inline int GetHeight() const { return m_height; }
 	inline int GetNumComponents() const { return m_numComponents; }
 	inline const byte* GetData() const { return m_data; }
+	inline size_t GetDataSize() const { return static_cast<size_t>(m_width) * m_height * 4; }
 	
 private:
 	std::string_view m_filePath;
@@ -240,12 +437,6 @@ private:
 };
 
 
-struct ShaderMacro
-{
-	const char* name;
-	const char* definition;
-};
-
 class ShaderAsset : public Asset {
 
 public:
@@ -257,29 +448,49 @@ public:
 		Num
 	};
 
-	ShaderAsset(Kind kind, std::wstring_view filePath, std::string_view entryFunc, std::string_view target, const std::vector<ShaderMacro>& defines = {})
-		: m_kind(kind), m_filePath(filePath), m_entryFunc(entryFunc), m_target(target), m_defines(defines) {}
+	// defines are the ones every variant gets, the features of key are appended as NAME=1 or NAME=0
+	ShaderAsset(Kind kind, std::string_view filePath, std::string_view entryFunc, std::string_view target, const std::vector<ShaderMacro>& defines = {},
+		const ShaderPermutation::FeatureSet& features = {}, ShaderPermutation::Key key = ShaderPermutation::BaseKey)
+		: m_kind(kind), m_filePath(filePath), m_entryFunc(entryFunc), m_target(target), m_defines(defines), m_features(features), m_key(key)
+	{
+		m_features.GetDefines(m_key, m_defines);
+	}
 
 	virtual void Load() override;
 	virtual void Unload() override;
 	void* GetRendererResource() const;
 	void InitRendererResource();
 
-	inline std::wstring_view GetFilePath() const { return m_filePath; }
+	inline std::string_view GetFilePath() const { return m_filePath; }
 	inline std::string_view GetEntryFunc() const { return m_entryFunc; }
 	inline std::string_view GetTarget() const { return m_target; }
 	inline const std::vector<ShaderMacro>& GetDefines() const { return m_defines; }
+	inline const ShaderPermutation::FeatureSet& GetFeatures() const { return m_features; }
+	inline ShaderPermutation::Key GetKey() const { return m_key; }
+	inline Kind GetKind() const { return m_kind; }
+	// key -> ShaderID of the variant, only filled in on the base shader
+	inline const ShaderPermutation::VariantTable& GetVariants() const { return m_variants; }
 
 public:
 	const byte* blob = nullptr;
 	size_t blobSize = 0;
 
 private:
-	std::wstring_view m_filePath = L"";
+	std::string_view m_filePath = "";
 	std::string_view m_entryFunc = "";
 	std::string_view m_target = "";
 	std::vector<ShaderMacro> m_defines;
+	ShaderPermutation::FeatureSet m_features;
+	ShaderPermutation::Key m_key = ShaderPermutation::BaseKey;
+	ShaderPermutation::VariantTable m_variants;
 	Kind m_kind = Kind::Invalid;
 
 	DX11ShaderBase* m_rendererResource = nullptr;
+
+	friend class AssetCatalog;
 };
+
+inline ShaderID AssetCatalog::FindShaderVariant(ShaderID base, ShaderPermutation::Key key) const
+{
+	return ShaderID{ GetShaderAsset(base).GetVariants().Find(key) };
+}
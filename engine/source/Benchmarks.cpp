@@ -0,0 +1,77 @@
+#include "Benchmarks.hpp"
+
+#include "AssetSystem.hpp"
+#include "Core/FrameStats.hpp"
+#include "Core/JobSystem.hpp"
+#include "Core/Log.hpp"
+#include "Core/MemoryTracker.hpp"
+#include "ClusteredLighting.hpp"
+#include "OcclusionCulling.hpp"
+#include "ClusterCulling.hpp"
+#include "Animation.hpp"
+#include "Skinning.hpp"
+#include "Morph.hpp"
+#include "MeshCompression.hpp"
+#include "Material.hpp"
+#include "ShaderPermutation.hpp"
+#include "ShaderBatch.hpp"
+#include "MathBatch.hpp"
+#include "MeshProcessing.hpp"
+#include "FrameLoop.hpp"
+
+// the catalog of the data dir, AssetManifest itself is also built into the tools that dont have an AssetSystem
+static bool RunManifestBenchmark()
+{
+	return AssetManifest::RunBenchmark(global::assetSystem->GetRealPath("catalog.txt"));
+}
+
+static const Benchmarks::Entry s_entries[] = {
+	{ .name = "jobs", .run = JobSystem::RunBenchmark },
+	{ .name = "log", .run = Log::RunBenchmark },
+	{ .name = "frame_stats", .run = FrameStats::RunBenchmark },
+	{ .name = "memory", .run = MemoryTracker::RunBenchmark },
+	{ .name = "clustering", .run = ClusteredLighting::RunBenchmark },
+	{ .name = "occlusion", .run = OcclusionCulling::RunBenchmark },
+	{ .name = "math", .run = MathBatch::RunBenchmark },
+	// suzanne from the catalog
+	{ .name = "mesh", .run = MeshProcessing::RunBenchmark, .needsAssets = true },
+	{ .name = "clusters", .run = ClusterCulling::RunBenchmark, .needsAssets = true },
+	{ .name = "animation", .run = Animation::RunBenchmark },
+	{ .name = "skinning", .run = Skinning::RunBenchmark },
+	{ .name = "morph", .run = Morph::RunBenchmark },
+	{ .name = "meshopt", .run = MeshCompression::RunBenchmark },
+	// the materials of every mesh in the catalog
+	{ .name = "materials", .run = Material::RunBenchmark, .needsAssets = true },
+	// the shader variants the catalog registered
+	{ .name = "shader_permutations", .run = ShaderPermutation::RunBenchmark, .needsAssets = true },
+	{ .name = "shader_batch", .run = ShaderBatch::RunBenchmark },
+	// catalog.txt from the data dir
+	{ .name = "manifest", .run = RunManifestBenchmark },
+	{ .name = "vfs", .run = VirtualFileSystem::RunBenchmark },
+	// the scene of the catalog through the frame loop without a renderer
+	{ .name = "frame", .run = FrameLoop::RunBenchmark, .needsAssets = true },
+	{ .name = "headless", .run = FrameLoop::RunHeadlessBenchmark, .needsAssets = true },
+};
+
+std::span<const Benchmarks::Entry> Benchmarks::GetEntries()
+{
+	return s_entries;
+}
+
+bool Benchmarks::Run(std::span<const Entry* const> entries)
+{
+	if (std::any_of(entries.begin(), entries.end(), [](const Entry* entry) { return entry->needsAssets; })) {
+		global::assetSystem->RegisterAssets();
+	}
+
+	u32 failed = 0;
+	for (const Entry* entry : entries) {
+		if (!entry->run()) {
+			spdlog::error("benchmark {} FAILED", entry->name);
+			failed += 1;
+		}
+	}
+
+	spdlog::info("{} benchmarks run, {} failed", entries.size(), failed);
+	return failed == 0;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Basic.hpp"
+
+#include <span>
+
+// every benchmark in the engine by name, --bench_<name> runs it instead of the app
+//
+// a benchmark times something and checks its results against a reference as it goes, it logs "matches" or
+// "MISMATCH" per check and returns false if any of them failed, the run exits with 1 if any benchmark did
+namespace Benchmarks
+{
+	struct Entry {
+		const char* name;
+		bool (*run)();
+		// the catalog has to be registered first, it loads without a device like --headless
+		bool needsAssets = false;
+	};
+
+	std::span<const Entry> GetEntries();
+
+	// in the order given, registers the assets first if any of them needs it, true if every one passed
+	bool Run(std::span<const Entry* const> entries);
+}
@@ -0,0 +1,328 @@
+#include "ClusterCulling.hpp"
+
+#include "AssetSystem.hpp"
+#include "Core/JobSystem.hpp"
+#include "Core/Profiler.hpp"
+
+#include <cmath>
+
+static f32 Dot3(const float4& plane, const float3& p)
+{
+	return plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w;
+}
+
+static float4 NormalizePlane(const float4& plane)
+{
+	const f32 length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+	const f32 scale = length > 0.0f ? 1.0f / length : 0.0f;
+	return float4(plane.x * scale, plane.y * scale, plane.z * scale, plane.w * scale);
+}
+
+// gribb hartmann, with row vectors clip = p * m so each plane is a sum of columns of m
+// d3d clip space is -w <= x, y <= w and 0 <= z <= w, the planes point inwards
+static void ExtractFrustum(const mat4& toProjection, float4 outPlanes[6])
+{
+	float4x4 m;
+	DirectX::XMStoreFloat4x4(&m, toProjection);
+
+	const float4 x = float4(m._11, m._21, m._31, m._41);
+	const float4 y = float4(m._12, m._22, m._32, m._42);
+	const float4 z = float4(m._13, m._23, m._33, m._43);
+	const float4 w = float4(m._14, m._24, m._34, m._44);
+
+	outPlanes[0] = NormalizePlane(float4(w.x + x.x, w.y + x.y, w.z + x.z, w.w + x.w));
+	outPlanes[1] = NormalizePlane(float4(w.x - x.x, w.y - x.y, w.z - x.z, w.w - x.w));
+	outPlanes[2] = NormalizePlane(float4(w.x + y.x, w.y + y.y, w.z + y.z, w.w + y.w));
+	outPlanes[3] = NormalizePlane(float4(w.x - y.x, w.y - y.y, w.z - y.z, w.w - y.w));
+	outPlanes[4] = NormalizePlane(z);
+	outPlanes[5] = NormalizePlane(float4(w.x - z.x, w.y - z.y, w.z - z.z, w.w - z.w));
+}
+
+static float3 TransformPoint(const float3& p, const mat4& m)
+{
+	float3 result;
+	DirectX::XMStoreFloat3(&result, DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&p), m));
+	return result;
+}
+
+void ClusterCulling::Begin(const mat4& worldToView, const mat4& viewToProjection)
+{
+	m_worldToProjection = worldToView * viewToProjection;
+	DirectX::XMStoreFloat3(&m_cameraPosition, DirectX::XMMatrixInverse(nullptr, worldToView).r[3]);
+	m_stats = {};
+}
+
+ClusterCulling::Range ClusterCulling::Cull(std::span<const MeshProcessing::Meshlet> meshlets, std::span<const u32> indices, const mat4& modelToWorld, Data<u32>& outIndices)
+{
+	PROFILE_FUNCTION();
+
+	const u32 meshletCount = static_cast<u32>(meshlets.size());
+	Range range = { .indexOffset = static_cast<u32>(outIndices.size()), .indexCount = 0 };
+
+	m_stats.meshes++;
+	if (meshletCount == 0) {
+		return range;
+	}
+
+	float4 planes[6];
+	ExtractFrustum(modelToWorld * m_worldToProjection, planes);
+	const float3 camera = TransformPoint(m_cameraPosition, DirectX::XMMatrixInverse(nullptr, modelToWorld));
+	// a mirrored transform flips the winding on screen, the cones would cull the side that gets drawn
+	const bool cullBackfaces = DirectX::XMVectorGetX(DirectX::XMMatrixDeterminant(modelToWorld)) > 0.0f;
+
+	const u32 batchCount = (meshletCount + MeshletsPerJob - 1) / MeshletsPerJob;
+	m_visible.resize(meshletCount);
+	m_batches.resize(batchCount);
+
+	// ParallelFor hands out whole batches, or everything at once when it runs inline
+	auto forEachBatch = [](u32 begin, u32 end, auto&& func) {
+		for (u32 b = begin / MeshletsPerJob; b * MeshletsPerJob < end; ++b) {
+			func(b, b * MeshletsPerJob, std::min((b + 1) * MeshletsPerJob, end));
+		}
+	};
+
+	global::jobSystem->ParallelFor(meshletCount, MeshletsPerJob, [&](u32 begin, u32 end) {
+		PROFILE_ZONE("TestMeshlets");
+		forEachBatch(begin, end, [&](u32 b, u32 first, u32 last) {
+			Batch batch = {};
+			for (u32 i = first; i < last; ++i) {
+				const MeshProcessing::Meshlet& meshlet = meshlets[i];
+
+				bool outside = false;
+				for (const float4& plane : planes) {
+					outside |= Dot3(plane, meshlet.center) < -meshlet.radius;
+				}
+
+				bool backfacing = false;
+				if (!outside && cullBackfaces) {
+					const float3 d = float3(meshlet.coneApex.x - camera.x, meshlet.coneApex.y - camera.y, meshlet.coneApex.z - camera.z);
+					const f32 length = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+					backfacing = d.x * meshlet.coneAxis.x + d.y * meshlet.coneAxis.y + d.z * meshlet.coneAxis.z >= meshlet.coneCutoff * length;
+				}
+
+				m_visible[i] = !outside && !backfacing;
+				batch.frustumCulled += outside;
+				batch.backfaceCulled += backfacing;
+				batch.triangles += m_visible[i] ? meshlet.triangleCount : 0;
+			}
+			m_batches[b] = batch;
+		});
+	});
+
+	u32 indexCount = 0;
+	for (Batch& batch : m_batches) {
+		batch.indexOffset = range.indexOffset + indexCount;
+		indexCount += batch.triangles * 3;
+		m_stats.meshletsFrustumCulled += batch.frustumCulled;
+		m_stats.meshletsBackfaceCulled += batch.backfaceCulled;
+	}
+
+	m_stats.meshletsTested += meshletCount;
+	m_stats.trianglesTested += indices.size() / 3;
+	m_stats.trianglesEmitted += indexCount / 3;
+
+	range.indexCount = indexCount;
+	outIndices.resize(static_cast<size_t>(range.indexOffset) + indexCount);
+
+	global::jobSystem->ParallelFor(meshletCount, MeshletsPerJob, [&](u32 begin, u32 end) {
+		PROFILE_ZONE("CopyMeshletIndices");
+		forEachBatch(begin, end, [&](u32 b, u32 first, u32 last) {
+			u32* out = outIndices.data() + m_batches[b].indexOffset;
+			for (u32 i = first; i < last; ++i) {
+				if (m_visible[i]) {
+					const MeshProcessing::Meshlet& meshlet = meshlets[i];
+					out = std::copy_n(indices.data() + meshlet.indexOffset, meshlet.triangleCount * 3, out);
+				}
+			}
+		});
+	});
+
+	return range;
+}
+
+//
+// benchmark
+//
+
+struct ClusterBenchmarkMesh {
+	std::string name;
+	ClusterCulling::Data<float3> positions;
+	ClusterCulling::Data<u32> indices;
+	mat4 modelToWorld = DirectX::XMMatrixIdentity();
+	// the cameras orbit this, or stand on it for terrain
+	float3 center = float3(0.0f, 0.0f, 0.0f);
+	f32 radius = 1.0f;
+	bool terrain = false;
+};
+
+// clockwise seen from outside
+static void BuildSphere(u32 rings, u32 segments, ClusterBenchmarkMesh& out)
+{
+	out.name = "sphere";
+	for (u32 j = 0; j <= rings; ++j) {
+		const f32 phi = DirectX::XM_PI * j / rings;
+		for (u32 i = 0; i <= segments; ++i) {
+			const f32 theta = DirectX::XM_2PI * i / segments;
+			out.positions.push_back(float3(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta)));
+		}
+	}
+
+	const u32 rowSize = segments + 1;
+	for (u32 j = 0; j < rings; ++j) {
+		for (u32 i = 0; i < segments; ++i) {
+			const u32 v00 = j * rowSize + i;
+			const u32 v10 = v00 + 1;
+			const u32 v01 = v00 + rowSize;
+			const u32 v11 = v01 + 1;
+			out.indices.insert(out.indices.end(), { v00, v10, v01, v10, v11, v01 });
+		}
+	}
+}
+
+// rolling hills on a grid, clockwise seen from above
+static void BuildTerrain(u32 quadsPerSide, f32 size, ClusterBenchmarkMesh& out)
+{
+	out.name = "terrain";
+	out.terrain = true;
+	out.radius = size * 0.5f;
+	out.center = float3(size * 0.5f, 0.0f, size * 0.5f);
+
+	for (u32 j = 0; j <= quadsPerSide; ++j) {
+		const f32 z = size * j / quadsPerSide;
+		for (u32 i = 0; i <= quadsPerSide; ++i) {
+			const f32 x = size * i / quadsPerSide;
+			out.positions.push_back(float3(x, 4.0f * std::sin(x * 0.05f) * std::cos(z * 0.07f) + std::sin(x * 0.31f + z * 0.23f), z));
+		}
+	}
+
+	const u32 rowSize = quadsPerSide + 1;
+	for (u32 j = 0; j < quadsPerSide; ++j) {
+		for (u32 i = 0; i < quadsPerSide; ++i) {
+			const u32 v00 = j * rowSize + i;
+			const u32 v10 = v00 + 1;
+			const u32 v01 = v00 + rowSize;
+			const u32 v11 = v01 + 1;
+			out.indices.insert(out.indices.end(), { v00, v01, v10, v10, v01, v11 });
+		}
+	}
+}
+
+// every culled triangle has to be outside one frustum plane or facing away, checked in world space
+// independently of how Cull does it, also counts what culling every triangle on its own would get rid of
+static void CheckCulled(const ClusterBenchmarkMesh& mesh, std::span<const MeshProcessing::Meshlet> meshlets, std::span<const u8> visible,
+	const mat4& worldToProjection, const float3& camera, u32& outWronglyCulled, u32& outCullable)
+{
+	float4 planes[6];
+	ExtractFrustum(worldToProjection, planes);
+
+	for (u32 m = 0; m < meshlets.size(); ++m) {
+		const MeshProcessing::Meshlet& meshlet = meshlets[m];
+		for (u32 i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.triangleCount * 3; i += 3) {
+			float3 p[3];
+			for (u32 k = 0; k < 3; ++k) {
+				p[k] = TransformPoint(mesh.positions[mesh.indices[i + k]], mesh.modelToWorld);
+			}
+
+			bool outside = false;
+			for (const float4& plane : planes) {
+				outside |= Dot3(plane, p[0]) < 0.0f && Dot3(plane, p[1]) < 0.0f && Dot3(plane, p[2]) < 0.0f;
+			}
+
+			const float3 e1 = float3(p[1].x - p[0].x, p[1].y - p[0].y, p[1].z - p[0].z);
+			const float3 e2 = float3(p[2].x - p[0].x, p[2].y - p[0].y, p[2].z - p[0].z);
+			const float3 normal = float3(e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x);
+			const bool backfacing = (p[0].x - camera.x) * normal.x + (p[0].y - camera.y) * normal.y + (p[0].z - camera.z) * normal.z >= 0.0f;
+
+			outCullable += outside || backfacing;
+			outWronglyCulled += !visible[m] && !outside && !backfacing;
+		}
+	}
+}
+
+bool ClusterCulling::RunBenchmark()
+{
+	constexpr u32 views = 8;
+	constexpr u32 iterations = 10;
+
+	Data<ClusterBenchmarkMesh> meshes;
+
+	const AssetCatalog* catalog = global::assetSystem->Catalog();
+	const MeshAsset& suzanne = catalog->GetMeshAsset(catalog->FindMeshAsset(HashPath("meshes/suzanne.glb")));
+	if (suzanne.state == AssetState::Loaded) {
+		ClusterBenchmarkMesh& mesh = meshes.emplace_back();
+		mesh.name = "suzanne";
+		mesh.positions.resize(suzanne.GetVertexCount());
+		suzanne.DecodePositions(0, mesh.positions, {});
+		mesh.indices.assign(suzanne.GetIndices().begin(), suzanne.GetIndices().end());
+		// squashed and turned so the model space tests get exercised
+		mesh.modelToWorld = DirectX::XMMatrixScaling(1.0f, 1.5f, 0.75f) * DirectX::XMMatrixRotationY(0.5f);
+		mesh.radius = 1.5f;
+	} else {
+		spdlog::warn("suzanne.glb isnt loaded, only running the synthetic meshes");
+	}
+
+	BuildSphere(1024, 1024, meshes.emplace_back());
+	BuildTerrain(1024, 1000.0f, meshes.emplace_back());
+
+	const mat4 viewToProjection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XMConvertToRadians(80.0f), 16.0f / 9.0f, 0.1f, 2000.0f);
+
+	spdlog::info("cluster culling benchmark, {} threads, {} views per mesh, {} iterations each", global::jobSystem->GetThreadCount(), views, iterations);
+
+	auto culling = std::make_unique<ClusterCulling>();
+	Data<u32> output;
+	bool passed = true;
+
+	for (ClusterBenchmarkMesh& mesh : meshes) {
+		TrackedVector<MeshProcessing::Meshlet, MemoryTag::AssetsMesh> meshlets;
+		spdlog::stopwatch buildTime;
+		MeshProcessing::BuildMeshlets(mesh.positions, mesh.indices, meshlets);
+		const f64 buildMs = buildTime.elapsed().count() * 1000.0;
+
+		const u64 triangleCount = mesh.indices.size() / 3;
+		f64 cullMs = 0.0;
+		Stats total;
+		u32 wronglyCulled = 0;
+		u32 cullable = 0;
+
+		for (u32 view = 0; view < views; ++view) {
+			// objects from a ring around them, terrain from the middle looking out and a little down
+			const f32 angle = DirectX::XM_2PI * view / views;
+			const vec4 direction = DirectX::XMVectorSet(std::cos(angle), mesh.terrain ? -0.2f : -0.35f, std::sin(angle), 0.0f);
+			const vec4 center = DirectX::XMLoadFloat3(&mesh.center);
+			const vec4 eye = mesh.terrain
+				? DirectX::XMVectorAdd(center, DirectX::XMVectorSet(0.0f, 8.0f, 0.0f, 0.0f))
+				: DirectX::XMVectorSubtract(center, DirectX::XMVectorScale(direction, mesh.radius * (view % 2 == 0 ? 2.5f : 1.2f)));
+			const mat4 worldToView = DirectX::XMMatrixLookToLH(eye, direction, DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+			for (u32 i = 0; i < iterations; ++i) {
+				output.clear();
+				spdlog::stopwatch cullTime;
+				culling->Begin(worldToView, viewToProjection);
+				culling->Cull(meshlets, mesh.indices, mesh.modelToWorld, output);
+				cullMs += cullTime.elapsed().count() * 1000.0;
+			}
+
+			const Stats& stats = culling->GetStats();
+			total.meshletsTested += stats.meshletsTested;
+			total.meshletsFrustumCulled += stats.meshletsFrustumCulled;
+			total.meshletsBackfaceCulled += stats.meshletsBackfaceCulled;
+			total.trianglesTested += stats.trianglesTested;
+			total.trianglesEmitted += stats.trianglesEmitted;
+
+			CheckCulled(mesh, meshlets, culling->m_visible, worldToView * viewToProjection, culling->m_cameraPosition, wronglyCulled, cullable);
+		}
+
+		const f64 rejected = 100.0 * (total.trianglesTested - total.trianglesEmitted) / std::max<u64>(total.trianglesTested, 1);
+		const f64 ideal = 100.0 * cullable / std::max<u64>(triangleCount * views, 1);
+		spdlog::info("{}: {} triangles in {} meshlets ({:.1f} triangles each), built in {:.2f} ms",
+			mesh.name, triangleCount, meshlets.size(), static_cast<f64>(triangleCount) / std::max<size_t>(meshlets.size(), 1), buildMs);
+		spdlog::info("    cull {:.3f} ms, {:.1f}% of triangles rejected (culling each triangle would get {:.1f}%), meshlets {:.1f}% frustum {:.1f}% backface culled, {} wrongly culled, {}",
+			cullMs / (views * iterations), rejected, ideal,
+			100.0 * total.meshletsFrustumCulled / std::max(total.meshletsTested, 1u), 100.0 * total.meshletsBackfaceCulled / std::max(total.meshletsTested, 1u),
+			wronglyCulled, wronglyCulled == 0 ? "matches" : "MISMATCH");
+		passed &= wronglyCulled == 0;
+	}
+
+	spdlog::info("cluster culling checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
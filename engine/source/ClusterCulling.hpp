@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "Math.hpp"
+#include "MeshProcessing.hpp"
+#include "Core/MemoryTracker.hpp"
+
+#include <span>
+
+// cpu cluster culling, the meshlets of a mesh (see MeshProcessing::BuildMeshlets) are tested one by one
+// against the view frustum and by their normal cone for facing away from the camera, and the triangles
+// of the ones left are copied into one index buffer for the frame that the renderer draws from
+//
+// the tests run in model space, the frustum planes come straight out of modelToProjection and the camera
+// is moved into model space, so any affine transform works
+// mirrored transforms flip the winding on screen, meshes with those only get frustum culled
+class ClusterCulling {
+public:
+	// the tests are a few dot products, most of the time goes into copying the indices that survive
+	static constexpr u32 MeshletsPerJob = 256;
+
+	struct Stats {
+		u32 meshes = 0;
+		u32 meshletsTested = 0;
+		u32 meshletsFrustumCulled = 0;
+		u32 meshletsBackfaceCulled = 0;
+		u64 trianglesTested = 0;
+		u64 trianglesEmitted = 0;
+	};
+
+	// where the triangles of one Cull call landed in the output
+	struct Range {
+		u32 indexOffset = 0;
+		u32 indexCount = 0;
+	};
+
+	template<typename T>
+	using Data = TrackedVector<T, MemoryTag::Scene>;
+
+	// resets the stats, everything after this is culled for this camera until the next Begin
+	void Begin(const mat4& worldToView, const mat4& viewToProjection);
+
+	// appends the indices of the visible meshlets to outIndices in meshlet order
+	// splits the work over the job system, call from the main thread or a job
+	Range Cull(std::span<const MeshProcessing::Meshlet> meshlets, std::span<const u32> indices, const mat4& modelToWorld, Data<u32>& outIndices);
+
+	inline const Stats& GetStats() const { return m_stats; }
+
+	// suzanne from the catalog and a couple of big synthetic meshes seen from a ring of cameras, checks
+	// no front facing triangle on screen gets culled, needs the assets registered
+	static bool RunBenchmark();
+
+private:
+	// per job, so the copy can start at the right place without a second pass over the meshlets
+	struct Batch {
+		u32 triangles;
+		u32 frustumCulled;
+		u32 backfaceCulled;
+		u32 indexOffset;
+	};
+
+	mat4 m_worldToProjection = DirectX::XMMatrixIdentity();
+	float3 m_cameraPosition = float3(0.0f, 0.0f, 0.0f);
+
+	Stats m_stats;
+
+	// reused by every Cull
+	Data<u8> m_visible;
+	Data<Batch> m_batches;
+};
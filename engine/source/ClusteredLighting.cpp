@@ -0,0 +1,424 @@
+#include "ClusteredLighting.hpp"
+
+#include "Core/JobSystem.hpp"
+#include "Core/Profiler.hpp"
+
+#include <xmmintrin.h>
+#include <algorithm>
+#include <cfloat>
+#include <bit>
+#include <random>
+
+// far enough away that the squared distance to any cluster beats any radius, but doesnt overflow when squared
+static constexpr f32 s_padPosition = 1e18f;
+
+static bool SphereIntersectsAabb(const f32 min[3], const f32 max[3], f32 x, f32 y, f32 z, f32 radius)
+{
+	const f32 center[3] = { x, y, z };
+
+	f32 distSq = 0.0f;
+	for (u32 axis = 0; axis < 3; ++axis) {
+		if (center[axis] < min[axis]) {
+			const f32 d = min[axis] - center[axis];
+			distSq += d * d;
+		} else if (center[axis] > max[axis]) {
+			const f32 d = center[axis] - max[axis];
+			distSq += d * d;
+		}
+	}
+
+	return distSq <= radius * radius;
+}
+
+void ClusteredLighting::SphereSet::Resize(u32 newCount)
+{
+	// round up so the simd loop can always read 4 at a time, never shrinks so the memory gets reused every frame
+	const size_t paddedCount = (static_cast<size_t>(newCount) + 3) & ~size_t{ 3 };
+	if (x.size() < paddedCount) {
+		x.resize(paddedCount);
+		y.resize(paddedCount);
+		z.resize(paddedCount);
+		radius.resize(paddedCount);
+		index.resize(paddedCount);
+	}
+	count = 0;
+}
+
+void ClusteredLighting::SphereSet::Pad()
+{
+	for (u32 i = count; (i & 3) != 0; ++i) {
+		x[i] = s_padPosition;
+		y[i] = s_padPosition;
+		z[i] = s_padPosition;
+		radius[i] = 0.0f;
+		index[i] = 0;
+	}
+}
+
+void ClusteredLighting::CullSpheres(const Aabb& box, const SphereSet& set, SphereSet* outSet, Data<u32>* outIndices)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 minX = _mm_set1_ps(box.min[0]);
+	const __m128 minY = _mm_set1_ps(box.min[1]);
+	const __m128 minZ = _mm_set1_ps(box.min[2]);
+	const __m128 maxX = _mm_set1_ps(box.max[0]);
+	const __m128 maxY = _mm_set1_ps(box.max[1]);
+	const __m128 maxZ = _mm_set1_ps(box.max[2]);
+
+	// 4 spheres at a time, distance from the center to the box is 0 along an axis if the center is inside the box on it
+	for (u32 i = 0; i < set.count; i += 4) {
+		const __m128 x = _mm_loadu_ps(&set.x[i]);
+		const __m128 y = _mm_loadu_ps(&set.y[i]);
+		const __m128 z = _mm_loadu_ps(&set.z[i]);
+		const __m128 radius = _mm_loadu_ps(&set.radius[i]);
+
+		const __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minX, x), zero), _mm_max_ps(_mm_sub_ps(x, maxX), zero));
+		const __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minY, y), zero), _mm_max_ps(_mm_sub_ps(y, maxY), zero));
+		const __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minZ, z), zero), _mm_max_ps(_mm_sub_ps(z, maxZ), zero));
+		const __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+		u32 mask = static_cast<u32>(_mm_movemask_ps(_mm_cmple_ps(distSq, _mm_mul_ps(radius, radius))));
+		while (mask != 0) {
+			const u32 j = i + static_cast<u32>(std::countr_zero(mask));
+			mask &= mask - 1;
+
+			if (outIndices != nullptr) {
+				outIndices->push_back(set.index[j]);
+			}
+
+			if (outSet != nullptr) {
+				const u32 k = outSet->count++;
+				outSet->x[k] = set.x[j];
+				outSet->y[k] = set.y[j];
+				outSet->z[k] = set.z[j];
+				outSet->radius[k] = set.radius[j];
+				outSet->index[k] = set.index[j];
+			}
+		}
+	}
+
+	if (outSet != nullptr) {
+		outSet->Pad();
+	}
+}
+
+void ClusteredLighting::UpdateClusterBounds(const Camera& camera)
+{
+	if (camera == m_boundsCamera) {
+		return;
+	}
+	m_boundsCamera = camera;
+
+	const f32 tanY = std::tan(camera.fov * 0.5f);
+	const f32 tanX = tanY * camera.aspect;
+	const f32 depthRatio = camera.farZ / camera.nearZ;
+
+	for (u32 z = 0; z < GridSizeZ; ++z) {
+		const f32 zNear = camera.nearZ * std::pow(depthRatio, static_cast<f32>(z) / GridSizeZ);
+		const f32 zFar = camera.nearZ * std::pow(depthRatio, static_cast<f32>(z + 1) / GridSizeZ);
+
+		Aabb& slice = m_sliceBounds[z];
+		slice = { { FLT_MAX, FLT_MAX, zNear }, { -FLT_MAX, -FLT_MAX, zFar } };
+
+		for (u32 y = 0; y < GridSizeY; ++y) {
+			const f32 ndcTop = 1.0f - 2.0f * y / GridSizeY;
+			const f32 ndcBottom = 1.0f - 2.0f * (y + 1) / GridSizeY;
+
+			Aabb& row = m_rowBounds[z * GridSizeY + y];
+			row = { { FLT_MAX, FLT_MAX, zNear }, { -FLT_MAX, -FLT_MAX, zFar } };
+
+			for (u32 x = 0; x < GridSizeX; ++x) {
+				const f32 ndcLeft = -1.0f + 2.0f * x / GridSizeX;
+				const f32 ndcRight = -1.0f + 2.0f * (x + 1) / GridSizeX;
+
+				// the cluster is a frustum piece, bound its corners on the near and far plane of the slice
+				Aabb& cluster = m_clusterBounds[ClusterIndex(x, y, z)];
+				cluster.min[0] = std::min(ndcLeft * zNear, ndcLeft * zFar) * tanX;
+				cluster.max[0] = std::max(ndcRight * zNear, ndcRight * zFar) * tanX;
+				cluster.min[1] = std::min(ndcBottom * zNear, ndcBottom * zFar) * tanY;
+				cluster.max[1] = std::max(ndcTop * zNear, ndcTop * zFar) * tanY;
+				cluster.min[2] = zNear;
+				cluster.max[2] = zFar;
+
+				for (u32 axis = 0; axis < 2; ++axis) {
+					row.min[axis] = std::min(row.min[axis], cluster.min[axis]);
+					row.max[axis] = std::max(row.max[axis], cluster.max[axis]);
+				}
+			}
+
+			for (u32 axis = 0; axis < 2; ++axis) {
+				slice.min[axis] = std::min(slice.min[axis], row.min[axis]);
+				slice.max[axis] = std::max(slice.max[axis], row.max[axis]);
+			}
+		}
+	}
+}
+
+void ClusteredLighting::TransformLights(const mat4& worldToView, std::span<const PointLight> lights)
+{
+	const u32 count = static_cast<u32>(lights.size());
+	m_viewLights.Resize(count);
+	m_viewLights.count = count;
+
+	global::jobSystem->ParallelFor(count, 1024, [&](u32 begin, u32 end) {
+		for (u32 i = begin; i < end; ++i) {
+			const vec4 position = DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&lights[i].position), worldToView);
+			m_viewLights.x[i] = DirectX::XMVectorGetX(position);
+			m_viewLights.y[i] = DirectX::XMVectorGetY(position);
+			m_viewLights.z[i] = DirectX::XMVectorGetZ(position);
+			m_viewLights.radius[i] = lights[i].radius;
+			m_viewLights.index[i] = i;
+		}
+	});
+
+	m_viewLights.Pad();
+}
+
+void ClusteredLighting::AssignSlice(u32 z)
+{
+	SliceScratch& slice = m_slices[z];
+	slice.indices.clear();
+	slice.counts.fill(0);
+
+	// narrow the lights down slice, then row, then cluster, so most lights only get tested a couple of times
+	slice.sliceLights.Resize(m_viewLights.count);
+	CullSpheres(m_sliceBounds[z], m_viewLights, &slice.sliceLights, nullptr);
+
+	if (slice.sliceLights.count == 0) {
+		return;
+	}
+
+	slice.rowLights.Resize(slice.sliceLights.count);
+
+	for (u32 y = 0; y < GridSizeY; ++y) {
+		slice.rowLights.count = 0;
+		CullSpheres(m_rowBounds[z * GridSizeY + y], slice.sliceLights, &slice.rowLights, nullptr);
+
+		if (slice.rowLights.count == 0) {
+			continue;
+		}
+
+		for (u32 x = 0; x < GridSizeX; ++x) {
+			const size_t before = slice.indices.size();
+			CullSpheres(m_clusterBounds[ClusterIndex(x, y, z)], slice.rowLights, nullptr, &slice.indices);
+			slice.counts[y * GridSizeX + x] = static_cast<u32>(slice.indices.size() - before);
+		}
+	}
+}
+
+static void SetSliceParams(const ClusteredLighting::Camera& camera, ClusteredLighting::Output& out)
+{
+	const f32 logDepthRatio = std::log(camera.farZ / camera.nearZ);
+	out.sliceScale = ClusteredLighting::GridSizeZ / logDepthRatio;
+	out.sliceBias = -(ClusteredLighting::GridSizeZ * std::log(camera.nearZ)) / logDepthRatio;
+}
+
+void ClusteredLighting::Build(const Camera& camera, const mat4& worldToView, std::span<const PointLight> lights, Output& out)
+{
+	PROFILE_FUNCTION();
+
+	UpdateClusterBounds(camera);
+	SetSliceParams(camera, out);
+	out.lights.assign(lights.begin(), lights.end());
+
+	TransformLights(worldToView, lights);
+
+	{
+		PROFILE_ZONE("ClusteredLighting::Assign");
+		global::jobSystem->ParallelFor(GridSizeZ, 1, [this](u32 begin, u32 end) {
+			for (u32 z = begin; z < end; ++z) {
+				AssignSlice(z);
+			}
+		});
+	}
+
+	// every slice is a contiguous run of clusters, so the slices lists just go one after the other
+	std::array<u32, GridSizeZ> sliceOffsets;
+	u32 indexCount = 0;
+	for (u32 z = 0; z < GridSizeZ; ++z) {
+		sliceOffsets[z] = indexCount;
+		indexCount += static_cast<u32>(m_slices[z].indices.size());
+	}
+
+	out.grid.resize(2 * ClusterCount);
+	out.indices.resize(indexCount);
+
+	PROFILE_ZONE("ClusteredLighting::Compact");
+	global::jobSystem->ParallelFor(GridSizeZ, 1, [&](u32 begin, u32 end) {
+		for (u32 z = begin; z < end; ++z) {
+			const SliceScratch& slice = m_slices[z];
+			if (!slice.indices.empty()) {
+				memcpy(&out.indices[sliceOffsets[z]], slice.indices.data(), slice.indices.size() * sizeof(u32));
+			}
+
+			u32 offset = sliceOffsets[z];
+			for (u32 i = 0; i < GridSizeX * GridSizeY; ++i) {
+				const u32 cluster = z * GridSizeX * GridSizeY + i;
+				out.grid[2 * cluster] = offset;
+				out.grid[2 * cluster + 1] = slice.counts[i];
+				offset += slice.counts[i];
+			}
+		}
+	});
+}
+
+void ClusteredLighting::BuildBruteForce(const Camera& camera, const mat4& worldToView, std::span<const PointLight> lights, f32 radiusSlack, Output& out)
+{
+	SetSliceParams(camera, out);
+	out.lights.assign(lights.begin(), lights.end());
+
+	// a view space direction with z = 1 through each tile corner, unprojected from the near plane
+	const mat4 projectionToView = DirectX::XMMatrixInverse(nullptr, DirectX::XMMatrixPerspectiveFovLH(camera.fov, camera.aspect, camera.nearZ, camera.farZ));
+	std::array<float3, (GridSizeX + 1) * (GridSizeY + 1)> cornerRays;
+	for (u32 y = 0; y <= GridSizeY; ++y) {
+		for (u32 x = 0; x <= GridSizeX; ++x) {
+			const vec4 ndc = DirectX::XMVectorSet(-1.0f + 2.0f * x / GridSizeX, 1.0f - 2.0f * y / GridSizeY, 0.0f, 1.0f);
+			const vec4 corner = DirectX::XMVector3TransformCoord(ndc, projectionToView);
+			DirectX::XMStoreFloat3(&cornerRays[y * (GridSizeX + 1) + x], DirectX::XMVectorDivide(corner, DirectX::XMVectorSplatZ(corner)));
+		}
+	}
+
+	// slice = log(viewZ) * sliceScale + sliceBias solved for viewZ at the slice borders
+	std::array<f32, GridSizeZ + 1> sliceDepths;
+	for (u32 z = 0; z <= GridSizeZ; ++z) {
+		sliceDepths[z] = std::exp((static_cast<f32>(z) - out.sliceBias) / out.sliceScale);
+	}
+
+	std::vector<float3> viewPositions(lights.size());
+	for (size_t i = 0; i < lights.size(); ++i) {
+		DirectX::XMStoreFloat3(&viewPositions[i], DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&lights[i].position), worldToView));
+	}
+
+	out.grid.resize(2 * ClusterCount);
+	out.indices.clear();
+
+	for (u32 z = 0; z < GridSizeZ; ++z) {
+		for (u32 y = 0; y < GridSizeY; ++y) {
+			for (u32 x = 0; x < GridSizeX; ++x) {
+				// the 8 corners of the frustum piece
+				Aabb box = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+				for (u32 corner = 0; corner < 8; ++corner) {
+					const float3& ray = cornerRays[(y + ((corner >> 1) & 1)) * (GridSizeX + 1) + x + (corner & 1)];
+					const f32 depth = sliceDepths[z + (corner >> 2)];
+					const f32 point[3] = { ray.x * depth, ray.y * depth, depth };
+					for (u32 axis = 0; axis < 3; ++axis) {
+						box.min[axis] = std::min(box.min[axis], point[axis]);
+						box.max[axis] = std::max(box.max[axis], point[axis]);
+					}
+				}
+
+				const u32 cluster = ClusterIndex(x, y, z);
+				out.grid[2 * cluster] = static_cast<u32>(out.indices.size());
+
+				for (u32 i = 0; i < static_cast<u32>(lights.size()); ++i) {
+					const f32 radius = std::max(lights[i].radius + radiusSlack, 0.0f);
+					if (SphereIntersectsAabb(box.min, box.max, viewPositions[i].x, viewPositions[i].y, viewPositions[i].z, radius)) {
+						out.indices.push_back(i);
+					}
+				}
+
+				out.grid[2 * cluster + 1] = static_cast<u32>(out.indices.size()) - out.grid[2 * cluster];
+			}
+		}
+	}
+}
+
+bool ClusteredLighting::Compare(const Output& lower, const Output& upper, const Output& actual)
+{
+	for (const Output* output : { &lower, &upper, &actual }) {
+		if (output->grid.size() != 2 * ClusterCount) {
+			spdlog::error("cluster mismatch: {} grid entries, expected {}", output->grid.size(), 2 * ClusterCount);
+			return false;
+		}
+	}
+
+	for (u32 cluster = 0; cluster < ClusterCount; ++cluster) {
+		const auto lightsOf = [cluster](const Output& output) {
+			return std::span<const u32>(output.indices.data() + output.grid[2 * cluster], output.grid[2 * cluster + 1]);
+		};
+		const std::span<const u32> lowerLights = lightsOf(lower);
+		const std::span<const u32> upperLights = lightsOf(upper);
+		const std::span<const u32> actualLights = lightsOf(actual);
+
+		// all three are ascending within a cluster
+		if (!std::includes(actualLights.begin(), actualLights.end(), lowerLights.begin(), lowerLights.end()) ||
+			!std::includes(upperLights.begin(), upperLights.end(), actualLights.begin(), actualLights.end())) {
+			spdlog::error("cluster {} mismatch: {} lights, expected {} to {}", cluster, actualLights.size(), lowerLights.size(), upperLights.size());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool ClusteredLighting::RunBenchmark()
+{
+	// same projection as the default CameraEntity, lights are placed in view space directly
+	const Camera camera = {
+		.fov = DirectX::XMConvertToRadians(80.0f),
+		.aspect = 16.0f / 9.0f,
+		.nearZ = 0.01f,
+		.farZ = 100.0f,
+	};
+	const mat4 worldToView = DirectX::XMMatrixIdentity();
+
+	constexpr u32 iterations = 20;
+
+	// fixed seed so runs are comparable
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<f32> randomX(-100.0f, 100.0f);
+	std::uniform_real_distribution<f32> randomY(-60.0f, 60.0f);
+	std::uniform_real_distribution<f32> randomZ(-1.0f, 101.0f);
+	std::uniform_real_distribution<f32> randomRadius(0.25f, 4.0f);
+
+	// well past the float error of either way of bounding the clusters, well short of a cluster being off
+	constexpr f32 radiusSlack = 1e-3f;
+
+	auto clustering = std::make_unique<ClusteredLighting>();
+	Output output;
+	Output lower;
+	Output upper;
+	std::vector<PointLight> lights;
+
+	spdlog::info("clustering benchmark, {}x{}x{} clusters, {} threads", GridSizeX, GridSizeY, GridSizeZ, global::jobSystem->GetThreadCount());
+
+	bool passed = true;
+
+	for (u32 lightCount : { 1024u, 4096u, 16384u, 65536u }) {
+		lights.resize(lightCount);
+		for (PointLight& light : lights) {
+			light = PointLight{
+				.position = float3(randomX(rng), randomY(rng), randomZ(rng)),
+				.radius = randomRadius(rng),
+				.color = float3(1.0f, 1.0f, 1.0f),
+				.intensity = 1.0f,
+			};
+		}
+
+		// warm up, sizes all the scratch memory
+		clustering->Build(camera, worldToView, lights, output);
+
+		f64 totalMs = 0.0;
+		f64 minMs = std::numeric_limits<f64>::max();
+		for (u32 i = 0; i < iterations; ++i) {
+			spdlog::stopwatch sw;
+			clustering->Build(camera, worldToView, lights, output);
+			const f64 ms = sw.elapsed().count() * 1000.0;
+			totalMs += ms;
+			minMs = std::min(minMs, ms);
+		}
+
+		spdlog::stopwatch bruteForceTime;
+		BuildBruteForce(camera, worldToView, lights, -radiusSlack, lower);
+		const f64 bruteForceMs = bruteForceTime.elapsed().count() * 1000.0;
+		BuildBruteForce(camera, worldToView, lights, radiusSlack, upper);
+
+		const bool matches = Compare(lower, upper, output);
+		passed &= matches;
+
+		spdlog::info("{:>6} lights: {:.3f} ms avg, {:.3f} ms min, {} light indices, brute force {:.1f} ms, {}",
+			lightCount, totalMs / iterations, minMs, output.indices.size(), bruteForceMs, matches ? "matches" : "MISMATCH");
+	}
+	spdlog::info("clustering checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "Math.hpp"
+#include "Core/MemoryTracker.hpp"
+
+#include <span>
+
+// same layout as PointLight in final_deferred_pass_ps.hlsl
+struct PointLight {
+	// world space
+	float3 position;
+	// the light is exactly 0 past this, clusters are assigned by it
+	f32 radius;
+	float3 color;
+	f32 intensity;
+};
+
+static_assert(sizeof(PointLight) == 32, "PointLight is uploaded as is, keep it in sync with the shader");
+
+// the view frustum split into clusters, GridSizeX x GridSizeY tiles on screen times GridSizeZ slices in depth
+// (exponentially spaced so near clusters arent huge), each with the list of lights touching it
+//
+// built on the cpu every frame and read by the final deferred pass, the output is laid out ready for upload:
+//	grid[2 * cluster] = offset into indices, grid[2 * cluster + 1] = count
+//	indices = light indices, ascending within each cluster
+//	cluster = (z * GridSizeY + y) * GridSizeX + x, y = 0 is the top of the screen
+//
+// the clusters only depend on the camera projection, not the resolution, the shader works out its tile
+// from the pixel position and its slice from view depth with sliceScale and sliceBias
+class ClusteredLighting {
+public:
+	static constexpr u32 GridSizeX = 16;
+	static constexpr u32 GridSizeY = 9;
+	static constexpr u32 GridSizeZ = 24;
+	static constexpr u32 ClusterCount = GridSizeX * GridSizeY * GridSizeZ;
+
+	struct Camera {
+		f32 fov = 0.0f;
+		f32 aspect = 0.0f;
+		f32 nearZ = 0.0f;
+		f32 farZ = 0.0f;
+
+		inline bool operator==(const Camera&) const = default;
+	};
+
+	template<typename T>
+	using Data = TrackedVector<T, MemoryTag::Scene>;
+
+	struct Output {
+		// slice = log(viewZ) * sliceScale + sliceBias
+		f32 sliceScale = 0.0f;
+		f32 sliceBias = 0.0f;
+
+		Data<PointLight> lights;
+		Data<u32> grid;
+		Data<u32> indices;
+	};
+
+	// splits the work over the job system, call from the main thread or a job
+	void Build(const Camera& camera, const mat4& worldToView, std::span<const PointLight> lights, Output& out);
+
+	// reference, every light against every cluster on one thread without simd, with the radius of every light
+	// grown by radiusSlack (shrunk if negative)
+	//
+	// shares nothing with Build but the slice params, the cluster corners are unprojected through the projection
+	// matrix and the slice depths come from inverting the formula the shader uses, so a wrong grid shows too
+	static void BuildBruteForce(const Camera& camera, const mat4& worldToView, std::span<const PointLight> lights, f32 radiusSlack, Output& out);
+
+	// true if every cluster of actual has all the lights lower has and none that upper doesnt, the two references
+	// are built with a little slack either way since Build bounds its clusters with different float math,
+	// logs the first cluster that differs
+	static bool Compare(const Output& lower, const Output& upper, const Output& actual);
+
+	// times Build with 1k to 64k random lights and checks each against BuildBruteForce, runs without a window
+	static bool RunBenchmark();
+
+private:
+	struct Aabb {
+		f32 min[3];
+		f32 max[3];
+	};
+
+	// view space spheres, structure of arrays padded to a multiple of 4 with spheres that never hit anything
+	struct SphereSet {
+		Data<f32> x;
+		Data<f32> y;
+		Data<f32> z;
+		Data<f32> radius;
+		// into the original light list
+		Data<u32> index;
+		u32 count = 0;
+
+		void Resize(u32 newCount);
+		void Pad();
+	};
+
+	struct SliceScratch {
+		SphereSet sliceLights;
+		SphereSet rowLights;
+		std::array<u32, GridSizeX * GridSizeY> counts;
+		Data<u32> indices;
+	};
+
+	void UpdateClusterBounds(const Camera& camera);
+	void TransformLights(const mat4& worldToView, std::span<const PointLight> lights);
+	void AssignSlice(u32 z);
+
+	inline static u32 ClusterIndex(u32 x, u32 y, u32 z) { return (z * GridSizeY + y) * GridSizeX + x; }
+
+	// appends the spheres in set touching box to outIndices, and to outSet if there is one
+	static void CullSpheres(const Aabb& box, const SphereSet& set, SphereSet* outSet, Data<u32>* outIndices);
+
+private:
+	Camera m_boundsCamera;
+	std::array<Aabb, ClusterCount> m_clusterBounds;
+	std::array<Aabb, GridSizeZ> m_sliceBounds;
+	std::array<Aabb, GridSizeY * GridSizeZ> m_rowBounds;
+
+	SphereSet m_viewLights;
+	std::array<SliceScratch, GridSizeZ> m_slices;
+};
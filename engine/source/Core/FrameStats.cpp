@@ -0,0 +1,196 @@
+#include "FrameStats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+static const char* phaseStrings[] = {
+	"PollEvents",
+	"SceneUpdate",
+	"Render",
+	"Present",
+	"WaitSceneUpdate",
+};
+
+static_assert(ARRLEN(phaseStrings) == static_cast<size_t>(FrameStats::Phase::Num));
+
+const char* FrameStats::PhaseToString(Phase phase)
+{
+	ENSURE(phase < Phase::Num, "");
+	return phaseStrings[static_cast<u32>(phase)];
+}
+
+void FrameStats::SetPhaseTime(Phase phase, f32 time)
+{
+	ENSURE(phase < Phase::Num, "");
+	m_current.phaseTimes[static_cast<u32>(phase)] = time;
+}
+
+void FrameStats::SetRenderCounters(const RenderCounters& counters)
+{
+	m_current.counters = counters;
+}
+
+void FrameStats::EndFrame(f32 cpuTime)
+{
+	m_current.cpuTime = cpuTime;
+
+	const u32 index = static_cast<u32>(m_frameCount % HistorySize);
+	m_frames[index] = m_current;
+	m_frameTimes[index] = cpuTime;
+	m_frameCount++;
+
+	m_current = Frame();
+}
+
+const FrameStats::Frame& FrameStats::GetLastFrame() const
+{
+	return m_frames[(m_frameCount + HistorySize - 1) % HistorySize];
+}
+
+FrameStats::Summary FrameStats::ComputeSummary() const
+{
+	return Summarise(m_frameTimes.data(), GetHistoryCount());
+}
+
+FrameStats::Summary FrameStats::ComputePhaseSummary(Phase phase) const
+{
+	ENSURE(phase < Phase::Num, "");
+
+	std::array<f32, HistorySize> values;
+	const u32 count = GetHistoryCount();
+	for (u32 i = 0; i < count; ++i) {
+		values[i] = m_frames[i].phaseTimes[static_cast<u32>(phase)];
+	}
+
+	return Summarise(values.data(), count);
+}
+
+FrameStats::Summary FrameStats::Summarise(const f32* values, u32 count) const
+{
+	Summary summary;
+	summary.frameCount = count;
+	if (count == 0) {
+		return summary;
+	}
+
+	// the history is small enough that sorting a copy is cheaper than keeping anything incremental
+	std::array<f32, HistorySize> sorted;
+	std::copy(values, values + count, sorted.begin());
+	std::sort(sorted.begin(), sorted.begin() + count);
+
+	f64 total = 0.0;
+	for (u32 i = 0; i < count; ++i) {
+		total += sorted[i];
+	}
+
+	// nearest rank
+	auto percentile = [&](f32 p) {
+		const u32 rank = static_cast<u32>(std::ceil(p * count));
+		return sorted[std::clamp(rank, 1u, count) - 1];
+	};
+
+	summary.average = static_cast<f32>(total / count);
+	summary.min = sorted[0];
+	summary.max = sorted[count - 1];
+	summary.p50 = percentile(0.50f);
+	summary.p95 = percentile(0.95f);
+	summary.p99 = percentile(0.99f);
+
+	return summary;
+}
+
+// the summary of values straight from the definition, nearest rank percentiles of the sorted values
+static FrameStats::Summary ReferenceSummary(std::vector<f32> values)
+{
+	FrameStats::Summary summary;
+	summary.frameCount = static_cast<u32>(values.size());
+	std::sort(values.begin(), values.end());
+
+	f64 total = 0.0;
+	for (f32 value : values) {
+		total += value;
+	}
+
+	const auto percentile = [&](f64 p) {
+		const size_t rank = static_cast<size_t>(std::ceil(p * static_cast<f64>(values.size()) - 1e-9));
+		return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+	};
+
+	summary.average = static_cast<f32>(total / static_cast<f64>(values.size()));
+	summary.min = values.front();
+	summary.max = values.back();
+	summary.p50 = percentile(0.50);
+	summary.p95 = percentile(0.95);
+	summary.p99 = percentile(0.99);
+	return summary;
+}
+
+static bool SameSummary(const FrameStats::Summary& a, const FrameStats::Summary& b)
+{
+	return a.frameCount == b.frameCount && std::abs(a.average - b.average) <= 1e-4f * std::max(b.average, 1.0f)
+		&& a.min == b.min && a.max == b.max && a.p50 == b.p50 && a.p95 == b.p95 && a.p99 == b.p99;
+}
+
+// frameCount frames of made up times, render at a third of the frame, checked against the last HistorySize of them
+static bool CheckHistory(u32 frameCount, std::mt19937& rng)
+{
+	std::uniform_real_distribution<f32> frameTime(4.0f, 40.0f);
+
+	FrameStats stats;
+	std::vector<f32> frameTimes(frameCount);
+	for (u32 i = 0; i < frameCount; ++i) {
+		frameTimes[i] = frameTime(rng);
+		stats.SetPhaseTime(FrameStats::Phase::Render, frameTimes[i] / 3.0f);
+		stats.EndFrame(frameTimes[i]);
+	}
+
+	const u32 kept = std::min(frameCount, FrameStats::HistorySize);
+	const std::vector<f32> history(frameTimes.end() - kept, frameTimes.end());
+	std::vector<f32> renderHistory(kept);
+	std::transform(history.begin(), history.end(), renderHistory.begin(), [](f32 time) { return time / 3.0f; });
+
+	const bool summary = SameSummary(stats.ComputeSummary(), ReferenceSummary(history));
+	const bool phase = SameSummary(stats.ComputePhaseSummary(FrameStats::Phase::Render), ReferenceSummary(renderHistory));
+	const bool empty = stats.ComputePhaseSummary(FrameStats::Phase::Present).max == 0.0f;
+
+	// oldest first from the offset, like the plot reads it
+	bool ring = stats.GetFrameCount() == frameCount && stats.GetHistoryCount() == kept;
+	ring &= stats.GetLastFrame().cpuTime == frameTimes.back();
+	const u32 offset = frameCount < FrameStats::HistorySize ? 0 : stats.GetHistoryOffset();
+	for (u32 i = 0; ring && i < kept; ++i) {
+		ring &= stats.GetFrameTimeHistory()[(offset + i) % FrameStats::HistorySize] == history[i];
+	}
+
+	spdlog::info("{} frames: summary {}, phase {}, unset phase {}, history {}", frameCount, summary ? "matches" : "MISMATCH",
+		phase ? "matches" : "MISMATCH", empty ? "matches" : "MISMATCH", ring ? "matches" : "MISMATCH");
+	return summary && phase && empty && ring;
+}
+
+bool FrameStats::RunBenchmark()
+{
+	constexpr u32 frameCount = 100000;
+
+	spdlog::info("frame stats benchmark, {} frame history", HistorySize);
+
+	std::mt19937 rng(32);
+	bool passed = CheckHistory(1, rng);
+	passed &= CheckHistory(HistorySize / 2 + 1, rng);
+	passed &= CheckHistory(HistorySize * 3 + 17, rng);
+
+	// what a frame costs the app with the perf panel open, one frame recorded and its summary computed
+	FrameStats stats;
+	f32 checksum = 0.0f;
+	spdlog::stopwatch sw;
+	for (u32 i = 0; i < frameCount; ++i) {
+		stats.SetPhaseTime(Phase::SceneUpdate, static_cast<f32>(i % 7));
+		stats.EndFrame(static_cast<f32>(i % 13));
+		checksum += stats.ComputeSummary().p95;
+	}
+	const f64 ms = sw.elapsed().count() * 1000.0;
+
+	spdlog::info("{} frames recorded and summarised in {:.2f}ms, {:.0f} ns per frame (p95 sum {})", frameCount, ms,
+		ms * 1e6 / frameCount, checksum);
+	spdlog::info("frame stats checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Basic.hpp"
+
+// per frame cpu timings and renderer counters, kept for the last HistorySize frames
+// no renderer or imgui dependencies so it can be driven headless
+class FrameStats {
+public:
+	static constexpr u32 HistorySize = 256;
+
+	enum class Phase : u32 {
+		PollEvents = 0,
+		SceneUpdate,
+		Render,
+		Present,
+		WaitSceneUpdate,
+
+		Num
+	};
+
+	// filled in by the renderer every frame
+	struct RenderCounters {
+		u32 drawCalls = 0;
+		u64 triangles = 0;
+		u32 stateChanges = 0;
+		u64 bytesUploaded = 0;
+		// left out of the frame by cpu occlusion culling
+		u32 occlusionCulled = 0;
+		// triangles of clustered meshes left out by meshlet culling
+		u64 clusterTrianglesCulled = 0;
+	};
+
+	struct Frame {
+		f32 cpuTime = 0.0f;
+		f32 phaseTimes[static_cast<u32>(Phase::Num)] = {};
+		RenderCounters counters;
+	};
+
+	// over the frames currently in the history, all times in ms
+	struct Summary {
+		u32 frameCount = 0;
+		f32 average = 0.0f;
+		f32 min = 0.0f;
+		f32 max = 0.0f;
+		f32 p50 = 0.0f;
+		f32 p95 = 0.0f;
+		f32 p99 = 0.0f;
+	};
+
+public:
+	// times are in ms
+	void SetPhaseTime(Phase phase, f32 time);
+	void SetRenderCounters(const RenderCounters& counters);
+	// pushes the frame into the history and starts a new one
+	void EndFrame(f32 cpuTime);
+
+	Summary ComputeSummary() const;
+	Summary ComputePhaseSummary(Phase phase) const;
+
+	// most recently finished frame
+	const Frame& GetLastFrame() const;
+	inline u64 GetFrameCount() const { return m_frameCount; }
+	inline u32 GetHistoryCount() const { return static_cast<u32>(std::min<u64>(m_frameCount, HistorySize)); }
+
+	// ring buffer of frame times, oldest at GetHistoryOffset, matches what ImGui::PlotLines expects
+	inline const f32* GetFrameTimeHistory() const { return m_frameTimes.data(); }
+	inline u32 GetHistoryOffset() const { return static_cast<u32>(m_frameCount % HistorySize); }
+
+	static const char* PhaseToString(Phase phase);
+
+	// random frames through a short and a wrapped history, the summaries and the ring order checked against
+	// a sorted reference, then what recording a frame and summarising the history costs
+	static bool RunBenchmark();
+
+private:
+	Summary Summarise(const f32* values, u32 count) const;
+
+private:
+	Frame m_current;
+	std::array<Frame, HistorySize> m_frames = {};
+	// frame times again, contiguous for plotting and percentiles
+	std::array<f32, HistorySize> m_frameTimes = {};
+	u64 m_frameCount = 0;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Basic.hpp"
+
+#include <string_view>
+
+// 64 bit FNV-1a, constexpr so asset paths known at compile time hash for free
+// @TODO: good enough for asset paths, swap for something faster (xxhash?) when hashing large blobs
+constexpr u64 FNV1a64OffsetBasis = 0xcbf29ce484222325ull;
+constexpr u64 FNV1a64Prime = 0x100000001b3ull;
+
+inline u64 Hash64(const void* data, size_t size, u64 seed = FNV1a64OffsetBasis)
+{
+	const byte* bytes = static_cast<const byte*>(data);
+	u64 hash = seed;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= static_cast<u64>(bytes[i]);
+		hash *= FNV1a64Prime;
+	}
+	return hash;
+}
+
+// separate overload since a void* cant be read in a constant expression
+constexpr u64 Hash64(std::string_view str, u64 seed = FNV1a64OffsetBasis)
+{
+	u64 hash = seed;
+	for (char c : str) {
+		hash ^= static_cast<u64>(static_cast<byte>(c));
+		hash *= FNV1a64Prime;
+	}
+	return hash;
+}
+
+// hash of an assets virtual path (relative to the data dir), paths are expected to use forward slashes
+constexpr u64 HashPath(std::string_view path)
+{
+	return Hash64(path);
+}
+
+// for unordered_maps keyed by an already hashed value
+struct IdentityHash {
+	inline size_t operator()(u64 value) const { return static_cast<size_t>(value); }
+};
@@ -0,0 +1,482 @@
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+
+#include <span>
+
+namespace global
+{
+	JobSystem* jobSystem = nullptr;
+}
+
+// main thread is 0, workers are 1..N, anything else is a thread the job system doesnt know about
+static thread_local u32 s_threadIndex = std::numeric_limits<u32>::max();
+
+#pragma region JobCounter
+
+void JobCounter::Decrement(JobSystem& jobSystem)
+{
+	u64 state = m_state.load(std::memory_order_relaxed);
+	bool finishing = false;
+	for (;;) {
+		ENSURE((state & PendingMask) > 0, "counter decremented more times than it was incremented");
+
+		// the last job sets the finishing bit instead of letting the counter hit zero,
+		// unless another thread is already finishing, then that one takes care of it
+		u64 next = state - 1;
+		finishing = (next & PendingMask) == 0 && !(next & FinishingBit);
+		if (finishing) {
+			next |= FinishingBit;
+		}
+
+		if (m_state.compare_exchange_weak(state, next, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+			break;
+		}
+	}
+
+	if (!finishing) {
+		return;
+	}
+
+	// continuations are only submitted once we are done with the counter, they might be what
+	// lets a waiter go ahead and destroy it
+	std::vector<Job*> continuations;
+	for (;;) {
+		{
+			std::lock_guard lock(m_continuationMutex);
+			continuations.insert(continuations.end(), m_continuations.begin(), m_continuations.end());
+			m_continuations.clear();
+			m_state.fetch_and(~DirtyBit, std::memory_order_relaxed);
+		}
+
+		u64 expected = FinishingBit;
+		if (m_state.compare_exchange_strong(expected, 0, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+			break;
+		}
+
+		// more continuations came in while we were busy
+		if (expected & DirtyBit) {
+			continue;
+		}
+
+		// jobs were added to the counter again, whoever finishes last out of those takes over
+		if (m_state.compare_exchange_strong(expected, expected & ~FinishingBit, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+			break;
+		}
+	}
+
+	for (Job* job : continuations) {
+		jobSystem.Submit(job);
+	}
+}
+
+bool JobCounter::AddContinuation(Job* job)
+{
+	std::lock_guard lock(m_continuationMutex);
+
+	// only fully done counters can run the job right away, if a thread is still finishing up it has to
+	// submit the job itself, otherwise the job could finish and let someone destroy the counter under it
+	if (m_state.load(std::memory_order_acquire) == 0) {
+		return false;
+	}
+
+	m_continuations.push_back(job);
+	m_state.fetch_or(DirtyBit, std::memory_order_release);
+	return true;
+}
+
+#pragma endregion
+
+#pragma region WorkStealingQueue
+
+// see "Correct and Efficient Work-Stealing for Weak Memory Models" (Le, Pop, Cohen, Zappa Nardelli)
+
+bool WorkStealingQueue::Push(Job* job)
+{
+	const i64 bottom = m_bottom.load(std::memory_order_relaxed);
+	const i64 top = m_top.load(std::memory_order_acquire);
+
+	if (bottom - top >= static_cast<i64>(Capacity)) {
+		return false;
+	}
+
+	// release so a thief that sees the new bottom also sees the job contents
+	m_jobs[bottom & (Capacity - 1)].store(job, std::memory_order_release);
+	m_bottom.store(bottom + 1, std::memory_order_release);
+	return true;
+}
+
+Job* WorkStealingQueue::Pop()
+{
+	const i64 bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	i64 top = m_top.load(std::memory_order_relaxed);
+
+	if (top > bottom) {
+		// empty
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = m_jobs[bottom & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (top == bottom) {
+		// last job, race the stealers for it
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			job = nullptr;
+		}
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+Job* WorkStealingQueue::Steal()
+{
+	i64 top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const i64 bottom = m_bottom.load(std::memory_order_acquire);
+
+	if (top >= bottom) {
+		return nullptr;
+	}
+
+	Job* job = m_jobs[top & (Capacity - 1)].load(std::memory_order_acquire);
+	if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		// someone else got it
+		return nullptr;
+	}
+
+	return job;
+}
+
+#pragma endregion
+
+JobSystem::JobSystem(u32 workerCount)
+{
+	if (workerCount == 0) {
+		workerCount = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+	}
+
+	m_threads.resize(workerCount + 1);
+	for (u32 i = 0; i < m_threads.size(); ++i) {
+		m_threads[i] = std::make_unique<ThreadData>();
+		m_threads[i]->jobPool = std::make_unique<Job[]>(JobPoolSize);
+		m_threads[i]->randomState = 0x9E3779B9u * (i + 1);
+	}
+
+	ENSURE(s_threadIndex == std::numeric_limits<u32>::max(), "thread already belongs to a job system");
+	s_threadIndex = MainThreadIndex;
+
+	m_workers.reserve(workerCount);
+	for (u32 i = 1; i <= workerCount; ++i) {
+		m_workers.emplace_back([this, i]() { WorkerLoop(i); });
+	}
+
+	spdlog::info("job system started with {} workers", workerCount);
+}
+
+JobSystem::~JobSystem()
+{
+	m_running.store(false);
+	{
+		std::lock_guard lock(m_sleepMutex);
+		m_sleepCondition.notify_all();
+	}
+
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+
+	s_threadIndex = std::numeric_limits<u32>::max();
+}
+
+u32 JobSystem::GetThreadIndex()
+{
+	return s_threadIndex;
+}
+
+Job* JobSystem::AllocateJob(u32 threadIndex)
+{
+	ThreadData& thread = *m_threads[threadIndex];
+
+	// slots mostly free up in the order they were taken, so the next one is almost always free, a job that waits
+	// on a counter or for the main thread holds on to its slot though, so look a little further before giving up,
+	// not the whole pool, with every slot in flight that would be a scan per job
+	constexpr u32 SearchCount = 64;
+
+	for (;;) {
+		for (u32 i = 0; i < SearchCount; ++i) {
+			Job* job = &thread.jobPool[thread.jobPoolIndex++ & (JobPoolSize - 1)];
+			if (!job->inUse.load(std::memory_order_acquire)) {
+				job->inUse.store(true, std::memory_order_relaxed);
+				return job;
+			}
+		}
+
+		// every slot is in flight, reusing one would overwrite a job that hasnt run yet, so help until one is done
+		if (threadIndex == MainThreadIndex) {
+			RunMainThreadJobs();
+		}
+
+		Job* job = GetJob(threadIndex);
+		if (job == nullptr) {
+			std::this_thread::yield();
+			continue;
+		}
+		Execute(job);
+
+		// mostly one of our own off the bottom of our queue, only this thread takes slots from its pool so it
+		// can have it straight away instead of scanning the pool again
+		if (job >= thread.jobPool.get() && job < thread.jobPool.get() + JobPoolSize && !job->inUse.load(std::memory_order_acquire)) {
+			job->inUse.store(true, std::memory_order_relaxed);
+			return job;
+		}
+	}
+}
+
+void JobSystem::Submit(Job* job)
+{
+	ThreadData& thread = *m_threads[GetThreadIndex()];
+
+	if (!thread.queue.Push(job)) {
+		// queue is full, just do it now rather than drop it
+		Execute(job);
+		return;
+	}
+
+	m_queuedJobs.fetch_add(1);
+	WakeWorker();
+}
+
+void JobSystem::SubmitMainThread(Job* job)
+{
+	std::lock_guard lock(m_mainThreadMutex);
+	m_mainThreadJobs.push_back(job);
+}
+
+void JobSystem::Execute(Job* job)
+{
+	job->invoke(job->storage);
+
+	// the slot can be taken again as soon as it is released, the counter has to be read before
+	JobCounter* counter = job->counter;
+	job->inUse.store(false, std::memory_order_release);
+
+	if (counter != nullptr) {
+		counter->Decrement(*this);
+	}
+}
+
+Job* JobSystem::GetJob(u32 threadIndex)
+{
+	Job* job = m_threads[threadIndex]->queue.Pop();
+
+	if (job == nullptr) {
+		// xorshift to pick where to start stealing so workers dont all gang up on the same victim
+		u32& state = m_threads[threadIndex]->randomState;
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+
+		const u32 threadCount = GetThreadCount();
+		for (u32 i = 0; i < threadCount && job == nullptr; ++i) {
+			const u32 victim = (state + i) % threadCount;
+			if (victim != threadIndex) {
+				job = m_threads[victim]->queue.Steal();
+			}
+		}
+	}
+
+	if (job != nullptr) {
+		m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+bool JobSystem::RunOneJob(u32 threadIndex)
+{
+	if (Job* job = GetJob(threadIndex)) {
+		Execute(job);
+		return true;
+	}
+	return false;
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	const u32 threadIndex = GetThreadIndex();
+	ASSERT(threadIndex < m_threads.size(), "can only wait from the main thread or a worker");
+
+	while (!counter.IsDone()) {
+		if (threadIndex == MainThreadIndex) {
+			RunMainThreadJobs();
+		}
+
+		if (!RunOneJob(threadIndex)) {
+			// whatever we are waiting on is running on another thread
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::RunMainThreadJobs()
+{
+	ASSERT(IsMainThread(), "");
+
+	std::vector<Job*> jobs;
+	{
+		std::lock_guard lock(m_mainThreadMutex);
+		if (m_mainThreadJobs.empty()) {
+			return;
+		}
+		jobs.swap(m_mainThreadJobs);
+	}
+
+	for (Job* job : jobs) {
+		Execute(job);
+	}
+}
+
+void JobSystem::WakeWorker()
+{
+	// pairs with the increment of m_sleepingWorkers in WorkerLoop, one of the two sides always sees the other
+	if (m_sleepingWorkers.load() > 0) {
+		std::lock_guard lock(m_sleepMutex);
+		m_sleepCondition.notify_one();
+	}
+}
+
+void JobSystem::WorkerLoop(u32 threadIndex)
+{
+	s_threadIndex = threadIndex;
+	Profiler::SetThreadName(fmt::format("worker {}", threadIndex));
+
+	// spin a little before going to sleep, waking up a sleeping thread costs a lot more than a few yields
+	constexpr u32 SpinCount = 64;
+	u32 spins = 0;
+
+	while (m_running.load(std::memory_order_relaxed)) {
+		if (RunOneJob(threadIndex)) {
+			spins = 0;
+			continue;
+		}
+
+		if (++spins < SpinCount) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock lock(m_sleepMutex);
+		m_sleepingWorkers.fetch_add(1);
+		m_sleepCondition.wait(lock, [this]() {
+			return !m_running.load() || m_queuedJobs.load() > 0;
+		});
+		m_sleepingWorkers.fetch_sub(1);
+		spins = 0;
+	}
+}
+
+#pragma region Benchmark
+
+// some math per element so a batch costs about what a batch of vertices does
+static f32 BenchmarkKernel(u32 i)
+{
+	f32 x = static_cast<f32>(i) * 0.001f;
+	for (u32 k = 0; k < 16; ++k) {
+		x = x * 0.999f + 0.5f / (1.0f + x * x);
+	}
+	return x;
+}
+
+struct ScalingResult {
+	f64 parallelForMs = 0.0;
+	f64 jobsMs = 0.0;
+	bool passed = true;
+};
+
+// runs on a thread of its own, it becomes the main thread of a job system with threadCount - 1 workers
+static ScalingResult RunScaling(u32 threadCount, std::span<const f32> expected)
+{
+	constexpr u32 batchSize = 256;
+	constexpr u32 jobCount = 3 * JobSystem::JobPoolSize;
+	constexpr u32 runs = 5;
+
+	ScalingResult result;
+	result.parallelForMs = std::numeric_limits<f64>::max();
+	result.jobsMs = std::numeric_limits<f64>::max();
+
+	JobSystem jobSystem(threadCount - 1);
+
+	const u32 count = static_cast<u32>(expected.size());
+	std::vector<f32> values(count);
+	std::vector<std::atomic<u32>> hits(jobCount);
+
+	for (u32 r = 0; r < runs; ++r) {
+		std::fill(values.begin(), values.end(), -1.0f);
+
+		// far more batches than slots in the job pool, they are all queued before the wait
+		spdlog::stopwatch parallelForTime;
+		jobSystem.ParallelFor(count, batchSize, [&](u32 begin, u32 end) {
+			for (u32 i = begin; i < end; ++i) {
+				values[i] = BenchmarkKernel(i);
+			}
+		});
+		result.parallelForMs = std::min(result.parallelForMs, parallelForTime.elapsed().count() * 1000.0);
+		result.passed &= std::equal(values.begin(), values.end(), expected.begin());
+
+		// empty jobs, the overhead of a job and what a job pool overrun looks like, every job has to run exactly once
+		for (std::atomic<u32>& hit : hits) {
+			hit.store(0, std::memory_order_relaxed);
+		}
+
+		JobCounter counter;
+		spdlog::stopwatch jobsTime;
+		for (u32 j = 0; j < jobCount; ++j) {
+			std::atomic<u32>* hit = &hits[j];
+			jobSystem.Run([hit]() { hit->fetch_add(1, std::memory_order_relaxed); }, &counter);
+		}
+		jobSystem.Wait(counter);
+		result.jobsMs = std::min(result.jobsMs, jobsTime.elapsed().count() * 1000.0);
+		result.passed &= std::all_of(hits.begin(), hits.end(), [](const std::atomic<u32>& hit) { return hit.load() == 1; });
+	}
+
+	return result;
+}
+
+bool JobSystem::RunBenchmark()
+{
+	constexpr u32 count = 1 << 22;
+	constexpr u32 jobCount = 3 * JobPoolSize;
+
+	// at least two so the workers get a go on a single core machine too
+	const u32 maxThreads = std::max(std::thread::hardware_concurrency(), 2u);
+
+	spdlog::info("job system benchmark, {} elements, {} jobs, 1 to {} threads", count, jobCount, maxThreads);
+
+	std::vector<f32> expected(count);
+	for (u32 i = 0; i < count; ++i) {
+		expected[i] = BenchmarkKernel(i);
+	}
+
+	// without workers ParallelFor runs the whole range on the calling thread, the speedups are against that
+	bool passed = true;
+	f64 singleThreadMs = 0.0;
+	for (u32 threadCount = 1; threadCount <= maxThreads; ++threadCount) {
+		ScalingResult result;
+		std::thread thread([&]() { result = RunScaling(threadCount, expected); });
+		thread.join();
+
+		singleThreadMs = threadCount == 1 ? result.parallelForMs : singleThreadMs;
+
+		spdlog::info("{:2} threads: parallel for {:.2f}ms ({:.2f}x), {} jobs {:.2f}ms ({:.1f} ns per job), results {}", threadCount,
+			result.parallelForMs, singleThreadMs / std::max(result.parallelForMs, 1e-3), jobCount, result.jobsMs, result.jobsMs * 1e6 / jobCount,
+			result.passed ? "matches" : "MISMATCH");
+		passed &= result.passed;
+	}
+
+	spdlog::info("job system checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
+
+#pragma endregion
@@ -0,0 +1,259 @@
+#pragma once
+
+#include "Basic.hpp"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <algorithm>
+
+class JobSystem;
+namespace global
+{
+	extern JobSystem* jobSystem;
+}
+
+class JobCounter;
+
+// a unit of work, the callable is stored inline so submitting a job never allocates
+// jobs come from a per thread pool of JobPoolSize slots, a slot stays taken until its job has run, a thread
+// with every slot in flight runs jobs itself until one frees up
+struct Job {
+	static constexpr size_t StorageSize = 48;
+
+	void (*invoke)(void* storage) = nullptr;
+	JobCounter* counter = nullptr;
+	// set by CreateJob, cleared by Execute once the job is done with the slot
+	std::atomic<bool> inUse = false;
+	alignas(16) byte storage[StorageSize];
+};
+
+// counts outstanding jobs, Wait on it to block until they are all done
+// jobs submitted with RunAfter start once the counter they depend on hits zero
+class JobCounter {
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	inline bool IsDone() const { return m_state.load(std::memory_order_acquire) == 0; }
+
+private:
+	// low bits count pending jobs, FinishingBit is set while the last job to finish is kicking off continuations
+	// so waiters dont see the counter as done (and destroy it) until nothing touches it anymore,
+	// DirtyBit means continuations were added that the finishing thread hasnt picked up yet
+	static constexpr u64 FinishingBit = 1ull << 63;
+	static constexpr u64 DirtyBit = 1ull << 62;
+	static constexpr u64 PendingMask = DirtyBit - 1;
+
+	inline void Increment() { m_state.fetch_add(1, std::memory_order_relaxed); }
+	void Decrement(JobSystem& jobSystem);
+	// returns false if the counter is already done, caller should run the job right away
+	bool AddContinuation(Job* job);
+
+	std::atomic<u64> m_state = 0;
+
+	// only touched when RunAfter is used
+	std::mutex m_continuationMutex;
+	std::vector<Job*> m_continuations;
+
+	friend class JobSystem;
+};
+
+// Chase-Lev work stealing deque, the owning thread pushes and pops at the bottom, everyone else steals from the top
+class WorkStealingQueue {
+public:
+	static constexpr u32 Capacity = 4096;
+
+	// returns false when full
+	bool Push(Job* job);
+	Job* Pop();
+	Job* Steal();
+
+	inline bool IsEmpty() const {
+		return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+	}
+
+private:
+	static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+	alignas(64) std::atomic<i64> m_top = 0;
+	alignas(64) std::atomic<i64> m_bottom = 0;
+	alignas(64) std::atomic<Job*> m_jobs[Capacity] = {};
+};
+
+// task based job system, one worker thread per core (minus the main thread) each with its own
+// work stealing deque, idle threads steal from the others
+//
+// only the main thread (the one that created the job system) and the workers may submit jobs
+// Wait helps out by running jobs instead of blocking, so it is fine to wait from inside a job
+//
+// usage:
+//	JobCounter counter;
+//	global::jobSystem->Run([&]() { DoThing(); }, &counter);
+//	global::jobSystem->RunAfter(counter, [&]() { UseThing(); });
+//	global::jobSystem->Wait(counter);
+//
+//	global::jobSystem->ParallelFor(count, 64, [&](u32 begin, u32 end) { ... });
+class JobSystem {
+public:
+	static constexpr u32 JobPoolSize = 4096;
+	static constexpr u32 MainThreadIndex = 0;
+
+	// workerCount 0 means one per hardware thread, not counting the main thread
+	JobSystem(u32 workerCount = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	template<typename Func>
+	void Run(Func&& func, JobCounter* counter = nullptr);
+
+	// runs func once dependency reaches zero
+	template<typename Func>
+	void RunAfter(JobCounter& dependency, Func&& func, JobCounter* counter = nullptr);
+
+	// for work that has to happen on the main thread (window, device context, ...)
+	// runs during RunMainThreadJobs or while the main thread is in Wait
+	template<typename Func>
+	void RunOnMainThread(Func&& func, JobCounter* counter = nullptr);
+
+	// splits [0, count) into batches of batchSize and calls func(begin, end) for each in parallel, blocks until done
+	template<typename Func>
+	void ParallelFor(u32 count, u32 batchSize, Func&& func);
+
+	void Wait(JobCounter& counter);
+
+	// ParallelFor and a flood of small jobs on 1 to N threads, each on a job system of its own, checked against
+	// a serial run and timed
+	static bool RunBenchmark();
+
+	void RunMainThreadJobs();
+
+	// main thread + workers
+	inline u32 GetThreadCount() const { return static_cast<u32>(m_threads.size()); }
+	// index of the calling thread in [0, GetThreadCount()), MainThreadIndex for the main thread
+	static u32 GetThreadIndex();
+	inline bool IsMainThread() const { return GetThreadIndex() == MainThreadIndex; }
+
+private:
+	template<typename Func>
+	Job* CreateJob(Func&& func, JobCounter* counter);
+
+	// the next free slot of the calling thread
+	Job* AllocateJob(u32 threadIndex);
+
+	void Submit(Job* job);
+	void SubmitMainThread(Job* job);
+	void Execute(Job* job);
+
+	// own queue first, then steal
+	Job* GetJob(u32 threadIndex);
+	bool RunOneJob(u32 threadIndex);
+
+	void WorkerLoop(u32 threadIndex);
+	void WakeWorker();
+
+private:
+	struct alignas(64) ThreadData {
+		WorkStealingQueue queue;
+		std::unique_ptr<Job[]> jobPool;
+		u32 jobPoolIndex = 0;
+		u32 randomState = 0;
+	};
+
+	std::vector<std::unique_ptr<ThreadData>> m_threads;
+	std::vector<std::thread> m_workers;
+
+	std::atomic<bool> m_running = true;
+
+	// sleeping workers, woken when work is pushed
+	std::mutex m_sleepMutex;
+	std::condition_variable m_sleepCondition;
+	std::atomic<u32> m_sleepingWorkers = 0;
+	std::atomic<u32> m_queuedJobs = 0;
+
+	std::mutex m_mainThreadMutex;
+	std::vector<Job*> m_mainThreadJobs;
+
+	friend class JobCounter;
+};
+
+template<typename Func>
+Job* JobSystem::CreateJob(Func&& func, JobCounter* counter)
+{
+	using FuncType = std::decay_t<Func>;
+	static_assert(sizeof(FuncType) <= Job::StorageSize, "job captures too much, capture a pointer to a struct instead");
+	static_assert(alignof(FuncType) <= alignof(Job), "job capture alignment too large");
+	static_assert(std::is_trivially_copyable_v<FuncType> && std::is_trivially_destructible_v<FuncType>,
+		"jobs are copied around as bytes and never destroyed, capture by reference or by pointer");
+
+	const u32 threadIndex = GetThreadIndex();
+	ASSERT(threadIndex < m_threads.size(), "jobs can only be submitted from the main thread or a worker");
+
+	Job* job = AllocateJob(threadIndex);
+
+	new (job->storage) FuncType(std::forward<Func>(func));
+	job->invoke = [](void* storage) { (*static_cast<FuncType*>(storage))(); };
+	job->counter = counter;
+
+	if (counter != nullptr) {
+		counter->Increment();
+	}
+
+	return job;
+}
+
+template<typename Func>
+void JobSystem::Run(Func&& func, JobCounter* counter)
+{
+	Submit(CreateJob(std::forward<Func>(func), counter));
+}
+
+template<typename Func>
+void JobSystem::RunAfter(JobCounter& dependency, Func&& func, JobCounter* counter)
+{
+	Job* job = CreateJob(std::forward<Func>(func), counter);
+	if (!dependency.AddContinuation(job)) {
+		Submit(job);
+	}
+}
+
+template<typename Func>
+void JobSystem::RunOnMainThread(Func&& func, JobCounter* counter)
+{
+	SubmitMainThread(CreateJob(std::forward<Func>(func), counter));
+}
+
+template<typename Func>
+void JobSystem::ParallelFor(u32 count, u32 batchSize, Func&& func)
+{
+	if (count == 0) {
+		return;
+	}
+
+	batchSize = std::max(batchSize, 1u);
+
+	// not worth the overhead of a job
+	if (count <= batchSize || m_workers.empty()) {
+		func(0u, count);
+		return;
+	}
+
+	JobCounter counter;
+	auto* funcPtr = &func;
+
+	// keep the last batch for this thread
+	u32 begin = 0;
+	for (; begin + batchSize < count; begin += batchSize) {
+		const u32 end = begin + batchSize;
+		Run([funcPtr, begin, end]() { (*funcPtr)(begin, end); }, &counter);
+	}
+
+	func(begin, count);
+
+	Wait(counter);
+}
@@ -0,0 +1,507 @@
+#include "Log.hpp"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+#include <spdlog/async.h>
+#include <spdlog/details/os.h>
+#include <spdlog/sinks/sink.h>
+
+#include <charconv>
+
+namespace
+{
+	// single producer (its own thread) single consumer (the log thread) ring of Records
+	struct ThreadRing {
+		static constexpr u64 Capacity = 1 << 16;
+
+		size_t threadId = 0;
+
+		alignas(64) std::atomic<u64> writeIndex = 0;
+		// producer only, where the record being written ends
+		u64 reserveIndex = 0;
+		std::atomic<u64> dropped = 0;
+		// between BeginRecord and EndRecord, Shutdown waits for it so a record thats mid push isnt lost
+		std::atomic<bool> writing = false;
+
+		alignas(64) std::atomic<u64> readIndex = 0;
+
+		alignas(Log::detail::Record) byte data[Capacity];
+	};
+
+	static_assert(ThreadRing::Capacity % alignof(Log::detail::Record) == 0);
+	static_assert(Log::detail::MaxRecordSize <= ThreadRing::Capacity / 4);
+
+	// rings are never freed, threads keep a raw pointer to theirs
+	std::mutex s_ringsMutex;
+	std::vector<std::unique_ptr<ThreadRing>> s_rings;
+	thread_local ThreadRing* t_ring = nullptr;
+
+	std::atomic<u32> s_rateLimit = 100;
+
+	std::thread s_thread;
+	std::mutex s_wakeMutex;
+	std::condition_variable s_wake;
+	std::condition_variable s_flushed;
+	bool s_running = false;
+	u64 s_flushRequested = 0;
+	u64 s_flushDone = 0;
+
+	ThreadRing& GetThreadRing()
+	{
+		if (t_ring == nullptr) {
+			std::lock_guard lock(s_ringsMutex);
+			auto& ring = s_rings.emplace_back(std::make_unique<ThreadRing>());
+			ring->threadId = spdlog::details::os::thread_id();
+			t_ring = ring.get();
+		}
+		return *t_ring;
+	}
+
+	// same as what the logger does after formatting, minus the formatting
+	void Output(Log::Level level, spdlog::log_clock::time_point time, size_t threadId, fmt::string_view text)
+	{
+		spdlog::logger* logger = spdlog::default_logger_raw();
+
+		spdlog::details::log_msg msg(time, spdlog::source_loc{}, logger->name(), level, text);
+		msg.thread_id = threadId;
+
+		for (auto& sink : logger->sinks()) {
+			if (sink->should_log(level)) {
+				sink->log(msg);
+			}
+		}
+	}
+
+	struct PendingRecord {
+		const Log::detail::Record* record;
+		size_t threadId;
+	};
+
+	// formats and writes out everything the rings have right now, returns whether there was anything
+	bool Drain(std::vector<PendingRecord>& pending, fmt::memory_buffer& buffer)
+	{
+		std::vector<ThreadRing*> rings;
+		{
+			std::lock_guard lock(s_ringsMutex);
+			rings.reserve(s_rings.size());
+			for (auto& ring : s_rings) {
+				rings.push_back(ring.get());
+			}
+		}
+
+		pending.clear();
+		std::vector<u64> ends(rings.size());
+
+		for (size_t i = 0; i < rings.size(); ++i) {
+			ThreadRing& ring = *rings[i];
+			const u64 end = ring.writeIndex.load(std::memory_order_acquire);
+			ends[i] = end;
+
+			for (u64 index = ring.readIndex.load(std::memory_order_relaxed); index < end;) {
+				const auto* record = reinterpret_cast<const Log::detail::Record*>(&ring.data[index % ThreadRing::Capacity]);
+				if (record->decode != nullptr) {
+					pending.push_back(PendingRecord{ record, ring.threadId });
+				}
+				index += record->size;
+			}
+		}
+
+		// each ring is in order already, this interleaves the threads
+		std::stable_sort(pending.begin(), pending.end(), [](const PendingRecord& a, const PendingRecord& b) {
+			return a.record->time < b.record->time;
+		});
+
+		for (const PendingRecord& entry : pending) {
+			const Log::detail::Record& record = *entry.record;
+
+			buffer.clear();
+			record.decode(fmt::string_view(record.format, record.formatSize), reinterpret_cast<const byte*>(&record + 1), buffer);
+			if (record.suppressed > 0) {
+				fmt::format_to(fmt::appender(buffer), " ({} more suppressed)", record.suppressed);
+			}
+
+			Output(record.level, record.time, entry.threadId, fmt::string_view(buffer.data(), buffer.size()));
+		}
+
+		// only now can the producers reuse the space
+		for (size_t i = 0; i < rings.size(); ++i) {
+			rings[i]->readIndex.store(ends[i], std::memory_order_release);
+
+			if (const u64 dropped = rings[i]->dropped.exchange(0, std::memory_order_relaxed); dropped > 0) {
+				buffer.clear();
+				fmt::format_to(fmt::appender(buffer), "log ring full, dropped {} messages", dropped);
+				Output(Log::Level::warn, spdlog::log_clock::now(), rings[i]->threadId, fmt::string_view(buffer.data(), buffer.size()));
+			}
+		}
+
+		if (!pending.empty()) {
+			spdlog::default_logger_raw()->flush();
+		}
+
+		return !pending.empty();
+	}
+
+	void LogThread()
+	{
+		std::vector<PendingRecord> pending;
+		fmt::memory_buffer buffer;
+
+		std::unique_lock lock(s_wakeMutex);
+		for (;;) {
+			// nobody signals new records, waking the log thread on every message would cost more than the message,
+			// so it just polls, flushes and shutdown wake it up early
+			s_wake.wait_for(lock, std::chrono::milliseconds(5));
+
+			const bool running = s_running;
+			const u64 flushRequested = s_flushRequested;
+
+			lock.unlock();
+			Drain(pending, buffer);
+			lock.lock();
+
+			s_flushDone = flushRequested;
+			s_flushed.notify_all();
+
+			if (!running) {
+				break;
+			}
+		}
+	}
+}
+
+namespace Log
+{
+	namespace detail
+	{
+		std::atomic<bool> deferred = false;
+
+		bool PassRateLimit(Site& site, spdlog::log_clock::time_point now, u32& outSuppressed)
+		{
+			const u32 limit = s_rateLimit.load(std::memory_order_relaxed);
+			if (limit == 0) {
+				return true;
+			}
+
+			const i64 nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+			i64 windowStart = site.windowStart.load(std::memory_order_relaxed);
+			if (nowMs - windowStart >= 1000 && site.windowStart.compare_exchange_strong(windowStart, nowMs, std::memory_order_relaxed)) {
+				site.count.store(0, std::memory_order_relaxed);
+			}
+
+			if (site.count.fetch_add(1, std::memory_order_relaxed) >= limit) {
+				site.suppressed.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			outSuppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+			return true;
+		}
+
+		byte* BeginRecord(size_t size)
+		{
+			ThreadRing& ring = GetThreadRing();
+
+			// pairs with Shutdown, which turns deferred off and then checks writing, both sequentially consistent
+			// so either this sees deferred off or Shutdown sees the ring being written and waits for it
+			ring.writing.store(true);
+			if (!deferred.load()) {
+				ring.writing.store(false, std::memory_order_release);
+				return nullptr;
+			}
+
+			u64 write = ring.writeIndex.load(std::memory_order_relaxed);
+			const u64 read = ring.readIndex.load(std::memory_order_acquire);
+
+			// records dont wrap, if it doesnt fit before the end pad the rest out and start over at the front
+			const u64 offset = write % ThreadRing::Capacity;
+			const u64 untilEnd = ThreadRing::Capacity - offset;
+			const u64 padding = size > untilEnd ? untilEnd : 0;
+
+			if (write + padding + size - read > ThreadRing::Capacity) {
+				ring.writing.store(false, std::memory_order_release);
+				return nullptr;
+			}
+
+			if (padding > 0) {
+				auto* pad = reinterpret_cast<Record*>(&ring.data[offset]);
+				pad->size = static_cast<u32>(padding);
+				pad->decode = nullptr;
+				write += padding;
+			}
+
+			ring.reserveIndex = write + size;
+			return &ring.data[write % ThreadRing::Capacity];
+		}
+
+		void EndRecord()
+		{
+			ThreadRing& ring = *t_ring;
+			ring.writeIndex.store(ring.reserveIndex, std::memory_order_release);
+			ring.writing.store(false, std::memory_order_release);
+		}
+
+		void DropRecord()
+		{
+			GetThreadRing().dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void WriteNow(Level level, spdlog::log_clock::time_point time, fmt::string_view format, fmt::format_args args, u32 suppressed)
+		{
+			fmt::memory_buffer buffer;
+			fmt::vformat_to(fmt::appender(buffer), format, args);
+			if (suppressed > 0) {
+				fmt::format_to(fmt::appender(buffer), " ({} more suppressed)", suppressed);
+			}
+
+			if (level >= Level::critical) {
+				// whatever is queued up probably explains how we got here, so it goes out first
+				Flush();
+			}
+
+			Output(level, time, spdlog::details::os::thread_id(), fmt::string_view(buffer.data(), buffer.size()));
+		}
+	}
+
+	void Init(bool deferred)
+	{
+		if (!deferred) {
+			return;
+		}
+
+		{
+			std::lock_guard lock(s_wakeMutex);
+			s_running = true;
+		}
+		s_thread = std::thread(LogThread);
+		detail::deferred.store(true);
+
+		spdlog::info("deferred logging enabled, {} per call site per second", s_rateLimit.load());
+	}
+
+	void Shutdown()
+	{
+		if (!s_thread.joinable()) {
+			return;
+		}
+
+		// anything logged after this is written right away
+		detail::deferred.store(false);
+		{
+			std::lock_guard lock(s_wakeMutex);
+			s_running = false;
+			s_wake.notify_one();
+		}
+		s_thread.join();
+
+		// a thread that got into BeginRecord before deferred went off can still be writing its record, the log
+		// thread might have done its last drain before it was done, wait for those and write them out here
+		{
+			std::lock_guard lock(s_ringsMutex);
+			for (auto& ring : s_rings) {
+				while (ring->writing.load()) {
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		std::vector<PendingRecord> pending;
+		fmt::memory_buffer buffer;
+		Drain(pending, buffer);
+	}
+
+	void Flush()
+	{
+		if (!detail::deferred.load()) {
+			return;
+		}
+
+		std::unique_lock lock(s_wakeMutex);
+		const u64 flush = ++s_flushRequested;
+		s_wake.notify_one();
+		s_flushed.wait(lock, [flush]() { return s_flushDone >= flush || !s_running; });
+	}
+
+	void SetRateLimit(u32 perSecond)
+	{
+		s_rateLimit.store(perSecond);
+	}
+}
+
+#pragma region Benchmark
+
+namespace
+{
+	// counts what reaches it, no formatting or io so only the cost of getting there is measured, the drop
+	// warnings of the deferred path are parsed so lost messages can be told from dropped ones
+	class CountingSink : public spdlog::sinks::sink {
+	public:
+		void log(const spdlog::details::log_msg& msg) override
+		{
+			constexpr std::string_view droppedPrefix = "log ring full, dropped ";
+
+			const std::string_view text(msg.payload.data(), msg.payload.size());
+			if (msg.level == Log::Level::warn && text.starts_with(droppedPrefix)) {
+				u64 count = 0;
+				std::from_chars(text.data() + droppedPrefix.size(), text.data() + text.size(), count);
+				dropped.fetch_add(count, std::memory_order_relaxed);
+			} else {
+				received.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		void flush() override {}
+		void set_pattern(const std::string&) override {}
+		void set_formatter(std::unique_ptr<spdlog::formatter>) override {}
+
+		std::atomic<u64> received = 0;
+		std::atomic<u64> dropped = 0;
+	};
+
+	struct LatencyResult {
+		// ns per call on the calling thread, over every call of every thread
+		f64 p50 = 0.0;
+		f64 p99 = 0.0;
+		f64 p999 = 0.0;
+		f64 max = 0.0;
+	};
+
+	constexpr u32 BurstSize = 128;
+
+	template<typename Func>
+	LatencyResult MeasureLatency(u32 threadCount, u32 messageCount, Func&& logMessage)
+	{
+		std::vector<std::vector<f32>> latencies(threadCount);
+		std::vector<std::thread> threads;
+		threads.reserve(threadCount);
+
+		for (u32 t = 0; t < threadCount; ++t) {
+			threads.emplace_back([&, t]() {
+				std::vector<f32>& times = latencies[t];
+				times.resize(messageCount);
+				for (u32 i = 0; i < messageCount; ++i) {
+					// in bursts like a frame would log them, flat out every ring overflows between two drains
+					if (i % BurstSize == 0) {
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					}
+
+					const auto start = std::chrono::steady_clock::now();
+					logMessage(t, i);
+					times[i] = std::chrono::duration<f32, std::nano>(std::chrono::steady_clock::now() - start).count();
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		LatencyResult result;
+
+		std::vector<f32> all;
+		all.reserve(static_cast<size_t>(threadCount) * messageCount);
+		for (const std::vector<f32>& times : latencies) {
+			all.insert(all.end(), times.begin(), times.end());
+		}
+		std::sort(all.begin(), all.end());
+
+		const auto percentile = [&](f64 p) { return static_cast<f64>(all[std::min(static_cast<size_t>(p * all.size()), all.size() - 1)]); };
+		result.p50 = percentile(0.5);
+		result.p99 = percentile(0.99);
+		result.p999 = percentile(0.999);
+		result.max = all.back();
+		return result;
+	}
+
+	void LogLatency(std::string_view name, const LatencyResult& result, u64 received, u64 dropped, u64 sent, bool complete)
+	{
+		spdlog::info("{:14} per call p50 {:7.1f}ns p99 {:8.1f}ns p99.9 {:8.1f}ns max {:10.1f}ns, {} received {} dropped of {} {}",
+			name, result.p50, result.p99, result.p999, result.max, received, dropped, sent, complete ? "matches" : "MISMATCH");
+	}
+}
+
+bool Log::RunBenchmark()
+{
+	constexpr u32 messageCount = 20000;
+	const u32 threadCount = std::clamp(std::thread::hardware_concurrency(), 2u, 8u);
+	const u64 sent = static_cast<u64>(threadCount) * messageCount;
+
+	spdlog::info("log benchmark, {} threads logging {} messages each in bursts of {}", threadCount, messageCount, BurstSize);
+
+	// the benchmark swaps the default logger for its own, everything is written to the old one until it is back
+	Flush();
+	const std::shared_ptr<spdlog::logger> previousLogger = spdlog::default_logger();
+	const u32 previousRateLimit = s_rateLimit.load();
+	const bool wasDeferred = detail::deferred.load();
+
+	auto sink = std::make_shared<CountingSink>();
+	bool passed = true;
+
+	// LOG_INFO, deferred to the log thread
+	LatencyResult deferredResult;
+	{
+		if (!wasDeferred) {
+			Init(true);
+		}
+		auto logger = std::make_shared<spdlog::logger>("log_benchmark", sink);
+		logger->set_level(spdlog::level::trace);
+		spdlog::set_default_logger(logger);
+		SetRateLimit(0);
+
+		deferredResult = MeasureLatency(threadCount, messageCount, [](u32 thread, u32 i) {
+			LOG_INFO("benchmark message {} from thread {}, {:.3f} and {}", i, thread, i * 0.25f, std::string_view("a string"));
+		});
+
+		if (!wasDeferred) {
+			Shutdown();
+		} else {
+			Flush();
+		}
+	}
+	const u64 deferredReceived = sink->received.exchange(0);
+	const u64 deferredDropped = sink->dropped.exchange(0);
+
+	// the default logger as it is used everywhere else, formats and writes on the calling thread
+	LatencyResult syncResult;
+	{
+		auto logger = std::make_shared<spdlog::logger>("log_benchmark_sync", sink);
+		logger->set_level(spdlog::level::trace);
+		syncResult = MeasureLatency(threadCount, messageCount, [&logger](u32 thread, u32 i) {
+			logger->info("benchmark message {} from thread {}, {:.3f} and {}", i, thread, i * 0.25f, std::string_view("a string"));
+		});
+	}
+	const u64 syncReceived = sink->received.exchange(0);
+
+	// spdlogs own async logger, a shared queue to a thread pool, blocks when the queue is full
+	LatencyResult asyncResult;
+	{
+		auto pool = std::make_shared<spdlog::details::thread_pool>(8192, 1);
+		auto logger = std::make_shared<spdlog::async_logger>("log_benchmark_async", sink, pool, spdlog::async_overflow_policy::block);
+		logger->set_level(spdlog::level::trace);
+		asyncResult = MeasureLatency(threadCount, messageCount, [&logger](u32 thread, u32 i) {
+			logger->info("benchmark message {} from thread {}, {:.3f} and {}", i, thread, i * 0.25f, std::string_view("a string"));
+		});
+		// the pool thread writes out what is left and stops
+		logger.reset();
+		pool.reset();
+	}
+	const u64 asyncReceived = sink->received.exchange(0);
+
+	SetRateLimit(previousRateLimit);
+	spdlog::set_default_logger(previousLogger);
+
+	// dropping below warn when a ring is full is by design, losing them without a count isnt
+	const bool deferredComplete = deferredReceived + deferredDropped == sent;
+	const bool syncComplete = syncReceived == sent;
+	const bool asyncComplete = asyncReceived == sent;
+	passed &= deferredComplete && syncComplete && asyncComplete;
+
+	LogLatency("LOG_INFO", deferredResult, deferredReceived, deferredDropped, sent, deferredComplete);
+	LogLatency("spdlog sync", syncResult, syncReceived, 0, sent, syncComplete);
+	LogLatency("spdlog async", asyncResult, asyncReceived, 0, sent, asyncComplete);
+
+	spdlog::info("log checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
+
+#pragma endregion
@@ -0,0 +1,251 @@
+#pragma once
+
+#include "Basic.hpp"
+
+#include <atomic>
+#include <tuple>
+#include <string_view>
+#include <type_traits>
+
+// anything below this level is compiled out, arguments and all, uses the SPDLOG_LEVEL_* values
+#ifndef ENGINE_LOG_LEVEL
+#ifdef _DEBUG
+#define ENGINE_LOG_LEVEL SPDLOG_LEVEL_TRACE
+#else
+#define ENGINE_LOG_LEVEL SPDLOG_LEVEL_INFO
+#endif
+#endif
+
+// logging for loading and frame code, goes through the default spdlog logger (same sinks, same pattern)
+// but in deferred mode the calling thread only copies the arguments into its own ring buffer,
+// formatting and io happen on a background thread
+//
+// usage:
+//	LOG_INFO("loaded mesh {}", path);
+//	LOG_TRACE("[accessor name={} count={}]", SPDLOG_PTR(accessor.name), accessor.count);
+//
+// - format strings have to be string literals, they are kept by pointer
+// - arguments are copied as bytes, so they have to be trivially copyable or strings (const char*, std::string_view, std::string)
+// - each call site logs at most the rate limit per second, what gets dropped is counted on the next message from the same site
+// - if a threads ring is full, messages below warn are dropped (and counted) rather than blocking, warn and up are logged right away
+// - critical always logs right away, after everything queued before it, usually something is about to go down
+// - deferred messages can show up after direct spdlog calls made later, the timestamps are when the message was logged
+#define LOG_AT(level, ...) do {						\
+	static Log::Site logSite_;						\
+	Log::Write(logSite_, level, __VA_ARGS__);		\
+} while (0)
+
+#if ENGINE_LOG_LEVEL <= SPDLOG_LEVEL_TRACE
+#define LOG_TRACE(...) LOG_AT(spdlog::level::trace, __VA_ARGS__)
+#else
+#define LOG_TRACE(...) ((void)0)
+#endif
+
+#if ENGINE_LOG_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LOG_AT(spdlog::level::debug, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#if ENGINE_LOG_LEVEL <= SPDLOG_LEVEL_INFO
+#define LOG_INFO(...) LOG_AT(spdlog::level::info, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if ENGINE_LOG_LEVEL <= SPDLOG_LEVEL_WARN
+#define LOG_WARN(...) LOG_AT(spdlog::level::warn, __VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+
+#if ENGINE_LOG_LEVEL <= SPDLOG_LEVEL_ERROR
+#define LOG_ERROR(...) LOG_AT(spdlog::level::err, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+
+#if ENGINE_LOG_LEVEL <= SPDLOG_LEVEL_CRITICAL
+#define LOG_CRITICAL(...) LOG_AT(spdlog::level::critical, __VA_ARGS__)
+#else
+#define LOG_CRITICAL(...) ((void)0)
+#endif
+
+namespace Log
+{
+	using Level = spdlog::level::level_enum;
+
+	// per call site rate limiting state, one static per LOG_* macro
+	struct Site {
+		// ms since epoch
+		std::atomic<i64> windowStart = 0;
+		std::atomic<u32> count = 0;
+		std::atomic<u32> suppressed = 0;
+	};
+
+	// deferred starts the background thread, otherwise everything is formatted and written on the calling thread
+	// call after the default spdlog logger is set up
+	void Init(bool deferred);
+	// writes out everything still queued and stops the background thread
+	void Shutdown();
+	// blocks until everything logged before the call is written
+	void Flush();
+
+	// max messages per call site per second, 0 turns rate limiting off
+	void SetRateLimit(u32 perSecond);
+
+	// a few threads logging as fast as they can through LOG_INFO, a synchronous and an asynchronous spdlog logger,
+	// all into a sink that only counts, checks nothing is lost and logs the latency of a call on the calling thread
+	bool RunBenchmark();
+
+	namespace detail
+	{
+		using DecodeFunc = void (*)(fmt::string_view format, const byte* args, fmt::memory_buffer& out);
+
+		struct alignas(16) Record {
+			// whole record including arguments, multiple of alignof(Record)
+			u32 size;
+			u32 suppressed;
+			// nullptr marks padding up to the end of the ring
+			DecodeFunc decode;
+			const char* format;
+			u32 formatSize;
+			Level level;
+			spdlog::log_clock::time_point time;
+		};
+
+		// bigger records are logged right away instead
+		constexpr size_t MaxRecordSize = 4096;
+
+		extern std::atomic<bool> deferred;
+
+		bool PassRateLimit(Site& site, spdlog::log_clock::time_point now, u32& outSuppressed);
+
+		// space for size bytes in the calling threads ring, nullptr if it is full or deferred logging was turned off
+		// since the caller checked, every record begun has to be ended
+		byte* BeginRecord(size_t size);
+		// makes the record visible to the background thread
+		void EndRecord();
+		// counts a message lost to a full ring
+		void DropRecord();
+
+		void WriteNow(Level level, spdlog::log_clock::time_point time, fmt::string_view format, fmt::format_args args, u32 suppressed);
+
+		// how each argument type is stored in the ring
+		template<typename T>
+		struct ArgCodec {
+			static_assert(std::is_trivially_copyable_v<T>, "deferred log arguments have to be trivially copyable or strings, format it first or log with spdlog directly");
+			using Decoded = T;
+
+			static inline size_t Size(const T&) { return sizeof(T); }
+			static inline void Encode(byte*& cursor, const T& value)
+			{
+				memcpy(cursor, &value, sizeof(T));
+				cursor += sizeof(T);
+			}
+			static inline T Decode(const byte*& cursor)
+			{
+				T value;
+				memcpy(&value, cursor, sizeof(T));
+				cursor += sizeof(T);
+				return value;
+			}
+		};
+
+		// strings are copied, whatever they point to might be gone by the time the message is formatted
+		struct StringCodec {
+			using Decoded = std::string_view;
+
+			static inline size_t Size(std::string_view str) { return sizeof(u32) + str.size(); }
+			static inline void Encode(byte*& cursor, std::string_view str)
+			{
+				const u32 size = static_cast<u32>(str.size());
+				memcpy(cursor, &size, sizeof(u32));
+				memcpy(cursor + sizeof(u32), str.data(), size);
+				cursor += sizeof(u32) + size;
+			}
+			static inline std::string_view Decode(const byte*& cursor)
+			{
+				u32 size;
+				memcpy(&size, cursor, sizeof(u32));
+				std::string_view str(reinterpret_cast<const char*>(cursor + sizeof(u32)), size);
+				cursor += sizeof(u32) + size;
+				return str;
+			}
+		};
+
+		struct CStringCodec : StringCodec {
+			static inline std::string_view ToView(const char* str) { return str != nullptr ? std::string_view(str) : std::string_view("nullptr"); }
+			static inline size_t Size(const char* str) { return StringCodec::Size(ToView(str)); }
+			static inline void Encode(byte*& cursor, const char* str) { StringCodec::Encode(cursor, ToView(str)); }
+		};
+
+		template<> struct ArgCodec<std::string_view> : StringCodec {};
+		template<> struct ArgCodec<std::string> : StringCodec {};
+		template<> struct ArgCodec<const char*> : CStringCodec {};
+		template<> struct ArgCodec<char*> : CStringCodec {};
+
+		template<typename T>
+		using Codec = ArgCodec<std::decay_t<T>>;
+
+		template<typename... Args>
+		void Decode(fmt::string_view format, const byte* args, fmt::memory_buffer& out)
+		{
+			// braced init evaluates left to right, so the arguments come out in the order they went in
+			std::tuple<typename ArgCodec<Args>::Decoded...> values{ ArgCodec<Args>::Decode(args)... };
+			std::apply([&](auto&... decoded) {
+				fmt::vformat_to(fmt::appender(out), format, fmt::make_format_args(decoded...));
+			}, values);
+		}
+
+		inline size_t AlignRecordSize(size_t size)
+		{
+			return (size + alignof(Record) - 1) & ~(alignof(Record) - 1);
+		}
+	}
+
+	template<typename... Args>
+	void Write(Site& site, Level level, fmt::format_string<Args...> format, Args&&... args)
+	{
+		if (!spdlog::default_logger_raw()->should_log(level)) {
+			return;
+		}
+
+		const auto now = spdlog::log_clock::now();
+		u32 suppressed = 0;
+		if (!detail::PassRateLimit(site, now, suppressed)) {
+			return;
+		}
+
+		if (detail::deferred.load(std::memory_order_relaxed) && level < Level::critical) {
+			const size_t size = detail::AlignRecordSize(sizeof(detail::Record) + (size_t{ 0 } + ... + detail::Codec<Args>::Size(args)));
+
+			if (size <= detail::MaxRecordSize) {
+				if (byte* memory = detail::BeginRecord(size)) {
+					const fmt::string_view formatView = format.get();
+					new (memory) detail::Record{
+						.size = static_cast<u32>(size),
+						.suppressed = suppressed,
+						.decode = &detail::Decode<std::decay_t<Args>...>,
+						.format = formatView.data(),
+						.formatSize = static_cast<u32>(formatView.size()),
+						.level = level,
+						.time = now,
+					};
+
+					byte* cursor = memory + sizeof(detail::Record);
+					(detail::Codec<Args>::Encode(cursor, args), ...);
+					detail::EndRecord();
+					return;
+				}
+
+				if (level < Level::warn && detail::deferred.load(std::memory_order_relaxed)) {
+					detail::DropRecord();
+					return;
+				}
+			}
+		}
+
+		detail::WriteNow(level, now, format.get(), fmt::make_format_args(args...), suppressed);
+	}
+}
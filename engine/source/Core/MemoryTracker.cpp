@@ -0,0 +1,339 @@
+#include "MemoryTracker.hpp"
+#include "JobSystem.hpp"
+
+#include <chrono>
+
+static const char* memoryTagStrings[] = {
+	"untagged",
+	"assets_mesh",
+	"assets_texture",
+	"assets_animation",
+	"assets_material",
+	"shader",
+	"scene",
+	"renderer",
+	"scratch",
+};
+
+static_assert(ARRLEN(memoryTagStrings) == static_cast<size_t>(MemoryTag::Num));
+
+const char* MemoryTagToString(MemoryTag tag)
+{
+	ENSURE(tag < MemoryTag::Num, "");
+	return memoryTagStrings[static_cast<u32>(tag)];
+}
+
+namespace
+{
+	// one cache line each, assets load on workers so different tags get hit from different threads
+	struct alignas(64) TagCounters {
+		std::atomic<i64> live = 0;
+		std::atomic<i64> peak = 0;
+		std::atomic<i64> allocCount = 0;
+		std::atomic<i64> freeCount = 0;
+
+		std::atomic<u64> budget = 0;
+		// so going over budget warns once instead of on every allocation after it
+		std::atomic<bool> overBudget = false;
+	};
+
+	std::array<TagCounters, static_cast<u32>(MemoryTag::Num)> s_counters;
+	f64 s_trackingOverhead = 0.0;
+
+	TagCounters& GetCounters(MemoryTag tag)
+	{
+		ASSERT(tag < MemoryTag::Num, "");
+		return s_counters[static_cast<u32>(tag)];
+	}
+
+	std::string FormatBytes(i64 bytes)
+	{
+		const f64 absBytes = static_cast<f64>(bytes < 0 ? -bytes : bytes);
+		if (absBytes >= 1024.0 * 1024.0) {
+			return fmt::format("{:.2f} MB", bytes / (1024.0 * 1024.0));
+		}
+		if (absBytes >= 1024.0) {
+			return fmt::format("{:.2f} KB", bytes / 1024.0);
+		}
+		return fmt::format("{} B", bytes);
+	}
+}
+
+namespace MemoryTracker
+{
+	namespace detail
+	{
+		void OnAlloc(MemoryTag tag, size_t size)
+		{
+			TagCounters& counters = GetCounters(tag);
+
+			const i64 live = counters.live.fetch_add(static_cast<i64>(size), std::memory_order_relaxed) + static_cast<i64>(size);
+			counters.allocCount.fetch_add(1, std::memory_order_relaxed);
+
+			i64 peak = counters.peak.load(std::memory_order_relaxed);
+			while (live > peak && !counters.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+			}
+
+			const u64 budget = counters.budget.load(std::memory_order_relaxed);
+			if (budget != 0 && static_cast<u64>(live) > budget && !counters.overBudget.exchange(true, std::memory_order_relaxed)) {
+				spdlog::warn("memory budget exceeded for {}: {} live, budget {}", MemoryTagToString(tag), FormatBytes(live), FormatBytes(static_cast<i64>(budget)));
+			}
+		}
+
+		void OnFree(MemoryTag tag, size_t size)
+		{
+			TagCounters& counters = GetCounters(tag);
+
+			const i64 live = counters.live.fetch_sub(static_cast<i64>(size), std::memory_order_relaxed) - static_cast<i64>(size);
+			counters.freeCount.fetch_add(1, std::memory_order_relaxed);
+			ASSERT(live >= 0, "more memory freed than allocated, sizes passed to TrackFree have to match TrackAlloc");
+
+			const u64 budget = counters.budget.load(std::memory_order_relaxed);
+			if (budget == 0 || static_cast<u64>(live) <= budget) {
+				counters.overBudget.store(false, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	void Init()
+	{
+#if ENGINE_MEMORY_TRACKING
+		// time tracked against plain allocations of the same size, the difference is what tracking costs
+		constexpr u32 calibrationAllocs = 10000;
+		constexpr size_t calibrationSize = 64;
+
+		auto timeAllocs = [](auto&& allocFree) {
+			const auto begin = std::chrono::steady_clock::now();
+			for (u32 i = 0; i < calibrationAllocs; ++i) {
+				allocFree();
+			}
+			return std::chrono::duration<f64, std::nano>(std::chrono::steady_clock::now() - begin).count() / calibrationAllocs;
+		};
+
+		const TagStats before = GetStats(MemoryTag::Untagged);
+
+		// volatile so the optimiser cant pair up the malloc and free and drop both
+		void* volatile sink = nullptr;
+		const f64 untracked = timeAllocs([&]() {
+			sink = malloc(calibrationSize);
+			free(sink);
+		});
+		const f64 tracked = timeAllocs([&]() {
+			sink = Alloc(MemoryTag::Untagged, calibrationSize);
+			Free(sink);
+		});
+		s_trackingOverhead = std::max(tracked - untracked, 0.0);
+
+		// calibration shouldnt show up in the counts
+		TagCounters& counters = GetCounters(MemoryTag::Untagged);
+		counters.peak.store(before.peak, std::memory_order_relaxed);
+		counters.allocCount.store(before.allocCount, std::memory_order_relaxed);
+		counters.freeCount.store(before.freeCount, std::memory_order_relaxed);
+
+		spdlog::info("memory tracking enabled, {:.1f}ns per tracked allocation", s_trackingOverhead);
+#endif
+	}
+
+	f64 GetTrackingOverhead()
+	{
+		return s_trackingOverhead;
+	}
+
+	void SetBudget(MemoryTag tag, u64 bytes)
+	{
+		GetCounters(tag).budget.store(bytes, std::memory_order_relaxed);
+	}
+
+	u64 GetBudget(MemoryTag tag)
+	{
+		return GetCounters(tag).budget.load(std::memory_order_relaxed);
+	}
+
+	TagStats GetStats(MemoryTag tag)
+	{
+		const TagCounters& counters = GetCounters(tag);
+		return TagStats{
+			.live = counters.live.load(std::memory_order_relaxed),
+			.peak = counters.peak.load(std::memory_order_relaxed),
+			.allocCount = counters.allocCount.load(std::memory_order_relaxed),
+			.freeCount = counters.freeCount.load(std::memory_order_relaxed),
+		};
+	}
+
+	Snapshot TakeSnapshot()
+	{
+		// each tag is consistent on its own, tags can be off from each other if other threads are allocating
+		Snapshot snapshot;
+		for (u32 i = 0; i < static_cast<u32>(MemoryTag::Num); ++i) {
+			snapshot.tags[i] = GetStats(static_cast<MemoryTag>(i));
+		}
+		return snapshot;
+	}
+
+	Snapshot Diff(const Snapshot& before, const Snapshot& after)
+	{
+		Snapshot diff;
+		for (u32 i = 0; i < static_cast<u32>(MemoryTag::Num); ++i) {
+			diff.tags[i] = TagStats{
+				.live = after.tags[i].live - before.tags[i].live,
+				.peak = after.tags[i].peak,
+				.allocCount = after.tags[i].allocCount - before.tags[i].allocCount,
+				.freeCount = after.tags[i].freeCount - before.tags[i].freeCount,
+			};
+		}
+		return diff;
+	}
+
+	void LogSnapshot([[maybe_unused]] std::string_view title, [[maybe_unused]] const Snapshot& snapshot)
+	{
+#if ENGINE_MEMORY_TRACKING
+		spdlog::info("memory: {}", title);
+		for (u32 i = 0; i < static_cast<u32>(MemoryTag::Num); ++i) {
+			const TagStats& stats = snapshot.tags[i];
+			const u64 budget = GetBudget(static_cast<MemoryTag>(i));
+			spdlog::info("  {:<16} live {:>12}  peak {:>12}  allocs {:>8}  budget {}",
+				memoryTagStrings[i], FormatBytes(stats.live), FormatBytes(stats.peak), stats.allocCount - stats.freeCount,
+				budget != 0 ? FormatBytes(static_cast<i64>(budget)) : std::string("none"));
+		}
+#endif
+	}
+
+	void LogDiff([[maybe_unused]] std::string_view title, [[maybe_unused]] const Snapshot& diff)
+	{
+#if ENGINE_MEMORY_TRACKING
+		spdlog::info("memory: {}", title);
+		for (u32 i = 0; i < static_cast<u32>(MemoryTag::Num); ++i) {
+			const TagStats& stats = diff.tags[i];
+			if (stats.live == 0 && stats.allocCount == 0 && stats.freeCount == 0) {
+				continue;
+			}
+			spdlog::info("  {:<16} {:>+12} bytes  {:+} allocs  {:+} frees  peak {}",
+				memoryTagStrings[i], stats.live, stats.allocCount, stats.freeCount, FormatBytes(stats.peak));
+		}
+#endif
+	}
+
+	// counts a known sequence of sizes on tag, allocated in order then freed in reverse, the peak is the sum of all of them
+	static bool CheckCounting(MemoryTag tag)
+	{
+		constexpr size_t sizes[] = { 16, 1000, 64, 4096, 3, 250000, 48 };
+
+		const Snapshot before = TakeSnapshot();
+		i64 total = 0;
+		for (size_t size : sizes) {
+			detail::OnAlloc(tag, size);
+			total += static_cast<i64>(size);
+		}
+		const TagStats held = GetStats(tag);
+		for (size_t i = ARRLEN(sizes); i > 0; --i) {
+			detail::OnFree(tag, sizes[i - 1]);
+		}
+		const Snapshot diff = Diff(before, TakeSnapshot());
+
+		const i64 count = static_cast<i64>(ARRLEN(sizes));
+		const TagStats& beforeTag = before[tag];
+		bool passed = held.live == beforeTag.live + total && held.allocCount == beforeTag.allocCount + count;
+		passed &= held.peak == std::max(beforeTag.peak, beforeTag.live + total);
+		passed &= diff[tag].live == 0 && diff[tag].allocCount == count && diff[tag].freeCount == count && diff[tag].peak == held.peak;
+
+		// nothing else moved
+		for (u32 i = 0; i < static_cast<u32>(MemoryTag::Num); ++i) {
+			const TagStats& other = diff.tags[i];
+			passed &= i == static_cast<u32>(tag) || (other.live == 0 && other.allocCount == 0 && other.freeCount == 0);
+		}
+
+		spdlog::info("counting: {} bytes in {} allocations, live, peak and diff {}", total, count, passed ? "match" : "MISMATCH");
+		return passed;
+	}
+
+	// every worker allocates and frees the same sizes at once, the counters have to balance and count every call
+	static bool CheckConcurrent(MemoryTag tag)
+	{
+		constexpr u32 allocCount = 1 << 16;
+
+		const TagStats before = GetStats(tag);
+		global::jobSystem->ParallelFor(allocCount, 256, [&](u32 begin, u32 end) {
+			for (u32 i = begin; i < end; ++i) {
+				detail::OnAlloc(tag, i % 512 + 1);
+			}
+			for (u32 i = begin; i < end; ++i) {
+				detail::OnFree(tag, i % 512 + 1);
+			}
+		});
+		const TagStats after = GetStats(tag);
+
+		const bool passed = after.live == before.live && after.allocCount - before.allocCount == allocCount
+			&& after.freeCount - before.freeCount == allocCount && after.peak >= before.live;
+		spdlog::info("concurrent: {} allocations on {} threads, counters {}", allocCount, global::jobSystem->GetThreadCount() + 1,
+			passed ? "balance" : "MISMATCH");
+		return passed;
+	}
+
+#if ENGINE_MEMORY_TRACKING
+	// the header has to carry size and tag through to Free, and a tracked container has to give everything back
+	static bool CheckTrackedAllocations(MemoryTag tag)
+	{
+		const TagStats before = GetStats(tag);
+
+		void* blob = Alloc(tag, 1000);
+		const bool aligned = reinterpret_cast<uintptr_t>(blob) % alignof(detail::Header) == 0;
+		const i64 blobLive = GetStats(tag).live - before.live;
+		Free(blob);
+
+		i64 vectorLive = 0;
+		{
+			TrackedVector<u32, MemoryTag::Scratch> values(100);
+			vectorLive = GetStats(MemoryTag::Scratch).live - (tag == MemoryTag::Scratch ? before.live : 0);
+		}
+
+		const TagStats after = GetStats(tag);
+		const bool passed = aligned && blobLive == 1000 && vectorLive == static_cast<i64>(100 * sizeof(u32))
+			&& after.live == before.live && after.allocCount - before.allocCount == 2;
+		spdlog::info("Alloc/Free and TrackedVector {}", passed ? "match" : "MISMATCH");
+		return passed;
+	}
+#endif
+
+	bool RunBenchmark()
+	{
+		constexpr u32 allocCount = 1000000;
+		constexpr size_t allocSize = 64;
+		constexpr MemoryTag tag = MemoryTag::Scratch;
+
+		spdlog::info("memory tracker benchmark, tracking {}", ENGINE_MEMORY_TRACKING ? "enabled" : "compiled out");
+
+		bool passed = CheckCounting(tag);
+		passed &= CheckConcurrent(tag);
+#if ENGINE_MEMORY_TRACKING
+		passed &= CheckTrackedAllocations(tag);
+#endif
+
+		auto timeAllocs = [](auto&& allocFree) {
+			spdlog::stopwatch sw;
+			for (u32 i = 0; i < allocCount; ++i) {
+				allocFree();
+			}
+			return sw.elapsed().count() * 1e9 / allocCount;
+		};
+
+		// volatile so the optimiser cant pair up the malloc and free and drop both
+		void* volatile sink = nullptr;
+		const f64 counting = timeAllocs([&]() {
+			detail::OnAlloc(tag, allocSize);
+			detail::OnFree(tag, allocSize);
+		});
+		const f64 untracked = timeAllocs([&]() {
+			sink = malloc(allocSize);
+			free(sink);
+		});
+		const f64 tracked = timeAllocs([&]() {
+			sink = Alloc(tag, allocSize);
+			Free(sink);
+		});
+
+		spdlog::info("{} allocations of {} bytes: counting {:.1f}ns, malloc/free {:.1f}ns, Alloc/Free {:.1f}ns per pair",
+			allocCount, allocSize, counting, untracked, tracked);
+		spdlog::info("memory tracker checks {}", passed ? "passed" : "FAILED");
+		return passed;
+	}
+}
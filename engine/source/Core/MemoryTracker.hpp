@@ -0,0 +1,206 @@
+#pragma once
+
+#include "Basic.hpp"
+
+#include <atomic>
+
+// on in debug builds and compiled out otherwise, build with ENGINE_MEMORY_TRACKING=0/1 to override
+#ifndef ENGINE_MEMORY_TRACKING
+#ifdef _DEBUG
+#define ENGINE_MEMORY_TRACKING 1
+#else
+#define ENGINE_MEMORY_TRACKING 0
+#endif
+#endif
+
+// who an allocation belongs to, tracking is opt in so only allocations that go through
+// MemoryTracker::Alloc/New, a TrackedAllocator or MemoryTracker::TrackAlloc show up
+enum class MemoryTag : u32 {
+	Untagged = 0,
+	AssetsMesh,
+	AssetsTexture,
+	AssetsAnimation,
+	AssetsMaterial,
+	Shader,
+	Scene,
+	Renderer,
+	Scratch,
+
+	Num
+};
+
+// also used as the suffix of the --mem_budget_<tag> flags
+const char* MemoryTagToString(MemoryTag tag);
+
+// per tag live/peak byte counters with budgets, with ENGINE_MEMORY_TRACKING=0 the counting compiles
+// to nothing, Alloc/New/TrackedAllocator fall through to malloc/new and snapshots are all zeros
+//
+// usage:
+//	byte* blob = (byte*)MemoryTracker::Alloc(MemoryTag::Shader, size);
+//	MemoryTracker::Free(blob);
+//
+//	DX11Mesh* mesh = MemoryTracker::New<DX11Mesh>(MemoryTag::Renderer, device, createInfo);
+//	MemoryTracker::Delete(mesh);
+//
+//	TrackedVector<float3, MemoryTag::AssetsMesh> positions;
+//
+//	// memory someone else allocated (stb, cgltf, ...), has to be given the same size when freed
+//	MemoryTracker::TrackAlloc(MemoryTag::AssetsTexture, size);
+//	MemoryTracker::TrackFree(MemoryTag::AssetsTexture, size);
+//
+//	const MemoryTracker::Snapshot before = MemoryTracker::TakeSnapshot();
+//	LoadThings();
+//	MemoryTracker::LogDiff("load things", MemoryTracker::Diff(before, MemoryTracker::TakeSnapshot()));
+namespace MemoryTracker
+{
+	struct TagStats {
+		// bytes
+		i64 live = 0;
+		i64 peak = 0;
+		// allocCount - freeCount is how many allocations are still around
+		i64 allocCount = 0;
+		i64 freeCount = 0;
+	};
+
+	struct Snapshot {
+		std::array<TagStats, static_cast<u32>(MemoryTag::Num)> tags = {};
+
+		inline const TagStats& operator[](MemoryTag tag) const { return tags[static_cast<u32>(tag)]; }
+		inline TagStats& operator[](MemoryTag tag) { return tags[static_cast<u32>(tag)]; }
+	};
+
+	// measures the tracking overhead, call once at startup
+	void Init();
+
+	// ns an Alloc/Free pair costs on top of malloc/free, measured in Init
+	f64 GetTrackingOverhead();
+
+	// warns once every time the live bytes of tag go over budget, 0 means no budget
+	void SetBudget(MemoryTag tag, u64 bytes);
+	u64 GetBudget(MemoryTag tag);
+
+	TagStats GetStats(MemoryTag tag);
+	Snapshot TakeSnapshot();
+
+	// after - before for everything except peak, which is the peak at after
+	Snapshot Diff(const Snapshot& before, const Snapshot& after);
+
+	void LogSnapshot(std::string_view title, const Snapshot& snapshot);
+	// only logs tags that changed
+	void LogDiff(std::string_view title, const Snapshot& diff);
+
+	// the counters, peak and Diff checked against sizes known up front, on one thread and from every worker at once,
+	// then what an allocation costs tracked against plain malloc, Alloc and TrackedVector are only checked when tracking
+	bool RunBenchmark();
+
+	namespace detail
+	{
+		void OnAlloc(MemoryTag tag, size_t size);
+		void OnFree(MemoryTag tag, size_t size);
+
+		// in front of every Alloc when tracking, so Free knows what to take off which tag
+		struct alignas(16) Header {
+			u64 size;
+			MemoryTag tag;
+		};
+	}
+
+	inline void TrackAlloc([[maybe_unused]] MemoryTag tag, [[maybe_unused]] size_t size)
+	{
+#if ENGINE_MEMORY_TRACKING
+		detail::OnAlloc(tag, size);
+#endif
+	}
+
+	inline void TrackFree([[maybe_unused]] MemoryTag tag, [[maybe_unused]] size_t size)
+	{
+#if ENGINE_MEMORY_TRACKING
+		detail::OnFree(tag, size);
+#endif
+	}
+
+	// 16 byte aligned, like malloc
+	inline void* Alloc([[maybe_unused]] MemoryTag tag, size_t size)
+	{
+#if ENGINE_MEMORY_TRACKING
+		auto* header = static_cast<detail::Header*>(malloc(sizeof(detail::Header) + size));
+		if (header == nullptr) {
+			return nullptr;
+		}
+		header->size = size;
+		header->tag = tag;
+		detail::OnAlloc(tag, size);
+		return header + 1;
+#else
+		return malloc(size);
+#endif
+	}
+
+	// only for memory from Alloc
+	inline void Free(void* ptr)
+	{
+#if ENGINE_MEMORY_TRACKING
+		if (ptr == nullptr) {
+			return;
+		}
+		auto* header = static_cast<detail::Header*>(ptr) - 1;
+		detail::OnFree(header->tag, header->size);
+		free(header);
+#else
+		free(ptr);
+#endif
+	}
+
+	template<typename T, typename... Args>
+	T* New(MemoryTag tag, Args&&... args)
+	{
+		static_assert(alignof(T) <= alignof(detail::Header), "over aligned types need their own allocation");
+		void* memory = Alloc(tag, sizeof(T));
+		ENSURE(memory != nullptr, "");
+		return new (memory) T(std::forward<Args>(args)...);
+	}
+
+	// ptr has to be the exact type it was created with, a base class pointer gets the wrong size
+	template<typename T>
+	void Delete(T* ptr)
+	{
+		if (ptr == nullptr) {
+			return;
+		}
+		ptr->~T();
+		Free(ptr);
+	}
+}
+
+// std allocator that counts against Tag, for containers that belong to a subsystem
+template<typename T, MemoryTag Tag>
+struct TrackedAllocator {
+	using value_type = T;
+
+	template<typename U>
+	struct rebind {
+		using other = TrackedAllocator<U, Tag>;
+	};
+
+	TrackedAllocator() = default;
+	template<typename U>
+	TrackedAllocator(const TrackedAllocator<U, Tag>&) {}
+
+	inline T* allocate(size_t count)
+	{
+		MemoryTracker::TrackAlloc(Tag, count * sizeof(T));
+		return static_cast<T*>(::operator new(count * sizeof(T)));
+	}
+
+	inline void deallocate(T* ptr, size_t count)
+	{
+		MemoryTracker::TrackFree(Tag, count * sizeof(T));
+		::operator delete(ptr);
+	}
+
+	template<typename U>
+	inline bool operator==(const TrackedAllocator<U, Tag>&) const { return true; }
+};
+
+template<typename T, MemoryTag Tag>
+using TrackedVector = std::vector<T, TrackedAllocator<T, Tag>>;
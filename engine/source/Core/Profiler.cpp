@@ -0,0 +1,185 @@
+#include "Profiler.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <fstream>
+
+namespace
+{
+	// ring buffer written only by its own thread, older events get overwritten once it wraps
+	struct ThreadBuffer {
+		static constexpr u32 Capacity = 1 << 15;
+
+		u32 threadId = 0;
+		u32 depth = 0;
+		char name[32] = {};
+
+		std::atomic<u64> writeIndex = 0;
+		Profiler::Event events[Capacity];
+	};
+
+	std::chrono::steady_clock::time_point s_startTime = std::chrono::steady_clock::now();
+	f64 s_zoneOverhead = 0.0;
+
+	// buffers are never freed, threads keep a raw pointer to theirs
+	std::mutex s_buffersMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> s_buffers;
+
+	thread_local ThreadBuffer* t_buffer = nullptr;
+
+	ThreadBuffer& GetThreadBuffer()
+	{
+		if (t_buffer == nullptr) {
+			std::lock_guard lock(s_buffersMutex);
+			auto& buffer = s_buffers.emplace_back(std::make_unique<ThreadBuffer>());
+			buffer->threadId = static_cast<u32>(s_buffers.size() - 1);
+			snprintf(buffer->name, sizeof(buffer->name), "thread %u", buffer->threadId);
+			t_buffer = buffer.get();
+		}
+		return *t_buffer;
+	}
+
+	void WriteEscaped(fmt::memory_buffer& out, std::string_view str)
+	{
+		for (char c : str) {
+			if (c == '"' || c == '\\') {
+				out.push_back('\\');
+			}
+			out.push_back(c);
+		}
+	}
+}
+
+namespace Profiler
+{
+	namespace detail
+	{
+		std::atomic<bool> enabled = false;
+
+		u64 BeginZone()
+		{
+			GetThreadBuffer().depth++;
+			return Now();
+		}
+
+		void EndZone(const char* name, u64 begin, std::string_view text)
+		{
+			const u64 end = Now();
+
+			ThreadBuffer& buffer = GetThreadBuffer();
+			const u64 index = buffer.writeIndex.load(std::memory_order_relaxed);
+
+			Event& event = buffer.events[index & (ThreadBuffer::Capacity - 1)];
+			event.name = name;
+			event.begin = begin;
+			event.end = end;
+			event.depth = --buffer.depth;
+
+			const size_t textSize = std::min(text.size(), static_cast<size_t>(Event::TextSize - 1));
+			memcpy(event.text, text.data(), textSize);
+			event.text[textSize] = '\0';
+
+			// release so WriteChromeTrace sees the whole event
+			buffer.writeIndex.store(index + 1, std::memory_order_release);
+		}
+	}
+
+	void Init()
+	{
+		s_startTime = std::chrono::steady_clock::now();
+		detail::enabled.store(true);
+
+		// measure what an empty zone costs so we know how much of the trace is us
+		constexpr u32 calibrationZones = 10000;
+		ThreadBuffer& buffer = GetThreadBuffer();
+		const u64 writeIndex = buffer.writeIndex.load(std::memory_order_relaxed);
+
+		const u64 begin = Now();
+		for (u32 i = 0; i < calibrationZones; ++i) {
+			Zone zone("Profiler::Calibration");
+		}
+		s_zoneOverhead = static_cast<f64>(Now() - begin) / calibrationZones;
+
+		// drop the calibration zones, they would just be noise in the trace
+		buffer.writeIndex.store(writeIndex, std::memory_order_relaxed);
+
+		spdlog::info("profiler enabled, {:.1f}ns per zone", s_zoneOverhead);
+	}
+
+	void SetThreadName(std::string_view name)
+	{
+		ThreadBuffer& buffer = GetThreadBuffer();
+		const size_t size = std::min(name.size(), sizeof(buffer.name) - 1);
+		memcpy(buffer.name, name.data(), size);
+		buffer.name[size] = '\0';
+	}
+
+	u64 Now()
+	{
+		return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_startTime).count());
+	}
+
+	f64 GetZoneOverhead()
+	{
+		return s_zoneOverhead;
+	}
+
+	bool WriteChromeTrace(const std::string& realPath)
+	{
+		spdlog::stopwatch sw;
+
+		fmt::memory_buffer out;
+		fmt::format_to(std::back_inserter(out), "{{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+		size_t eventCount = 0;
+		bool first = true;
+
+		std::lock_guard lock(s_buffersMutex);
+		for (const auto& buffer : s_buffers) {
+			if (!first) {
+				out.push_back(',');
+			}
+			first = false;
+
+			fmt::format_to(std::back_inserter(out), "{{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":{},\"args\":{{\"name\":\"",
+				buffer->threadId);
+			WriteEscaped(out, buffer->name);
+			fmt::format_to(std::back_inserter(out), "\"}}}}\n");
+
+			const u64 writeIndex = buffer->writeIndex.load(std::memory_order_acquire);
+			const u64 count = std::min<u64>(writeIndex, ThreadBuffer::Capacity);
+
+			for (u64 i = writeIndex - count; i < writeIndex; ++i) {
+				const Event& event = buffer->events[i & (ThreadBuffer::Capacity - 1)];
+
+				// chrome wants microseconds, keep the ns as decimals
+				fmt::format_to(std::back_inserter(out), ",{{\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f},\"name\":\"",
+					buffer->threadId, event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+				WriteEscaped(out, event.name);
+				out.push_back('"');
+
+				if (event.text[0] != '\0') {
+					fmt::format_to(std::back_inserter(out), ",\"args\":{{\"text\":\"");
+					WriteEscaped(out, event.text);
+					fmt::format_to(std::back_inserter(out), "\"}}");
+				}
+
+				fmt::format_to(std::back_inserter(out), "}}\n");
+			}
+
+			eventCount += count;
+		}
+
+		fmt::format_to(std::back_inserter(out), "]}}\n");
+
+		std::ofstream file(realPath, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			spdlog::error("failed opening {} for writing", realPath);
+			return false;
+		}
+		file.write(out.data(), out.size());
+
+		spdlog::info("wrote chrome trace {} with {} zones in {:.3}s", realPath, eventCount, sw);
+		return file.good();
+	}
+}
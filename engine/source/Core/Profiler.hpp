@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Basic.hpp"
+
+#include <atomic>
+
+// build with ENGINE_PROFILER=0 to compile every zone out
+#ifndef ENGINE_PROFILER
+#define ENGINE_PROFILER 1
+#endif
+
+// scoped cpu zones, recorded into per thread ring buffers and exported as a chrome trace (chrome://tracing or ui.perfetto.dev)
+//
+// usage:
+//	void Thing() {
+//		PROFILE_FUNCTION();
+//		{
+//			PROFILE_ZONE("Thing::Part");
+//			...
+//		}
+//		PROFILE_ZONE_TEXT("Thing::Load", path);
+//	}
+//
+// zone names are stored by pointer, so they have to be string literals (or otherwise live as long as the program),
+// the text is copied and truncated to Event::TextSize
+namespace Profiler
+{
+	struct Event {
+		static constexpr u32 TextSize = 32;
+
+		const char* name;
+		// nanoseconds since Init
+		u64 begin;
+		u64 end;
+		u32 depth;
+		char text[TextSize];
+	};
+
+	void Init();
+
+	// shows up as the track name in the trace, call once per thread before its first zone
+	void SetThreadName(std::string_view name);
+
+	// nanoseconds since Init
+	u64 Now();
+
+	// cost of one empty zone in ns, measured in Init
+	f64 GetZoneOverhead();
+
+	// dumps everything recorded so far, only call when no other thread is recording (at shutdown, between frames)
+	bool WriteChromeTrace(const std::string& realPath);
+
+	namespace detail
+	{
+		extern std::atomic<bool> enabled;
+		// returns the begin timestamp
+		u64 BeginZone();
+		void EndZone(const char* name, u64 begin, std::string_view text);
+	}
+
+	class Zone {
+	public:
+		inline Zone(const char* name, std::string_view text = {})
+			: m_name(nullptr), m_text(text)
+		{
+			if (detail::enabled.load(std::memory_order_relaxed)) {
+				m_name = name;
+				m_begin = detail::BeginZone();
+			}
+		}
+
+		inline ~Zone()
+		{
+			if (m_name != nullptr) {
+				detail::EndZone(m_name, m_begin, m_text);
+			}
+		}
+
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+
+	private:
+		const char* m_name;
+		std::string_view m_text;
+		u64 m_begin = 0;
+	};
+}
+
+#if ENGINE_PROFILER
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) Profiler::Zone PROFILER_CONCAT(_profileZone, __LINE__)(name)
+#define PROFILE_ZONE_TEXT(name, text) Profiler::Zone PROFILER_CONCAT(_profileZone, __LINE__)(name, text)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_ZONE_TEXT(name, text)
+#define PROFILE_FUNCTION()
+#endif
@@ -16,13 +16,16 @@
 
 #include "SceneSystem.hpp"
 #include "AssetSystem.hpp"
+#include "Core/Profiler.hpp"
+#include "Core/MemoryTracker.hpp"
+#include "PerfHud.hpp"
 
 
 DX11Context::DX11Context(GLFWwindow* window)
 	: m_window(window)
 {
 	m_scratchSize = 4096;
-	m_scratchMemory = new byte[m_scratchSize];
+	m_scratchMemory = static_cast<byte*>(MemoryTracker::Alloc(MemoryTag::Scratch, m_scratchSize));
 
 	ASSERT(m_window != nullptr, "");
 
@@ -209,8 +212,8 @@ DX11Context::DX11Context(GLFWwindow* window)
 		DXERROR(res);
 	}
 
-	D3D11_BUFFER_DESC pointLightBufferDesc = {
-		.ByteWidth = sizeof(PointLightBuffer),
+	D3D11_BUFFER_DESC clusterBufferDesc = {
+		.ByteWidth = sizeof(ClusterBuffer),
 		.Usage = D3D11_USAGE::D3D11_USAGE_DYNAMIC,
 		.BindFlags = D3D11_BIND_CONSTANT_BUFFER,
 		.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE,
@@ -218,7 +221,7 @@ DX11Context::DX11Context(GLFWwindow* window)
 		.StructureByteStride = 0,
 	};
 	
-	if (auto res = m_device->CreateBuffer(&pointLightBufferDesc, nullptr, &m_pointLightBuffer); FAILED(res)) {
+	if (auto res = m_device->CreateBuffer(&clusterBufferDesc, nullptr, &m_clusterBuffer); FAILED(res)) {
 		DXERROR(res);
 	}
 
@@ -377,6 +380,95 @@ void DX11Context::CreateGbuffer(uint width, uint height)
 	}
 }
 
+void DX11Context::UploadStructuredBuffer(StructuredBuffer& buffer, const void* data, u32 count, u32 stride)
+{
+	if (count > buffer.capacity || buffer.buffer == nullptr) {
+		// grow by half again so a slowly rising light count doesnt recreate it every frame
+		const u32 capacity = std::max({ count + count / 2, buffer.capacity, 64u });
+
+		D3D11_BUFFER_DESC bufferDesc = {
+			.ByteWidth = capacity * stride,
+			.Usage = D3D11_USAGE::D3D11_USAGE_DYNAMIC,
+			.BindFlags = D3D11_BIND_SHADER_RESOURCE,
+			.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE,
+			.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED,
+			.StructureByteStride = stride,
+		};
+
+		buffer.buffer.Reset();
+		buffer.srv.Reset();
+		buffer.capacity = 0;
+
+		if (auto res = m_device->CreateBuffer(&bufferDesc, nullptr, &buffer.buffer); FAILED(res)) {
+			DXERROR(res);
+			return;
+		}
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {
+			.Format = DXGI_FORMAT::DXGI_FORMAT_UNKNOWN,
+			.ViewDimension = D3D11_SRV_DIMENSION::D3D11_SRV_DIMENSION_BUFFER,
+			.Buffer = {
+				.FirstElement = 0,
+				.NumElements = capacity,
+			},
+		};
+
+		if (auto res = m_device->CreateShaderResourceView(buffer.buffer.Get(), &srvDesc, &buffer.srv); FAILED(res)) {
+			DXERROR(res);
+			return;
+		}
+
+		buffer.capacity = capacity;
+	}
+
+	if (count == 0) {
+		return;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE subresource;
+	m_deviceContext->Map(buffer.buffer.Get(), 0, D3D11_MAP::D3D11_MAP_WRITE_DISCARD, 0, &subresource);
+	memcpy(subresource.pData, data, static_cast<size_t>(count) * stride);
+	m_deviceContext->Unmap(buffer.buffer.Get(), 0);
+	m_counters.bytesUploaded += static_cast<u64>(count) * stride;
+}
+
+void DX11Context::UploadClusterIndices(const u32* indices, u32 count)
+{
+	if (count > m_clusterIndexCapacity || m_clusterIndexBuffer == nullptr) {
+		// the visible triangle count moves with the camera every frame, grow with room to spare
+		const u32 capacity = std::max({ count + count / 2, m_clusterIndexCapacity, 1024u });
+
+		D3D11_BUFFER_DESC bufferDesc = {
+			.ByteWidth = capacity * static_cast<u32>(sizeof(u32)),
+			.Usage = D3D11_USAGE::D3D11_USAGE_DYNAMIC,
+			.BindFlags = D3D11_BIND_INDEX_BUFFER,
+			.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE,
+			.MiscFlags = 0,
+			.StructureByteStride = sizeof(u32),
+		};
+
+		m_clusterIndexBuffer.Reset();
+		m_clusterIndexCapacity = 0;
+
+		if (auto res = m_device->CreateBuffer(&bufferDesc, nullptr, &m_clusterIndexBuffer); FAILED(res)) {
+			DXERROR(res);
+			return;
+		}
+
+		m_clusterIndexCapacity = capacity;
+	}
+
+	if (count == 0) {
+		return;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE subresource;
+	m_deviceContext->Map(m_clusterIndexBuffer.Get(), 0, D3D11_MAP::D3D11_MAP_WRITE_DISCARD, 0, &subresource);
+	memcpy(subresource.pData, indices, static_cast<size_t>(count) * sizeof(u32));
+	m_deviceContext->Unmap(m_clusterIndexBuffer.Get(), 0);
+	m_counters.bytesUploaded += static_cast<u64>(count) * sizeof(u32);
+}
+
 DX11Context::~DX11Context()
 {
 	// @TODO: make a renderer system that uses dx11 context internally?
@@ -392,18 +484,23 @@ DX11Context::~DX11Context()
 	ImGui_ImplDX11_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
+
+	MemoryTracker::Free(m_scratchMemory);
 }
 
-void DX11Context::Render(const RuntimeScene& scene)
+void DX11Context::Render(const RenderSnapshot& snapshot, FrameStats& stats)
 {
+	PROFILE_FUNCTION();
+
+	m_counters = {};
+	m_counters.occlusionCulled = snapshot.occlusion.boxesCulled;
+	m_counters.clusterTrianglesCulled = snapshot.clusters.trianglesTested - snapshot.clusters.trianglesEmitted;
+
 	ImGui_ImplDX11_NewFrame();
 	ImGui_ImplGlfw_NewFrame();
 	ImGui::NewFrame();
 
-	ImGui::ShowDemoWindow();
-	// ImGui::Begin("the name", nullptr, ImGuiWindowFlags_DockNodeHost);
-
-	// ImGui::End();
+	DrawPerfHud(stats);
 
 	// begin render
 
@@ -427,127 +524,148 @@ void DX11Context::Render(const RuntimeScene& scene)
 
 	m_deviceContext->ClearDepthStencilView(m_depthStencilView.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
 
-	float time = static_cast<float>(glfwGetTime());
-	float angle = DirectX::XMScalarSin(time);
-	float moveX = 0.5f * DirectX::XMScalarSin(time * 2.0f);
-	float moveY = 0.5f * DirectX::XMScalarSin(time * 2.0f);
-	auto rotMatrix = DirectX::XMMatrixRotationY(angle + DirectX::XM_PI);
+	{
+		PROFILE_ZONE("UploadLights");
+
+		const ClusteredLighting::Output& lights = snapshot.lights;
+		UploadStructuredBuffer(m_lightsBuffer, lights.lights.data(), static_cast<u32>(lights.lights.size()), sizeof(PointLight));
+		UploadStructuredBuffer(m_clusterGridBuffer, lights.grid.data(), static_cast<u32>(lights.grid.size()), sizeof(u32) * 2);
+		UploadStructuredBuffer(m_lightIndicesBuffer, lights.indices.data(), static_cast<u32>(lights.indices.size()), sizeof(u32));
+
+		D3D11_MAPPED_SUBRESOURCE clusterSubresource;
+		m_deviceContext->Map(m_clusterBuffer.Get(), 0, D3D11_MAP::D3D11_MAP_WRITE_DISCARD, 0, &clusterSubresource);
+		ClusterBuffer* clusterBuffer = reinterpret_cast<ClusterBuffer*>(clusterSubresource.pData);
+		*clusterBuffer = ClusterBuffer{
+			.GridSize = { ClusteredLighting::GridSizeX, ClusteredLighting::GridSizeY, ClusteredLighting::GridSizeZ },
+			.SliceScale = lights.sliceScale,
+			.SliceBias = lights.sliceBias,
+			.TileScale = { ClusteredLighting::GridSizeX / m_viewport.Width, ClusteredLighting::GridSizeY / m_viewport.Height },
+			.LightCount = static_cast<u32>(lights.lights.size()),
+			.WsCameraPos = snapshot.cameraPosition,
+		};
+		m_deviceContext->Unmap(m_clusterBuffer.Get(), 0);
+		m_counters.bytesUploaded += sizeof(ClusterBuffer);
+	}
 
-	auto transMatrix = DirectX::XMMatrixTranslation(moveX, moveY, 0);
+	{
+		PROFILE_ZONE("UploadClusterIndices");
+		UploadClusterIndices(snapshot.clusterIndices.data(), static_cast<u32>(snapshot.clusterIndices.size()));
+	}
 
-	DirectX::XMMATRIX modelToWorld = scene.staticMeshEntity0->xform.matrix;
-	modelToWorld = modelToWorld * rotMatrix;
-	modelToWorld = modelToWorld * transMatrix;
+	{
+		PROFILE_ZONE("UploadMaterials");
+		const std::span<const Material::Constants> materials = global::assetSystem->Catalog()->GetMaterialConstants();
+		if (materials.size() != m_materialsUploaded) {
+			UploadStructuredBuffer(m_materialsBuffer, materials.data(), static_cast<u32>(materials.size()), sizeof(Material::Constants));
+			m_materialsUploaded = static_cast<u32>(materials.size());
+		}
+	}
 
-	mat4 worldToCam = scene.camera->GetView();
-	mat4 CamToProjection = scene.camera->GetProjection();
+	ID3D11RenderTargetView* renderTargets[] = { m_gbufferData.albedoRTV.Get(), m_gbufferData.wsPositionRTV.Get(), m_gbufferData.wsNormalRTV.Get() };
 
-	D3D11_MAPPED_SUBRESOURCE subresource;
-	m_deviceContext->Map(m_matrixBuffer.Get(), 0, D3D11_MAP::D3D11_MAP_WRITE_DISCARD, 0, &subresource);
-	MatrixBuffer* data = reinterpret_cast<MatrixBuffer*>(subresource.pData);
-	data->ModelToWorld = DirectX::XMMatrixTranspose(modelToWorld);
-	data->WorldToView = DirectX::XMMatrixTranspose(worldToCam);
-	data->ViewToProjection = DirectX::XMMatrixTranspose(CamToProjection);
-	m_deviceContext->Unmap(m_matrixBuffer.Get(), 0);
-
-	D3D11_MAPPED_SUBRESOURCE pointSubresource;
-	m_deviceContext->Map(m_pointLightBuffer.Get(), 0, D3D11_MAP::D3D11_MAP_WRITE_DISCARD, 0, &pointSubresource);
-	PointLightBuffer* plBuffer = reinterpret_cast<PointLightBuffer*>(pointSubresource.pData);
-	plBuffer->Pos = DirectX::XMFLOAT3(1.0, 1.0f, -3);
-	plBuffer->Col = DirectX::XMFLOAT3(1.0, 1.0, 1.0);
-	m_deviceContext->Unmap(m_pointLightBuffer.Get(), 0);
-
-	// @TODO: move this to DX11Mesh?
-	D3D11_INPUT_ELEMENT_DESC inputElementDescs[] = {
-		{
-			.SemanticName = "POSITION",
-			.SemanticIndex = 0,
-			.Format = DXGI_FORMAT::DXGI_FORMAT_R32G32B32_FLOAT,
-			.InputSlot = 0,
-			.AlignedByteOffset = 0,
-			.InputSlotClass = D3D11_INPUT_CLASSIFICATION::D3D11_INPUT_PER_VERTEX_DATA,
-			.InstanceDataStepRate = 0,
-		},
-		{
-			.SemanticName = "NORMAL",
-			.SemanticIndex = 0,
-			.Format = DXGI_FORMAT::DXGI_FORMAT_R32G32B32_FLOAT,
-			.InputSlot = 0,
-			.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT,
-			.InputSlotClass = D3D11_INPUT_CLASSIFICATION::D3D11_INPUT_PER_VERTEX_DATA,
-			.InstanceDataStepRate = 0,
-		},
-		{
-			.SemanticName = "COLOR",
-			.SemanticIndex = 0,
-			.Format = DXGI_FORMAT::DXGI_FORMAT_R32G32B32_FLOAT,
-			.InputSlot = 0,
-			.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT,
-			.InputSlotClass = D3D11_INPUT_CLASSIFICATION::D3D11_INPUT_PER_VERTEX_DATA,
-			.InstanceDataStepRate = 0,
-		},
-		{
-			.SemanticName = "TEXCOORD",
-			.SemanticIndex = 0,
-			.Format = DXGI_FORMAT::DXGI_FORMAT_R32G32_FLOAT,
-			.InputSlot = 0,
-			.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT,
-			.InputSlotClass = D3D11_INPUT_CLASSIFICATION::D3D11_INPUT_PER_VERTEX_DATA,
-			.InstanceDataStepRate = 0,
-		}
-	};
+	//@TODO: render ws_position, ws_normal, albedo, ...
+	m_deviceContext->OMSetRenderTargets(ARRLEN(renderTargets), renderTargets, m_depthStencilView.Get());
+	m_deviceContext->RSSetState(m_rasterState.Get());
+	m_deviceContext->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-	const ShaderAsset& vertShaderAssetSimple = global::assetSystem->Catalog()->GetShaderAsset(scene.staticMeshEntity0->vertShaderAsset);
-	DX11VertexShader* vertShaderSimple = (DX11VertexShader*)vertShaderAssetSimple.GetRendererResource();
-	const ShaderAsset& pixShaderAssetSimple = global::assetSystem->Catalog()->GetShaderAsset(scene.staticMeshEntity0->pixShaderAsset);
-	DX11PixelShader* pixShaderSimple = (DX11PixelShader*)pixShaderAssetSimple.GetRendererResource();
+	// the final pass rebinds t1, so once a frame instead of once a draw
+	m_deviceContext->PSSetShaderResources(1, 1, m_materialsBuffer.srv.GetAddressOf());
+	m_counters.stateChanges++;
 
-	ComPtr<ID3D11InputLayout> m_inputLayout;
-	if (auto res = m_device->CreateInputLayout(
-		inputElementDescs,
-		ARRAYSIZE(inputElementDescs),
-		vertShaderAssetSimple.blob,
-		vertShaderAssetSimple.blobSize,
-		&m_inputLayout); FAILED(res))
-	{
-		DXERROR(res);
-	}
+	// the final pass borrows a sampler from whatever was drawn last
+	DX11Texture* texture = nullptr;
 
-	m_deviceContext->IASetInputLayout(m_inputLayout.Get());
+	for (const RenderSnapshot::StaticMesh& staticMesh : snapshot.staticMeshes) {
+		PROFILE_ZONE("GBufferPass::Draw");
 
-	const MeshAsset& meshAsset0 = global::assetSystem->Catalog()->GetMeshAsset(scene.staticMeshEntity0->meshAsset);
-	DX11Mesh* rendererMesh = (DX11Mesh*)meshAsset0.GetRendererResource();
+		const MeshAsset& meshAsset = global::assetSystem->Catalog()->GetMeshAsset(staticMesh.mesh);
+		DX11Mesh* rendererMesh = (DX11Mesh*)meshAsset.GetRendererResource();
 
-	const TextureAsset& texAsset = global::assetSystem->Catalog()->GetTextureAsset(scene.staticMeshEntity0->texAsset);
-	DX11Texture* texture = (DX11Texture*)texAsset.GetRendererResource();
+		const ShaderAsset& vertShaderAssetSimple = global::assetSystem->Catalog()->GetShaderAsset(staticMesh.vertShader);
+		DX11VertexShader* vertShaderSimple = (DX11VertexShader*)vertShaderAssetSimple.GetRendererResource();
+		// the variant for the features the material needs, a table read on the base shader
+		ShaderID pixShader = global::assetSystem->Catalog()->FindShaderVariant(staticMesh.pixShader, staticMesh.pixShaderKey);
+		if (pixShader.value == InvalidAssetIndex) {
+			pixShader = staticMesh.pixShader;
+		}
+		const ShaderAsset& pixShaderAssetSimple = global::assetSystem->Catalog()->GetShaderAsset(pixShader);
+		DX11PixelShader* pixShaderSimple = (DX11PixelShader*)pixShaderAssetSimple.GetRendererResource();
 
-	// draw mesh 1
-	m_deviceContext->IASetVertexBuffers(
-		0,
-		rendererMesh->GetVertexBufferCount(),
-		rendererMesh->GetVertexBuffer().GetAddressOf(),
-		rendererMesh->GetVertexBufferStrides().data(),
-		rendererMesh->GetVertexBufferOffsets().data());
+		// the shader failed to compile at startup, the errors are in the log
+		if (vertShaderSimple == nullptr || pixShaderSimple == nullptr) {
+			continue;
+		}
 
-	m_deviceContext->IASetIndexBuffer(rendererMesh->GetIndexBuffer().Get(), rendererMesh->GetIndexBufferFormat(), 0);
+		D3D11_MAPPED_SUBRESOURCE subresource;
+		m_deviceContext->Map(m_matrixBuffer.Get(), 0, D3D11_MAP::D3D11_MAP_WRITE_DISCARD, 0, &subresource);
+		MatrixBuffer* data = reinterpret_cast<MatrixBuffer*>(subresource.pData);
+		data->ModelToWorld = DirectX::XMMatrixTranspose(staticMesh.modelToWorld);
+		data->WorldToView = DirectX::XMMatrixTranspose(snapshot.worldToView);
+		data->ViewToProjection = DirectX::XMMatrixTranspose(snapshot.viewToProjection);
+		data->MaterialIndex = staticMesh.material.value;
+		data->PositionScale = rendererMesh->GetPositionScale();
+		m_deviceContext->Unmap(m_matrixBuffer.Get(), 0);
+		m_counters.bytesUploaded += sizeof(MatrixBuffer);
+
+		// slot 0 is DX11Mesh::PositionStream, slot 1 DX11Mesh::AttributeStream in the formats of the mesh
+		const auto inputElementDescs = rendererMesh->GetInputElements();
+		ComPtr<ID3D11InputLayout> m_inputLayout;
+		if (auto res = m_device->CreateInputLayout(
+			inputElementDescs.data(),
+			static_cast<UINT>(inputElementDescs.size()),
+			vertShaderAssetSimple.blob,
+			vertShaderAssetSimple.blobSize,
+			&m_inputLayout); FAILED(res))
+		{
+			DXERROR(res);
+		}
 
-	m_deviceContext->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		m_deviceContext->IASetInputLayout(m_inputLayout.Get());
 
-	m_deviceContext->VSSetShader(vertShaderSimple->Get(), nullptr, 0);
-	m_deviceContext->VSSetConstantBuffers(0, 1, m_matrixBuffer.GetAddressOf());
+		const TextureAsset& texAsset = global::assetSystem->Catalog()->GetTextureAsset(staticMesh.texture);
+		texture = (DX11Texture*)texAsset.GetRendererResource();
 
-	m_deviceContext->PSSetShader(pixShaderSimple->Get(), nullptr, 0);
-	m_deviceContext->PSSetShaderResources(0, 1, texture->GetSRV().GetAddressOf());
-	m_deviceContext->PSSetSamplers(0, 1, texture->GetSamplerState().GetAddressOf());
-	m_deviceContext->PSSetConstantBuffers(0, 1, m_pointLightBuffer.GetAddressOf());
-	m_deviceContext->PSSetConstantBuffers(1, 1, m_matrixBuffer.GetAddressOf());
+		// skinned and morphed from the pose in the snapshot straight into the discarded buffer, the position stream
+		// of the mesh only holds the last frame
+		if (staticMesh.IsDeformed() && rendererMesh->HasDynamicPositions()) {
+			const std::span<DX11Mesh::PositionVertex> positions = rendererMesh->MapPositions(m_deviceContext);
+			if (!positions.empty()) {
+				m_meshDeformer.Deform(snapshot, staticMesh, meshAsset, positions);
+				rendererMesh->UnmapPositions(m_deviceContext);
+				m_counters.bytesUploaded += positions.size_bytes();
+			}
+		}
 
-	ID3D11RenderTargetView* renderTargets[] = { m_gbufferData.albedoRTV.Get(), m_gbufferData.wsPositionRTV.Get(), m_gbufferData.wsNormalRTV.Get() };
+		m_deviceContext->IASetVertexBuffers(
+			0,
+			rendererMesh->GetVertexBufferCount(),
+			rendererMesh->GetVertexBuffers().data(),
+			rendererMesh->GetVertexBufferStrides().data(),
+			rendererMesh->GetVertexBufferOffsets().data());
+
+		if (staticMesh.clustered) {
+			m_deviceContext->IASetIndexBuffer(m_clusterIndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+		} else {
+			m_deviceContext->IASetIndexBuffer(rendererMesh->GetIndexBuffer().Get(), rendererMesh->GetIndexBufferFormat(), 0);
+		}
 
-	//@TODO: render ws_position, ws_normal, albedo, ...
-	m_deviceContext->OMSetRenderTargets(ARRLEN(renderTargets), renderTargets, m_depthStencilView.Get());
-	m_deviceContext->RSSetState(m_rasterState.Get());
-	m_deviceContext->DrawIndexed(rendererMesh->GetIndexCount(), 0, 0);
+		m_deviceContext->VSSetShader(vertShaderSimple->Get(), nullptr, 0);
+		m_deviceContext->VSSetConstantBuffers(0, 1, m_matrixBuffer.GetAddressOf());
+
+		m_deviceContext->PSSetShader(pixShaderSimple->Get(), nullptr, 0);
+		m_deviceContext->PSSetShaderResources(0, 1, texture->GetSRV().GetAddressOf());
+		m_deviceContext->PSSetSamplers(0, 1, texture->GetSamplerState().GetAddressOf());
+		m_deviceContext->PSSetConstantBuffers(1, 1, m_matrixBuffer.GetAddressOf());
+
+		const u32 indexCount = staticMesh.clustered ? staticMesh.clusterIndexCount : rendererMesh->GetIndexCount();
+		const u32 indexOffset = staticMesh.clustered ? staticMesh.clusterIndexOffset : 0;
+		m_deviceContext->DrawIndexed(indexCount, indexOffset, 0);
+
+		// input layout, vb, ib, vs, vs cb, ps, srv, sampler, ps cb
+		m_counters.stateChanges += 9;
+		m_counters.drawCalls++;
+		m_counters.triangles += indexCount / 3;
+	}
 
 	// final pass
 
@@ -574,9 +692,9 @@ void DX11Context::Render(const RuntimeScene& scene)
 	//};
 
 
-	const ShaderAsset& vertShaderAssetFinalPass = global::assetSystem->Catalog()->GetShaderAsset(m_finalPassVertexShader);
+	const ShaderAsset& vertShaderAssetFinalPass = global::assetSystem->Catalog()->GetShaderAsset(global::assetSystem->Catalog()->FindShaderAsset(s_finalPassVertexShaderPath));
 	DX11VertexShader* vertShaderFinalPass = (DX11VertexShader*)vertShaderAssetFinalPass.GetRendererResource();
-	const ShaderAsset& pixShaderAssetFinalPass = global::assetSystem->Catalog()->GetShaderAsset(m_finalPassPixelShader);
+	const ShaderAsset& pixShaderAssetFinalPass = global::assetSystem->Catalog()->GetShaderAsset(global::assetSystem->Catalog()->FindShaderAsset(s_finalPassPixelShaderPath));
 	DX11PixelShader* pixShaderFinalPass = (DX11PixelShader*)pixShaderAssetFinalPass.GetRendererResource();
 
 	//ComPtr<ID3D11InputLayout> m_finalPassinputLayout;
@@ -592,9 +710,24 @@ void DX11Context::Render(const RuntimeScene& scene)
 
 	//m_deviceContext->IASetInputLayout(m_finalPassinputLayout.Get());
 
-	const MeshAsset& quadMesh = global::assetSystem->Catalog()->GetMeshAsset(m_quadMesh);
+	const MeshAsset& quadMesh = global::assetSystem->Catalog()->GetMeshAsset(global::assetSystem->Catalog()->FindMeshAsset(s_quadMeshPath));
 	DX11Mesh* rendererQuadMesh = (DX11Mesh*)quadMesh.GetRendererResource();
 
+	// the layout of the last gbuffer draw can have other attribute formats than the quad
+	const auto quadInputElementDescs = rendererQuadMesh->GetInputElements();
+	ComPtr<ID3D11InputLayout> quadInputLayout;
+	if (auto res = m_device->CreateInputLayout(
+		quadInputElementDescs.data(),
+		static_cast<UINT>(quadInputElementDescs.size()),
+		vertShaderAssetFinalPass.blob,
+		vertShaderAssetFinalPass.blobSize,
+		&quadInputLayout); FAILED(res))
+	{
+		DXERROR(res);
+	}
+
+	m_deviceContext->IASetInputLayout(quadInputLayout.Get());
+
 	m_deviceContext->ClearRenderTargetView(m_renderTargetView.Get(), clearColor);
 
 	//m_deviceContext->ClearDepthStencilView(m_depthStencilView.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
@@ -607,7 +740,7 @@ void DX11Context::Render(const RuntimeScene& scene)
 	m_deviceContext->IASetVertexBuffers(
 		0,
 		rendererQuadMesh->GetVertexBufferCount(),
-		rendererQuadMesh->GetVertexBuffer().GetAddressOf(),
+		rendererQuadMesh->GetVertexBuffers().data(),
 		rendererQuadMesh->GetVertexBufferStrides().data(),
 		rendererQuadMesh->GetVertexBufferOffsets().data());
 
@@ -621,9 +754,14 @@ void DX11Context::Render(const RuntimeScene& scene)
 	m_deviceContext->PSSetShaderResources(1, 1, m_gbufferData.wsPositionSRV.GetAddressOf());
 	m_deviceContext->PSSetShaderResources(2, 1, m_gbufferData.wsNormalSRV.GetAddressOf());
 
-	m_deviceContext->PSSetSamplers(0, 1, texture->GetSamplerState().GetAddressOf());
+	ID3D11ShaderResourceView* lightSRVs[] = { m_lightsBuffer.srv.Get(), m_clusterGridBuffer.srv.Get(), m_lightIndicesBuffer.srv.Get() };
+	m_deviceContext->PSSetShaderResources(3, ARRLEN(lightSRVs), lightSRVs);
+
+	if (texture != nullptr) {
+		m_deviceContext->PSSetSamplers(0, 1, texture->GetSamplerState().GetAddressOf());
+	}
 
-	m_deviceContext->PSSetConstantBuffers(0, 1, m_pointLightBuffer.GetAddressOf());
+	m_deviceContext->PSSetConstantBuffers(0, 1, m_clusterBuffer.GetAddressOf());
 	m_deviceContext->PSSetConstantBuffers(1, 1, m_matrixBuffer.GetAddressOf());
 
 	// disable depth clip
@@ -632,6 +770,11 @@ void DX11Context::Render(const RuntimeScene& scene)
 	// @TODO: final quad isnt being drawn!!!!
 	m_deviceContext->DrawIndexed(rendererQuadMesh->GetIndexCount(), 0, 0);
 
+	// render targets, vb, ib, topology, vs, ps, 3 gbuffer srvs, 3 light srvs, sampler, 2 ps cbs
+	m_counters.stateChanges += 15;
+	m_counters.drawCalls++;
+	m_counters.triangles += rendererQuadMesh->GetIndexCount() / 3;
+
 	// // end final pass
 
 #ifdef DX11_DEBUG
@@ -639,6 +782,7 @@ void DX11Context::Render(const RuntimeScene& scene)
 	LogDebugInfo();
 #endif
 
+	PROFILE_ZONE("ImGui");
 	m_annotation->BeginEvent(L"ImGui");
 	ImGui::Render();
 	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
@@ -659,11 +803,16 @@ void DX11Context::Render(const RuntimeScene& scene)
 
 	VerifyGraphicsPipeline();
 
+	stats.SetRenderCounters(m_counters);
+
 	// end render
+	PROFILE_ZONE("Present");
+	spdlog::stopwatch presentTime;
 	// vsync enabled
 	if (auto res = m_swapchain->Present(0, 0); FAILED(res)) {
 		DXERROR(res);
 	}
+	stats.SetPhaseTime(FrameStats::Phase::Present, static_cast<f32>(presentTime.elapsed().count() * 1000.0));
 }
 
 void DX11Context::EnumAdapters(std::vector<ComPtr<IDXGIAdapter>>& outAdapters) {
@@ -905,6 +1054,64 @@ void DX11Context::HandleResize(u32 width, u32 height)
 	//m_device->CreateTexture2D()
 }
 
+DX11Mesh* DX11Context::CreateMesh(const MeshAsset& asset)
+{
+	DX11Mesh::CreateInfo createInfo = {
+		.attributesCount = asset.GetVertexCount(),
+		
+		.positionStream = asset.GetPositionStream().data(),
+		.positionLayout = asset.GetPositionLayout(),
+		.positions = asset.GetPositions().data(),
+		.normals = asset.GetNormals().data(),
+
+		.attributes = asset.GetAttributes().data(),
+		.attributeLayout = asset.GetAttributeLayout(),
+		
+		.indicesCount = asset.GetIndices().size(),
+		.indices = asset.GetIndices().data(),
+
+		// skinned and morphed meshes get their positions and normals rewritten every frame
+		.dynamicPositions = asset.IsSkinned() || asset.HasMorphTargets(),
+	};
+	return MemoryTracker::New<DX11Mesh>(MemoryTag::Renderer, m_device, createInfo);
+}
+
+DX11Texture* DX11Context::CreateTexture(const TextureAsset& asset)
+{
+	DX11Texture::CreateInfo createInfo = {
+		.width = asset.GetWidth(),
+		.height = asset.GetHeight(),
+		.numComponents = asset.GetNumComponents(),
+		.data = asset.GetData(),
+	};
+	return MemoryTracker::New<DX11Texture>(MemoryTag::Renderer, m_device, createInfo);
+}
+
+DX11ShaderBase* DX11Context::CreateShader(const ShaderAsset& asset)
+{
+	switch (asset.GetKind())
+	{
+	case ShaderAsset::Kind::Vertex:
+		return MemoryTracker::New<DX11VertexShader>(MemoryTag::Renderer, m_device, DX11VertexShader::CreateInfo{
+				.blob = asset.blob,
+				.blobSize = asset.blobSize,
+			});
+	case ShaderAsset::Kind::Pixel:
+		return MemoryTracker::New<DX11PixelShader>(MemoryTag::Renderer, m_device, DX11PixelShader::CreateInfo{
+				.blob = asset.blob,
+				.blobSize = asset.blobSize, 
+			});
+	default:
+		ENSURE(false, "");
+		return nullptr;
+	}
+}
+
+bool DX11Context::CompileShaders(std::span<const ShaderID> shaders)
+{
+	return shaderCompiler->CompileShaderAssets(shaders);
+}
+
 void DX11Context::InitImgui() {
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
@@ -11,7 +11,7 @@
 #include <dxgi1_6.h>
 #include <d3dcompiler.h>
 #include <d3dcommon.h>
-#include <directxmath.h>
+#include <DirectXMath.h>
 
 #ifdef DX11_DEBUG
 #include <dxgidebug.h>
@@ -22,6 +22,8 @@
 #include "DX11ContextUtils.hpp"
 
 #include "AssetSystem.hpp"
+#include "FrameLoop.hpp"
+#include "SceneSystem.hpp"
 
 struct GLFWwindow;
 
@@ -30,9 +32,8 @@ class DX11VertexShader;
 class DX11PixelShader;
 class ShaderCompiler;
 
-class RuntimeScene;
 
-class DX11Context {
+class DX11Context : public AssetRenderer, public FrameRenderer {
 	template<typename T>
 	using ComPtr = Microsoft::WRL::ComPtr<T>;
 	
@@ -41,9 +42,17 @@ public:
 	DX11Context(GLFWwindow* window);
 	virtual ~DX11Context();
 
-	void Render(const RuntimeScene& scene);
 	void HandleResize(u32 width, u32 height);
 
+	// FrameRenderer, also draws the perf hud from stats
+	virtual void Render(const RenderSnapshot& snapshot, FrameStats& stats) override;
+
+	// AssetRenderer
+	virtual DX11Mesh* CreateMesh(const MeshAsset& asset) override;
+	virtual DX11Texture* CreateTexture(const TextureAsset& asset) override;
+	virtual DX11ShaderBase* CreateShader(const ShaderAsset& asset) override;
+	virtual bool CompileShaders(std::span<const ShaderID> shaders) override;
+
 	void InitImgui();
 
 	inline ComPtr<ID3D11Device> GetDevice() {
@@ -70,6 +79,11 @@ private:
 
 	void CreateGbuffer(uint width, uint height);
 
+	// recreates the buffer if count elements dont fit, then copies them in
+	void UploadStructuredBuffer(StructuredBuffer& buffer, const void* data, u32 count, u32 stride);
+	// same for the cluster culled index buffer
+	void UploadClusterIndices(const u32* indices, u32 count);
+
 	// @TODO: factor swapchain params?
 	void ResizeSwapchainResources(u32 width, u32 height);
 	void ObtainSwapchainResources();
@@ -128,32 +142,75 @@ private:
 
 	GBufferData m_gbufferData;
 
-	// final pass quad mesh
-	// @TODO: hardcoding asset ids
-	MeshID m_quadMesh { 0 };
-	ShaderID m_finalPassVertexShader { 4 };
-	ShaderID m_finalPassPixelShader { 5 };
+	// final pass quad mesh and shaders, resolved through the catalog by path hash
+	static constexpr u64 s_quadMeshPath = HashPath(EngineQuadMeshPath);
+	static constexpr u64 s_finalPassVertexShaderPath = HashPath("shaders/final_deferred_pass_vs.hlsl");
+	static constexpr u64 s_finalPassPixelShaderPath = HashPath("shaders/final_deferred_pass_ps.hlsl");
 
 	D3D11_VIEWPORT m_viewport = {};
 
 	ComPtr<ID3D11Buffer> m_matrixBuffer;
-	ComPtr<ID3D11Buffer> m_pointLightBuffer;
+	ComPtr<ID3D11Buffer> m_clusterBuffer;
 
+	// mapped per draw, so the material index of the draw rides along with its matrix
 	struct MatrixBuffer {
 		mat4 ModelToWorld;
 		mat4 WorldToView;
 		mat4 ViewToProjection;
+		// into m_materialsBuffer
+		u32 MaterialIndex;
+		// DX11Mesh::GetPositionScale, quantized positions are multiplied back in the vertex shader
+		f32 PositionScale;
+
+		byte _padding[8];
 	};
 
-	struct PointLightBuffer {
-		DirectX::XMFLOAT3 Pos;
-		DirectX::XMFLOAT3 Col;
+	static_assert(sizeof(MatrixBuffer) % 16 == 0, "constant buffers are sized in multiples of 16 bytes");
 
-		byte _padding[8];
+	// same layout as ClusterBuffer in final_deferred_pass_ps.hlsl
+	struct ClusterBuffer {
+		u32 GridSize[3];
+		f32 SliceScale;
+		f32 SliceBias;
+		// pixels to tiles
+		f32 TileScale[2];
+		u32 LightCount;
+		DirectX::XMFLOAT3 WsCameraPos;
+
+		byte _padding[4];
 	};
 
+	static_assert(sizeof(ClusterBuffer) % 16 == 0, "constant buffers are sized in multiples of 16 bytes");
+
+	// dynamic, grows to fit and never shrinks
+	struct StructuredBuffer {
+		ComPtr<ID3D11Buffer> buffer;
+		ComPtr<ID3D11ShaderResourceView> srv;
+		u32 capacity = 0;
+	};
+
+	// the light list and the cluster grid from the snapshot, read by the final pass
+	StructuredBuffer m_lightsBuffer;
+	StructuredBuffer m_clusterGridBuffer;
+	StructuredBuffer m_lightIndicesBuffer;
+
+	// Material::Constants of every material in the catalog, indexed by MaterialID in simple_deferred_ps
+	// only uploaded again when the catalog has more materials than last time
+	StructuredBuffer m_materialsBuffer;
+	u32 m_materialsUploaded = 0;
+
+	// the visible meshlet triangles of the snapshot, dynamic like the structured buffers
+	ComPtr<ID3D11Buffer> m_clusterIndexBuffer;
+	u32 m_clusterIndexCapacity = 0;
+
 	GLFWwindow* m_window = nullptr;
 
+	// reset at the start of every Render
+	FrameStats::RenderCounters m_counters;
+
+	// skins and morphs into the mapped position streams of the deformed meshes
+	MeshDeformer m_meshDeformer;
+
 	// @TODO: use proper allocators
 	byte* m_scratchMemory = nullptr;
 	u32 m_scratchSize = 0;
@@ -1,42 +1,75 @@
 #include "DX11Mesh.hpp"
 
-void DX11Mesh::Create(ComPtr<ID3D11Device> device, const CreateInfo& info)
+static DXGI_FORMAT GetDxgiFormat(MeshCompression::VertexFormat format)
 {
-	std::vector<VertexType> vertices;
-	vertices.reserve(info.attributesCount);
-
-	for (int i = 0; i < info.attributesCount; ++i) {
-		vertices.push_back(
-			VertexType{
-				.position = info.positions[i],
-				.normal = info.normals ? info.normals[i] : float3{},
-				.color = info.colors ? info.colors[i] : float3{},
-				.uv0 = info.uv0s[i],
-			}
-		);
+	using MeshCompression::VertexFormat;
+
+	switch (format) {
+	case VertexFormat::Float2: return DXGI_FORMAT_R32G32_FLOAT;
+	case VertexFormat::Float3: return DXGI_FORMAT_R32G32B32_FLOAT;
+	case VertexFormat::Float4: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+	case VertexFormat::Unorm8x2: return DXGI_FORMAT_R8G8_UNORM;
+	case VertexFormat::Unorm8x4: return DXGI_FORMAT_R8G8B8A8_UNORM;
+	case VertexFormat::Unorm16x2: return DXGI_FORMAT_R16G16_UNORM;
+	case VertexFormat::Unorm16x4: return DXGI_FORMAT_R16G16B16A16_UNORM;
+	case VertexFormat::Snorm8x2: return DXGI_FORMAT_R8G8_SNORM;
+	case VertexFormat::Snorm8x4: return DXGI_FORMAT_R8G8B8A8_SNORM;
+	case VertexFormat::Snorm16x2: return DXGI_FORMAT_R16G16_SNORM;
+	case VertexFormat::Snorm16x4: return DXGI_FORMAT_R16G16B16A16_SNORM;
 	}
+	UNREACHABLE("");
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+void DX11Mesh::Create(ComPtr<ID3D11Device> device, const CreateInfo& info)
+{
+	ENSURE(info.attributes != nullptr, "DX11Mesh needs the packed attribute stream");
+
+	// MapPositions hands out the float layout
+	ASSERT(sizeof(PositionVertex) == MeshCompression::PositionLayout{}.Stride(), "");
 
-	m_vertexCount = vertices.size();
+	m_vertexCount = static_cast<uint>(info.attributesCount);
 	m_indexCount = info.indicesCount;
+	m_dynamicPositions = info.dynamicPositions;
+	m_positionLayout = info.dynamicPositions ? MeshCompression::PositionLayout{} : info.positionLayout;
+	m_attributeLayout = info.attributeLayout;
 
-	D3D11_BUFFER_DESC vertBufferDesc = {
-		.ByteWidth = static_cast<UINT>(sizeof(VertexType) * vertices.size()),
-		.Usage = D3D11_USAGE_DEFAULT,
-		.BindFlags = D3D11_BIND_VERTEX_BUFFER,
-		.CPUAccessFlags = 0,
-		.MiscFlags = 0,
-		.StructureByteStride = sizeof(VertexType),
-	};
+	// static positions and the attributes go in as they are, dynamic positions get interleaved here
+	TrackedVector<u8, MemoryTag::Scratch> positions;
+	if (info.dynamicPositions) {
+		positions.resize(static_cast<size_t>(m_vertexCount) * m_positionLayout.Stride());
+		MeshCompression::PackPositions(m_positionLayout, std::span(info.positions, m_vertexCount),
+			std::span(info.normals, info.normals ? m_vertexCount : 0), m_vertexCount, positions);
+	} else {
+		ENSURE(info.positionStream != nullptr, "DX11Mesh needs the packed position stream of a static mesh");
+	}
 
-	D3D11_SUBRESOURCE_DATA vertexBufferInitData = {
-		.pSysMem = vertices.data(),
-		// these have no meaning for vertex buffers
-		.SysMemPitch = 0,
-		.SysMemSlicePitch = 0,
-	};
+	const void* streamData[StreamCount] = { info.dynamicPositions ? positions.data() : info.positionStream, info.attributes };
+	const u32 streamStrides[StreamCount] = { m_positionLayout.Stride(), m_attributeLayout.Stride() };
 
-	if (auto res = device->CreateBuffer(&vertBufferDesc, &vertexBufferInitData, &m_vertexBuffer); FAILED(res)) {
-		DXERROR(res);
+	for (u32 stream = 0; stream < StreamCount; ++stream) {
+		const bool dynamic = stream == PositionStream && info.dynamicPositions;
+
+		D3D11_BUFFER_DESC vertBufferDesc = {
+			.ByteWidth = static_cast<UINT>(streamStrides[stream] * m_vertexCount),
+			.Usage = dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT,
+			.BindFlags = D3D11_BIND_VERTEX_BUFFER,
+			.CPUAccessFlags = dynamic ? D3D11_CPU_ACCESS_WRITE : 0u,
+			.MiscFlags = 0,
+			.StructureByteStride = streamStrides[stream],
+		};
+
+		// a dynamic buffer starts out with the bind pose too, so it draws something before the first map
+		D3D11_SUBRESOURCE_DATA vertexBufferInitData = {
+			.pSysMem = streamData[stream],
+			// these have no meaning for vertex buffers
+			.SysMemPitch = 0,
+			.SysMemSlicePitch = 0,
+		};
+
+		if (auto res = device->CreateBuffer(&vertBufferDesc, &vertexBufferInitData, &m_vertexBuffers[stream]); FAILED(res)) {
+			DXERROR(res);
+		}
 	}
 
 	D3D11_BUFFER_DESC indexBufferDesc = {
@@ -58,4 +91,47 @@ void DX11Mesh::Create(ComPtr<ID3D11Device> device, const CreateInfo& info)
 	if (auto res = device->CreateBuffer(&indexBufferDesc, &indexBufferInitData, &m_indexBuffer); FAILED(res)) {
 		DXERROR(res);
 	}
-}
\ No newline at end of file
+}
+
+std::span<DX11Mesh::PositionVertex> DX11Mesh::MapPositions(ComPtr<ID3D11DeviceContext> context)
+{
+	ENSURE(m_dynamicPositions, "MapPositions needs a mesh created with dynamicPositions");
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (auto res = context->Map(m_vertexBuffers[PositionStream].Get(), 0, D3D11_MAP::D3D11_MAP_WRITE_DISCARD, 0, &mapped); FAILED(res)) {
+		DXERROR(res);
+		return {};
+	}
+
+	return std::span<PositionVertex>(static_cast<PositionVertex*>(mapped.pData), m_vertexCount);
+}
+
+void DX11Mesh::UnmapPositions(ComPtr<ID3D11DeviceContext> context)
+{
+	context->Unmap(m_vertexBuffers[PositionStream].Get(), 0);
+}
+
+std::array<D3D11_INPUT_ELEMENT_DESC, DX11Mesh::InputElementCount> DX11Mesh::GetInputElements() const
+{
+	auto element = [](const char* semantic, DXGI_FORMAT format, u32 slot, u32 offset) {
+		return D3D11_INPUT_ELEMENT_DESC{
+			.SemanticName = semantic,
+			.SemanticIndex = 0,
+			.Format = format,
+			.InputSlot = slot,
+			.AlignedByteOffset = offset,
+			.InputSlotClass = D3D11_INPUT_CLASSIFICATION::D3D11_INPUT_PER_VERTEX_DATA,
+			.InstanceDataStepRate = 0,
+		};
+	};
+
+	// normalized integers come into the shader as floats, the shaders dont change with the formats, positions
+	// only need GetPositionScale
+	return {
+		element("POSITION", GetDxgiFormat(m_positionLayout.position), PositionStream, m_positionLayout.PositionOffset()),
+		element("NORMAL", GetDxgiFormat(m_positionLayout.normal), PositionStream, m_positionLayout.NormalOffset()),
+		element("TANGENT", GetDxgiFormat(m_attributeLayout.tangent), AttributeStream, m_attributeLayout.TangentOffset()),
+		element("COLOR", GetDxgiFormat(m_attributeLayout.color), AttributeStream, m_attributeLayout.ColorOffset()),
+		element("TEXCOORD", GetDxgiFormat(m_attributeLayout.uv0), AttributeStream, m_attributeLayout.Uv0Offset()),
+	};
+}
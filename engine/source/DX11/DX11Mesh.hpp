@@ -3,40 +3,53 @@
 #include "Basic.hpp"
 #include "Math.hpp"
 #include "AssetSystem.hpp"
+#include "MeshCompression.hpp"
+#include "Skinning.hpp"
 
 #include "DX11ContextUtils.hpp"
 
 #include <d3d11.h>
 #include <wrl.h>
 
+#include <array>
+#include <span>
+
 class DX11Mesh {
 	template<typename T>
 	using ComPtr = Microsoft::WRL::ComPtr<T>;
 
 public:
-	struct Vertex {
-		float3 position;
-		float3 normal;
-		float3 color;
-		float2 uv0;
-	};
+	// two streams so the cpu can rewrite positions and normals every frame (see Skinning) without
+	// touching the attributes that never change
+	static constexpr u32 PositionStream = 0;
+	static constexpr u32 AttributeStream = 1;
+	static constexpr u32 StreamCount = 2;
 
-	using VertexType = Vertex;
+	using PositionVertex = Skinning::SkinnedVertex;
+
+	// position, normal, tangent, color, uv0
+	static constexpr u32 InputElementCount = 5;
 
 	struct CreateInfo {
 		// number of elements in each of the attibute arrays
 		size_t attributesCount = 0;
 
-		// attribute arrays
-		float3* positions = nullptr;
-		float3* normals = nullptr;
-		float3* tangents = nullptr;
-		float3* colors = nullptr;
-		float2* uv0s = nullptr;
-		float2* uv1s = nullptr;
+		// static meshes, positions and normals already interleaved, see MeshCompression::PackPositions
+		const u8* positionStream = nullptr;
+		MeshCompression::PositionLayout positionLayout;
+		// dynamic ones, the bind pose as floats, dynamic positions are always floats since the cpu writes them every frame
+		const float3* positions = nullptr;
+		const float3* normals = nullptr;
+
+		// tangent, color and uv0 already interleaved, see MeshCompression::PackAttributes
+		const u8* attributes = nullptr;
+		MeshCompression::AttributeLayout attributeLayout;
 
 		size_t indicesCount = 0;
-		u32* indices = nullptr;
+		const u32* indices = nullptr;
+
+		// the position stream is a dynamic buffer for MapPositions instead of an immutable one
+		bool dynamicPositions = false;
 	};
 
 	DX11Mesh(ComPtr<ID3D11Device> device, const CreateInfo& info) 
@@ -46,25 +59,40 @@ public:
 
 	void Create(ComPtr<ID3D11Device> device, const CreateInfo& info);
 
-	inline ComPtr<ID3D11Buffer> GetVertexBuffer() {
-		return m_vertexBuffer;
+	// for IASetVertexBuffers, the input layout reads position and normal from slot 0 and the rest from slot 1
+	inline std::array<ID3D11Buffer*, StreamCount> GetVertexBuffers() {
+		return std::array<ID3D11Buffer*, StreamCount> { m_vertexBuffers[PositionStream].Get(), m_vertexBuffers[AttributeStream].Get() };
 	}
 
-	// @TODO: hardcoded
 	inline u32 GetVertexBufferCount() {
-		return 1;
+		return StreamCount;
 	}
 
-	// @TODO: hardcoded
-	inline std::array<u32, 1> GetVertexBufferOffsets() {
-		return std::array<u32, 1> { 0 };
+	inline std::array<u32, StreamCount> GetVertexBufferOffsets() {
+		return std::array<u32, StreamCount> { 0, 0 };
 	}
 
-	// @TODO: hardcoded
-	inline std::array<u32, 1> GetVertexBufferStrides() {
-		return std::array<u32, 1> { sizeof(VertexType) };
+	inline std::array<u32, StreamCount> GetVertexBufferStrides() {
+		return std::array<u32, StreamCount> { m_positionLayout.Stride(), m_attributeLayout.Stride() };
+	}
+
+	// for the vertex shader, positions in the stream times this are model space
+	inline f32 GetPositionScale() const {
+		return m_positionLayout.positionScale;
 	}
 
+	// for CreateInputLayout, the formats of both streams differ from mesh to mesh
+	std::array<D3D11_INPUT_ELEMENT_DESC, InputElementCount> GetInputElements() const;
+
+	inline bool HasDynamicPositions() {
+		return m_dynamicPositions;
+	}
+
+	// write discard, every vertex has to be written before UnmapPositions and the memory is write combined
+	// so never read it back
+	std::span<PositionVertex> MapPositions(ComPtr<ID3D11DeviceContext> context);
+	void UnmapPositions(ComPtr<ID3D11DeviceContext> context);
+
 	inline ComPtr<ID3D11Buffer> GetIndexBuffer() {
 		return m_indexBuffer;
 	}
@@ -84,11 +112,13 @@ public:
 
 private:
 
-	// @TODO: SOA vertex stream?
-	ComPtr<ID3D11Buffer> m_vertexBuffer;
+	std::array<ComPtr<ID3D11Buffer>, StreamCount> m_vertexBuffers;
 	ComPtr<ID3D11Buffer> m_indexBuffer;
 
 	uint m_vertexCount = 0;
 	uint m_indexCount = 0;
+	bool m_dynamicPositions = false;
+	MeshCompression::PositionLayout m_positionLayout;
+	MeshCompression::AttributeLayout m_attributeLayout;
 };
 
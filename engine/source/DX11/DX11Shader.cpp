@@ -1,56 +1,87 @@
 #include "DX11Shader.hpp"
 
 #include "AssetSystem.hpp"
+#include "ShaderBatch.hpp"
+#include "Core/Profiler.hpp"
+#include "Core/MemoryTracker.hpp"
+#include "Core/Log.hpp"
 
 #include <d3dcompiler.h>
 #include <d3dcommon.h>
 
 bool ShaderCompiler::CompileShaderAsset(ShaderID asset)
 {
-	ShaderAsset& shaderAsset = const_cast<ShaderAsset&>(global::assetSystem->Catalog()->GetShaderAsset(asset));
+	return CompileShaderAssets({ &asset, 1 });
+}
 
-	// @TODO: meh, copy
-	const std::vector<ShaderMacro>& defines = shaderAsset.GetDefines();
-	std::vector<D3D_SHADER_MACRO> shaderMacros;
-	
-	for(const auto& define: defines) {
-		shaderMacros.push_back(D3D_SHADER_MACRO{define.name, define.definition});
+bool ShaderCompiler::CompileShaderAssets(std::span<const ShaderID> assets)
+{
+	PROFILE_FUNCTION();
+
+	const AssetCatalog* catalog = global::assetSystem->Catalog();
+
+	std::vector<ShaderBatch::Input> inputs;
+	inputs.reserve(assets.size());
+	for (ShaderID id : assets) {
+		const ShaderAsset& shaderAsset = catalog->GetShaderAsset(id);
+		inputs.push_back(ShaderBatch::Input{
+			.filePath = shaderAsset.GetFilePath(),
+			.entryFunc = shaderAsset.GetEntryFunc(),
+			.target = shaderAsset.GetTarget(),
+			.defines = shaderAsset.GetDefines(),
+			.variant = shaderAsset.GetFeatures().Describe(shaderAsset.GetKey()),
+		});
 	}
 
-	std::wstring_view filePath = shaderAsset.GetFilePath();
-	std::string_view entryFunc = shaderAsset.GetEntryFunc();
-	std::string_view target = shaderAsset.GetTarget();
-
-	//spdlog::info("compiling shader {}", filePath.data());
+	std::vector<ShaderBatch::Output> outputs(inputs.size());
+	const ShaderBatch::Report report = ShaderBatch::Compile(inputs, outputs, [this](const ShaderBatch::Input& input, ShaderBatch::Output& outOutput) {
+		CompiledResult res = CompileShader(input.filePath, input.entryFunc, input.target, input.defines);
+
+		if (res.error != nullptr) {
+			outOutput.messages = (const char*)res.error->GetBufferPointer();
+			return;
+		}
+
+		if (res.blob == nullptr) {
+			outOutput.messages = res.failure.empty() ? "no output from the compiler" : std::move(res.failure);
+			return;
+		}
+
+		outOutput.blobSize = res.blob->GetBufferSize();
+		// @TODO: use temp allocator here
+		byte* blob = (byte*) MemoryTracker::Alloc(MemoryTag::Shader, outOutput.blobSize);
+		memcpy_s(blob, outOutput.blobSize, res.blob->GetBufferPointer(), outOutput.blobSize);
+		outOutput.blob = blob;
+	});
+
+	// back on this thread, in the order of the ids
+	for (u32 i = 0; i < assets.size(); ++i) {
+		ShaderAsset& shaderAsset = const_cast<ShaderAsset&>(catalog->GetShaderAsset(assets[i]));
+		if (!outputs[i].Succeeded()) {
+			continue;
+		}
+
+		MemoryTracker::Free((void*)shaderAsset.blob);
+		shaderAsset.blob = outputs[i].blob;
+		shaderAsset.blobSize = outputs[i].blobSize;
+	}
 
-	CompiledResult res = CompileShader(
-			filePath,
-			entryFunc,
-			target,
-			shaderMacros
-		);
+	ShaderBatch::LogReport(inputs, outputs, report);
 
-	if (res.error != nullptr) {
-		const char* errStr = (const char*)res.error->GetBufferPointer();
-		spdlog::error("shader compile error: {}", errStr);
+	if (report.failedCount > 0) {
 		DEBUGBREAK();
 		return false;
 	}
-
-	shaderAsset.blobSize = res.blob->GetBufferSize();
-
-	// @TODO: use temp allocator here
-	shaderAsset.blob = (const byte*) malloc(shaderAsset.blobSize);
-	memcpy_s((void*)shaderAsset.blob, shaderAsset.blobSize, res.blob->GetBufferPointer(), shaderAsset.blobSize);
-
 	return true;
 }
 
 ShaderCompiler::CompiledResult ShaderCompiler::CompileShader(
-	std::wstring_view filePath, 
+	std::string_view filePath, 
 	std::string_view entryFunc, 
 	std::string_view target, 
-	const std::vector<D3D_SHADER_MACRO>& defines) {
+	std::span<const ShaderMacro> defines) {
+
+	PROFILE_ZONE_TEXT("ShaderCompiler::CompileShader", filePath);
 
 	ASSERT(filePath.data(), "");
 	ASSERT(entryFunc.data(), "");
@@ -64,13 +95,25 @@ ShaderCompiler::CompiledResult ShaderCompiler::CompileShader(
 	// @WTF
 	// An optional array of D3D_SHADER_MACRO structures that define shader macros. Each macro definition contains a name and a null-terminated definition. 
 	// If not used, set to NULL. The last structure in the array serves as a terminator and must have all members set to NULL
+	std::vector<D3D_SHADER_MACRO> terminatedDefines;
+	if (!defines.empty()) {
+		terminatedDefines.reserve(defines.size() + 1);
+		for (const ShaderMacro& define : defines) {
+			terminatedDefines.push_back(D3D_SHADER_MACRO{ define.name, define.definition });
+		}
+		terminatedDefines.push_back(D3D_SHADER_MACRO{ nullptr, nullptr });
+	}
+	const D3D_SHADER_MACRO* exDefines = terminatedDefines.empty() ? nullptr : terminatedDefines.data();
 
-	// @TODO: extract defines as needed
-	D3D_SHADER_MACRO* exDefines = nullptr;
+	FileView source = global::assetSystem->OpenFile(filePath);
+	if (!source) {
+		compiled.failure = fmt::format("failed opening shader {}", filePath);
+		return compiled;
+	}
 
-	std::wstring realPath = global::assetSystem->GetRealPath(filePath);
-	if (auto res = D3DCompileFromFile(realPath.data(), exDefines, m_includer, entryFunc.data(), target.data(), flags1, flags2, &compiled.blob, &compiled.error); FAILED(res)) {
-		DXERROR(res);
+	// file path is only used as the source name in error messages, strings from the catalog are null terminated
+	if (auto res = D3DCompile(source.Data(), source.Size(), filePath.data(), exDefines, m_includer, entryFunc.data(), target.data(), flags1, flags2, &compiled.blob, &compiled.error); FAILED(res)) {
+		compiled.failure = fmt::format("D3DCompile failed ({:x})", static_cast<u32>(res));
 	}
 
 	return compiled;
@@ -86,9 +129,10 @@ HRESULT ShaderIncluder::Open(D3D_INCLUDE_TYPE IncludeType, LPCSTR pFileName, LPC
 		"D3D_INCLUDE_FORCE_DWORD",
 	};
 
-	spdlog::error("shader includes not yet supported, implement ShaderIncluder fully");
-
-	return S_OK;
+	// runs on the workers like the rest of the compile, failing here puts the include in the error messages
+	// of the shader instead of logging it
+	// @TODO: shader includes not yet supported, implement ShaderIncluder fully
+	return E_NOTIMPL;
 }
 
 HRESULT ShaderIncluder::Close(LPCVOID pData) {
@@ -8,6 +8,8 @@
 #include "DX11ContextUtils.hpp"
 #include "AssetSystem.hpp"
 
+#include <span>
+
 class DX11ShaderBase {
 public:
 
@@ -36,6 +38,9 @@ public:
 	}
 
     bool CompileShaderAsset(ShaderID asset);
+	// every shader at once across the job system, the blobs are written back to the assets in the order of ids
+	// and failures are logged together after the batch, false if any failed
+	bool CompileShaderAssets(std::span<const ShaderID> assets);
 
 private:
 	ID3DInclude* m_includer;
@@ -43,12 +48,15 @@ private:
 	struct CompiledResult {
 		ComPtr<ID3DBlob> blob;
 		ComPtr<ID3DBlob> error;
+		// why there is no blob when it isnt the compiler that failed, like a missing file
+		std::string failure;
 	};
+	// thread safe, runs on the workers during CompileShaderAssets so it logs nothing, every failure ends up in the result
 	CompiledResult CompileShader(
-		std::wstring_view filePath, 
+		std::string_view filePath, 
 		std::string_view entryFunc, 
 		std::string_view target, 
-		const std::vector<D3D_SHADER_MACRO>& defines);
+		std::span<const ShaderMacro> defines);
 };
 
 // @TODO: implement the shader includer
@@ -21,7 +21,7 @@ public:
 
 		// @TODO: more stuff here
 
-		byte* data;
+		const byte* data;
 	};
 
 	DX11Texture(ComPtr<ID3D11Device> device, const CreateInfo& asset);
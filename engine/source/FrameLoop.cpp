@@ -0,0 +1,214 @@
+#include "FrameLoop.hpp"
+
+#include "AssetSystem.hpp"
+#include "SceneSystem.hpp"
+#include "Core/JobSystem.hpp"
+#include "Core/Profiler.hpp"
+
+static f32 ElapsedMs(const spdlog::stopwatch& sw)
+{
+	return static_cast<f32>(sw.elapsed().count() * 1000.0);
+}
+
+// stands in for render or update work in the frame benchmark
+static void BurnCpu(f64 ms)
+{
+	spdlog::stopwatch sw;
+	while (sw.elapsed().count() * 1000.0 < ms) {
+	}
+}
+
+FrameLoop::FrameLoop(FrameWindow* window, FrameRenderer* renderer)
+	: m_window(window)
+	, m_renderer(renderer)
+{
+}
+
+u64 FrameLoop::Run(RuntimeScene& scene, const Settings& settings)
+{
+	auto& snapshots = global::sceneSystem->renderSnapshots;
+
+	u64 frameIndex = 0;
+	scene.Update(GetTime(frameIndex, settings));
+	scene.WriteSnapshot(frameIndex, snapshots[0]);
+
+	while (!ShouldExit(frameIndex, settings))
+	{
+		PROFILE_ZONE("Frame");
+		spdlog::stopwatch frameTime;
+
+		if (m_window != nullptr) {
+			PROFILE_ZONE("PollEvents");
+			spdlog::stopwatch phaseTime;
+			m_window->PollEvents();
+			m_frameStats.SetPhaseTime(FrameStats::Phase::PollEvents, ElapsedMs(phaseTime));
+		}
+
+		const RenderSnapshot& currentSnapshot = snapshots[frameIndex % 2];
+		RenderSnapshot& nextSnapshot = snapshots[(frameIndex + 1) % 2];
+
+		const u64 nextFrameIndex = frameIndex + 1;
+		const f64 nextTime = GetTime(nextFrameIndex, settings);
+
+		// written by the update job, only read after waiting on it
+		f32 sceneUpdateTime = 0.0f;
+
+		JobCounter updateCounter;
+		auto update = [&scene, &nextSnapshot, &sceneUpdateTime, &settings, nextTime, nextFrameIndex]() {
+			PROFILE_ZONE("SceneUpdate");
+			spdlog::stopwatch phaseTime;
+			scene.Update(nextTime);
+			scene.WriteSnapshot(nextFrameIndex, nextSnapshot);
+			BurnCpu(settings.updateMs);
+			sceneUpdateTime = ElapsedMs(phaseTime);
+		};
+
+		if (settings.pipelined) {
+			global::jobSystem->Run(update, &updateCounter);
+		} else {
+			update();
+		}
+
+		{
+			spdlog::stopwatch phaseTime;
+			if (m_renderer != nullptr) {
+				m_renderer->Render(currentSnapshot, m_frameStats);
+			}
+			BurnCpu(settings.renderMs);
+			m_frameStats.SetPhaseTime(FrameStats::Phase::Render, ElapsedMs(phaseTime));
+		}
+
+		{
+			PROFILE_ZONE("WaitSceneUpdate");
+			spdlog::stopwatch phaseTime;
+			global::jobSystem->Wait(updateCounter);
+			m_frameStats.SetPhaseTime(FrameStats::Phase::WaitSceneUpdate, ElapsedMs(phaseTime));
+		}
+		m_frameStats.SetPhaseTime(FrameStats::Phase::SceneUpdate, sceneUpdateTime);
+
+		m_frameStats.EndFrame(ElapsedMs(frameTime));
+		frameIndex = nextFrameIndex;
+	}
+
+	return frameIndex;
+}
+
+void FrameLoop::LogSummary(u64 frameIndex) const
+{
+	const RenderSnapshot& snapshot = global::sceneSystem->renderSnapshots[frameIndex % 2];
+	const FrameStats::Summary frame = m_frameStats.ComputeSummary();
+	const FrameStats::Summary update = m_frameStats.ComputePhaseSummary(FrameStats::Phase::SceneUpdate);
+	spdlog::info("{} frames, over the last {}: frame avg {:.3f}ms p95 {:.3f}ms, scene update avg {:.3f}ms p95 {:.3f}ms, {} of {} boxes occluded, {} of {} cluster triangles culled",
+		frameIndex, frame.frameCount, frame.average, frame.p95, update.average, update.p95, snapshot.occlusion.boxesCulled, snapshot.occlusion.boxesTested,
+		snapshot.clusters.trianglesTested - snapshot.clusters.trianglesEmitted, snapshot.clusters.trianglesTested);
+}
+
+f64 FrameLoop::GetTime(u64 frameIndex, const Settings& settings) const
+{
+	return m_window != nullptr ? m_window->GetTime() : static_cast<f64>(frameIndex) * settings.frameTime;
+}
+
+bool FrameLoop::ShouldExit(u64 frameIndex, const Settings& settings) const
+{
+	if (settings.frameLimit > 0 && frameIndex >= settings.frameLimit) {
+		return true;
+	}
+	if (settings.timeLimit > 0.0 && GetTime(frameIndex, settings) >= settings.timeLimit) {
+		return true;
+	}
+	return m_window != nullptr && m_window->ShouldClose();
+}
+
+// the scene only depends on the time, two runs that end on the same frame have to end on the same snapshot
+static bool SameSnapshot(const RenderSnapshot& a, const RenderSnapshot& b)
+{
+	bool same = a.frameIndex == b.frameIndex && a.staticMeshes.size() == b.staticMeshes.size();
+	same &= memcmp(&a.worldToView, &b.worldToView, sizeof(mat4)) == 0;
+	for (size_t i = 0; same && i < a.staticMeshes.size(); ++i) {
+		same &= memcmp(&a.staticMeshes[i].modelToWorld, &b.staticMeshes[i].modelToWorld, sizeof(mat4)) == 0;
+		same &= a.staticMeshes[i].mesh.value == b.staticMeshes[i].mesh.value;
+	}
+	same &= a.clusterIndices.size() == b.clusterIndices.size()
+		&& std::equal(a.clusterIndices.begin(), a.clusterIndices.end(), b.clusterIndices.begin());
+	same &= a.palettes.size() == b.palettes.size() && memcmp(a.palettes.data(), b.palettes.data(), a.palettes.size() * sizeof(float4x4)) == 0;
+	same &= a.morphWeights.size() == b.morphWeights.size() && std::equal(a.morphWeights.begin(), a.morphWeights.end(), b.morphWeights.begin());
+	same &= a.occlusion.boxesCulled == b.occlusion.boxesCulled;
+	return same;
+}
+
+bool FrameLoop::RunBenchmark()
+{
+	if (global::sceneSystem->runtimeScene == nullptr) {
+		global::sceneSystem->runtimeScene = std::allocate_shared<RuntimeScene>(TrackedAllocator<RuntimeScene, MemoryTag::Scene>());
+	}
+	RuntimeScene& scene = *global::sceneSystem->runtimeScene.get();
+
+	// 4 seconds of scene time, the render and update stage each take about as long as the other
+	Settings settings;
+	settings.frameLimit = 240;
+	settings.renderMs = 2.0;
+	settings.updateMs = 2.0;
+
+	spdlog::info("frame benchmark, {} frames on {} threads, {:.2f}ms render and {:.2f}ms update per frame on top of the scene",
+		settings.frameLimit, global::jobSystem->GetThreadCount(), settings.renderMs, settings.updateMs);
+
+	RenderSnapshot lockstepSnapshot;
+	FrameStats::Summary summaries[2];
+	u64 frameIndex = 0;
+	for (u32 pipelined = 0; pipelined < 2; ++pipelined) {
+		settings.pipelined = pipelined != 0;
+
+		FrameLoop loop(nullptr, nullptr);
+		frameIndex = loop.Run(scene, settings);
+		summaries[pipelined] = loop.GetStats().ComputeSummary();
+
+		// the next run writes over the snapshots
+		if (!settings.pipelined) {
+			lockstepSnapshot = global::sceneSystem->renderSnapshots[frameIndex % 2];
+		}
+
+		spdlog::info("{}: frame avg {:.3f}ms p50 {:.3f}ms p95 {:.3f}ms over the last {} frames", settings.pipelined ? "pipelined" : "lockstep",
+			summaries[pipelined].average, summaries[pipelined].p50, summaries[pipelined].p95, summaries[pipelined].frameCount);
+	}
+
+	// on a single core the two stages still take turns and both come out about the same
+	const bool same = SameSnapshot(lockstepSnapshot, global::sceneSystem->renderSnapshots[frameIndex % 2]);
+	spdlog::info("pipelined {:.2f}x the throughput of lockstep, final snapshots {}",
+		summaries[0].average / std::max(summaries[1].average, 1e-3f), same ? "matches" : "MISMATCH");
+
+	spdlog::info("frame checks {}", same ? "passed" : "FAILED");
+	return same;
+}
+
+bool FrameLoop::RunHeadlessBenchmark()
+{
+	if (global::sceneSystem->runtimeScene == nullptr) {
+		global::sceneSystem->runtimeScene = std::allocate_shared<RuntimeScene>(TrackedAllocator<RuntimeScene, MemoryTag::Scene>());
+	}
+	RuntimeScene& scene = *global::sceneSystem->runtimeScene.get();
+
+	// the frame count --headless defaults to, 10 seconds of scene time
+	Settings settings;
+	settings.frameLimit = 600;
+
+	spdlog::stopwatch runTime;
+	FrameLoop loop(nullptr, nullptr);
+	const u64 frameIndex = loop.Run(scene, settings);
+	const f32 runMs = ElapsedMs(runTime);
+	loop.LogSummary(frameIndex);
+
+	// the scene only depends on the time, a fresh one put straight at the time of the last frame has to agree
+	std::shared_ptr<RuntimeScene> reference = std::allocate_shared<RuntimeScene>(TrackedAllocator<RuntimeScene, MemoryTag::Scene>());
+	reference->Update(static_cast<f64>(frameIndex) * settings.frameTime);
+	RenderSnapshot referenceSnapshot;
+	reference->WriteSnapshot(frameIndex, referenceSnapshot);
+
+	const RenderSnapshot& last = global::sceneSystem->renderSnapshots[frameIndex % 2];
+	const bool same = loop.GetStats().GetFrameCount() == settings.frameLimit && SameSnapshot(last, referenceSnapshot);
+	spdlog::info("headless {} frames on {} threads in {:.2f}ms, {:.1f} frames a second, {} meshes in the last snapshot, {} palette matrices, against the reference {}",
+		frameIndex, global::jobSystem->GetThreadCount(), runMs, static_cast<f64>(frameIndex) * 1000.0 / std::max(runMs, 1e-3f),
+		last.staticMeshes.size(), last.palettes.size(), same ? "matches" : "MISMATCH");
+
+	spdlog::info("headless checks {}", same ? "passed" : "FAILED");
+	return same;
+}
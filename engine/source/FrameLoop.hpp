@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "Core/FrameStats.hpp"
+
+class RuntimeScene;
+struct RenderSnapshot;
+
+// draws the snapshot of a frame, the DX11 context in the app, headless runs and the tools go without one
+class FrameRenderer {
+public:
+	virtual ~FrameRenderer() = default;
+
+	// fills in the render counters and present time of stats
+	virtual void Render(const RenderSnapshot& snapshot, FrameStats& stats) = 0;
+};
+
+// the window the frame loop runs in, the app puts glfw behind it, without one the loop steps a fixed
+// amount of scene time per frame so runs are repeatable
+class FrameWindow {
+public:
+	virtual ~FrameWindow() = default;
+
+	virtual void PollEvents() = 0;
+	// seconds since startup
+	virtual f64 GetTime() const = 0;
+	virtual bool ShouldClose() const = 0;
+};
+
+// two stage frame pipeline, while the renderer builds commands for frame N from its snapshot a worker updates
+// the scene and writes the snapshot for frame N+1 into the other buffer of SceneSystem::renderSnapshots
+//
+// needs no window or device, the scene update, the snapshot and the culling in it run the same without them
+class FrameLoop {
+public:
+	struct Settings {
+		// update frame N+1 on a worker while frame N renders, otherwise update then render on this thread
+		bool pipelined = true;
+		// extra cpu time burned in the render and update stage of every frame, for the frame benchmark
+		f64 renderMs = 0.0;
+		f64 updateMs = 0.0;
+
+		// seconds of scene time per frame without a window
+		f64 frameTime = 1.0 / 60.0;
+		// exit after this many frames or seconds of scene time, 0 is no limit
+		u64 frameLimit = 0;
+		f64 timeLimit = 0.0;
+	};
+
+public:
+	// either can be null
+	FrameLoop(FrameWindow* window, FrameRenderer* renderer);
+
+	// until a limit is hit or the window closes, returns the index of the last frame, its snapshot is the one
+	// in renderSnapshots[index % 2]
+	u64 Run(RuntimeScene& scene, const Settings& settings);
+
+	inline FrameStats& GetStats() { return m_frameStats; }
+
+	// what the frames of the last Run took and what the culling of its last snapshot did
+	void LogSummary(u64 frameIndex) const;
+
+	// the scene of the catalog without a renderer in lockstep and pipelined under a synthetic load, checks both
+	// runs end on the same snapshot, the throughput only goes up with a core for each stage
+	static bool RunBenchmark();
+
+	// N frames of the catalog scene the way --headless runs them, no window, device or renderer, checks the last
+	// snapshot against one a scene of its own writes straight for that time
+	static bool RunHeadlessBenchmark();
+
+private:
+	f64 GetTime(u64 frameIndex, const Settings& settings) const;
+	bool ShouldExit(u64 frameIndex, const Settings& settings) const;
+
+private:
+	FrameWindow* m_window = nullptr;
+	FrameRenderer* m_renderer = nullptr;
+
+	FrameStats m_frameStats;
+};
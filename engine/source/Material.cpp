@@ -0,0 +1,342 @@
+#include "Material.hpp"
+
+#include "AssetSystem.hpp"
+#include "Core/Log.hpp"
+#include "Core/Profiler.hpp"
+
+#include <cgltf/cgltf.h>
+
+#include <cstring>
+#include <random>
+
+using namespace Material;
+
+Desc Material::DefaultDesc()
+{
+	Desc desc;
+	desc.name = "default";
+	desc.metallicFactor = 0.0f;
+	desc.roughnessFactor = 0.5f;
+	return desc;
+}
+
+Constants Material::Pack(const Desc& desc)
+{
+	Constants constants = {
+		.baseColorFactor = desc.baseColorFactor,
+		.emissiveFactor = desc.emissiveFactor,
+		.metallicFactor = desc.metallicFactor,
+		.roughnessFactor = desc.roughnessFactor,
+		.normalScale = desc.normalScale,
+		.occlusionStrength = desc.occlusionStrength,
+		.alphaCutoff = desc.alphaCutoff,
+		.alphaMode = static_cast<u32>(desc.alphaMode),
+		.flags = (desc.doubleSided ? FlagDoubleSided : 0u) | (desc.unlit ? FlagUnlit : 0u),
+		.textureMask = 0,
+		.texCoords = 0,
+	};
+
+	for (u32 slot = 0; slot < TextureSlotCount; ++slot) {
+		const Texture& texture = desc.textures[slot];
+		if (texture.pathHash != 0) {
+			constants.textureMask |= 1u << slot;
+			constants.texCoords |= (texture.texCoord & 0xf) << (4 * slot);
+		}
+	}
+
+	return constants;
+}
+
+u64 Material::ContentHash(const Desc& desc)
+{
+	// the packed constants are everything but the name and the texture paths, and have no padding to hash
+	const Constants constants = Pack(desc);
+	u64 hash = Hash64(&constants, sizeof(constants));
+	for (const Texture& texture : desc.textures) {
+		hash = Hash64(&texture.pathHash, sizeof(texture.pathHash), hash);
+	}
+	return hash;
+}
+
+static bool SameContent(const Desc& a, const Desc& b)
+{
+	const Constants packedA = Pack(a);
+	const Constants packedB = Pack(b);
+	if (memcmp(&packedA, &packedB, sizeof(Constants)) != 0) {
+		return false;
+	}
+
+	for (u32 slot = 0; slot < TextureSlotCount; ++slot) {
+		if (a.textures[slot].pathHash != b.textures[slot].pathHash) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static Texture ImportTexture(const cgltf_texture_view& view, std::string_view filePath)
+{
+	if (view.texture == nullptr || view.texture->image == nullptr) {
+		return Texture{};
+	}
+
+	const cgltf_image* image = view.texture->image;
+	if (image->uri == nullptr || strncmp(image->uri, "data:", 5) == 0) {
+		// @TODO: textures in the glb itself, the catalog only knows textures that are files
+		LOG_WARN("material texture {} of {} is embedded, only image files are supported", SPDLOG_PTR(image->name), filePath);
+		return Texture{};
+	}
+
+	// uris are relative to the gltf file and can be percent encoded
+	std::string uri = image->uri;
+	uri.resize(cgltf_decode_uri(uri.data()));
+
+	const std::filesystem::path path = std::filesystem::path(filePath).parent_path() / uri;
+	return Texture{
+		.pathHash = HashPath(path.lexically_normal().generic_string()),
+		.texCoord = static_cast<u32>(view.texcoord),
+	};
+}
+
+void Material::ImportGltf(const cgltf_material* material, std::string_view filePath, Desc& outDesc)
+{
+	if (material == nullptr) {
+		outDesc = DefaultDesc();
+		return;
+	}
+
+	outDesc = Desc{};
+	outDesc.name = material->name != nullptr ? material->name : "";
+
+	// cgltf fills in the glTF defaults for everything the file leaves out
+	if (material->has_pbr_metallic_roughness) {
+		const cgltf_pbr_metallic_roughness& pbr = material->pbr_metallic_roughness;
+		outDesc.baseColorFactor = float4(pbr.base_color_factor[0], pbr.base_color_factor[1], pbr.base_color_factor[2], pbr.base_color_factor[3]);
+		outDesc.metallicFactor = pbr.metallic_factor;
+		outDesc.roughnessFactor = pbr.roughness_factor;
+		outDesc.textures[static_cast<u32>(TextureSlot::BaseColor)] = ImportTexture(pbr.base_color_texture, filePath);
+		outDesc.textures[static_cast<u32>(TextureSlot::MetallicRoughness)] = ImportTexture(pbr.metallic_roughness_texture, filePath);
+	} else if (material->has_pbr_specular_glossiness) {
+		LOG_WARN("material {} of {} is specular glossiness, only metallic roughness is supported", outDesc.name, filePath);
+	}
+
+	const f32 emissiveStrength = material->has_emissive_strength ? material->emissive_strength.emissive_strength : 1.0f;
+	outDesc.emissiveFactor = float3(
+		material->emissive_factor[0] * emissiveStrength,
+		material->emissive_factor[1] * emissiveStrength,
+		material->emissive_factor[2] * emissiveStrength);
+
+	outDesc.textures[static_cast<u32>(TextureSlot::Normal)] = ImportTexture(material->normal_texture, filePath);
+	outDesc.textures[static_cast<u32>(TextureSlot::Occlusion)] = ImportTexture(material->occlusion_texture, filePath);
+	outDesc.textures[static_cast<u32>(TextureSlot::Emissive)] = ImportTexture(material->emissive_texture, filePath);
+	// scale is only written for the normal and occlusion textures and is 1 when there is none
+	outDesc.normalScale = material->normal_texture.scale;
+	outDesc.occlusionStrength = material->occlusion_texture.scale;
+
+	switch (material->alpha_mode) {
+	case cgltf_alpha_mode_mask: outDesc.alphaMode = AlphaMode::Mask; break;
+	case cgltf_alpha_mode_blend: outDesc.alphaMode = AlphaMode::Blend; break;
+	default: outDesc.alphaMode = AlphaMode::Opaque; break;
+	}
+	outDesc.alphaCutoff = material->alpha_cutoff;
+	outDesc.doubleSided = material->double_sided;
+	outDesc.unlit = material->unlit;
+}
+
+u32 Library::Add(const Desc& desc)
+{
+	const u64 hash = ContentHash(desc);
+
+	auto [begin, end] = m_lookup.equal_range(hash);
+	for (auto it = begin; it != end; ++it) {
+		if (SameContent(m_descs[it->second], desc)) {
+			return it->second;
+		}
+	}
+
+	const u32 index = Count();
+	m_descs.push_back(desc);
+	m_constants.push_back(Pack(desc));
+	m_lookup.emplace(hash, index);
+	return index;
+}
+
+//
+// benchmark
+//
+
+static bool PackedMatches(const Desc& desc, const Constants& constants)
+{
+	bool matches =
+		constants.baseColorFactor.x == desc.baseColorFactor.x && constants.baseColorFactor.y == desc.baseColorFactor.y &&
+		constants.baseColorFactor.z == desc.baseColorFactor.z && constants.baseColorFactor.w == desc.baseColorFactor.w &&
+		constants.emissiveFactor.x == desc.emissiveFactor.x && constants.emissiveFactor.y == desc.emissiveFactor.y &&
+		constants.emissiveFactor.z == desc.emissiveFactor.z &&
+		constants.metallicFactor == desc.metallicFactor && constants.roughnessFactor == desc.roughnessFactor &&
+		constants.normalScale == desc.normalScale && constants.occlusionStrength == desc.occlusionStrength &&
+		constants.alphaCutoff == desc.alphaCutoff && constants.alphaMode == static_cast<u32>(desc.alphaMode) &&
+		((constants.flags & FlagDoubleSided) != 0) == desc.doubleSided && ((constants.flags & FlagUnlit) != 0) == desc.unlit;
+
+	for (u32 slot = 0; slot < TextureSlotCount; ++slot) {
+		const bool hasTexture = desc.textures[slot].pathHash != 0;
+		matches &= ((constants.textureMask >> slot) & 1) == static_cast<u32>(hasTexture);
+		matches &= !hasTexture || ((constants.texCoords >> (4 * slot)) & 0xf) == desc.textures[slot].texCoord;
+	}
+	return matches;
+}
+
+// every primitive of every mesh of the file, not only the first one MeshAsset draws
+static bool CheckFile(std::string_view path)
+{
+	FileView file = global::assetSystem->OpenFile(path);
+	if (!file) {
+		spdlog::warn("{} isnt there, skipping it", path);
+		return true;
+	}
+
+	cgltf_options options = {};
+	cgltf_data* data = nullptr;
+	if (cgltf_parse(&options, file.Data(), file.Size(), &data) != cgltf_result_success) {
+		spdlog::error("failed parsing {}", path);
+		return false;
+	}
+
+	Library library;
+	// the library index every glTF material (and no material at all, the last entry) ended up at
+	TrackedVector<u32, MemoryTag::Scratch> indexOfMaterial(data->materials_count + 1, InvalidAssetIndex);
+	u32 primitiveCount = 0;
+	bool packing = true;
+	bool dedup = true;
+
+	for (cgltf_size m = 0; m < data->meshes_count; ++m) {
+		for (cgltf_size p = 0; p < data->meshes[m].primitives_count; ++p) {
+			const cgltf_material* material = data->meshes[m].primitives[p].material;
+			Desc desc;
+			ImportGltf(material, path, desc);
+
+			const u32 index = library.Add(desc);
+			packing &= PackedMatches(desc, library.GetConstants()[index]);
+
+			// primitives sharing a glTF material share the library entry
+			u32& expected = indexOfMaterial[material != nullptr ? cgltf_material_index(data, material) : data->materials_count];
+			dedup &= expected == InvalidAssetIndex || expected == index;
+			expected = index;
+			++primitiveCount;
+		}
+	}
+
+	// distinct entries never have the same content
+	for (u32 a = 0; a < library.Count(); ++a) {
+		for (u32 b = a + 1; b < library.Count(); ++b) {
+			dedup &= !SameContent(library.Get(a), library.Get(b));
+		}
+	}
+
+	// importing the same file again adds nothing
+	const u32 count = library.Count();
+	for (cgltf_size m = 0; m < data->meshes_count; ++m) {
+		for (cgltf_size p = 0; p < data->meshes[m].primitives_count; ++p) {
+			Desc desc;
+			ImportGltf(data->meshes[m].primitives[p].material, path, desc);
+			(void)library.Add(desc);
+		}
+	}
+	dedup &= library.Count() == count;
+
+	// the material MeshAsset::Load registered for the first primitive has the same content
+	const AssetCatalog* catalog = global::assetSystem->Catalog();
+	const MeshID meshId = catalog->FindMeshAsset(path);
+	bool catalogMatches = true;
+	if (meshId.value != InvalidAssetIndex && data->meshes_count > 0 && data->meshes[0].primitives_count > 0) {
+		const MeshAsset& mesh = catalog->GetMeshAsset(meshId);
+		Desc desc;
+		ImportGltf(data->meshes[0].primitives[0].material, path, desc);
+		catalogMatches = mesh.state != AssetState::Loaded || SameContent(catalog->GetMaterial(mesh.GetMaterial()), desc);
+	}
+
+	spdlog::info("{}: {} primitives, {} glTF materials, {} after dedup, packing {}, dedup {}, catalog {}",
+		path, primitiveCount, data->materials_count, count,
+		packing ? "matches" : "MISMATCH", dedup ? "matches" : "MISMATCH", catalogMatches ? "matches" : "MISMATCH");
+
+	cgltf_free(data);
+	return packing && dedup && catalogMatches;
+}
+
+bool Material::RunBenchmark()
+{
+	constexpr u32 materialCount = 1 << 18;
+	constexpr u32 distinctCount = 256;
+	constexpr u32 runs = 5;
+
+	spdlog::info("material benchmark, Constants is {} bytes", sizeof(Constants));
+
+	bool passed = CheckFile("meshes/scene1.glb");
+
+	// every other mesh in the catalog too
+	const AssetManifest& manifest = global::assetSystem->Catalog()->GetManifest();
+	for (u32 i = 0; i < manifest.GetEntryCount(); ++i) {
+		const AssetManifest::Entry& entry = manifest.GetEntry(i);
+		const std::string_view path = manifest.GetPath(entry);
+		if (entry.type == AssetType::Mesh && path != "meshes/scene1.glb") {
+			passed &= CheckFile(path);
+		}
+	}
+
+	const AssetCatalog* catalog = global::assetSystem->Catalog();
+	spdlog::info("catalog has {} materials, {} bytes of constants", catalog->GetMaterialCount(), catalog->GetMaterialConstants().size_bytes());
+
+	// a few distinct materials under a lot of names, like a level where every prop exports its own copy
+	std::mt19937 rng(48);
+	std::uniform_real_distribution<f32> unit(0.0f, 1.0f);
+
+	TrackedVector<Desc, MemoryTag::Scratch> distinct(distinctCount);
+	for (u32 d = 0; d < distinctCount; ++d) {
+		Desc& desc = distinct[d];
+		desc.baseColorFactor = float4(unit(rng), unit(rng), unit(rng), 1.0f);
+		desc.metallicFactor = unit(rng);
+		desc.roughnessFactor = unit(rng);
+		desc.alphaMode = static_cast<AlphaMode>(d % 3);
+		desc.doubleSided = d % 2 == 0;
+		desc.textures[static_cast<u32>(TextureSlot::BaseColor)].pathHash = HashPath(fmt::format("textures/albedo_{}.png", d % 16));
+		desc.textures[static_cast<u32>(TextureSlot::Normal)].pathHash = d % 4 == 0 ? HashPath(fmt::format("textures/normal_{}.png", d % 16)) : 0;
+	}
+
+	TrackedVector<Desc, MemoryTag::Scratch> descs(materialCount);
+	TrackedVector<u32, MemoryTag::Scratch> sources(materialCount);
+	for (u32 i = 0; i < materialCount; ++i) {
+		sources[i] = rng() % distinctCount;
+		descs[i] = distinct[sources[i]];
+		descs[i].name = fmt::format("prop_{}", i);
+	}
+
+	f64 bestMs = std::numeric_limits<f64>::max();
+	for (u32 r = 0; r < runs; ++r) {
+		Library library;
+		TrackedVector<u32, MemoryTag::Scratch> indices(materialCount);
+
+		spdlog::stopwatch sw;
+		for (u32 i = 0; i < materialCount; ++i) {
+			indices[i] = library.Add(descs[i]);
+		}
+		bestMs = std::min(bestMs, sw.elapsed().count() * 1000.0);
+
+		// every copy of a material lands on the entry of the first one
+		TrackedVector<u32, MemoryTag::Scratch> entryOfSource(distinctCount, InvalidAssetIndex);
+		bool dedup = library.Count() == distinctCount;
+		for (u32 i = 0; i < materialCount; ++i) {
+			u32& entry = entryOfSource[sources[i]];
+			dedup &= entry == InvalidAssetIndex || entry == indices[i];
+			entry = indices[i];
+		}
+
+		if (r == 0) {
+			spdlog::info("{} materials, {} distinct: {} entries, {} bytes of constants, dedup {}",
+				materialCount, distinctCount, library.Count(), library.GetConstants().size_bytes(), dedup ? "matches" : "MISMATCH");
+			passed &= dedup;
+		}
+	}
+
+	spdlog::info("dedup {:.2f} ms, {:.1f} ns per material", bestMs, bestMs * 1e6 / materialCount);
+	spdlog::info("material checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "Math.hpp"
+#include "Core/Hash.hpp"
+#include "Core/MemoryTracker.hpp"
+
+#include <array>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+struct cgltf_material;
+
+// glTF metallic roughness materials, imported by MeshAsset::Load and registered with the catalog
+//
+// a material is its parameters plus the textures of its slots, the catalog keeps one copy of every
+// distinct material (by a hash of the content, names dont count) so every mesh of a file that shares
+// one, or two files exporting the same one, end up with the same MaterialID
+//
+// the gpu side of every material is a Constants in one contiguous array, uploaded as a structured buffer
+// that the gbuffer pass indexes with the MaterialID of the draw, so switching materials between draws
+// maps nothing
+namespace Material
+{
+	template<typename T>
+	using Data = TrackedVector<T, MemoryTag::AssetsMaterial>;
+
+	// same values as ALPHA_MODE_* in simple_deferred_ps.hlsl
+	enum class AlphaMode : u32 {
+		Opaque = 0,
+		// clipped at alphaCutoff
+		Mask = 1,
+		// the deferred path has nowhere to blend, drawn like Opaque until there is a forward pass
+		Blend = 2,
+	};
+
+	enum class TextureSlot : u32 {
+		BaseColor,
+		MetallicRoughness,
+		Normal,
+		Occlusion,
+		Emissive,
+
+		Num
+	};
+
+	constexpr u32 TextureSlotCount = static_cast<u32>(TextureSlot::Num);
+
+	// bits of Constants::flags
+	constexpr u32 FlagDoubleSided = 1u << 0;
+	constexpr u32 FlagUnlit = 1u << 1;
+
+	struct Texture {
+		// HashPath of the image, relative to the data dir like every other asset, 0 for no texture
+		// images embedded in the file have no path and dont count
+		u64 pathHash = 0;
+		// which TEXCOORD_n it samples with
+		u32 texCoord = 0;
+	};
+
+	// the material asset, defaults are the glTF ones
+	struct Desc {
+		// only for logs, two materials with different names and the same content are the same material
+		std::string name;
+
+		float4 baseColorFactor = float4(1.0f, 1.0f, 1.0f, 1.0f);
+		float3 emissiveFactor = float3(0.0f, 0.0f, 0.0f);
+		f32 metallicFactor = 1.0f;
+		f32 roughnessFactor = 1.0f;
+		f32 normalScale = 1.0f;
+		f32 occlusionStrength = 1.0f;
+		f32 alphaCutoff = 0.5f;
+		AlphaMode alphaMode = AlphaMode::Opaque;
+		bool doubleSided = false;
+		bool unlit = false;
+
+		std::array<Texture, TextureSlotCount> textures = {};
+
+		inline const Texture& GetTexture(TextureSlot slot) const { return textures[static_cast<u32>(slot)]; }
+	};
+
+	// one per material in the structured buffer, same layout as Material in simple_deferred_ps.hlsl
+	struct Constants {
+		float4 baseColorFactor;
+		float3 emissiveFactor;
+		f32 metallicFactor;
+		f32 roughnessFactor;
+		f32 normalScale;
+		f32 occlusionStrength;
+		f32 alphaCutoff;
+		u32 alphaMode;
+		u32 flags;
+		// bit n set when TextureSlot n has a texture
+		u32 textureMask;
+		// 4 bits per slot, the TEXCOORD_n the slot samples with
+		u32 texCoords;
+	};
+
+	static_assert(sizeof(Constants) == 64, "Constants is read as a structured buffer, keep it in sync with the hlsl");
+	static_assert(offsetof(Constants, emissiveFactor) == 16 && offsetof(Constants, roughnessFactor) == 32 && offsetof(Constants, alphaMode) == 48,
+		"Constants is read as a structured buffer, keep it in sync with the hlsl");
+
+	// what primitives without a material get, the glTF default is a fully rough metal which has no diffuse
+	// and no highlight under the phong lighting, so a grey dielectric like the ones blender exports instead
+	Desc DefaultDesc();
+
+	Constants Pack(const Desc& desc);
+
+	// of everything but the name, textures by path
+	u64 ContentHash(const Desc& desc);
+
+	// material is null for primitives without one, image uris resolve against the directory of filePath
+	void ImportGltf(const cgltf_material* material, std::string_view filePath, Desc& outDesc);
+
+	// the deduplicated set of materials, indices are stable since nothing is ever removed
+	class Library {
+	public:
+		// index of the material with the same content if there is one, otherwise adds it
+		u32 Add(const Desc& desc);
+
+		inline u32 Count() const { return static_cast<u32>(m_descs.size()); }
+		inline const Desc& Get(u32 index) const { return m_descs[index]; }
+		// Count() of them back to back, ready to copy into the structured buffer
+		inline std::span<const Constants> GetConstants() const { return m_constants; }
+
+	private:
+		Data<Desc> m_descs;
+		Data<Constants> m_constants;
+		// content hash -> materials with it, more than one only when two different ones collide
+		std::unordered_multimap<u64, u32, IdentityHash> m_lookup;
+	};
+
+	// packing and dedup checked against scene1.glb and every mesh the catalog loaded, then import and
+	// dedup throughput on a lot of generated materials with few distinct ones
+	bool RunBenchmark();
+}
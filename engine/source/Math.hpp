@@ -1,4 +1,6 @@
-#include <directxmath.h>
+#pragma once
+
+#include <DirectXMath.h>
 
 using float2 = DirectX::XMFLOAT2;
 using float3 = DirectX::XMFLOAT3;
@@ -12,3 +14,18 @@ using mat4 = DirectX::XMMATRIX;
 using vec4 = DirectX::XMVECTOR;
 using quat = DirectX::XMVECTOR;
 
+// 8 float3s as structure of arrays, what the batch kernels in MathBatch.hpp work on
+// 8 wide to match avx2, the sse path does each half
+struct alignas(32) float3_soa {
+	static constexpr unsigned Width = 8;
+
+	float x[Width];
+	float y[Width];
+	float z[Width];
+};
+
+// axis aligned box
+struct Bounds {
+	float3 min;
+	float3 max;
+};
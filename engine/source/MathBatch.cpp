@@ -0,0 +1,911 @@
+#include "MathBatch.hpp"
+
+#include <immintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// msvc lets any function use any intrinsic, gcc and clang only where the function is marked for it
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET_SSE4
+#define TARGET_AVX2
+#else
+#define TARGET_SSE4 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+using namespace MathBatch;
+
+// normals shorter than this come out as zero instead of nan
+static constexpr f32 s_minLengthSq = 1e-30f;
+
+static Isa DetectIsa()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	const bool sse41 = (info[2] & (1 << 19)) != 0;
+	const bool fma = (info[2] & (1 << 12)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+
+	bool avx2 = false;
+	if (maxLeaf >= 7) {
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+
+	// the os has to save the ymm registers on a context switch too
+	const bool ymmEnabled = osxsave && (_xgetbv(0) & 0x6) == 0x6;
+
+	if (avx && avx2 && fma && ymmEnabled) {
+		return Isa::AVX2;
+	}
+	if (sse41) {
+		return Isa::SSE4;
+	}
+	return Isa::Scalar;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return Isa::AVX2;
+	}
+	if (__builtin_cpu_supports("sse4.1")) {
+		return Isa::SSE4;
+	}
+	return Isa::Scalar;
+#endif
+}
+
+// the same kernel on every isa, the public functions check the sizes and pick one
+struct Kernels {
+	void (*transformPoints)(const float4x4& m, const float3_soa* in, float3_soa* out, size_t count);
+	void (*transformNormals)(const float4x4& m, const float3_soa* in, float3_soa* out, size_t count);
+	void (*multiplyMatrices)(const float4x4* a, const float4x4* b, float4x4* out, size_t count);
+	void (*composeTransforms)(const float3* translations, const float4* rotations, const float3* scales, float4x4* out, size_t count);
+	void (*transformBounds)(const Bounds* in, const float4x4* matrices, Bounds* out, size_t count);
+};
+
+//
+// scalar, the fallback and the tails of the wider versions
+//
+
+static void TransformPointsScalar(const float4x4& m, const float3_soa* in, float3_soa* out, size_t count)
+{
+	for (size_t p = 0; p < count; ++p) {
+		for (u32 l = 0; l < float3_soa::Width; ++l) {
+			const f32 x = in[p].x[l];
+			const f32 y = in[p].y[l];
+			const f32 z = in[p].z[l];
+			out[p].x[l] = x * m._11 + y * m._21 + z * m._31 + m._41;
+			out[p].y[l] = x * m._12 + y * m._22 + z * m._32 + m._42;
+			out[p].z[l] = x * m._13 + y * m._23 + z * m._33 + m._43;
+		}
+	}
+}
+
+static void TransformNormalsScalar(const float4x4& m, const float3_soa* in, float3_soa* out, size_t count)
+{
+	for (size_t p = 0; p < count; ++p) {
+		for (u32 l = 0; l < float3_soa::Width; ++l) {
+			const f32 x = in[p].x[l];
+			const f32 y = in[p].y[l];
+			const f32 z = in[p].z[l];
+			const f32 nx = x * m._11 + y * m._21 + z * m._31;
+			const f32 ny = x * m._12 + y * m._22 + z * m._32;
+			const f32 nz = x * m._13 + y * m._23 + z * m._33;
+			const f32 invLength = 1.0f / std::sqrt(std::max(nx * nx + ny * ny + nz * nz, s_minLengthSq));
+			out[p].x[l] = nx * invLength;
+			out[p].y[l] = ny * invLength;
+			out[p].z[l] = nz * invLength;
+		}
+	}
+}
+
+static void MultiplyMatricesScalar(const float4x4* a, const float4x4* b, float4x4* out, size_t count)
+{
+	for (size_t i = 0; i < count; ++i) {
+		// a or b can be out
+		float4x4 result;
+		for (u32 r = 0; r < 4; ++r) {
+			for (u32 c = 0; c < 4; ++c) {
+				result.m[r][c] = a[i].m[r][0] * b[i].m[0][c] + a[i].m[r][1] * b[i].m[1][c] + a[i].m[r][2] * b[i].m[2][c] + a[i].m[r][3] * b[i].m[3][c];
+			}
+		}
+		out[i] = result;
+	}
+}
+
+static void ComposeTransform(const float3& t, const float4& q, const float3& s, float4x4& out)
+{
+	const f32 xx = q.x * q.x;
+	const f32 yy = q.y * q.y;
+	const f32 zz = q.z * q.z;
+	const f32 xy = q.x * q.y;
+	const f32 xz = q.x * q.z;
+	const f32 yz = q.y * q.z;
+	const f32 wx = q.w * q.x;
+	const f32 wy = q.w * q.y;
+	const f32 wz = q.w * q.z;
+
+	out = float4x4(
+		s.x * (1.0f - 2.0f * (yy + zz)), s.x * (2.0f * (xy + wz)), s.x * (2.0f * (xz - wy)), 0.0f,
+		s.y * (2.0f * (xy - wz)), s.y * (1.0f - 2.0f * (xx + zz)), s.y * (2.0f * (yz + wx)), 0.0f,
+		s.z * (2.0f * (xz + wy)), s.z * (2.0f * (yz - wx)), s.z * (1.0f - 2.0f * (xx + yy)), 0.0f,
+		t.x, t.y, t.z, 1.0f);
+}
+
+static void ComposeTransformsScalar(const float3* translations, const float4* rotations, const float3* scales, float4x4* out, size_t count)
+{
+	for (size_t i = 0; i < count; ++i) {
+		ComposeTransform(translations[i], rotations[i], scales[i], out[i]);
+	}
+}
+
+// center and extents instead of the 8 corners, the new extent on each axis is the sum of the old
+// extents scaled by the absolute matrix entries
+static void TransformBound(const Bounds& in, const float4x4& m, Bounds& out)
+{
+	const f32 center[3] = { (in.min.x + in.max.x) * 0.5f, (in.min.y + in.max.y) * 0.5f, (in.min.z + in.max.z) * 0.5f };
+	const f32 extent[3] = { (in.max.x - in.min.x) * 0.5f, (in.max.y - in.min.y) * 0.5f, (in.max.z - in.min.z) * 0.5f };
+
+	f32 newCenter[3];
+	f32 newExtent[3];
+	for (u32 c = 0; c < 3; ++c) {
+		newCenter[c] = center[0] * m.m[0][c] + center[1] * m.m[1][c] + center[2] * m.m[2][c] + m.m[3][c];
+		newExtent[c] = extent[0] * std::abs(m.m[0][c]) + extent[1] * std::abs(m.m[1][c]) + extent[2] * std::abs(m.m[2][c]);
+	}
+
+	out.min = float3(newCenter[0] - newExtent[0], newCenter[1] - newExtent[1], newCenter[2] - newExtent[2]);
+	out.max = float3(newCenter[0] + newExtent[0], newCenter[1] + newExtent[1], newCenter[2] + newExtent[2]);
+}
+
+static void TransformBoundsScalar(const Bounds* in, const float4x4* matrices, Bounds* out, size_t count)
+{
+	for (size_t i = 0; i < count; ++i) {
+		TransformBound(in[i], matrices[i], out[i]);
+	}
+}
+
+//
+// sse4.1, 4 lanes, each point packet in two halves
+//
+
+TARGET_SSE4 static void TransformPointsSSE4(const float4x4& m, const float3_soa* in, float3_soa* out, size_t count)
+{
+	const __m128 m11 = _mm_set1_ps(m._11), m12 = _mm_set1_ps(m._12), m13 = _mm_set1_ps(m._13);
+	const __m128 m21 = _mm_set1_ps(m._21), m22 = _mm_set1_ps(m._22), m23 = _mm_set1_ps(m._23);
+	const __m128 m31 = _mm_set1_ps(m._31), m32 = _mm_set1_ps(m._32), m33 = _mm_set1_ps(m._33);
+	const __m128 m41 = _mm_set1_ps(m._41), m42 = _mm_set1_ps(m._42), m43 = _mm_set1_ps(m._43);
+
+	for (size_t p = 0; p < count; ++p) {
+		for (u32 half = 0; half < float3_soa::Width; half += 4) {
+			const __m128 x = _mm_loadu_ps(in[p].x + half);
+			const __m128 y = _mm_loadu_ps(in[p].y + half);
+			const __m128 z = _mm_loadu_ps(in[p].z + half);
+
+			const __m128 ox = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m11), _mm_mul_ps(y, m21)), _mm_mul_ps(z, m31)), m41);
+			const __m128 oy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m12), _mm_mul_ps(y, m22)), _mm_mul_ps(z, m32)), m42);
+			const __m128 oz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m13), _mm_mul_ps(y, m23)), _mm_mul_ps(z, m33)), m43);
+
+			_mm_storeu_ps(out[p].x + half, ox);
+			_mm_storeu_ps(out[p].y + half, oy);
+			_mm_storeu_ps(out[p].z + half, oz);
+		}
+	}
+}
+
+TARGET_SSE4 static void TransformNormalsSSE4(const float4x4& m, const float3_soa* in, float3_soa* out, size_t count)
+{
+	const __m128 m11 = _mm_set1_ps(m._11), m12 = _mm_set1_ps(m._12), m13 = _mm_set1_ps(m._13);
+	const __m128 m21 = _mm_set1_ps(m._21), m22 = _mm_set1_ps(m._22), m23 = _mm_set1_ps(m._23);
+	const __m128 m31 = _mm_set1_ps(m._31), m32 = _mm_set1_ps(m._32), m33 = _mm_set1_ps(m._33);
+	const __m128 minLengthSq = _mm_set1_ps(s_minLengthSq);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for (size_t p = 0; p < count; ++p) {
+		for (u32 half = 0; half < float3_soa::Width; half += 4) {
+			const __m128 x = _mm_loadu_ps(in[p].x + half);
+			const __m128 y = _mm_loadu_ps(in[p].y + half);
+			const __m128 z = _mm_loadu_ps(in[p].z + half);
+
+			const __m128 nx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m11), _mm_mul_ps(y, m21)), _mm_mul_ps(z, m31));
+			const __m128 ny = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m12), _mm_mul_ps(y, m22)), _mm_mul_ps(z, m32));
+			const __m128 nz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m13), _mm_mul_ps(y, m23)), _mm_mul_ps(z, m33));
+
+			// a real sqrt and divide rather than rsqrt, normals feed lighting and the 12 bit estimate shows
+			const __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+			const __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(lengthSq, minLengthSq)));
+
+			_mm_storeu_ps(out[p].x + half, _mm_mul_ps(nx, invLength));
+			_mm_storeu_ps(out[p].y + half, _mm_mul_ps(ny, invLength));
+			_mm_storeu_ps(out[p].z + half, _mm_mul_ps(nz, invLength));
+		}
+	}
+}
+
+TARGET_SSE4 static void MultiplyMatricesSSE4(const float4x4* a, const float4x4* b, float4x4* out, size_t count)
+{
+	for (size_t i = 0; i < count; ++i) {
+		const __m128 b0 = _mm_loadu_ps(b[i].m[0]);
+		const __m128 b1 = _mm_loadu_ps(b[i].m[1]);
+		const __m128 b2 = _mm_loadu_ps(b[i].m[2]);
+		const __m128 b3 = _mm_loadu_ps(b[i].m[3]);
+
+		__m128 rows[4];
+		for (u32 r = 0; r < 4; ++r) {
+			const __m128 row = _mm_loadu_ps(a[i].m[r]);
+			const __m128 x = _mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0));
+			const __m128 y = _mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1));
+			const __m128 z = _mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2));
+			const __m128 w = _mm_shuffle_ps(row, row, _MM_SHUFFLE(3, 3, 3, 3));
+			rows[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, b0), _mm_mul_ps(y, b1)), _mm_add_ps(_mm_mul_ps(z, b2), _mm_mul_ps(w, b3)));
+		}
+
+		// only stored once everything is read, a or b can be out
+		for (u32 r = 0; r < 4; ++r) {
+			_mm_storeu_ps(out[i].m[r], rows[r]);
+		}
+	}
+}
+
+TARGET_SSE4 static void ComposeTransformsSSE4(const float3* translations, const float4* rotations, const float3* scales, float4x4* out, size_t count)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		// 4 quaternions to x, y, z, w of all 4
+		__m128 qx = _mm_loadu_ps(&rotations[i + 0].x);
+		__m128 qy = _mm_loadu_ps(&rotations[i + 1].x);
+		__m128 qz = _mm_loadu_ps(&rotations[i + 2].x);
+		__m128 qw = _mm_loadu_ps(&rotations[i + 3].x);
+		_MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+		const float3* s = scales + i;
+		const float3* t = translations + i;
+		const __m128 sx = _mm_setr_ps(s[0].x, s[1].x, s[2].x, s[3].x);
+		const __m128 sy = _mm_setr_ps(s[0].y, s[1].y, s[2].y, s[3].y);
+		const __m128 sz = _mm_setr_ps(s[0].z, s[1].z, s[2].z, s[3].z);
+
+		const __m128 xx = _mm_mul_ps(qx, qx);
+		const __m128 yy = _mm_mul_ps(qy, qy);
+		const __m128 zz = _mm_mul_ps(qz, qz);
+		const __m128 xy = _mm_mul_ps(qx, qy);
+		const __m128 xz = _mm_mul_ps(qx, qz);
+		const __m128 yz = _mm_mul_ps(qy, qz);
+		const __m128 wx = _mm_mul_ps(qw, qx);
+		const __m128 wy = _mm_mul_ps(qw, qy);
+		const __m128 wz = _mm_mul_ps(qw, qz);
+
+		// row r of all 4 matrices, transposed back into one row per matrix
+		__m128 rows[4][4] = {
+			{
+				_mm_mul_ps(sx, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)))),
+				_mm_mul_ps(sx, _mm_mul_ps(two, _mm_add_ps(xy, wz))),
+				_mm_mul_ps(sx, _mm_mul_ps(two, _mm_sub_ps(xz, wy))),
+				zero,
+			},
+			{
+				_mm_mul_ps(sy, _mm_mul_ps(two, _mm_sub_ps(xy, wz))),
+				_mm_mul_ps(sy, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)))),
+				_mm_mul_ps(sy, _mm_mul_ps(two, _mm_add_ps(yz, wx))),
+				zero,
+			},
+			{
+				_mm_mul_ps(sz, _mm_mul_ps(two, _mm_add_ps(xz, wy))),
+				_mm_mul_ps(sz, _mm_mul_ps(two, _mm_sub_ps(yz, wx))),
+				_mm_mul_ps(sz, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)))),
+				zero,
+			},
+			{
+				_mm_setr_ps(t[0].x, t[1].x, t[2].x, t[3].x),
+				_mm_setr_ps(t[0].y, t[1].y, t[2].y, t[3].y),
+				_mm_setr_ps(t[0].z, t[1].z, t[2].z, t[3].z),
+				one,
+			},
+		};
+
+		for (u32 r = 0; r < 4; ++r) {
+			_MM_TRANSPOSE4_PS(rows[r][0], rows[r][1], rows[r][2], rows[r][3]);
+			for (u32 k = 0; k < 4; ++k) {
+				_mm_storeu_ps(out[i + k].m[r], rows[r][k]);
+			}
+		}
+	}
+
+	ComposeTransformsScalar(translations + i, rotations + i, scales + i, out + i, count - i);
+}
+
+TARGET_SSE4 static void TransformBoundsSSE4(const Bounds* in, const float4x4* matrices, Bounds* out, size_t count)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+	for (size_t i = 0; i < count; ++i) {
+		// a box is 6 floats, two overlapping loads get all of it without reading past the end,
+		// (min.x min.y min.z max.x) and (min.z max.x max.y max.z), with w zeroed by a blend
+		const f32* box = &in[i].min.x;
+		const __m128 low = _mm_loadu_ps(box);
+		const __m128 high = _mm_loadu_ps(box + 2);
+		const __m128 boundsMin = _mm_blend_ps(low, zero, 0x8);
+		const __m128 boundsMax = _mm_blend_ps(_mm_shuffle_ps(high, high, _MM_SHUFFLE(0, 3, 2, 1)), zero, 0x8);
+		const __m128 center = _mm_mul_ps(_mm_add_ps(boundsMin, boundsMax), half);
+		const __m128 extent = _mm_mul_ps(_mm_sub_ps(boundsMax, boundsMin), half);
+
+		const __m128 r0 = _mm_loadu_ps(matrices[i].m[0]);
+		const __m128 r1 = _mm_loadu_ps(matrices[i].m[1]);
+		const __m128 r2 = _mm_loadu_ps(matrices[i].m[2]);
+		const __m128 r3 = _mm_loadu_ps(matrices[i].m[3]);
+
+		const __m128 newCenter = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_shuffle_ps(center, center, _MM_SHUFFLE(0, 0, 0, 0)), r0),
+			_mm_mul_ps(_mm_shuffle_ps(center, center, _MM_SHUFFLE(1, 1, 1, 1)), r1)),
+			_mm_mul_ps(_mm_shuffle_ps(center, center, _MM_SHUFFLE(2, 2, 2, 2)), r2)),
+			r3);
+		const __m128 newExtent = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_shuffle_ps(extent, extent, _MM_SHUFFLE(0, 0, 0, 0)), _mm_and_ps(r0, absMask)),
+			_mm_mul_ps(_mm_shuffle_ps(extent, extent, _MM_SHUFFLE(1, 1, 1, 1)), _mm_and_ps(r1, absMask))),
+			_mm_mul_ps(_mm_shuffle_ps(extent, extent, _MM_SHUFFLE(2, 2, 2, 2)), _mm_and_ps(r2, absMask)));
+
+		// and back the same way, max.x goes into w of the low half and min.z into x of the high half
+		// both after the loads so in and out can be the same
+		const __m128 newMin = _mm_sub_ps(newCenter, newExtent);
+		const __m128 newMax = _mm_add_ps(newCenter, newExtent);
+		f32* outBox = &out[i].min.x;
+		_mm_storeu_ps(outBox, _mm_insert_ps(newMin, newMax, _MM_MK_INSERTPS_NDX(0, 3, 0)));
+		_mm_storeu_ps(outBox + 2, _mm_insert_ps(_mm_shuffle_ps(newMax, newMax, _MM_SHUFFLE(2, 1, 0, 0)), newMin, _MM_MK_INSERTPS_NDX(2, 0, 0)));
+	}
+}
+
+//
+// avx2, 8 lanes with fma
+//
+
+// 4x4 transpose within each 128 bit half, like _MM_TRANSPOSE4_PS on two sets of 4 at once
+TARGET_AVX2 static inline void Transpose4x2(__m256& a, __m256& b, __m256& c, __m256& d)
+{
+	const __m256 t0 = _mm256_unpacklo_ps(a, b);
+	const __m256 t1 = _mm256_unpackhi_ps(a, b);
+	const __m256 t2 = _mm256_unpacklo_ps(c, d);
+	const __m256 t3 = _mm256_unpackhi_ps(c, d);
+	a = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	b = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	c = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	d = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+TARGET_AVX2 static inline __m256 LoadPair(const f32* low, const f32* high)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(low)), _mm_loadu_ps(high), 1);
+}
+
+TARGET_AVX2 static void TransformPointsAVX2(const float4x4& m, const float3_soa* in, float3_soa* out, size_t count)
+{
+	const __m256 m11 = _mm256_set1_ps(m._11), m12 = _mm256_set1_ps(m._12), m13 = _mm256_set1_ps(m._13);
+	const __m256 m21 = _mm256_set1_ps(m._21), m22 = _mm256_set1_ps(m._22), m23 = _mm256_set1_ps(m._23);
+	const __m256 m31 = _mm256_set1_ps(m._31), m32 = _mm256_set1_ps(m._32), m33 = _mm256_set1_ps(m._33);
+	const __m256 m41 = _mm256_set1_ps(m._41), m42 = _mm256_set1_ps(m._42), m43 = _mm256_set1_ps(m._43);
+
+	for (size_t p = 0; p < count; ++p) {
+		const __m256 x = _mm256_loadu_ps(in[p].x);
+		const __m256 y = _mm256_loadu_ps(in[p].y);
+		const __m256 z = _mm256_loadu_ps(in[p].z);
+
+		_mm256_storeu_ps(out[p].x, _mm256_fmadd_ps(z, m31, _mm256_fmadd_ps(y, m21, _mm256_fmadd_ps(x, m11, m41))));
+		_mm256_storeu_ps(out[p].y, _mm256_fmadd_ps(z, m32, _mm256_fmadd_ps(y, m22, _mm256_fmadd_ps(x, m12, m42))));
+		_mm256_storeu_ps(out[p].z, _mm256_fmadd_ps(z, m33, _mm256_fmadd_ps(y, m23, _mm256_fmadd_ps(x, m13, m43))));
+	}
+}
+
+TARGET_AVX2 static void TransformNormalsAVX2(const float4x4& m, const float3_soa* in, float3_soa* out, size_t count)
+{
+	const __m256 m11 = _mm256_set1_ps(m._11), m12 = _mm256_set1_ps(m._12), m13 = _mm256_set1_ps(m._13);
+	const __m256 m21 = _mm256_set1_ps(m._21), m22 = _mm256_set1_ps(m._22), m23 = _mm256_set1_ps(m._23);
+	const __m256 m31 = _mm256_set1_ps(m._31), m32 = _mm256_set1_ps(m._32), m33 = _mm256_set1_ps(m._33);
+	const __m256 minLengthSq = _mm256_set1_ps(s_minLengthSq);
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	for (size_t p = 0; p < count; ++p) {
+		const __m256 x = _mm256_loadu_ps(in[p].x);
+		const __m256 y = _mm256_loadu_ps(in[p].y);
+		const __m256 z = _mm256_loadu_ps(in[p].z);
+
+		const __m256 nx = _mm256_fmadd_ps(z, m31, _mm256_fmadd_ps(y, m21, _mm256_mul_ps(x, m11)));
+		const __m256 ny = _mm256_fmadd_ps(z, m32, _mm256_fmadd_ps(y, m22, _mm256_mul_ps(x, m12)));
+		const __m256 nz = _mm256_fmadd_ps(z, m33, _mm256_fmadd_ps(y, m23, _mm256_mul_ps(x, m13)));
+
+		const __m256 lengthSq = _mm256_fmadd_ps(nz, nz, _mm256_fmadd_ps(ny, ny, _mm256_mul_ps(nx, nx)));
+		const __m256 invLength = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_max_ps(lengthSq, minLengthSq)));
+
+		_mm256_storeu_ps(out[p].x, _mm256_mul_ps(nx, invLength));
+		_mm256_storeu_ps(out[p].y, _mm256_mul_ps(ny, invLength));
+		_mm256_storeu_ps(out[p].z, _mm256_mul_ps(nz, invLength));
+	}
+}
+
+// two rows of a at once, each half broadcasts its own row entries against the same row of b
+TARGET_AVX2 static inline __m256 MultiplyRowPair(__m256 rows, __m256 b0, __m256 b1, __m256 b2, __m256 b3)
+{
+	__m256 result = _mm256_mul_ps(_mm256_permute_ps(rows, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+	result = _mm256_fmadd_ps(_mm256_permute_ps(rows, _MM_SHUFFLE(1, 1, 1, 1)), b1, result);
+	result = _mm256_fmadd_ps(_mm256_permute_ps(rows, _MM_SHUFFLE(2, 2, 2, 2)), b2, result);
+	result = _mm256_fmadd_ps(_mm256_permute_ps(rows, _MM_SHUFFLE(3, 3, 3, 3)), b3, result);
+	return result;
+}
+
+TARGET_AVX2 static void MultiplyMatricesAVX2(const float4x4* a, const float4x4* b, float4x4* out, size_t count)
+{
+	for (size_t i = 0; i < count; ++i) {
+		const __m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b[i].m[0]));
+		const __m256 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b[i].m[1]));
+		const __m256 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b[i].m[2]));
+		const __m256 b3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b[i].m[3]));
+
+		const __m256 rows01 = MultiplyRowPair(_mm256_loadu_ps(a[i].m[0]), b0, b1, b2, b3);
+		const __m256 rows23 = MultiplyRowPair(_mm256_loadu_ps(a[i].m[2]), b0, b1, b2, b3);
+
+		_mm256_storeu_ps(out[i].m[0], rows01);
+		_mm256_storeu_ps(out[i].m[2], rows23);
+	}
+}
+
+TARGET_AVX2 static void ComposeTransformsAVX2(const float3* translations, const float4* rotations, const float3* scales, float4x4* out, size_t count)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 zero = _mm256_setzero_ps();
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		// lanes 0-3 are transforms i to i + 3, lanes 4-7 are i + 4 to i + 7
+		const float4* q = rotations + i;
+		__m256 qx = LoadPair(&q[0].x, &q[4].x);
+		__m256 qy = LoadPair(&q[1].x, &q[5].x);
+		__m256 qz = LoadPair(&q[2].x, &q[6].x);
+		__m256 qw = LoadPair(&q[3].x, &q[7].x);
+		Transpose4x2(qx, qy, qz, qw);
+
+		const float3* s = scales + i;
+		const float3* t = translations + i;
+		const __m256 sx = _mm256_setr_ps(s[0].x, s[1].x, s[2].x, s[3].x, s[4].x, s[5].x, s[6].x, s[7].x);
+		const __m256 sy = _mm256_setr_ps(s[0].y, s[1].y, s[2].y, s[3].y, s[4].y, s[5].y, s[6].y, s[7].y);
+		const __m256 sz = _mm256_setr_ps(s[0].z, s[1].z, s[2].z, s[3].z, s[4].z, s[5].z, s[6].z, s[7].z);
+
+		const __m256 xx = _mm256_mul_ps(qx, qx);
+		const __m256 yy = _mm256_mul_ps(qy, qy);
+		const __m256 zz = _mm256_mul_ps(qz, qz);
+		const __m256 xy = _mm256_mul_ps(qx, qy);
+		const __m256 xz = _mm256_mul_ps(qx, qz);
+		const __m256 yz = _mm256_mul_ps(qy, qz);
+		const __m256 wx = _mm256_mul_ps(qw, qx);
+		const __m256 wy = _mm256_mul_ps(qw, qy);
+		const __m256 wz = _mm256_mul_ps(qw, qz);
+
+		__m256 rows[4][4] = {
+			{
+				_mm256_mul_ps(sx, _mm256_fnmadd_ps(two, _mm256_add_ps(yy, zz), one)),
+				_mm256_mul_ps(sx, _mm256_mul_ps(two, _mm256_add_ps(xy, wz))),
+				_mm256_mul_ps(sx, _mm256_mul_ps(two, _mm256_sub_ps(xz, wy))),
+				zero,
+			},
+			{
+				_mm256_mul_ps(sy, _mm256_mul_ps(two, _mm256_sub_ps(xy, wz))),
+				_mm256_mul_ps(sy, _mm256_fnmadd_ps(two, _mm256_add_ps(xx, zz), one)),
+				_mm256_mul_ps(sy, _mm256_mul_ps(two, _mm256_add_ps(yz, wx))),
+				zero,
+			},
+			{
+				_mm256_mul_ps(sz, _mm256_mul_ps(two, _mm256_add_ps(xz, wy))),
+				_mm256_mul_ps(sz, _mm256_mul_ps(two, _mm256_sub_ps(yz, wx))),
+				_mm256_mul_ps(sz, _mm256_fnmadd_ps(two, _mm256_add_ps(xx, yy), one)),
+				zero,
+			},
+			{
+				_mm256_setr_ps(t[0].x, t[1].x, t[2].x, t[3].x, t[4].x, t[5].x, t[6].x, t[7].x),
+				_mm256_setr_ps(t[0].y, t[1].y, t[2].y, t[3].y, t[4].y, t[5].y, t[6].y, t[7].y),
+				_mm256_setr_ps(t[0].z, t[1].z, t[2].z, t[3].z, t[4].z, t[5].z, t[6].z, t[7].z),
+				one,
+			},
+		};
+
+		for (u32 r = 0; r < 4; ++r) {
+			Transpose4x2(rows[r][0], rows[r][1], rows[r][2], rows[r][3]);
+			for (u32 k = 0; k < 4; ++k) {
+				_mm_storeu_ps(out[i + k].m[r], _mm256_castps256_ps128(rows[r][k]));
+				_mm_storeu_ps(out[i + k + 4].m[r], _mm256_extractf128_ps(rows[r][k], 1));
+			}
+		}
+	}
+
+	ComposeTransformsScalar(translations + i, rotations + i, scales + i, out + i, count - i);
+}
+
+TARGET_AVX2 static void TransformBoundsAVX2(const Bounds* in, const float4x4* matrices, Bounds* out, size_t count)
+{
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+	// two boxes at once, one per half
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		const Bounds& b0 = in[i];
+		const Bounds& b1 = in[i + 1];
+		const __m256 boundsMin = _mm256_setr_ps(b0.min.x, b0.min.y, b0.min.z, 0.0f, b1.min.x, b1.min.y, b1.min.z, 0.0f);
+		const __m256 boundsMax = _mm256_setr_ps(b0.max.x, b0.max.y, b0.max.z, 0.0f, b1.max.x, b1.max.y, b1.max.z, 0.0f);
+		const __m256 center = _mm256_mul_ps(_mm256_add_ps(boundsMin, boundsMax), half);
+		const __m256 extent = _mm256_mul_ps(_mm256_sub_ps(boundsMax, boundsMin), half);
+
+		const __m256 r0 = LoadPair(matrices[i].m[0], matrices[i + 1].m[0]);
+		const __m256 r1 = LoadPair(matrices[i].m[1], matrices[i + 1].m[1]);
+		const __m256 r2 = LoadPair(matrices[i].m[2], matrices[i + 1].m[2]);
+		const __m256 r3 = LoadPair(matrices[i].m[3], matrices[i + 1].m[3]);
+
+		__m256 newCenter = _mm256_fmadd_ps(_mm256_permute_ps(center, _MM_SHUFFLE(0, 0, 0, 0)), r0, r3);
+		newCenter = _mm256_fmadd_ps(_mm256_permute_ps(center, _MM_SHUFFLE(1, 1, 1, 1)), r1, newCenter);
+		newCenter = _mm256_fmadd_ps(_mm256_permute_ps(center, _MM_SHUFFLE(2, 2, 2, 2)), r2, newCenter);
+
+		__m256 newExtent = _mm256_mul_ps(_mm256_permute_ps(extent, _MM_SHUFFLE(0, 0, 0, 0)), _mm256_and_ps(r0, absMask));
+		newExtent = _mm256_fmadd_ps(_mm256_permute_ps(extent, _MM_SHUFFLE(1, 1, 1, 1)), _mm256_and_ps(r1, absMask), newExtent);
+		newExtent = _mm256_fmadd_ps(_mm256_permute_ps(extent, _MM_SHUFFLE(2, 2, 2, 2)), _mm256_and_ps(r2, absMask), newExtent);
+
+		alignas(32) f32 resultMin[8];
+		alignas(32) f32 resultMax[8];
+		_mm256_store_ps(resultMin, _mm256_sub_ps(newCenter, newExtent));
+		_mm256_store_ps(resultMax, _mm256_add_ps(newCenter, newExtent));
+		out[i].min = float3(resultMin[0], resultMin[1], resultMin[2]);
+		out[i].max = float3(resultMax[0], resultMax[1], resultMax[2]);
+		out[i + 1].min = float3(resultMin[4], resultMin[5], resultMin[6]);
+		out[i + 1].max = float3(resultMax[4], resultMax[5], resultMax[6]);
+	}
+
+	TransformBoundsScalar(in + i, matrices + i, out + i, count - i);
+}
+
+static constexpr Kernels s_kernels[] = {
+	{ TransformPointsScalar, TransformNormalsScalar, MultiplyMatricesScalar, ComposeTransformsScalar, TransformBoundsScalar },
+	{ TransformPointsSSE4, TransformNormalsSSE4, MultiplyMatricesSSE4, ComposeTransformsSSE4, TransformBoundsSSE4 },
+	{ TransformPointsAVX2, TransformNormalsAVX2, MultiplyMatricesAVX2, ComposeTransformsAVX2, TransformBoundsAVX2 },
+};
+static_assert(ARRLEN(s_kernels) == static_cast<size_t>(Isa::Count));
+
+static const Isa s_supportedIsa = DetectIsa();
+static Isa s_isa = s_supportedIsa;
+
+static const Kernels& CurrentKernels()
+{
+	return s_kernels[static_cast<u32>(s_isa)];
+}
+
+const char* MathBatch::IsaName(Isa isa)
+{
+	switch (isa) {
+	case Isa::Scalar: return "scalar";
+	case Isa::SSE4: return "sse4";
+	case Isa::AVX2: return "avx2";
+	default: UNREACHABLE("bad isa"); return "";
+	}
+}
+
+Isa MathBatch::GetSupportedIsa()
+{
+	return s_supportedIsa;
+}
+
+Isa MathBatch::GetIsa()
+{
+	return s_isa;
+}
+
+void MathBatch::SetIsa(Isa isa)
+{
+	s_isa = std::min(isa, s_supportedIsa);
+}
+
+void MathBatch::Pack(std::span<const float3> in, std::span<float3_soa> out)
+{
+	if (out.size() != PacketCount(static_cast<u32>(in.size()))) {
+		ENSURE(false, "Pack needs PacketCount(in.size()) packets");
+		return;
+	}
+
+	for (size_t i = 0; i < out.size() * float3_soa::Width; ++i) {
+		const float3& v = in[std::min(i, in.size() - 1)];
+		float3_soa& packet = out[i / float3_soa::Width];
+		packet.x[i % float3_soa::Width] = v.x;
+		packet.y[i % float3_soa::Width] = v.y;
+		packet.z[i % float3_soa::Width] = v.z;
+	}
+}
+
+void MathBatch::Unpack(std::span<const float3_soa> in, std::span<float3> out)
+{
+	if (in.size() != PacketCount(static_cast<u32>(out.size()))) {
+		ENSURE(false, "Unpack needs PacketCount(out.size()) packets");
+		return;
+	}
+
+	for (size_t i = 0; i < out.size(); ++i) {
+		const float3_soa& packet = in[i / float3_soa::Width];
+		out[i] = float3(packet.x[i % float3_soa::Width], packet.y[i % float3_soa::Width], packet.z[i % float3_soa::Width]);
+	}
+}
+
+void MathBatch::TransformPoints(const mat4& m, std::span<const float3_soa> in, std::span<float3_soa> out)
+{
+	if (in.size() != out.size()) {
+		ENSURE(false, "TransformPoints size mismatch");
+		return;
+	}
+
+	float4x4 matrix;
+	DirectX::XMStoreFloat4x4(&matrix, m);
+	CurrentKernels().transformPoints(matrix, in.data(), out.data(), in.size());
+}
+
+void MathBatch::TransformNormals(const mat4& m, std::span<const float3_soa> in, std::span<float3_soa> out)
+{
+	if (in.size() != out.size()) {
+		ENSURE(false, "TransformNormals size mismatch");
+		return;
+	}
+
+	float4x4 matrix;
+	DirectX::XMStoreFloat4x4(&matrix, m);
+	CurrentKernels().transformNormals(matrix, in.data(), out.data(), in.size());
+}
+
+void MathBatch::MultiplyMatrices(std::span<const float4x4> a, std::span<const float4x4> b, std::span<float4x4> out)
+{
+	if (a.size() != out.size() || b.size() != out.size()) {
+		ENSURE(false, "MultiplyMatrices size mismatch");
+		return;
+	}
+
+	CurrentKernels().multiplyMatrices(a.data(), b.data(), out.data(), out.size());
+}
+
+void MathBatch::ComposeTransforms(std::span<const float3> translations, std::span<const float4> rotations, std::span<const float3> scales, std::span<float4x4> out)
+{
+	if (translations.size() != out.size() || rotations.size() != out.size() || scales.size() != out.size()) {
+		ENSURE(false, "ComposeTransforms size mismatch");
+		return;
+	}
+
+	CurrentKernels().composeTransforms(translations.data(), rotations.data(), scales.data(), out.data(), out.size());
+}
+
+void MathBatch::TransformBounds(std::span<const Bounds> in, std::span<const float4x4> matrices, std::span<Bounds> out)
+{
+	if (in.size() != out.size() || matrices.size() != out.size()) {
+		ENSURE(false, "TransformBounds size mismatch");
+		return;
+	}
+
+	CurrentKernels().transformBounds(in.data(), matrices.data(), out.data(), out.size());
+}
+
+//
+// benchmark
+//
+
+template<typename Func>
+static f64 BestOf(u32 runs, Func&& func)
+{
+	f64 bestMs = std::numeric_limits<f64>::max();
+	for (u32 i = 0; i < runs; ++i) {
+		spdlog::stopwatch sw;
+		func();
+		bestMs = std::min(bestMs, sw.elapsed().count() * 1000.0);
+	}
+	return bestMs;
+}
+
+// relative past 1 so big coordinates dont need a bigger tolerance
+static f32 Error(f32 expected, f32 actual)
+{
+	return std::abs(expected - actual) / std::max(1.0f, std::abs(expected));
+}
+
+static f32 MaxError(std::span<const float3> expected, std::span<const float3> actual)
+{
+	f32 error = 0.0f;
+	for (size_t i = 0; i < expected.size(); ++i) {
+		error = std::max({ error, Error(expected[i].x, actual[i].x), Error(expected[i].y, actual[i].y), Error(expected[i].z, actual[i].z) });
+	}
+	return error;
+}
+
+static f32 MaxError(std::span<const float4x4> expected, std::span<const float4x4> actual)
+{
+	f32 error = 0.0f;
+	for (size_t i = 0; i < expected.size(); ++i) {
+		for (u32 r = 0; r < 4; ++r) {
+			for (u32 c = 0; c < 4; ++c) {
+				error = std::max(error, Error(expected[i].m[r][c], actual[i].m[r][c]));
+			}
+		}
+	}
+	return error;
+}
+
+static f32 MaxError(std::span<const Bounds> expected, std::span<const Bounds> actual)
+{
+	f32 error = 0.0f;
+	for (size_t i = 0; i < expected.size(); ++i) {
+		const float3 e[2] = { expected[i].min, expected[i].max };
+		const float3 a[2] = { actual[i].min, actual[i].max };
+		error = std::max(error, MaxError(e, a));
+	}
+	return error;
+}
+
+bool MathBatch::RunBenchmark()
+{
+	constexpr u32 pointCount = 1 << 20;
+	constexpr u32 transformCount = 1 << 18;
+	constexpr u32 runs = 10;
+	// fma and a different order of operations, with some cancellation thats more than a few ulp
+	// a wrong element or lane is off by far more
+	constexpr f32 tolerance = 1e-4f;
+
+	// fixed seed so runs are comparable
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<f32> randomPosition(-100.0f, 100.0f);
+	std::uniform_real_distribution<f32> randomUnit(-1.0f, 1.0f);
+	std::uniform_real_distribution<f32> randomScale(0.5f, 2.0f);
+
+	std::vector<float3> translations(transformCount);
+	std::vector<float4> rotations(transformCount);
+	std::vector<float3> scales(transformCount);
+	std::vector<float4x4> matrices(transformCount);
+	for (u32 i = 0; i < transformCount; ++i) {
+		translations[i] = float3(randomPosition(rng), randomPosition(rng), randomPosition(rng));
+		DirectX::XMStoreFloat4(&rotations[i], DirectX::XMQuaternionNormalize(DirectX::XMVectorSet(randomUnit(rng), randomUnit(rng), randomUnit(rng), randomUnit(rng))));
+		scales[i] = float3(randomScale(rng), randomScale(rng), randomScale(rng));
+		DirectX::XMStoreFloat4x4(&matrices[i], DirectX::XMMatrixAffineTransformation(
+			DirectX::XMLoadFloat3(&scales[i]), DirectX::XMVectorZero(), DirectX::XMLoadFloat4(&rotations[i]), DirectX::XMLoadFloat3(&translations[i])));
+	}
+
+	std::vector<float3> points(pointCount);
+	std::vector<float3> normals(pointCount);
+	for (u32 i = 0; i < pointCount; ++i) {
+		points[i] = float3(randomPosition(rng), randomPosition(rng), randomPosition(rng));
+		DirectX::XMStoreFloat3(&normals[i], DirectX::XMVector3Normalize(DirectX::XMVectorSet(randomUnit(rng), randomUnit(rng), randomUnit(rng), 0.0f)));
+	}
+
+	std::vector<Bounds> bounds(transformCount);
+	for (Bounds& b : bounds) {
+		const float3 center(randomPosition(rng), randomPosition(rng), randomPosition(rng));
+		const float3 extent(randomScale(rng), randomScale(rng), randomScale(rng));
+		b.min = float3(center.x - extent.x, center.y - extent.y, center.z - extent.z);
+		b.max = float3(center.x + extent.x, center.y + extent.y, center.z + extent.z);
+	}
+
+	std::vector<float3_soa> pointPackets(PacketCount(pointCount));
+	std::vector<float3_soa> normalPackets(PacketCount(pointCount));
+	std::vector<float3_soa> packetsOut(PacketCount(pointCount));
+	Pack(points, pointPackets);
+	Pack(normals, normalPackets);
+
+	const mat4 pointMatrix = DirectX::XMLoadFloat4x4(&matrices[0]);
+	const mat4 normalMatrix = DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(nullptr, pointMatrix));
+
+	std::vector<float3> expected3(pointCount);
+	std::vector<float3> actual3(pointCount);
+	std::vector<float4x4> expectedMatrices(transformCount);
+	std::vector<float4x4> actualMatrices(transformCount);
+	std::vector<Bounds> expectedBounds(transformCount);
+	std::vector<Bounds> actualBounds(transformCount);
+
+	const Isa previousIsa = GetIsa();
+
+	spdlog::info("batch math benchmark, cpu supports {}, best of {} runs", IsaName(GetSupportedIsa()), runs);
+
+	bool passed = true;
+
+	// the directxmath loop is the baseline, then every isa runs the same kernel
+	auto report = [&](const char* name, u32 count, f64 baselineMs, auto&& runKernel, auto&& error) {
+		spdlog::info("{}, {} items: directxmath {:.3f} ms", name, count, baselineMs);
+		for (u32 isa = 0; isa <= static_cast<u32>(GetSupportedIsa()); ++isa) {
+			SetIsa(static_cast<Isa>(isa));
+			const f64 ms = BestOf(runs, runKernel);
+			const f32 maxError = error();
+			spdlog::info("    {:<6} {:.3f} ms, {:.2f}x, max error {:.2e}, {}",
+				IsaName(static_cast<Isa>(isa)), ms, baselineMs / ms, maxError, maxError <= tolerance ? "matches" : "MISMATCH");
+			passed &= maxError <= tolerance;
+		}
+	};
+
+	{
+		const f64 baselineMs = BestOf(runs, [&]() {
+			for (u32 i = 0; i < pointCount; ++i) {
+				DirectX::XMStoreFloat3(&expected3[i], DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&points[i]), pointMatrix));
+			}
+		});
+		report("TransformPoints", pointCount, baselineMs,
+			[&]() { TransformPoints(pointMatrix, pointPackets, packetsOut); },
+			[&]() { Unpack(packetsOut, actual3); return MaxError(expected3, actual3); });
+	}
+
+	{
+		const f64 baselineMs = BestOf(runs, [&]() {
+			for (u32 i = 0; i < pointCount; ++i) {
+				DirectX::XMStoreFloat3(&expected3[i], DirectX::XMVector3Normalize(DirectX::XMVector3TransformNormal(DirectX::XMLoadFloat3(&normals[i]), normalMatrix)));
+			}
+		});
+		report("TransformNormals", pointCount, baselineMs,
+			[&]() { TransformNormals(normalMatrix, normalPackets, packetsOut); },
+			[&]() { Unpack(packetsOut, actual3); return MaxError(expected3, actual3); });
+	}
+
+	{
+		// every matrix times its neighbour, like local to parent
+		const std::span<const float4x4> a(matrices.data(), transformCount - 1);
+		const std::span<const float4x4> b(matrices.data() + 1, transformCount - 1);
+		const std::span<float4x4> expected(expectedMatrices.data(), transformCount - 1);
+		const std::span<float4x4> actual(actualMatrices.data(), transformCount - 1);
+
+		const f64 baselineMs = BestOf(runs, [&]() {
+			for (u32 i = 0; i < transformCount - 1; ++i) {
+				DirectX::XMStoreFloat4x4(&expected[i], DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&a[i]), DirectX::XMLoadFloat4x4(&b[i])));
+			}
+		});
+		report("MultiplyMatrices", transformCount - 1, baselineMs,
+			[&]() { MultiplyMatrices(a, b, actual); },
+			[&]() { return MaxError(expected, actual); });
+	}
+
+	{
+		const f64 baselineMs = BestOf(runs, [&]() {
+			for (u32 i = 0; i < transformCount; ++i) {
+				DirectX::XMStoreFloat4x4(&expectedMatrices[i], DirectX::XMMatrixAffineTransformation(
+					DirectX::XMLoadFloat3(&scales[i]), DirectX::XMVectorZero(), DirectX::XMLoadFloat4(&rotations[i]), DirectX::XMLoadFloat3(&translations[i])));
+			}
+		});
+		report("ComposeTransforms", transformCount, baselineMs,
+			[&]() { ComposeTransforms(translations, rotations, scales, actualMatrices); },
+			[&]() { return MaxError(expectedMatrices, actualMatrices); });
+	}
+
+	{
+		// the usual way, all 8 corners through the matrix
+		const f64 baselineMs = BestOf(runs, [&]() {
+			for (u32 i = 0; i < transformCount; ++i) {
+				const mat4 m = DirectX::XMLoadFloat4x4(&matrices[i]);
+				vec4 newMin = DirectX::g_XMFltMax;
+				vec4 newMax = DirectX::XMVectorNegate(DirectX::g_XMFltMax);
+				for (u32 corner = 0; corner < 8; ++corner) {
+					const vec4 p = DirectX::XMVectorSet(
+						(corner & 1) ? bounds[i].max.x : bounds[i].min.x,
+						(corner & 2) ? bounds[i].max.y : bounds[i].min.y,
+						(corner & 4) ? bounds[i].max.z : bounds[i].min.z,
+						1.0f);
+					const vec4 transformed = DirectX::XMVector3Transform(p, m);
+					newMin = DirectX::XMVectorMin(newMin, transformed);
+					newMax = DirectX::XMVectorMax(newMax, transformed);
+				}
+				DirectX::XMStoreFloat3(&expectedBounds[i].min, newMin);
+				DirectX::XMStoreFloat3(&expectedBounds[i].max, newMax);
+			}
+		});
+		report("TransformBounds", transformCount, baselineMs,
+			[&]() { TransformBounds(bounds, matrices, actualBounds); },
+			[&]() { return MaxError(expectedBounds, actualBounds); });
+	}
+
+	SetIsa(previousIsa);
+
+	spdlog::info("batch math checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
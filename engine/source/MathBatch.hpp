@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "Math.hpp"
+
+#include <span>
+
+// math over whole arrays at once instead of one XMVECTOR at a time, for per vertex and per entity work
+// every kernel has a scalar, sse4.1 and avx2 (with fma) version, the best one the cpu has is picked at startup
+//
+// points and normals are float3_soa packets, Pack and Unpack convert from plain float3 arrays,
+// a partial last packet is padded with copies of the last element
+// matrices are row vector like the rest of the engine, p' = p * m
+//
+// in and out can be the same span, spans of different lengths are an error
+namespace MathBatch
+{
+	enum class Isa : u8 {
+		Scalar,
+		SSE4,
+		AVX2,
+		Count,
+	};
+
+	const char* IsaName(Isa isa);
+
+	// best the cpu and os support
+	Isa GetSupportedIsa();
+	// what the kernels run with
+	Isa GetIsa();
+	// clamped to GetSupportedIsa, for the benchmark and for checking the paths against each other
+	// not thread safe, dont call while kernels are running
+	void SetIsa(Isa isa);
+
+	inline u32 PacketCount(u32 count) { return (count + float3_soa::Width - 1) / float3_soa::Width; }
+
+	// out needs PacketCount(in.size()) packets
+	void Pack(std::span<const float3> in, std::span<float3_soa> out);
+	// the padding in the last packet is dropped
+	void Unpack(std::span<const float3_soa> in, std::span<float3> out);
+
+	// (p, 1) * m, m is expected to be affine, the w column is ignored
+	void TransformPoints(const mat4& m, std::span<const float3_soa> in, std::span<float3_soa> out);
+	// normalize(n * m) with the upper 3x3 only, pass the inverse transpose when m has non uniform scale
+	void TransformNormals(const mat4& m, std::span<const float3_soa> in, std::span<float3_soa> out);
+
+	// out[i] = a[i] * b[i]
+	void MultiplyMatrices(std::span<const float4x4> a, std::span<const float4x4> b, std::span<float4x4> out);
+	// out[i] = scale * rotation * translation, rotations are quaternions (x, y, z, w)
+	// same as XMMatrixAffineTransformation with a zero origin
+	void ComposeTransforms(std::span<const float3> translations, std::span<const float4> rotations, std::span<const float3> scales, std::span<float4x4> out);
+	// out[i] = the box around in[i] transformed by matrices[i], affine matrices only
+	void TransformBounds(std::span<const Bounds> in, std::span<const float4x4> matrices, std::span<Bounds> out);
+
+	// every kernel on every supported isa against a plain DirectXMath loop, checks the results match
+	bool RunBenchmark();
+}
@@ -0,0 +1,1703 @@
+#include "MeshCompression.hpp"
+
+#include "Core/JobSystem.hpp"
+#include "Core/Profiler.hpp"
+
+#include <cgltf/cgltf.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <random>
+#include <string>
+#include <type_traits>
+
+using namespace MeshCompression;
+
+// the high nibble of the first byte is the codec, the low one its version
+static constexpr u8 s_vertexHeader = 0xa0;
+static constexpr u8 s_indexHeader = 0xe0;
+static constexpr u8 s_sequenceHeader = 0xd0;
+static constexpr u8 s_vertexVersion = 0;
+static constexpr u8 s_indexVersion = 1;
+static constexpr u8 s_sequenceVersion = 1;
+
+// vertex streams are split into blocks that fit 8 KB, every byte of a vertex is a stream of deltas
+// in groups of 16, each group packed to 0 2 4 or 8 bits per delta
+static constexpr u32 ByteGroupSize = 16;
+static constexpr u32 VertexBlockSizeBytes = 8192;
+static constexpr u32 VertexBlockMaxSize = 256;
+// the first vertex sits at the end of the stream padded to this, which also means a group never reads
+// past the end, so the decoder only checks this much is left before each one
+static constexpr u32 TailMaxSize = 32;
+static constexpr u32 ByteGroupDecodeLimit = 24;
+// what the triangle codec puts at the end, a table of the most common pairs of vertex fifo codes
+static constexpr u8 s_codeAuxTable[16] = {
+	0x00, 0x76, 0x87, 0x56, 0x67, 0x78, 0xa9, 0x86, 0x65, 0x89, 0x68, 0x98, 0x01, 0x69,
+	// never used by the encoder, pad to 16
+	0x00, 0x00,
+};
+
+//
+// vertex codec
+//
+
+static inline u32 VertexBlockSize(u32 stride)
+{
+	return std::min((VertexBlockSizeBytes / stride) & ~(ByteGroupSize - 1), VertexBlockMaxSize);
+}
+
+static inline u8 ZigZag8(u8 v)
+{
+	return static_cast<u8>((v << 1) ^ static_cast<u8>(static_cast<i8>(v) >> 7));
+}
+
+static inline u8 UnZigZag8(u8 v)
+{
+	return static_cast<u8>((0u - (v & 1)) ^ (v >> 1));
+}
+
+// Bits of every delta, all ones means the delta didnt fit and is a whole byte after the packed ones
+template<u32 Bits>
+static const u8* DecodeBitsGroup(const u8* data, u8* out)
+{
+	constexpr u32 perByte = 8 / Bits;
+	constexpr u8 sentinel = (1u << Bits) - 1;
+
+	const u8* escapes = data + ByteGroupSize / perByte;
+	for (u32 i = 0; i < ByteGroupSize; i += perByte) {
+		u32 byte = *data++;
+		for (u32 k = 0; k < perByte; ++k) {
+			const u8 value = static_cast<u8>((byte >> (8 - Bits)) & sentinel);
+			byte <<= Bits;
+			out[i + k] = value == sentinel ? *escapes : value;
+			escapes += value == sentinel;
+		}
+	}
+	return escapes;
+}
+
+static const u8* DecodeBytes(const u8* data, const u8* end, u8* out, u32 size)
+{
+	// 2 bits per group
+	const u8* header = data;
+	const u32 headerSize = (size / ByteGroupSize + 3) / 4;
+	if (static_cast<size_t>(end - data) < headerSize) {
+		return nullptr;
+	}
+	data += headerSize;
+
+	for (u32 i = 0; i < size; i += ByteGroupSize) {
+		if (static_cast<size_t>(end - data) < ByteGroupDecodeLimit) {
+			return nullptr;
+		}
+
+		const u32 group = i / ByteGroupSize;
+		switch ((header[group / 4] >> ((group % 4) * 2)) & 3) {
+		case 0:
+			memset(out + i, 0, ByteGroupSize);
+			break;
+		case 1:
+			data = DecodeBitsGroup<2>(data, out + i);
+			break;
+		case 2:
+			data = DecodeBitsGroup<4>(data, out + i);
+			break;
+		default:
+			memcpy(out + i, data, ByteGroupSize);
+			data += ByteGroupSize;
+			break;
+		}
+	}
+	return data;
+}
+
+bool MeshCompression::DecodeVertexBuffer(void* out, u32 count, u32 stride, std::span<const u8> encoded)
+{
+	if (stride == 0 || stride > 256 || stride % 4 != 0) {
+		return false;
+	}
+	if (encoded.size() < 1 + stride) {
+		return false;
+	}
+	if ((encoded[0] & 0xf0) != s_vertexHeader || (encoded[0] & 0x0f) > s_vertexVersion) {
+		return false;
+	}
+
+	const u8* data = encoded.data() + 1;
+	const u8* end = encoded.data() + encoded.size();
+	u8* vertices = static_cast<u8*>(out);
+
+	// every delta chain starts at the first vertex
+	u8 lastVertex[256];
+	memcpy(lastVertex, end - stride, stride);
+
+	const u32 blockSize = VertexBlockSize(stride);
+	u8 deltas[VertexBlockMaxSize];
+
+	for (u32 first = 0; first < count; first += blockSize) {
+		const u32 blockCount = std::min(blockSize, count - first);
+		const u32 alignedCount = (blockCount + ByteGroupSize - 1) & ~(ByteGroupSize - 1);
+
+		for (u32 k = 0; k < stride; ++k) {
+			data = DecodeBytes(data, end, deltas, alignedCount);
+			if (data == nullptr) {
+				return false;
+			}
+
+			u8* vertex = vertices + static_cast<size_t>(first) * stride + k;
+			u8 previous = lastVertex[k];
+			for (u32 i = 0; i < blockCount; ++i) {
+				previous = static_cast<u8>(previous + UnZigZag8(deltas[i]));
+				*vertex = previous;
+				vertex += stride;
+			}
+			lastVertex[k] = previous;
+		}
+	}
+
+	return static_cast<size_t>(end - data) == std::max(stride, TailMaxSize);
+}
+
+static void EncodeBytes(const u8* deltas, u32 size, Data<u8>& out)
+{
+	const size_t header = out.size();
+	out.resize(out.size() + (size / ByteGroupSize + 3) / 4, 0);
+
+	for (u32 i = 0; i < size; i += ByteGroupSize) {
+		const u8* group = deltas + i;
+
+		// the smallest of the 4 sizes, 0 bits only when every delta is 0
+		u32 escapes2 = 0;
+		u32 escapes4 = 0;
+		bool zero = true;
+		for (u32 k = 0; k < ByteGroupSize; ++k) {
+			escapes2 += group[k] >= 3;
+			escapes4 += group[k] >= 15;
+			zero &= group[k] == 0;
+		}
+		const u32 size2 = 4 + escapes2;
+		const u32 size4 = 8 + escapes4;
+		const u32 bitsLog2 = zero ? 0 : (size2 <= size4 && size2 < ByteGroupSize) ? 1 : size4 < ByteGroupSize ? 2 : 3;
+
+		const u32 index = i / ByteGroupSize;
+		out[header + index / 4] |= static_cast<u8>(bitsLog2 << ((index % 4) * 2));
+
+		if (bitsLog2 == 3) {
+			out.insert(out.end(), group, group + ByteGroupSize);
+		} else if (bitsLog2 != 0) {
+			const u32 bits = 1u << bitsLog2;
+			const u32 perByte = 8 / bits;
+			const u8 sentinel = static_cast<u8>((1u << bits) - 1);
+			for (u32 k = 0; k < ByteGroupSize; k += perByte) {
+				u32 byte = 0;
+				for (u32 j = 0; j < perByte; ++j) {
+					byte = (byte << bits) | std::min(group[k + j], sentinel);
+				}
+				out.push_back(static_cast<u8>(byte));
+			}
+			for (u32 k = 0; k < ByteGroupSize; ++k) {
+				if (group[k] >= sentinel) {
+					out.push_back(group[k]);
+				}
+			}
+		}
+	}
+}
+
+void MeshCompression::EncodeVertexBuffer(const void* vertices, u32 count, u32 stride, Data<u8>& out)
+{
+	ENSURE(stride > 0 && stride <= 256 && stride % 4 == 0, "EncodeVertexBuffer needs a stride that is a multiple of 4 up to 256");
+
+	const u8* source = static_cast<const u8*>(vertices);
+	out.clear();
+	out.push_back(s_vertexHeader | s_vertexVersion);
+
+	u8 firstVertex[256] = {};
+	if (count > 0) {
+		memcpy(firstVertex, source, stride);
+	}
+	u8 lastVertex[256];
+	memcpy(lastVertex, firstVertex, stride);
+
+	const u32 blockSize = VertexBlockSize(stride);
+	u8 deltas[VertexBlockMaxSize];
+
+	for (u32 first = 0; first < count; first += blockSize) {
+		const u32 blockCount = std::min(blockSize, count - first);
+		const u32 alignedCount = (blockCount + ByteGroupSize - 1) & ~(ByteGroupSize - 1);
+
+		for (u32 k = 0; k < stride; ++k) {
+			const u8* vertex = source + static_cast<size_t>(first) * stride + k;
+			u8 previous = lastVertex[k];
+			for (u32 i = 0; i < blockCount; ++i) {
+				deltas[i] = ZigZag8(static_cast<u8>(*vertex - previous));
+				previous = *vertex;
+				vertex += stride;
+			}
+			memset(deltas + blockCount, 0, alignedCount - blockCount);
+			lastVertex[k] = previous;
+
+			EncodeBytes(deltas, alignedCount, out);
+		}
+	}
+
+	if (stride < TailMaxSize) {
+		out.resize(out.size() + TailMaxSize - stride, 0);
+	}
+	out.insert(out.end(), firstVertex, firstVertex + stride);
+}
+
+//
+// index codecs
+//
+
+// the last 16 edges and vertices, triangles refer back into them instead of spelling out indices
+using EdgeFifo = u32[16][2];
+using VertexFifo = u32[16];
+
+static inline void PushEdge(EdgeFifo& fifo, u32 a, u32 b, u32& offset)
+{
+	fifo[offset][0] = a;
+	fifo[offset][1] = b;
+	offset = (offset + 1) & 15;
+}
+
+static inline void PushVertex(VertexFifo& fifo, u32 v, u32& offset, u32 advance = 1)
+{
+	fifo[offset] = v;
+	offset = (offset + advance) & 15;
+}
+
+// how far back the edge is times 4, plus which rotation of the triangle starts with it, -1 if its not there
+static i32 FindEdge(const EdgeFifo& fifo, u32 a, u32 b, u32 c, u32 offset)
+{
+	for (u32 i = 0; i < 16; ++i) {
+		const u32 index = (offset - 1 - i) & 15;
+		const u32 e0 = fifo[index][0];
+		const u32 e1 = fifo[index][1];
+		if (e0 == a && e1 == b) {
+			return static_cast<i32>(i << 2) | 0;
+		}
+		if (e0 == b && e1 == c) {
+			return static_cast<i32>(i << 2) | 1;
+		}
+		if (e0 == c && e1 == a) {
+			return static_cast<i32>(i << 2) | 2;
+		}
+	}
+	return -1;
+}
+
+static i32 FindVertex(const VertexFifo& fifo, u32 v, u32 offset)
+{
+	for (u32 i = 0; i < 16; ++i) {
+		if (fifo[(offset - 1 - i) & 15] == v) {
+			return static_cast<i32>(i);
+		}
+	}
+	return -1;
+}
+
+static inline void EncodeVByte(Data<u8>& out, u32 v)
+{
+	while (v >= 128) {
+		out.push_back(static_cast<u8>((v & 127) | 128));
+		v >>= 7;
+	}
+	out.push_back(static_cast<u8>(v));
+}
+
+static inline u32 DecodeVByte(const u8*& data)
+{
+	const u8 lead = *data++;
+	if (lead < 128) {
+		return lead;
+	}
+
+	u32 result = lead & 127;
+	u32 shift = 7;
+	for (u32 i = 0; i < 4; ++i) {
+		const u8 group = *data++;
+		result |= static_cast<u32>(group & 127) << shift;
+		shift += 7;
+		if (group < 128) {
+			break;
+		}
+	}
+	return result;
+}
+
+// free indices are zigzagged deltas from the previous one
+static inline void EncodeIndex(Data<u8>& out, u32 v, u32 last)
+{
+	const u32 delta = v - last;
+	EncodeVByte(out, (delta << 1) ^ static_cast<u32>(static_cast<i32>(delta) >> 31));
+}
+
+static inline u32 DecodeIndex(const u8*& data, u32 last)
+{
+	const u32 v = DecodeVByte(data);
+	return last + ((v >> 1) ^ (0u - (v & 1)));
+}
+
+static inline void WriteIndex(void* out, u32 i, u32 indexSize, u32 index)
+{
+	if (indexSize == 2) {
+		static_cast<u16*>(out)[i] = static_cast<u16>(index);
+	} else {
+		static_cast<u32*>(out)[i] = index;
+	}
+}
+
+static inline void WriteTriangle(void* out, u32 i, u32 indexSize, u32 a, u32 b, u32 c)
+{
+	WriteIndex(out, i + 0, indexSize, a);
+	WriteIndex(out, i + 1, indexSize, b);
+	WriteIndex(out, i + 2, indexSize, c);
+}
+
+bool MeshCompression::DecodeIndexBuffer(void* out, u32 count, u32 indexSize, std::span<const u8> encoded)
+{
+	if (count % 3 != 0 || (indexSize != 2 && indexSize != 4)) {
+		return false;
+	}
+	// the header, a code per triangle and the table at the end
+	if (encoded.size() < 1 + count / 3 + 16) {
+		return false;
+	}
+	if ((encoded[0] & 0xf0) != s_indexHeader || (encoded[0] & 0x0f) > s_indexVersion) {
+		return false;
+	}
+
+	// version 0 has no codes for the previous free index plus or minus 1
+	const u32 fecMax = (encoded[0] & 0x0f) >= 1 ? 13 : 15;
+
+	EdgeFifo edges;
+	VertexFifo vertices;
+	memset(edges, 0xff, sizeof(edges));
+	memset(vertices, 0xff, sizeof(vertices));
+	u32 edgeOffset = 0;
+	u32 vertexOffset = 0;
+
+	// next is the lowest vertex not seen yet, last the previous free index
+	u32 next = 0;
+	u32 last = 0;
+
+	const u8* code = encoded.data() + 1;
+	const u8* data = code + count / 3;
+	// a triangle reads at most 16 bytes past data, an aux byte and 3 varints, the table is that padding
+	const u8* dataSafeEnd = encoded.data() + encoded.size() - 16;
+	const u8* codeAux = dataSafeEnd;
+
+	for (u32 i = 0; i < count; i += 3) {
+		if (data > dataSafeEnd) {
+			return false;
+		}
+
+		const u8 codeTri = *code++;
+
+		if (codeTri < 0xf0) {
+			// shares an edge with a recent triangle, the third vertex is in the fifo, new or free
+			const u32 fe = codeTri >> 4;
+			const u32 a = edges[(edgeOffset - 1 - fe) & 15][0];
+			const u32 b = edges[(edgeOffset - 1 - fe) & 15][1];
+			const u32 fec = codeTri & 15;
+
+			u32 c;
+			if (fec < fecMax) {
+				c = fec == 0 ? next : vertices[(vertexOffset - 1 - fec) & 15];
+				next += fec == 0;
+				PushVertex(vertices, c, vertexOffset, fec == 0);
+			} else {
+				// 13 and 14 are the previous free index minus and plus 1
+				c = fec == 15 ? DecodeIndex(data, last) : fec == 13 ? last - 1 : last + 1;
+				last = c;
+				PushVertex(vertices, c, vertexOffset);
+			}
+
+			WriteTriangle(out, i, indexSize, a, b, c);
+			PushEdge(edges, c, b, edgeOffset);
+			PushEdge(edges, a, c, edgeOffset);
+		} else if (codeTri < 0xfe) {
+			// a is the next new vertex, b and c a pair of fifo codes from the table
+			const u8 aux = codeAux[codeTri & 15];
+			const u32 feb = aux >> 4;
+			const u32 fec = aux & 15;
+
+			const u32 a = next++;
+			const u32 b = feb == 0 ? next : vertices[(vertexOffset - feb) & 15];
+			next += feb == 0;
+			const u32 c = fec == 0 ? next : vertices[(vertexOffset - fec) & 15];
+			next += fec == 0;
+
+			WriteTriangle(out, i, indexSize, a, b, c);
+			PushVertex(vertices, a, vertexOffset);
+			PushVertex(vertices, b, vertexOffset, feb == 0);
+			PushVertex(vertices, c, vertexOffset, fec == 0);
+			PushEdge(edges, b, a, edgeOffset);
+			PushEdge(edges, c, b, edgeOffset);
+			PushEdge(edges, a, c, edgeOffset);
+		} else {
+			// the same with the codes in a byte of their own, 15 is a free index and an aux byte of 0
+			// restarts next
+			const u8 aux = *data++;
+			const u32 fea = codeTri == 0xfe ? 0 : 15;
+			const u32 feb = aux >> 4;
+			const u32 fec = aux & 15;
+
+			if (aux == 0) {
+				next = 0;
+			}
+
+			u32 a = fea == 0 ? next++ : 0;
+			u32 b = feb == 0 ? next++ : vertices[(vertexOffset - feb) & 15];
+			u32 c = fec == 0 ? next++ : vertices[(vertexOffset - fec) & 15];
+
+			if (fea == 15) {
+				last = a = DecodeIndex(data, last);
+			}
+			if (feb == 15) {
+				last = b = DecodeIndex(data, last);
+			}
+			if (fec == 15) {
+				last = c = DecodeIndex(data, last);
+			}
+
+			WriteTriangle(out, i, indexSize, a, b, c);
+			PushVertex(vertices, a, vertexOffset);
+			PushVertex(vertices, b, vertexOffset, feb == 0 || feb == 15);
+			PushVertex(vertices, c, vertexOffset, fec == 0 || fec == 15);
+			PushEdge(edges, b, a, edgeOffset);
+			PushEdge(edges, c, b, edgeOffset);
+			PushEdge(edges, a, c, edgeOffset);
+		}
+	}
+
+	return data == dataSafeEnd;
+}
+
+void MeshCompression::EncodeIndexBuffer(std::span<const u32> indices, Data<u8>& out)
+{
+	ENSURE(indices.size() % 3 == 0, "EncodeIndexBuffer needs whole triangles");
+
+	// rotations of a triangle, the one that puts the matched edge or the next vertex first
+	static constexpr u32 rotations[3][3] = { { 0, 1, 2 }, { 1, 2, 0 }, { 2, 0, 1 } };
+	constexpr u32 fecMax = 13;
+
+	EdgeFifo edges;
+	VertexFifo vertices;
+	memset(edges, 0xff, sizeof(edges));
+	memset(vertices, 0xff, sizeof(vertices));
+	u32 edgeOffset = 0;
+	u32 vertexOffset = 0;
+	u32 next = 0;
+	u32 last = 0;
+
+	Data<u8> codes;
+	Data<u8> data;
+	codes.reserve(indices.size() / 3);
+
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		const u32* triangle = &indices[i];
+		const i32 fer = FindEdge(edges, triangle[0], triangle[1], triangle[2], edgeOffset);
+
+		if (fer >= 0 && (fer >> 2) < 15) {
+			const u32* order = rotations[fer & 3];
+			const u32 a = triangle[order[0]];
+			const u32 b = triangle[order[1]];
+			const u32 c = triangle[order[2]];
+
+			const i32 fc = FindVertex(vertices, c, vertexOffset);
+			u32 fec;
+			if (fc >= 1 && fc < static_cast<i32>(fecMax)) {
+				fec = static_cast<u32>(fc);
+			} else if (c == next) {
+				fec = 0;
+				++next;
+			} else if (c + 1 == last) {
+				fec = 13;
+			} else if (c == last + 1) {
+				fec = 14;
+			} else {
+				fec = 15;
+				EncodeIndex(data, c, last);
+			}
+			if (fec >= fecMax) {
+				last = c;
+			}
+
+			codes.push_back(static_cast<u8>(((fer >> 2) << 4) | fec));
+
+			if (fec == 0 || fec >= fecMax) {
+				PushVertex(vertices, c, vertexOffset);
+			}
+			PushEdge(edges, c, b, edgeOffset);
+			PushEdge(edges, a, c, edgeOffset);
+		} else {
+			const u32 rotation = triangle[1] == next ? 1 : triangle[2] == next ? 2 : 0;
+			const u32* order = rotations[rotation];
+			const u32 a = triangle[order[0]];
+			const u32 b = triangle[order[1]];
+			const u32 c = triangle[order[2]];
+
+			// 0 1 2 after other vertices starts over, the fifo is cleared so nothing refers to before
+			const bool restart = a == 0 && b == 1 && c == 2 && next > 0;
+			if (restart) {
+				next = 0;
+				memset(vertices, 0xff, sizeof(vertices));
+			}
+
+			const i32 fb = FindVertex(vertices, b, vertexOffset);
+			const i32 fc = FindVertex(vertices, c, vertexOffset);
+
+			// after the rotation a is nearly always the next vertex, it gets no fifo code
+			u32 fea = 15;
+			if (a == next) {
+				fea = 0;
+				++next;
+			}
+			u32 feb = 15;
+			if (fb >= 0 && fb < 14) {
+				feb = static_cast<u32>(fb) + 1;
+			} else if (b == next) {
+				feb = 0;
+				++next;
+			}
+			u32 fec = 15;
+			if (fc >= 0 && fc < 14) {
+				fec = static_cast<u32>(fc) + 1;
+			} else if (c == next) {
+				fec = 0;
+				++next;
+			}
+
+			const u8 aux = static_cast<u8>((feb << 4) | fec);
+			const u8* entry = std::find(s_codeAuxTable, s_codeAuxTable + 14, aux);
+			if (fea == 0 && entry != s_codeAuxTable + 14 && !restart) {
+				codes.push_back(static_cast<u8>(0xf0 | (entry - s_codeAuxTable)));
+			} else {
+				codes.push_back(static_cast<u8>(0xfe | (fea == 15)));
+				data.push_back(aux);
+			}
+
+			if (fea == 15) {
+				EncodeIndex(data, a, last);
+				last = a;
+			}
+			if (feb == 15) {
+				EncodeIndex(data, b, last);
+				last = b;
+			}
+			if (fec == 15) {
+				EncodeIndex(data, c, last);
+				last = c;
+			}
+
+			PushVertex(vertices, a, vertexOffset);
+			if (feb == 0 || feb == 15) {
+				PushVertex(vertices, b, vertexOffset);
+			}
+			if (fec == 0 || fec == 15) {
+				PushVertex(vertices, c, vertexOffset);
+			}
+			PushEdge(edges, b, a, edgeOffset);
+			PushEdge(edges, c, b, edgeOffset);
+			PushEdge(edges, a, c, edgeOffset);
+		}
+	}
+
+	out.clear();
+	out.reserve(1 + codes.size() + data.size() + 16);
+	out.push_back(s_indexHeader | s_indexVersion);
+	out.insert(out.end(), codes.begin(), codes.end());
+	out.insert(out.end(), data.begin(), data.end());
+	out.insert(out.end(), s_codeAuxTable, s_codeAuxTable + 16);
+}
+
+bool MeshCompression::DecodeIndexSequence(void* out, u32 count, u32 indexSize, std::span<const u8> encoded)
+{
+	if (indexSize != 2 && indexSize != 4) {
+		return false;
+	}
+	// the header, a byte per index and the 4 byte tail at least
+	if (encoded.size() < 1 + static_cast<size_t>(count) + 4) {
+		return false;
+	}
+	if ((encoded[0] & 0xf0) != s_sequenceHeader || (encoded[0] & 0x0f) > s_sequenceVersion) {
+		return false;
+	}
+
+	const u8* data = encoded.data() + 1;
+	// a varint is at most 5 bytes, the tail is the other 4
+	const u8* dataSafeEnd = encoded.data() + encoded.size() - 4;
+
+	// two baselines, the low bit of each value says which one the delta is from
+	u32 last[2] = {};
+	for (u32 i = 0; i < count; ++i) {
+		if (data >= dataSafeEnd) {
+			return false;
+		}
+
+		const u32 v = DecodeVByte(data);
+		const u32 baseline = v & 1;
+		const u32 delta = v >> 1;
+		const u32 index = last[baseline] + ((delta >> 1) ^ (0u - (delta & 1)));
+		last[baseline] = index;
+
+		WriteIndex(out, i, indexSize, index);
+	}
+
+	return data == dataSafeEnd;
+}
+
+void MeshCompression::EncodeIndexSequence(std::span<const u32> indices, Data<u8>& out)
+{
+	out.clear();
+	out.push_back(s_sequenceHeader | s_sequenceVersion);
+
+	u32 last[2] = {};
+	u32 baseline = 0;
+	for (const u32 index : indices) {
+		// a delta that wont fit a byte with the sign and baseline bits switches to the other baseline
+		const i32 distance = static_cast<i32>(index - last[baseline]);
+		baseline ^= std::abs(distance) >= 30;
+
+		const u32 delta = index - last[baseline];
+		const u32 zigzag = (delta << 1) ^ static_cast<u32>(static_cast<i32>(delta) >> 31);
+		EncodeVByte(out, (zigzag << 1) | baseline);
+		last[baseline] = index;
+	}
+
+	out.resize(out.size() + 4, 0);
+}
+
+//
+// filters
+//
+
+static inline i32 RoundToInt(f32 v)
+{
+	return static_cast<i32>(v + (v >= 0.0f ? 0.5f : -0.5f));
+}
+
+static inline i32 QuantizeSnorm(f32 v, u32 bits)
+{
+	const f32 scale = static_cast<f32>((1 << (bits - 1)) - 1);
+	return RoundToInt(std::clamp(v, -1.0f, 1.0f) * scale);
+}
+
+// x and y on the octahedron, z is 1 at the same scale so it tells the decoder the bit count
+template<typename T>
+static void DecodeOctahedral(T* data, u32 count)
+{
+	constexpr f32 max = static_cast<f32>(std::numeric_limits<T>::max());
+
+	for (u32 i = 0; i < count; ++i) {
+		T* v = data + static_cast<size_t>(i) * 4;
+		f32 x = static_cast<f32>(v[0]);
+		f32 y = static_cast<f32>(v[1]);
+		const f32 z = static_cast<f32>(v[2]) - std::abs(x) - std::abs(y);
+
+		// fold the lower half back out
+		const f32 t = std::min(z, 0.0f);
+		x += x >= 0.0f ? t : -t;
+		y += y >= 0.0f ? t : -t;
+
+		const f32 s = max / std::sqrt(x * x + y * y + z * z);
+		v[0] = static_cast<T>(RoundToInt(x * s));
+		v[1] = static_cast<T>(RoundToInt(y * s));
+		v[2] = static_cast<T>(RoundToInt(z * s));
+	}
+}
+
+// the three smallest components scaled by sqrt 2, the low 2 bits of the 4th say which one is missing and
+// the rest of it is the scale
+static void DecodeQuaternion(i16* data, u32 count)
+{
+	const f32 scale = 1.0f / std::sqrt(2.0f);
+
+	for (u32 i = 0; i < count; ++i) {
+		i16* q = data + static_cast<size_t>(i) * 4;
+		const f32 s = scale / static_cast<f32>(q[3] | 3);
+
+		const f32 x = q[0] * s;
+		const f32 y = q[1] * s;
+		const f32 z = q[2] * s;
+		const f32 w = std::sqrt(std::max(0.0f, 1.0f - x * x - y * y - z * z));
+
+		const u32 largest = q[3] & 3;
+		q[(largest + 1) & 3] = static_cast<i16>(RoundToInt(x * 32767.0f));
+		q[(largest + 2) & 3] = static_cast<i16>(RoundToInt(y * 32767.0f));
+		q[(largest + 3) & 3] = static_cast<i16>(RoundToInt(z * 32767.0f));
+		q[largest] = static_cast<i16>(RoundToInt(w * 32767.0f));
+	}
+}
+
+static void DecodeExponential(u32* data, u32 count)
+{
+	for (u32 i = 0; i < count; ++i) {
+		const u32 v = data[i];
+		const i32 mantissa = static_cast<i32>(v << 8) >> 8;
+		const i32 exponent = static_cast<i32>(v) >> 24;
+
+		// ldexp without the call, 2^exponent straight into the bits of a float
+		const f32 scale = std::bit_cast<f32>(static_cast<u32>(exponent + 127) << 23);
+		data[i] = std::bit_cast<u32>(scale * static_cast<f32>(mantissa));
+	}
+}
+
+void MeshCompression::DecodeFilter(Filter filter, void* data, u32 count, u32 stride)
+{
+	switch (filter) {
+	case Filter::None:
+		break;
+	case Filter::Octahedral:
+		ENSURE(stride == 4 || stride == 8, "the octahedral filter needs a stride of 4 or 8");
+		if (stride == 4) {
+			DecodeOctahedral(static_cast<i8*>(data), count);
+		} else {
+			DecodeOctahedral(static_cast<i16*>(data), count);
+		}
+		break;
+	case Filter::Quaternion:
+		ENSURE(stride == 8, "the quaternion filter needs a stride of 8");
+		DecodeQuaternion(static_cast<i16*>(data), count);
+		break;
+	case Filter::Exponential:
+		ENSURE(stride % 4 == 0, "the exponential filter needs a stride that is a multiple of 4");
+		DecodeExponential(static_cast<u32*>(data), count * (stride / 4));
+		break;
+	}
+}
+
+void MeshCompression::EncodeFilterOctahedral(std::span<const float4> vectors, u32 stride, u32 bits, void* out)
+{
+	ENSURE((stride == 4 && bits >= 2 && bits <= 8) || (stride == 8 && bits >= 2 && bits <= 16), "EncodeFilterOctahedral has 8 bits for stride 4 and 16 for stride 8");
+
+	for (size_t i = 0; i < vectors.size(); ++i) {
+		const float4& n = vectors[i];
+
+		// onto the octahedron, the lower half folded over the upper one
+		const f32 length = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+		const f32 s = length == 0.0f ? 0.0f : 1.0f / length;
+		const f32 x = n.x * s;
+		const f32 y = n.y * s;
+		const f32 u = n.z >= 0.0f ? x : (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		const f32 v = n.z >= 0.0f ? y : (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+
+		const i32 encoded[4] = { QuantizeSnorm(u, bits), QuantizeSnorm(v, bits), QuantizeSnorm(1.0f, bits), QuantizeSnorm(n.w, bits) };
+		for (u32 c = 0; c < 4; ++c) {
+			if (stride == 4) {
+				static_cast<i8*>(out)[i * 4 + c] = static_cast<i8>(encoded[c]);
+			} else {
+				static_cast<i16*>(out)[i * 4 + c] = static_cast<i16>(encoded[c]);
+			}
+		}
+	}
+}
+
+void MeshCompression::EncodeFilterQuaternion(std::span<const float4> rotations, u32 bits, i16* out)
+{
+	ENSURE(bits >= 4 && bits <= 16, "EncodeFilterQuaternion needs 4 to 16 bits");
+
+	const f32 scale = std::sqrt(2.0f);
+	for (size_t i = 0; i < rotations.size(); ++i) {
+		const f32 q[4] = { rotations[i].x, rotations[i].y, rotations[i].z, rotations[i].w };
+
+		u32 largest = 0;
+		for (u32 c = 1; c < 4; ++c) {
+			largest = std::abs(q[c]) > std::abs(q[largest]) ? c : largest;
+		}
+
+		// q and -q are the same rotation, flip it so the dropped component is positive
+		const f32 sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+		i16* encoded = out + i * 4;
+		encoded[0] = static_cast<i16>(QuantizeSnorm(q[(largest + 1) & 3] * scale * sign, bits));
+		encoded[1] = static_cast<i16>(QuantizeSnorm(q[(largest + 2) & 3] * scale * sign, bits));
+		encoded[2] = static_cast<i16>(QuantizeSnorm(q[(largest + 3) & 3] * scale * sign, bits));
+		encoded[3] = static_cast<i16>((QuantizeSnorm(1.0f, bits) & ~3) | static_cast<i32>(largest));
+	}
+}
+
+void MeshCompression::EncodeFilterExponential(std::span<const f32> values, u32 bits, u32* out)
+{
+	ENSURE(bits >= 1 && bits <= 24, "EncodeFilterExponential needs 1 to 24 bits");
+
+	const i32 mantissaMax = (1 << (bits - 1)) - 1;
+	for (size_t i = 0; i < values.size(); ++i) {
+		const f32 v = values[i];
+
+		// the exponent that leaves bits - 1 bits for the magnitude, one more if rounding overflows it
+		i32 exponent = 0;
+		std::frexp(v, &exponent);
+		exponent = v == 0.0f ? 0 : std::clamp(exponent - static_cast<i32>(bits - 1), -100, 100);
+		i32 mantissa = RoundToInt(std::ldexp(v, -exponent));
+		if (std::abs(mantissa) > mantissaMax) {
+			exponent = std::min(exponent + 1, 100);
+			mantissa = RoundToInt(std::ldexp(v, -exponent));
+		}
+
+		out[i] = (static_cast<u32>(exponent) << 24) | (static_cast<u32>(mantissa) & 0xffffff);
+	}
+}
+
+//
+// glTF
+//
+
+static bool DecodeBufferView(const cgltf_buffer_view& view)
+{
+	const cgltf_meshopt_compression& compression = view.meshopt_compression;
+	const std::span<const u8> encoded(static_cast<const u8*>(compression.buffer->data) + compression.offset, compression.size);
+	const u32 count = static_cast<u32>(compression.count);
+	const u32 stride = static_cast<u32>(compression.stride);
+
+	switch (compression.mode) {
+	case cgltf_meshopt_compression_mode_attributes: {
+		if (!DecodeVertexBuffer(view.data, count, stride, encoded)) {
+			return false;
+		}
+		const Filter filter = static_cast<Filter>(compression.filter);
+		const bool strideFits = (filter != Filter::Octahedral || stride == 4 || stride == 8) && (filter != Filter::Quaternion || stride == 8);
+		if (compression.filter >= cgltf_meshopt_compression_filter_max_enum || !strideFits) {
+			return false;
+		}
+		DecodeFilter(filter, view.data, count, stride);
+		return true;
+	}
+	case cgltf_meshopt_compression_mode_triangles:
+		return compression.filter == cgltf_meshopt_compression_filter_none && DecodeIndexBuffer(view.data, count, stride, encoded);
+	case cgltf_meshopt_compression_mode_indices:
+		return compression.filter == cgltf_meshopt_compression_filter_none && DecodeIndexSequence(view.data, count, stride, encoded);
+	default:
+		return false;
+	}
+}
+
+bool MeshCompression::DecodeGltfBufferViews(cgltf_data* data)
+{
+	PROFILE_ZONE("MeshCompression::DecodeGltfBufferViews");
+
+	Data<cgltf_buffer_view*> views;
+	for (cgltf_size i = 0; i < data->buffer_views_count; ++i) {
+		cgltf_buffer_view* view = &data->buffer_views[i];
+		if (!view->has_meshopt_compression || view->data != nullptr) {
+			continue;
+		}
+
+		// view->buffer is usually a fallback without any data, only the compressed buffer is read
+		const cgltf_meshopt_compression& compression = view->meshopt_compression;
+		const cgltf_buffer* source = compression.buffer;
+		if (source == nullptr || source->data == nullptr || compression.offset + compression.size > source->size) {
+			return false;
+		}
+		if (compression.count > std::numeric_limits<u32>::max() || compression.count * compression.stride != view->size) {
+			return false;
+		}
+
+		// cgltf_free frees view->data with the same allocator, even if decoding fails below
+		view->data = data->memory.alloc_func(data->memory.user_data, view->size);
+		if (view->data == nullptr) {
+			return false;
+		}
+		views.push_back(view);
+	}
+
+	Data<u8> decoded(views.size(), 0);
+	global::jobSystem->ParallelFor(static_cast<u32>(views.size()), 1, [&](u32 begin, u32 end) {
+		for (u32 v = begin; v < end; ++v) {
+			decoded[v] = DecodeBufferView(*views[v]);
+		}
+	});
+
+	return std::all_of(decoded.begin(), decoded.end(), [](u8 ok) { return ok != 0; });
+}
+
+//
+// vertex formats
+//
+
+u32 MeshCompression::FormatSize(VertexFormat format)
+{
+	switch (format) {
+	case VertexFormat::Float2: return 8;
+	case VertexFormat::Float3: return 12;
+	case VertexFormat::Float4: return 16;
+	case VertexFormat::Unorm16x4:
+	case VertexFormat::Snorm16x4: return 8;
+	default: return 4;
+	}
+}
+
+VertexFormat MeshCompression::GetGltfFormat(const cgltf_accessor* accessor, VertexFormat floatFormat)
+{
+	if (!accessor->normalized) {
+		return floatFormat;
+	}
+
+	const bool two = accessor->type == cgltf_type_vec2;
+	const bool four = accessor->type == cgltf_type_vec3 || accessor->type == cgltf_type_vec4;
+	if (!two && !four) {
+		return floatFormat;
+	}
+
+	switch (accessor->component_type) {
+	case cgltf_component_type_r_8: return two ? VertexFormat::Snorm8x2 : VertexFormat::Snorm8x4;
+	case cgltf_component_type_r_8u: return two ? VertexFormat::Unorm8x2 : VertexFormat::Unorm8x4;
+	case cgltf_component_type_r_16: return two ? VertexFormat::Snorm16x2 : VertexFormat::Snorm16x4;
+	case cgltf_component_type_r_16u: return two ? VertexFormat::Unorm16x2 : VertexFormat::Unorm16x4;
+	default: return floatFormat;
+	}
+}
+
+VertexFormat MeshCompression::GetGltfPositionFormat(const cgltf_accessor* accessor, f32& outPositionScale)
+{
+	outPositionScale = 1.0f;
+	if (accessor->normalized || accessor->type != cgltf_type_vec3) {
+		return GetGltfFormat(accessor, VertexFormat::Float3);
+	}
+
+	switch (accessor->component_type) {
+	case cgltf_component_type_r_8: outPositionScale = 127.0f; return VertexFormat::Snorm8x4;
+	case cgltf_component_type_r_8u: outPositionScale = 255.0f; return VertexFormat::Unorm8x4;
+	case cgltf_component_type_r_16: outPositionScale = 32767.0f; return VertexFormat::Snorm16x4;
+	case cgltf_component_type_r_16u: outPositionScale = 65535.0f; return VertexFormat::Unorm16x4;
+	default: return VertexFormat::Float3;
+	}
+}
+
+template<typename T>
+static void StoreNormalized(const f32* values, u32 components, u8* out)
+{
+	constexpr f32 max = static_cast<f32>(std::numeric_limits<T>::max());
+	constexpr f32 min = std::is_signed_v<T> ? -1.0f : 0.0f;
+
+	T packed[4];
+	for (u32 c = 0; c < components; ++c) {
+		packed[c] = static_cast<T>(RoundToInt(std::clamp(values[c], min, 1.0f) * max));
+	}
+	memcpy(out, packed, components * sizeof(T));
+}
+
+// values has 4 components whatever the format
+static void StoreAttribute(VertexFormat format, const f32* values, u8* out)
+{
+	memset(out, 0, FormatSize(format));
+
+	switch (format) {
+	case VertexFormat::Float2: memcpy(out, values, 2 * sizeof(f32)); break;
+	case VertexFormat::Float3: memcpy(out, values, 3 * sizeof(f32)); break;
+	case VertexFormat::Float4: memcpy(out, values, 4 * sizeof(f32)); break;
+	case VertexFormat::Unorm8x2: StoreNormalized<u8>(values, 2, out); break;
+	case VertexFormat::Unorm8x4: StoreNormalized<u8>(values, 4, out); break;
+	case VertexFormat::Unorm16x2: StoreNormalized<u16>(values, 2, out); break;
+	case VertexFormat::Unorm16x4: StoreNormalized<u16>(values, 4, out); break;
+	case VertexFormat::Snorm8x2: StoreNormalized<i8>(values, 2, out); break;
+	case VertexFormat::Snorm8x4: StoreNormalized<i8>(values, 4, out); break;
+	case VertexFormat::Snorm16x2: StoreNormalized<i16>(values, 2, out); break;
+	case VertexFormat::Snorm16x4: StoreNormalized<i16>(values, 4, out); break;
+	}
+}
+
+void MeshCompression::PackAttributes(const AttributeLayout& layout, std::span<const float4> tangents, std::span<const float3> colors,
+	std::span<const float2> uv0s, u32 count, std::span<u8> out)
+{
+	PROFILE_ZONE("MeshCompression::PackAttributes");
+
+	const u32 stride = layout.Stride();
+	ENSURE(out.size() >= static_cast<size_t>(count) * stride, "PackAttributes needs count * stride bytes");
+
+	for (u32 v = 0; v < count; ++v) {
+		const float4 tangent = v < tangents.size() ? tangents[v] : float4(1.0f, 0.0f, 0.0f, 1.0f);
+		const float3 color = v < colors.size() ? colors[v] : float3(0.0f, 0.0f, 0.0f);
+		const float2 uv0 = v < uv0s.size() ? uv0s[v] : float2(0.0f, 0.0f);
+
+		const f32 tangentValues[4] = { tangent.x, tangent.y, tangent.z, tangent.w };
+		const f32 colorValues[4] = { color.x, color.y, color.z, 1.0f };
+		const f32 uv0Values[4] = { uv0.x, uv0.y, 0.0f, 0.0f };
+
+		u8* vertex = out.data() + static_cast<size_t>(v) * stride;
+		StoreAttribute(layout.tangent, tangentValues, vertex + layout.TangentOffset());
+		StoreAttribute(layout.color, colorValues, vertex + layout.ColorOffset());
+		StoreAttribute(layout.uv0, uv0Values, vertex + layout.Uv0Offset());
+	}
+}
+
+void MeshCompression::PackPositions(const PositionLayout& layout, std::span<const float3> positions, std::span<const float3> normals,
+	u32 count, std::span<u8> out)
+{
+	PROFILE_ZONE("MeshCompression::PackPositions");
+
+	const u32 stride = layout.Stride();
+	ENSURE(out.size() >= static_cast<size_t>(count) * stride, "PackPositions needs count * stride bytes");
+	ENSURE(positions.size() >= count, "");
+
+	// the shader multiplies by the scale, so the integer of an unnormalized position is what gets stored
+	const f32 inverseScale = 1.0f / layout.positionScale;
+	for (u32 v = 0; v < count; ++v) {
+		const float3 position = positions[v];
+		const float3 normal = v < normals.size() ? normals[v] : float3(0.0f, 0.0f, 0.0f);
+
+		const f32 positionValues[4] = { position.x * inverseScale, position.y * inverseScale, position.z * inverseScale, 0.0f };
+		const f32 normalValues[4] = { normal.x, normal.y, normal.z, 0.0f };
+
+		u8* vertex = out.data() + static_cast<size_t>(v) * stride;
+		StoreAttribute(layout.position, positionValues, vertex + layout.PositionOffset());
+		StoreAttribute(layout.normal, normalValues, vertex + layout.NormalOffset());
+	}
+}
+
+// the same math as cgltf_accessor_unpack_floats for a scale of 1, scaled positions multiply the integer
+// by scale / max which is 1 for all of them, so they come back as the integer
+template<typename T>
+static void LoadNormalized(const u8* in, u32 components, f32 scale, f32* values)
+{
+	constexpr f32 max = static_cast<f32>(std::numeric_limits<T>::max());
+
+	T packed[4];
+	memcpy(packed, in, components * sizeof(T));
+	for (u32 c = 0; c < components; ++c) {
+		const f32 value = static_cast<f32>(packed[c]);
+		values[c] = scale == 1.0f ? std::max(value / max, -1.0f) : value * (scale / max);
+	}
+}
+
+// values gets 4 components whatever the format, the ones it doesnt have are 0
+static void LoadAttribute(VertexFormat format, const u8* in, f32 scale, f32* values)
+{
+	memset(values, 0, 4 * sizeof(f32));
+
+	switch (format) {
+	case VertexFormat::Float2: memcpy(values, in, 2 * sizeof(f32)); break;
+	case VertexFormat::Float3: memcpy(values, in, 3 * sizeof(f32)); break;
+	case VertexFormat::Float4: memcpy(values, in, 4 * sizeof(f32)); break;
+	case VertexFormat::Unorm8x2: LoadNormalized<u8>(in, 2, scale, values); break;
+	case VertexFormat::Unorm8x4: LoadNormalized<u8>(in, 4, scale, values); break;
+	case VertexFormat::Unorm16x2: LoadNormalized<u16>(in, 2, scale, values); break;
+	case VertexFormat::Unorm16x4: LoadNormalized<u16>(in, 4, scale, values); break;
+	case VertexFormat::Snorm8x2: LoadNormalized<i8>(in, 2, scale, values); break;
+	case VertexFormat::Snorm8x4: LoadNormalized<i8>(in, 4, scale, values); break;
+	case VertexFormat::Snorm16x2: LoadNormalized<i16>(in, 2, scale, values); break;
+	case VertexFormat::Snorm16x4: LoadNormalized<i16>(in, 4, scale, values); break;
+	}
+}
+
+void MeshCompression::UnpackPositions(const PositionLayout& layout, std::span<const u8> stream, u32 first, std::span<float3> positions, std::span<float3> normals)
+{
+	const u32 stride = layout.Stride();
+	const size_t count = std::max(positions.size(), normals.size());
+	ENSURE((first + count) * stride <= stream.size(), "UnpackPositions past the end of the stream");
+
+	for (size_t v = 0; v < count; ++v) {
+		const u8* vertex = stream.data() + (first + v) * stride;
+		f32 values[4];
+		if (v < positions.size()) {
+			LoadAttribute(layout.position, vertex + layout.PositionOffset(), layout.positionScale, values);
+			positions[v] = float3(values[0], values[1], values[2]);
+		}
+		if (v < normals.size()) {
+			LoadAttribute(layout.normal, vertex + layout.NormalOffset(), 1.0f, values);
+			normals[v] = float3(values[0], values[1], values[2]);
+		}
+	}
+}
+
+void MeshCompression::UnpackUv0s(const AttributeLayout& layout, std::span<const u8> stream, u32 first, std::span<float2> uv0s)
+{
+	const u32 stride = layout.Stride();
+	ENSURE((first + uv0s.size()) * stride <= stream.size(), "UnpackUv0s past the end of the stream");
+
+	for (size_t v = 0; v < uv0s.size(); ++v) {
+		f32 values[4];
+		LoadAttribute(layout.uv0, stream.data() + (first + v) * stride + layout.Uv0Offset(), 1.0f, values);
+		uv0s[v] = float2(values[0], values[1]);
+	}
+}
+
+//
+// benchmark
+//
+
+template<typename Func>
+static f64 BestOf(u32 runs, Func&& func)
+{
+	f64 bestMs = std::numeric_limits<f64>::max();
+	for (u32 i = 0; i < runs; ++i) {
+		spdlog::stopwatch sw;
+		func();
+		bestMs = std::min(bestMs, sw.elapsed().count() * 1000.0);
+	}
+	return bestMs;
+}
+
+static const char* FormatName(VertexFormat format)
+{
+	switch (format) {
+	case VertexFormat::Float2: return "float2";
+	case VertexFormat::Float3: return "float3";
+	case VertexFormat::Float4: return "float4";
+	case VertexFormat::Unorm8x2: return "unorm8x2";
+	case VertexFormat::Unorm8x4: return "unorm8x4";
+	case VertexFormat::Unorm16x2: return "unorm16x2";
+	case VertexFormat::Unorm16x4: return "unorm16x4";
+	case VertexFormat::Snorm8x2: return "snorm8x2";
+	case VertexFormat::Snorm8x4: return "snorm8x4";
+	case VertexFormat::Snorm16x2: return "snorm16x2";
+	case VertexFormat::Snorm16x4: return "snorm16x4";
+	}
+	return "?";
+}
+
+// the same triangle, maybe starting at another corner
+static bool SameTriangle(const u32* expected, const u32* actual)
+{
+	for (u32 r = 0; r < 3; ++r) {
+		if (expected[r] == actual[0] && expected[(r + 1) % 3] == actual[1] && expected[(r + 2) % 3] == actual[2]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// triangles of a gridSize by gridSize vertex grid, row by row like an exporter writes them
+static void GridTriangles(u32 gridSize, Data<u32>& out)
+{
+	out.clear();
+	for (u32 y = 0; y + 1 < gridSize; ++y) {
+		for (u32 x = 0; x + 1 < gridSize; ++x) {
+			const u32 v = y * gridSize + x;
+			out.insert(out.end(), { v, v + gridSize, v + 1, v + 1, v + gridSize, v + gridSize + 1 });
+		}
+	}
+}
+
+// a glb with its json and one binary chunk, both padded to 4 bytes
+static void WriteGlb(const std::string& json, std::span<const u8> bin, Data<u8>& out)
+{
+	const u32 jsonSize = (static_cast<u32>(json.size()) + 3) & ~3u;
+	const u32 binSize = (static_cast<u32>(bin.size()) + 3) & ~3u;
+
+	// sized up front and written through the span, so every write is bounded by what is left of it
+	out.assign(12 + 8 + jsonSize + 8 + binSize, 0);
+	std::span<u8> rest(out);
+	auto write = [&](const void* data, size_t size) {
+		const std::span<u8> to = rest.first(size);
+		std::memcpy(to.data(), data, to.size());
+		rest = rest.subspan(size);
+	};
+	auto write32 = [&](u32 v) {
+		write(&v, sizeof(v));
+	};
+
+	write32(0x46546c67);
+	write32(2);
+	write32(static_cast<u32>(out.size()));
+	write32(jsonSize);
+	write32(0x4e4f534a);
+	write(json.data(), json.size());
+	std::fill_n(rest.begin(), jsonSize - json.size(), static_cast<u8>(' '));
+	rest = rest.subspan(jsonSize - json.size());
+	write32(binSize);
+	write32(0x004e4942);
+	write(bin.data(), bin.size());
+}
+
+// streams as meshoptimizer writes them, the ones its own tests decode, so the decoders are held against the
+// reference encoder and not only against the encoders here
+static bool CheckReferenceStreams()
+{
+	// 3 16 bit positions, 2 8 bit octahedral normal components and 2 16 bit uvs
+	struct Vertex {
+		u16 px, py, pz;
+		u8 nu, nv;
+		u16 tx, ty;
+	};
+	static_assert(sizeof(Vertex) == 12, "");
+
+	static const Vertex vertices[] = {
+		{ 0, 0, 0, 0, 0, 0, 0 },
+		{ 300, 0, 0, 0, 0, 500, 0 },
+		{ 0, 300, 0, 0, 0, 0, 500 },
+		{ 300, 300, 0, 0, 0, 500, 500 },
+	};
+	static const u8 vertexData[] = {
+		0xa0,
+		// every byte of the vertex is a group of deltas, 2 bits each and the ones that dont fit after them
+		0x01, 0x3f, 0x00, 0x00, 0x00, 0x58, 0x57, 0x58,
+		0x01, 0x26, 0x00, 0x00, 0x00,
+		0x01, 0x0c, 0x00, 0x00, 0x00, 0x58,
+		0x01, 0x08, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00,
+		0x01, 0x3f, 0x00, 0x00, 0x00, 0x17, 0x18, 0x17,
+		0x01, 0x26, 0x00, 0x00, 0x00,
+		0x01, 0x0c, 0x00, 0x00, 0x00, 0x17,
+		0x01, 0x08, 0x00, 0x00, 0x00,
+		// the tail, padding and the first vertex
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	};
+
+	// 4 6 5 keeps the next vertex from advancing, so the last triangle cant be encoded as the next one
+	static const u32 indices[] = { 0, 1, 2, 2, 1, 3, 4, 6, 5, 7, 8, 9 };
+	static const u8 indexDataV0[] = {
+		0xe0, 0xf0, 0x10, 0xfe, 0xff, 0xf0, 0x0c, 0xff, 0x02, 0x02, 0x02, 0x00, 0x76, 0x87, 0x56, 0x67,
+		0x78, 0xa9, 0x86, 0x65, 0x89, 0x68, 0x98, 0x01, 0x69, 0x00, 0x00,
+	};
+
+	static const u32 sequence[] = { 0, 1, 51, 2, 49, 1000 };
+	static const u8 sequenceData[] = {
+		0xd1, 0x00, 0x04, 0xcd, 0x01, 0x04, 0x07, 0x98, 0x1f, 0x00, 0x00, 0x00, 0x00,
+	};
+
+	Vertex decodedVertices[ARRLEN(vertices)] = {};
+	bool vertexMatches = DecodeVertexBuffer(decodedVertices, ARRLEN(vertices), sizeof(Vertex), vertexData);
+	vertexMatches = vertexMatches && memcmp(decodedVertices, vertices, sizeof(vertices)) == 0;
+
+	auto sameTriangles = [](std::span<const u32> expected, std::span<const u32> decoded) {
+		bool same = true;
+		for (size_t i = 0; i < expected.size(); i += 3) {
+			same &= SameTriangle(&expected[i], &decoded[i]);
+		}
+		return same;
+	};
+
+	u32 decodedIndices[ARRLEN(indices)] = {};
+	bool indexMatches = DecodeIndexBuffer(decodedIndices, ARRLEN(indices), sizeof(u32), indexDataV0);
+	indexMatches = indexMatches && sameTriangles(indices, decodedIndices);
+
+	// 16 bit indices come out of the same stream
+	u16 decodedShort[ARRLEN(indices)] = {};
+	indexMatches = indexMatches && DecodeIndexBuffer(decodedShort, ARRLEN(indices), sizeof(u16), indexDataV0);
+	for (u32 i = 0; i < ARRLEN(indices) && indexMatches; ++i) {
+		indexMatches = decodedShort[i] == decodedIndices[i];
+	}
+
+	u32 decodedSequence[ARRLEN(sequence)] = {};
+	bool sequenceMatches = DecodeIndexSequence(decodedSequence, ARRLEN(sequence), sizeof(u32), sequenceData);
+	sequenceMatches = sequenceMatches && memcmp(decodedSequence, sequence, sizeof(sequence)) == 0;
+
+	spdlog::info("reference streams, vertices {}, triangles {}, sequence {}", vertexMatches ? "matches" : "MISMATCH",
+		indexMatches ? "matches" : "MISMATCH", sequenceMatches ? "matches" : "MISMATCH");
+	return vertexMatches && indexMatches && sequenceMatches;
+}
+
+bool MeshCompression::RunBenchmark()
+{
+	constexpr u32 gridSize = 512;
+	constexpr u32 vertexCount = gridSize * gridSize;
+	constexpr u32 runs = 10;
+	constexpr u32 normalBits = 8;
+	constexpr u32 rotationBits = 12;
+	constexpr u32 exponentialBits = 15;
+
+	spdlog::info("mesh compression benchmark, {} vertices, best of {} runs", vertexCount, runs);
+
+	bool passed = CheckReferenceStreams();
+
+	// a wavy sheet with a frame per vertex, what a terrain tile or a piece of cloth carries
+	Data<float3> positions(vertexCount);
+	Data<float4> normals(vertexCount);
+	Data<float4> tangents(vertexCount);
+	Data<float4> rotations(vertexCount);
+	Data<float2> uvs(vertexCount);
+	Data<float4> colors(vertexCount);
+	for (u32 y = 0; y < gridSize; ++y) {
+		for (u32 x = 0; x < gridSize; ++x) {
+			const u32 v = y * gridSize + x;
+			const f32 fx = x / (gridSize - 1.0f);
+			const f32 fy = y / (gridSize - 1.0f);
+			const f32 height = 0.1f * std::sin(fx * 25.0f) * std::cos(fy * 17.0f);
+			const f32 slopeX = 2.5f * std::cos(fx * 25.0f) * std::cos(fy * 17.0f);
+			const f32 slopeY = -1.7f * std::sin(fx * 25.0f) * std::sin(fy * 17.0f);
+
+			positions[v] = float3(fx * 2.0f - 1.0f, height, fy * 2.0f - 1.0f);
+
+			vec4 normal = DirectX::XMVector3Normalize(DirectX::XMVectorSet(-slopeX, 2.0f, -slopeY, 0.0f));
+			vec4 tangent = DirectX::XMVector3Normalize(DirectX::XMVectorSet(2.0f, slopeX, 0.0f, 0.0f));
+			DirectX::XMStoreFloat4(&normals[v], normal);
+			DirectX::XMStoreFloat4(&tangents[v], DirectX::XMVectorSetW(tangent, 1.0f));
+			DirectX::XMStoreFloat4(&rotations[v], DirectX::XMQuaternionRotationRollPitchYaw(slopeX, fx * 6.0f, slopeY));
+
+			uvs[v] = float2(fx, fy);
+			colors[v] = float4(fx, fy, 0.5f + height, 1.0f);
+		}
+	}
+
+	// the streams as a KHR_mesh_quantization file has them, positions are unnormalized shorts that the
+	// node transform scales back
+	constexpr f32 positionScale = 16383.0f;
+	Data<i16> quantizedPositions(vertexCount * 4, 0);
+	Data<i8> octNormals(vertexCount * 4);
+	Data<i8> octTangents(vertexCount * 4);
+	Data<i16> quatRotations(vertexCount * 4);
+	Data<u32> expPositions(vertexCount * 3);
+	Data<u16> unormUvs(vertexCount * 2);
+	Data<u8> unormColors(vertexCount * 4);
+	for (u32 v = 0; v < vertexCount; ++v) {
+		quantizedPositions[v * 4 + 0] = static_cast<i16>(RoundToInt(positions[v].x * positionScale));
+		quantizedPositions[v * 4 + 1] = static_cast<i16>(RoundToInt(positions[v].y * positionScale));
+		quantizedPositions[v * 4 + 2] = static_cast<i16>(RoundToInt(positions[v].z * positionScale));
+		const f32 uv[4] = { uvs[v].x, uvs[v].y, 0.0f, 0.0f };
+		StoreNormalized<u16>(uv, 2, reinterpret_cast<u8*>(&unormUvs[v * 2]));
+		StoreNormalized<u8>(&colors[v].x, 4, &unormColors[v * 4]);
+	}
+	EncodeFilterOctahedral(normals, 4, normalBits, octNormals.data());
+	EncodeFilterOctahedral(tangents, 4, normalBits, octTangents.data());
+	EncodeFilterQuaternion(rotations, rotationBits, quatRotations.data());
+	EncodeFilterExponential(std::span<const f32>(&positions[0].x, vertexCount * 3), exponentialBits, expPositions.data());
+
+	// what each filter should come back as, per component against the source
+	auto normalError = [&](const void* decoded) {
+		const i8* n = static_cast<const i8*>(decoded);
+		f32 error = 0.0f;
+		for (u32 v = 0; v < vertexCount; ++v) {
+			error = std::max({ error, std::abs(n[v * 4 + 0] / 127.0f - normals[v].x), std::abs(n[v * 4 + 1] / 127.0f - normals[v].y), std::abs(n[v * 4 + 2] / 127.0f - normals[v].z) });
+		}
+		return error;
+	};
+	auto rotationError = [&](const void* decoded) {
+		const i16* q = static_cast<const i16*>(decoded);
+		f32 error = 0.0f;
+		for (u32 v = 0; v < vertexCount; ++v) {
+			const f32* expected = &rotations[v].x;
+			f32 same = 0.0f;
+			f32 flipped = 0.0f;
+			for (u32 c = 0; c < 4; ++c) {
+				same = std::max(same, std::abs(q[v * 4 + c] / 32767.0f - expected[c]));
+				flipped = std::max(flipped, std::abs(q[v * 4 + c] / 32767.0f + expected[c]));
+			}
+			error = std::max(error, std::min(same, flipped));
+		}
+		return error;
+	};
+	auto exponentialError = [&](const void* decoded) {
+		const f32* p = static_cast<const f32*>(decoded);
+		const f32* expected = &positions[0].x;
+		f32 error = 0.0f;
+		for (u32 i = 0; i < vertexCount * 3; ++i) {
+			error = std::max(error, std::abs(p[i] - expected[i]) / std::max(std::abs(expected[i]), 1e-6f));
+		}
+		return error;
+	};
+
+	struct VertexStream {
+		const char* name;
+		const void* data;
+		u32 stride;
+		Filter filter;
+		// the filter error when there is one
+		f32 tolerance = 0.0f;
+		std::function<f32(const void*)> error = nullptr;
+	};
+	const VertexStream streams[] = {
+		{ "positions short", quantizedPositions.data(), 8, Filter::None },
+		// half a step on each octahedron axis, up to twice that near the fold, and the rounding of the output
+		{ "normals oct", octNormals.data(), 4, Filter::Octahedral, 3.0f / ((1 << (normalBits - 1)) - 1), normalError },
+		{ "tangents oct", octTangents.data(), 4, Filter::Octahedral },
+		{ "rotations quat", quatRotations.data(), 8, Filter::Quaternion, 2.0f / ((1 << (rotationBits - 1)) - 1), rotationError },
+		{ "positions exp", expPositions.data(), 12, Filter::Exponential, 1.0f / (1 << (exponentialBits - 2)), exponentialError },
+		{ "uvs unorm", unormUvs.data(), 4, Filter::None },
+		{ "colors unorm", unormColors.data(), 4, Filter::None },
+	};
+
+	Data<u8> encoded;
+	Data<u8> decoded;
+	u64 totalRaw = 0;
+	u64 totalEncoded = 0;
+	for (const VertexStream& stream : streams) {
+		const size_t rawSize = static_cast<size_t>(vertexCount) * stream.stride;
+		EncodeVertexBuffer(stream.data, vertexCount, stream.stride, encoded);
+		decoded.assign(rawSize, 0);
+
+		const bool decodes = DecodeVertexBuffer(decoded.data(), vertexCount, stream.stride, encoded);
+		const bool matches = decodes && memcmp(decoded.data(), stream.data, rawSize) == 0;
+		const f64 ms = BestOf(runs, [&]() { DecodeVertexBuffer(decoded.data(), vertexCount, stream.stride, encoded); });
+		totalRaw += rawSize;
+		totalEncoded += encoded.size();
+
+		spdlog::info("    {:<16} {:6.2f} MB -> {:6.2f} MB ({:4.1f}%), decode {:.3f} ms, {:.2f} GB/s, {}",
+			stream.name, rawSize / (1024.0 * 1024.0), encoded.size() / (1024.0 * 1024.0), 100.0 * encoded.size() / rawSize, ms,
+			rawSize / (ms * 1e6), matches ? "matches" : "MISMATCH");
+		passed &= matches;
+
+		if (stream.filter != Filter::None) {
+			// filters work in place, every run starts from a copy of the decoded stream
+			Data<u8> filtered(decoded);
+			const f64 copyMs = BestOf(runs, [&]() { memcpy(filtered.data(), decoded.data(), rawSize); });
+			const f64 filterMs = BestOf(runs, [&]() {
+				memcpy(filtered.data(), decoded.data(), rawSize);
+				DecodeFilter(stream.filter, filtered.data(), vertexCount, stream.stride);
+			});
+			if (stream.error) {
+				const f32 error = stream.error(filtered.data());
+				spdlog::info("    {:<16} filter {:.3f} ms, {:.2f} GB/s, max error {:.2e}, {}", "",
+					filterMs - copyMs, rawSize / (std::max(filterMs - copyMs, 1e-3) * 1e6), error, error <= stream.tolerance ? "matches" : "MISMATCH");
+				passed &= error <= stream.tolerance;
+			} else {
+				spdlog::info("    {:<16} filter {:.3f} ms, {:.2f} GB/s", "", filterMs - copyMs, rawSize / (std::max(filterMs - copyMs, 1e-3) * 1e6));
+			}
+		}
+	}
+	spdlog::info("    vertex streams {:.2f} MB -> {:.2f} MB ({:.1f}%)", totalRaw / (1024.0 * 1024.0), totalEncoded / (1024.0 * 1024.0), 100.0 * totalEncoded / totalRaw);
+
+	// grid order has an edge in the fifo for nearly every triangle, shuffled has to spell out most indices
+	Data<u32> gridIndices;
+	GridTriangles(gridSize, gridIndices);
+	Data<u32> shuffledIndices(gridIndices);
+	{
+		std::mt19937 rng(47);
+		Data<u32> order(shuffledIndices.size() / 3);
+		for (u32 t = 0; t < order.size(); ++t) {
+			order[t] = t;
+		}
+		std::shuffle(order.begin(), order.end(), rng);
+		for (u32 t = 0; t < order.size(); ++t) {
+			std::copy_n(&gridIndices[order[t] * 3], 3, &shuffledIndices[t * 3]);
+		}
+	}
+	Data<u32> smallIndices;
+	GridTriangles(128, smallIndices);
+
+	struct IndexCase {
+		const char* name;
+		const Data<u32>& indices;
+		bool sequence;
+		u32 indexSize;
+	};
+	const IndexCase indexCases[] = {
+		{ "triangles grid", gridIndices, false, 4 },
+		{ "triangles random", shuffledIndices, false, 4 },
+		{ "triangles 16 bit", smallIndices, false, 2 },
+		{ "indices grid", gridIndices, true, 4 },
+		{ "indices random", shuffledIndices, true, 4 },
+	};
+	for (const IndexCase& test : indexCases) {
+		const u32 count = static_cast<u32>(test.indices.size());
+		const size_t rawSize = static_cast<size_t>(count) * test.indexSize;
+		if (test.sequence) {
+			EncodeIndexSequence(test.indices, encoded);
+		} else {
+			EncodeIndexBuffer(test.indices, encoded);
+		}
+
+		Data<u32> wide(count);
+		Data<u16> narrow(test.indexSize == 2 ? count : 0);
+		void* out = test.indexSize == 2 ? static_cast<void*>(narrow.data()) : static_cast<void*>(wide.data());
+		auto decode = [&]() {
+			return test.sequence ? DecodeIndexSequence(out, count, test.indexSize, encoded) : DecodeIndexBuffer(out, count, test.indexSize, encoded);
+		};
+
+		bool matches = decode();
+		if (test.indexSize == 2) {
+			std::copy(narrow.begin(), narrow.end(), wide.begin());
+		}
+		for (u32 i = 0; i < count && matches; i += 3) {
+			matches = test.sequence ? std::equal(&wide[i], &wide[i] + 3, &test.indices[i]) : SameTriangle(&test.indices[i], &wide[i]);
+		}
+		const f64 ms = BestOf(runs, decode);
+
+		spdlog::info("    {:<16} {:6.2f} MB -> {:6.2f} MB ({:4.1f}%), decode {:.3f} ms, {:.2f} GB/s, {}",
+			test.name, rawSize / (1024.0 * 1024.0), encoded.size() / (1024.0 * 1024.0), 100.0 * encoded.size() / rawSize, ms,
+			rawSize / (ms * 1e6), matches ? "matches" : "MISMATCH");
+		passed &= matches;
+	}
+
+	// the same streams written out as a file and read back the way MeshAsset::Load does it
+	{
+		struct View {
+			const void* data;
+			u32 count;
+			u32 stride;
+			const char* mode;
+			const char* filter;
+			// ARRAY_BUFFER or ELEMENT_ARRAY_BUFFER
+			u32 target;
+		};
+		const View views[] = {
+			{ quantizedPositions.data(), vertexCount, 8, "ATTRIBUTES", "NONE", 34962 },
+			{ octNormals.data(), vertexCount, 4, "ATTRIBUTES", "OCTAHEDRAL", 34962 },
+			{ octTangents.data(), vertexCount, 4, "ATTRIBUTES", "OCTAHEDRAL", 34962 },
+			{ unormUvs.data(), vertexCount, 4, "ATTRIBUTES", "NONE", 34962 },
+			{ unormColors.data(), vertexCount, 4, "ATTRIBUTES", "NONE", 34962 },
+			{ expPositions.data(), vertexCount, 12, "ATTRIBUTES", "EXPONENTIAL", 34962 },
+			{ gridIndices.data(), static_cast<u32>(gridIndices.size()), 4, "TRIANGLES", "NONE", 34963 },
+		};
+
+		// every view is compressed into buffer 0, buffer 1 is the fallback that is never there
+		Data<u8> bin;
+		std::string viewsJson;
+		u32 fallbackSize = 0;
+		for (const View& view : views) {
+			if (view.target == 34963) {
+				EncodeIndexBuffer(gridIndices, encoded);
+			} else {
+				EncodeVertexBuffer(view.data, view.count, view.stride, encoded);
+			}
+			const u32 offset = static_cast<u32>(bin.size());
+			bin.insert(bin.end(), encoded.begin(), encoded.end());
+			bin.resize((bin.size() + 3) & ~size_t(3), 0);
+
+			const u32 size = view.count * view.stride;
+			const std::string stride = view.target == 34962 ? fmt::format("\"byteStride\":{},", view.stride) : std::string();
+			viewsJson += fmt::format("{}{{\"buffer\":1,\"byteOffset\":{},\"byteLength\":{},{}\"target\":{},\"extensions\":{{\"EXT_meshopt_compression\":"
+				"{{\"buffer\":0,\"byteOffset\":{},\"byteLength\":{},\"byteStride\":{},\"count\":{},\"mode\":\"{}\",\"filter\":\"{}\"}}}}}}",
+				viewsJson.empty() ? "" : ",", fallbackSize, size, stride, view.target, offset, encoded.size(), view.stride, view.count, view.mode, view.filter);
+			fallbackSize += size;
+		}
+
+		const std::string json = fmt::format(
+			"{{\"asset\":{{\"version\":\"2.0\"}},"
+			"\"extensionsUsed\":[\"EXT_meshopt_compression\",\"KHR_mesh_quantization\"],"
+			"\"extensionsRequired\":[\"EXT_meshopt_compression\",\"KHR_mesh_quantization\"],"
+			"\"buffers\":[{{\"byteLength\":{}}},{{\"byteLength\":{},\"extensions\":{{\"EXT_meshopt_compression\":{{\"fallback\":true}}}}}}],"
+			"\"bufferViews\":[{}],"
+			"\"accessors\":["
+			"{{\"bufferView\":0,\"componentType\":5122,\"count\":{},\"type\":\"VEC3\",\"min\":[-16383,-1639,-16383],\"max\":[16383,1639,16383]}},"
+			"{{\"bufferView\":1,\"componentType\":5120,\"normalized\":true,\"count\":{},\"type\":\"VEC3\"}},"
+			"{{\"bufferView\":2,\"componentType\":5120,\"normalized\":true,\"count\":{},\"type\":\"VEC4\"}},"
+			"{{\"bufferView\":3,\"componentType\":5123,\"normalized\":true,\"count\":{},\"type\":\"VEC2\"}},"
+			"{{\"bufferView\":4,\"componentType\":5121,\"normalized\":true,\"count\":{},\"type\":\"VEC4\"}},"
+			"{{\"bufferView\":5,\"componentType\":5126,\"count\":{},\"type\":\"VEC3\"}},"
+			"{{\"bufferView\":6,\"componentType\":5125,\"count\":{},\"type\":\"SCALAR\"}}],"
+			"\"meshes\":[{{\"primitives\":[{{\"attributes\":{{\"POSITION\":0,\"NORMAL\":1,\"TANGENT\":2,\"TEXCOORD_0\":3,\"COLOR_0\":4,\"_PRECISE_POSITION\":5}},\"indices\":6}}]}}],"
+			"\"nodes\":[{{\"mesh\":0,\"scale\":[{},{},{}]}}],\"scenes\":[{{\"nodes\":[0]}}],\"scene\":0}}",
+			bin.size(), fallbackSize, viewsJson, vertexCount, vertexCount, vertexCount, vertexCount, vertexCount, vertexCount, gridIndices.size(),
+			1.0f / positionScale, 1.0f / positionScale, 1.0f / positionScale);
+
+		Data<u8> glb;
+		WriteGlb(json, bin, glb);
+
+		cgltf_options options = {};
+		cgltf_data* data = nullptr;
+		bool matches = cgltf_parse(&options, glb.data(), glb.size(), &data) == cgltf_result_success;
+		matches = matches && cgltf_load_buffers(&options, data, nullptr) == cgltf_result_success;
+
+		f64 decodeMs = 0.0;
+		if (matches) {
+			spdlog::stopwatch sw;
+			matches = DecodeGltfBufferViews(data);
+			decodeMs = sw.elapsed().count() * 1000.0;
+		}
+
+		PositionLayout positionLayout;
+		AttributeLayout layout;
+		if (matches) {
+			const cgltf_primitive& primitive = data->meshes[0].primitives[0];
+
+			// what the decoder makes of the filtered streams on its own, the file has to give the same
+			Data<u8> expectedNormals(octNormals.size());
+			Data<u8> expectedTangents(octTangents.size());
+			memcpy(expectedNormals.data(), octNormals.data(), octNormals.size());
+			memcpy(expectedTangents.data(), octTangents.data(), octTangents.size());
+			DecodeFilter(Filter::Octahedral, expectedNormals.data(), vertexCount, 4);
+			DecodeFilter(Filter::Octahedral, expectedTangents.data(), vertexCount, 4);
+			Data<u32> expectedExp(expPositions);
+			DecodeFilter(Filter::Exponential, expectedExp.data(), vertexCount, 12);
+
+			Data<float3> floats3(vertexCount);
+			Data<float3> positionFloats(vertexCount);
+			Data<float3> normalFloats(vertexCount);
+			Data<float4> tangentFloats(vertexCount);
+			Data<float4> colorFloats(vertexCount);
+			Data<float3> colorRgb(vertexCount);
+			Data<float2> uvFloats(vertexCount);
+			for (cgltf_size a = 0; a < primitive.attributes_count && matches; ++a) {
+				const cgltf_attribute& attribute = primitive.attributes[a];
+				switch (attribute.type) {
+				case cgltf_attribute_type_position:
+					positionLayout.position = GetGltfPositionFormat(attribute.data, positionLayout.positionScale);
+					cgltf_accessor_unpack_floats(attribute.data, &positionFloats[0].x, vertexCount * 3);
+					break;
+				case cgltf_attribute_type_normal:
+					positionLayout.normal = GetGltfFormat(attribute.data, VertexFormat::Float3);
+					cgltf_accessor_unpack_floats(attribute.data, &normalFloats[0].x, vertexCount * 3);
+					break;
+				case cgltf_attribute_type_tangent:
+					layout.tangent = GetGltfFormat(attribute.data, VertexFormat::Float4);
+					cgltf_accessor_unpack_floats(attribute.data, &tangentFloats[0].x, vertexCount * 4);
+					break;
+				case cgltf_attribute_type_texcoord:
+					layout.uv0 = GetGltfFormat(attribute.data, VertexFormat::Float2);
+					cgltf_accessor_unpack_floats(attribute.data, &uvFloats[0].x, vertexCount * 2);
+					break;
+				case cgltf_attribute_type_color:
+					layout.color = GetGltfFormat(attribute.data, VertexFormat::Float3);
+					cgltf_accessor_unpack_floats(attribute.data, &colorFloats[0].x, vertexCount * 4);
+					for (u32 v = 0; v < vertexCount; ++v) {
+						colorRgb[v] = float3(colorFloats[v].x, colorFloats[v].y, colorFloats[v].z);
+					}
+					break;
+				case cgltf_attribute_type_custom:
+					cgltf_accessor_unpack_floats(attribute.data, &floats3[0].x, vertexCount * 3);
+					matches = memcmp(floats3.data(), expectedExp.data(), expectedExp.size() * sizeof(u32)) == 0;
+					break;
+				default:
+					break;
+				}
+			}
+
+			// through floats and back into the formats of the file, every byte has to be what was encoded, and
+			// positions have to come out of what the vertex shader does with them as the integers of the file
+			Data<u8> packedPositions(static_cast<size_t>(vertexCount) * positionLayout.Stride());
+			PackPositions(positionLayout, positionFloats, normalFloats, vertexCount, packedPositions);
+			for (u32 v = 0; v < vertexCount && matches; ++v) {
+				const u8* vertex = &packedPositions[static_cast<size_t>(v) * positionLayout.Stride()];
+				matches = memcmp(vertex + positionLayout.PositionOffset(), &quantizedPositions[v * 4], 4 * sizeof(i16)) == 0
+					&& memcmp(vertex + positionLayout.NormalOffset(), &expectedNormals[v * 4], 3) == 0;
+
+				i16 position[3];
+				memcpy(position, vertex + positionLayout.PositionOffset(), sizeof(position));
+				for (u32 c = 0; c < 3 && matches; ++c) {
+					const f32 snorm = std::max(position[c] / 32767.0f, -1.0f);
+					matches = RoundToInt(snorm * positionLayout.positionScale) == quantizedPositions[v * 4 + c];
+				}
+			}
+
+			Data<u8> packed(static_cast<size_t>(vertexCount) * layout.Stride());
+			PackAttributes(layout, tangentFloats, colorRgb, uvFloats, vertexCount, packed);
+			for (u32 v = 0; v < vertexCount && matches; ++v) {
+				const u8* vertex = &packed[static_cast<size_t>(v) * layout.Stride()];
+				matches = memcmp(vertex + layout.TangentOffset(), &expectedTangents[v * 4], 4) == 0
+					&& memcmp(vertex + layout.ColorOffset(), &unormColors[v * 4], 3) == 0
+					&& memcmp(vertex + layout.Uv0Offset(), &unormUvs[v * 2], 4) == 0;
+			}
+
+			// and back out of the packed streams, what the cpu side of a static mesh reads instead of keeping floats
+			Data<float3> unpackedPositions(vertexCount);
+			Data<float3> unpackedNormals(vertexCount);
+			Data<float2> unpackedUvs(vertexCount);
+			if (matches) {
+				UnpackPositions(positionLayout, packedPositions, 0, unpackedPositions, unpackedNormals);
+				UnpackUv0s(layout, packed, 0, unpackedUvs);
+				matches = memcmp(unpackedPositions.data(), positionFloats.data(), vertexCount * sizeof(float3)) == 0
+					&& memcmp(unpackedNormals.data(), normalFloats.data(), vertexCount * sizeof(float3)) == 0
+					&& memcmp(unpackedUvs.data(), uvFloats.data(), vertexCount * sizeof(float2)) == 0;
+			}
+
+			Data<u32> indices(gridIndices.size());
+			cgltf_accessor_unpack_indices(primitive.indices, indices.data(), sizeof(u32), indices.size());
+			for (size_t i = 0; i < indices.size() && matches; i += 3) {
+				matches = SameTriangle(&gridIndices[i], &indices[i]);
+			}
+		}
+		cgltf_free(data);
+
+		const u32 floatStride = FormatSize(VertexFormat::Float4) + FormatSize(VertexFormat::Float3) + FormatSize(VertexFormat::Float2);
+		const u32 floatPositionStride = PositionLayout{}.Stride();
+		spdlog::info("glb round trip, {:.2f} MB file for {:.2f} MB of views, decoded in {:.3f} ms on {} threads",
+			glb.size() / (1024.0 * 1024.0), fallbackSize / (1024.0 * 1024.0), decodeMs, global::jobSystem->GetThreadCount());
+		spdlog::info("    attribute stream tangent {} color {} uv0 {}, {} bytes a vertex instead of {}, {}",
+			FormatName(layout.tangent), FormatName(layout.color), FormatName(layout.uv0), layout.Stride(), floatStride, matches ? "matches" : "MISMATCH");
+		spdlog::info("    position stream position {} times {} normal {}, {} bytes a vertex instead of {}, {}",
+			FormatName(positionLayout.position), positionLayout.positionScale, FormatName(positionLayout.normal), positionLayout.Stride(),
+			floatPositionStride, matches ? "matches" : "MISMATCH");
+		passed &= matches;
+	}
+
+	spdlog::info("mesh compression checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "Math.hpp"
+#include "Core/MemoryTracker.hpp"
+
+#include <span>
+
+struct cgltf_data;
+struct cgltf_accessor;
+
+// EXT_meshopt_compression and KHR_mesh_quantization for MeshAsset::Load
+//
+// compressed buffer views are decoded into the memory cgltf reads accessors from, right after the buffers
+// load, so the importer reads them like any other view
+// the three codecs and three filters follow the extension, the encoders are here to write test files with
+//
+// quantized tangents, colors and uvs stay in their integer format all the way into the attribute stream of
+// DX11Mesh, the input assembler turns them back into floats
+// quantized positions and normals do the same in the position stream of static meshes, d3d11 has no scaled
+// integer formats so unnormalized positions go in as the normalized format of their type and the vertex shader
+// multiplies them back
+// MeshAsset keeps the packed streams and nothing else, the cpu systems that read static meshes (occlusion, the
+// software renderer) unpack the vertices they need into buffers of their own, only skinned and morphed meshes
+// keep float positions and normals since those are what the cpu deforms every frame
+namespace MeshCompression
+{
+	template<typename T>
+	using Data = TrackedVector<T, MemoryTag::Scratch>;
+
+	// same order as cgltf_meshopt_compression_filter
+	enum class Filter : u8 {
+		None,
+		// unit vectors as 4 8 or 16 bit integers, the 4th component is kept as is
+		Octahedral,
+		// unit quaternions as 4 16 bit integers
+		Quaternion,
+		// floats as 32 bit integers, 8 bit exponent and 24 bit mantissa
+		Exponential,
+	};
+
+	// count elements of stride bytes (a multiple of 4, at most 256) into out
+	// false when encoded isnt a vertex stream of that size, out is garbage then
+	bool DecodeVertexBuffer(void* out, u32 count, u32 stride, std::span<const u8> encoded);
+	// count is a multiple of 3, indexSize is 2 or 4
+	// triangles can come out rotated against what was encoded, the winding is the same
+	bool DecodeIndexBuffer(void* out, u32 count, u32 indexSize, std::span<const u8> encoded);
+	// any list of indices, in the same order, indexSize is 2 or 4
+	bool DecodeIndexSequence(void* out, u32 count, u32 indexSize, std::span<const u8> encoded);
+	// in place over count decoded elements of stride bytes
+	// octahedral needs stride 4 or 8, quaternion 8, exponential a multiple of 4
+	void DecodeFilter(Filter filter, void* data, u32 count, u32 stride);
+
+	void EncodeVertexBuffer(const void* vertices, u32 count, u32 stride, Data<u8>& out);
+	void EncodeIndexBuffer(std::span<const u32> indices, Data<u8>& out);
+	void EncodeIndexSequence(std::span<const u32> indices, Data<u8>& out);
+	// out has 4 (stride 4, bits up to 8) or 4 16 bit (stride 8, bits up to 16) integers per vector,
+	// w of each vector is stored as is
+	void EncodeFilterOctahedral(std::span<const float4> vectors, u32 stride, u32 bits, void* out);
+	// bits from 4 to 16
+	void EncodeFilterQuaternion(std::span<const float4> rotations, u32 bits, i16* out);
+	// bits of mantissa from 1 to 24
+	void EncodeFilterExponential(std::span<const f32> values, u32 bits, u32* out);
+
+	// decodes every view with EXT_meshopt_compression, the views run in parallel on the job system
+	// false if any of them fails, data still frees everything
+	bool DecodeGltfBufferViews(cgltf_data* data);
+
+	// how an attribute is stored in a vertex buffer
+	enum class VertexFormat : u8 {
+		Float2,
+		Float3,
+		Float4,
+		Unorm8x2,
+		Unorm8x4,
+		Unorm16x2,
+		Unorm16x4,
+		Snorm8x2,
+		Snorm8x4,
+		Snorm16x2,
+		Snorm16x4,
+	};
+
+	// bytes an attribute of the format takes in a vertex, padded to 4 for the input assembler
+	u32 FormatSize(VertexFormat format);
+
+	// the format that keeps a glTF attribute without losing anything, normalized integers keep their type
+	// (vec3 ones get a padding component) and everything else is floatFormat
+	VertexFormat GetGltfFormat(const cgltf_accessor* accessor, VertexFormat floatFormat);
+
+	// the attribute stream of DX11Mesh, every attribute in the format the file had it in
+	struct AttributeLayout {
+		VertexFormat tangent = VertexFormat::Float4;
+		VertexFormat color = VertexFormat::Float3;
+		VertexFormat uv0 = VertexFormat::Float2;
+
+		inline u32 TangentOffset() const { return 0; }
+		inline u32 ColorOffset() const { return TangentOffset() + FormatSize(tangent); }
+		inline u32 Uv0Offset() const { return ColorOffset() + FormatSize(color); }
+		inline u32 Stride() const { return Uv0Offset() + FormatSize(uv0); }
+	};
+
+	// the position stream of DX11Mesh, positions and normals in the formats the file had them in
+	struct PositionLayout {
+		VertexFormat position = VertexFormat::Float3;
+		VertexFormat normal = VertexFormat::Float3;
+		// what the vertex shader multiplies positions by, the largest value of the type for unnormalized integers
+		// and 1 otherwise
+		f32 positionScale = 1.0f;
+
+		inline u32 PositionOffset() const { return 0; }
+		inline u32 NormalOffset() const { return PositionOffset() + FormatSize(position); }
+		inline u32 Stride() const { return NormalOffset() + FormatSize(normal); }
+	};
+
+	// GetGltfFormat for positions, unnormalized 8 and 16 bit integers of KHR_mesh_quantization become the
+	// normalized format of their type with a positionScale, -32768 and -128 come back one higher but
+	// quantizers keep to the symmetric range anyway
+	VertexFormat GetGltfPositionFormat(const cgltf_accessor* accessor, f32& outPositionScale);
+
+	// interleaves count positions and normals into out (count * layout.Stride() bytes), integers that went
+	// through cgltf_accessor_unpack_floats come back out bit exact, empty normals are 0
+	void PackPositions(const PositionLayout& layout, std::span<const float3> positions, std::span<const float3> normals,
+		u32 count, std::span<u8> out);
+
+	// interleaves count vertices into out (count * layout.Stride() bytes)
+	// normalized integers that went through cgltf_accessor_unpack_floats come back out bit exact
+	// empty tangents are +x with a w of 1 and empty colors 0, like DX11Mesh always did
+	void PackAttributes(const AttributeLayout& layout, std::span<const float4> tangents, std::span<const float3> colors,
+		std::span<const float2> uv0s, u32 count, std::span<u8> out);
+
+	// the other way, vertices first to first + out.size() of a stream PackPositions wrote, either span can be
+	// empty, gives back the floats that were packed bit exact when they came out of cgltf_accessor_unpack_floats
+	void UnpackPositions(const PositionLayout& layout, std::span<const u8> stream, u32 first, std::span<float3> positions, std::span<float3> normals);
+	// the same for the uv0s of a stream PackAttributes wrote
+	void UnpackUv0s(const AttributeLayout& layout, std::span<const u8> stream, u32 first, std::span<float2> uv0s);
+
+	// decode throughput of every codec and filter on a generated mesh, checked against what was encoded,
+	// then the same streams written into a glb, read back through cgltf like MeshAsset::Load does and unpacked again
+	bool RunBenchmark();
+}
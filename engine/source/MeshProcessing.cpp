@@ -0,0 +1,1075 @@
+#include "MeshProcessing.hpp"
+
+#include "AssetSystem.hpp"
+#include "Core/Hash.hpp"
+#include "Core/JobSystem.hpp"
+#include "Core/Log.hpp"
+#include "Core/MemoryTracker.hpp"
+#include "Core/Profiler.hpp"
+
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <optional>
+#include <xmmintrin.h>
+
+template<typename T>
+using Data = TrackedVector<T, MemoryTag::Scratch>;
+
+static constexpr u32 TrianglesPerJob = 4096;
+static constexpr u32 VerticesPerJob = 8192;
+static constexpr u32 CornersPerJob = 16384;
+// how many items ahead the hash table loops load their slot
+static constexpr u32 PrefetchDistance = 16;
+// jobs of FindFirstDuplicates are big enough that most duplicates land in the same one, and each remembers
+// the last item at this many hashes
+static constexpr u32 ItemsPerDuplicateJob = 65536;
+static constexpr u32 RecentSize = 16384;
+
+// how far a triangle can face away from the rest of its meshlet, about 60 degrees
+// wider cones almost never cull, narrower ones make lots of tiny meshlets on low poly meshes
+static constexpr f32 MeshletMinNormalDot = 0.5f;
+
+// anything shorter than this is degenerate
+static constexpr f32 s_epsilon = 1e-20f;
+
+static float3 Add(const float3& a, const float3& b) { return float3(a.x + b.x, a.y + b.y, a.z + b.z); }
+static float3 Sub(const float3& a, const float3& b) { return float3(a.x - b.x, a.y - b.y, a.z - b.z); }
+static float3 Scale(const float3& a, f32 s) { return float3(a.x * s, a.y * s, a.z * s); }
+static f32 Dot(const float3& a, const float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static f32 Length(const float3& a) { return std::sqrt(Dot(a, a)); }
+
+static float3 Cross(const float3& a, const float3& b)
+{
+	return float3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+// false and zero for degenerate vectors
+static bool Normalize(float3& v)
+{
+	const f32 length = Length(v);
+	if (!(length > s_epsilon)) {
+		v = float3(0.0f, 0.0f, 0.0f);
+		return false;
+	}
+	v = Scale(v, 1.0f / length);
+	return true;
+}
+
+// v with the part along the unit vector n removed
+static float3 Reject(const float3& v, const float3& n)
+{
+	return Sub(v, Scale(n, Dot(v, n)));
+}
+
+// angle between two vectors, atan2 holds up better than acos for small and large angles
+static f32 Angle(const float3& a, const float3& b)
+{
+	return std::atan2(Length(Cross(a, b)), Dot(a, b));
+}
+
+// any unit vector perpendicular to the unit vector n
+static float3 Perpendicular(const float3& n)
+{
+	const float3 axis = std::abs(n.x) < 0.9f ? float3(1.0f, 0.0f, 0.0f) : float3(0.0f, 1.0f, 0.0f);
+	float3 result = Cross(n, axis);
+	if (!Normalize(result)) {
+		return float3(1.0f, 0.0f, 0.0f);
+	}
+	return result;
+}
+
+static bool ValidateIndices(std::span<const u32> indices, size_t vertexCount, const char* what)
+{
+	if (indices.size() % 3 != 0) {
+		LOG_ERROR("{}: {} indices is not a triangle list", what, indices.size());
+		return false;
+	}
+
+	for (u32 index : indices) {
+		if (index >= vertexCount) {
+			LOG_ERROR("{}: index {} out of range, {} vertices", what, index, vertexCount);
+			return false;
+		}
+	}
+	return true;
+}
+
+// corners of each key in triangle order, the corners of key k are corners[offsets[k]] to corners[offsets[k + 1]]
+// a corner is triangle * 3 + vertex of the triangle
+struct Adjacency {
+	Data<u32> offsets;
+	Data<u32> corners;
+};
+
+// a counting sort with atomics, the corners land in whatever order the threads got to them so each
+// key is sorted after, thats cheap since a vertex only has a handful
+static void BuildAdjacency(std::span<const u32> cornerKeys, u32 keyCount, Adjacency& out)
+{
+	PROFILE_ZONE("BuildAdjacency");
+
+	const u32 cornerCount = static_cast<u32>(cornerKeys.size());
+
+	out.offsets.assign(keyCount + 1, 0);
+	global::jobSystem->ParallelFor(cornerCount, CornersPerJob, [&](u32 begin, u32 end) {
+		for (u32 c = begin; c < end; ++c) {
+			std::atomic_ref<u32>(out.offsets[cornerKeys[c] + 1]).fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+
+	for (u32 k = 0; k < keyCount; ++k) {
+		out.offsets[k + 1] += out.offsets[k];
+	}
+
+	Data<u32> cursor(out.offsets.begin(), out.offsets.end() - 1);
+	out.corners.resize(cornerCount);
+	global::jobSystem->ParallelFor(cornerCount, CornersPerJob, [&](u32 begin, u32 end) {
+		for (u32 c = begin; c < end; ++c) {
+			const u32 slot = std::atomic_ref<u32>(cursor[cornerKeys[c]]).fetch_add(1, std::memory_order_relaxed);
+			out.corners[slot] = c;
+		}
+	});
+
+	global::jobSystem->ParallelFor(keyCount, VerticesPerJob, [&](u32 begin, u32 end) {
+		for (u32 k = begin; k < end; ++k) {
+			const auto first = out.corners.begin() + out.offsets[k];
+			const auto last = out.corners.begin() + out.offsets[k + 1];
+			// always the case with one thread
+			if (!std::is_sorted(first, last)) {
+				std::sort(first, last);
+			}
+		}
+	});
+}
+
+static u32 MixHash(u32 hash)
+{
+	// the low bits pick the slot, mix the high ones down
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	return hash;
+}
+
+// -0 turns into 0, they compare equal so they have to hash the same
+static u32 FloatBits(f32 value)
+{
+	const u32 bits = std::bit_cast<u32>(value);
+	return bits == 0x80000000u ? 0u : bits;
+}
+
+// for every item the lowest index equal to it
+//
+// duplicates are mostly close in the buffer, the corners of a vertex are a few rows of triangles apart, so each
+// job first remembers the last items it saw at a few thousand hashes and most items find an equal one there,
+// only the ones that dont are kept in a list per job with their hash and go into the shared table, which then
+// is a fraction of the items and never looks at the rest of them
+//
+// the shared table is open addressing filled by all threads at once, a slot holds some item of its group and
+// gets swapped for lower ones as they show up, the lowest item of a group has nothing earlier to find so it
+// always goes in, and once its filled the slots hold the lowest of each group whatever order the threads ran in
+//
+// hashFunc(i) is called once per item, right before the item is looked for so whatever it read is still in cache
+// for the compare, equal(a, b) is only called with matching hashes and never with a == b
+template<typename Hash, typename Equal>
+static void FindFirstDuplicates(u32 count, Hash&& hashFunc, Equal&& equal, Data<u32>& outFirst)
+{
+	// hash << 32 | index, the hash next to the index so running into other items doesnt have to look at them
+	constexpr u64 emptySlot = ~0ull;
+	// until resolved an item holds an earlier equal item of its job, or this bit and its slot in the table
+	constexpr u32 inTable = 1u << 31;
+
+	ENSURE(count < inTable, "FindFirstDuplicates takes less than 2^31 items");
+	outFirst.resize(count);
+
+	// the items each job couldnt find in its recent ones, in index order
+	const u32 jobCount = (count + ItemsPerDuplicateJob - 1) / ItemsPerDuplicateJob;
+	TrackedVector<Data<u64>, MemoryTag::Scratch> missed(jobCount);
+	std::atomic<u32> tableItems = 0;
+
+	global::jobSystem->ParallelFor(count, ItemsPerDuplicateJob, [&](u32 begin, u32 end) {
+		PROFILE_ZONE("FindRecentDuplicates");
+		Data<u64> recent(RecentSize, emptySlot);
+		Data<u64>& jobMissed = missed[begin / ItemsPerDuplicateJob];
+		for (u32 i = begin; i < end; ++i) {
+			const u32 hash = hashFunc(i);
+			u64& seen = recent[hash & (RecentSize - 1)];
+			if (seen != emptySlot && static_cast<u32>(seen >> 32) == hash && equal(static_cast<u32>(seen), i)) {
+				outFirst[i] = static_cast<u32>(seen);
+				continue;
+			}
+			seen = static_cast<u64>(hash) << 32 | i;
+			jobMissed.push_back(seen);
+		}
+		tableItems.fetch_add(static_cast<u32>(jobMissed.size()), std::memory_order_relaxed);
+	});
+
+	// at most two thirds full even with no duplicates at all
+	const u32 tableSize = std::bit_ceil(std::max(tableItems.load() + tableItems.load() / 2, 16u));
+	const u32 mask = tableSize - 1;
+	Data<u64> table(tableSize, emptySlot);
+
+	global::jobSystem->ParallelFor(jobCount, 1, [&](u32 beginJob, u32 endJob) {
+		for (u32 job = beginJob; job < endJob; ++job) {
+			const Data<u64>& items = missed[job];
+			const u32 itemCount = static_cast<u32>(items.size());
+			for (u32 k = 0; k < itemCount; ++k) {
+				// the slot is a miss almost every time, start loading the one a few items ahead
+				if (k + PrefetchDistance < itemCount) {
+					_mm_prefetch(reinterpret_cast<const char*>(&table[(items[k + PrefetchDistance] >> 32) & mask]), _MM_HINT_T0);
+				}
+
+				const u64 entry = items[k];
+				const u32 hash = static_cast<u32>(entry >> 32);
+				const u32 i = static_cast<u32>(entry);
+				u32 slot = hash & mask;
+				while (true) {
+					std::atomic_ref<u64> current(table[slot]);
+					u64 other = current.load(std::memory_order_relaxed);
+					if (other == emptySlot) {
+						if (current.compare_exchange_strong(other, entry, std::memory_order_relaxed)) {
+							break;
+						}
+						// someone else took it, look at what they put there
+						continue;
+					}
+					if (static_cast<u32>(other >> 32) == hash && equal(static_cast<u32>(other), i)) {
+						// only items of this group ever replace this one, a failed exchange reloads other
+						while (entry < other && !current.compare_exchange_weak(other, entry, std::memory_order_relaxed)) {}
+						break;
+					}
+					slot = (slot + 1) & mask;
+				}
+				outFirst[i] = inTable | slot;
+			}
+		}
+	});
+
+	// the same jobs as the first pass, so the earlier item an item found there is resolved before it
+	global::jobSystem->ParallelFor(count, ItemsPerDuplicateJob, [&](u32 begin, u32 end) {
+		for (u32 i = begin; i < end; ++i) {
+			if (i + PrefetchDistance < end && (outFirst[i + PrefetchDistance] & inTable) != 0) {
+				_mm_prefetch(reinterpret_cast<const char*>(&table[outFirst[i + PrefetchDistance] & ~inTable]), _MM_HINT_T0);
+			}
+			const u32 first = outFirst[i];
+			outFirst[i] = (first & inTable) != 0 ? static_cast<u32>(table[first & ~inTable]) : outFirst[first];
+		}
+	});
+}
+
+// the first vertex at each position
+static void RemapByPosition(std::span<const float3> positions, Data<u32>& outRemap)
+{
+	PROFILE_ZONE("RemapByPosition");
+
+	const u32 vertexCount = static_cast<u32>(positions.size());
+	FindFirstDuplicates(vertexCount, [&](u32 v) {
+		const float3& p = positions[v];
+		return MixHash(FloatBits(p.x) * 0x8da6b343u ^ FloatBits(p.y) * 0xd8163841u ^ FloatBits(p.z) * 0xcb1ab31fu);
+	}, [&](u32 a, u32 b) {
+		return positions[a].x == positions[b].x && positions[a].y == positions[b].y && positions[a].z == positions[b].z;
+	}, outRemap);
+}
+
+void MeshProcessing::GenerateNormals(std::span<const float3> positions, std::span<const u32> indices, NormalWeighting weighting, std::span<float3> outNormals)
+{
+	PROFILE_ZONE("MeshProcessing::GenerateNormals");
+
+	const u32 vertexCount = static_cast<u32>(positions.size());
+	const u32 triangleCount = static_cast<u32>(indices.size() / 3);
+
+	if (outNormals.size() != vertexCount) {
+		ENSURE(false, "GenerateNormals needs a normal per position");
+		return;
+	}
+
+	const float3 fallback = float3(0.0f, 1.0f, 0.0f);
+	if (!ValidateIndices(indices, vertexCount, "GenerateNormals")) {
+		std::fill(outNormals.begin(), outNormals.end(), fallback);
+		return;
+	}
+
+	Data<u32> remap;
+	RemapByPosition(positions, remap);
+
+	// the weighted face normal at each corner, and the vertex it adds to
+	Data<float3> cornerNormals(indices.size());
+	Data<u32> cornerKeys(indices.size());
+
+	global::jobSystem->ParallelFor(triangleCount, TrianglesPerJob, [&](u32 begin, u32 end) {
+		PROFILE_ZONE("FaceNormals");
+		for (u32 t = begin; t < end; ++t) {
+			const u32* triangle = &indices[t * 3];
+			const float3 p[3] = { positions[triangle[0]], positions[triangle[1]], positions[triangle[2]] };
+
+			// twice the area long
+			const float3 faceNormal = Cross(Sub(p[1], p[0]), Sub(p[2], p[0]));
+
+			for (u32 k = 0; k < 3; ++k) {
+				cornerKeys[t * 3 + k] = remap[triangle[k]];
+			}
+
+			if (weighting == NormalWeighting::Area) {
+				for (u32 k = 0; k < 3; ++k) {
+					cornerNormals[t * 3 + k] = faceNormal;
+				}
+				continue;
+			}
+
+			float3 unitNormal = faceNormal;
+			Normalize(unitNormal);
+
+			// the angle at corner k is between the edges to the other two corners
+			for (u32 k = 0; k < 3; ++k) {
+				const f32 angle = Angle(Sub(p[(k + 1) % 3], p[k]), Sub(p[(k + 2) % 3], p[k]));
+				cornerNormals[t * 3 + k] = Scale(unitNormal, angle);
+			}
+		}
+	});
+
+	Adjacency adjacency;
+	BuildAdjacency(cornerKeys, vertexCount, adjacency);
+
+	// only the first vertex at each position has corners, the rest copy it once its done
+	global::jobSystem->ParallelFor(vertexCount, VerticesPerJob, [&](u32 begin, u32 end) {
+		PROFILE_ZONE("VertexNormals");
+		for (u32 v = begin; v < end; ++v) {
+			if (remap[v] != v) {
+				continue;
+			}
+
+			float3 sum = float3(0.0f, 0.0f, 0.0f);
+			for (u32 i = adjacency.offsets[v]; i < adjacency.offsets[v + 1]; ++i) {
+				sum = Add(sum, cornerNormals[adjacency.corners[i]]);
+			}
+			outNormals[v] = Normalize(sum) ? sum : fallback;
+		}
+	});
+
+	global::jobSystem->ParallelFor(vertexCount, VerticesPerJob, [&](u32 begin, u32 end) {
+		for (u32 v = begin; v < end; ++v) {
+			outNormals[v] = outNormals[remap[v]];
+		}
+	});
+}
+
+void MeshProcessing::GenerateTangents(std::span<const float3> positions, std::span<const float3> normals, std::span<const float2> uvs, std::span<u32> indices,
+	std::span<float4> outTangents, TrackedVector<TangentSplit, MemoryTag::Scratch>& outSplits)
+{
+	PROFILE_ZONE("MeshProcessing::GenerateTangents");
+
+	const u32 vertexCount = static_cast<u32>(positions.size());
+	const u32 triangleCount = static_cast<u32>(indices.size() / 3);
+
+	if (normals.size() != vertexCount || uvs.size() != vertexCount || outTangents.size() != vertexCount) {
+		ENSURE(false, "GenerateTangents needs a normal, uv and tangent per position");
+		return;
+	}
+
+	if (!ValidateIndices(indices, vertexCount, "GenerateTangents")) {
+		for (u32 v = 0; v < vertexCount; ++v) {
+			const float3 tangent = Perpendicular(normals[v]);
+			outTangents[v] = float4(tangent.x, tangent.y, tangent.z, 1.0f);
+		}
+		return;
+	}
+
+	// xyz the face tangent in the vertex normal plane weighted by the corner angle, w the uv orientation
+	// of the triangle, 0 if it adds nothing
+	Data<float4> cornerTangents(indices.size());
+
+	global::jobSystem->ParallelFor(triangleCount, TrianglesPerJob, [&](u32 begin, u32 end) {
+		PROFILE_ZONE("FaceTangents");
+		for (u32 t = begin; t < end; ++t) {
+			const u32* triangle = &indices[t * 3];
+			const float3 p[3] = { positions[triangle[0]], positions[triangle[1]], positions[triangle[2]] };
+			const float2 uv[3] = { uvs[triangle[0]], uvs[triangle[1]], uvs[triangle[2]] };
+
+			const float3 d1 = Sub(p[1], p[0]);
+			const float3 d2 = Sub(p[2], p[0]);
+			const float2 st1 = float2(uv[1].x - uv[0].x, uv[1].y - uv[0].y);
+			const float2 st2 = float2(uv[2].x - uv[0].x, uv[2].y - uv[0].y);
+
+			// dp/du scaled by the signed uv area, the sign flips it back for mirrored uvs
+			const f32 signedUvArea = st1.x * st2.y - st1.y * st2.x;
+			const f32 orientation = signedUvArea > 0.0f ? 1.0f : -1.0f;
+			float3 faceTangent = Scale(Sub(Scale(d1, st2.y), Scale(d2, st1.y)), orientation);
+
+			const bool degenerate = !(std::abs(signedUvArea) > s_epsilon) || !Normalize(faceTangent);
+
+			for (u32 k = 0; k < 3; ++k) {
+				float4& corner = cornerTangents[t * 3 + k];
+				corner = float4(0.0f, 0.0f, 0.0f, 0.0f);
+				if (degenerate) {
+					continue;
+				}
+
+				const float3& n = normals[triangle[k]];
+				float3 tangent = Reject(faceTangent, n);
+				float3 edge1 = Reject(Sub(p[(k + 1) % 3], p[k]), n);
+				float3 edge2 = Reject(Sub(p[(k + 2) % 3], p[k]), n);
+				if (!Normalize(tangent) || !Normalize(edge1) || !Normalize(edge2)) {
+					continue;
+				}
+
+				const f32 angle = Angle(edge1, edge2);
+				corner = float4(tangent.x * angle, tangent.y * angle, tangent.z * angle, orientation);
+			}
+		}
+	});
+
+	Adjacency adjacency;
+	BuildAdjacency(indices, vertexCount, adjacency);
+
+	// the tangent of the side that lost, w is 0 when the vertex isnt split
+	Data<float4> splitTangents(vertexCount);
+
+	global::jobSystem->ParallelFor(vertexCount, VerticesPerJob, [&](u32 begin, u32 end) {
+		PROFILE_ZONE("VertexTangents");
+		for (u32 v = begin; v < end; ++v) {
+			// both orientations added up separately, the one with more weight keeps the vertex
+			float3 sums[2] = { float3(0.0f, 0.0f, 0.0f), float3(0.0f, 0.0f, 0.0f) };
+			f32 weights[2] = { 0.0f, 0.0f };
+			for (u32 i = adjacency.offsets[v]; i < adjacency.offsets[v + 1]; ++i) {
+				const float4& corner = cornerTangents[adjacency.corners[i]];
+				if (corner.w == 0.0f) {
+					continue;
+				}
+				const u32 side = corner.w > 0.0f ? 0 : 1;
+				const float3 tangent = float3(corner.x, corner.y, corner.z);
+				sums[side] = Add(sums[side], tangent);
+				weights[side] += Length(tangent);
+			}
+
+			const u32 side = weights[0] >= weights[1] ? 0 : 1;
+			float3 tangent = sums[side];
+			f32 sign = side == 0 ? 1.0f : -1.0f;
+			if (!Normalize(tangent)) {
+				tangent = Perpendicular(normals[v]);
+				sign = 1.0f;
+			}
+			outTangents[v] = float4(tangent.x, tangent.y, tangent.z, sign);
+
+			float3 other = sums[1 - side];
+			splitTangents[v] = weights[1 - side] > 0.0f && Normalize(other) ? float4(other.x, other.y, other.z, -sign) : float4(0.0f, 0.0f, 0.0f, 0.0f);
+		}
+	});
+
+	// in vertex order so the new vertices come out the same whatever the thread count
+	outSplits.clear();
+	Data<u32> splitVertices(vertexCount, 0);
+	for (u32 v = 0; v < vertexCount; ++v) {
+		if (splitTangents[v].w != 0.0f) {
+			splitVertices[v] = vertexCount + static_cast<u32>(outSplits.size());
+			outSplits.push_back(TangentSplit{ .vertex = v, .tangent = splitTangents[v] });
+		}
+	}
+
+	if (outSplits.empty()) {
+		return;
+	}
+
+	// every corner belongs to one vertex, so the vertices can rewrite theirs side by side
+	global::jobSystem->ParallelFor(vertexCount, VerticesPerJob, [&](u32 begin, u32 end) {
+		for (u32 v = begin; v < end; ++v) {
+			if (splitTangents[v].w == 0.0f) {
+				continue;
+			}
+			for (u32 i = adjacency.offsets[v]; i < adjacency.offsets[v + 1]; ++i) {
+				const u32 corner = adjacency.corners[i];
+				if (cornerTangents[corner].w == splitTangents[v].w) {
+					indices[corner] = splitVertices[v];
+				}
+			}
+		}
+	});
+}
+
+// the value a component is compared by, inverseEpsilon is 0 for bit exact
+static f32 WeldKey(f32 value, f32 inverseEpsilon)
+{
+	if (inverseEpsilon == 0.0f) {
+		return value;
+	}
+	return std::floor(value * inverseEpsilon + 0.5f);
+}
+
+u32 MeshProcessing::WeldVertices(std::span<const WeldStream> streams, u32 vertexCount, std::span<u32> indices)
+{
+	PROFILE_ZONE("MeshProcessing::WeldVertices");
+
+	if (!ValidateIndices(indices, vertexCount, "WeldVertices")) {
+		return vertexCount;
+	}
+
+	Data<f32> inverseEpsilons(streams.size());
+	for (size_t s = 0; s < streams.size(); ++s) {
+		ENSURE(streams[s].data != nullptr && streams[s].components > 0, "WeldVertices streams need data");
+		inverseEpsilons[s] = streams[s].epsilon > 0.0f ? 1.0f / streams[s].epsilon : 0.0f;
+	}
+
+	Data<u32> remap;
+	FindFirstDuplicates(vertexCount, [&](u32 v) {
+		u32 hash = 0;
+		for (size_t s = 0; s < streams.size(); ++s) {
+			const f32* values = streams[s].data + static_cast<size_t>(v) * streams[s].components;
+			// most streams are bit exact, checking that per stream instead of per component is a good part of the loop
+			if (inverseEpsilons[s] == 0.0f) {
+				for (u32 c = 0; c < streams[s].components; ++c) {
+					hash = (hash ^ FloatBits(values[c])) * 0x9e3779b1u;
+					hash ^= hash >> 15;
+				}
+			} else {
+				for (u32 c = 0; c < streams[s].components; ++c) {
+					hash = (hash ^ FloatBits(WeldKey(values[c], inverseEpsilons[s]))) * 0x9e3779b1u;
+					hash ^= hash >> 15;
+				}
+			}
+		}
+		return MixHash(hash);
+	}, [&](u32 a, u32 b) {
+		for (size_t s = 0; s < streams.size(); ++s) {
+			const u32 components = streams[s].components;
+			const f32* valuesA = streams[s].data + static_cast<size_t>(a) * components;
+			const f32* valuesB = streams[s].data + static_cast<size_t>(b) * components;
+			for (u32 c = 0; c < components; ++c) {
+				// split vertices are mostly exact copies, equal values always have equal keys
+				if (valuesA[c] != valuesB[c] && FloatBits(WeldKey(valuesA[c], inverseEpsilons[s])) != FloatBits(WeldKey(valuesB[c], inverseEpsilons[s]))) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}, remap);
+
+	// first vertices take the next slot, the rest take their first vertexs, which is lower so already renumbered
+	u32 weldedCount = 0;
+	for (u32 v = 0; v < vertexCount; ++v) {
+		remap[v] = remap[v] == v ? weldedCount++ : remap[remap[v]];
+	}
+
+	if (weldedCount == vertexCount) {
+		return vertexCount;
+	}
+
+	global::jobSystem->ParallelFor(static_cast<u32>(indices.size()), CornersPerJob, [&](u32 begin, u32 end) {
+		for (u32 i = begin; i < end; ++i) {
+			indices[i] = remap[indices[i]];
+		}
+	});
+
+	// a vertex is first in its group when it got the next slot, slots only go down so moving forward
+	// never overwrites anything still to be read
+	global::jobSystem->ParallelFor(static_cast<u32>(streams.size()), 1, [&](u32 begin, u32 end) {
+		PROFILE_ZONE("CompactStream");
+		for (u32 s = begin; s < end; ++s) {
+			const size_t stride = streams[s].components;
+			f32* data = streams[s].data;
+			u32 next = 0;
+			for (u32 v = 0; v < vertexCount; ++v) {
+				if (remap[v] == next) {
+					std::copy_n(data + v * stride, stride, data + next * stride);
+					++next;
+				}
+			}
+		}
+	});
+
+	return weldedCount;
+}
+
+// sphere around the box of the corners and the cone of the face normals
+static void ComputeMeshletBounds(std::span<const float3> positions, std::span<const u32> indices, MeshProcessing::Meshlet& meshlet)
+{
+	// not the tightest sphere but meshlets are small and roughly round, so its close
+	float3 boundsMin = positions[indices[0]];
+	float3 boundsMax = boundsMin;
+	for (u32 index : indices) {
+		const float3& p = positions[index];
+		boundsMin = float3(std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z));
+		boundsMax = float3(std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z));
+	}
+	meshlet.center = Scale(Add(boundsMin, boundsMax), 0.5f);
+	meshlet.radius = 0.0f;
+	for (u32 index : indices) {
+		meshlet.radius = std::max(meshlet.radius, Length(Sub(positions[index], meshlet.center)));
+	}
+
+	// never culled unless the normals say otherwise
+	meshlet.coneApex = meshlet.center;
+	meshlet.coneAxis = float3(0.0f, 0.0f, 1.0f);
+	meshlet.coneCutoff = 2.0f;
+
+	// front facing normals and a corner of their triangle, degenerate triangles dont draw anything so they dont count
+	std::array<float3, MeshProcessing::MaxMeshletTriangles> normals;
+	std::array<float3, MeshProcessing::MaxMeshletTriangles> corners;
+	u32 normalCount = 0;
+	float3 axis = float3(0.0f, 0.0f, 0.0f);
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		const float3& p0 = positions[indices[i]];
+		float3 normal = Cross(Sub(positions[indices[i + 1]], p0), Sub(positions[indices[i + 2]], p0));
+		if (Normalize(normal)) {
+			normals[normalCount] = normal;
+			corners[normalCount] = p0;
+			++normalCount;
+			axis = Add(axis, normal);
+		}
+	}
+	if (!Normalize(axis)) {
+		return;
+	}
+
+	f32 minDot = 1.0f;
+	for (u32 i = 0; i < normalCount; ++i) {
+		minDot = std::min(minDot, Dot(normals[i], axis));
+	}
+	// spread over a half space or more, some triangle always faces the camera
+	if (minDot <= 0.0f) {
+		return;
+	}
+
+	// the apex goes behind every triangles plane, then any camera in the cone sees all of them from behind
+	f32 apexDistance = -std::numeric_limits<f32>::max();
+	for (u32 i = 0; i < normalCount; ++i) {
+		apexDistance = std::max(apexDistance, Dot(Sub(meshlet.center, corners[i]), normals[i]) / Dot(axis, normals[i]));
+	}
+
+	meshlet.coneApex = Sub(meshlet.center, Scale(axis, apexDistance));
+	meshlet.coneAxis = axis;
+	// sin of the spread, nudged up a little so float error never culls an edge on triangle
+	meshlet.coneCutoff = std::min(std::sqrt(1.0f - minDot * minDot) + 1e-3f, 1.0f);
+}
+
+void MeshProcessing::BuildMeshlets(std::span<const float3> positions, std::span<u32> indices, TrackedVector<Meshlet, MemoryTag::AssetsMesh>& outMeshlets)
+{
+	PROFILE_ZONE("MeshProcessing::BuildMeshlets");
+
+	outMeshlets.clear();
+
+	const u32 vertexCount = static_cast<u32>(positions.size());
+	const u32 triangleCount = static_cast<u32>(indices.size() / 3);
+	if (!ValidateIndices(indices, vertexCount, "BuildMeshlets")) {
+		return;
+	}
+
+	// neighbours through shared positions, flat shaded and uv split meshes would fall apart into single faces otherwise
+	// the vertex limit still counts real vertices
+	Data<u32> remap;
+	RemapByPosition(positions, remap);
+	Data<u32> cornerKeys(indices.size());
+	global::jobSystem->ParallelFor(static_cast<u32>(indices.size()), CornersPerJob, [&](u32 begin, u32 end) {
+		for (u32 c = begin; c < end; ++c) {
+			cornerKeys[c] = remap[indices[c]];
+		}
+	});
+
+	Adjacency adjacency;
+	BuildAdjacency(cornerKeys, vertexCount, adjacency);
+
+	Data<float3> faceNormals(triangleCount);
+	global::jobSystem->ParallelFor(triangleCount, TrianglesPerJob, [&](u32 begin, u32 end) {
+		for (u32 t = begin; t < end; ++t) {
+			const float3& p0 = positions[indices[t * 3]];
+			faceNormals[t] = Cross(Sub(positions[indices[t * 3 + 1]], p0), Sub(positions[indices[t * 3 + 2]], p0));
+			Normalize(faceNormals[t]);
+		}
+	});
+
+	Data<u32> reordered;
+	reordered.reserve(indices.size());
+	Data<u8> used(triangleCount, 0);
+
+	// the meshlet that last touched each vertex and triangle, 0 for none
+	Data<u32> vertexMeshlet(vertexCount, 0);
+	Data<u32> triangleMeshlet(triangleCount, 0);
+	// corners of the triangle not in the current meshlet yet, only valid while triangleMeshlet is current
+	Data<u8> missing(triangleCount);
+
+	// triangles touching the current meshlet by how many vertices they would add, read front to back
+	// so the meshlet grows out evenly, a triangle moves to a lower list as its corners get added and
+	// the entries it leaves behind are skipped
+	// the last list is triangles that only share a position with the meshlet, not a vertex
+	std::array<Data<u32>, 4> candidates;
+	std::array<u32, 4> heads = {};
+
+	u32 meshletStamp = 0;
+	auto addVertex = [&](u32 v) {
+		vertexMeshlet[v] = meshletStamp;
+		const u32 key = remap[v];
+		for (u32 i = adjacency.offsets[key]; i < adjacency.offsets[key + 1]; ++i) {
+			const u32 corner = adjacency.corners[i];
+			const u32 t = corner / 3;
+			if (used[t]) {
+				continue;
+			}
+			if (triangleMeshlet[t] != meshletStamp) {
+				triangleMeshlet[t] = meshletStamp;
+				missing[t] = 3;
+			}
+			if (indices[corner] == v) {
+				--missing[t];
+			}
+			candidates[missing[t]].push_back(t);
+		}
+	};
+
+	u32 seedCursor = 0;
+	while (reordered.size() < indices.size()) {
+		// whatever the last meshlet left on its border, so the next one grows next to it
+		u32 t = ~0u;
+		for (u32 k = 0; k < candidates.size() && t == ~0u; ++k) {
+			for (; heads[k] < candidates[k].size(); ++heads[k]) {
+				if (!used[candidates[k][heads[k]]]) {
+					t = candidates[k][heads[k]];
+					break;
+				}
+			}
+		}
+		if (t == ~0u) {
+			while (used[seedCursor]) {
+				++seedCursor;
+			}
+			t = seedCursor;
+		}
+
+		for (u32 k = 0; k < candidates.size(); ++k) {
+			candidates[k].clear();
+			heads[k] = 0;
+		}
+		++meshletStamp;
+
+		Meshlet meshlet = {};
+		meshlet.indexOffset = static_cast<u32>(reordered.size());
+		// sum of the face normals so far, candidates too far off it would widen the cone past being useful
+		float3 normalSum = float3(0.0f, 0.0f, 0.0f);
+
+		while (true) {
+			used[t] = 1;
+			for (u32 k = 0; k < 3; ++k) {
+				const u32 v = indices[t * 3 + k];
+				reordered.push_back(v);
+				if (vertexMeshlet[v] != meshletStamp) {
+					addVertex(v);
+					++meshlet.vertexCount;
+				}
+			}
+			++meshlet.triangleCount;
+			normalSum = Add(normalSum, faceNormals[t]);
+			if (meshlet.triangleCount == MaxMeshletTriangles) {
+				break;
+			}
+
+			// fewest new vertices first, a triangle that would go over the limit is dropped until it needs fewer
+			float3 axis = normalSum;
+			const bool hasAxis = Normalize(axis);
+			t = ~0u;
+			for (u32 k = 0; k < candidates.size() && t == ~0u; ++k) {
+				while (heads[k] < candidates[k].size()) {
+					const u32 candidate = candidates[k][heads[k]++];
+					if (used[candidate] || missing[candidate] != k || meshlet.vertexCount + k > MaxMeshletVertices) {
+						continue;
+					}
+					// degenerate triangles have a zero normal and go anywhere
+					const float3& normal = faceNormals[candidate];
+					const bool degenerate = normal.x == 0.0f && normal.y == 0.0f && normal.z == 0.0f;
+					if (!hasAxis || degenerate || Dot(normal, axis) >= MeshletMinNormalDot) {
+						t = candidate;
+						break;
+					}
+				}
+			}
+			if (t == ~0u) {
+				break;
+			}
+		}
+
+		ComputeMeshletBounds(positions, std::span<const u32>(reordered).subspan(meshlet.indexOffset, meshlet.triangleCount * 3), meshlet);
+		outMeshlets.push_back(meshlet);
+	}
+
+	std::copy(reordered.begin(), reordered.end(), indices.begin());
+}
+
+//
+// benchmark
+//
+
+struct BenchmarkMesh {
+	std::string name;
+	Data<float3> positions;
+	Data<float2> uvs;
+	Data<u32> indices;
+	// what the generated ones are compared against, only the torus has them
+	// suzanne is flat shaded, its authored normals say nothing about smooth ones
+	Data<float3> normals;
+	Data<float3> tangents;
+	Data<float3> bitangents;
+	// how many vertices have to split for their tangents, only known for the generated meshes
+	std::optional<u32> expectedSplits;
+};
+
+// seams on both u and v get their own vertices, like an exported mesh would have
+static void BuildTorus(u32 segmentsU, u32 segmentsV, BenchmarkMesh& out)
+{
+	constexpr f32 majorRadius = 1.0f;
+	constexpr f32 minorRadius = 0.3f;
+
+	out.name = "torus";
+	for (u32 j = 0; j <= segmentsV; ++j) {
+		const f32 v = static_cast<f32>(j) / segmentsV;
+		const f32 phi = v * DirectX::XM_2PI;
+		for (u32 i = 0; i <= segmentsU; ++i) {
+			const f32 u = static_cast<f32>(i) / segmentsU;
+			const f32 theta = u * DirectX::XM_2PI;
+
+			const f32 ring = majorRadius + minorRadius * std::cos(phi);
+			out.positions.push_back(float3(ring * std::cos(theta), minorRadius * std::sin(phi), ring * std::sin(theta)));
+			out.normals.push_back(float3(std::cos(phi) * std::cos(theta), std::sin(phi), std::cos(phi) * std::sin(theta)));
+			out.tangents.push_back(float3(-std::sin(theta), 0.0f, std::cos(theta)));
+			out.bitangents.push_back(float3(-std::sin(phi) * std::cos(theta), std::cos(phi), -std::sin(phi) * std::sin(theta)));
+			out.uvs.push_back(float2(u, v));
+		}
+	}
+
+	const u32 rowSize = segmentsU + 1;
+	for (u32 j = 0; j < segmentsV; ++j) {
+		for (u32 i = 0; i < segmentsU; ++i) {
+			const u32 v00 = j * rowSize + i;
+			const u32 v10 = v00 + 1;
+			const u32 v01 = v00 + rowSize;
+			const u32 v11 = v01 + 1;
+			out.indices.insert(out.indices.end(), { v00, v01, v10, v10, v01, v11 });
+		}
+	}
+}
+
+// a flat grid with its uvs mirrored down the middle, like the two halves of a face sharing one half of a texture
+// every vertex on the middle column has triangles of both orientations
+static void BuildMirroredPlane(u32 segments, BenchmarkMesh& out)
+{
+	out.name = "mirrored plane";
+	for (u32 j = 0; j <= segments; ++j) {
+		const f32 z = static_cast<f32>(j) / segments;
+		for (u32 i = 0; i <= segments * 2; ++i) {
+			const f32 x = static_cast<f32>(i) / segments - 1.0f;
+			out.positions.push_back(float3(x, 0.0f, z));
+			out.uvs.push_back(float2(std::abs(x), z));
+		}
+	}
+
+	const u32 rowSize = segments * 2 + 1;
+	for (u32 j = 0; j < segments; ++j) {
+		for (u32 i = 0; i < segments * 2; ++i) {
+			const u32 v00 = j * rowSize + i;
+			const u32 v10 = v00 + 1;
+			const u32 v01 = v00 + rowSize;
+			const u32 v11 = v01 + 1;
+			out.indices.insert(out.indices.end(), { v00, v01, v10, v10, v01, v11 });
+		}
+	}
+	out.expectedSplits = segments + 1;
+}
+
+// average and max in degrees
+static void AngleError(std::span<const float3> expected, std::span<const float3> actual, f64& outAverage, f64& outMax)
+{
+	outAverage = 0.0;
+	outMax = 0.0;
+	for (size_t i = 0; i < expected.size(); ++i) {
+		const f64 degrees = Angle(expected[i], actual[i]) * (180.0 / DirectX::XM_PI);
+		outAverage += degrees;
+		outMax = std::max(outMax, degrees);
+	}
+	outAverage /= std::max<size_t>(expected.size(), 1);
+}
+
+bool MeshProcessing::RunBenchmark()
+{
+	constexpr u32 runs = 5;
+	// against analytic normals and tangents, the generated ones are a weighted average of the faces around a vertex
+	// so they are off by a little where the curvature changes, a wrong winding or uv axis is off by far more
+	constexpr f64 maxAngleError = 1.0;
+
+	Data<BenchmarkMesh> meshes;
+
+	const AssetCatalog* catalog = global::assetSystem->Catalog();
+	const MeshAsset& suzanne = catalog->GetMeshAsset(catalog->FindMeshAsset(HashPath("meshes/suzanne.glb")));
+	if (suzanne.state == AssetState::Loaded) {
+		BenchmarkMesh& mesh = meshes.emplace_back();
+		mesh.name = "suzanne";
+		mesh.positions.resize(suzanne.GetVertexCount());
+		mesh.uvs.resize(suzanne.GetVertexCount());
+		suzanne.DecodePositions(0, mesh.positions, {});
+		suzanne.DecodeUv0s(0, mesh.uvs);
+		mesh.indices.assign(suzanne.GetIndices().begin(), suzanne.GetIndices().end());
+	} else {
+		spdlog::warn("suzanne.glb isnt loaded, only running the torus");
+	}
+
+	constexpr u32 torusSegmentsU = 1536;
+	constexpr u32 torusSegmentsV = 1024;
+	BuildMirroredPlane(64, meshes.emplace_back());
+	BuildTorus(torusSegmentsU, torusSegmentsV, meshes.emplace_back());
+	meshes.back().expectedSplits = 0;
+
+	spdlog::info("mesh processing benchmark, {} threads, best of {} runs", global::jobSystem->GetThreadCount(), runs);
+
+	// meshes keep their packed streams and nothing else, against the float positions, normals and uvs they kept next to them
+	const AssetManifest& manifest = catalog->GetManifest();
+	for (u32 e = 0; e < manifest.GetEntryCount(); ++e) {
+		const AssetManifest::Entry& entry = manifest.GetEntry(e);
+		const MeshID id = catalog->FindMeshAsset(entry.pathHash);
+		if (entry.type != AssetType::Mesh || id.value == InvalidAssetIndex || catalog->GetMeshAsset(id).state != AssetState::Loaded) {
+			continue;
+		}
+
+		const MeshAsset& asset = catalog->GetMeshAsset(id);
+		const size_t floatBytes = asset.GetImportedVertexBytes() + asset.GetAttributes().size();
+		spdlog::info("{}: {} vertices in {} bytes instead of {} with floats, {} bytes saved, {:.1f}%", manifest.GetPath(entry), asset.GetVertexCount(),
+			asset.GetVertexBytes(), floatBytes, floatBytes - asset.GetVertexBytes(), 100.0 * (floatBytes - asset.GetVertexBytes()) / std::max<size_t>(floatBytes, 1));
+	}
+
+	bool passed = true;
+
+	for (const BenchmarkMesh& mesh : meshes) {
+		const u32 vertexCount = static_cast<u32>(mesh.positions.size());
+		Data<float3> normals(vertexCount);
+		Data<float4> tangents(vertexCount);
+		Data<u32> indices;
+		TrackedVector<TangentSplit, MemoryTag::Scratch> splits;
+
+		f64 normalsMs = std::numeric_limits<f64>::max();
+		f64 tangentsMs = std::numeric_limits<f64>::max();
+		for (u32 run = 0; run < runs; ++run) {
+			spdlog::stopwatch normalsTime;
+			GenerateNormals(mesh.positions, mesh.indices, NormalWeighting::Angle, normals);
+			normalsMs = std::min(normalsMs, normalsTime.elapsed().count() * 1000.0);
+
+			// splitting rewrites them
+			indices = mesh.indices;
+			spdlog::stopwatch tangentsTime;
+			GenerateTangents(mesh.positions, normals, mesh.uvs, indices, tangents, splits);
+			tangentsMs = std::min(tangentsMs, tangentsTime.elapsed().count() * 1000.0);
+		}
+
+		spdlog::info("{}: {} vertices, {} triangles, normals {:.2f} ms, tangents {:.2f} ms",
+			mesh.name, vertexCount, mesh.indices.size() / 3, normalsMs, tangentsMs);
+
+		// every corner of a triangle with a uv area has to end up on a vertex with the sign of that area, the split
+		// vertices have to copy the one they came from, and a corner can only move to a split of its own vertex
+		bool splitsMatch = !mesh.expectedSplits.has_value() || splits.size() == *mesh.expectedSplits;
+		u32 wrongCorners = 0;
+		for (size_t c = 0; c < indices.size(); ++c) {
+			const u32 original = mesh.indices[c];
+			const u32 vertex = indices[c];
+			const bool split = vertex >= vertexCount;
+			splitsMatch &= vertex == original || (split && splits[vertex - vertexCount].vertex == original);
+
+			const u32* triangle = &mesh.indices[c - c % 3];
+			const float2 st1 = float2(mesh.uvs[triangle[1]].x - mesh.uvs[triangle[0]].x, mesh.uvs[triangle[1]].y - mesh.uvs[triangle[0]].y);
+			const float2 st2 = float2(mesh.uvs[triangle[2]].x - mesh.uvs[triangle[0]].x, mesh.uvs[triangle[2]].y - mesh.uvs[triangle[0]].y);
+			const f32 signedUvArea = st1.x * st2.y - st1.y * st2.x;
+			if (std::abs(signedUvArea) > s_epsilon) {
+				const f32 sign = split ? splits[vertex - vertexCount].tangent.w : tangents[vertex].w;
+				wrongCorners += sign != (signedUvArea > 0.0f ? 1.0f : -1.0f);
+			}
+		}
+		spdlog::info("    {} vertices split, {} corners on a vertex with the wrong sign, {}", splits.size(), wrongCorners,
+			splitsMatch && wrongCorners == 0 ? "matches" : "MISMATCH");
+		passed &= splitsMatch && wrongCorners == 0;
+
+		if (!mesh.normals.empty()) {
+			f64 normalAverage = 0.0;
+			f64 normalMax = 0.0;
+			AngleError(mesh.normals, normals, normalAverage, normalMax);
+			spdlog::info("    normals off by {:.3f} degrees on average, {:.3f} at most, {}", normalAverage, normalMax,
+				normalMax <= maxAngleError ? "matches" : "MISMATCH");
+			passed &= normalMax <= maxAngleError;
+		}
+
+		if (!mesh.tangents.empty()) {
+			Data<float3> tangentDirections(vertexCount);
+			u32 wrongSigns = 0;
+			for (u32 v = 0; v < vertexCount; ++v) {
+				tangentDirections[v] = float3(tangents[v].x, tangents[v].y, tangents[v].z);
+				// cross(normal, tangent) * w has to point along dp/dv
+				const f32 expectedSign = Dot(Cross(mesh.normals[v], mesh.tangents[v]), mesh.bitangents[v]) > 0.0f ? 1.0f : -1.0f;
+				wrongSigns += tangents[v].w != expectedSign;
+			}
+
+			f64 tangentAverage = 0.0;
+			f64 tangentMax = 0.0;
+			AngleError(mesh.tangents, tangentDirections, tangentAverage, tangentMax);
+			const bool tangentsMatch = tangentMax <= maxAngleError && wrongSigns == 0;
+			spdlog::info("    tangents off by {:.3f} degrees on average, {:.3f} at most, {} with the wrong sign, {}", tangentAverage, tangentMax, wrongSigns,
+				tangentsMatch ? "matches" : "MISMATCH");
+			passed &= tangentsMatch;
+		}
+	}
+
+	// the torus split into a vertex per corner like a careless export, then welded back
+	const BenchmarkMesh& torus = meshes.back();
+	const u32 cornerCount = static_cast<u32>(torus.indices.size());
+	Data<float3> splitPositions(cornerCount);
+	Data<float2> splitUvs(cornerCount);
+	Data<u32> splitIndices(cornerCount);
+	for (u32 c = 0; c < cornerCount; ++c) {
+		splitPositions[c] = torus.positions[torus.indices[c]];
+		splitUvs[c] = torus.uvs[torus.indices[c]];
+		splitIndices[c] = c;
+	}
+
+	struct WeldCase {
+		const char* name;
+		f32 epsilon;
+		bool uvs;
+		u32 expectedCount;
+	};
+	const WeldCase weldCases[] = {
+		{ "bit exact", 0.0f, true, static_cast<u32>(torus.positions.size()) },
+		// the seam vertices are only float error apart, so without uvs they weld too
+		{ "epsilon 1e-4, positions only", 1e-4f, false, torusSegmentsU * torusSegmentsV },
+	};
+
+	for (const WeldCase& weldCase : weldCases) {
+		Data<float3> positions;
+		Data<float2> uvs;
+		Data<u32> indices;
+		u32 weldedCount = 0;
+
+		f64 weldMs = std::numeric_limits<f64>::max();
+		for (u32 run = 0; run < runs; ++run) {
+			positions = splitPositions;
+			uvs = splitUvs;
+			indices = splitIndices;
+
+			Data<WeldStream> streams;
+			streams.push_back(MakeWeldStream(std::span(positions), weldCase.epsilon));
+			if (weldCase.uvs) {
+				streams.push_back(MakeWeldStream(std::span(uvs), weldCase.epsilon));
+			}
+
+			spdlog::stopwatch weldTime;
+			weldedCount = WeldVertices(streams, cornerCount, indices);
+			weldMs = std::min(weldMs, weldTime.elapsed().count() * 1000.0);
+		}
+
+		// every corner has to land on a vertex within epsilon of where it was
+		f32 maxError = 0.0f;
+		for (u32 c = 0; c < cornerCount; ++c) {
+			const float3 d = Sub(positions[indices[c]], splitPositions[c]);
+			maxError = std::max({ maxError, std::abs(d.x), std::abs(d.y), std::abs(d.z) });
+			if (weldCase.uvs) {
+				maxError = std::max({ maxError, std::abs(uvs[indices[c]].x - splitUvs[c].x), std::abs(uvs[indices[c]].y - splitUvs[c].y) });
+			}
+		}
+
+		const bool matches = weldedCount == weldCase.expectedCount && maxError <= weldCase.epsilon;
+		spdlog::info("weld {}: {} into {} vertices ({} expected) in {:.2f} ms, max error {}, {}",
+			weldCase.name, cornerCount, weldedCount, weldCase.expectedCount, weldMs, maxError, matches ? "matches" : "MISMATCH");
+		passed &= matches;
+	}
+
+	spdlog::info("mesh processing checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "Math.hpp"
+#include "Core/MemoryTracker.hpp"
+
+#include <span>
+
+// import time processing of mesh data, run by MeshAsset::Load for whatever the file didnt have
+//
+// everything is split over the job system in two steps, per triangle work writes one result per corner
+// and per vertex work adds up the corners of the vertex in triangle order, so the result is the same
+// bits whatever the thread count
+namespace MeshProcessing
+{
+	enum class NormalWeighting : u8 {
+		// bigger triangles pull harder, cheap but depends on how the surface is tessellated
+		Area,
+		// by the angle of the triangle at the vertex, the same surface gives the same normals however its split
+		Angle,
+	};
+
+	// smooth vertex normals for an indexed triangle list
+	// vertices at the same position are smoothed together even with different indices, so uv seams
+	// dont show up as hard edges
+	void GenerateNormals(std::span<const float3> positions, std::span<const u32> indices, NormalWeighting weighting, std::span<float3> outNormals);
+
+	// a vertex GenerateTangents had to duplicate, the copy goes after every existing vertex in the order of the splits
+	struct TangentSplit {
+		// the vertex it copies everything but the tangent from
+		u32 vertex;
+		float4 tangent;
+	};
+
+	// tangents for normal mapping, xyz along +u and w the sign of the bitangent, bitangent = cross(normal, tangent.xyz) * w
+	// follows the MikkTSpace rules (unit face tangents projected onto the vertex normal plane and weighted by
+	// the corner angle there, orientation from the sign of the uv area) so baked normal maps match
+	// a vertex whose triangles disagree on the uv orientation, like the seam of mirrored uvs, keeps the side with more
+	// weight and the corners of the other side move to a new vertex, indices are rewritten to point at it and
+	// outSplits says what to copy into it, the caller appends those to every other vertex stream
+	// vertices without usable uvs get a tangent perpendicular to the normal
+	void GenerateTangents(std::span<const float3> positions, std::span<const float3> normals, std::span<const float2> uvs, std::span<u32> indices,
+		std::span<float4> outTangents, TrackedVector<TangentSplit, MemoryTag::Scratch>& outSplits);
+
+	// one vertex attribute for WeldVertices, vertices are packed tightly as components floats each
+	struct WeldStream {
+		f32* data;
+		u32 components;
+		// 0 welds bit exact (except -0 and 0), otherwise values are rounded to multiples of epsilon
+		// before comparing, so vertices closer than that usually weld but two on either side of a
+		// rounding boundary dont
+		f32 epsilon;
+	};
+
+	template<typename T>
+	WeldStream MakeWeldStream(std::span<T> data, f32 epsilon = 0.0f)
+	{
+		static_assert(sizeof(T) % sizeof(f32) == 0, "weld streams are made of floats");
+		return WeldStream{ .data = reinterpret_cast<f32*>(data.data()), .components = sizeof(T) / sizeof(f32), .epsilon = epsilon };
+	}
+
+	// merges vertices that match in every stream, each group keeps its first vertex and the streams are
+	// compacted in place in the original order, indices are rewritten to match
+	// returns the new vertex count, the caller shrinks the streams to it
+	// unreferenced vertices are kept, bad indices leave everything as it was
+	u32 WeldVertices(std::span<const WeldStream> streams, u32 vertexCount, std::span<u32> indices);
+
+	// a cluster of neighbouring triangles small enough to cull on its own, its triangles are
+	// indices[indexOffset, indexOffset + triangleCount * 3) of the index buffer BuildMeshlets reordered
+	struct Meshlet {
+		// bounding sphere
+		float3 center;
+		f32 radius;
+		// every triangle faces away from a camera at c when dot(normalize(coneApex - c), coneAxis) >= coneCutoff
+		// cutoff is above 1 when the normals spread too far for that to ever hold
+		float3 coneApex;
+		float3 coneAxis;
+		f32 coneCutoff;
+		u32 indexOffset;
+		u32 triangleCount;
+		u32 vertexCount;
+	};
+
+	// the usual mesh shader limits, small enough that a cone is tight and a sphere is mostly off or on screen
+	constexpr u32 MaxMeshletVertices = 64;
+	constexpr u32 MaxMeshletTriangles = 124;
+
+	// splits the mesh into meshlets, growing each from a triangle through its neighbours so they stay compact,
+	// and reorders indices in place so each meshlets triangles are contiguous
+	// front faces are clockwise seen from the camera, same as the rasterizer state
+	void BuildMeshlets(std::span<const float3> positions, std::span<u32> indices, TrackedVector<Meshlet, MemoryTag::AssetsMesh>& outMeshlets);
+
+	// suzanne from the catalog against its authored normals and a synthetic torus of a few million triangles
+	// against the analytic ones, a plane with mirrored uvs for the tangent splits, needs the assets registered
+	bool RunBenchmark();
+}
@@ -0,0 +1,383 @@
+#include "Morph.hpp"
+
+#include "MathBatch.hpp"
+#include "Core/JobSystem.hpp"
+#include "Core/Profiler.hpp"
+
+#include <immintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+
+// same as MathBatch.cpp, gcc and clang only emit sse4 and avx2 in functions marked for it
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET_SSE4
+#define TARGET_AVX2
+#else
+#define TARGET_SSE4 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+using namespace Morph;
+
+// the base copy alone is a few hundred kilobytes per job
+static constexpr u32 VerticesPerJob = 16384;
+
+// normals shorter than this come out as zero instead of nan
+static constexpr f32 s_minLengthSq = 1e-30f;
+
+static inline bool Moves(const float3& delta)
+{
+	return std::abs(delta.x) > MinDelta || std::abs(delta.y) > MinDelta || std::abs(delta.z) > MinDelta;
+}
+
+void Morph::AddTarget(TargetSet& set, std::string_view name, f32 defaultWeight, std::span<const float3> positionDeltas, std::span<const float3> normalDeltas)
+{
+	ENSURE(set.targets.empty() || positionDeltas.size() == set.vertexCount, "AddTarget deltas dont match the other targets");
+	ENSURE(normalDeltas.empty() || normalDeltas.size() == positionDeltas.size(), "AddTarget needs a normal delta per position delta");
+
+	set.vertexCount = static_cast<u32>(positionDeltas.size());
+
+	const bool hasNormals = !normalDeltas.empty();
+	// the first target with normals fills in zeros for the ones before it
+	if (hasNormals && set.normalDeltas.empty()) {
+		set.normalDeltas.resize(set.positionDeltas.size(), float3(0.0f, 0.0f, 0.0f));
+	}
+
+	auto moved = [&](u32 v) {
+		return Moves(positionDeltas[v]) || (hasNormals && Moves(normalDeltas[v]));
+	};
+
+	Target target{
+		.name = std::string(name),
+		.defaultWeight = defaultWeight,
+		.firstRun = static_cast<u32>(set.runs.size()),
+	};
+
+	const u32 vertexCount = set.vertexCount;
+	for (u32 v = 0; v < vertexCount;) {
+		if (!moved(v)) {
+			++v;
+			continue;
+		}
+
+		// on through gaps of up to MaxZeroGap vertices that dont move, then back to the last one that did
+		u32 last = v;
+		for (u32 next = v + 1; next < vertexCount && next - last - 1 <= MaxZeroGap; ++next) {
+			if (moved(next)) {
+				last = next;
+			}
+		}
+		const u32 end = last + 1;
+
+		set.runs.push_back(Run{ .firstVertex = v, .count = end - v, .deltaOffset = static_cast<u32>(set.positionDeltas.size()) });
+		set.positionDeltas.insert(set.positionDeltas.end(), positionDeltas.begin() + v, positionDeltas.begin() + end);
+		if (hasNormals) {
+			set.normalDeltas.insert(set.normalDeltas.end(), normalDeltas.begin() + v, normalDeltas.begin() + end);
+		} else if (!set.normalDeltas.empty()) {
+			set.normalDeltas.resize(set.positionDeltas.size(), float3(0.0f, 0.0f, 0.0f));
+		}
+
+		v = end;
+	}
+
+	target.runCount = static_cast<u32>(set.runs.size()) - target.firstRun;
+	set.targets.push_back(std::move(target));
+}
+
+//
+// kernels, out[i] += weight * deltas[i] over floatCount floats, a run of n vertices is 3n floats
+//
+
+static void AccumulateScalar(f32 weight, const f32* deltas, f32* out, u32 floatCount)
+{
+	for (u32 i = 0; i < floatCount; ++i) {
+		out[i] += weight * deltas[i];
+	}
+}
+
+TARGET_SSE4 static void AccumulateSSE4(f32 weight, const f32* deltas, f32* out, u32 floatCount)
+{
+	const __m128 w = _mm_set1_ps(weight);
+
+	u32 i = 0;
+	for (; i + 4 <= floatCount; i += 4) {
+		_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(w, _mm_loadu_ps(deltas + i))));
+	}
+	AccumulateScalar(weight, deltas + i, out + i, floatCount - i);
+}
+
+TARGET_AVX2 static void AccumulateAVX2(f32 weight, const f32* deltas, f32* out, u32 floatCount)
+{
+	const __m256 w = _mm256_set1_ps(weight);
+
+	// two registers per iteration so the loads of the next pair dont wait on the stores
+	u32 i = 0;
+	for (; i + 16 <= floatCount; i += 16) {
+		const __m256 a = _mm256_fmadd_ps(w, _mm256_loadu_ps(deltas + i), _mm256_loadu_ps(out + i));
+		const __m256 b = _mm256_fmadd_ps(w, _mm256_loadu_ps(deltas + i + 8), _mm256_loadu_ps(out + i + 8));
+		_mm256_storeu_ps(out + i, a);
+		_mm256_storeu_ps(out + i + 8, b);
+	}
+	for (; i + 8 <= floatCount; i += 8) {
+		_mm256_storeu_ps(out + i, _mm256_fmadd_ps(w, _mm256_loadu_ps(deltas + i), _mm256_loadu_ps(out + i)));
+	}
+	for (; i < floatCount; ++i) {
+		out[i] = std::fma(weight, deltas[i], out[i]);
+	}
+}
+
+using AccumulateFunc = void (*)(f32 weight, const f32* deltas, f32* out, u32 floatCount);
+
+// indexed by MathBatch::Isa
+static constexpr AccumulateFunc s_accumulate[] = {
+	AccumulateScalar,
+	AccumulateSSE4,
+	AccumulateAVX2,
+};
+
+// renormalizing is a fraction of the adds once a few targets overlap, so it stays scalar
+static void Normalize(float3* normals, u32 count)
+{
+	for (u32 i = 0; i < count; ++i) {
+		float3& n = normals[i];
+		const f32 invLength = 1.0f / std::sqrt(std::max(n.x * n.x + n.y * n.y + n.z * n.z, s_minLengthSq));
+		n = float3(n.x * invLength, n.y * invLength, n.z * invLength);
+	}
+}
+
+struct ActiveTarget {
+	const Target* target;
+	f32 weight;
+};
+
+// calls func(vertex, deltaOffset, count) for the part of every run of target inside [begin, end)
+template<typename Func>
+static void ForEachRun(const TargetSet& set, const Target& target, u32 begin, u32 end, Func&& func)
+{
+	const Run* first = set.runs.data() + target.firstRun;
+	const Run* last = first + target.runCount;
+	const Run* run = std::partition_point(first, last, [&](const Run& r) { return r.firstVertex + r.count <= begin; });
+
+	for (; run != last && run->firstVertex < end; ++run) {
+		const u32 runBegin = std::max(run->firstVertex, begin);
+		const u32 runEnd = std::min(run->firstVertex + run->count, end);
+		func(runBegin, run->deltaOffset + (runBegin - run->firstVertex), runEnd - runBegin);
+	}
+}
+
+void Morph::Evaluate(const TargetSet& set, std::span<const f32> weights,
+	std::span<const float3> basePositions, std::span<const float3> baseNormals,
+	std::span<float3> outPositions, std::span<float3> outNormals)
+{
+	PROFILE_ZONE("Morph::Evaluate");
+
+	const u32 vertexCount = static_cast<u32>(basePositions.size());
+	ENSURE(weights.size() == set.TargetCount(), "Evaluate needs a weight per target");
+	ENSURE(set.Empty() || set.vertexCount == vertexCount, "Evaluate base doesnt match the targets");
+	ENSURE(outPositions.size() == vertexCount, "Evaluate output doesnt match the base");
+	ENSURE(baseNormals.size() == outNormals.size() && (outNormals.empty() || outNormals.size() == vertexCount), "Evaluate normals dont match the base");
+
+	TrackedVector<ActiveTarget, MemoryTag::Scratch> active;
+	for (u32 t = 0; t < set.TargetCount(); ++t) {
+		if (std::abs(weights[t]) > MinWeight) {
+			active.push_back(ActiveTarget{ .target = &set.targets[t], .weight = weights[t] });
+		}
+	}
+
+	const bool morphNormals = !outNormals.empty() && !set.normalDeltas.empty();
+	const AccumulateFunc accumulate = s_accumulate[static_cast<u32>(MathBatch::GetIsa())];
+
+	// jobs own a vertex range and clip every run to it, so targets that overlap never write the same
+	// vertex from two threads
+	global::jobSystem->ParallelFor(vertexCount, VerticesPerJob, [&](u32 begin, u32 end) {
+		PROFILE_ZONE("Morph");
+
+		std::memcpy(&outPositions[begin], &basePositions[begin], (end - begin) * sizeof(float3));
+		if (!outNormals.empty()) {
+			std::memcpy(&outNormals[begin], &baseNormals[begin], (end - begin) * sizeof(float3));
+		}
+
+		for (const ActiveTarget& a : active) {
+			ForEachRun(set, *a.target, begin, end, [&](u32 vertex, u32 deltaOffset, u32 count) {
+				accumulate(a.weight, &set.positionDeltas[deltaOffset].x, &outPositions[vertex].x, count * 3);
+				if (morphNormals) {
+					accumulate(a.weight, &set.normalDeltas[deltaOffset].x, &outNormals[vertex].x, count * 3);
+				}
+			});
+		}
+
+		// a vertex in runs of several targets gets normalized more than once, which changes nothing
+		if (morphNormals) {
+			for (const ActiveTarget& a : active) {
+				ForEachRun(set, *a.target, begin, end, [&](u32 vertex, u32, u32 count) {
+					Normalize(&outNormals[vertex], count);
+				});
+			}
+		}
+	});
+}
+
+//
+// benchmark
+//
+
+template<typename Func>
+static f64 BestOf(u32 runs, Func&& func)
+{
+	f64 bestMs = std::numeric_limits<f64>::max();
+	for (u32 i = 0; i < runs; ++i) {
+		spdlog::stopwatch sw;
+		func();
+		bestMs = std::min(bestMs, sw.elapsed().count() * 1000.0);
+	}
+	return bestMs;
+}
+
+// relative past 1 like the MathBatch benchmark
+static f32 Error(const float3& expected, const float3& actual)
+{
+	auto error = [](f32 e, f32 a) { return std::abs(e - a) / std::max(1.0f, std::abs(e)); };
+	return std::max({ error(expected.x, actual.x), error(expected.y, actual.y), error(expected.z, actual.z) });
+}
+
+// a smooth bump around a point of the grid, like a sculpted shape on part of a face
+struct Blob {
+	f32 centerX, centerY, radius;
+	float3 offset;
+	float3 tilt;
+};
+
+bool Morph::RunBenchmark()
+{
+	constexpr u32 gridSize = 1024;
+	constexpr u32 vertexCount = gridSize * gridSize;
+	constexpr u32 targetCount = 64;
+	constexpr u32 faceRigActive = 8;
+	constexpr u32 runs = 10;
+	constexpr f32 tolerance = 1e-4f;
+
+	std::mt19937 rng(46);
+	std::uniform_real_distribution<f32> unit(0.0f, 1.0f);
+	std::uniform_real_distribution<f32> signedUnit(-1.0f, 1.0f);
+
+	TrackedVector<float3, MemoryTag::Scratch> basePositions(vertexCount);
+	TrackedVector<float3, MemoryTag::Scratch> baseNormals(vertexCount, float3(0.0f, 1.0f, 0.0f));
+	for (u32 y = 0; y < gridSize; ++y) {
+		for (u32 x = 0; x < gridSize; ++x) {
+			basePositions[y * gridSize + x] = float3(x * 0.01f, 0.0f, y * 0.01f);
+		}
+	}
+
+	TrackedVector<Blob, MemoryTag::Scratch> blobs(targetCount);
+	for (Blob& blob : blobs) {
+		blob.radius = 16.0f + unit(rng) * 80.0f;
+		blob.centerX = blob.radius + unit(rng) * (gridSize - 2.0f * blob.radius);
+		blob.centerY = blob.radius + unit(rng) * (gridSize - 2.0f * blob.radius);
+		blob.offset = float3(signedUnit(rng) * 0.05f, signedUnit(rng) * 0.05f, signedUnit(rng) * 0.05f);
+		blob.tilt = float3(signedUnit(rng) * 0.5f, 0.0f, signedUnit(rng) * 0.5f);
+	}
+
+	// the deltas are worked out again for the reference instead of read back out of the runs
+	auto blobDelta = [&](const Blob& blob, u32 v, float3& outPosition, float3& outNormal) {
+		const f32 dx = (v % gridSize - blob.centerX) / blob.radius;
+		const f32 dy = (v / gridSize - blob.centerY) / blob.radius;
+		const f32 falloff = std::max(0.0f, 1.0f - (dx * dx + dy * dy));
+		const f32 f = falloff * falloff;
+		outPosition = float3(blob.offset.x * f, blob.offset.y * f, blob.offset.z * f);
+		outNormal = float3(blob.tilt.x * f, 0.0f, blob.tilt.z * f);
+	};
+
+	TargetSet set;
+	{
+		TrackedVector<float3, MemoryTag::Scratch> positionDeltas(vertexCount);
+		TrackedVector<float3, MemoryTag::Scratch> normalDeltas(vertexCount);
+		spdlog::stopwatch sw;
+		for (u32 t = 0; t < targetCount; ++t) {
+			for (u32 v = 0; v < vertexCount; ++v) {
+				blobDelta(blobs[t], v, positionDeltas[v], normalDeltas[v]);
+			}
+			AddTarget(set, fmt::format("blob{}", t), 0.0f, positionDeltas, normalDeltas);
+		}
+		const f64 denseMb = static_cast<f64>(targetCount) * vertexCount * 2 * sizeof(float3) / (1024.0 * 1024.0);
+		const f64 sparseMb = (set.positionDeltas.size() + set.normalDeltas.size()) * sizeof(float3) / (1024.0 * 1024.0) + set.runs.size() * sizeof(Run) / (1024.0 * 1024.0);
+		spdlog::info("morph benchmark, {} threads, {} vertices, {} targets, best of {} runs", global::jobSystem->GetThreadCount(), vertexCount, targetCount, runs);
+		spdlog::info("    {} deltas in {} runs, {:.1f} MB against {:.1f} MB dense ({:.1f}%), built in {:.1f} ms",
+			set.positionDeltas.size(), set.runs.size(), sparseMb, denseMb, 100.0 * sparseMb / denseMb, sw.elapsed().count() * 1000.0);
+	}
+
+	TrackedVector<float3, MemoryTag::Scratch> outPositions(vertexCount);
+	TrackedVector<float3, MemoryTag::Scratch> outNormals(vertexCount);
+	TrackedVector<float3, MemoryTag::Scratch> expectedPositions(vertexCount);
+	TrackedVector<float3, MemoryTag::Scratch> expectedNormals(vertexCount);
+	TrackedVector<f32, MemoryTag::Scratch> weights(targetCount, 0.0f);
+
+	const MathBatch::Isa previousIsa = MathBatch::GetIsa();
+
+	// every evaluate copies the base first, the throughput below is for the time on top of that
+	const f64 copyMs = BestOf(runs, [&]() { Evaluate(set, weights, basePositions, baseNormals, outPositions, outNormals); });
+	spdlog::info("no weights, only the base copy: {:.3f} ms", copyMs);
+
+	bool passed = true;
+
+	auto scenario = [&](const char* name, u32 activeCount) {
+		std::fill(weights.begin(), weights.end(), 0.0f);
+		TrackedVector<u32, MemoryTag::Scratch> order(targetCount);
+		for (u32 t = 0; t < targetCount; ++t) {
+			order[t] = t;
+		}
+		std::shuffle(order.begin(), order.end(), rng);
+		for (u32 i = 0; i < activeCount; ++i) {
+			weights[order[i]] = 0.1f + unit(rng) * 0.9f;
+		}
+
+		// every vertex against every active target, no runs involved
+		u64 deltaCount = 0;
+		std::copy(basePositions.begin(), basePositions.end(), expectedPositions.begin());
+		std::copy(baseNormals.begin(), baseNormals.end(), expectedNormals.begin());
+		for (u32 t = 0; t < targetCount; ++t) {
+			if (weights[t] == 0.0f) {
+				continue;
+			}
+			const Target& target = set.targets[t];
+			for (u32 r = 0; r < target.runCount; ++r) {
+				deltaCount += set.runs[target.firstRun + r].count;
+			}
+			for (u32 v = 0; v < vertexCount; ++v) {
+				float3 dp, dn;
+				blobDelta(blobs[t], v, dp, dn);
+				float3& p = expectedPositions[v];
+				float3& n = expectedNormals[v];
+				p = float3(p.x + weights[t] * dp.x, p.y + weights[t] * dp.y, p.z + weights[t] * dp.z);
+				n = float3(n.x + weights[t] * dn.x, n.y + weights[t] * dn.y, n.z + weights[t] * dn.z);
+			}
+		}
+		for (float3& n : expectedNormals) {
+			DirectX::XMStoreFloat3(&n, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&n)));
+		}
+
+		spdlog::info("{}, {} of {} targets, {} deltas", name, activeCount, targetCount, deltaCount);
+		for (u32 isa = 0; isa <= static_cast<u32>(MathBatch::GetSupportedIsa()); ++isa) {
+			MathBatch::SetIsa(static_cast<MathBatch::Isa>(isa));
+			const f64 ms = BestOf(runs, [&]() { Evaluate(set, weights, basePositions, baseNormals, outPositions, outNormals); });
+
+			f32 maxError = 0.0f;
+			for (u32 v = 0; v < vertexCount; ++v) {
+				maxError = std::max({ maxError, Error(expectedPositions[v], outPositions[v]), Error(expectedNormals[v], outNormals[v]) });
+			}
+			spdlog::info("    {:<6} {:.3f} ms, {:.1f} Mdeltas/s past the copy, max error {:.2e}, {}",
+				MathBatch::IsaName(static_cast<MathBatch::Isa>(isa)), ms, deltaCount / (std::max(ms - copyMs, 1e-3) * 1000.0), maxError, maxError <= tolerance ? "matches" : "MISMATCH");
+			passed &= maxError <= tolerance;
+		}
+	};
+
+	scenario("face rig", faceRigActive);
+	scenario("every target", targetCount);
+
+	MathBatch::SetIsa(previousIsa);
+
+	spdlog::info("morph checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
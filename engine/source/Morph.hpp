@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "Math.hpp"
+#include "Core/MemoryTracker.hpp"
+
+#include <span>
+#include <string>
+#include <string_view>
+
+// morph targets (blend shapes), glTF primitive targets imported by MeshAsset::Load with the weights of the mesh
+// as the defaults
+//
+// a target only keeps the vertices it moves, as runs of consecutive vertices with their deltas packed
+// together, so evaluating adds each run as one contiguous multiply add instead of scattering vertex by vertex
+// targets with a weight of 0 cost nothing, which is most of them in a face rig
+//
+// the output is plain positions and normals, give them to Skinning::Source to morph before skinning
+namespace Morph
+{
+	template<typename T>
+	using Data = TrackedVector<T, MemoryTag::AssetsMesh>;
+
+	// deltas shorter than this on every axis are exporter noise and count as 0
+	constexpr f32 MinDelta = 1e-6f;
+	// a run carries up to this many zero deltas across a gap instead of starting a new run
+	constexpr u32 MaxZeroGap = 4;
+	// weights closer to 0 than this are skipped
+	constexpr f32 MinWeight = 1e-4f;
+
+	// vertices [firstVertex, firstVertex + count) of a target, their deltas start at deltaOffset
+	struct Run {
+		u32 firstVertex;
+		u32 count;
+		u32 deltaOffset;
+	};
+
+	struct Target {
+		std::string name;
+		// mesh.weights from the file, what a mesh draws with until something sets its weights
+		f32 defaultWeight = 0.0f;
+		// runs[firstRun, firstRun + runCount), in vertex order
+		u32 firstRun = 0;
+		u32 runCount = 0;
+	};
+
+	struct TargetSet {
+		u32 vertexCount = 0;
+		Data<Target> targets;
+		Data<Run> runs;
+		Data<float3> positionDeltas;
+		// empty when no target moves normals, otherwise one per position delta
+		Data<float3> normalDeltas;
+
+		inline u32 TargetCount() const { return static_cast<u32>(targets.size()); }
+		inline bool Empty() const { return targets.empty(); }
+	};
+
+	// dense deltas in, one per vertex of the set, normalDeltas can be empty
+	void AddTarget(TargetSet& set, std::string_view name, f32 defaultWeight, std::span<const float3> positionDeltas, std::span<const float3> normalDeltas);
+
+	// out = base + the sum of weight * delta over every target with a weight further from 0 than MinWeight,
+	// normals are renormalized where a target moved them
+	// the normal spans can be empty to only morph positions, out can't alias base
+	// vertices are split over the job system, kernels picked by MathBatch::GetIsa like Skinning
+	void Evaluate(const TargetSet& set, std::span<const f32> weights,
+		std::span<const float3> basePositions, std::span<const float3> baseNormals,
+		std::span<float3> outPositions, std::span<float3> outNormals);
+
+	// 64 targets on a dense grid, a few active like a face rig and then all of them, against a dense loop
+	bool RunBenchmark();
+}
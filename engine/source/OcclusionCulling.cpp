@@ -0,0 +1,728 @@
+#include "OcclusionCulling.hpp"
+
+#include "MathBatch.hpp"
+#include "Core/Profiler.hpp"
+
+#include <immintrin.h>
+#include <cfloat>
+#include <random>
+
+// avx2 without fma, a fused multiply add rounds the edge functions differently from the sse path and the reference,
+// msvc only contracts with /fp:contract
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+static constexpr u32 s_fullMask = 0xffffffffu;
+
+static_assert(OcclusionCulling::TileWidth * OcclusionCulling::TileHeight == 32, "the coverage mask is a u32");
+static_assert(OcclusionCulling::TileWidth == 8, "CoverageMask does a tile row as two sse registers");
+
+OcclusionCulling::OcclusionCulling(u32 width, u32 height)
+{
+	// whole tiles only, the edge functions clip the triangles to the screen and the tile grid covers it exactly
+	m_tilesX = (width + TileWidth - 1) / TileWidth;
+	m_tilesY = (height + TileHeight - 1) / TileHeight;
+	m_width = m_tilesX * TileWidth;
+	m_height = m_tilesY * TileHeight;
+
+	m_tiles.resize(m_tilesX * m_tilesY);
+}
+
+void OcclusionCulling::Begin(const mat4& worldToProjection)
+{
+	PROFILE_FUNCTION();
+
+	m_worldToProjection = worldToProjection;
+	m_stats = {};
+
+	std::fill(m_tiles.begin(), m_tiles.end(), Tile{ .mask = 0, .zMax0 = 1.0f, .zMax1 = 0.0f });
+}
+
+bool OcclusionCulling::SetupTriangle(const vec4 clip[3], u32 width, u32 height, TriangleSetup& out)
+{
+	ScreenVertex v[3];
+	for (u32 i = 0; i < 3; ++i) {
+		const f32 z = DirectX::XMVectorGetZ(clip[i]);
+		const f32 w = DirectX::XMVectorGetW(clip[i]);
+
+		// ClipNearPlane leaves points right on the plane, the rest of the way is a precision problem
+		if (z < 0.0f || w <= 0.0f) {
+			return false;
+		}
+
+		const f32 invW = 1.0f / w;
+		v[i] = ScreenVertex{
+			.x = (DirectX::XMVectorGetX(clip[i]) * invW * 0.5f + 0.5f) * width,
+			.y = (0.5f - DirectX::XMVectorGetY(clip[i]) * invW * 0.5f) * height,
+			.z = z * invW,
+		};
+	}
+
+	f32 area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+	if (!(std::abs(area) > 0.0f) || !std::isfinite(area)) {
+		return false;
+	}
+
+	// double sided, flip back facing triangles so inside is always positive
+	if (area < 0.0f) {
+		std::swap(v[1], v[2]);
+		area = -area;
+	}
+
+	// pixels whose centers can be inside, clamped in float first so huge coordinates dont overflow the ints
+	const f32 minX = std::min({ v[0].x, v[1].x, v[2].x });
+	const f32 maxX = std::max({ v[0].x, v[1].x, v[2].x });
+	const f32 minY = std::min({ v[0].y, v[1].y, v[2].y });
+	const f32 maxY = std::max({ v[0].y, v[1].y, v[2].y });
+
+	out.minX = static_cast<i32>(std::ceil(std::clamp(minX - 0.5f, -1.0f, static_cast<f32>(width))));
+	out.maxX = static_cast<i32>(std::floor(std::clamp(maxX - 0.5f, -1.0f, static_cast<f32>(width))));
+	out.minY = static_cast<i32>(std::ceil(std::clamp(minY - 0.5f, -1.0f, static_cast<f32>(height))));
+	out.maxY = static_cast<i32>(std::floor(std::clamp(maxY - 0.5f, -1.0f, static_cast<f32>(height))));
+
+	out.minX = std::max(out.minX, 0);
+	out.minY = std::max(out.minY, 0);
+	out.maxX = std::min(out.maxX, static_cast<i32>(width) - 1);
+	out.maxY = std::min(out.maxY, static_cast<i32>(height) - 1);
+
+	if (out.minX > out.maxX || out.minY > out.maxY) {
+		return false;
+	}
+
+	out.zMin = std::min({ v[0].z, v[1].z, v[2].z });
+	out.zMax = std::max({ v[0].z, v[1].z, v[2].z });
+
+	// past the far plane, the gpu wouldnt draw it either
+	if (out.zMin > 1.0f) {
+		return false;
+	}
+
+	for (u32 i = 0; i < 3; ++i) {
+		const ScreenVertex& a = v[i];
+		const ScreenVertex& b = v[(i + 1) % 3];
+		out.edgeA[i] = a.y - b.y;
+		out.edgeB[i] = b.x - a.x;
+		out.edgeC[i] = -(out.edgeA[i] * a.x + out.edgeB[i] * a.y);
+	}
+
+	// z = zA * x + zB * y + zC, z is linear in screen space after the divide
+	const f32 dz1 = v[1].z - v[0].z;
+	const f32 dz2 = v[2].z - v[0].z;
+	out.zA = (dz1 * (v[2].y - v[0].y) - dz2 * (v[1].y - v[0].y)) / area;
+	out.zB = ((v[1].x - v[0].x) * dz2 - (v[2].x - v[0].x) * dz1) / area;
+	out.zC = v[0].z - out.zA * v[0].x - out.zB * v[0].y;
+
+	return true;
+}
+
+u32 OcclusionCulling::ClipNearPlane(const vec4 clip[3], vec4 outPolygon[4])
+{
+	// the near plane is z = 0 in clip space
+	f32 distances[3];
+	u32 insideCount = 0;
+	for (u32 i = 0; i < 3; ++i) {
+		distances[i] = DirectX::XMVectorGetZ(clip[i]);
+		insideCount += distances[i] >= 0.0f ? 1 : 0;
+	}
+
+	if (insideCount == 3) {
+		outPolygon[0] = clip[0];
+		outPolygon[1] = clip[1];
+		outPolygon[2] = clip[2];
+		return 3;
+	}
+
+	if (insideCount == 0) {
+		return 0;
+	}
+
+	// one plane, so each edge adds at most one vertex and the result is a triangle or a quad
+	u32 count = 0;
+	for (u32 i = 0; i < 3; ++i) {
+		const u32 next = (i + 1) % 3;
+		if (distances[i] >= 0.0f) {
+			outPolygon[count++] = clip[i];
+		}
+
+		if ((distances[i] >= 0.0f) != (distances[next] >= 0.0f)) {
+			const f32 t = distances[i] / (distances[i] - distances[next]);
+			vec4 crossing = DirectX::XMVectorLerp(clip[i], clip[next], t);
+			// exactly on the plane, lerp can land a hair in front of it
+			crossing = DirectX::XMVectorSetZ(crossing, 0.0f);
+			outPolygon[count++] = crossing;
+		}
+	}
+
+	return count;
+}
+
+template<typename DrawFunc>
+bool OcclusionCulling::DrawClipped(const vec4 clip[3], u32 width, u32 height, DrawFunc&& draw)
+{
+	vec4 polygon[4];
+	const u32 count = ClipNearPlane(clip, polygon);
+
+	bool drawn = false;
+	TriangleSetup tri;
+	for (u32 i = 2; i < count; ++i) {
+		const vec4 fan[3] = { polygon[0], polygon[i - 1], polygon[i] };
+		if (SetupTriangle(fan, width, height, tri)) {
+			draw(tri);
+			drawn = true;
+		}
+	}
+
+	return drawn;
+}
+
+u32 OcclusionCulling::CoverageMask(const TriangleSetup& tri, u32 tileX, u32 tileY)
+{
+	const f32 x0 = static_cast<f32>(tileX * TileWidth) + 0.5f;
+	const __m128 columnsLow = _mm_setr_ps(x0, x0 + 1.0f, x0 + 2.0f, x0 + 3.0f);
+	const __m128 columnsHigh = _mm_setr_ps(x0 + 4.0f, x0 + 5.0f, x0 + 6.0f, x0 + 7.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	// the x part of each edge function is the same on every row
+	__m128 edgeLow[3];
+	__m128 edgeHigh[3];
+	for (u32 e = 0; e < 3; ++e) {
+		const __m128 a = _mm_set1_ps(tri.edgeA[e]);
+		edgeLow[e] = _mm_mul_ps(a, columnsLow);
+		edgeHigh[e] = _mm_mul_ps(a, columnsHigh);
+	}
+
+	u32 mask = 0;
+	for (u32 row = 0; row < TileHeight; ++row) {
+		const f32 y = static_cast<f32>(tileY * TileHeight + row) + 0.5f;
+
+		__m128 insideLow = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		__m128 insideHigh = insideLow;
+		for (u32 e = 0; e < 3; ++e) {
+			const __m128 rowTerm = _mm_set1_ps(tri.edgeB[e] * y + tri.edgeC[e]);
+			insideLow = _mm_and_ps(insideLow, _mm_cmpge_ps(_mm_add_ps(edgeLow[e], rowTerm), zero));
+			insideHigh = _mm_and_ps(insideHigh, _mm_cmpge_ps(_mm_add_ps(edgeHigh[e], rowTerm), zero));
+		}
+
+		const u32 rowMask = static_cast<u32>(_mm_movemask_ps(insideLow)) | (static_cast<u32>(_mm_movemask_ps(insideHigh)) << 4);
+		mask |= rowMask << (row * TileWidth);
+	}
+
+	return mask;
+}
+
+// same as CoverageMask with a tile row in one register
+TARGET_AVX2 u32 OcclusionCulling::CoverageMaskAVX2(const TriangleSetup& tri, u32 tileX, u32 tileY)
+{
+	const f32 x0 = static_cast<f32>(tileX * TileWidth) + 0.5f;
+	const __m256 columns = _mm256_add_ps(_mm256_set1_ps(x0), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+	const __m256 zero = _mm256_setzero_ps();
+
+	__m256 edge[3];
+	for (u32 e = 0; e < 3; ++e) {
+		edge[e] = _mm256_mul_ps(_mm256_set1_ps(tri.edgeA[e]), columns);
+	}
+
+	u32 mask = 0;
+	for (u32 row = 0; row < TileHeight; ++row) {
+		const f32 y = static_cast<f32>(tileY * TileHeight + row) + 0.5f;
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (u32 e = 0; e < 3; ++e) {
+			const __m256 rowTerm = _mm256_set1_ps(tri.edgeB[e] * y + tri.edgeC[e]);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(edge[e], rowTerm), zero, _CMP_GE_OQ));
+		}
+
+		mask |= static_cast<u32>(_mm256_movemask_ps(inside)) << (row * TileWidth);
+	}
+
+	return mask;
+}
+
+void OcclusionCulling::UpdateTile(Tile& tile, u32 coverage, f32 zTri)
+{
+	// behind what the whole tile already has, nothing to learn
+	if (zTri >= tile.zMax0) {
+		return;
+	}
+
+	// if adding the triangle pushes the working layer back further than the triangle is in front of the
+	// reference layer, the working layer is worth less than starting over, dropping it only loses tightness
+	const f32 dist1 = zTri - tile.zMax1;
+	const f32 dist0 = tile.zMax0 - zTri;
+	if (tile.mask != 0 && dist1 > dist0) {
+		tile.mask = 0;
+		tile.zMax1 = 0.0f;
+	}
+
+	tile.zMax1 = tile.mask != 0 ? std::max(tile.zMax1, zTri) : zTri;
+	tile.mask |= coverage;
+
+	// the working layer covers the tile, it becomes the new reference
+	if (tile.mask == s_fullMask) {
+		tile.zMax0 = tile.zMax1;
+		tile.zMax1 = 0.0f;
+		tile.mask = 0;
+	}
+}
+
+void OcclusionCulling::RasterizeTriangle(const TriangleSetup& tri, bool avx2)
+{
+	const u32 tileMinX = static_cast<u32>(tri.minX) / TileWidth;
+	const u32 tileMaxX = static_cast<u32>(tri.maxX) / TileWidth;
+	const u32 tileMinY = static_cast<u32>(tri.minY) / TileHeight;
+	const u32 tileMaxY = static_cast<u32>(tri.maxY) / TileHeight;
+
+	for (u32 tileY = tileMinY; tileY <= tileMaxY; ++tileY) {
+		// outermost pixel centers in both the tile and the triangles bounds, the plane is linear so its max
+		// over them is at a corner, thin or steep triangles get a much tighter depth than from the tile corners
+		const f32 top = static_cast<f32>(std::max<i32>(tileY * TileHeight, tri.minY)) + 0.5f;
+		const f32 bottom = static_cast<f32>(std::min<i32>(tileY * TileHeight + TileHeight - 1, tri.maxY)) + 0.5f;
+
+		for (u32 tileX = tileMinX; tileX <= tileMaxX; ++tileX) {
+			Tile& tile = m_tiles[tileY * m_tilesX + tileX];
+			if (tri.zMin >= tile.zMax0) {
+				continue;
+			}
+
+			const u32 coverage = avx2 ? CoverageMaskAVX2(tri, tileX, tileY) : CoverageMask(tri, tileX, tileY);
+			if (coverage == 0) {
+				continue;
+			}
+
+			const f32 left = static_cast<f32>(std::max<i32>(tileX * TileWidth, tri.minX)) + 0.5f;
+			const f32 right = static_cast<f32>(std::min<i32>(tileX * TileWidth + TileWidth - 1, tri.maxX)) + 0.5f;
+
+			const f32 zLeft = tri.zA * left + tri.zC;
+			const f32 zRight = tri.zA * right + tri.zC;
+			const f32 zCorners = std::max(zLeft, zRight) + std::max(tri.zB * top, tri.zB * bottom);
+
+			UpdateTile(tile, coverage, std::min(zCorners, tri.zMax));
+		}
+	}
+}
+
+void OcclusionCulling::RenderOccluder(std::span<const float3> positions, std::span<const u32> indices, const mat4& modelToWorld)
+{
+	PROFILE_FUNCTION();
+
+	const mat4 modelToProjection = modelToWorld * m_worldToProjection;
+
+	m_clipPositions.resize(positions.size());
+	for (size_t i = 0; i < positions.size(); ++i) {
+		DirectX::XMStoreFloat4(&m_clipPositions[i], DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&positions[i]), modelToProjection));
+	}
+
+	m_stats.occluders++;
+
+	const bool avx2 = MathBatch::GetIsa() >= MathBatch::Isa::AVX2;
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		const vec4 clip[3] = {
+			DirectX::XMLoadFloat4(&m_clipPositions[indices[i + 0]]),
+			DirectX::XMLoadFloat4(&m_clipPositions[indices[i + 1]]),
+			DirectX::XMLoadFloat4(&m_clipPositions[indices[i + 2]]),
+		};
+
+		const bool drawn = DrawClipped(clip, m_width, m_height, [this, avx2](const TriangleSetup& tri) {
+			RasterizeTriangle(tri, avx2);
+		});
+
+		if (drawn) {
+			m_stats.trianglesRasterized++;
+		} else {
+			m_stats.trianglesSkipped++;
+		}
+	}
+}
+
+bool OcclusionCulling::ProjectBox(const float3& boundsMin, const float3& boundsMax, const mat4& modelToProjection, u32 width, u32 height, ScreenRect& out)
+{
+	f32 minX = FLT_MAX;
+	f32 minY = FLT_MAX;
+	f32 maxX = -FLT_MAX;
+	f32 maxY = -FLT_MAX;
+	f32 minZ = FLT_MAX;
+
+	for (u32 corner = 0; corner < 8; ++corner) {
+		const vec4 position = DirectX::XMVectorSet(
+			(corner & 1) ? boundsMax.x : boundsMin.x,
+			(corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z,
+			1.0f);
+		const vec4 clip = DirectX::XMVector4Transform(position, modelToProjection);
+
+		const f32 z = DirectX::XMVectorGetZ(clip);
+		const f32 w = DirectX::XMVectorGetW(clip);
+
+		// the camera is in or right next to the box, cant say anything
+		if (z < 0.0f || w <= 0.0f) {
+			out = ScreenRect{ .minX = 0, .minY = 0, .maxX = static_cast<i32>(width) - 1, .maxY = static_cast<i32>(height) - 1, .zMin = 0.0f };
+			return true;
+		}
+
+		const f32 invW = 1.0f / w;
+		const f32 x = (DirectX::XMVectorGetX(clip) * invW * 0.5f + 0.5f) * width;
+		const f32 y = (0.5f - DirectX::XMVectorGetY(clip) * invW * 0.5f) * height;
+
+		// w a hair above 0, same as above
+		if (!std::isfinite(x) || !std::isfinite(y)) {
+			out = ScreenRect{ .minX = 0, .minY = 0, .maxX = static_cast<i32>(width) - 1, .maxY = static_cast<i32>(height) - 1, .zMin = 0.0f };
+			return true;
+		}
+
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minZ = std::min(minZ, z * invW);
+	}
+
+	if (maxX < 0.0f || maxY < 0.0f || minX > width || minY > height || minZ > 1.0f) {
+		return false;
+	}
+
+	// every pixel the rect touches, not just the ones whose centers it covers, clamped in float first like
+	// SetupTriangle, a corner close to the camera projects way outside what an i32 holds
+	const f32 lastX = static_cast<f32>(width - 1);
+	const f32 lastY = static_cast<f32>(height - 1);
+	out.minX = static_cast<i32>(std::floor(std::clamp(minX, 0.0f, lastX)));
+	out.minY = static_cast<i32>(std::floor(std::clamp(minY, 0.0f, lastY)));
+	out.maxX = static_cast<i32>(std::floor(std::clamp(maxX, 0.0f, lastX)));
+	out.maxY = static_cast<i32>(std::floor(std::clamp(maxY, 0.0f, lastY)));
+	out.zMin = minZ;
+
+	return true;
+}
+
+bool OcclusionCulling::TestBox(const float3& boundsMin, const float3& boundsMax, const mat4& modelToWorld) const
+{
+	ScreenRect rect;
+	if (!ProjectBox(boundsMin, boundsMax, modelToWorld * m_worldToProjection, m_width, m_height, rect)) {
+		return false;
+	}
+
+	const u32 tileMinX = static_cast<u32>(rect.minX) / TileWidth;
+	const u32 tileMaxX = static_cast<u32>(rect.maxX) / TileWidth;
+	const u32 tileMinY = static_cast<u32>(rect.minY) / TileHeight;
+	const u32 tileMaxY = static_cast<u32>(rect.maxY) / TileHeight;
+
+	for (u32 tileY = tileMinY; tileY <= tileMaxY; ++tileY) {
+		const i32 rowBegin = std::max(rect.minY - static_cast<i32>(tileY * TileHeight), 0);
+		const i32 rowEnd = std::min(rect.maxY - static_cast<i32>(tileY * TileHeight), static_cast<i32>(TileHeight) - 1);
+
+		for (u32 tileX = tileMinX; tileX <= tileMaxX; ++tileX) {
+			const Tile& tile = m_tiles[tileY * m_tilesX + tileX];
+
+			// zMax1 is always in front of zMax0, so this is the whole tile
+			if (rect.zMin >= tile.zMax0) {
+				continue;
+			}
+
+			const i32 columnBegin = std::max(rect.minX - static_cast<i32>(tileX * TileWidth), 0);
+			const i32 columnEnd = std::min(rect.maxX - static_cast<i32>(tileX * TileWidth), static_cast<i32>(TileWidth) - 1);
+
+			const u32 columns = ((1u << (columnEnd + 1)) - 1) & ~((1u << columnBegin) - 1);
+			u32 rectMask = 0;
+			for (i32 row = rowBegin; row <= rowEnd; ++row) {
+				rectMask |= columns << (row * TileWidth);
+			}
+
+			// some of the pixels only have zMax0, which the box is in front of
+			if ((rectMask & ~tile.mask) != 0) {
+				return true;
+			}
+
+			if (rect.zMin < tile.zMax1) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool OcclusionCulling::TestBoxCounted(const float3& boundsMin, const float3& boundsMax, const mat4& modelToWorld)
+{
+	const bool visible = TestBox(boundsMin, boundsMax, modelToWorld);
+
+	m_stats.boxesTested++;
+	if (!visible) {
+		m_stats.boxesCulled++;
+	}
+
+	return visible;
+}
+
+#pragma region benchmark
+
+// plain depth buffer, a float per pixel, drawn with the same triangle setup so the only difference is the masking
+class OcclusionReference {
+public:
+	OcclusionReference(u32 width, u32 height)
+		: m_width(width), m_height(height), m_depth(static_cast<size_t>(width) * height)
+	{
+	}
+
+	void Begin(const mat4& worldToProjection)
+	{
+		m_worldToProjection = worldToProjection;
+		std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+	}
+
+	void RenderOccluder(std::span<const float3> positions, std::span<const u32> indices, const mat4& modelToWorld)
+	{
+		const mat4 modelToProjection = modelToWorld * m_worldToProjection;
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			const vec4 clip[3] = {
+				DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&positions[indices[i + 0]]), modelToProjection),
+				DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&positions[indices[i + 1]]), modelToProjection),
+				DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&positions[indices[i + 2]]), modelToProjection),
+			};
+
+			OcclusionCulling::DrawClipped(clip, m_width, m_height, [this](const OcclusionCulling::TriangleSetup& tri) {
+				RasterizeTriangle(tri);
+			});
+		}
+	}
+
+	bool TestBox(const float3& boundsMin, const float3& boundsMax, const mat4& modelToWorld) const
+	{
+		OcclusionCulling::ScreenRect rect;
+		if (!OcclusionCulling::ProjectBox(boundsMin, boundsMax, modelToWorld * m_worldToProjection, m_width, m_height, rect)) {
+			return false;
+		}
+
+		for (i32 y = rect.minY; y <= rect.maxY; ++y) {
+			for (i32 x = rect.minX; x <= rect.maxX; ++x) {
+				if (rect.zMin < m_depth[y * m_width + x]) {
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+private:
+	void RasterizeTriangle(const OcclusionCulling::TriangleSetup& tri)
+	{
+		for (i32 y = tri.minY; y <= tri.maxY; ++y) {
+			const f32 py = static_cast<f32>(y) + 0.5f;
+			for (i32 x = tri.minX; x <= tri.maxX; ++x) {
+				const f32 px = static_cast<f32>(x) + 0.5f;
+
+				// same operations in the same order as CoverageMask
+				bool inside = true;
+				for (u32 e = 0; e < 3; ++e) {
+					inside &= tri.edgeA[e] * px + (tri.edgeB[e] * py + tri.edgeC[e]) >= 0.0f;
+				}
+
+				if (inside) {
+					f32& depth = m_depth[y * m_width + x];
+					depth = std::min(depth, tri.zA * px + tri.zB * py + tri.zC);
+				}
+			}
+		}
+	}
+
+private:
+	u32 m_width;
+	u32 m_height;
+	mat4 m_worldToProjection = DirectX::XMMatrixIdentity();
+	std::vector<f32> m_depth;
+};
+
+// box with each face split into a grid, so buildings have a realistic triangle count instead of 12
+static void MakeSubdividedBox(u32 divisions, std::vector<float3>& outPositions, std::vector<u32>& outIndices)
+{
+	outPositions.clear();
+	outIndices.clear();
+
+	// each face as an origin and two edges, unit box from -0.5 to 0.5
+	const float3 faces[6][3] = {
+		{ { -0.5f, -0.5f, -0.5f }, { 1, 0, 0 }, { 0, 1, 0 } },
+		{ {  0.5f, -0.5f,  0.5f }, { -1, 0, 0 }, { 0, 1, 0 } },
+		{ { -0.5f, -0.5f,  0.5f }, { 0, 0, -1 }, { 0, 1, 0 } },
+		{ {  0.5f, -0.5f, -0.5f }, { 0, 0, 1 }, { 0, 1, 0 } },
+		{ { -0.5f,  0.5f, -0.5f }, { 1, 0, 0 }, { 0, 0, 1 } },
+		{ { -0.5f, -0.5f,  0.5f }, { 1, 0, 0 }, { 0, 0, -1 } },
+	};
+
+	for (const auto& face : faces) {
+		const u32 base = static_cast<u32>(outPositions.size());
+		for (u32 j = 0; j <= divisions; ++j) {
+			for (u32 i = 0; i <= divisions; ++i) {
+				const f32 u = static_cast<f32>(i) / divisions;
+				const f32 v = static_cast<f32>(j) / divisions;
+				outPositions.push_back(float3(
+					face[0].x + face[1].x * u + face[2].x * v,
+					face[0].y + face[1].y * u + face[2].y * v,
+					face[0].z + face[1].z * u + face[2].z * v));
+			}
+		}
+
+		const u32 stride = divisions + 1;
+		for (u32 j = 0; j < divisions; ++j) {
+			for (u32 i = 0; i < divisions; ++i) {
+				const u32 corner = base + j * stride + i;
+				outIndices.insert(outIndices.end(), { corner, corner + stride, corner + 1, corner + 1, corner + stride, corner + stride + 1 });
+			}
+		}
+	}
+}
+
+bool OcclusionCulling::RunBenchmark()
+{
+	// a grid of city blocks, a building on each, seen from the street
+	constexpr u32 blocksPerSide = 24;
+	constexpr f32 blockSize = 20.0f;
+	constexpr f32 buildingSize = 14.0f;
+	constexpr u32 boxDivisions = 4;
+	constexpr u32 testBoxCount = 20000;
+	constexpr u32 iterations = 20;
+
+	std::vector<float3> boxPositions;
+	std::vector<u32> boxIndices;
+	MakeSubdividedBox(boxDivisions, boxPositions, boxIndices);
+
+	// fixed seed so runs are comparable
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<f32> randomHeight(8.0f, 60.0f);
+	std::uniform_real_distribution<f32> randomPosition(0.0f, blocksPerSide * blockSize);
+	std::uniform_real_distribution<f32> randomSize(0.5f, 3.0f);
+
+	std::vector<mat4> buildings;
+	for (u32 z = 0; z < blocksPerSide; ++z) {
+		for (u32 x = 0; x < blocksPerSide; ++x) {
+			const f32 height = randomHeight(rng);
+			buildings.push_back(DirectX::XMMatrixScaling(buildingSize, height, buildingSize) *
+				DirectX::XMMatrixTranslation((x + 0.5f) * blockSize, height * 0.5f, (z + 0.5f) * blockSize));
+		}
+	}
+
+	// cars, props, people, anything small on or near the ground
+	struct TestBox {
+		float3 min;
+		float3 max;
+	};
+	std::vector<TestBox> testBoxes(testBoxCount);
+	for (TestBox& box : testBoxes) {
+		const f32 x = randomPosition(rng);
+		const f32 z = randomPosition(rng);
+		const f32 size = randomSize(rng);
+		box = TestBox{ .min = float3(x, 0.0f, z), .max = float3(x + size, size, z + size) };
+	}
+
+	const mat4 identity = DirectX::XMMatrixIdentity();
+
+	// standing in the street between the first two columns of blocks, looking down it at an angle
+	const mat4 worldToView = DirectX::XMMatrixLookToLH(
+		DirectX::XMVectorSet(blockSize, 1.7f, 2.0f, 1.0f),
+		DirectX::XMVectorSet(0.35f, 0.0f, 1.0f, 0.0f),
+		DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	const mat4 viewToProjection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XMConvertToRadians(80.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	const mat4 worldToProjection = worldToView * viewToProjection;
+
+	// near to far, the closest occluders fill tiles first and the rest mostly get rejected per tile right away
+	std::sort(buildings.begin(), buildings.end(), [&](const mat4& a, const mat4& b) {
+		return DirectX::XMVectorGetZ(DirectX::XMVector4Transform(a.r[3], worldToView)) < DirectX::XMVectorGetZ(DirectX::XMVector4Transform(b.r[3], worldToView));
+	});
+
+	auto culling = std::make_unique<OcclusionCulling>();
+
+	spdlog::info("occlusion benchmark, {}x{} buffer, {} buildings of {} triangles, {} test boxes",
+		culling->GetWidth(), culling->GetHeight(), buildings.size(), boxIndices.size() / 3, testBoxes.size());
+
+	// the coverage kernel the cpu has against the sse one, the masks have to come out bit for bit the same
+	const MathBatch::Isa previousIsa = MathBatch::GetIsa();
+	const MathBatch::Isa isas[] = { MathBatch::Isa::SSE4, MathBatch::Isa::AVX2 };
+
+	bool passed = true;
+	Data<Tile> sseTiles;
+	f64 rasterMs = 0.0;
+	f64 testMs = 0.0;
+	for (const MathBatch::Isa isa : isas) {
+		if (isa > MathBatch::GetSupportedIsa()) {
+			continue;
+		}
+		MathBatch::SetIsa(isa);
+
+		rasterMs = 0.0;
+		testMs = 0.0;
+		for (u32 i = 0; i < iterations; ++i) {
+			spdlog::stopwatch rasterTime;
+			culling->Begin(worldToProjection);
+			for (const mat4& building : buildings) {
+				culling->RenderOccluder(boxPositions, boxIndices, building);
+			}
+			rasterMs += rasterTime.elapsed().count() * 1000.0;
+
+			spdlog::stopwatch testTime;
+			for (const TestBox& box : testBoxes) {
+				culling->TestBoxCounted(box.min, box.max, identity);
+			}
+			testMs += testTime.elapsed().count() * 1000.0;
+		}
+		rasterMs /= iterations;
+		testMs /= iterations;
+
+		if (isa == MathBatch::Isa::SSE4) {
+			sseTiles = culling->m_tiles;
+			spdlog::info("  {} raster: {:.3f} ms", MathBatch::IsaName(isa), rasterMs);
+		} else {
+			const bool same = sseTiles.size() == culling->m_tiles.size()
+				&& memcmp(sseTiles.data(), culling->m_tiles.data(), sizeof(Tile) * sseTiles.size()) == 0;
+			passed &= same;
+			spdlog::info("  {} raster: {:.3f} ms, depth against sse4 {}", MathBatch::IsaName(isa), rasterMs, same ? "matches" : "MISMATCH");
+		}
+	}
+	MathBatch::SetIsa(previousIsa);
+
+	const Stats& stats = culling->GetStats();
+
+	OcclusionReference reference(culling->GetWidth(), culling->GetHeight());
+	reference.Begin(worldToProjection);
+	for (const mat4& building : buildings) {
+		reference.RenderOccluder(boxPositions, boxIndices, building);
+	}
+
+	u32 offScreen = 0;
+	u32 referenceCulled = 0;
+	u32 wronglyCulled = 0;
+	for (const TestBox& box : testBoxes) {
+		ScreenRect rect;
+		offScreen += ProjectBox(box.min, box.max, worldToProjection, culling->GetWidth(), culling->GetHeight(), rect) ? 0 : 1;
+
+		const bool referenceVisible = reference.TestBox(box.min, box.max, identity);
+		referenceCulled += referenceVisible ? 0 : 1;
+		if (referenceVisible && !culling->TestBox(box.min, box.max, identity)) {
+			wronglyCulled++;
+		}
+	}
+
+	spdlog::info("  raster: {:.3f} ms, {} triangles drawn, {} skipped, {:.1f} M triangles/s",
+		rasterMs, stats.trianglesRasterized, stats.trianglesSkipped, stats.trianglesRasterized / (rasterMs * 1000.0));
+	spdlog::info("  test: {:.3f} ms, {:.1f} ns per box", testMs, testMs * 1e6 / testBoxes.size());
+	spdlog::info("  culled {:.1f}% ({:.1f}% off screen), per pixel reference culls {:.1f}%, {} wrongly culled, {}",
+		100.0 * stats.boxesCulled / stats.boxesTested, 100.0 * offScreen / testBoxes.size(), 100.0 * referenceCulled / testBoxes.size(), wronglyCulled,
+		wronglyCulled == 0 ? "matches" : "MISMATCH");
+	passed &= wronglyCulled == 0;
+
+	// a pole straight down the street reaching way above and below the screen, its corners project further out
+	// than an i32 goes
+	ScreenRect rect;
+	const bool projected = ProjectBox(float3(37.0f, -1e12f, 52.0f), float3(38.0f, 1e12f, 53.0f), worldToProjection, culling->GetWidth(), culling->GetHeight(), rect);
+	const bool inRange = !projected || (rect.minX >= 0 && rect.maxX < static_cast<i32>(culling->GetWidth())
+		&& rect.minY >= 0 && rect.maxY < static_cast<i32>(culling->GetHeight()) && rect.minX <= rect.maxX && rect.minY <= rect.maxY);
+	passed &= inRange;
+	spdlog::info("  huge box rect {}", inRange ? "matches" : "MISMATCH");
+
+	spdlog::info("occlusion checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
+
+#pragma endregion
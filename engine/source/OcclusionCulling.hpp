@@ -0,0 +1,139 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "Math.hpp"
+#include "Core/MemoryTracker.hpp"
+
+#include <span>
+
+// software occlusion culling, occluder meshes are rasterized on the cpu into a small depth buffer
+// and bounding boxes are tested against it before anything is sent to the gpu
+//
+// the depth buffer is masked: the screen is split into 8x4 pixel tiles and instead of a depth per pixel
+// each tile keeps two conservative max depths and a bit mask of which pixels the second one covers:
+//	zMax0 = every pixel of the tile is at least this close
+//	zMax1 = pixels in mask are at least this close
+// when mask fills up the layers merge, so a tile is 12 bytes and a triangle updates it with a few bit ops
+//
+// depth is z / w from the projection, 0 near 1 far
+// conservative at the buffers resolution (coverage is sampled at pixel centers), a box is only reported
+// hidden if every pixel it touches is behind the occluders
+class OcclusionCulling {
+public:
+	static constexpr u32 TileWidth = 8;
+	static constexpr u32 TileHeight = 4;
+
+	// low resolution is plenty, occluders are big
+	static constexpr u32 DefaultWidth = 384;
+	static constexpr u32 DefaultHeight = 216;
+
+	struct Stats {
+		u32 occluders = 0;
+		u32 trianglesRasterized = 0;
+		// behind the camera, off screen or degenerate
+		u32 trianglesSkipped = 0;
+		u32 boxesTested = 0;
+		u32 boxesCulled = 0;
+	};
+
+	OcclusionCulling(u32 width = DefaultWidth, u32 height = DefaultHeight);
+
+	// clears the depth, everything after this uses worldToProjection until the next Begin
+	void Begin(const mat4& worldToProjection);
+
+	// indexed triangle list, rendered double sided since imported meshes dont agree on winding
+	void RenderOccluder(std::span<const float3> positions, std::span<const u32> indices, const mat4& modelToWorld);
+
+	// model space box, false if it is outside the screen or completely behind what was rendered since Begin
+	// doesnt change the depth, so it can be called from several threads at once (stats arent counted then)
+	bool TestBox(const float3& boundsMin, const float3& boundsMax, const mat4& modelToWorld) const;
+
+	// same as TestBox but counted in the stats
+	bool TestBoxCounted(const float3& boundsMin, const float3& boundsMax, const mat4& modelToWorld);
+
+	inline const Stats& GetStats() const { return m_stats; }
+	inline u32 GetWidth() const { return m_width; }
+	inline u32 GetHeight() const { return m_height; }
+
+	// rasterizes a synthetic city and tests boxes scattered through it, checks nothing visible gets culled
+	// against a per pixel depth buffer, runs without a window
+	static bool RunBenchmark();
+
+private:
+	struct Tile {
+		u32 mask;
+		f32 zMax0;
+		f32 zMax1;
+	};
+
+	// screen space vertex, y down, z is depth
+	struct ScreenVertex {
+		f32 x;
+		f32 y;
+		f32 z;
+	};
+
+	// edge functions and depth plane of a triangle ready for rasterizing, edges are >= 0 inside
+	struct TriangleSetup {
+		f32 edgeA[3];
+		f32 edgeB[3];
+		f32 edgeC[3];
+		f32 zA;
+		f32 zB;
+		f32 zC;
+		f32 zMin;
+		f32 zMax;
+		// pixel bounds, inclusive
+		i32 minX;
+		i32 minY;
+		i32 maxX;
+		i32 maxY;
+	};
+
+	struct ScreenRect {
+		i32 minX;
+		i32 minY;
+		i32 maxX;
+		i32 maxY;
+		f32 zMin;
+	};
+
+	// cuts off the part of the triangle in front of the near plane, the result is a fan of 0, 3 or 4 vertices
+	static u32 ClipNearPlane(const vec4 clip[3], vec4 outPolygon[4]);
+	// false if the triangle cant be drawn, see Stats::trianglesSkipped, has to be clipped to the near plane already
+	static bool SetupTriangle(const vec4 clip[3], u32 width, u32 height, TriangleSetup& out);
+	// clips and rasterizes with draw(setup), returns whether anything was drawn
+	template<typename DrawFunc>
+	static bool DrawClipped(const vec4 clip[3], u32 width, u32 height, DrawFunc&& draw);
+	// false if the box is off screen, true with a full screen rect if it crosses the near plane
+	static bool ProjectBox(const float3& boundsMin, const float3& boundsMax, const mat4& modelToProjection, u32 width, u32 height, ScreenRect& out);
+
+	// which pixels of the tile at tileX, tileY the triangle covers, bit = row * TileWidth + column
+	static u32 CoverageMask(const TriangleSetup& tri, u32 tileX, u32 tileY);
+	// the same a row at a time, only call it when MathBatch::GetIsa is avx2
+	static u32 CoverageMaskAVX2(const TriangleSetup& tri, u32 tileX, u32 tileY);
+
+	static void UpdateTile(Tile& tile, u32 coverage, f32 zTri);
+
+	void RasterizeTriangle(const TriangleSetup& tri, bool avx2);
+
+private:
+	template<typename T>
+	using Data = TrackedVector<T, MemoryTag::Scratch>;
+
+	u32 m_width = 0;
+	u32 m_height = 0;
+	u32 m_tilesX = 0;
+	u32 m_tilesY = 0;
+
+	mat4 m_worldToProjection = DirectX::XMMatrixIdentity();
+
+	Data<Tile> m_tiles;
+	// per occluder, reused
+	Data<float4> m_clipPositions;
+
+	Stats m_stats;
+
+	// the benchmarks reference draws the same triangles
+	friend class OcclusionReference;
+};
@@ -0,0 +1,99 @@
+#include "PerfHud.hpp"
+
+#include "Core/FrameStats.hpp"
+#include "Core/MemoryTracker.hpp"
+
+#include <imgui.h>
+
+void DrawPerfHud(const FrameStats& stats)
+{
+	ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
+	ImGui::SetNextWindowSize(ImVec2(360, 0), ImGuiCond_FirstUseEver);
+
+	// everything below only runs while the panel is open
+	if (!ImGui::Begin("Performance")) {
+		ImGui::End();
+		return;
+	}
+
+	const FrameStats::Summary summary = stats.ComputeSummary();
+	const FrameStats::Frame& last = stats.GetLastFrame();
+
+	ImGui::Text("frame %llu  %.2f ms  (%.0f fps avg)", static_cast<unsigned long long>(stats.GetFrameCount()), last.cpuTime,
+		summary.average > 0.0f ? 1000.0f / summary.average : 0.0f);
+	ImGui::Text("p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms", summary.p50, summary.p95, summary.p99, summary.max);
+
+	char overlay[32];
+	snprintf(overlay, sizeof(overlay), "avg %.2f ms", summary.average);
+	ImGui::PlotLines("##frametimes", stats.GetFrameTimeHistory(), stats.GetHistoryCount(), stats.GetHistoryCount() < FrameStats::HistorySize ? 0 : stats.GetHistoryOffset(),
+		overlay, 0.0f, summary.max * 1.2f, ImVec2(-1, 60));
+
+	if (ImGui::CollapsingHeader("Phases", ImGuiTreeNodeFlags_DefaultOpen)
+		&& ImGui::BeginTable("phases", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+		ImGui::TableSetupColumn("phase");
+		ImGui::TableSetupColumn("last");
+		ImGui::TableSetupColumn("p50");
+		ImGui::TableSetupColumn("p95");
+		ImGui::TableHeadersRow();
+
+		for (u32 i = 0; i < static_cast<u32>(FrameStats::Phase::Num); ++i) {
+			const FrameStats::Phase phase = static_cast<FrameStats::Phase>(i);
+			const FrameStats::Summary phaseSummary = stats.ComputePhaseSummary(phase);
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(FrameStats::PhaseToString(phase));
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", last.phaseTimes[i]);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", phaseSummary.p50);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", phaseSummary.p95);
+		}
+
+		ImGui::EndTable();
+	}
+
+	if (ImGui::CollapsingHeader("Renderer", ImGuiTreeNodeFlags_DefaultOpen)) {
+		const FrameStats::RenderCounters& counters = last.counters;
+		ImGui::Text("draws          %u", counters.drawCalls);
+		ImGui::Text("triangles      %llu", static_cast<unsigned long long>(counters.triangles));
+		ImGui::Text("state changes  %u", counters.stateChanges);
+		ImGui::Text("uploaded       %.1f KB", counters.bytesUploaded / 1024.0);
+		ImGui::Text("occluded       %u", counters.occlusionCulled);
+		ImGui::Text("cluster culled %llu", static_cast<unsigned long long>(counters.clusterTrianglesCulled));
+	}
+
+#if ENGINE_MEMORY_TRACKING
+	if (ImGui::CollapsingHeader("Memory")
+		&& ImGui::BeginTable("memory", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+		ImGui::TableSetupColumn("tag");
+		ImGui::TableSetupColumn("live KB");
+		ImGui::TableSetupColumn("peak KB");
+		ImGui::TableSetupColumn("budget KB");
+		ImGui::TableHeadersRow();
+
+		for (u32 i = 0; i < static_cast<u32>(MemoryTag::Num); ++i) {
+			const MemoryTag tag = static_cast<MemoryTag>(i);
+			const MemoryTracker::TagStats tagStats = MemoryTracker::GetStats(tag);
+			const u64 budget = MemoryTracker::GetBudget(tag);
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(MemoryTagToString(tag));
+			ImGui::TableNextColumn();
+			if (budget != 0 && static_cast<u64>(tagStats.live) > budget) {
+				ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%.1f", tagStats.live / 1024.0);
+			} else {
+				ImGui::Text("%.1f", tagStats.live / 1024.0);
+			}
+			ImGui::TableNextColumn(); ImGui::Text("%.1f", tagStats.peak / 1024.0);
+			ImGui::TableNextColumn();
+			if (budget != 0) {
+				ImGui::Text("%.1f", budget / 1024.0);
+			} else {
+				ImGui::TextUnformatted("-");
+			}
+		}
+
+		ImGui::EndTable();
+	}
+#endif
+
+	ImGui::End();
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Basic.hpp"
+
+class FrameStats;
+
+// imgui performance panel, call between ImGui::NewFrame and ImGui::Render
+// does next to nothing while collapsed
+void DrawPerfHud(const FrameStats& stats);
@@ -1,5 +1,10 @@
 #include "SceneSystem.hpp"
 
+#include "Core/Profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
 namespace global 
 {
 	SceneSystem* sceneSystem = nullptr;
@@ -7,21 +12,281 @@ namespace global
 
 RuntimeScene::RuntimeScene()
 {
-	camera = std::make_shared<CameraEntity>();
+	camera = std::allocate_shared<CameraEntity>(TrackedAllocator<CameraEntity, MemoryTag::Scene>());
 	camera->xform.matrix = DirectX::XMMatrixTranslation(0, 0, -3);
 
-	// @TODO: hardcoding
-	staticMeshEntity0 = std::make_shared<StaticMeshEntity>();
+	// @TODO: hardcoding, scenes should come from a file too
+	const AssetCatalog* catalog = global::assetSystem->Catalog();
+
+	staticMeshEntity0 = std::allocate_shared<StaticMeshEntity>(TrackedAllocator<StaticMeshEntity, MemoryTag::Scene>());
 	staticMeshEntity0->xform.matrix = DirectX::XMMatrixIdentity();
-	staticMeshEntity0->meshAsset = {1};
-	staticMeshEntity0->vertShaderAsset = {2};
-	staticMeshEntity0->pixShaderAsset = {3};
-	staticMeshEntity0->texAsset = {0};
+	staticMeshEntity0->meshAsset = catalog->FindMeshAsset(HashPath("meshes/suzanne.glb"));
+	staticMeshEntity0->vertShaderAsset = catalog->FindShaderAsset(HashPath("shaders/simple_deferred_vs.hlsl"));
+	staticMeshEntity0->pixShaderAsset = catalog->FindShaderAsset(HashPath("shaders/simple_deferred_ps.hlsl"));
+	staticMeshEntity0->texAsset = catalog->FindTextureAsset(HashPath("textures/checker.png"));
 
-	staticMeshEntity1 = std::make_shared<StaticMeshEntity>();
+	staticMeshEntity1 = std::allocate_shared<StaticMeshEntity>(TrackedAllocator<StaticMeshEntity, MemoryTag::Scene>());
 	staticMeshEntity1->xform.matrix = DirectX::XMMatrixIdentity();
-	staticMeshEntity1->meshAsset = {2};
-	staticMeshEntity1->vertShaderAsset = {0};
-	staticMeshEntity1->pixShaderAsset = {1};
-	staticMeshEntity1->texAsset = {0};
+	staticMeshEntity1->meshAsset = catalog->FindMeshAsset(HashPath("meshes/two_cubes.glb"));
+	staticMeshEntity1->vertShaderAsset = catalog->FindShaderAsset(HashPath("shaders/simple_vs.hlsl"));
+	staticMeshEntity1->pixShaderAsset = catalog->FindShaderAsset(HashPath("shaders/simple_ps.hlsl"));
+	staticMeshEntity1->texAsset = catalog->FindTextureAsset(HashPath("textures/checker.png"));
+
+	occluderEntity = std::allocate_shared<StaticMeshEntity>(TrackedAllocator<StaticMeshEntity, MemoryTag::Scene>());
+	occluderEntity->xform.matrix = DirectX::XMMatrixScaling(0.6f, 1.0f, 0.05f) * DirectX::XMMatrixTranslation(-2.2f, 0.0f, -1.0f);
+	occluderEntity->meshAsset = catalog->FindMeshAsset(HashPath("meshes/two_cubes.glb"));
+	occluderEntity->vertShaderAsset = staticMeshEntity0->vertShaderAsset;
+	occluderEntity->pixShaderAsset = staticMeshEntity0->pixShaderAsset;
+	occluderEntity->texAsset = staticMeshEntity0->texAsset;
+	occluderEntity->occluder = true;
+
+	// fully behind the wall from where the camera is, culled every frame
+	occludedEntity = std::allocate_shared<StaticMeshEntity>(TrackedAllocator<StaticMeshEntity, MemoryTag::Scene>());
+	occludedEntity->xform.matrix = DirectX::XMMatrixScaling(0.25f, 0.25f, 0.25f) * DirectX::XMMatrixTranslation(-3.2f, 0.0f, 1.0f);
+	occludedEntity->meshAsset = staticMeshEntity0->meshAsset;
+	occludedEntity->vertShaderAsset = staticMeshEntity0->vertShaderAsset;
+	occludedEntity->pixShaderAsset = staticMeshEntity0->pixShaderAsset;
+	occludedEntity->texAsset = staticMeshEntity0->texAsset;
+
+	skinnedEntity = std::allocate_shared<StaticMeshEntity>(TrackedAllocator<StaticMeshEntity, MemoryTag::Scene>());
+	skinnedEntity->xform.matrix = DirectX::XMMatrixTranslation(1.6f, -0.8f, 0.5f);
+	skinnedEntity->meshAsset = catalog->FindMeshAsset(HashPath("meshes/tentacle.glb"));
+	skinnedEntity->vertShaderAsset = staticMeshEntity0->vertShaderAsset;
+	skinnedEntity->pixShaderAsset = staticMeshEntity0->pixShaderAsset;
+	skinnedEntity->texAsset = staticMeshEntity0->texAsset;
+	// the one target of the tentacle, Update swells it
+	skinnedEntity->morphWeights.resize(1);
+
+	// the old single light (intensity makes up for the falloff it didnt have before), plus a ring of coloured ones that Update moves around
+	pointLights.push_back(PointLight{ .position = float3(1.0f, 1.0f, -3.0f), .radius = 10.0f, .color = float3(1.0f, 1.0f, 1.0f), .intensity = 10.0f });
+
+	constexpr u32 ringLights = 32;
+	for (u32 i = 0; i < ringLights; ++i) {
+		const f32 hue = static_cast<f32>(i) / ringLights;
+		const vec4 color = DirectX::XMColorHSVToRGB(DirectX::XMVectorSet(hue, 1.0f, 1.0f, 1.0f));
+
+		// Update puts it on the ring, the color comes from the hue
+		PointLight light = { .position = float3(), .radius = 1.5f, .color = float3(), .intensity = 2.0f };
+		DirectX::XMStoreFloat3(&light.color, color);
+		pointLights.push_back(light);
+	}
+}
+
+
+void RuntimeScene::Update(f64 time)
+{
+	m_time = time;
+
+	const float t = static_cast<float>(time);
+	const float angle = DirectX::XMScalarSin(t);
+	const float moveX = 0.5f * DirectX::XMScalarSin(t * 2.0f);
+	const float moveY = 0.5f * DirectX::XMScalarSin(t * 2.0f);
+
+	const mat4 rotMatrix = DirectX::XMMatrixRotationY(angle + DirectX::XM_PI);
+	const mat4 transMatrix = DirectX::XMMatrixTranslation(moveX, moveY, 0);
+
+	staticMeshEntity0->xform.matrix = rotMatrix * transMatrix;
+
+	// between 0 and 1 around the 0.5 of the file, a cycle every 2 seconds like the clip
+	skinnedEntity->morphWeights[0] = 0.5f + 0.5f * DirectX::XMScalarSin(t * DirectX::XM_PI);
+
+	// pointLights[0] stays put
+	const u32 ringLights = static_cast<u32>(pointLights.size()) - 1;
+	for (u32 i = 0; i < ringLights; ++i) {
+		const f32 phase = DirectX::XM_2PI * static_cast<f32>(i) / ringLights + t * 0.5f;
+		pointLights[i + 1].position = float3(
+			2.0f * DirectX::XMScalarCos(phase),
+			0.75f * DirectX::XMScalarSin(phase * 3.0f),
+			2.0f * DirectX::XMScalarSin(phase));
+	}
+}
+
+void RuntimeScene::WriteSnapshot(u64 frameIndex, RenderSnapshot& outSnapshot) const
+{
+	outSnapshot.frameIndex = frameIndex;
+	outSnapshot.worldToView = camera->GetView();
+	outSnapshot.viewToProjection = camera->GetProjection();
+	DirectX::XMStoreFloat3(&outSnapshot.cameraPosition, camera->xform.matrix.r[3]);
+
+	// @TODO: staticMeshEntity1 uses the forward shaders, add it once there is a forward pass
+	const StaticMeshEntity* entities[] = { staticMeshEntity0.get(), occluderEntity.get(), occludedEntity.get(), skinnedEntity.get() };
+
+	const AssetCatalog* catalog = global::assetSystem->Catalog();
+
+	// occluders first, then everything else gets tested against them
+	bool hasOccluders = false;
+	for (const StaticMeshEntity* entity : entities) {
+		if (!entity->occluder) {
+			continue;
+		}
+
+		const MeshAsset& mesh = catalog->GetMeshAsset(entity->meshAsset);
+		if (mesh.state != AssetState::Loaded) {
+			continue;
+		}
+
+		if (!hasOccluders) {
+			m_occlusionCulling.Begin(outSnapshot.worldToView * outSnapshot.viewToProjection);
+			hasOccluders = true;
+		}
+		m_occluderPositions.resize(mesh.GetVertexCount());
+		mesh.DecodePositions(0, m_occluderPositions, {});
+		m_occlusionCulling.RenderOccluder(m_occluderPositions, mesh.GetIndices(), entity->xform.matrix);
+	}
+
+	outSnapshot.staticMeshes.clear();
+	outSnapshot.clusterIndices.clear();
+	outSnapshot.palettes.clear();
+	outSnapshot.morphWeights.clear();
+	m_clusterCulling.Begin(outSnapshot.worldToView, outSnapshot.viewToProjection);
+	for (const StaticMeshEntity* entity : entities) {
+		const MeshAsset& mesh = catalog->GetMeshAsset(entity->meshAsset);
+
+		// deformed meshes are culled by where their pose puts the vertices this frame, not by the bind pose
+		RenderSnapshot::StaticMesh deformed;
+		Bounds bounds = { .min = mesh.GetBoundsMin(), .max = mesh.GetBoundsMax() };
+		if (mesh.state == AssetState::Loaded && (mesh.IsSkinned() || mesh.HasMorphTargets())) {
+			bounds = Pose(*entity, mesh, outSnapshot, deformed);
+		}
+
+		if (hasOccluders && !entity->occluder) {
+			if (!m_occlusionCulling.TestBoxCounted(bounds.min, bounds.max, entity->xform.matrix)) {
+				if (deformed.paletteOffset != RenderSnapshot::StaticMesh::NotDeformed) {
+					outSnapshot.palettes.resize(deformed.paletteOffset);
+				}
+				if (deformed.morphWeightOffset != RenderSnapshot::StaticMesh::NotDeformed) {
+					outSnapshot.morphWeights.resize(deformed.morphWeightOffset);
+				}
+				continue;
+			}
+		}
+
+		const Material::Desc& material = catalog->GetMaterial(mesh.GetMaterial());
+		const Material::Texture& baseColor = material.GetTexture(Material::TextureSlot::BaseColor);
+		const TextureID materialTexture = baseColor.pathHash != 0 ? catalog->FindTextureAsset(baseColor.pathHash) : TextureID{ InvalidAssetIndex };
+
+		// 0 for shaders without the feature, they draw their base variant
+		const ShaderPermutation::FeatureSet& pixFeatures = catalog->GetShaderAsset(entity->pixShaderAsset).GetFeatures();
+		const ShaderPermutation::Key pixShaderKey = material.alphaMode == Material::AlphaMode::Mask ? pixFeatures.Bit("ALPHA_MASK") : ShaderPermutation::BaseKey;
+
+		RenderSnapshot::StaticMesh staticMesh = {
+			.modelToWorld = entity->xform.matrix,
+			.mesh = entity->meshAsset,
+			.vertShader = entity->vertShaderAsset,
+			.pixShader = entity->pixShaderAsset,
+			.pixShaderKey = pixShaderKey,
+			.texture = materialTexture.value != InvalidAssetIndex ? materialTexture : entity->texAsset,
+			.material = mesh.GetMaterial(),
+			.paletteOffset = deformed.paletteOffset,
+			.morphWeightOffset = deformed.morphWeightOffset,
+		};
+
+		// occluders too, they only need to be whole in the occlusion buffer
+		// the meshlet bounds are of the bind pose, deformed meshes draw whole
+		if (mesh.state == AssetState::Loaded && !mesh.GetMeshlets().empty() && !staticMesh.IsDeformed()) {
+			const ClusterCulling::Range range = m_clusterCulling.Cull(mesh.GetMeshlets(), mesh.GetIndices(), entity->xform.matrix, outSnapshot.clusterIndices);
+			if (range.indexCount == 0) {
+				continue;
+			}
+			staticMesh.clustered = true;
+			staticMesh.clusterIndexOffset = range.indexOffset;
+			staticMesh.clusterIndexCount = range.indexCount;
+		}
+
+		outSnapshot.staticMeshes.push_back(staticMesh);
+	}
+
+	outSnapshot.occlusion = hasOccluders ? m_occlusionCulling.GetStats() : OcclusionCulling::Stats{};
+	outSnapshot.clusters = m_clusterCulling.GetStats();
+
+	const ClusteredLighting::Camera clusterCamera = {
+		.fov = camera->fov,
+		.aspect = camera->aspect,
+		.nearZ = camera->nearZ,
+		.farZ = camera->farZ,
+	};
+	m_lightClustering.Build(clusterCamera, outSnapshot.worldToView, pointLights, outSnapshot.lights);
+}
+
+Bounds RuntimeScene::Pose(const StaticMeshEntity& entity, const MeshAsset& mesh, RenderSnapshot& outSnapshot, RenderSnapshot::StaticMesh& outStaticMesh) const
+{
+	PROFILE_FUNCTION();
+
+	std::span<const f32> weights;
+	if (mesh.HasMorphTargets()) {
+		const Morph::TargetSet& targets = mesh.GetMorphTargets();
+		outStaticMesh.morphWeightOffset = static_cast<u32>(outSnapshot.morphWeights.size());
+		for (u32 t = 0; t < targets.TargetCount(); ++t) {
+			outSnapshot.morphWeights.push_back(t < entity.morphWeights.size() ? entity.morphWeights[t] : targets.targets[t].defaultWeight);
+		}
+		weights = std::span(outSnapshot.morphWeights).subspan(outStaticMesh.morphWeightOffset);
+	}
+
+	if (!mesh.IsSkinned()) {
+		return Skinning::ComputeDeformedBounds(mesh.GetDeformBounds(), {}, weights);
+	}
+
+	const Animation::Skeleton& skeleton = mesh.GetSkeleton();
+	m_jointMatrices.resize(skeleton.JointCount());
+
+	const auto& clips = mesh.GetClips();
+	if (entity.clip < clips.size()) {
+		const Animation::CompressedClip& clip = clips[entity.clip];
+		const Animation::Instance instance = {
+			.layers = {
+				Animation::Layer{
+					.clip = nullptr,
+					.compressedClip = &clip,
+					.time = clip.duration > 0.0f ? static_cast<f32>(std::fmod(m_time, static_cast<f64>(clip.duration))) : 0.0f,
+					.weight = 1.0f,
+				},
+			},
+			.layerCount = 1,
+		};
+		Animation::EvaluateInstances(skeleton, std::span(&instance, 1), m_jointMatrices);
+	} else {
+		Animation::LocalToModel(skeleton, skeleton.restPose, m_jointMatrices);
+	}
+
+	outStaticMesh.paletteOffset = static_cast<u32>(outSnapshot.palettes.size());
+	outSnapshot.palettes.resize(outStaticMesh.paletteOffset + skeleton.JointCount());
+	const std::span<float4x4> palette = std::span(outSnapshot.palettes).subspan(outStaticMesh.paletteOffset);
+	Skinning::BuildPalette(skeleton, m_jointMatrices, palette);
+
+	return Skinning::ComputeDeformedBounds(mesh.GetDeformBounds(), palette, weights);
+}
+
+void MeshDeformer::Deform(const RenderSnapshot& snapshot, const RenderSnapshot::StaticMesh& staticMesh, const MeshAsset& mesh, std::span<Skinning::SkinnedVertex> out)
+{
+	PROFILE_FUNCTION();
+
+	const u32 vertexCount = mesh.GetVertexCount();
+	ENSURE(out.size() == vertexCount, "MeshDeformer::Deform needs a vertex per vertex of the mesh");
+
+	std::span<const float3> positions = mesh.GetPositions();
+	std::span<const float3> normals = mesh.GetNormals();
+
+	// morph targets first, skinning deforms the morphed mesh like glTF says
+	if (staticMesh.morphWeightOffset != RenderSnapshot::StaticMesh::NotDeformed) {
+		const Morph::TargetSet& targets = mesh.GetMorphTargets();
+		m_morphedPositions.resize(positions.size());
+		m_morphedNormals.resize(normals.size());
+		Morph::Evaluate(targets, std::span(snapshot.morphWeights).subspan(staticMesh.morphWeightOffset, targets.TargetCount()),
+			positions, normals, m_morphedPositions, m_morphedNormals);
+		positions = m_morphedPositions;
+		normals = m_morphedNormals;
+	}
+
+	if (staticMesh.paletteOffset == RenderSnapshot::StaticMesh::NotDeformed) {
+		for (u32 v = 0; v < vertexCount; ++v) {
+			// missing normals are zero, same as DX11Mesh
+			out[v] = Skinning::SkinnedVertex{ .position = positions[v], .normal = v < normals.size() ? normals[v] : float3(0.0f, 0.0f, 0.0f) };
+		}
+		return;
+	}
+
+	Skinning::Source source = Skinning::GetSource(mesh);
+	source.positions = positions;
+	source.normals = normals;
+	Skinning::SkinLinear(source, std::span(snapshot.palettes).subspan(staticMesh.paletteOffset, mesh.GetSkeleton().JointCount()), out);
 }
@@ -3,6 +3,10 @@
 #include "Basic.hpp"
 #include "Math.hpp"
 #include "AssetSystem.hpp"
+#include "ClusterCulling.hpp"
+#include "ClusteredLighting.hpp"
+#include "OcclusionCulling.hpp"
+#include "Skinning.hpp"
 
 class SceneSystem;
 namespace global 
@@ -18,13 +22,111 @@ class StaticMeshEntity;
 class Transform;
 
 
+// plain copy of everything the renderer needs to draw a frame, written by the scene update
+// so the scene can move on to the next frame while the renderer is still building commands for this one
+struct RenderSnapshot {
+	struct StaticMesh {
+		static constexpr u32 NotDeformed = 0xffffffff;
+
+		mat4 modelToWorld;
+		MeshID mesh = { 0 };
+		ShaderID vertShader = { 0 };
+		ShaderID pixShader = { 0 };
+		// features of pixShader the material needs, the renderer draws with that variant
+		ShaderPermutation::Key pixShaderKey = ShaderPermutation::BaseKey;
+		TextureID texture = { 0 };
+		MaterialID material = DefaultMaterial;
+
+		// meshes with meshlets draw clusterIndices[clusterIndexOffset, + clusterIndexCount) instead of their own index buffer
+		bool clustered = false;
+		u32 clusterIndexOffset = 0;
+		u32 clusterIndexCount = 0;
+
+		// skinned meshes draw their bind pose through palettes[paletteOffset, + joint count of the mesh), morphed
+		// ones with morphWeights[morphWeightOffset, + target count of the mesh) first, the renderer deforms them
+		// with a MeshDeformer straight into the dynamic position stream of the mesh before the draw
+		u32 paletteOffset = NotDeformed;
+		u32 morphWeightOffset = NotDeformed;
+
+		inline bool IsDeformed() const { return paletteOffset != NotDeformed || morphWeightOffset != NotDeformed; }
+	};
+
+	u64 frameIndex = 0;
+	mat4 worldToView = DirectX::XMMatrixIdentity();
+	mat4 viewToProjection = DirectX::XMMatrixIdentity();
+	float3 cameraPosition = float3(0.0f, 0.0f, 0.0f);
+
+	TrackedVector<StaticMesh, MemoryTag::Scene> staticMeshes;
+
+	// the pose of every deformed mesh this frame, a few matrices and weights instead of all of its vertices
+	TrackedVector<float4x4, MemoryTag::Scene> palettes;
+	TrackedVector<f32, MemoryTag::Scene> morphWeights;
+
+	// visible meshlet triangles of every clustered mesh, uploaded as one index buffer
+	ClusterCulling::Data<u32> clusterIndices;
+	ClusterCulling::Stats clusters;
+
+	// point lights and their cluster assignment, ready to upload
+	ClusteredLighting::Output lights;
+
+	// what the occlusion culling did to get staticMeshes
+	OcclusionCulling::Stats occlusion;
+};
+
+
 class RuntimeScene {
 public:
+	// resolves its assets through the catalog, so construct it after AssetSystem::RegisterAssets
 	RuntimeScene();
+
+	// time is in seconds since startup
+	void Update(f64 time);
+
+	// runs on a worker while the renderer reads the other snapshot, must not touch anything the renderer does
+	void WriteSnapshot(u64 frameIndex, RenderSnapshot& outSnapshot) const;
+
 public:
 	std::shared_ptr<CameraEntity> camera;
 	std::shared_ptr<StaticMeshEntity> staticMeshEntity0;
 	std::shared_ptr<StaticMeshEntity> staticMeshEntity1;
+	// a wall off to the left with a smaller suzanne behind it, so occlusion culling has something to do
+	std::shared_ptr<StaticMeshEntity> occluderEntity;
+	std::shared_ptr<StaticMeshEntity> occludedEntity;
+	// skinned and morphed on the cpu every frame, loops the clip of its mesh
+	std::shared_ptr<StaticMeshEntity> skinnedEntity;
+
+	TrackedVector<PointLight, MemoryTag::Scene> pointLights;
+
+private:
+	// appends the palette and morph weights of the mesh as the entity has it posed this frame to the snapshot,
+	// returns a model space box around where they put the vertices
+	Bounds Pose(const StaticMeshEntity& entity, const MeshAsset& mesh, RenderSnapshot& outSnapshot, RenderSnapshot::StaticMesh& outStaticMesh) const;
+
+private:
+	// seconds, from the last Update
+	f64 m_time = 0.0;
+
+	// only scratch memory, reused by every WriteSnapshot
+	mutable ClusteredLighting m_lightClustering;
+	mutable OcclusionCulling m_occlusionCulling;
+	mutable ClusterCulling m_clusterCulling;
+	// meshes keep packed positions, occluders are unpacked into here to be rasterized
+	mutable TrackedVector<float3, MemoryTag::Scene> m_occluderPositions;
+	mutable TrackedVector<float4x4, MemoryTag::Scene> m_jointMatrices;
+};
+
+
+// morphs and skins the deformed meshes of a snapshot, the renderers run it straight into the vertex stream they
+// draw from, for DX11 the mapped dynamic position buffer, so the vertices are written once a frame and not copied
+class MeshDeformer {
+public:
+	// out has the vertex count of the mesh, it is written in order so it can be write combined memory
+	void Deform(const RenderSnapshot& snapshot, const RenderSnapshot::StaticMesh& staticMesh, const MeshAsset& mesh, std::span<Skinning::SkinnedVertex> out);
+
+private:
+	// only scratch, the morphed bind pose that skinning reads
+	TrackedVector<float3, MemoryTag::Scene> m_morphedPositions;
+	TrackedVector<float3, MemoryTag::Scene> m_morphedNormals;
 };
 
 
@@ -42,6 +144,9 @@ public:
 	}
 
 	std::shared_ptr<RuntimeScene> runtimeScene;
+
+	// double buffered, frame N is drawn from one while the update for frame N+1 writes the other
+	std::array<RenderSnapshot, 2> renderSnapshots;
 };
 
 
@@ -69,11 +174,11 @@ public:
 	float farZ = 100.0f;
 
 public:
-	inline mat4 GetView() {
+	inline mat4 GetView() const {
 		return DirectX::XMMatrixInverse(nullptr, xform.matrix);
 	}
 
-	inline mat4 GetProjection() {
+	inline mat4 GetProjection() const {
 		return DirectX::XMMatrixPerspectiveFovLH(fov, aspect, nearZ, farZ);
 	}
 
@@ -86,6 +191,15 @@ public:
 	MeshID meshAsset = { 0 };
 	ShaderID vertShaderAsset = { 0 };
 	ShaderID pixShaderAsset = { 0 };
+	// drawn when the material of the mesh has no base color texture the catalog knows
 	TextureID texAsset = { 0 };
+
+	// rasterized on the cpu to hide whatever is behind it, meant for big simple meshes like walls,
+	// occluders themselves are always drawn
+	bool occluder = false;
+	// the clip skinned meshes loop, an index into MeshAsset::GetClips, meshes without clips stay in their rest pose
+	u32 clip = 0;
+	// by morph target of the mesh, set by the scene update, targets past the end draw with the weight of the file
+	TrackedVector<f32, MemoryTag::Scene> morphWeights;
 private:
 };
\ No newline at end of file
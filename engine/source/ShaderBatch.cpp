@@ -0,0 +1,204 @@
+#include "ShaderBatch.hpp"
+
+#include "Core/Hash.hpp"
+#include "Core/JobSystem.hpp"
+#include "Core/Log.hpp"
+#include "Core/MemoryTracker.hpp"
+#include "Core/Profiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+using namespace ShaderBatch;
+
+Report ShaderBatch::Compile(std::span<const Input> inputs, std::span<Output> outputs, const CompileFunc& compile)
+{
+	PROFILE_FUNCTION();
+
+	ENSURE(outputs.size() == inputs.size(), "");
+
+	Report report = {
+		.shaderCount = static_cast<u32>(inputs.size()),
+		.threadCount = global::jobSystem->GetThreadCount(),
+	};
+
+	spdlog::stopwatch sw;
+
+	// a shader per job, each takes milliseconds so the job overhead doesnt matter and the load balances best
+	global::jobSystem->ParallelFor(report.shaderCount, 1, [&](u32 begin, u32 end) {
+		for (u32 i = begin; i < end; ++i) {
+			ASSERT(outputs[i].blob == nullptr, "");
+
+			spdlog::stopwatch shaderTime;
+			compile(inputs[i], outputs[i]);
+			outputs[i].ms = shaderTime.elapsed().count() * 1000.0;
+		}
+	});
+
+	report.wallMs = sw.elapsed().count() * 1000.0;
+
+	for (const Output& output : outputs) {
+		report.compileMs += output.ms;
+		report.failedCount += output.Succeeded() ? 0 : 1;
+	}
+
+	return report;
+}
+
+void ShaderBatch::LogReport(std::span<const Input> inputs, std::span<const Output> outputs, const Report& report)
+{
+	constexpr u32 slowestCount = 5;
+
+	for (u32 i = 0; i < report.shaderCount; ++i) {
+		if (!outputs[i].Succeeded()) {
+			LOG_ERROR("shader {} ({}) failed to compile: {}", inputs[i].filePath, inputs[i].variant, outputs[i].messages);
+		} else if (!outputs[i].messages.empty()) {
+			LOG_WARN("shader {} ({}): {}", inputs[i].filePath, inputs[i].variant, outputs[i].messages);
+		}
+	}
+
+	spdlog::info("compiled {} shaders on {} threads in {:.2f}ms, {:.2f}ms of compiling ({:.1f}x), {} failed",
+		report.shaderCount, report.threadCount, report.wallMs, report.compileMs, report.compileMs / std::max(report.wallMs, 1e-3), report.failedCount);
+
+	TrackedVector<u32, MemoryTag::Scratch> order(report.shaderCount);
+	std::iota(order.begin(), order.end(), 0u);
+	const u32 listed = std::min(slowestCount, report.shaderCount);
+	std::partial_sort(order.begin(), order.begin() + listed, order.end(), [&](u32 a, u32 b) {
+		return outputs[a].ms > outputs[b].ms;
+	});
+	for (u32 i = 0; i < listed; ++i) {
+		const u32 slowest = order[i];
+		spdlog::info("  {:.2f}ms {} ({})", outputs[slowest].ms, inputs[slowest].filePath, inputs[slowest].variant);
+	}
+}
+
+// stands in for D3DCompile, burns a made up amount of cpu per shader and fails some of them, the blob is a function of
+// everything in the input so an output that ends up in the wrong slot shows
+static void MockCompile(const Input& input, Output& outOutput)
+{
+	u64 hash = Hash64(input.filePath);
+	hash = Hash64(input.entryFunc, hash);
+	hash = Hash64(input.target, hash);
+	hash = Hash64(input.variant, hash);
+	for (const ShaderMacro& define : input.defines) {
+		hash = Hash64(std::string_view(define.name), hash);
+		hash = Hash64(std::string_view(define.definition), hash);
+	}
+
+	// 0.25 to 2ms, about what a small pixel shader takes
+	const f64 costMs = 0.25 + static_cast<f64>(hash % 8) * 0.25;
+	spdlog::stopwatch sw;
+	while (sw.elapsed().count() * 1000.0 < costMs) {
+		hash = hash * 6364136223846793005ull + 1442695040888963407ull;
+	}
+
+	if (input.variant.ends_with("BROKEN")) {
+		outOutput.messages = fmt::format("{}(1,1): error X3000: syntax error in {}", input.filePath, input.variant);
+		return;
+	}
+
+	const u64 seed = Hash64(input.variant, Hash64(input.filePath));
+	outOutput.blobSize = 16 + seed % 1024;
+	byte* blob = static_cast<byte*>(MemoryTracker::Alloc(MemoryTag::Shader, outOutput.blobSize));
+	for (size_t b = 0; b < outOutput.blobSize; ++b) {
+		blob[b] = static_cast<byte>(Hash64(&b, sizeof(b), seed));
+	}
+	outOutput.blob = blob;
+}
+
+static void FreeOutputs(std::span<Output> outputs)
+{
+	for (Output& output : outputs) {
+		MemoryTracker::Free((void*)output.blob);
+		output = {};
+	}
+}
+
+static bool SameOutputs(std::span<const Output> a, std::span<const Output> b)
+{
+	bool same = a.size() == b.size();
+	for (size_t i = 0; same && i < a.size(); ++i) {
+		same &= a[i].blobSize == b[i].blobSize && a[i].messages == b[i].messages && a[i].Succeeded() == b[i].Succeeded();
+		same &= !a[i].Succeeded() || std::memcmp(a[i].blob, b[i].blob, a[i].blobSize) == 0;
+	}
+	return same;
+}
+
+bool ShaderBatch::RunBenchmark()
+{
+	constexpr u32 fileCount = 16;
+	constexpr u32 variantsPerFile = 8;
+	constexpr u32 shaderCount = fileCount * variantsPerFile;
+	constexpr u32 runs = 3;
+
+	spdlog::info("shader batch benchmark, {} mock shaders on {} threads", shaderCount, global::jobSystem->GetThreadCount());
+
+	// permutations of a few files like the catalog registers them, one of them broken
+	static const char* featureNames[3] = { "FEATURE_0", "FEATURE_1", "FEATURE_2" };
+	ShaderPermutation::FeatureSet features;
+	for (u32 bit = 0; bit < 3; ++bit) {
+		features.Add(featureNames[bit], bit);
+	}
+	ASSERT(features.VariantCount() == variantsPerFile, "");
+
+	TrackedVector<std::string, MemoryTag::Scratch> paths(fileCount);
+	std::vector<std::vector<ShaderMacro>> defines(variantsPerFile);
+	for (u32 f = 0; f < fileCount; ++f) {
+		paths[f] = fmt::format("shaders/mock_{}.hlsl", f);
+	}
+	features.ForEachKey([&](ShaderPermutation::Key key) {
+		features.GetDefines(key, defines[key]);
+	});
+
+	TrackedVector<Input, MemoryTag::Scratch> inputs(shaderCount);
+	u32 expectedFailures = 0;
+	for (u32 i = 0; i < shaderCount; ++i) {
+		const u32 file = i / variantsPerFile;
+		const ShaderPermutation::Key key = i % variantsPerFile;
+		const bool broken = file == 3 && key == 5;
+		inputs[i] = Input{
+			.filePath = paths[file],
+			.entryFunc = "PSMain",
+			.target = "ps_5_0",
+			.defines = defines[key],
+			.variant = broken ? features.Describe(key) + "|BROKEN" : features.Describe(key),
+		};
+		expectedFailures += broken ? 1 : 0;
+	}
+
+	// one after another on this thread, what RegisterAssets used to do
+	TrackedVector<Output, MemoryTag::Scratch> serial(shaderCount);
+	spdlog::stopwatch serialTime;
+	for (u32 i = 0; i < shaderCount; ++i) {
+		MockCompile(inputs[i], serial[i]);
+	}
+	const f64 serialMs = serialTime.elapsed().count() * 1000.0;
+
+	bool passed = true;
+	f64 bestMs = std::numeric_limits<f64>::max();
+	for (u32 r = 0; r < runs; ++r) {
+		TrackedVector<Output, MemoryTag::Scratch> outputs(shaderCount);
+		const Report report = Compile(inputs, outputs, MockCompile);
+		bestMs = std::min(bestMs, report.wallMs);
+
+		const bool same = SameOutputs(serial, outputs);
+		const bool failures = report.failedCount == expectedFailures;
+		passed &= same && failures;
+
+		if (r == 0) {
+			spdlog::info("outputs against serial {}, failures {} of {} expected {}", same ? "matches" : "MISMATCH",
+				report.failedCount, expectedFailures, failures ? "matches" : "MISMATCH");
+			// the failure is on purpose, this is what a broken shader at startup looks like
+			LogReport(inputs, outputs, report);
+		}
+
+		FreeOutputs(outputs);
+	}
+
+	FreeOutputs(serial);
+
+	spdlog::info("serial {:.2f}ms, batch {:.2f}ms, {:.1f}x", serialMs, bestMs, serialMs / std::max(bestMs, 1e-3));
+	spdlog::info("shader batch checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
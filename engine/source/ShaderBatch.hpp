@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "ShaderPermutation.hpp"
+
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+
+// compiles a batch of shaders across the job system, RegisterAssets hands it every shader of the catalog at once
+//
+// the compiler is passed in and runs on the workers, so it has to be thread safe (D3DCompile is) and may only touch
+// the output of its own shader, outputs[i] always belongs to inputs[i] whichever order they compiled in, so writing
+// the results back is a plain loop on the calling thread and comes out the same every run
+//
+// nothing is logged while the batch runs, failures are collected and logged in input order by LogReport afterwards
+namespace ShaderBatch
+{
+	struct Input {
+		std::string_view filePath;
+		std::string_view entryFunc;
+		std::string_view target;
+		std::span<const ShaderMacro> defines;
+		// which permutation of the file, for the report
+		std::string variant;
+	};
+
+	struct Output {
+		// MemoryTag::Shader allocation, whoever takes it frees it with MemoryTracker::Free, null if the compile failed
+		const byte* blob = nullptr;
+		size_t blobSize = 0;
+		// whatever the compiler had to say
+		std::string messages;
+		f64 ms = 0.0;
+
+		inline bool Succeeded() const { return blob != nullptr; }
+	};
+
+	using CompileFunc = std::function<void(const Input& input, Output& outOutput)>;
+
+	struct Report {
+		u32 shaderCount = 0;
+		u32 failedCount = 0;
+		u32 threadCount = 0;
+		// from the start of the batch to the last shader done
+		f64 wallMs = 0.0;
+		// of every shader added up, about what compiling them one after another takes
+		f64 compileMs = 0.0;
+	};
+
+	// outputs has to be as long as inputs and empty, blocks until every shader is done
+	Report Compile(std::span<const Input> inputs, std::span<Output> outputs, const CompileFunc& compile);
+
+	// every failure with its messages in input order, then the timings and the slowest shaders
+	void LogReport(std::span<const Input> inputs, std::span<const Output> outputs, const Report& report);
+
+	// a mock compiler with made up costs and failures, checks that the batch matches a serial compile output for output
+	// and failure for failure, and times both
+	bool RunBenchmark();
+}
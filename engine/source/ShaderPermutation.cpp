@@ -0,0 +1,264 @@
+#include "ShaderPermutation.hpp"
+
+#include "AssetSystem.hpp"
+#include "Core/Log.hpp"
+
+#include <cstring>
+#include <random>
+
+using namespace ShaderPermutation;
+
+bool FeatureSet::Add(std::string_view name, u32 bit)
+{
+	if (bit >= MaxFeatures || name.empty() || m_names[bit] != nullptr || Bit(name) != 0) {
+		return false;
+	}
+
+	m_names[bit] = name.data();
+	m_mask |= 1u << bit;
+	m_count += 1;
+	return true;
+}
+
+Key FeatureSet::Bit(std::string_view name) const
+{
+	for (u32 bit = 0; bit < MaxFeatures; ++bit) {
+		if (m_names[bit] != nullptr && name == m_names[bit]) {
+			return 1u << bit;
+		}
+	}
+	return 0;
+}
+
+void FeatureSet::GetDefines(Key key, std::vector<ShaderMacro>& outDefines) const
+{
+	ASSERT(IsValid(key), "");
+
+	for (u32 bit = 0; bit < MaxFeatures; ++bit) {
+		if (m_names[bit] != nullptr) {
+			outDefines.push_back(ShaderMacro{
+				.name = m_names[bit],
+				.definition = (key & (1u << bit)) != 0 ? "1" : "0",
+			});
+		}
+	}
+}
+
+std::string FeatureSet::Describe(Key key) const
+{
+	std::string description;
+	for (u32 bit = 0; bit < MaxFeatures; ++bit) {
+		if (m_names[bit] != nullptr && (key & (1u << bit)) != 0) {
+			if (!description.empty()) {
+				description += '|';
+			}
+			description += m_names[bit];
+		}
+	}
+	return description.empty() ? "base" : description;
+}
+
+void VariantTable::Reset(Key mask)
+{
+	ASSERT(mask < (1u << MaxFeatures), "");
+
+	m_mask = mask;
+	m_entries.assign(mask + 1, InvalidIndex);
+}
+
+void VariantTable::Set(Key key, u32 index)
+{
+	ASSERT((key & ~m_mask) == 0 && key < m_entries.size(), "");
+
+	m_entries[key] = index;
+}
+
+// the defines of the key have every feature exactly once with the value of its bit
+static bool CheckDefines(const FeatureSet& features, Key key, const std::vector<ShaderMacro>& defines)
+{
+	bool passed = true;
+	u32 found = 0;
+	for (const ShaderMacro& define : defines) {
+		const Key bit = features.Bit(define.name);
+		if (bit != 0) {
+			passed &= std::strcmp(define.definition, (key & bit) != 0 ? "1" : "0") == 0;
+			found += 1;
+		}
+	}
+	return passed && found == features.Count();
+}
+
+static bool CheckGenerated()
+{
+	static const char* names[MaxFeatures] = {
+		"FEATURE_0", "FEATURE_1", "FEATURE_2", "FEATURE_3", "FEATURE_4", "FEATURE_5", "FEATURE_6", "FEATURE_7",
+	};
+
+	bool passed = true;
+
+	// every feature
+	FeatureSet full;
+	for (u32 bit = 0; bit < MaxFeatures; ++bit) {
+		passed &= full.Add(names[bit], bit);
+	}
+	passed &= !full.Add("FEATURE_8", MaxFeatures);
+	passed &= !full.Add("FEATURE_0", 0);
+	passed &= full.VariantCount() == 1u << MaxFeatures;
+
+	VariantTable fullTable;
+	fullTable.Reset(full.Mask());
+
+	u32 keyCount = 0;
+	Key previous = 0;
+	bool ordered = true;
+	bool defines = true;
+	full.ForEachKey([&](Key key) {
+		ordered &= keyCount == 0 ? key == BaseKey : key > previous;
+		previous = key;
+		keyCount += 1;
+
+		std::vector<ShaderMacro> macros;
+		full.GetDefines(key, macros);
+		defines &= macros.size() == MaxFeatures && CheckDefines(full, key, macros);
+
+		// anything that isnt the key itself
+		fullTable.Set(key, key ^ 0x5a5a);
+	});
+
+	bool lookup = true;
+	for (Key key = 0; key < (1u << MaxFeatures); ++key) {
+		lookup &= fullTable.Find(key) == (key ^ 0x5a5a);
+	}
+	lookup &= fullTable.Find(1u << MaxFeatures) == VariantTable::InvalidIndex;
+
+	spdlog::info("{} features: {} keys, ordered {}, defines {}, lookup {}", full.Count(), keyCount,
+		ordered ? "matches" : "MISMATCH", defines ? "matches" : "MISMATCH", lookup ? "matches" : "MISMATCH");
+	passed &= keyCount == full.VariantCount() && ordered && defines && lookup;
+
+	// features on scattered bits, the keys in between are not variants
+	FeatureSet sparse;
+	passed &= sparse.Add(names[1], 1);
+	passed &= sparse.Add(names[4], 4);
+	passed &= !sparse.Add(names[1], 2);
+	passed &= !sparse.Add(names[2], 4);
+
+	VariantTable sparseTable;
+	sparseTable.Reset(sparse.Mask());
+
+	keyCount = 0;
+	sparse.ForEachKey([&](Key key) {
+		keyCount += 1;
+		sparseTable.Set(key, keyCount);
+	});
+
+	bool sparseLookup = keyCount == 4 && sparse.VariantCount() == 4;
+	for (Key key = 0; key <= sparse.Mask() + 1; ++key) {
+		sparseLookup &= sparse.IsValid(key) == (sparseTable.Find(key) != VariantTable::InvalidIndex);
+	}
+	sparseLookup &= sparse.Bit("FEATURE_4") == 0b10000 && sparse.Bit("FEATURE_2") == 0;
+	sparseLookup &= sparse.Describe(0b10010) == "FEATURE_1|FEATURE_4" && sparse.Describe(BaseKey) == "base";
+
+	spdlog::info("{} scattered features: {} keys, lookup {}", sparse.Count(), keyCount, sparseLookup ? "matches" : "MISMATCH");
+	passed &= sparseLookup;
+
+	return passed;
+}
+
+// every shader in the catalog has all its variants registered under the right key, with the right defines
+static bool CheckCatalog()
+{
+	const AssetCatalog* catalog = global::assetSystem->Catalog();
+	const AssetManifest& manifest = catalog->GetManifest();
+
+	bool passed = true;
+	for (u32 i = 0; i < manifest.GetEntryCount(); ++i) {
+		const AssetManifest::Entry& entry = manifest.GetEntry(i);
+		if (entry.type != AssetType::Shader) {
+			continue;
+		}
+
+		const std::string_view path = manifest.GetPath(entry);
+		const ShaderID base = catalog->FindShaderAsset(entry.pathHash);
+		if (base.value == InvalidAssetIndex) {
+			spdlog::error("{} is not registered", path);
+			passed = false;
+			continue;
+		}
+
+		const FeatureSet& features = catalog->GetShaderAsset(base).GetFeatures();
+
+		bool variants = true;
+		features.ForEachKey([&](Key key) {
+			const ShaderID id = catalog->FindShaderVariant(base, key);
+			if (id.value == InvalidAssetIndex) {
+				spdlog::error("{} has no variant {}", path, features.Describe(key));
+				variants = false;
+				return;
+			}
+
+			const ShaderAsset& variant = catalog->GetShaderAsset(id);
+			variants &= variant.GetKey() == key && variant.GetFilePath() == path;
+			variants &= key != BaseKey || id.value == base.value;
+			variants &= CheckDefines(features, key, variant.GetDefines());
+		});
+		// past the mask there is always a bit the shader doesnt have
+		variants &= catalog->FindShaderVariant(base, features.Mask() + 1).value == InvalidAssetIndex;
+
+		spdlog::info("{}: {} features, {} variants {}", path, features.Count(), features.VariantCount(), variants ? "matches" : "MISMATCH");
+		passed &= variants;
+	}
+	return passed;
+}
+
+bool ShaderPermutation::RunBenchmark()
+{
+	constexpr u32 lookupCount = 1 << 22;
+	constexpr u32 runs = 5;
+
+	spdlog::info("shader permutation benchmark, {} features per shader at most", MaxFeatures);
+
+	bool passed = CheckGenerated();
+	passed &= CheckCatalog();
+
+	// what the renderer does per draw, a key picked by the material of the mesh into the table of the shader
+	FeatureSet features;
+	features.Add("FEATURE_0", 0);
+	features.Add("FEATURE_1", 1);
+	features.Add("FEATURE_2", 2);
+
+	VariantTable table;
+	table.Reset(features.Mask());
+	features.ForEachKey([&](Key key) {
+		table.Set(key, key * 3);
+	});
+
+	std::mt19937 rng(49);
+	TrackedVector<Key, MemoryTag::Scratch> keys(lookupCount);
+	for (u32 i = 0; i < lookupCount; ++i) {
+		keys[i] = rng() & features.Mask();
+	}
+
+	f64 bestMs = std::numeric_limits<f64>::max();
+	u64 checksum = 0;
+	for (u32 r = 0; r < runs; ++r) {
+		u64 sum = 0;
+		spdlog::stopwatch sw;
+		for (u32 i = 0; i < lookupCount; ++i) {
+			sum += table.Find(keys[i]);
+		}
+		bestMs = std::min(bestMs, sw.elapsed().count() * 1000.0);
+		checksum = sum;
+	}
+
+	u64 expected = 0;
+	for (u32 i = 0; i < lookupCount; ++i) {
+		expected += keys[i] * 3;
+	}
+
+	spdlog::info("{} lookups {:.2f} ms, {:.2f} ns per lookup, checksum {}", lookupCount, bestMs, bestMs * 1e6 / lookupCount,
+		checksum == expected ? "matches" : "MISMATCH");
+	passed &= checksum == expected;
+
+	spdlog::info("shader permutation checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "Core/MemoryTracker.hpp"
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct ShaderMacro
+{
+	const char* name;
+	const char* definition;
+};
+
+// compile time feature switches of a shader, so one source file builds every variant instead of a copy per combination
+//
+// a shader declares its features in the catalog as feature.NAME=<bit>, a variant is the bitmask of the features
+// it was compiled with, every feature is passed to the compiler as NAME=1 or NAME=0 so the hlsl can #if on it
+//
+// the catalog compiles every combination up front, the variants of a shader sit in a table indexed by the key
+// so picking one at draw time is an array read
+namespace ShaderPermutation
+{
+	template<typename T>
+	using Data = TrackedVector<T, MemoryTag::Shader>;
+
+	using Key = u32;
+
+	// 256 variants per shader at most, they all get compiled at startup
+	constexpr u32 MaxFeatures = 8;
+
+	// the variant with every feature off, always the shader registered at the catalog path
+	constexpr Key BaseKey = 0;
+
+	class FeatureSet {
+	public:
+		// name has to stay alive and null terminated as long as the set, like the strings of the manifest
+		// false if the bit is out of range or either the bit or the name is taken already
+		bool Add(std::string_view name, u32 bit);
+
+		inline Key Mask() const { return m_mask; }
+		inline u32 Count() const { return m_count; }
+		// 1 << Count(), including the base
+		inline u32 VariantCount() const { return 1u << m_count; }
+		// only keys made of declared features
+		inline bool IsValid(Key key) const { return (key & ~m_mask) == 0; }
+
+		// the key bit of a feature, 0 if the shader doesnt have it so asking for a feature a shader doesnt
+		// declare lands on a variant without it
+		Key Bit(std::string_view name) const;
+
+		// every declared feature with 1 if it is in the key, 0 otherwise, appended to outDefines
+		void GetDefines(Key key, std::vector<ShaderMacro>& outDefines) const;
+
+		// names of the features in the key joined by |, "base" for none, for logs
+		std::string Describe(Key key) const;
+
+		// every valid key in increasing order, the base first
+		template<typename Fn>
+		void ForEachKey(Fn&& fn) const
+		{
+			for (Key key = 0; key <= m_mask; ++key) {
+				if (IsValid(key)) {
+					fn(key);
+				}
+			}
+		}
+
+	private:
+		// indexed by bit, null for bits without a feature
+		std::array<const char*, MaxFeatures> m_names = {};
+		Key m_mask = 0;
+		u32 m_count = 0;
+	};
+
+	// key -> index of the compiled variant, dense over [0, mask] since a shader has a handful of features at most
+	class VariantTable {
+	public:
+		static constexpr u32 InvalidIndex = 0xffffffff;
+
+		void Reset(Key mask);
+		void Set(Key key, u32 index);
+
+		// InvalidIndex for keys with bits outside the mask or variants that were never set
+		inline u32 Find(Key key) const
+		{
+			return (key & ~m_mask) == 0 && key < m_entries.size() ? m_entries[key] : InvalidIndex;
+		}
+
+		inline Key Mask() const { return m_mask; }
+
+	private:
+		Data<u32> m_entries;
+		Key m_mask = 0;
+	};
+
+	// key encoding, defines and the variant table checked on a set of generated features and against every shader
+	// the catalog registered, then the lookup timed
+	bool RunBenchmark();
+}
@@ -0,0 +1,772 @@
+#include "Skinning.hpp"
+
+#include "AssetSystem.hpp"
+#include "MathBatch.hpp"
+#include "Core/JobSystem.hpp"
+#include "Core/Profiler.hpp"
+
+#include <immintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <random>
+
+// same as MathBatch.cpp, gcc and clang only emit avx2 in functions marked for it
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+using namespace Skinning;
+
+// a few hundred microseconds of work per job on one core
+static constexpr u32 VerticesPerJob = 16384;
+
+// normals and dual quaternions shorter than this come out as zero instead of nan
+static constexpr f32 s_minLengthSq = 1e-30f;
+
+static constexpr u32 SignBit = 0x80000000u;
+
+Source Skinning::GetSource(const MeshAsset& mesh)
+{
+	ENSURE(mesh.IsSkinned(), "GetSource needs a mesh with joints and weights");
+	ENSURE(mesh.GetNormals().size() == mesh.GetPositions().size(), "a skinned mesh needs a normal per position");
+
+	return Source{
+		.positions = mesh.GetPositions(),
+		.normals = mesh.GetNormals(),
+		.joints = mesh.GetJoints(),
+		.weights = mesh.GetWeights(),
+	};
+}
+
+void Skinning::BuildPalette(const Animation::Skeleton& skeleton, std::span<const float4x4> jointMatrices, std::span<float4x4> out)
+{
+	ENSURE(jointMatrices.size() == skeleton.JointCount() && out.size() == skeleton.JointCount(), "BuildPalette matrices dont match the skeleton");
+	MathBatch::MultiplyMatrices(skeleton.inverseBindMatrices, jointMatrices, out);
+}
+
+void Skinning::BuildDualQuaternions(std::span<const float4x4> palette, std::span<DualQuaternion> out)
+{
+	ENSURE(out.size() == palette.size(), "BuildDualQuaternions output doesnt match the palette");
+
+	for (size_t j = 0; j < palette.size(); ++j) {
+		const float4x4& matrix = palette[j];
+
+		// unit rows leave the rotation, for row vectors like everything else here
+		f32 m[3][3];
+		for (u32 r = 0; r < 3; ++r) {
+			const f32 length = std::sqrt(matrix.m[r][0] * matrix.m[r][0] + matrix.m[r][1] * matrix.m[r][1] + matrix.m[r][2] * matrix.m[r][2]);
+			const f32 invLength = length > 0.0f ? 1.0f / length : 0.0f;
+			for (u32 c = 0; c < 3; ++c) {
+				m[r][c] = matrix.m[r][c] * invLength;
+			}
+		}
+
+		// the inverse of the quaternion to matrix in Animation::LocalToModel, from the largest component
+		// so the divide is never by something small
+		f32 x, y, z, w;
+		const f32 trace = m[0][0] + m[1][1] + m[2][2];
+		if (trace > 0.0f) {
+			const f32 s = std::sqrt(trace + 1.0f) * 2.0f;
+			w = 0.25f * s;
+			x = (m[1][2] - m[2][1]) / s;
+			y = (m[2][0] - m[0][2]) / s;
+			z = (m[0][1] - m[1][0]) / s;
+		} else if (m[0][0] > m[1][1] && m[0][0] > m[2][2]) {
+			const f32 s = std::sqrt(1.0f + m[0][0] - m[1][1] - m[2][2]) * 2.0f;
+			w = (m[1][2] - m[2][1]) / s;
+			x = 0.25f * s;
+			y = (m[0][1] + m[1][0]) / s;
+			z = (m[2][0] + m[0][2]) / s;
+		} else if (m[1][1] > m[2][2]) {
+			const f32 s = std::sqrt(1.0f + m[1][1] - m[0][0] - m[2][2]) * 2.0f;
+			w = (m[2][0] - m[0][2]) / s;
+			x = (m[0][1] + m[1][0]) / s;
+			y = 0.25f * s;
+			z = (m[1][2] + m[2][1]) / s;
+		} else {
+			const f32 s = std::sqrt(1.0f + m[2][2] - m[0][0] - m[1][1]) * 2.0f;
+			w = (m[0][1] - m[1][0]) / s;
+			x = (m[2][0] + m[0][2]) / s;
+			y = (m[1][2] + m[2][1]) / s;
+			z = 0.25f * s;
+		}
+
+		const f32 invLength = 1.0f / std::sqrt(x * x + y * y + z * z + w * w);
+		x *= invLength;
+		y *= invLength;
+		z *= invLength;
+		w *= invLength;
+
+		// dual = 0.5 * (t, 0) * real
+		const f32 tx = matrix.m[3][0] * 0.5f;
+		const f32 ty = matrix.m[3][1] * 0.5f;
+		const f32 tz = matrix.m[3][2] * 0.5f;
+
+		out[j].real = float4(x, y, z, w);
+		out[j].dual = float4(
+			w * tx + ty * z - tz * y,
+			w * ty + tz * x - tx * z,
+			w * tz + tx * y - ty * x,
+			-(tx * x + ty * y + tz * z));
+	}
+}
+
+//
+// scalar, one vertex at a time
+//
+
+static inline void Grow(Bounds& bounds, const float3& p)
+{
+	bounds.min = float3(std::min(bounds.min.x, p.x), std::min(bounds.min.y, p.y), std::min(bounds.min.z, p.z));
+	bounds.max = float3(std::max(bounds.max.x, p.x), std::max(bounds.max.y, p.y), std::max(bounds.max.z, p.z));
+}
+
+static inline float3 Normalize(f32 x, f32 y, f32 z)
+{
+	const f32 invLength = 1.0f / std::sqrt(std::max(x * x + y * y + z * z, s_minLengthSq));
+	return float3(x * invLength, y * invLength, z * invLength);
+}
+
+static void SkinLinearScalar(const Source& source, const float4x4* palette, SkinnedVertex* out, u32 begin, u32 end, Bounds& bounds)
+{
+	for (u32 v = begin; v < end; ++v) {
+		const u16* joints = source.joints[v].index;
+		const f32* weights = &source.weights[v].x;
+
+		// the 4th column of an affine matrix is 0 0 0 1 and never read
+		f32 m[4][3] = {};
+		for (u32 k = 0; k < 4; ++k) {
+			const float4x4& matrix = palette[joints[k]];
+			for (u32 r = 0; r < 4; ++r) {
+				for (u32 c = 0; c < 3; ++c) {
+					m[r][c] += weights[k] * matrix.m[r][c];
+				}
+			}
+		}
+
+		const float3& p = source.positions[v];
+		const float3& n = source.normals[v];
+
+		SkinnedVertex& vertex = out[v];
+		vertex.position = float3(
+			p.x * m[0][0] + p.y * m[1][0] + p.z * m[2][0] + m[3][0],
+			p.x * m[0][1] + p.y * m[1][1] + p.z * m[2][1] + m[3][1],
+			p.x * m[0][2] + p.y * m[1][2] + p.z * m[2][2] + m[3][2]);
+		vertex.normal = Normalize(
+			n.x * m[0][0] + n.y * m[1][0] + n.z * m[2][0],
+			n.x * m[0][1] + n.y * m[1][1] + n.z * m[2][1],
+			n.x * m[0][2] + n.y * m[1][2] + n.z * m[2][2]);
+
+		Grow(bounds, vertex.position);
+	}
+}
+
+static void SkinDualQuaternionScalar(const Source& source, const DualQuaternion* palette, SkinnedVertex* out, u32 begin, u32 end, Bounds& bounds)
+{
+	for (u32 v = begin; v < end; ++v) {
+		const u16* joints = source.joints[v].index;
+		const f32* weights = &source.weights[v].x;
+		const float4& pivot = palette[joints[0]].real;
+
+		f32 real[4] = {};
+		f32 dual[4] = {};
+		for (u32 k = 0; k < 4; ++k) {
+			const DualQuaternion& dq = palette[joints[k]];
+			// q and -q are the same rotation, blend every influence on the same side as the first
+			const f32 side = pivot.x * dq.real.x + pivot.y * dq.real.y + pivot.z * dq.real.z + pivot.w * dq.real.w;
+			const f32 weight = side < 0.0f ? -weights[k] : weights[k];
+			const f32* r = &dq.real.x;
+			const f32* d = &dq.dual.x;
+			for (u32 c = 0; c < 4; ++c) {
+				real[c] += weight * r[c];
+				dual[c] += weight * d[c];
+			}
+		}
+
+		const f32 invLength = 1.0f / std::sqrt(std::max(real[0] * real[0] + real[1] * real[1] + real[2] * real[2] + real[3] * real[3], s_minLengthSq));
+		const f32 rx = real[0] * invLength, ry = real[1] * invLength, rz = real[2] * invLength, rw = real[3] * invLength;
+		const f32 dx = dual[0] * invLength, dy = dual[1] * invLength, dz = dual[2] * invLength, dw = dual[3] * invLength;
+
+		// v + 2 * cross(r, cross(r, v) + w * v)
+		auto rotate = [&](const float3& p) {
+			const f32 tx = ry * p.z - rz * p.y + rw * p.x;
+			const f32 ty = rz * p.x - rx * p.z + rw * p.y;
+			const f32 tz = rx * p.y - ry * p.x + rw * p.z;
+			return float3(
+				p.x + 2.0f * (ry * tz - rz * ty),
+				p.y + 2.0f * (rz * tx - rx * tz),
+				p.z + 2.0f * (rx * ty - ry * tx));
+		};
+
+		// 2 * dual * conjugate(real)
+		const f32 tx = 2.0f * (rw * dx - dw * rx + ry * dz - rz * dy);
+		const f32 ty = 2.0f * (rw * dy - dw * ry + rz * dx - rx * dz);
+		const f32 tz = 2.0f * (rw * dz - dw * rz + rx * dy - ry * dx);
+
+		const float3 p = rotate(source.positions[v]);
+
+		SkinnedVertex& vertex = out[v];
+		vertex.position = float3(p.x + tx, p.y + ty, p.z + tz);
+		vertex.normal = rotate(source.normals[v]);
+
+		Grow(bounds, vertex.position);
+	}
+}
+
+//
+// avx2, linear blend one vertex at a time with two rows per register, dual quaternions 8 vertices at a time
+//
+
+TARGET_AVX2 static void SkinLinearAVX2(const Source& source, const float4x4* palette, SkinnedVertex* out, u32 begin, u32 end, Bounds& bounds)
+{
+	const __m128 minLengthSq = _mm_set1_ps(s_minLengthSq);
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128 boundsMin = _mm_set1_ps(std::numeric_limits<f32>::max());
+	__m128 boundsMax = _mm_set1_ps(-std::numeric_limits<f32>::max());
+
+	for (u32 v = begin; v < end; ++v) {
+		const u16* joints = source.joints[v].index;
+		const f32* weights = &source.weights[v].x;
+
+		// [row0 | row1] and [row2 | row3] of the blended matrix
+		__m256 rows01 = _mm256_setzero_ps();
+		__m256 rows23 = _mm256_setzero_ps();
+		for (u32 k = 0; k < 4; ++k) {
+			const f32* matrix = palette[joints[k]].m[0];
+			const __m256 weight = _mm256_broadcast_ss(&weights[k]);
+			rows01 = _mm256_fmadd_ps(weight, _mm256_loadu_ps(matrix), rows01);
+			rows23 = _mm256_fmadd_ps(weight, _mm256_loadu_ps(matrix + 8), rows23);
+		}
+
+		// [x * row0 | y * row1] + [z * row2 | 1 * row3], then the two halves added
+		const f32* p = &source.positions[v].x;
+		const __m256 xy = _mm256_set_m128(_mm_set1_ps(p[1]), _mm_set1_ps(p[0]));
+		const __m256 z1 = _mm256_set_m128(one, _mm_set1_ps(p[2]));
+		const __m256 positionSum = _mm256_fmadd_ps(xy, rows01, _mm256_mul_ps(z1, rows23));
+		const __m128 position = _mm_add_ps(_mm256_castps256_ps128(positionSum), _mm256_extractf128_ps(positionSum, 1));
+
+		const f32* n = &source.normals[v].x;
+		const __m256 nxy = _mm256_set_m128(_mm_set1_ps(n[1]), _mm_set1_ps(n[0]));
+		const __m256 nz0 = _mm256_set_m128(_mm_setzero_ps(), _mm_set1_ps(n[2]));
+		const __m256 normalSum = _mm256_fmadd_ps(nxy, rows01, _mm256_mul_ps(nz0, rows23));
+		__m128 normal = _mm_add_ps(_mm256_castps256_ps128(normalSum), _mm256_extractf128_ps(normalSum, 1));
+		const __m128 lengthSq = _mm_dp_ps(normal, normal, 0x7f);
+		normal = _mm_div_ps(normal, _mm_sqrt_ps(_mm_max_ps(lengthSq, minLengthSq)));
+
+		// 24 bytes in order, position xyz with normal x in the 4th lane, then normal yz
+		f32* vertex = &out[v].position.x;
+		_mm_storeu_ps(vertex, _mm_blend_ps(position, _mm_shuffle_ps(normal, normal, _MM_SHUFFLE(0, 0, 0, 0)), 0x8));
+		_mm_storel_pi(reinterpret_cast<__m64*>(vertex + 4), _mm_shuffle_ps(normal, normal, _MM_SHUFFLE(3, 3, 2, 1)));
+
+		boundsMin = _mm_min_ps(boundsMin, position);
+		boundsMax = _mm_max_ps(boundsMax, position);
+	}
+
+	alignas(16) f32 lanes[2][4];
+	_mm_store_ps(lanes[0], boundsMin);
+	_mm_store_ps(lanes[1], boundsMax);
+	Grow(bounds, float3(lanes[0][0], lanes[0][1], lanes[0][2]));
+	Grow(bounds, float3(lanes[1][0], lanes[1][1], lanes[1][2]));
+}
+
+TARGET_AVX2 static inline void Transpose8x8(__m256 r[8])
+{
+	const __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+	const __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+	const __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+	const __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+	const __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+	const __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+	const __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+	const __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+	const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+	r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// v + 2 * cross(r, cross(r, v) + w * v) on 8 vectors
+TARGET_AVX2 static inline void Rotate(const __m256 r[4], __m256& x, __m256& y, __m256& z)
+{
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 tx = _mm256_fmadd_ps(r[3], x, _mm256_fmsub_ps(r[1], z, _mm256_mul_ps(r[2], y)));
+	const __m256 ty = _mm256_fmadd_ps(r[3], y, _mm256_fmsub_ps(r[2], x, _mm256_mul_ps(r[0], z)));
+	const __m256 tz = _mm256_fmadd_ps(r[3], z, _mm256_fmsub_ps(r[0], y, _mm256_mul_ps(r[1], x)));
+	x = _mm256_fmadd_ps(two, _mm256_fmsub_ps(r[1], tz, _mm256_mul_ps(r[2], ty)), x);
+	y = _mm256_fmadd_ps(two, _mm256_fmsub_ps(r[2], tx, _mm256_mul_ps(r[0], tz)), y);
+	z = _mm256_fmadd_ps(two, _mm256_fmsub_ps(r[0], ty, _mm256_mul_ps(r[1], tx)), z);
+}
+
+TARGET_AVX2 static void SkinDualQuaternionAVX2(const Source& source, const DualQuaternion* palette, SkinnedVertex* out, u32 begin, u32 end, Bounds& bounds)
+{
+	const __m256i stride3 = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	const __m256i stride4 = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+	const __m256 signBit = _mm256_castsi256_ps(_mm256_set1_epi32(SignBit));
+	const __m256 minLengthSq = _mm256_set1_ps(s_minLengthSq);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+
+	__m256 minX = _mm256_set1_ps(std::numeric_limits<f32>::max());
+	__m256 minY = minX, minZ = minX;
+	__m256 maxX = _mm256_set1_ps(-std::numeric_limits<f32>::max());
+	__m256 maxY = maxX, maxZ = maxX;
+
+	alignas(32) f32 lanes[6][8];
+
+	u32 v = begin;
+	for (; v + 8 <= end; v += 8) {
+		// components c of the 8 blended dual quaternions, real xyzw then dual xyzw
+		__m256 blended[8];
+		__m256 pivot[4];
+		for (u32 k = 0; k < 4; ++k) {
+			__m256 dq[8];
+			for (u32 l = 0; l < 8; ++l) {
+				dq[l] = _mm256_loadu_ps(&palette[source.joints[v + l].index[k]].real.x);
+			}
+			Transpose8x8(dq);
+
+			__m256 weight = _mm256_i32gather_ps(&source.weights[v].x + k, stride4, 4);
+			if (k == 0) {
+				for (u32 c = 0; c < 4; ++c) {
+					pivot[c] = dq[c];
+				}
+				for (u32 c = 0; c < 8; ++c) {
+					blended[c] = _mm256_mul_ps(weight, dq[c]);
+				}
+				continue;
+			}
+
+			// q and -q are the same rotation, blend every influence on the same side as the first
+			const __m256 side = _mm256_fmadd_ps(pivot[3], dq[3], _mm256_fmadd_ps(pivot[2], dq[2], _mm256_fmadd_ps(pivot[1], dq[1], _mm256_mul_ps(pivot[0], dq[0]))));
+			weight = _mm256_xor_ps(weight, _mm256_and_ps(side, signBit));
+			for (u32 c = 0; c < 8; ++c) {
+				blended[c] = _mm256_fmadd_ps(weight, dq[c], blended[c]);
+			}
+		}
+
+		const __m256 lengthSq = _mm256_fmadd_ps(blended[3], blended[3], _mm256_fmadd_ps(blended[2], blended[2], _mm256_fmadd_ps(blended[1], blended[1], _mm256_mul_ps(blended[0], blended[0]))));
+		const __m256 invLength = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_max_ps(lengthSq, minLengthSq)));
+		__m256 r[4], d[4];
+		for (u32 c = 0; c < 4; ++c) {
+			r[c] = _mm256_mul_ps(blended[c], invLength);
+			d[c] = _mm256_mul_ps(blended[c + 4], invLength);
+		}
+
+		// 2 * dual * conjugate(real)
+		const __m256 tx = _mm256_mul_ps(two, _mm256_fmadd_ps(r[3], d[0], _mm256_fnmadd_ps(d[3], r[0], _mm256_fmsub_ps(r[1], d[2], _mm256_mul_ps(r[2], d[1])))));
+		const __m256 ty = _mm256_mul_ps(two, _mm256_fmadd_ps(r[3], d[1], _mm256_fnmadd_ps(d[3], r[1], _mm256_fmsub_ps(r[2], d[0], _mm256_mul_ps(r[0], d[2])))));
+		const __m256 tz = _mm256_mul_ps(two, _mm256_fmadd_ps(r[3], d[2], _mm256_fnmadd_ps(d[3], r[2], _mm256_fmsub_ps(r[0], d[1], _mm256_mul_ps(r[1], d[0])))));
+
+		const f32* positions = &source.positions[v].x;
+		__m256 px = _mm256_i32gather_ps(positions, stride3, 4);
+		__m256 py = _mm256_i32gather_ps(positions + 1, stride3, 4);
+		__m256 pz = _mm256_i32gather_ps(positions + 2, stride3, 4);
+		Rotate(r, px, py, pz);
+		px = _mm256_add_ps(px, tx);
+		py = _mm256_add_ps(py, ty);
+		pz = _mm256_add_ps(pz, tz);
+
+		const f32* normals = &source.normals[v].x;
+		__m256 nx = _mm256_i32gather_ps(normals, stride3, 4);
+		__m256 ny = _mm256_i32gather_ps(normals + 1, stride3, 4);
+		__m256 nz = _mm256_i32gather_ps(normals + 2, stride3, 4);
+		Rotate(r, nx, ny, nz);
+
+		minX = _mm256_min_ps(minX, px);
+		minY = _mm256_min_ps(minY, py);
+		minZ = _mm256_min_ps(minZ, pz);
+		maxX = _mm256_max_ps(maxX, px);
+		maxY = _mm256_max_ps(maxY, py);
+		maxZ = _mm256_max_ps(maxZ, pz);
+
+		// back to interleaved, still written in order
+		_mm256_store_ps(lanes[0], px);
+		_mm256_store_ps(lanes[1], py);
+		_mm256_store_ps(lanes[2], pz);
+		_mm256_store_ps(lanes[3], nx);
+		_mm256_store_ps(lanes[4], ny);
+		_mm256_store_ps(lanes[5], nz);
+		for (u32 l = 0; l < 8; ++l) {
+			out[v + l] = SkinnedVertex{
+				.position = float3(lanes[0][l], lanes[1][l], lanes[2][l]),
+				.normal = float3(lanes[3][l], lanes[4][l], lanes[5][l]),
+			};
+		}
+	}
+
+	_mm256_store_ps(lanes[0], minX);
+	_mm256_store_ps(lanes[1], minY);
+	_mm256_store_ps(lanes[2], minZ);
+	_mm256_store_ps(lanes[3], maxX);
+	_mm256_store_ps(lanes[4], maxY);
+	_mm256_store_ps(lanes[5], maxZ);
+	for (u32 l = 0; l < 8; ++l) {
+		Grow(bounds, float3(lanes[0][l], lanes[1][l], lanes[2][l]));
+		Grow(bounds, float3(lanes[3][l], lanes[4][l], lanes[5][l]));
+	}
+
+	SkinDualQuaternionScalar(source, palette, out, v, end, bounds);
+}
+
+struct Kernels {
+	void (*skinLinear)(const Source& source, const float4x4* palette, SkinnedVertex* out, u32 begin, u32 end, Bounds& bounds);
+	void (*skinDualQuaternion)(const Source& source, const DualQuaternion* palette, SkinnedVertex* out, u32 begin, u32 end, Bounds& bounds);
+};
+
+// indexed by MathBatch::Isa, there is nothing in sse4.1 that beats the scalar loop by enough to be worth a third kernel
+static constexpr Kernels s_kernels[] = {
+	{ SkinLinearScalar, SkinDualQuaternionScalar },
+	{ SkinLinearScalar, SkinDualQuaternionScalar },
+	{ SkinLinearAVX2, SkinDualQuaternionAVX2 },
+};
+
+static inline const Kernels& CurrentKernels()
+{
+	return s_kernels[static_cast<u32>(MathBatch::GetIsa())];
+}
+
+static inline Bounds EmptyBounds()
+{
+	constexpr f32 big = std::numeric_limits<f32>::max();
+	return Bounds{ .min = float3(big, big, big), .max = float3(-big, -big, -big) };
+}
+
+static void CheckSource(const Source& source, size_t outCount)
+{
+	const size_t count = source.positions.size();
+	ENSURE(source.normals.size() == count && source.joints.size() == count && source.weights.size() == count, "skinning source streams dont match");
+	ENSURE(outCount == count, "skinning output doesnt match the source");
+}
+
+// every job grows its own bounds so there is nothing shared to synchronize, merged after
+template<typename Palette, typename Kernel>
+static Bounds Skin(const Source& source, const Palette* palette, SkinnedVertex* out, Kernel kernel)
+{
+	const u32 vertexCount = static_cast<u32>(source.positions.size());
+	const u32 jobCount = (vertexCount + VerticesPerJob - 1) / VerticesPerJob;
+
+	TrackedVector<Bounds, MemoryTag::Scratch> jobBounds(jobCount, EmptyBounds());
+	global::jobSystem->ParallelFor(vertexCount, VerticesPerJob, [&](u32 begin, u32 end) {
+		PROFILE_ZONE("Skin");
+		kernel(source, palette, out, begin, end, jobBounds[begin / VerticesPerJob]);
+	});
+
+	// ParallelFor runs everything as one batch without workers, so some entries can still be empty
+	Bounds bounds = EmptyBounds();
+	for (const Bounds& b : jobBounds) {
+		bounds.min = float3(std::min(bounds.min.x, b.min.x), std::min(bounds.min.y, b.min.y), std::min(bounds.min.z, b.min.z));
+		bounds.max = float3(std::max(bounds.max.x, b.max.x), std::max(bounds.max.y, b.max.y), std::max(bounds.max.z, b.max.z));
+	}
+	return bounds;
+}
+
+Bounds Skinning::SkinLinear(const Source& source, std::span<const float4x4> palette, std::span<SkinnedVertex> out)
+{
+	PROFILE_ZONE("Skinning::SkinLinear");
+	CheckSource(source, out.size());
+	ENSURE(!palette.empty(), "SkinLinear needs a palette");
+	return Skin(source, palette.data(), out.data(), CurrentKernels().skinLinear);
+}
+
+Bounds Skinning::SkinDualQuaternion(const Source& source, std::span<const DualQuaternion> palette, std::span<SkinnedVertex> out)
+{
+	PROFILE_ZONE("Skinning::SkinDualQuaternion");
+	CheckSource(source, out.size());
+	ENSURE(!palette.empty(), "SkinDualQuaternion needs a palette");
+	return Skin(source, palette.data(), out.data(), CurrentKernels().skinDualQuaternion);
+}
+
+DeformBounds Skinning::BuildDeformBounds(std::span<const float3> positions, std::span<const Animation::JointIndices> joints,
+	std::span<const float4> weights, u32 jointCount, const Morph::TargetSet& targets)
+{
+	const bool skinned = !joints.empty();
+	ENSURE(!skinned || (joints.size() == positions.size() && weights.size() == positions.size() && jointCount > 0), "BuildDeformBounds skin streams dont match the positions");
+	ENSURE(targets.Empty() || targets.vertexCount == positions.size(), "BuildDeformBounds morph targets dont match the positions");
+
+	DeformBounds out;
+	out.jointCount = skinned ? jointCount : 1;
+	out.targetCount = targets.TargetCount();
+	out.joints.assign(out.jointCount, EmptyBounds());
+	out.targetExtents.assign(static_cast<size_t>(out.jointCount) * out.targetCount, float3(0.0f, 0.0f, 0.0f));
+
+	// every joint with a weight on vertex v, the whole mesh is joint 0 without a skin
+	auto forEachJoint = [&](u32 v, auto&& func) {
+		if (!skinned) {
+			func(0u);
+			return;
+		}
+		for (u32 k = 0; k < 4; ++k) {
+			if ((&weights[v].x)[k] != 0.0f && joints[v].index[k] < jointCount) {
+				func(static_cast<u32>(joints[v].index[k]));
+			}
+		}
+	};
+
+	for (u32 v = 0; v < positions.size(); ++v) {
+		forEachJoint(v, [&](u32 j) { Grow(out.joints[j], positions[v]); });
+	}
+
+	for (u32 t = 0; t < out.targetCount; ++t) {
+		const Morph::Target& target = targets.targets[t];
+		for (u32 r = target.firstRun; r < target.firstRun + target.runCount; ++r) {
+			const Morph::Run& run = targets.runs[r];
+			for (u32 i = 0; i < run.count; ++i) {
+				const float3& delta = targets.positionDeltas[run.deltaOffset + i];
+				forEachJoint(run.firstVertex + i, [&](u32 j) {
+					float3& extent = out.targetExtents[static_cast<size_t>(j) * out.targetCount + t];
+					extent = float3(std::max(extent.x, std::abs(delta.x)), std::max(extent.y, std::abs(delta.y)), std::max(extent.z, std::abs(delta.z)));
+				});
+			}
+		}
+	}
+
+	return out;
+}
+
+Bounds Skinning::ComputeDeformedBounds(const DeformBounds& bounds, std::span<const float4x4> palette, std::span<const f32> weights)
+{
+	ENSURE(palette.empty() ? bounds.jointCount == 1 : palette.size() == bounds.jointCount, "ComputeDeformedBounds palette doesnt match the joints");
+	ENSURE(weights.size() == bounds.targetCount, "ComputeDeformedBounds weights dont match the morph targets");
+
+	Bounds out = EmptyBounds();
+	for (u32 j = 0; j < bounds.jointCount; ++j) {
+		const Bounds& box = bounds.joints[j];
+		if (box.min.x > box.max.x) {
+			continue;
+		}
+
+		const vec4 min = DirectX::XMLoadFloat3(&box.min);
+		const vec4 max = DirectX::XMLoadFloat3(&box.max);
+		vec4 center = DirectX::XMVectorScale(DirectX::XMVectorAdd(min, max), 0.5f);
+		vec4 extent = DirectX::XMVectorScale(DirectX::XMVectorSubtract(max, min), 0.5f);
+
+		// the morph pushes every vertex of the joint by at most the weighted sum of the largest deltas
+		for (u32 t = 0; t < bounds.targetCount; ++t) {
+			const float3& targetExtent = bounds.targetExtents[static_cast<size_t>(j) * bounds.targetCount + t];
+			extent = DirectX::XMVectorMultiplyAdd(DirectX::XMVectorReplicate(std::abs(weights[t])), DirectX::XMLoadFloat3(&targetExtent), extent);
+		}
+
+		// the box through the joint matrix, each axis of the result takes the absolute rows times the extent
+		if (!palette.empty()) {
+			const mat4 m = DirectX::XMLoadFloat4x4(&palette[j]);
+			center = DirectX::XMVector3Transform(center, m);
+			extent = DirectX::XMVectorMultiplyAdd(DirectX::XMVectorAbs(m.r[0]), DirectX::XMVectorSplatX(extent),
+				DirectX::XMVectorMultiplyAdd(DirectX::XMVectorAbs(m.r[1]), DirectX::XMVectorSplatY(extent),
+					DirectX::XMVectorMultiply(DirectX::XMVectorAbs(m.r[2]), DirectX::XMVectorSplatZ(extent))));
+		}
+
+		float3 jointMin, jointMax;
+		DirectX::XMStoreFloat3(&jointMin, DirectX::XMVectorSubtract(center, extent));
+		DirectX::XMStoreFloat3(&jointMax, DirectX::XMVectorAdd(center, extent));
+		Grow(out, jointMin);
+		Grow(out, jointMax);
+	}
+	return out;
+}
+
+//
+// benchmark
+//
+
+template<typename Func>
+static f64 BestOf(u32 runs, Func&& func)
+{
+	f64 bestMs = std::numeric_limits<f64>::max();
+	for (u32 i = 0; i < runs; ++i) {
+		spdlog::stopwatch sw;
+		func();
+		bestMs = std::min(bestMs, sw.elapsed().count() * 1000.0);
+	}
+	return bestMs;
+}
+
+// relative past 1 like the MathBatch benchmark
+static f32 Error(f32 expected, f32 actual)
+{
+	return std::abs(expected - actual) / std::max(1.0f, std::abs(expected));
+}
+
+static f32 Error(const float3& expected, const float3& actual)
+{
+	return std::max({ Error(expected.x, actual.x), Error(expected.y, actual.y), Error(expected.z, actual.z) });
+}
+
+static f32 MaxError(std::span<const SkinnedVertex> expected, std::span<const SkinnedVertex> actual)
+{
+	f32 error = 0.0f;
+	for (size_t i = 0; i < expected.size(); ++i) {
+		error = std::max({ error, Error(expected[i].position, actual[i].position), Error(expected[i].normal, actual[i].normal) });
+	}
+	return error;
+}
+
+static f32 BoundsError(const Bounds& expected, const Bounds& actual)
+{
+	return std::max(Error(expected.min, actual.min), Error(expected.max, actual.max));
+}
+
+bool Skinning::RunBenchmark()
+{
+	constexpr u32 vertexCount = 1 << 20;
+	constexpr u32 jointCount = 64;
+	constexpr u32 runs = 10;
+	// fma and a different order of operations, a wrong joint or lane is off by far more
+	constexpr f32 tolerance = 1e-4f;
+
+	std::mt19937 rng(45);
+	std::uniform_real_distribution<f32> randomPosition(-1.0f, 1.0f);
+	std::uniform_real_distribution<f32> randomUnit(-1.0f, 1.0f);
+	std::uniform_real_distribution<f32> randomWeight(0.0f, 1.0f);
+	std::uniform_int_distribution<u32> randomJoint(0, jointCount - 1);
+
+	// rigid joints so both methods agree on what the pose is, the reference uses the quaternions the matrices
+	// were built from instead of what BuildDualQuaternions gets back out of them
+	TrackedVector<float4, MemoryTag::Scratch> rotations(jointCount);
+	TrackedVector<float3, MemoryTag::Scratch> translations(jointCount);
+	TrackedVector<float4x4, MemoryTag::Scratch> palette(jointCount);
+	for (u32 j = 0; j < jointCount; ++j) {
+		DirectX::XMStoreFloat4(&rotations[j], DirectX::XMQuaternionNormalize(DirectX::XMVectorSet(randomUnit(rng), randomUnit(rng), randomUnit(rng), randomUnit(rng))));
+		translations[j] = float3(randomPosition(rng), randomPosition(rng), randomPosition(rng));
+		DirectX::XMStoreFloat4x4(&palette[j], DirectX::XMMatrixAffineTransformation(
+			DirectX::XMVectorSplatOne(), DirectX::XMVectorZero(), DirectX::XMLoadFloat4(&rotations[j]), DirectX::XMLoadFloat3(&translations[j])));
+	}
+
+	TrackedVector<DualQuaternion, MemoryTag::Scratch> dualQuaternions(jointCount);
+	BuildDualQuaternions(palette, dualQuaternions);
+
+	TrackedVector<float3, MemoryTag::Scratch> positions(vertexCount);
+	TrackedVector<float3, MemoryTag::Scratch> normals(vertexCount);
+	TrackedVector<Animation::JointIndices, MemoryTag::Scratch> joints(vertexCount);
+	TrackedVector<float4, MemoryTag::Scratch> weights(vertexCount);
+	for (u32 v = 0; v < vertexCount; ++v) {
+		positions[v] = float3(randomPosition(rng), randomPosition(rng), randomPosition(rng));
+		DirectX::XMStoreFloat3(&normals[v], DirectX::XMVector3Normalize(DirectX::XMVectorSet(randomUnit(rng), randomUnit(rng), randomUnit(rng), 0.0f)));
+
+		// like an exporter writes them, 1 to 4 influences heaviest first and the rest 0
+		const u32 influences = 1 + v % 4;
+		f32 w[4] = {};
+		f32 sum = 0.0f;
+		for (u32 k = 0; k < influences; ++k) {
+			w[k] = randomWeight(rng) + 0.01f;
+			sum += w[k];
+		}
+		std::sort(w, w + 4, std::greater<f32>());
+		weights[v] = float4(w[0] / sum, w[1] / sum, w[2] / sum, w[3] / sum);
+		for (u32 k = 0; k < 4; ++k) {
+			joints[v].index[k] = static_cast<u16>(k < influences ? randomJoint(rng) : 0);
+		}
+	}
+
+	const Source source{ .positions = positions, .normals = normals, .joints = joints, .weights = weights };
+
+	TrackedVector<SkinnedVertex, MemoryTag::Scratch> expected(vertexCount);
+	TrackedVector<SkinnedVertex, MemoryTag::Scratch> actual(vertexCount);
+
+	const MathBatch::Isa previousIsa = MathBatch::GetIsa();
+
+	spdlog::info("skinning benchmark, {} threads, {} vertices, {} joints, best of {} runs", global::jobSystem->GetThreadCount(), vertexCount, jointCount, runs);
+
+	bool passed = true;
+
+	// the single threaded directxmath loop is the baseline, then every isa runs the same split over the job system
+	auto report = [&](const char* name, f64 baselineMs, const Bounds& expectedBounds, auto&& runKernel) {
+		spdlog::info("{}: directxmath {:.3f} ms, {:.1f} Mverts/s", name, baselineMs, vertexCount / (baselineMs * 1000.0));
+		for (u32 isa = 0; isa <= static_cast<u32>(MathBatch::GetSupportedIsa()); ++isa) {
+			// would only time the kernels of the isa below it again
+			if (isa > 0 && s_kernels[isa].skinLinear == s_kernels[isa - 1].skinLinear && s_kernels[isa].skinDualQuaternion == s_kernels[isa - 1].skinDualQuaternion) {
+				spdlog::info("    {:<6} runs the {} kernels", MathBatch::IsaName(static_cast<MathBatch::Isa>(isa)), MathBatch::IsaName(static_cast<MathBatch::Isa>(isa - 1)));
+				continue;
+			}
+			MathBatch::SetIsa(static_cast<MathBatch::Isa>(isa));
+			Bounds bounds;
+			const f64 ms = BestOf(runs, [&]() { bounds = runKernel(); });
+			const f32 maxError = std::max(MaxError(expected, actual), BoundsError(expectedBounds, bounds));
+			spdlog::info("    {:<6} {:.3f} ms, {:.1f} Mverts/s, {:.2f}x, max error {:.2e}, {}",
+				MathBatch::IsaName(static_cast<MathBatch::Isa>(isa)), ms, vertexCount / (ms * 1000.0), baselineMs / ms, maxError, maxError <= tolerance ? "matches" : "MISMATCH");
+			passed &= maxError <= tolerance;
+		}
+	};
+
+	{
+		Bounds expectedBounds;
+		const f64 baselineMs = BestOf(runs, [&]() {
+			expectedBounds = EmptyBounds();
+			for (u32 v = 0; v < vertexCount; ++v) {
+				mat4 m(DirectX::XMVectorZero(), DirectX::XMVectorZero(), DirectX::XMVectorZero(), DirectX::XMVectorZero());
+				for (u32 k = 0; k < 4; ++k) {
+					m += DirectX::XMLoadFloat4x4(&palette[joints[v].index[k]]) * (&weights[v].x)[k];
+				}
+				DirectX::XMStoreFloat3(&expected[v].position, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&positions[v]), m));
+				DirectX::XMStoreFloat3(&expected[v].normal, DirectX::XMVector3Normalize(DirectX::XMVector3TransformNormal(DirectX::XMLoadFloat3(&normals[v]), m)));
+				Grow(expectedBounds, expected[v].position);
+			}
+		});
+		report("linear blend", baselineMs, expectedBounds, [&]() { return SkinLinear(source, palette, actual); });
+
+		// what the scene culls with instead of skinning, has to hold every vertex, up to the float error of the kernels
+		const DeformBounds deformBounds = BuildDeformBounds(positions, joints, weights, jointCount, Morph::TargetSet{});
+		const Bounds conservative = ComputeDeformedBounds(deformBounds, palette, {});
+		const bool contained = conservative.min.x <= expectedBounds.min.x + tolerance && conservative.min.y <= expectedBounds.min.y + tolerance
+			&& conservative.min.z <= expectedBounds.min.z + tolerance && conservative.max.x >= expectedBounds.max.x - tolerance
+			&& conservative.max.y >= expectedBounds.max.y - tolerance && conservative.max.z >= expectedBounds.max.z - tolerance;
+		spdlog::info("    deform bounds ({:.2f} {:.2f} {:.2f}) to ({:.2f} {:.2f} {:.2f}) around the skinned ({:.2f} {:.2f} {:.2f}) to ({:.2f} {:.2f} {:.2f}), {}",
+			conservative.min.x, conservative.min.y, conservative.min.z, conservative.max.x, conservative.max.y, conservative.max.z,
+			expectedBounds.min.x, expectedBounds.min.y, expectedBounds.min.z, expectedBounds.max.x, expectedBounds.max.y, expectedBounds.max.z,
+			contained ? "matches" : "MISMATCH");
+		passed &= contained;
+	}
+
+	{
+		Bounds expectedBounds;
+		const f64 baselineMs = BestOf(runs, [&]() {
+			expectedBounds = EmptyBounds();
+			for (u32 v = 0; v < vertexCount; ++v) {
+				const vec4 pivot = DirectX::XMLoadFloat4(&rotations[joints[v].index[0]]);
+				vec4 real = DirectX::XMVectorZero();
+				vec4 dual = DirectX::XMVectorZero();
+				for (u32 k = 0; k < 4; ++k) {
+					const u16 j = joints[v].index[k];
+					const vec4 rotation = DirectX::XMLoadFloat4(&rotations[j]);
+					// dual = 0.5 * (t, 0) * real, directxmath multiplies the other way round
+					const vec4 translation = DirectX::XMVectorSetW(DirectX::XMLoadFloat3(&translations[j]), 0.0f);
+					const vec4 jointDual = DirectX::XMVectorScale(DirectX::XMQuaternionMultiply(rotation, translation), 0.5f);
+					const f32 weight = DirectX::XMVectorGetX(DirectX::XMQuaternionDot(pivot, rotation)) < 0.0f ? -(&weights[v].x)[k] : (&weights[v].x)[k];
+					real = DirectX::XMVectorMultiplyAdd(DirectX::XMVectorReplicate(weight), rotation, real);
+					dual = DirectX::XMVectorMultiplyAdd(DirectX::XMVectorReplicate(weight), jointDual, dual);
+				}
+				const vec4 invLength = DirectX::XMVectorReciprocal(DirectX::XMQuaternionLength(real));
+				real = DirectX::XMVectorMultiply(real, invLength);
+				dual = DirectX::XMVectorMultiply(dual, invLength);
+				const vec4 translation = DirectX::XMVectorScale(DirectX::XMQuaternionMultiply(DirectX::XMQuaternionConjugate(real), dual), 2.0f);
+
+				DirectX::XMStoreFloat3(&expected[v].position, DirectX::XMVectorAdd(DirectX::XMVector3Rotate(DirectX::XMLoadFloat3(&positions[v]), real), translation));
+				DirectX::XMStoreFloat3(&expected[v].normal, DirectX::XMVector3Rotate(DirectX::XMLoadFloat3(&normals[v]), real));
+				Grow(expectedBounds, expected[v].position);
+			}
+		});
+		report("dual quaternion", baselineMs, expectedBounds, [&]() { return SkinDualQuaternion(source, dualQuaternions, actual); });
+	}
+
+	MathBatch::SetIsa(previousIsa);
+
+	spdlog::info("skinning checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "Math.hpp"
+#include "Animation.hpp"
+#include "Morph.hpp"
+
+#include <span>
+
+class MeshAsset;
+
+// cpu skinning, deforms the positions and normals of a mesh with JOINTS_0 and WEIGHTS_0 (see MeshAsset::IsSkinned)
+// by a palette of joint matrices, straight into the vertex stream the renderer draws from
+//
+// linear blend skinning averages the 4 matrices, dual quaternion skinning averages rigid transforms instead so
+// twisting joints keep their volume, but it drops any scale in the palette
+// both have a scalar and an avx2 (with fma) kernel, picked by MathBatch::GetIsa so MathBatch::SetIsa switches
+// these too, sse4 has no kernel of its own and runs the scalar one, every vertex gathers 4 palette matrices by
+// joint index and without the fma of avx2 a 4 wide kernel has little left to win over the scalar loop
+//
+// tangents are not skinned, the attribute stream of DX11Mesh keeps the bind pose ones, no shader reads TANGENT yet
+// since nothing samples normal maps, they go through the palette like the normals once something does
+namespace Skinning
+{
+	// what the kernels write, the layout of DX11Mesh's position stream
+	struct SkinnedVertex {
+		float3 position;
+		float3 normal;
+	};
+
+	struct alignas(32) DualQuaternion {
+		// the rotation
+		float4 real;
+		// half the translation times the rotation
+		float4 dual;
+	};
+
+	struct Source {
+		std::span<const float3> positions;
+		std::span<const float3> normals;
+		std::span<const Animation::JointIndices> joints;
+		std::span<const float4> weights;
+	};
+
+	// the bind pose streams of a skinned mesh
+	Source GetSource(const MeshAsset& mesh);
+
+	// where the vertices of a skinned or morphed mesh can end up, so the scene can cull it without deforming it
+	// a linear blend skinned vertex is a weighted average of its joints' transforms of it, which keeps it inside
+	// the union of the joint boxes moved by the palette
+	struct DeformBounds {
+		// 1 for meshes without a skin, the whole mesh
+		u32 jointCount = 0;
+		u32 targetCount = 0;
+		// bind pose box of the vertices each joint moves, empty (min above max) for joints that move none
+		TrackedVector<Bounds, MemoryTag::AssetsMesh> joints;
+		// jointCount * targetCount, per axis the largest delta the target has on a vertex of the joint
+		TrackedVector<float3, MemoryTag::AssetsMesh> targetExtents;
+	};
+
+	// joints and weights are empty for a mesh that is only morphed, targets for one that is only skinned
+	DeformBounds BuildDeformBounds(std::span<const float3> positions, std::span<const Animation::JointIndices> joints,
+		std::span<const float4> weights, u32 jointCount, const Morph::TargetSet& targets);
+	// model space box around the mesh morphed by weights and skinned by palette, palette is empty without a skin
+	Bounds ComputeDeformedBounds(const DeformBounds& bounds, std::span<const float4x4> palette, std::span<const f32> weights);
+
+	// out[j] = inverseBindMatrices[j] * jointMatrices[j], jointMatrices are the model space joints from
+	// Animation::LocalToModel
+	void BuildPalette(const Animation::Skeleton& skeleton, std::span<const float4x4> jointMatrices, std::span<float4x4> out);
+	// the rigid part of every palette matrix, scale and shear are dropped
+	void BuildDualQuaternions(std::span<const float4x4> palette, std::span<DualQuaternion> out);
+
+	// vertices are split over the job system, every job writes its own range of out in order so out can be
+	// write combined memory, like a mapped dynamic vertex buffer
+	// returns the model space box around the skinned positions, what culling should test instead of the
+	// bind pose bounds of the mesh
+	Bounds SkinLinear(const Source& source, std::span<const float4x4> palette, std::span<SkinnedVertex> out);
+	Bounds SkinDualQuaternion(const Source& source, std::span<const DualQuaternion> palette, std::span<SkinnedVertex> out);
+
+	// a million vertices on a made up skeleton with both methods on every isa with kernels of its own, checked
+	// against a plain DirectXMath loop, and the linear blend result against its DeformBounds
+	bool RunBenchmark();
+}
@@ -0,0 +1,808 @@
+#include "SoftwareRenderer.hpp"
+
+#include "AssetSystem.hpp"
+#include "SceneSystem.hpp"
+#include "Core/JobSystem.hpp"
+#include "Core/Profiler.hpp"
+
+#include <spdlog/stopwatch.h>
+#include <stb/stb_image.h>
+#include <stb/stb_image_write.h>
+
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#include <cmath>
+#include <limits>
+
+static_assert(SoftwareRenderer::TileSize % 4 == 0, "rows are rasterized 4 pixels at a time");
+
+static f32 ElapsedMs(const spdlog::stopwatch& sw)
+{
+	return static_cast<f32>(sw.elapsed().count() * 1000.0);
+}
+
+// mask ? a : b
+static inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// same as PhongTerms in final_deferred_pass_ps.hlsl
+static inline void PhongTerms(f32 metallic, f32 roughness, f32& outKd, f32& outKs, f32& outAlpha)
+{
+	outKd = 0.5f * (1.0f - metallic);
+	outKs = 1.2f * (1.0f - roughness);
+	outAlpha = std::exp2(10.0f * (1.0f - roughness));
+}
+
+static inline __m128 LaneMask(u32 bits)
+{
+	return _mm_castsi128_ps(_mm_setr_epi32(
+		(bits & 1) ? -1 : 0,
+		(bits & 2) ? -1 : 0,
+		(bits & 4) ? -1 : 0,
+		(bits & 8) ? -1 : 0));
+}
+
+SoftwareRenderer::SoftwareRenderer(u32 width, u32 height)
+	: m_width(width), m_height(height)
+{
+	m_tilesX = (width + TileSize - 1) / TileSize;
+	m_tilesY = (height + TileSize - 1) / TileSize;
+	m_stride = m_tilesX * TileSize;
+
+	const size_t pixelCount = static_cast<size_t>(m_stride) * m_tilesY * TileSize;
+	m_gbuffer.depth.resize(pixelCount);
+	for (u32 i = 0; i < 4; ++i) {
+		m_gbuffer.albedo[i].resize(pixelCount);
+	}
+	for (u32 i = 0; i < 3; ++i) {
+		m_gbuffer.wsPosition[i].resize(pixelCount);
+		m_gbuffer.wsNormal[i].resize(pixelCount);
+	}
+	m_gbuffer.metallic.resize(pixelCount);
+	m_gbuffer.roughness.resize(pixelCount);
+
+	m_image.width = width;
+	m_image.height = height;
+	m_image.pixels.resize(static_cast<size_t>(width) * height);
+}
+
+void SoftwareRenderer::Render(const RenderSnapshot& snapshot)
+{
+	PROFILE_FUNCTION();
+	spdlog::stopwatch totalTime;
+
+	m_timings = {};
+	const AssetCatalog* catalog = global::assetSystem->Catalog();
+
+	// simple_deferred_vs
+	{
+		PROFILE_ZONE("SoftwareRenderer::Vertex");
+		spdlog::stopwatch phaseTime;
+
+		m_draws.clear();
+		const std::span<const Material::Constants> materials = catalog->GetMaterialConstants();
+		u32 vertexCount = 0;
+		u32 triangleCount = 0;
+		for (const RenderSnapshot::StaticMesh& staticMesh : snapshot.staticMeshes) {
+			const MeshAsset& mesh = catalog->GetMeshAsset(staticMesh.mesh);
+			m_draws.push_back(Draw{
+				.mesh = &mesh,
+				.texture = &catalog->GetTextureAsset(staticMesh.texture),
+				.material = &materials[staticMesh.material.value],
+				.firstVertex = vertexCount,
+				.firstTriangle = triangleCount,
+			});
+			vertexCount += mesh.GetVertexCount();
+			triangleCount += static_cast<u32>(mesh.GetIndices().size() / 3);
+		}
+
+		m_vertices.resize(vertexCount);
+		m_timings.trianglesIn = triangleCount;
+
+		for (size_t i = 0; i < m_draws.size(); ++i) {
+			const Draw& draw = m_draws[i];
+			const mat4 modelToWorld = snapshot.staticMeshes[i].modelToWorld;
+			const mat4 modelToProjection = modelToWorld * snapshot.worldToView * snapshot.viewToProjection;
+
+			const MeshAsset& mesh = *draw.mesh;
+			Vertex* outVertices = &m_vertices[draw.firstVertex];
+
+			// skinned and morphed meshes as the scene posed them this frame
+			const Skinning::SkinnedVertex* deformed = nullptr;
+			if (snapshot.staticMeshes[i].IsDeformed()) {
+				m_deformedVertices.resize(mesh.GetVertexCount());
+				m_meshDeformer.Deform(snapshot, snapshot.staticMeshes[i], mesh, m_deformedVertices);
+				deformed = m_deformedVertices.data();
+			}
+
+			global::jobSystem->ParallelFor(mesh.GetVertexCount(), VertexBatchSize, [&](u32 begin, u32 end) {
+				// the mesh keeps its vertices packed, a batch at a time comes out as floats, without workers
+				// ParallelFor hands over the whole range in one go
+				float3 positions[VertexBatchSize];
+				float3 normals[VertexBatchSize];
+				float2 uv0s[VertexBatchSize];
+				for (u32 first = begin; first < end; first += VertexBatchSize) {
+					const u32 count = std::min(end - first, VertexBatchSize);
+					mesh.DecodePositions(first, std::span(positions, deformed != nullptr ? 0 : count), std::span(normals, deformed != nullptr ? 0 : count));
+					mesh.DecodeUv0s(first, std::span(uv0s, count));
+
+					for (u32 v = first; v < first + count; ++v) {
+						const vec4 position = DirectX::XMLoadFloat3(deformed != nullptr ? &deformed[v].position : &positions[v - first]);
+						const float3 normal = deformed != nullptr ? deformed[v].normal : normals[v - first];
+
+						Vertex& out = outVertices[v];
+						DirectX::XMStoreFloat4(&out.csPosition, DirectX::XMVector3Transform(position, modelToProjection));
+						DirectX::XMStoreFloat3(&out.wsPosition, DirectX::XMVector3Transform(position, modelToWorld));
+						DirectX::XMStoreFloat3(&out.wsNormal, DirectX::XMVector3TransformNormal(DirectX::XMLoadFloat3(&normal), modelToWorld));
+						out.uv0 = uv0s[v - first];
+					}
+				}
+			});
+		}
+
+		m_timings.vertex = ElapsedMs(phaseTime);
+	}
+
+	const u32 tileCount = m_tilesX * m_tilesY;
+	const u32 triangleCount = m_timings.trianglesIn;
+	const u32 batchCount = (triangleCount + TrianglesPerBatch - 1) / TrianglesPerBatch;
+
+	{
+		PROFILE_ZONE("SoftwareRenderer::Bin");
+		spdlog::stopwatch phaseTime;
+
+		if (m_batches.size() < batchCount) {
+			m_batches.resize(batchCount);
+		}
+
+		global::jobSystem->ParallelFor(batchCount, 1, [&](u32 begin, u32 end) {
+			for (u32 b = begin; b < end; ++b) {
+				PROFILE_ZONE("SoftwareRenderer::BinBatch");
+
+				Batch& batch = m_batches[b];
+				batch.triangles.clear();
+				batch.bins.resize(tileCount);
+				for (Data<u32>& bin : batch.bins) {
+					bin.clear();
+				}
+
+				const u32 first = b * TrianglesPerBatch;
+				const u32 last = std::min(first + TrianglesPerBatch, triangleCount);
+
+				// last draw starting at or before the first triangle, empty draws share firstTriangle with the next one
+				u32 drawIndex = static_cast<u32>(std::upper_bound(m_draws.begin(), m_draws.end(), first, [](u32 triangle, const Draw& draw) {
+					return triangle < draw.firstTriangle;
+				}) - m_draws.begin()) - 1;
+
+				for (u32 t = first; t < last; ++t) {
+					while (drawIndex + 1 < m_draws.size() && m_draws[drawIndex + 1].firstTriangle <= t) {
+						++drawIndex;
+					}
+					const Draw& draw = m_draws[drawIndex];
+					const u32* indices = &draw.mesh->GetIndices()[(t - draw.firstTriangle) * 3];
+
+					const Vertex* triangle[3] = {
+						&m_vertices[draw.firstVertex + indices[0]],
+						&m_vertices[draw.firstVertex + indices[1]],
+						&m_vertices[draw.firstVertex + indices[2]],
+					};
+
+					Vertex polygon[4];
+					const u32 polygonCount = ClipNearPlane(triangle, polygon);
+
+					for (u32 i = 2; i < polygonCount; ++i) {
+						TriangleSetup setup;
+						if (!SetupTriangle(polygon[0], polygon[i - 1], polygon[i], draw.texture, draw.material, setup)) {
+							continue;
+						}
+
+						const u32 index = static_cast<u32>(batch.triangles.size());
+						batch.triangles.push_back(setup);
+
+						for (i32 tileY = setup.minY / TileSize; tileY <= setup.maxY / static_cast<i32>(TileSize); ++tileY) {
+							for (i32 tileX = setup.minX / TileSize; tileX <= setup.maxX / static_cast<i32>(TileSize); ++tileX) {
+								batch.bins[tileY * m_tilesX + tileX].push_back(index);
+							}
+						}
+					}
+				}
+
+				batch.trianglesDrawn = static_cast<u32>(batch.triangles.size());
+			}
+		});
+
+		for (u32 b = 0; b < batchCount; ++b) {
+			m_timings.trianglesDrawn += m_batches[b].trianglesDrawn;
+		}
+
+		m_timings.bin = ElapsedMs(phaseTime);
+	}
+
+	// simple_deferred_ps
+	{
+		PROFILE_ZONE("SoftwareRenderer::Raster");
+		spdlog::stopwatch phaseTime;
+
+		global::jobSystem->ParallelFor(tileCount, 1, [&](u32 begin, u32 end) {
+			for (u32 tile = begin; tile < end; ++tile) {
+				const u32 tileX = tile % m_tilesX;
+				const u32 tileY = tile / m_tilesX;
+
+				ClearTile(tileX, tileY);
+
+				// batches in order, so the depth test ties resolve the same way every time
+				for (u32 b = 0; b < batchCount; ++b) {
+					const Batch& batch = m_batches[b];
+					for (const u32 index : batch.bins[tile]) {
+						RasterizeTriangle(batch.triangles[index], tileX, tileY);
+					}
+				}
+			}
+		});
+
+		m_timings.raster = ElapsedMs(phaseTime);
+	}
+
+	// final_deferred_pass_ps
+	{
+		PROFILE_ZONE("SoftwareRenderer::Resolve");
+		spdlog::stopwatch phaseTime;
+
+		float4x4 worldToView;
+		DirectX::XMStoreFloat4x4(&worldToView, snapshot.worldToView);
+
+		// same as the ClusterBuffer DX11Context uploads
+		const ResolveConstants constants = {
+			.viewZ = float4(worldToView.m[0][2], worldToView.m[1][2], worldToView.m[2][2], worldToView.m[3][2]),
+			.wsCameraPosition = snapshot.cameraPosition,
+			.tileScale = float2(
+				static_cast<f32>(ClusteredLighting::GridSizeX) / m_width,
+				static_cast<f32>(ClusteredLighting::GridSizeY) / m_height),
+			.sliceScale = snapshot.lights.sliceScale,
+			.sliceBias = snapshot.lights.sliceBias,
+		};
+
+		global::jobSystem->ParallelFor(tileCount, 1, [&](u32 begin, u32 end) {
+			for (u32 tile = begin; tile < end; ++tile) {
+				ResolveTile(snapshot, constants, tile % m_tilesX, tile / m_tilesX);
+			}
+		});
+
+		m_timings.resolve = ElapsedMs(phaseTime);
+	}
+
+	m_timings.total = ElapsedMs(totalTime);
+}
+
+u32 SoftwareRenderer::ClipNearPlane(const Vertex* triangle[3], Vertex outPolygon[4])
+{
+	auto lerp = [](const Vertex& a, const Vertex& b, f32 t) {
+		auto mix = [t](const vec4& x, const vec4& y) { return DirectX::XMVectorLerp(x, y, t); };
+
+		Vertex out;
+		DirectX::XMStoreFloat4(&out.csPosition, mix(DirectX::XMLoadFloat4(&a.csPosition), DirectX::XMLoadFloat4(&b.csPosition)));
+		DirectX::XMStoreFloat3(&out.wsPosition, mix(DirectX::XMLoadFloat3(&a.wsPosition), DirectX::XMLoadFloat3(&b.wsPosition)));
+		DirectX::XMStoreFloat3(&out.wsNormal, mix(DirectX::XMLoadFloat3(&a.wsNormal), DirectX::XMLoadFloat3(&b.wsNormal)));
+		DirectX::XMStoreFloat2(&out.uv0, mix(DirectX::XMLoadFloat2(&a.uv0), DirectX::XMLoadFloat2(&b.uv0)));
+		return out;
+	};
+
+	// one plane so the triangle gains at most one vertex, the winding is kept
+	u32 count = 0;
+	for (u32 i = 0; i < 3; ++i) {
+		const Vertex& a = *triangle[i];
+		const Vertex& b = *triangle[(i + 1) % 3];
+		const f32 distanceA = a.csPosition.z;
+		const f32 distanceB = b.csPosition.z;
+
+		if (distanceA >= 0.0f) {
+			outPolygon[count++] = a;
+		}
+		if ((distanceA >= 0.0f) != (distanceB >= 0.0f)) {
+			outPolygon[count++] = lerp(a, b, distanceA / (distanceA - distanceB));
+		}
+	}
+
+	return count;
+}
+
+bool SoftwareRenderer::SetupTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, const TextureAsset* texture, const Material::Constants* material, TriangleSetup& out) const
+{
+	const Vertex* v[3] = { &v0, &v1, &v2 };
+
+	f32 x[3];
+	f32 y[3];
+	for (u32 i = 0; i < 3; ++i) {
+		const float4& cs = v[i]->csPosition;
+		if (!(cs.w > 0.0f)) {
+			return false;
+		}
+
+		const f32 invW = 1.0f / cs.w;
+		// snapped to 1/256 of a pixel like the gpu
+		x[i] = std::round((cs.x * invW * 0.5f + 0.5f) * m_width * 256.0f) / 256.0f;
+		y[i] = std::round((0.5f - cs.y * invW * 0.5f) * m_height * 256.0f) / 256.0f;
+
+		out.z[i] = cs.z * invW;
+		out.invW[i] = invW;
+
+		out.attributes[0][i] = v[i]->wsPosition.x * invW;
+		out.attributes[1][i] = v[i]->wsPosition.y * invW;
+		out.attributes[2][i] = v[i]->wsPosition.z * invW;
+		out.attributes[3][i] = v[i]->wsNormal.x * invW;
+		out.attributes[4][i] = v[i]->wsNormal.y * invW;
+		out.attributes[5][i] = v[i]->wsNormal.z * invW;
+		out.attributes[6][i] = v[i]->uv0.x * invW;
+		out.attributes[7][i] = v[i]->uv0.y * invW;
+	}
+
+	// clockwise on screen is the front (FrontCounterClockwise = false) and back faces are culled
+	const f32 area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (!(area > 0.0f) || !std::isfinite(area)) {
+		return false;
+	}
+
+	// pixels whose centers can be inside, clamped in float first so huge coordinates dont overflow the ints
+	const f32 minX = std::min({ x[0], x[1], x[2] });
+	const f32 maxX = std::max({ x[0], x[1], x[2] });
+	const f32 minY = std::min({ y[0], y[1], y[2] });
+	const f32 maxY = std::max({ y[0], y[1], y[2] });
+
+	out.minX = std::max(static_cast<i32>(std::ceil(std::clamp(minX - 0.5f, -1.0f, static_cast<f32>(m_width)))), 0);
+	out.maxX = std::min(static_cast<i32>(std::floor(std::clamp(maxX - 0.5f, -1.0f, static_cast<f32>(m_width)))), static_cast<i32>(m_width) - 1);
+	out.minY = std::max(static_cast<i32>(std::ceil(std::clamp(minY - 0.5f, -1.0f, static_cast<f32>(m_height)))), 0);
+	out.maxY = std::min(static_cast<i32>(std::floor(std::clamp(maxY - 0.5f, -1.0f, static_cast<f32>(m_height)))), static_cast<i32>(m_height) - 1);
+
+	if (out.minX > out.maxX || out.minY > out.maxY) {
+		return false;
+	}
+
+	for (u32 i = 0; i < 3; ++i) {
+		const u32 a = i;
+		const u32 b = (i + 1) % 3;
+		const f32 dx = x[b] - x[a];
+		const f32 dy = y[b] - y[a];
+
+		out.edgeA[i] = -dy;
+		out.edgeB[i] = dx;
+
+		// evaluated from the same end whichever way round the edge is, so the triangle on the other side
+		// gets exactly the negated value and no pixel on a shared edge is drawn twice or missed
+		const u32 origin = (y[a] < y[b] || (y[a] == y[b] && x[a] < x[b])) ? a : b;
+		out.edgeX[i] = x[origin];
+		out.edgeY[i] = y[origin];
+
+		// y is down, so for a clockwise triangle left edges go up and top edges go right
+		out.topLeft[i] = dy < 0.0f || (dy == 0.0f && dx > 0.0f);
+	}
+
+	out.invArea = 1.0f / area;
+	out.texture = texture;
+	out.material = material;
+
+	return true;
+}
+
+void SoftwareRenderer::ClearTile(u32 tileX, u32 tileY)
+{
+	// same clear values as DX11Context
+	for (u32 y = tileY * TileSize; y < (tileY + 1) * TileSize; ++y) {
+		const size_t row = static_cast<size_t>(y) * m_stride + tileX * TileSize;
+
+		std::fill_n(&m_gbuffer.depth[row], TileSize, 1.0f);
+		for (u32 i = 0; i < 4; ++i) {
+			std::fill_n(&m_gbuffer.albedo[i][row], TileSize, 0.0f);
+		}
+		for (u32 i = 0; i < 3; ++i) {
+			std::fill_n(&m_gbuffer.wsPosition[i][row], TileSize, 0.0f);
+			std::fill_n(&m_gbuffer.wsNormal[i][row], TileSize, 0.0f);
+		}
+		std::fill_n(&m_gbuffer.metallic[row], TileSize, 0.0f);
+		std::fill_n(&m_gbuffer.roughness[row], TileSize, 0.0f);
+	}
+}
+
+void SoftwareRenderer::RasterizeTriangle(const TriangleSetup& tri, u32 tileX, u32 tileY)
+{
+	const i32 tileMinX = static_cast<i32>(tileX * TileSize);
+	const i32 tileMinY = static_cast<i32>(tileY * TileSize);
+
+	// rows start on a multiple of 4 so the loads line up, lanes outside the triangle fail the edge test
+	const i32 minX = std::max(tri.minX, tileMinX) & ~3;
+	const i32 maxX = std::min(tri.maxX, tileMinX + static_cast<i32>(TileSize) - 1);
+	const i32 minY = std::max(tri.minY, tileMinY);
+	const i32 maxY = std::min(tri.maxY, tileMinY + static_cast<i32>(TileSize) - 1);
+
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 invArea = _mm_set1_ps(tri.invArea);
+
+	__m128 edgeA[3];
+	__m128 edgeX[3];
+	__m128 topLeft[3];
+	for (u32 i = 0; i < 3; ++i) {
+		edgeA[i] = _mm_set1_ps(tri.edgeA[i]);
+		edgeX[i] = _mm_set1_ps(tri.edgeX[i]);
+		topLeft[i] = LaneMask(tri.topLeft[i] ? 0xf : 0);
+	}
+
+	for (i32 y = minY; y <= maxY; ++y) {
+		const size_t row = static_cast<size_t>(y) * m_stride;
+		const f32 py = static_cast<f32>(y) + 0.5f;
+
+		// the y part of the edge functions is the same along the row
+		__m128 edgeRow[3];
+		for (u32 i = 0; i < 3; ++i) {
+			edgeRow[i] = _mm_set1_ps(tri.edgeB[i] * (py - tri.edgeY[i]));
+		}
+
+		for (i32 x = minX; x <= maxX; x += 4) {
+			const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<f32>(x)), laneOffsets);
+
+			__m128 edges[3];
+			__m128 inside = LaneMask(0xf);
+			for (u32 i = 0; i < 3; ++i) {
+				edges[i] = _mm_add_ps(_mm_mul_ps(edgeA[i], _mm_sub_ps(px, edgeX[i])), edgeRow[i]);
+				const __m128 covered = _mm_or_ps(_mm_cmpgt_ps(edges[i], zero), _mm_and_ps(_mm_cmpeq_ps(edges[i], zero), topLeft[i]));
+				inside = _mm_and_ps(inside, covered);
+			}
+
+			if (_mm_movemask_ps(inside) == 0) {
+				continue;
+			}
+
+			// edge i is 0 at vertex i + 2, so it is that vertex's weight
+			const __m128 weights[3] = {
+				_mm_mul_ps(edges[1], invArea),
+				_mm_mul_ps(edges[2], invArea),
+				_mm_mul_ps(edges[0], invArea),
+			};
+			auto interpolate = [&weights](const f32 values[3]) {
+				return _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(weights[0], _mm_set1_ps(values[0])),
+					_mm_mul_ps(weights[1], _mm_set1_ps(values[1]))),
+					_mm_mul_ps(weights[2], _mm_set1_ps(values[2])));
+			};
+
+			// z / w is linear in screen space, clipped to [0, 1] and tested LESS like the gpu
+			f32* depth = &m_gbuffer.depth[row + x];
+			const __m128 z = interpolate(tri.z);
+			const __m128 oldDepth = _mm_loadu_ps(depth);
+			inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(z, zero), _mm_cmple_ps(z, one)));
+			inside = _mm_and_ps(inside, _mm_cmplt_ps(z, oldDepth));
+
+			const u32 laneBits = static_cast<u32>(_mm_movemask_ps(inside));
+			if (laneBits == 0) {
+				continue;
+			}
+
+			const __m128 w = _mm_div_ps(one, interpolate(tri.invW));
+			__m128 attributes[AttributeCount];
+			for (u32 i = 0; i < AttributeCount; ++i) {
+				attributes[i] = _mm_mul_ps(interpolate(tri.attributes[i]), w);
+			}
+
+			// texture fetches dont vectorize, sample lane by lane
+			alignas(16) f32 u[4];
+			alignas(16) f32 v[4];
+			_mm_store_ps(u, attributes[6]);
+			_mm_store_ps(v, attributes[7]);
+
+			const Material::Constants& material = *tri.material;
+			const f32 baseColor[4] = { material.baseColorFactor.x, material.baseColorFactor.y, material.baseColorFactor.z, material.baseColorFactor.w };
+
+			alignas(16) f32 albedo[4][4] = {};
+			for (u32 lane = 0; lane < 4; ++lane) {
+				if (laneBits & (1 << lane)) {
+					f32 color[4];
+					SampleTexture(*tri.texture, u[lane], v[lane], color);
+					for (u32 c = 0; c < 4; ++c) {
+						albedo[c][lane] = color[c] * baseColor[c];
+					}
+				}
+			}
+
+			// clip(albedo.a - alphaCutoff), before anything of the pixel is written
+			if (material.alphaMode == static_cast<u32>(Material::AlphaMode::Mask)) {
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_load_ps(albedo[3]), _mm_set1_ps(material.alphaCutoff)));
+				if (_mm_movemask_ps(inside) == 0) {
+					continue;
+				}
+			}
+
+			_mm_storeu_ps(depth, Select(inside, z, oldDepth));
+
+			for (u32 i = 0; i < 3; ++i) {
+				f32* position = &m_gbuffer.wsPosition[i][row + x];
+				_mm_storeu_ps(position, Select(inside, attributes[i], _mm_loadu_ps(position)));
+
+				f32* normal = &m_gbuffer.wsNormal[i][row + x];
+				_mm_storeu_ps(normal, Select(inside, attributes[3 + i], _mm_loadu_ps(normal)));
+			}
+
+			for (u32 c = 0; c < 4; ++c) {
+				f32* plane = &m_gbuffer.albedo[c][row + x];
+				_mm_storeu_ps(plane, Select(inside, _mm_load_ps(albedo[c]), _mm_loadu_ps(plane)));
+			}
+
+			const bool unlit = (material.flags & Material::FlagUnlit) != 0;
+			f32* metallic = &m_gbuffer.metallic[row + x];
+			_mm_storeu_ps(metallic, Select(inside, _mm_set1_ps(material.metallicFactor), _mm_loadu_ps(metallic)));
+			f32* roughness = &m_gbuffer.roughness[row + x];
+			_mm_storeu_ps(roughness, Select(inside, _mm_set1_ps(unlit ? -1.0f : material.roughnessFactor), _mm_loadu_ps(roughness)));
+		}
+	}
+}
+
+void SoftwareRenderer::SampleTexture(const TextureAsset& texture, f32 u, f32 v, f32 outColor[4])
+{
+	const byte* data = texture.GetData();
+	const i32 width = texture.GetWidth();
+	const i32 height = texture.GetHeight();
+
+	if (data == nullptr || width <= 0 || height <= 0) {
+		outColor[0] = outColor[1] = outColor[2] = outColor[3] = 0.0f;
+		return;
+	}
+
+	// wrap first, then texel centers are at .5 so x is in [-0.5, width - 0.5)
+	f32 x = (u - std::floor(u)) * width - 0.5f;
+	f32 y = (v - std::floor(v)) * height - 0.5f;
+	if (!std::isfinite(x) || !std::isfinite(y)) {
+		x = 0.0f;
+		y = 0.0f;
+	}
+
+	const f32 floorX = std::floor(x);
+	const f32 floorY = std::floor(y);
+	const f32 fracX = x - floorX;
+	const f32 fracY = y - floorY;
+
+	const size_t x0 = floorX < 0.0f ? width - 1 : static_cast<size_t>(floorX);
+	const size_t y0 = floorY < 0.0f ? height - 1 : static_cast<size_t>(floorY);
+	const size_t x1 = x0 + 1 < static_cast<size_t>(width) ? x0 + 1 : 0;
+	const size_t y1 = y0 + 1 < static_cast<size_t>(height) ? y0 + 1 : 0;
+
+	// rgba8 unorm, 4 channels whatever the source had
+	const byte* t00 = &data[(y0 * width + x0) * 4];
+	const byte* t10 = &data[(y0 * width + x1) * 4];
+	const byte* t01 = &data[(y1 * width + x0) * 4];
+	const byte* t11 = &data[(y1 * width + x1) * 4];
+
+	for (u32 c = 0; c < 4; ++c) {
+		const f32 top = t00[c] + (t10[c] - t00[c]) * fracX;
+		const f32 bottom = t01[c] + (t11[c] - t01[c]) * fracX;
+		outColor[c] = (top + (bottom - top) * fracY) * (1.0f / 255.0f);
+	}
+}
+
+void SoftwareRenderer::ResolveTile(const RenderSnapshot& snapshot, const ResolveConstants& constants, u32 tileX, u32 tileY)
+{
+	using Clusters = ClusteredLighting;
+
+	const auto& lights = snapshot.lights.lights;
+	const auto& grid = snapshot.lights.grid;
+	const auto& lightIndices = snapshot.lights.indices;
+	const bool hasClusters = grid.size() == Clusters::ClusterCount * 2;
+
+	const __m128 ambient = _mm_set1_ps(0.1f);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+
+	const u32 endY = std::min((tileY + 1) * TileSize, m_height);
+	const u32 endX = std::min((tileX + 1) * TileSize, m_width);
+
+	for (u32 y = tileY * TileSize; y < endY; ++y) {
+		const size_t row = static_cast<size_t>(y) * m_stride;
+		const u32 clusterY = std::min(static_cast<u32>((y + 0.5f) * constants.tileScale.y), Clusters::GridSizeY - 1);
+
+		for (u32 x = tileX * TileSize; x < endX; x += 4) {
+			const size_t pixel = row + x;
+
+			__m128 albedo[4];
+			for (u32 c = 0; c < 4; ++c) {
+				albedo[c] = _mm_loadu_ps(&m_gbuffer.albedo[c][pixel]);
+			}
+			const __m128 px = _mm_loadu_ps(&m_gbuffer.wsPosition[0][pixel]);
+			const __m128 py = _mm_loadu_ps(&m_gbuffer.wsPosition[1][pixel]);
+			const __m128 pz = _mm_loadu_ps(&m_gbuffer.wsPosition[2][pixel]);
+			const __m128 nx = _mm_loadu_ps(&m_gbuffer.wsNormal[0][pixel]);
+			const __m128 ny = _mm_loadu_ps(&m_gbuffer.wsNormal[1][pixel]);
+			const __m128 nz = _mm_loadu_ps(&m_gbuffer.wsNormal[2][pixel]);
+
+			// the phong terms of the material of each pixel, unlit ones keep their albedo
+			alignas(16) f32 kdLanes[4];
+			alignas(16) f32 ksLanes[4];
+			alignas(16) f32 alpha[4];
+			u32 unlitLanes = 0;
+			for (u32 lane = 0; lane < 4; ++lane) {
+				const f32 roughness = m_gbuffer.roughness[pixel + lane];
+				unlitLanes |= roughness < 0.0f ? 1 << lane : 0;
+				PhongTerms(m_gbuffer.metallic[pixel + lane], roughness, kdLanes[lane], ksLanes[lane], alpha[lane]);
+			}
+			const __m128 kd = _mm_load_ps(kdLanes);
+			const __m128 ks = _mm_load_ps(ksLanes);
+
+			// the view direction doesnt depend on the light
+			__m128 vx = _mm_sub_ps(_mm_set1_ps(constants.wsCameraPosition.x), px);
+			__m128 vy = _mm_sub_ps(_mm_set1_ps(constants.wsCameraPosition.y), py);
+			__m128 vz = _mm_sub_ps(_mm_set1_ps(constants.wsCameraPosition.z), pz);
+			const __m128 viewLength = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)));
+			vx = _mm_div_ps(vx, viewLength);
+			vy = _mm_div_ps(vy, viewLength);
+			vz = _mm_div_ps(vz, viewLength);
+
+			__m128 brdf[3] = { ambient, ambient, ambient };
+
+			if (hasClusters) {
+				alignas(16) f32 viewZ[4];
+				_mm_store_ps(viewZ, _mm_add_ps(_mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(px, _mm_set1_ps(constants.viewZ.x)),
+					_mm_mul_ps(py, _mm_set1_ps(constants.viewZ.y))),
+					_mm_mul_ps(pz, _mm_set1_ps(constants.viewZ.z))),
+					_mm_set1_ps(constants.viewZ.w)));
+
+				// ClusterIndex in the shader
+				u32 clusters[4];
+				for (u32 lane = 0; lane < 4; ++lane) {
+					const u32 clusterX = std::min(static_cast<u32>((x + lane + 0.5f) * constants.tileScale.x), Clusters::GridSizeX - 1);
+					const i32 slice = static_cast<i32>(std::floor(std::log(std::max(viewZ[lane], 1e-4f)) * constants.sliceScale + constants.sliceBias));
+					const u32 clusterZ = static_cast<u32>(std::clamp(slice, 0, static_cast<i32>(Clusters::GridSizeZ) - 1));
+					clusters[lane] = (clusterZ * Clusters::GridSizeY + clusterY) * Clusters::GridSizeX + clusterX;
+				}
+
+				// neighbouring pixels are nearly always in the same cluster, each distinct one is lit with
+				// all 4 lanes and masked to the lanes in it
+				u32 lanesDone = 0;
+				for (u32 lane = 0; lane < 4; ++lane) {
+					if (lanesDone & (1 << lane)) {
+						continue;
+					}
+
+					const u32 cluster = clusters[lane];
+					u32 lanesInCluster = 0;
+					for (u32 other = lane; other < 4; ++other) {
+						if (clusters[other] == cluster) {
+							lanesInCluster |= 1 << other;
+						}
+					}
+					lanesDone |= lanesInCluster;
+					const __m128 clusterMask = LaneMask(lanesInCluster);
+
+					const u32 offset = grid[2 * cluster];
+					const u32 count = grid[2 * cluster + 1];
+					for (u32 i = 0; i < count; ++i) {
+						const PointLight& light = lights[lightIndices[offset + i]];
+
+						// PhongBRDF
+						const __m128 tx = _mm_sub_ps(_mm_set1_ps(light.position.x), px);
+						const __m128 ty = _mm_sub_ps(_mm_set1_ps(light.position.y), py);
+						const __m128 tz = _mm_sub_ps(_mm_set1_ps(light.position.z), pz);
+						const __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz)));
+						const __m128 invDistance = _mm_div_ps(one, _mm_max_ps(distance, _mm_set1_ps(1e-4f)));
+						const __m128 lx = _mm_mul_ps(tx, invDistance);
+						const __m128 ly = _mm_mul_ps(ty, invDistance);
+						const __m128 lz = _mm_mul_ps(tz, invDistance);
+
+						const __m128 nDotL = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, nx), _mm_mul_ps(ly, ny)), _mm_mul_ps(lz, nz));
+						const __m128 shading = _mm_max_ps(nDotL, zero);
+
+						// reflect(-l, n) = 2 * dot(n, l) * n - l
+						const __m128 twoNDotL = _mm_mul_ps(two, nDotL);
+						const __m128 rx = _mm_sub_ps(_mm_mul_ps(twoNDotL, nx), lx);
+						const __m128 ry = _mm_sub_ps(_mm_mul_ps(twoNDotL, ny), ly);
+						const __m128 rz = _mm_sub_ps(_mm_mul_ps(twoNDotL, nz), lz);
+
+						// pow(x, alpha), the exponent is per pixel so lane by lane like the texture fetches
+						alignas(16) f32 specularLanes[4];
+						_mm_store_ps(specularLanes, _mm_max_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, vx), _mm_mul_ps(ry, vy)), _mm_mul_ps(rz, vz)), zero));
+						for (u32 l = 0; l < 4; ++l) {
+							specularLanes[l] = std::pow(specularLanes[l], alpha[l]);
+						}
+						const __m128 specular = _mm_load_ps(specularLanes);
+
+						// Attenuation
+						const __m128 ratio = _mm_div_ps(distance, _mm_set1_ps(light.radius));
+						const __m128 ratio2 = _mm_mul_ps(ratio, ratio);
+						const __m128 window = _mm_min_ps(_mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(ratio2, ratio2)), zero), one);
+						const __m128 attenuation = _mm_mul_ps(
+							_mm_div_ps(_mm_mul_ps(window, window), _mm_add_ps(_mm_mul_ps(distance, distance), one)),
+							_mm_set1_ps(light.intensity));
+
+						const __m128 amount = _mm_and_ps(clusterMask,
+							_mm_mul_ps(attenuation, _mm_add_ps(_mm_mul_ps(kd, shading), _mm_mul_ps(ks, specular))));
+
+						brdf[0] = _mm_add_ps(brdf[0], _mm_mul_ps(amount, _mm_set1_ps(light.color.x)));
+						brdf[1] = _mm_add_ps(brdf[1], _mm_mul_ps(amount, _mm_set1_ps(light.color.y)));
+						brdf[2] = _mm_add_ps(brdf[2], _mm_mul_ps(amount, _mm_set1_ps(light.color.z)));
+					}
+				}
+			}
+
+			// albedo * float4(brdf, 1) into rgba8 unorm, saturated and rounded like the output merger
+			// (max with zero first also turns nans into 0)
+			const __m128 scale = _mm_set1_ps(255.0f);
+			const __m128 half = _mm_set1_ps(0.5f);
+			__m128i packed = _mm_setzero_si128();
+			for (u32 c = 0; c < 4; ++c) {
+				const __m128 lit = c < 3 ? _mm_mul_ps(albedo[c], brdf[c]) : albedo[c];
+				const __m128 color = Select(LaneMask(unlitLanes), albedo[c], lit);
+				const __m128 unorm = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(color, zero), one), scale), half);
+				packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_cvttps_epi32(unorm), 8 * c));
+			}
+
+			alignas(16) u32 out[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(out), packed);
+			const u32 laneCount = std::min(4u, endX - x);
+			std::copy_n(out, laneCount, &m_image.pixels[static_cast<size_t>(y) * m_width + x]);
+		}
+	}
+}
+
+bool SoftwareRenderer::WritePng(const Image& image, const std::string& realPath)
+{
+	const int res = stbi_write_png(realPath.c_str(), static_cast<int>(image.width), static_cast<int>(image.height), 4, image.pixels.data(), static_cast<int>(image.width * 4));
+	if (res == 0) {
+		spdlog::error("failed to write {}", realPath);
+		return false;
+	}
+	return true;
+}
+
+bool SoftwareRenderer::ReadPng(const std::string& realPath, Image& outImage)
+{
+	int width = 0;
+	int height = 0;
+	int numComponents = 0;
+	stbi_uc* data = stbi_load(realPath.c_str(), &width, &height, &numComponents, 4);
+	if (data == nullptr) {
+		spdlog::error("failed to read {}: {}", realPath, stbi_failure_reason());
+		return false;
+	}
+
+	outImage.width = static_cast<u32>(width);
+	outImage.height = static_cast<u32>(height);
+	outImage.pixels.resize(static_cast<size_t>(width) * height);
+	std::memcpy(outImage.pixels.data(), data, outImage.pixels.size() * sizeof(u32));
+
+	stbi_image_free(data);
+	return true;
+}
+
+SoftwareRenderer::ImageDiff SoftwareRenderer::Compare(const Image& expected, const Image& actual, u32 tolerance)
+{
+	ImageDiff diff;
+
+	if (expected.width != actual.width || expected.height != actual.height) {
+		diff.sizeMismatch = true;
+		diff.differentPixels = std::max(expected.width * expected.height, actual.width * actual.height);
+		return diff;
+	}
+
+	u64 squaredError = 0;
+	for (size_t i = 0; i < expected.pixels.size(); ++i) {
+		bool different = false;
+		for (u32 c = 0; c < 4; ++c) {
+			const i32 a = (expected.pixels[i] >> (8 * c)) & 0xff;
+			const i32 b = (actual.pixels[i] >> (8 * c)) & 0xff;
+			const u32 channelDiff = static_cast<u32>(std::abs(a - b));
+
+			diff.maxChannelDiff = std::max(diff.maxChannelDiff, channelDiff);
+			squaredError += channelDiff * channelDiff;
+			different |= channelDiff > tolerance;
+		}
+		diff.differentPixels += different ? 1 : 0;
+	}
+
+	const f64 meanSquaredError = static_cast<f64>(squaredError) / std::max<f64>(1.0, expected.pixels.size() * 4.0);
+	diff.psnr = meanSquaredError > 0.0
+		? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError)
+		: std::numeric_limits<f64>::infinity();
+
+	return diff;
+}
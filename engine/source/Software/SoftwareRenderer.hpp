@@ -0,0 +1,184 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "Math.hpp"
+#include "Material.hpp"
+#include "SceneSystem.hpp"
+#include "Core/MemoryTracker.hpp"
+
+class MeshAsset;
+class TextureAsset;
+
+// reference renderer on the cpu, draws a RenderSnapshot through the same deferred pipeline as DX11Context
+// (simple_deferred_* fills the gbuffer, final_deferred_pass_* resolves the clustered phong lighting)
+// from the same MeshAsset and TextureAsset data, no device needed to render
+//
+// meant for golden image tests and for timing the pipeline per commit, not for shipping frames:
+//	vertex	every mesh transformed in parallel, triangles clipped to the near plane and back faces culled
+//	bin		triangles split into fixed size batches, each batch bins its triangles into TileSize tiles
+//	raster	one job per tile fills its part of the gbuffer 4 pixels at a time, batches in order
+//	resolve	one job per tile lights its pixels 4 at a time
+//
+// the output is deterministic for a given snapshot, whatever the thread count, since every tile sees
+// its triangles in submission order
+class SoftwareRenderer {
+public:
+	static constexpr u32 TileSize = 64;
+	static constexpr u32 TrianglesPerBatch = 2048;
+	// vertices a job unpacks and transforms
+	static constexpr u32 VertexBatchSize = 1024;
+
+	template<typename T>
+	using Data = TrackedVector<T, MemoryTag::Renderer>;
+
+	// rgba8, same as the swapchain
+	struct Image {
+		u32 width = 0;
+		u32 height = 0;
+		// pixel = r | g << 8 | b << 16 | a << 24
+		Data<u32> pixels;
+	};
+
+	// in ms
+	struct Timings {
+		f32 vertex = 0.0f;
+		f32 bin = 0.0f;
+		f32 raster = 0.0f;
+		f32 resolve = 0.0f;
+		f32 total = 0.0f;
+
+		u32 trianglesIn = 0;
+		u32 trianglesDrawn = 0;
+	};
+
+	struct ImageDiff {
+		// pixels with any channel more than the tolerance off
+		u32 differentPixels = 0;
+		u32 maxChannelDiff = 0;
+		// over every channel, infinite for identical images
+		f64 psnr = 0.0;
+		bool sizeMismatch = false;
+	};
+
+	SoftwareRenderer(u32 width, u32 height);
+
+	// splits the work over the job system, call from the main thread or a job
+	void Render(const RenderSnapshot& snapshot);
+
+	inline const Image& GetImage() const { return m_image; }
+	inline const Timings& GetTimings() const { return m_timings; }
+
+	// real paths, not through the vfs, goldens dont live in the data dir
+	static bool WritePng(const Image& image, const std::string& realPath);
+	static bool ReadPng(const std::string& realPath, Image& outImage);
+
+	static ImageDiff Compare(const Image& expected, const Image& actual, u32 tolerance);
+
+private:
+	// simple_deferred_vs output
+	struct Vertex {
+		float4 csPosition;
+		float3 wsPosition;
+		float3 wsNormal;
+		float2 uv0;
+	};
+
+	// everything interpolated across a triangle, divided by w for perspective correct interpolation
+	static constexpr u32 AttributeCount = 8;
+
+	// edge functions are >= 0 inside, edge i runs from vertex i to vertex i + 1 and is 0 at vertex i + 2
+	struct TriangleSetup {
+		f32 edgeA[3];
+		f32 edgeB[3];
+		// a point on each edge, the functions are evaluated relative to it to keep the precision
+		f32 edgeX[3];
+		f32 edgeY[3];
+		// edges that own the pixels right on them, the top left rule like the gpu
+		bool topLeft[3];
+
+		f32 invArea;
+		f32 z[3];
+		f32 invW[3];
+		// ws position, ws normal, uv0
+		f32 attributes[AttributeCount][3];
+
+		const TextureAsset* texture;
+		const Material::Constants* material;
+
+		// pixel bounds, inclusive
+		i32 minX;
+		i32 minY;
+		i32 maxX;
+		i32 maxY;
+	};
+
+	struct Batch {
+		Data<TriangleSetup> triangles;
+		// per tile, indices into triangles
+		Data<Data<u32>> bins;
+		u32 trianglesDrawn = 0;
+	};
+
+	// a static mesh of the snapshot, triangles are numbered across all of them in order
+	struct Draw {
+		const MeshAsset* mesh;
+		const TextureAsset* texture;
+		const Material::Constants* material;
+		u32 firstVertex;
+		u32 firstTriangle;
+	};
+
+	// final_deferred_pass_ps constants
+	struct ResolveConstants {
+		// third column of worldToView, view z = dot(wsPosition, viewZ.xyz) + viewZ.w
+		float4 viewZ;
+		float3 wsCameraPosition;
+		float2 tileScale;
+		f32 sliceScale;
+		f32 sliceBias;
+	};
+
+	// structure of arrays so the raster and resolve loops load 4 pixels at once
+	struct GBuffer {
+		Data<f32> depth;
+		Data<f32> albedo[4];
+		Data<f32> wsPosition[3];
+		Data<f32> wsNormal[3];
+		// the w of the gpu position and normal targets, roughness is negative for unlit materials
+		Data<f32> metallic;
+		Data<f32> roughness;
+	};
+
+	// clip space is z = 0 at the near plane, the result is a fan of 0, 3 or 4 vertices
+	static u32 ClipNearPlane(const Vertex* triangle[3], Vertex outPolygon[4]);
+	// false if the triangle is back facing, degenerate or off screen
+	bool SetupTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, const TextureAsset* texture, const Material::Constants* material, TriangleSetup& out) const;
+
+	void ClearTile(u32 tileX, u32 tileY);
+	void RasterizeTriangle(const TriangleSetup& tri, u32 tileX, u32 tileY);
+	void ResolveTile(const RenderSnapshot& snapshot, const ResolveConstants& constants, u32 tileX, u32 tileY);
+
+	// bilinear with wrapping, like the samplers in DX11Texture
+	static void SampleTexture(const TextureAsset& texture, f32 u, f32 v, f32 outColor[4]);
+
+private:
+	u32 m_width = 0;
+	u32 m_height = 0;
+	u32 m_tilesX = 0;
+	u32 m_tilesY = 0;
+	// the gbuffer is padded out to whole tiles
+	u32 m_stride = 0;
+
+	GBuffer m_gbuffer;
+	Image m_image;
+
+	// reused every frame
+	Data<Draw> m_draws;
+	Data<Vertex> m_vertices;
+	Data<Batch> m_batches;
+	// the skinned or morphed mesh the vertex stage is on, deformed from the pose in the snapshot
+	MeshDeformer m_meshDeformer;
+	Data<Skinning::SkinnedVertex> m_deformedVertices;
+
+	Timings m_timings;
+};
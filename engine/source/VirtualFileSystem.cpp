@@ -0,0 +1,503 @@
+#include "VirtualFileSystem.hpp"
+#include "Core/Log.hpp"
+
+#include <fstream>
+#include <span>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <climits>
+#endif
+
+// loose paths are built in a buffer this long on the stack
+#ifdef _WIN32
+static constexpr size_t s_maxPathLength = MAX_PATH;
+#else
+static constexpr size_t s_maxPathLength = PATH_MAX;
+#endif
+
+#pragma region FileView
+
+FileView::~FileView()
+{
+	Release();
+}
+
+FileView::FileView(FileView&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+FileView& FileView::operator=(FileView&& other) noexcept
+{
+	if (this != &other) {
+		Release();
+
+		m_data = other.m_data;
+		m_size = other.m_size;
+		m_valid = other.m_valid;
+		m_file = other.m_file;
+		m_mapping = other.m_mapping;
+
+		other.m_data = nullptr;
+		other.m_size = 0;
+		other.m_valid = false;
+		other.m_file = nullptr;
+		other.m_mapping = nullptr;
+	}
+	return *this;
+}
+
+void FileView::Release()
+{
+#ifdef _WIN32
+	if (m_mapping != nullptr) {
+		UnmapViewOfFile(m_data);
+		CloseHandle(static_cast<HANDLE>(m_mapping));
+	}
+
+	if (m_file != nullptr) {
+		CloseHandle(static_cast<HANDLE>(m_file));
+	}
+#else
+	// the mapping outlives the descriptor, it is closed right after mmap
+	if (m_mapping != nullptr) {
+		munmap(m_mapping, m_size);
+	}
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+	m_valid = false;
+	m_file = nullptr;
+	m_mapping = nullptr;
+}
+
+#pragma endregion
+
+VirtualFileSystem::~VirtualFileSystem()
+{
+	UnmountPack();
+}
+
+void VirtualFileSystem::SetLooseRoot(std::string_view dir)
+{
+	m_looseRoot = dir;
+}
+
+FileView VirtualFileSystem::MapFile(const char* realPath)
+{
+	FileView view;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(realPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return view;
+	}
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		return view;
+	}
+
+	view.m_file = file;
+	view.m_size = static_cast<size_t>(fileSize.QuadPart);
+	view.m_valid = true;
+
+	// cant map an empty file, an empty view is still a valid file though
+	if (view.m_size == 0) {
+		return view;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		spdlog::error("CreateFileMapping failed for {} with {}", realPath, GetLastError());
+		view.Release();
+		return view;
+	}
+	view.m_mapping = mapping;
+
+	view.m_data = static_cast<const byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (view.m_data == nullptr) {
+		spdlog::error("MapViewOfFile failed for {} with {}", realPath, GetLastError());
+		view.Release();
+	}
+#else
+	const int file = open(realPath, O_RDONLY);
+	if (file < 0) {
+		return view;
+	}
+
+	// directories open fine here, CreateFileA refuses them
+	struct stat fileStat = {};
+	if (fstat(file, &fileStat) != 0 || !S_ISREG(fileStat.st_mode)) {
+		close(file);
+		return view;
+	}
+
+	view.m_size = static_cast<size_t>(fileStat.st_size);
+	view.m_valid = true;
+
+	// cant map an empty file, an empty view is still a valid file though
+	if (view.m_size == 0) {
+		close(file);
+		return view;
+	}
+
+	void* mapping = mmap(nullptr, view.m_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (mapping == MAP_FAILED) {
+		spdlog::error("mmap failed for {} with {}", realPath, errno);
+		view.Release();
+		return view;
+	}
+	view.m_mapping = mapping;
+	view.m_data = static_cast<const byte*>(mapping);
+#endif
+
+	return view;
+}
+
+// offset + size can wrap for a corrupt header, so the size is checked against what is left after the offset
+static bool InRange(u64 offset, u64 size, u64 total)
+{
+	return offset <= total && size <= total - offset;
+}
+
+bool VirtualFileSystem::MountPack(const std::string& realPath)
+{
+	UnmountPack();
+
+	FileView pack = MapFile(realPath.c_str());
+	if (!pack) {
+		spdlog::error("failed mapping asset pack {}", realPath);
+		return false;
+	}
+
+	AssetPack::Header header;
+	if (pack.Size() < sizeof(header)) {
+		spdlog::error("asset pack {} is truncated", realPath);
+		return false;
+	}
+	memcpy(&header, pack.Data(), sizeof(header));
+
+	if (header.magic != AssetPack::Magic || header.version != AssetPack::Version) {
+		spdlog::error("asset pack {} has version {}, expected {}", realPath, header.version, AssetPack::Version);
+		return false;
+	}
+
+	const u64 tocSize = sizeof(AssetPack::Entry) * static_cast<u64>(header.entryCount);
+	if (!InRange(header.tocOffset, tocSize, pack.Size())
+		|| !InRange(header.stringTableOffset, header.stringTableSize, pack.Size())
+		|| header.tocOffset % alignof(AssetPack::Entry) != 0
+		|| (header.stringTableSize > 0 && pack.Data()[header.stringTableOffset + header.stringTableSize - 1] != '\0')) {
+		spdlog::error("asset pack {} has a corrupt table of contents", realPath);
+		return false;
+	}
+
+	const AssetPack::Entry* entries = reinterpret_cast<const AssetPack::Entry*>(pack.Data() + header.tocOffset);
+	for (u32 i = 0; i < header.entryCount; ++i) {
+		const AssetPack::Entry& entry = entries[i];
+		if (!InRange(entry.offset, entry.storedSize, pack.Size())
+			|| entry.pathOffset >= header.stringTableSize
+			|| entry.compression != AssetPack::Compression::None
+			|| entry.storedSize != entry.size) {
+			spdlog::error("asset pack {} entry {} is corrupt or uses an unsupported compression", realPath, i);
+			return false;
+		}
+	}
+
+	m_pack = std::move(pack);
+	m_packEntries = entries;
+	m_packEntryCount = header.entryCount;
+	m_packStrings = reinterpret_cast<const char*>(m_pack.Data() + header.stringTableOffset);
+	m_packStringsSize = header.stringTableSize;
+
+	spdlog::info("mounted asset pack {} with {} files ({} bytes)", realPath, m_packEntryCount, m_pack.Size());
+	return true;
+}
+
+void VirtualFileSystem::UnmountPack()
+{
+	m_pack = FileView();
+	m_packEntries = nullptr;
+	m_packEntryCount = 0;
+	m_packStrings = nullptr;
+	m_packStringsSize = 0;
+}
+
+const AssetPack::Entry* VirtualFileSystem::FindPackEntry(std::string_view virtualPath) const
+{
+	if (!m_pack) {
+		return nullptr;
+	}
+
+	const AssetPack::Entry* entry = AssetPack::FindEntry(m_packEntries, m_packEntryCount, HashPath(virtualPath));
+
+	// guard against hash collisions with a path not in the pack
+	if (entry != nullptr && std::string_view(m_packStrings + entry->pathOffset) != virtualPath) {
+		return nullptr;
+	}
+
+	return entry;
+}
+
+bool VirtualFileSystem::BuildLoosePath(std::string_view virtualPath, char* outPath, size_t outSize) const
+{
+	const int written = snprintf(outPath, outSize, "%.*s/%.*s",
+		static_cast<int>(m_looseRoot.size()), m_looseRoot.data(),
+		static_cast<int>(virtualPath.size()), virtualPath.data());
+
+	return written > 0 && static_cast<size_t>(written) < outSize;
+}
+
+FileView VirtualFileSystem::Open(std::string_view virtualPath) const
+{
+	if (const AssetPack::Entry* entry = FindPackEntry(virtualPath)) {
+		FileView view;
+		view.m_data = m_pack.Data() + entry->offset;
+		view.m_size = static_cast<size_t>(entry->size);
+		view.m_valid = true;
+		return view;
+	}
+
+	char realPath[s_maxPathLength];
+	if (!BuildLoosePath(virtualPath, realPath, sizeof(realPath))) {
+		LOG_ERROR("path too long {}", virtualPath);
+		return FileView();
+	}
+
+	FileView view = MapFile(realPath);
+	if (!view) {
+		LOG_ERROR("failed opening {}", realPath);
+	}
+	return view;
+}
+
+bool VirtualFileSystem::Exists(std::string_view virtualPath) const
+{
+	if (FindPackEntry(virtualPath) != nullptr) {
+		return true;
+	}
+
+	char realPath[s_maxPathLength];
+	if (!BuildLoosePath(virtualPath, realPath, sizeof(realPath))) {
+		return false;
+	}
+
+#ifdef _WIN32
+	const DWORD attributes = GetFileAttributesA(realPath);
+	return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	struct stat fileStat = {};
+	return stat(realPath, &fileStat) == 0 && S_ISREG(fileStat.st_mode);
+#endif
+}
+
+// drops the file from the os page cache so the next open has to read it from disk, returns the fraction of its
+// pages still cached after, 1 on windows which has no per file eviction, and on tmpfs where the cache is the file
+static f64 EvictFromPageCache(const std::string& realPath)
+{
+#ifdef _WIN32
+	(void)realPath;
+	return 1.0;
+#else
+	const int file = open(realPath.c_str(), O_RDONLY);
+	if (file < 0) {
+		return 1.0;
+	}
+
+	struct stat fileStat = {};
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0) {
+		close(file);
+		return fileStat.st_size == 0 ? 0.0 : 1.0;
+	}
+
+	// only clean pages can be dropped and the benchmark just wrote these
+	fdatasync(file);
+	posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+
+	// mapping doesnt fault anything in, mincore only reports what is there
+	f64 resident = 1.0;
+	const size_t size = static_cast<size_t>(fileStat.st_size);
+	void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (mapping != MAP_FAILED) {
+		const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		std::vector<unsigned char> pages((size + pageSize - 1) / pageSize);
+		if (mincore(mapping, size, pages.data()) == 0) {
+			const size_t cached = std::count_if(pages.begin(), pages.end(), [](unsigned char page) { return (page & 1) != 0; });
+			resident = static_cast<f64>(cached) / pages.size();
+		}
+		munmap(mapping, size);
+	}
+	close(file);
+	return resident;
+#endif
+}
+
+struct OpenTimes {
+	f64 coldMs = 0.0;
+	f64 warmMs = 0.0;
+	bool contents = true;
+};
+
+// the timed passes read a byte of every page so the mapping actually faults in, hashing every byte would
+// drown the open in the hash, the contents are checked after in a pass of their own
+static OpenTimes TimeOpens(const VirtualFileSystem& vfs, std::span<const std::string> paths, std::span<const u64> hashes)
+{
+	constexpr size_t pageSize = 4096;
+
+	OpenTimes times;
+	u64 touched = 0;
+	for (u32 pass = 0; pass < 2; ++pass) {
+		spdlog::stopwatch sw;
+		for (const std::string& path : paths) {
+			FileView view = vfs.Open(path);
+			for (size_t b = 0; b < view.Size(); b += pageSize) {
+				touched += view.Data()[b];
+			}
+		}
+		(pass == 0 ? times.coldMs : times.warmMs) = sw.elapsed().count() * 1000.0;
+	}
+
+	u64 expected = 0;
+	for (size_t i = 0; i < paths.size(); ++i) {
+		FileView view = vfs.Open(paths[i]);
+		times.contents &= view && Hash64(view.Data(), view.Size()) == hashes[i];
+		for (size_t b = 0; view && b < view.Size(); b += pageSize) {
+			expected += view.Data()[b];
+		}
+	}
+	times.contents &= touched == expected * 2;
+
+	return times;
+}
+
+bool VirtualFileSystem::RunBenchmark()
+{
+	constexpr u32 fileCount = 2000;
+	constexpr u32 writerFileCount = 100000;
+
+	const std::filesystem::path root = std::filesystem::temp_directory_path() / "vfs_benchmark";
+	std::error_code error;
+	std::filesystem::remove_all(root, error);
+	std::filesystem::create_directories(root / "files", error);
+	if (error) {
+		spdlog::error("failed creating {}: {}", root.string(), error.message());
+		return false;
+	}
+
+	spdlog::info("virtual file system benchmark, {} files in {}", fileCount, root.string());
+
+	// a few hundred bytes to 64kb each, about what the data dir has besides the meshes
+	std::vector<std::string> paths(fileCount);
+	std::vector<u64> hashes(fileCount);
+	AssetPack::Writer writer;
+	u64 totalSize = 0;
+	bool passed = true;
+	for (u32 i = 0; i < fileCount; ++i) {
+		paths[i] = fmt::format("files/file_{}.bin", i);
+
+		const u64 seed = Hash64(&i, sizeof(i));
+		std::vector<byte> data(256 + seed % (64 * 1024));
+		for (size_t b = 0; b < data.size(); ++b) {
+			data[b] = static_cast<byte>(Hash64(&b, sizeof(b), seed));
+		}
+		hashes[i] = Hash64(data.data(), data.size());
+		totalSize += data.size();
+
+		std::ofstream loose(root / paths[i], std::ios::binary | std::ios::trunc);
+		loose.write(reinterpret_cast<const char*>(data.data()), data.size());
+		passed &= loose.good();
+		passed &= writer.AddFile(paths[i], data.data(), data.size());
+	}
+
+	const std::string packPath = (root / AssetPack::FileName).string();
+	passed &= writer.Write(packPath);
+
+	// offsets that only look in range once offset + size wraps around
+	{
+		std::vector<byte> pack(sizeof(AssetPack::Header) + 64);
+		AssetPack::Header header = {
+			.entryCount = 1,
+			.tocOffset = ~0ull - sizeof(AssetPack::Entry) + 1 + 8,
+		};
+		memcpy(pack.data(), &header, sizeof(header));
+
+		const std::string corruptPath = (root / "corrupt.pak").string();
+		std::ofstream corrupt(corruptPath, std::ios::binary | std::ios::trunc);
+		corrupt.write(reinterpret_cast<const char*>(pack.data()), pack.size());
+		corrupt.close();
+
+		spdlog::info("the next error is on purpose");
+		VirtualFileSystem vfs;
+		const bool rejected = !vfs.MountPack(corruptPath);
+		passed &= rejected;
+		spdlog::info("wrapping table of contents rejected {}", rejected ? "matches" : "MISMATCH");
+	}
+
+	// the duplicate check used to rescan every file added before, quadratic in the size of the pack
+	{
+		AssetPack::Writer bigWriter;
+		const byte data = 0;
+		bool added = true;
+		spdlog::stopwatch sw;
+		for (u32 i = 0; i < writerFileCount; ++i) {
+			added &= bigWriter.AddFile(fmt::format("files/file_{}.bin", i), &data, sizeof(data));
+		}
+		const f64 addMs = sw.elapsed().count() * 1000.0;
+
+		spdlog::info("the next error is on purpose");
+		const bool duplicate = !bigWriter.AddFile("files/file_0.bin", &data, sizeof(data));
+		passed &= added && duplicate;
+
+		spdlog::info("pack writer added {} files in {:.2f}ms, duplicate rejected {}", writerFileCount, addMs, duplicate ? "matches" : "MISMATCH");
+	}
+
+	// the files are evicted from the page cache before each cold pass so it reads from disk, where the os wont
+	// let go of them cold is only the first open in this process and the log says so
+	auto describeCold = [](f64 resident) {
+		return resident < 0.5 ? fmt::format("page cache evicted, {:.0f}% still cached", resident * 100.0)
+			: fmt::format("{:.0f}% still in the page cache, cold is the first open in this process", resident * 100.0);
+	};
+
+	const f64 packResident = EvictFromPageCache(packPath);
+	VirtualFileSystem packed;
+	packed.SetLooseRoot((root / "missing").string());
+	spdlog::stopwatch mountTime;
+	passed &= packed.MountPack(packPath);
+	const f64 mountMs = mountTime.elapsed().count() * 1000.0;
+	const OpenTimes packTimes = TimeOpens(packed, paths, hashes);
+
+	f64 looseResident = 0.0;
+	for (const std::string& path : paths) {
+		looseResident += EvictFromPageCache((root / path).string()) / fileCount;
+	}
+	VirtualFileSystem loose;
+	loose.SetLooseRoot(root.string());
+	const OpenTimes looseTimes = TimeOpens(loose, paths, hashes);
+
+	passed &= packTimes.contents && looseTimes.contents;
+
+	spdlog::info("{} files, {:.2f} mb", fileCount, totalSize / (1024.0 * 1024.0));
+	spdlog::info("pack:  mount {:.2f}ms, cold {:.2f}ms ({:.2f} us per file, {}), warm {:.2f}ms ({:.2f} us per file), contents {}",
+		mountMs, packTimes.coldMs, packTimes.coldMs * 1000.0 / fileCount, describeCold(packResident), packTimes.warmMs, packTimes.warmMs * 1000.0 / fileCount,
+		packTimes.contents ? "matches" : "MISMATCH");
+	spdlog::info("loose: cold {:.2f}ms ({:.2f} us per file, {}), warm {:.2f}ms ({:.2f} us per file), contents {}",
+		looseTimes.coldMs, looseTimes.coldMs * 1000.0 / fileCount, describeCold(looseResident), looseTimes.warmMs, looseTimes.warmMs * 1000.0 / fileCount,
+		looseTimes.contents ? "matches" : "MISMATCH");
+
+	packed.UnmountPack();
+	std::filesystem::remove_all(root, error);
+
+	spdlog::info("virtual file system checks {}", passed ? "passed" : "FAILED");
+	return passed;
+}
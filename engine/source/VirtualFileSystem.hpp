@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "AssetPack.hpp"
+
+#include <string_view>
+
+// read only view of a file, either a slice of the mapped pack or a mapping of a loose file
+// move only, unmaps loose files when it goes out of scope
+class FileView {
+public:
+	FileView() = default;
+	~FileView();
+
+	FileView(const FileView&) = delete;
+	FileView& operator=(const FileView&) = delete;
+
+	FileView(FileView&& other) noexcept;
+	FileView& operator=(FileView&& other) noexcept;
+
+	inline const byte* Data() const { return m_data; }
+	inline size_t Size() const { return m_size; }
+	inline bool IsValid() const { return m_valid; }
+	inline explicit operator bool() const { return m_valid; }
+
+	inline std::string_view AsString() const { return std::string_view(reinterpret_cast<const char*>(m_data), m_size); }
+
+private:
+	void Release();
+
+	const byte* m_data = nullptr;
+	size_t m_size = 0;
+	bool m_valid = false;
+
+	// os handles, only set when the view owns a mapping of its own (loose files)
+	// posix only needs the mapped address in m_mapping
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+
+	friend class VirtualFileSystem;
+};
+
+// serves files by virtual path (relative to the data dir)
+// looks in the mounted pack first, then falls back to loose files on disk so development
+// builds dont need to repack after every change
+// Open does not allocate, the pack is mapped once and loose file paths are built on the stack
+class VirtualFileSystem {
+public:
+	VirtualFileSystem() = default;
+	~VirtualFileSystem();
+
+	VirtualFileSystem(const VirtualFileSystem&) = delete;
+	VirtualFileSystem& operator=(const VirtualFileSystem&) = delete;
+
+	void SetLooseRoot(std::string_view dir);
+
+	// maps the whole pack file, only one pack is mounted at a time
+	bool MountPack(const std::string& realPath);
+	void UnmountPack();
+	inline bool HasPack() const { return m_pack.IsValid(); }
+
+	FileView Open(std::string_view virtualPath) const;
+	bool Exists(std::string_view virtualPath) const;
+
+	// writes a set of generated files loose and as a pack to a temp dir, then times mounting and opening every
+	// file the first time after evicting them from the page cache (cold, read from disk) and again (warm),
+	// checking the contents
+	static bool RunBenchmark();
+
+private:
+	const AssetPack::Entry* FindPackEntry(std::string_view virtualPath) const;
+	bool BuildLoosePath(std::string_view virtualPath, char* outPath, size_t outSize) const;
+
+	static FileView MapFile(const char* realPath);
+
+private:
+	std::string m_looseRoot = "data";
+
+	FileView m_pack;
+	const AssetPack::Entry* m_packEntries = nullptr;
+	u32 m_packEntryCount = 0;
+	const char* m_packStrings = nullptr;
+	u64 m_packStringsSize = 0;
+};
@@ -0,0 +1,400 @@
+#include "Basic.hpp"
+#include "Core/Hash.hpp"
+#include "AssetManifest.hpp"
+#include "AssetPack.hpp"
+
+#include <flags.h>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <unordered_set>
+
+// incremental asset build, cooks the assets listed in the catalog from the source data dir into an output data dir
+// usage: assetbuild --source <dir> --out <dir> [--jobs <n>] [--pack] [--force]
+//
+// every output remembers a hash of the content of all the inputs it was cooked from (the asset itself,
+// its dep= entries in the catalog and for shaders everything they #include, and all of that for the
+// dependencies too), only outputs whose hash changed or that are missing get cooked again, and they get
+// cooked in parallel
+//
+// files of the source dir that arent in the catalog are copied as they are, the engine loads some by path
+// (like the fallback textures) and shaders are compiled at runtime so their includes have to ship
+//
+// @TODO: cooking is a copy for everything except the catalog right now, this is where a real mesh/texture
+// format and offline shader compilation plug in
+
+// bump when cooking changes so everything rebuilds
+constexpr u64 CookVersion = 1;
+
+constexpr std::string_view BuildStateFileName = ".assetbuild";
+// written first and renamed over the state, so a build that dies halfway keeps the previous one
+constexpr std::string_view BuildStateTempFileName = ".assetbuild.tmp";
+constexpr std::string_view CatalogSourceName = "catalog.txt";
+constexpr std::string_view CatalogCookedName = "catalog.bin";
+
+enum class CookKind {
+	Copy,
+	Catalog,
+};
+
+struct BuildItem {
+	CookKind kind = CookKind::Copy;
+
+	// virtual paths, relative to the source and output dirs
+	std::string output;
+	std::vector<std::string> inputs;
+
+	u64 hash = 0;
+	bool stale = true;
+	bool failed = false;
+};
+
+static bool ReadFile(const std::filesystem::path& path, std::vector<byte>& outContents)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		return false;
+	}
+
+	outContents.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(outContents.data()), outContents.size());
+	return file.good();
+}
+
+static bool WriteFile(const std::filesystem::path& path, const byte* data, size_t size)
+{
+	std::filesystem::create_directories(path.parent_path());
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(data), size);
+	return file.good();
+}
+
+// runs func(i) for i in [0, count) across jobCount threads
+template<typename Func>
+static void ParallelFor(size_t count, u32 jobCount, Func&& func)
+{
+	std::atomic<size_t> next = 0;
+	auto worker = [&]() {
+		for (size_t i = next++; i < count; i = next++) {
+			func(i);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	const u32 threadCount = static_cast<u32>(std::min<size_t>(jobCount, count));
+	for (u32 t = 1; t < threadCount; ++t) {
+		threads.emplace_back(worker);
+	}
+
+	worker();
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+// collects everything a shader #includes, recursively, includes are relative to the including file
+static void ScanShaderIncludes(const std::filesystem::path& sourceDir, const std::string& shaderPath,
+	std::vector<std::string>& outIncludes, std::unordered_set<std::string>& visited)
+{
+	std::vector<byte> contents;
+	if (!ReadFile(sourceDir / shaderPath, contents)) {
+		return;
+	}
+
+	std::string_view text(reinterpret_cast<const char*>(contents.data()), contents.size());
+	const std::filesystem::path shaderDir = std::filesystem::path(shaderPath).parent_path();
+
+	while (!text.empty()) {
+		const size_t newline = text.find('\n');
+		std::string_view line = text.substr(0, newline);
+		text = newline == std::string_view::npos ? std::string_view{} : text.substr(newline + 1);
+
+		const size_t hash = line.find_first_not_of(" \t");
+		if (hash == std::string_view::npos || !line.substr(hash).starts_with("#include")) {
+			continue;
+		}
+
+		const size_t open = line.find_first_of("\"<");
+		const size_t close = line.find_last_of("\">");
+		if (open == std::string_view::npos || close == std::string_view::npos || close <= open) {
+			continue;
+		}
+
+		const std::string include = (shaderDir / line.substr(open + 1, close - open - 1)).lexically_normal().generic_string();
+		if (visited.insert(include).second) {
+			outIncludes.push_back(include);
+			ScanShaderIncludes(sourceDir, include, outIncludes, visited);
+		}
+	}
+}
+
+// path of the asset, its dependencies and everything they #include, and the same for each of those,
+// appended to outInputs in the order they are found, every path once
+static void CollectInputs(const std::filesystem::path& sourceDir, const AssetManifest& manifest,
+	const std::unordered_map<std::string, u32>& entries, const std::string& path,
+	std::vector<std::string>& outInputs, std::unordered_set<std::string>& visited)
+{
+	if (!visited.insert(path).second) {
+		return;
+	}
+	outInputs.push_back(path);
+
+	auto it = entries.find(path);
+	if (it == entries.end()) {
+		return;
+	}
+
+	const AssetManifest::Entry& entry = manifest.GetEntry(it->second);
+	if (entry.type == AssetType::Shader) {
+		// includes are leaves, they arent in the catalog
+		ScanShaderIncludes(sourceDir, path, outInputs, visited);
+	}
+
+	for (const AssetManifest::Dependency& dependency : manifest.GetDependencies(entry)) {
+		CollectInputs(sourceDir, manifest, entries, std::string(manifest.GetString(dependency.pathOffset)), outInputs, visited);
+	}
+}
+
+static std::unordered_map<std::string, u64> ReadBuildState(const std::filesystem::path& path)
+{
+	std::unordered_map<std::string, u64> state;
+
+	std::ifstream file(path);
+	std::string hashStr;
+	std::string output;
+	while (file >> hashStr >> output) {
+		state[output] = std::strtoull(hashStr.c_str(), nullptr, 16);
+	}
+
+	return state;
+}
+
+static bool WriteBuildState(const std::filesystem::path& path, const std::filesystem::path& tempPath, const std::vector<BuildItem>& items)
+{
+	{
+		std::ofstream file(tempPath, std::ios::trunc);
+		for (const BuildItem& item : items) {
+			// failed items are left out so they retry next time
+			if (!item.failed) {
+				file << fmt::format("{:016x} {}\n", item.hash, item.output);
+			}
+		}
+
+		file.flush();
+		if (!file) {
+			return false;
+		}
+	}
+
+	// replaces the old state in one step
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	return !error;
+}
+
+static bool Cook(const BuildItem& item, const std::filesystem::path& sourceDir, const std::filesystem::path& outDir)
+{
+	std::vector<byte> contents;
+	if (!ReadFile(sourceDir / item.inputs[0], contents)) {
+		spdlog::error("failed reading {}", item.inputs[0]);
+		return false;
+	}
+
+	switch (item.kind) {
+	case CookKind::Copy: {
+		return WriteFile(outDir / item.output, contents.data(), contents.size());
+	}
+	case CookKind::Catalog: {
+		AssetManifest manifest;
+		if (!manifest.Load(contents.data(), contents.size())) {
+			spdlog::error("failed parsing {}", item.inputs[0]);
+			return false;
+		}
+		std::vector<byte> binary = manifest.SerializeBinary();
+		return WriteFile(outDir / item.output, binary.data(), binary.size());
+	}
+	}
+
+	UNREACHABLE("");
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+	spdlog::set_pattern("[%H:%M:%S.%e] [%^%L%$] %v");
+
+	const flags::args args(argc, argv);
+
+	const std::filesystem::path sourceDir = args.get<std::string>("source", "data");
+	const std::filesystem::path outDir = args.get<std::string>("out", "cooked");
+	const u32 jobCount = std::max(1u, args.get<u32>("jobs", u32{ std::thread::hardware_concurrency() }));
+	const bool writePack = args.get<bool>("pack", false);
+	const bool force = args.get<bool>("force", false);
+
+	spdlog::stopwatch sw;
+
+	std::vector<byte> catalogContents;
+	AssetManifest manifest;
+	if (!ReadFile(sourceDir / CatalogSourceName, catalogContents) || !manifest.Load(catalogContents.data(), catalogContents.size())) {
+		spdlog::critical("failed loading {}", (sourceDir / CatalogSourceName).generic_string());
+		return -1;
+	}
+
+	// work out what gets built from what
+	std::vector<BuildItem> items;
+	std::unordered_set<std::string> outputs;
+
+	items.push_back(BuildItem{
+		.kind = CookKind::Catalog,
+		.output = std::string(CatalogCookedName),
+		.inputs = { std::string(CatalogSourceName) },
+	});
+
+	std::unordered_map<std::string, u32> entries;
+	for (u32 i = 0; i < manifest.GetEntryCount(); ++i) {
+		entries.emplace(manifest.GetPath(manifest.GetEntry(i)), i);
+	}
+
+	for (u32 i = 0; i < manifest.GetEntryCount(); ++i) {
+		const std::string path(manifest.GetPath(manifest.GetEntry(i)));
+
+		BuildItem item = {
+			.kind = CookKind::Copy,
+			.output = path,
+		};
+
+		std::unordered_set<std::string> visited;
+		CollectInputs(sourceDir, manifest, entries, path, item.inputs, visited);
+
+		if (outputs.insert(item.output).second) {
+			items.push_back(std::move(item));
+		}
+	}
+
+	// everything else in the source dir goes along as it is
+	std::error_code error;
+	for (auto it = std::filesystem::recursive_directory_iterator(sourceDir, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+		if (!it->is_regular_file()) {
+			continue;
+		}
+
+		const std::string path = it->path().lexically_relative(sourceDir).generic_string();
+		// the catalog source is cooked into catalog.bin, dot files are build state and the like
+		if (path == CatalogSourceName || it->path().filename().generic_string().starts_with('.')) {
+			continue;
+		}
+
+		if (outputs.insert(path).second) {
+			items.push_back(BuildItem{
+				.kind = CookKind::Copy,
+				.output = path,
+				.inputs = { path },
+			});
+		}
+	}
+
+	if (error) {
+		spdlog::critical("failed listing {}: {}", sourceDir.generic_string(), error.message());
+		return -1;
+	}
+
+	// hash every distinct input once, in parallel
+	std::vector<std::string> uniqueInputs;
+	std::unordered_map<std::string, u64> inputHashes;
+	for (const BuildItem& item : items) {
+		for (const std::string& input : item.inputs) {
+			if (inputHashes.emplace(input, 0).second) {
+				uniqueInputs.push_back(input);
+			}
+		}
+	}
+
+	std::vector<u64> uniqueHashes(uniqueInputs.size());
+	ParallelFor(uniqueInputs.size(), jobCount, [&](size_t i) {
+		std::vector<byte> contents;
+		// missing inputs (like a not yet written include) still hash, so the item rebuilds once they show up
+		uniqueHashes[i] = ReadFile(sourceDir / uniqueInputs[i], contents)
+			? Hash64(contents.data(), contents.size())
+			: HashPath("<missing>");
+	});
+
+	for (size_t i = 0; i < uniqueInputs.size(); ++i) {
+		inputHashes[uniqueInputs[i]] = uniqueHashes[i];
+	}
+
+	// decide what is stale
+	const std::filesystem::path buildStatePath = outDir / BuildStateFileName;
+	const auto previousState = ReadBuildState(buildStatePath);
+
+	std::vector<size_t> staleItems;
+	for (size_t i = 0; i < items.size(); ++i) {
+		BuildItem& item = items[i];
+
+		u64 hash = Hash64(&CookVersion, sizeof(CookVersion));
+		hash = Hash64(&item.kind, sizeof(item.kind), hash);
+		for (const std::string& input : item.inputs) {
+			hash = Hash64(input, hash);
+			hash = Hash64(&inputHashes[input], sizeof(u64), hash);
+		}
+		item.hash = hash;
+
+		auto it = previousState.find(item.output);
+		item.stale = force
+			|| it == previousState.end()
+			|| it->second != item.hash
+			|| !std::filesystem::exists(outDir / item.output);
+
+		if (item.stale) {
+			staleItems.push_back(i);
+		}
+	}
+
+	// cook
+	std::atomic<u32> failedCount = 0;
+	ParallelFor(staleItems.size(), jobCount, [&](size_t i) {
+		BuildItem& item = items[staleItems[i]];
+		if (Cook(item, sourceDir, outDir)) {
+			spdlog::info("cooked {}", item.output);
+		} else {
+			spdlog::error("failed cooking {}", item.output);
+			item.failed = true;
+			failedCount++;
+		}
+	});
+
+	bool stateFailed = false;
+	if (!WriteBuildState(buildStatePath, outDir / BuildStateTempFileName, items)) {
+		spdlog::error("failed writing {}", buildStatePath.generic_string());
+		stateFailed = true;
+	}
+
+	// the pack is just the cooked outputs bundled up, only rewrite it when something changed
+	bool packFailed = false;
+	const std::filesystem::path packPath = outDir / AssetPack::FileName;
+	if (writePack && (!staleItems.empty() || !std::filesystem::exists(packPath))) {
+		AssetPack::Writer writer;
+		std::vector<byte> contents;
+		for (const BuildItem& item : items) {
+			if (!item.failed && ReadFile(outDir / item.output, contents)) {
+				writer.AddFile(item.output, contents.data(), contents.size());
+			}
+		}
+
+		if (!writer.Write(packPath.generic_string())) {
+			spdlog::error("failed writing {}", packPath.generic_string());
+			packFailed = true;
+		}
+	}
+
+	spdlog::info("asset build: {} outputs, {} cooked, {} up to date, {} failed, {} jobs, {:.3}s",
+		items.size(), staleItems.size() - failedCount, items.size() - staleItems.size(), failedCount.load(), jobCount, sw);
+
+	return (failedCount > 0 || packFailed || stateFailed) ? -1 : 0;
+}
@@ -0,0 +1,89 @@
+#include "Basic.hpp"
+#include "AssetPack.hpp"
+
+#include <flags.h>
+#include <fstream>
+
+// packs every file in the data dir into a single AssetPack file
+// usage: assetpacker --data_dir <dir> [--out <file>] [--alignment <bytes>]
+// --out defaults to <data_dir>/assets.pak, which the engine mounts on startup when it exists
+
+static bool ReadFile(const std::filesystem::path& path, std::vector<byte>& outContents)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		return false;
+	}
+
+	outContents.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(outContents.data()), outContents.size());
+	return file.good();
+}
+
+int main(int argc, char** argv)
+{
+	spdlog::set_pattern("[%H:%M:%S.%e] [%^%L%$] %v");
+
+	const flags::args args(argc, argv);
+
+	const std::filesystem::path dataDir = args.get<std::string>("data_dir", "data");
+	const std::filesystem::path outPath = args.get<std::string>("out", (dataDir / AssetPack::FileName).generic_string());
+	const u32 alignment = args.get<u32>("alignment", u32{ AssetPack::DefaultAlignment });
+
+	if (!std::filesystem::is_directory(dataDir)) {
+		spdlog::critical("data dir {} does not exist", dataDir.generic_string());
+		return -1;
+	}
+
+	if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+		spdlog::critical("alignment {} is not a power of two", alignment);
+		return -1;
+	}
+
+	spdlog::stopwatch sw;
+
+	AssetPack::Writer writer(alignment);
+	std::vector<byte> contents;
+	size_t totalBytes = 0;
+
+	// sorted so the pack is the same byte for byte no matter what order the os lists files in
+	std::vector<std::filesystem::path> files;
+	for (const auto& item : std::filesystem::recursive_directory_iterator(dataDir)) {
+		if (!item.is_regular_file()) {
+			continue;
+		}
+
+		// dont pack old packs, including the one we are about to overwrite
+		if (item.path().extension() == std::filesystem::path(AssetPack::FileName).extension()) {
+			continue;
+		}
+
+		files.push_back(item.path());
+	}
+	std::sort(files.begin(), files.end());
+
+	for (const auto& path : files) {
+		const std::string virtualPath = std::filesystem::relative(path, dataDir).generic_string();
+
+		if (!ReadFile(path, contents)) {
+			spdlog::error("failed reading {}", path.generic_string());
+			return -1;
+		}
+
+		if (!writer.AddFile(virtualPath, contents.data(), contents.size())) {
+			return -1;
+		}
+
+		spdlog::info("packed {} ({} bytes)", virtualPath, contents.size());
+		totalBytes += contents.size();
+	}
+
+	if (!writer.Write(outPath.generic_string())) {
+		spdlog::critical("failed writing {}", outPath.generic_string());
+		return -1;
+	}
+
+	spdlog::info("wrote {} with {} files, {} bytes of data in {:.3}s", outPath.generic_string(), writer.GetFileCount(), totalBytes, sw);
+	return 0;
+}
@@ -0,0 +1,31 @@
+#include "EngineTool.hpp"
+#include "Benchmarks.hpp"
+
+// runs the benchmarks of the engine without the window or the device, the same ones as --bench_<name> on the engine
+// usage: enginebench [--data_dir <dir>] [--workers 0] [--bench_<name> ...]
+// runs every benchmark when none is given, exits with 1 if any of them failed, the tests in engine/tests run it
+
+int main(int argc, char** argv)
+{
+	const flags::args args(argc, argv);
+
+	EngineTool::InitSystems(args);
+
+	std::vector<const Benchmarks::Entry*> benchmarks;
+	for (const Benchmarks::Entry& benchmark : Benchmarks::GetEntries()) {
+		if (args.get<bool>(fmt::format("bench_{}", benchmark.name), false)) {
+			benchmarks.push_back(&benchmark);
+		}
+	}
+	if (benchmarks.empty()) {
+		for (const Benchmarks::Entry& benchmark : Benchmarks::GetEntries()) {
+			benchmarks.push_back(&benchmark);
+		}
+	}
+
+	const bool passed = Benchmarks::Run(benchmarks);
+
+	EngineTool::ShutdownSystems();
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Basic.hpp"
+#include "AssetSystem.hpp"
+#include "SceneSystem.hpp"
+#include "Core/JobSystem.hpp"
+#include "Core/Log.hpp"
+#include "Core/MemoryTracker.hpp"
+#include "Core/Profiler.hpp"
+
+#include <flags.h>
+
+// the global systems of the engine without the window and the renderer, for the tools that run engine code
+// headless, assets only load their cpu side since no renderer is set
+//
+// --data_dir <dir> and --workers <n> like the engine
+namespace EngineTool
+{
+	inline void InitSystems(const flags::args& args)
+	{
+		spdlog::set_pattern("[%H:%M:%S.%e] [%^%L%$] [thread %t] %v");
+
+		Log::Init(!args.get<bool>("log_sync", false));
+
+		Profiler::Init();
+		Profiler::SetThreadName("main");
+
+		MemoryTracker::Init();
+
+		global::jobSystem = new JobSystem(args.get<u32>("workers", 0u));
+		global::assetSystem = new AssetSystem();
+		global::assetSystem->SetDataDir(args.get<std::string_view>("data_dir", "data"));
+		global::sceneSystem = new SceneSystem();
+	}
+
+	inline void ShutdownSystems()
+	{
+		delete global::assetSystem;
+		delete global::sceneSystem;
+		delete global::jobSystem;
+
+		Log::Shutdown();
+	}
+}
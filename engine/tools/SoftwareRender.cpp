@@ -0,0 +1,98 @@
+#include "EngineTool.hpp"
+#include "Software/SoftwareRenderer.hpp"
+
+// draws the scene on the cpu at a fixed time, writes the image and/or compares it against a golden
+// usage: softwarerender [--data_dir <dir>] [--capture <png>] [--golden <png>] [--tolerance 2] [--time 0]
+//                       [--width 1280] [--height 720] [--runs 5] [--workers 0]
+// exits with 1 if the image doesnt match the golden, the golden tests in engine/tests run it
+
+static int Render(const flags::args& args)
+{
+	const std::string capturePath = args.get<std::string>("capture", "");
+	const std::string goldenPath = args.get<std::string>("golden", "");
+	// max difference per channel that still counts as matching
+	const u32 tolerance = args.get<u32>("tolerance", 2u);
+	// fixed time so the image only changes when the code or the data does
+	const f64 time = args.get<f64>("time", 0.0);
+	const u32 width = args.get<u32>("width", 1280u);
+	const u32 height = args.get<u32>("height", 720u);
+	// the timings logged are the best of these
+	const u32 runs = std::max(args.get<u32>("runs", 5u), 1u);
+
+	if (width == 0 || height == 0) {
+		spdlog::critical("{}x{} is not an image size", width, height);
+		return -1;
+	}
+
+	global::assetSystem->RegisterAssets();
+
+	global::sceneSystem->runtimeScene = std::allocate_shared<RuntimeScene>(TrackedAllocator<RuntimeScene, MemoryTag::Scene>());
+	RuntimeScene& scene = *global::sceneSystem->runtimeScene.get();
+	scene.Update(time);
+	RenderSnapshot snapshot;
+	scene.WriteSnapshot(0, snapshot);
+
+	SoftwareRenderer renderer(width, height);
+
+	// best of each phase, the first run also pays for growing the buffers
+	SoftwareRenderer::Timings best;
+	for (u32 run = 0; run < runs; ++run) {
+		renderer.Render(snapshot);
+
+		const SoftwareRenderer::Timings& timings = renderer.GetTimings();
+		if (run == 0) {
+			best = timings;
+			continue;
+		}
+		best.vertex = std::min(best.vertex, timings.vertex);
+		best.bin = std::min(best.bin, timings.bin);
+		best.raster = std::min(best.raster, timings.raster);
+		best.resolve = std::min(best.resolve, timings.resolve);
+		best.total = std::min(best.total, timings.total);
+	}
+
+	spdlog::info("software render {}x{} on {} threads, best of {}: vertex {:.2f}ms bin {:.2f}ms raster {:.2f}ms resolve {:.2f}ms total {:.2f}ms, {} of {} triangles drawn",
+		width, height, global::jobSystem->GetThreadCount(), runs,
+		best.vertex, best.bin, best.raster, best.resolve, best.total, best.trianglesDrawn, best.trianglesIn);
+
+	const SoftwareRenderer::Image& image = renderer.GetImage();
+
+	if (!capturePath.empty()) {
+		if (!SoftwareRenderer::WritePng(image, capturePath)) {
+			return 1;
+		}
+		spdlog::info("software render written to {}", capturePath);
+	}
+
+	if (!goldenPath.empty()) {
+		SoftwareRenderer::Image golden;
+		if (!SoftwareRenderer::ReadPng(goldenPath, golden)) {
+			return 1;
+		}
+
+		const SoftwareRenderer::ImageDiff diff = SoftwareRenderer::Compare(golden, image, tolerance);
+		if (diff.sizeMismatch) {
+			spdlog::error("golden {} is {}x{}, rendered {}x{}", goldenPath, golden.width, golden.height, image.width, image.height);
+			return 1;
+		}
+		if (diff.differentPixels > 0) {
+			spdlog::error("{} pixels differ from golden {} by more than {}, max difference {}, psnr {:.2f}dB",
+				diff.differentPixels, goldenPath, tolerance, diff.maxChannelDiff, diff.psnr);
+			return 1;
+		}
+		spdlog::info("matches golden {}, max difference {}, psnr {:.2f}dB", goldenPath, diff.maxChannelDiff, diff.psnr);
+	}
+
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	const flags::args args(argc, argv);
+
+	EngineTool::InitSystems(args);
+	const int result = Render(args);
+	EngineTool::ShutdownSystems();
+
+	return result;
+}